@@ -0,0 +1,214 @@
+/*
+ *  Simple benchmark for the global DP matrix fill of MFE and partition
+ *  function computations
+ *
+ *  Usage: benchmark_fill [-p] [-b] [-l] [-g] [-t size] [-a n_seq] [-r repeats] [-s seed] [length ...]
+ *
+ *    -p          additionally compute the partition function
+ *    -b          additionally compute base pair probabilities (implies -p)
+ *    -l          additionally compute the partition function in log-space
+ *                (single sequences only, implies -p)
+ *    -g          include G-quadruplexes and additionally report the memory used
+ *                by the sparse G-quadruplex matrices compared to a dense
+ *                triangular layout
+ *    -t size     fill the matrices in tiles of size x size (see vrna_md_t.tile_size)
+ *    -a n_seq    fold alignments of n_seq random mutants instead of single sequences
+ *    -r repeats  number of random inputs per length (default 3)
+ *    -s seed     seed for the random inputs (default 1), such that different
+ *                builds of the library can be compared on identical data
+ *
+ *  Without length arguments, inputs of 1000, 2000, ..., 5000 nt are used.
+ *  The program prints the average wall clock time per input and length.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <ViennaRNA/fold_compound.h>
+#include <ViennaRNA/utils/basic.h>
+#include <ViennaRNA/utils/strings.h>
+#include <ViennaRNA/params/basic.h>
+#include <ViennaRNA/mfe.h>
+#include <ViennaRNA/part_func.h>
+#include <ViennaRNA/gquad.h>
+
+
+static double
+wall_time(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+
+/* create n_seq copies of seq with ~10% point mutations each */
+static char **
+random_alignment(const char *seq,
+                 int        n_seq)
+{
+  int   s, i, n;
+  char  **aln;
+
+  n   = (int)strlen(seq);
+  aln = (char **)vrna_alloc(sizeof(char *) * (n_seq + 1));
+
+  for (s = 0; s < n_seq; s++) {
+    aln[s] = strdup(seq);
+    for (i = 0; i < n; i++)
+      if (vrna_urn() < 0.1)
+        aln[s][i] = "ACGU-"[vrna_int_urn(0, 4)];
+  }
+
+  return aln;
+}
+
+
+int
+main(int  argc,
+     char *argv[])
+{
+  int                   i, r, n, a, pf, bpp, logspace, gquad, n_seq, repeats, seed, tile_size,
+                        lengths[64], num_lengths;
+  double                t, t_mfe, t_pf, t_log, mfe, gq_sparse, gq_dense;
+  char                  *seq, *structure, **aln;
+  vrna_md_t             md;
+  vrna_fold_compound_t  *fc;
+
+  pf          = 0;
+  bpp         = 0;
+  logspace    = 0;
+  gquad       = 0;
+  n_seq       = 0;
+  tile_size   = 0;
+  repeats     = 3;
+  seed        = 1;
+  num_lengths = 0;
+
+  for (a = 1; a < argc; a++) {
+    if (!strcmp(argv[a], "-p"))
+      pf = 1;
+    else if (!strcmp(argv[a], "-b"))
+      pf = bpp = 1;
+    else if (!strcmp(argv[a], "-l"))
+      pf = logspace = 1;
+    else if (!strcmp(argv[a], "-g"))
+      gquad = 1;
+    else if ((!strcmp(argv[a], "-t")) && (a + 1 < argc))
+      tile_size = atoi(argv[++a]);
+    else if ((!strcmp(argv[a], "-a")) && (a + 1 < argc))
+      n_seq = atoi(argv[++a]);
+    else if ((!strcmp(argv[a], "-r")) && (a + 1 < argc))
+      repeats = atoi(argv[++a]);
+    else if ((!strcmp(argv[a], "-s")) && (a + 1 < argc))
+      seed = atoi(argv[++a]);
+    else if (num_lengths < 64)
+      lengths[num_lengths++] = atoi(argv[a]);
+  }
+
+  if (num_lengths == 0)
+    for (num_lengths = 0; num_lengths < 5; num_lengths++)
+      lengths[num_lengths] = 1000 * (num_lengths + 1);
+
+  if (repeats < 1)
+    repeats = 1;
+
+  xsubi[0] = xsubi[1] = xsubi[2] = (unsigned short)seed;
+  vrna_md_set_default(&md);
+
+  md.compute_bpp = bpp;
+  md.tile_size   = tile_size;
+  md.gquad       = gquad;
+
+  /* neither log-space nor comparative partition functions support G-quadruplexes */
+  if ((n_seq > 0) || (gquad))
+    logspace = 0;
+
+  printf("# %s, %d input(s) per length\n",
+         (n_seq > 0) ? "alignments" : "single sequences",
+         repeats);
+  if (gquad)
+    printf("# %8s %12s %12s %12s %14s %14s\n", "length", "mfe [s]", "pf [s]", "pf log [s]",
+           "G sparse [MB]", "G dense [MB]");
+  else
+    printf("# %8s %12s %12s %12s\n", "length", "mfe [s]", "pf [s]", "pf log [s]");
+
+  for (i = 0; i < num_lengths; i++) {
+    n     = lengths[i];
+    t_mfe = t_pf = t_log = 0.;
+    gq_sparse = gq_dense = 0.;
+
+    for (r = 0; r < repeats; r++) {
+      seq       = vrna_random_string(n, "ACGU");
+      structure = (char *)vrna_alloc(sizeof(char) * (n + 1));
+      aln       = NULL;
+
+      if (n_seq > 0) {
+        aln = random_alignment(seq, n_seq);
+        fc  = vrna_fold_compound_comparative((const char **)aln, &md, VRNA_OPTION_DEFAULT);
+      } else {
+        fc = vrna_fold_compound(seq, &md, VRNA_OPTION_DEFAULT);
+      }
+
+      t     = wall_time();
+      mfe   = (double)vrna_mfe(fc, structure);
+      t_mfe += wall_time() - t;
+
+      if (gquad) {
+        /* memory of the sparse matrix vs. the n(n+1)/2 triangle of get_gquad_matrix() */
+        gq_sparse += (double)(fc->matrices->ggg->size * sizeof(int) +
+                              (n + 2) * sizeof(size_t));
+        gq_dense  += ((double)n * (n + 1) / 2 + 2) * sizeof(int);
+      }
+
+      if (pf) {
+        vrna_exp_params_rescale(fc, &mfe);
+        t     = wall_time();
+        (void)vrna_pf(fc, NULL);
+        t_pf  += wall_time() - t;
+
+        if ((gquad) && (n_seq == 0)) {
+          gq_sparse += (double)(fc->exp_matrices->G->size * sizeof(FLT_OR_DBL) +
+                                (n + 2) * sizeof(size_t));
+          gq_dense  += ((double)n * (n + 1) / 2 + 2) * sizeof(FLT_OR_DBL);
+        }
+      }
+
+      vrna_fold_compound_free(fc);
+
+      if (logspace) {
+        /* log-space computations require neither MFE nor pf_scale estimate */
+        md.pf_logspace  = 1;
+        fc              = vrna_fold_compound(seq, &md, VRNA_OPTION_DEFAULT);
+        md.pf_logspace  = 0;
+
+        t     = wall_time();
+        (void)vrna_pf(fc, NULL);
+        t_log += wall_time() - t;
+
+        vrna_fold_compound_free(fc);
+      }
+
+      if (aln) {
+        for (a = 0; a < n_seq; a++)
+          free(aln[a]);
+        free(aln);
+      }
+
+      free(structure);
+      free(seq);
+    }
+
+    if (gquad)
+      printf("  %8d %12.3f %12.3f %12.3f %14.3f %14.3f\n",
+             n, t_mfe / repeats, t_pf / repeats, t_log / repeats,
+             gq_sparse / repeats / (1024. * 1024.), gq_dense / repeats / (1024. * 1024.));
+    else
+      printf("  %8d %12.3f %12.3f %12.3f\n", n, t_mfe / repeats, t_pf / repeats, t_log / repeats);
+  }
+
+  return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ *  Simple throughput benchmark for the parallel processing of input
+ *  records (--jobs) in the programs
+ *
+ *  Usage: benchmark_queue [-j jobs] [-n records] [-m min] [-M max] [-d] [-o file] [-s seed]
+ *
+ *    -j jobs     number of worker threads (default 4)
+ *    -n records  number of random sequences (default 1000000)
+ *    -m min      minimum sequence length (default 15)
+ *    -M max      maximum sequence length (default 25)
+ *    -d          dispatch only, i.e. skip the MFE prediction and only pass
+ *                the records through the work queue and the ordered output
+ *    -o file     write the output to file (default /dev/null)
+ *    -s seed     seed for the random sequences (default 1)
+ *
+ *  The main thread generates the records and dispatches them like the
+ *  programs do with their input, i.e. through RUN_IN_PARALLEL() and the
+ *  bounded work queue of src/bin/parallel_helpers.c. The workers fold the
+ *  records with fold compounds from a vrna_fold_compound_pool_t, and the
+ *  results are written in input order through a vrna_ostream_t. The program
+ *  prints the wall clock time, the throughput, and the peak resident set
+ *  size. Since it uses the helpers of the programs, compile it from the
+ *  top-level source directory, e.g.
+ *
+ *    gcc -O2 -DVRNA_WITH_PTHREADS=1 -Isrc -Isrc/bin examples/benchmark_queue.c \
+ *        src/bin/parallel_helpers.c src/ViennaRNA/.libs/libRNA.a -fopenmp -lpthread -lm
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <ViennaRNA/fold_compound.h>
+#include <ViennaRNA/utils/basic.h>
+#include <ViennaRNA/utils/strings.h>
+#include <ViennaRNA/mfe.h>
+#include <ViennaRNA/datastructures/char_stream.h>
+#include <ViennaRNA/datastructures/stream_output.h>
+
+#include "parallel_helpers.h"
+
+
+struct options {
+  int                       dispatch_only;
+  vrna_md_t                 md;
+  vrna_ostream_t            output_queue;
+  vrna_fold_compound_pool_t *fc_pool;
+  FILE                      *output;
+};
+
+struct record_data {
+  unsigned int    number;
+  char            *sequence;
+  struct options  *options;
+};
+
+
+static double
+wall_time(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+
+  return (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+}
+
+
+static void
+flush_cstr_callback(void          *auxdata,
+                    unsigned int  i,
+                    void          *data)
+{
+  vrna_cstr_t buf = (vrna_cstr_t)data;
+
+  if (buf) {
+    vrna_cstr_fflush(buf);
+    vrna_cstr_free(buf);
+  }
+}
+
+
+static void
+process_record(struct record_data *record)
+{
+  unsigned int          n;
+  char                  *structure;
+  double                mfe;
+  vrna_cstr_t           buf;
+  vrna_fold_compound_t  *fc;
+  struct options        *opt;
+
+  opt = record->options;
+  n   = (unsigned int)strlen(record->sequence);
+  buf = vrna_cstr(3 * n, opt->output);
+
+  vrna_cstr_printf(buf, "%s\n", record->sequence);
+
+  if (!opt->dispatch_only) {
+    fc = vrna_fold_compound_pool_acquire(opt->fc_pool,
+                                         record->sequence,
+                                         &(opt->md),
+                                         VRNA_OPTION_DEFAULT);
+    structure = (char *)vrna_alloc(sizeof(char) * (n + 1));
+    mfe       = (double)vrna_mfe(fc, structure);
+
+    vrna_cstr_printf(buf, "%s (%6.2f)\n", structure, mfe);
+
+    vrna_fold_compound_pool_release(opt->fc_pool, fc);
+    free(structure);
+  }
+
+  vrna_ostream_provide(opt->output_queue, record->number, (void *)buf);
+
+  free(record->sequence);
+  free(record);
+}
+
+
+int
+main(int  argc,
+     char *argv[])
+{
+  int                 a, jobs, min_length, max_length, seed;
+  unsigned int        i, num_records;
+  double              t;
+  char                *filename;
+  struct rusage       usage;
+  struct options      opt;
+  struct record_data  *record;
+
+  jobs              = 4;
+  num_records       = 1000000;
+  min_length        = 15;
+  max_length        = 25;
+  seed              = 1;
+  filename          = "/dev/null";
+  opt.dispatch_only = 0;
+
+  for (a = 1; a < argc; a++) {
+    if (!strcmp(argv[a], "-d"))
+      opt.dispatch_only = 1;
+    else if ((!strcmp(argv[a], "-j")) && (a + 1 < argc))
+      jobs = atoi(argv[++a]);
+    else if ((!strcmp(argv[a], "-n")) && (a + 1 < argc))
+      num_records = (unsigned int)strtoul(argv[++a], NULL, 10);
+    else if ((!strcmp(argv[a], "-m")) && (a + 1 < argc))
+      min_length = atoi(argv[++a]);
+    else if ((!strcmp(argv[a], "-M")) && (a + 1 < argc))
+      max_length = atoi(argv[++a]);
+    else if ((!strcmp(argv[a], "-o")) && (a + 1 < argc))
+      filename = argv[++a];
+    else if ((!strcmp(argv[a], "-s")) && (a + 1 < argc))
+      seed = atoi(argv[++a]);
+  }
+
+  if (min_length < 1)
+    min_length = 1;
+
+  if (max_length < min_length)
+    max_length = min_length;
+
+  if (!(opt.output = fopen(filename, "w"))) {
+    fprintf(stderr, "unable to open \"%s\" for writing\n", filename);
+    return EXIT_FAILURE;
+  }
+
+  xsubi[0] = xsubi[1] = xsubi[2] = (unsigned short)seed;
+  vrna_md_set_default(&opt.md);
+
+  opt.output_queue  = vrna_ostream_init(&flush_cstr_callback, NULL);
+  opt.fc_pool       = vrna_fold_compound_pool_init(FC_POOL_MAX_LENGTH);
+
+  t = wall_time();
+
+  INIT_PARALLELIZATION(jobs);
+
+  for (i = 0; i < num_records; i++) {
+    record            = (struct record_data *)vrna_alloc(sizeof(struct record_data));
+    record->number    = i;
+    record->sequence  = vrna_random_string(vrna_int_urn(min_length, max_length), "ACGU");
+    record->options   = &opt;
+
+    vrna_ostream_request(opt.output_queue, i);
+
+    RUN_IN_PARALLEL(process_record, record);
+  }
+
+  UNINIT_PARALLELIZATION
+
+  vrna_ostream_free(opt.output_queue);
+
+  t = wall_time() - t;
+
+  vrna_fold_compound_pool_free(opt.fc_pool);
+  fclose(opt.output);
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("# %u records of %d-%d nt, %d job(s)%s\n",
+         num_records,
+         min_length,
+         max_length,
+         (jobs > 1) ? jobs : 1,
+         (opt.dispatch_only) ? ", dispatch only" : "");
+  printf("# %12s %16s %14s\n", "time [s]", "records/s", "peak RSS [MB]");
+  printf("  %12.3f %16.0f %14.1f\n",
+         t,
+         (t > 0.) ? (double)num_records / t : 0.,
+         (double)usage.ru_maxrss / 1024.);
+
+  return EXIT_SUCCESS;
+}
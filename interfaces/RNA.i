@@ -44,6 +44,7 @@ extern "C" {
 
 #include  <ViennaRNA/io/file_formats.h>
 #include  <ViennaRNA/io/file_formats_msa.h>
+#include  <ViennaRNA/io/accessibility.h>
 #include  <ViennaRNA/io/utils.h>
 
 #include  <ViennaRNA/loops/external.h>
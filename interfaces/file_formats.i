@@ -219,3 +219,145 @@ int my_file_msa_read_record(FILE                      *filehandle,
 %constant unsigned int FILE_FORMAT_MSA_APPEND    = VRNA_FILE_FORMAT_MSA_APPEND;
 
 %include <ViennaRNA/io/file_formats_msa.h>
+
+/**********************************************/
+/* BEGIN interface for accessibility stores   */
+/**********************************************/
+
+%ignore vrna_acc_store_s;
+%ignore vrna_acc_store_writer_s;
+
+%rename (acc_store)         vrna_acc_store_s;
+%rename (acc_store_writer)  vrna_acc_store_writer_s;
+%rename (acc_record)        vrna_acc_record_t;
+
+typedef struct {} vrna_acc_store_s;
+typedef struct {} vrna_acc_store_writer_s;
+
+/* records point into the memory mapped store, so they are read-only and never freed */
+%nodefaultctor vrna_acc_record_t;
+%nodefaultdtor vrna_acc_record_t;
+%immutable;
+typedef struct {
+  const char    *id;
+  unsigned int  length;
+  unsigned int  max_u;
+  double        kT;
+} vrna_acc_record_t;
+%mutable;
+
+%{
+#include <stdexcept>
+%}
+
+%extend vrna_acc_record_t {
+
+  float
+  energy(unsigned int i,
+         unsigned int u)
+  {
+    return vrna_acc_record_energy($self, i, u);
+  }
+
+  double
+  probability(unsigned int  i,
+              unsigned int  u)
+  {
+    return vrna_acc_record_probability($self, i, u);
+  }
+
+  /* the opening energies of all stretches of length u, 1-based */
+  std::vector<double>
+  energies(unsigned int u)
+  {
+    std::vector<double> v;
+
+    v.reserve($self->length + 1);
+    for (unsigned int i = 0; i <= $self->length; i++)
+      v.push_back(vrna_acc_record_energy($self, i, u));
+
+    return v;
+  }
+}
+
+%nodefaultdtor vrna_acc_store_s;
+
+%extend vrna_acc_store_s {
+  vrna_acc_store_s(std::string filename)
+  {
+    vrna_acc_store_t *store = vrna_acc_store_open(filename.c_str());
+
+    if (!store)
+      throw std::runtime_error("Can't read accessibility store " + filename);
+
+    return store;
+  }
+
+  ~vrna_acc_store_s()
+  {
+    vrna_acc_store_close($self);
+  }
+
+  unsigned int
+  size()
+  {
+    return vrna_acc_store_size($self);
+  }
+
+  const vrna_acc_record_t *
+  record(unsigned int k)
+  {
+    return vrna_acc_store_record($self, k);
+  }
+
+  const vrna_acc_record_t *
+  find(std::string id)
+  {
+    return vrna_acc_store_find($self, id.c_str());
+  }
+}
+
+%nodefaultdtor vrna_acc_store_writer_s;
+
+%extend vrna_acc_store_writer_s {
+  vrna_acc_store_writer_s(std::string filename)
+  {
+    vrna_acc_store_writer_t *writer = vrna_acc_store_create(filename.c_str());
+
+    if (!writer)
+      throw std::runtime_error("Can't create accessibility store " + filename);
+
+    return writer;
+  }
+
+  /* an unfinished store is finished upon destruction */
+  ~vrna_acc_store_writer_s()
+  {
+    vrna_acc_store_finish($self);
+  }
+
+  /* pu[i][u] as returned by pfl_fold_up(), i.e. [1..length][1..max_u] */
+  int
+  add(std::string                       id,
+      unsigned int                      max_u,
+      double                            kT,
+      std::vector<std::vector<double> > pu)
+  {
+    unsigned int  i, length;
+    int           ret;
+    double        **rows;
+
+    length  = (pu.size() > 0) ? (unsigned int)pu.size() - 1 : 0;
+    rows    = (double **)vrna_alloc(sizeof(double *) * (length + 1));
+
+    for (i = 1; i <= length; i++)
+      if (pu[i].size() > max_u)
+        rows[i] = &(pu[i][0]);
+
+    ret = vrna_acc_store_add($self, id.c_str(), length, max_u, kT, rows);
+
+    free(rows);
+
+    return ret;
+  }
+}
@@ -111,4 +111,13 @@ typedef struct {} vrna_fold_compound_t;
 %constant unsigned int OPTION_EVAL_ONLY = VRNA_OPTION_EVAL_ONLY;
 %constant unsigned int OPTION_WINDOW    = VRNA_OPTION_WINDOW;
 
+/* fold compound pools hand over the ownership of fold compounds, so we leave them to C programs */
+%ignore vrna_fold_compound_pool_init;
+%ignore vrna_fold_compound_pool_free;
+%ignore vrna_fold_compound_pool_acquire;
+%ignore vrna_fold_compound_pool_acquire_comparative;
+%ignore vrna_fold_compound_pool_release;
+%ignore vrna_fold_compound_add_rng;
+%ignore vrna_fc_s::rng;
+
 %include <ViennaRNA/fold_compound.h>
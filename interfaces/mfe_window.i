@@ -99,5 +99,7 @@ my_aliLfold(std::vector<std::string> alignment,
             int                      window_size,
             FILE                     *nullfile = NULL);
 
+%ignore vrna_mfe_window_cb_parallel;
+%ignore vrna_mfe_window_zscore_cb_parallel;
 
 %include <ViennaRNA/mfe_window.h>
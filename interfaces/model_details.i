@@ -36,6 +36,9 @@ typedef struct {
   double  sfact;
   int     rtype[8];
   short   alias[MAXALPHA+1];
+  int     wavefront;
+  int     pf_logspace;
+  int     tile_size;
 } vrna_md_t;
 
 /* make a nice object oriented interface to vrna_md_t */
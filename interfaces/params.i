@@ -126,6 +126,11 @@ typedef struct {
 %ignore scale_pf_parameters;
 %ignore copy_pf_param;
 %ignore set_pf_param;
+%ignore vrna_params_shared;
+%ignore vrna_exp_params_shared;
+%ignore vrna_exp_params_comparative_shared;
+%ignore vrna_params_shared_free;
+%ignore vrna_exp_params_shared_free;
 
 %include <ViennaRNA/params/basic.h>
 
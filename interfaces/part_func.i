@@ -121,8 +121,36 @@ extern char *pbacktrack(char *sequence);
   {
     return vrna_pbacktrack5($self, length);
   }
+
+  std::vector<std::string>
+  pbacktrack_num(unsigned int num_samples,
+                 unsigned int options = VRNA_PBACKTRACK_DEFAULT)
+  {
+    std::vector<std::string> ret;
+    char **samples = vrna_pbacktrack_num($self, num_samples, options);
+
+    if (samples) {
+      for (char **ptr = samples; *ptr; ptr++) {
+        ret.push_back(std::string(*ptr));
+        free(*ptr);
+      }
+      free(samples);
+    }
+
+    return ret;
+  }
 }
 
+%ignore vrna_pbacktrack_num;
+%ignore vrna_pbacktrack_cb;
+%ignore vrna_pbacktrack_num_pt;
+%ignore vrna_pbacktrack_cache_init;
+%ignore vrna_pbacktrack_cache_clear;
+%ignore vrna_pbacktrack_cache_free;
+%ignore vrna_pbacktrack_nr;
+%ignore vrna_pbacktrack_mem_free;
+%ignore vrna_nr_memory_s;
+
 %include  <ViennaRNA/boltzmann_sampling.h>
 
 /**********************************************/
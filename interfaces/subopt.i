@@ -152,5 +152,10 @@ std::vector<subopt_solution> my_subopt(char *seq, int delta, FILE *nullfile = NU
 %ignore zukersubopt;
 */
 %ignore zukersubopt_par;
+%ignore vrna_subopt_cb_parallel;
+%ignore vrna_subopt_parallel;
+%ignore vrna_subopt_stats;
+%ignore vrna_subopt_stats_s;
+%ignore vrna_subopt_sort_buffer;
 
 %include  <ViennaRNA/subopt.h>
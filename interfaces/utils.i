@@ -25,6 +25,16 @@
 %ignore filecopy;
 %ignore time_stamp;
 
+/* random number generator states are C-level building blocks for multithreaded sampling */
+%ignore vrna_rng_t;
+%ignore vrna_rng_s;
+%ignore vrna_rng_init;
+%ignore vrna_rng_free;
+%ignore vrna_rng_jump;
+%ignore vrna_rng_split;
+%ignore vrna_rng_urn;
+%ignore vrna_rng_int_urn;
+
 
 %include  <ViennaRNA/utils/basic.h>
 /**********************************************/
@@ -56,7 +56,7 @@ RNA_ENABLE_FLOATPF
 RNA_ENABLE_DEPRECATION_WARNINGS
 RNA_ENABLE_COLORED_TTY
 RNA_ENABLE_STATIC_BIN
-RNA_ENABLE_SSE
+RNA_ENABLE_SIMD
 
 ## Set post conditions for feature
 ## settings
@@ -246,7 +246,7 @@ Features
 
 Optimizations
 -------------
-  * Streaming SIMD Extension  : ${enable_sse:-no}
+  * SIMD (runtime dispatch)   : ${enable_simd:-no}${ac_simd_list}
   * Link Time Optimization    : ${enable_lto:-no}
   * POSIX Threads             : ${enable_pthreads:-no}
   * OpenMP                    : ${enable_openmp:-no}
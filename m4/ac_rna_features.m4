@@ -46,8 +46,8 @@ AC_DEFUN([RNA_GET_FEATURE],[
     AC_RNA_APPEND_VAR_COMMA($1, [Color])
     _features_active=1
   ])
-  AS_IF([test "x$enable_sse" = "xyes"], [
-    AC_RNA_APPEND_VAR_COMMA($1, [SSE4.1])
+  AS_IF([test "x$enable_simd" = "xyes"], [
+    AC_RNA_APPEND_VAR_COMMA($1, [SIMD])
     _features_active=1
   ])
   AS_IF([test "$_features_active" -eq "0"],[
@@ -412,65 +412,122 @@ into the executables are present!
 
 
 #
-# SSE implementations
+# SIMD implementations
 #
 
-AC_DEFUN([RNA_ENABLE_SSE],[
+## Check whether the compiler supports a particular SIMD instruction set
+## extension through the flag $2, and is able to compile the test program
+## given in $4 with the includes given in $3. On success, the flag is stored
+## in SIMD_$1_FLAGS and ac_simd_$1_supported is set to 'yes'
+AC_DEFUN([RNA_CHECK_SIMD],[
+  AC_MSG_CHECKING([compiler support for $2])
+  ac_save_CFLAGS="$CFLAGS"
+  CFLAGS="$ac_save_CFLAGS $2"
+  AC_LANG_PUSH([C])
+  AC_COMPILE_IFELSE(
+  [
+    AC_LANG_PROGRAM([$3], [$4])
+  ],
+  [
+    AC_MSG_RESULT([yes])
+    ac_simd_$1_supported=yes
+    SIMD_$1_FLAGS="$2"
+  ],
+  [
+    AC_MSG_RESULT([no])
+    ac_simd_$1_supported=no
+    SIMD_$1_FLAGS=""
+  ])
+  AC_LANG_POP([C])
+  CFLAGS="$ac_save_CFLAGS"
+])
 
-  RNA_ADD_FEATURE([sse],
-                  [Speed-up MFE computations using SSE 4.1 implementations],
-                  [no])
 
-  ## Add preprocessor define statement for Boustrophedon scheme in stochastic backtracking in part_func.c
-  RNA_FEATURE_IF_ENABLED([sse],[
-    if test "x$SIND_CFLAGS" = x; then
-      case $ax_cv_c_compiler_vendor in
-        gnu)
-          AC_LANG_PUSH([C])
-          AX_CHECK_COMPILE_FLAG([-msse4.1], [ac_sse41_supported=yes],[ac_sse41_supported=no],[],[])
-          AC_LANG_POP([C])
-          ;;
-        intel)
-          ;;
-        *)
-          ;;
-      esac
-    fi
+AC_DEFUN([RNA_ENABLE_SIMD],[
 
-    if test $ac_sse41_supported = no; then
-      enable_sse=no;
-    fi
-  ])
+  RNA_ADD_FEATURE([simd],
+                  [Speed-up MFE and partition function computations using SIMD implementations (SSE2, SSE4.1, AVX2, AVX-512) selected at runtime],
+                  [yes])
 
-  RNA_FEATURE_IF_ENABLED([sse],[
-    AC_MSG_CHECKING([compiler support for SSE4.1 min function])
-    ac_save_CFLAGS="$CFLAGS"
-    CFLAGS="$ac_save_CFLAGS -msse4.1"
-    AC_LANG(C)
-    AC_COMPILE_IFELSE(
-    [
-      AC_LANG_PROGRAM([[
-                        #include <smmintrin.h>
-                        #include <limits.h>
-                      ]],
-                        [[__m128i a = _mm_set1_epi32(INT_MAX);
-                          __m128i b = _mm_set1_epi32(INT_MIN);
-                          b = _mm_min_epi32(a, b);
-                      ]])
-    ],
-    [
-      AC_MSG_RESULT([yes])
-      SIMD_CFLAGS="${SIMD_CFLAGS} -msse4.1"
-      AC_DEFINE([VRNA_WITH_SSE_IMPLEMENTATION], [1], [use SSE implementations])
-      CONFIG_SSE_IMPLEMENTATION="#define VRNA_WITH_SSE_IMPLEMENTATION"
-    ],
-    [
-      enable_sse=no
-      AC_MSG_RESULT([no; using default implementation])
+  ac_simd_sse2_supported=no
+  ac_simd_sse41_supported=no
+  ac_simd_avx2_supported=no
+  ac_simd_avx512_supported=no
+  ac_simd_list=""
+
+  ## Check which instruction set extensions the compiler is able to generate code for.
+  ## Each implementation is compiled in a separate translation unit with the respective
+  ## flags, and the library selects the best one for the host CPU at runtime.
+  RNA_FEATURE_IF_ENABLED([simd],[
+    RNA_CHECK_SIMD([sse2], [-msse2], [[
+                     #include <emmintrin.h>
+                   ]],
+                   [[__m128d a = _mm_set1_pd(1.);
+                     __m128d b = _mm_set1_pd(2.);
+                     b = _mm_add_pd(a, _mm_mul_pd(a, b));
+                   ]])
+
+    RNA_CHECK_SIMD([sse41], [-msse4.1], [[
+                     #include <smmintrin.h>
+                     #include <limits.h>
+                   ]],
+                   [[__m128i a = _mm_set1_epi32(INT_MAX);
+                     __m128i b = _mm_set1_epi32(INT_MIN);
+                     b = _mm_min_epi32(a, b);
+                   ]])
+
+    RNA_CHECK_SIMD([avx2], [-mavx2], [[
+                     #include <immintrin.h>
+                     #include <limits.h>
+                   ]],
+                   [[__m256i a = _mm256_set1_epi32(INT_MAX);
+                     __m256i b = _mm256_set1_epi32(INT_MIN);
+                     b = _mm256_min_epi32(a, b);
+                   ]])
+
+    RNA_CHECK_SIMD([avx512], [-mavx512f], [[
+                     #include <immintrin.h>
+                     #include <limits.h>
+                   ]],
+                   [[__m512i a = _mm512_set1_epi32(INT_MAX);
+                     __m512i b = _mm512_set1_epi32(INT_MIN);
+                     b = _mm512_min_epi32(a, b);
+                     int c = _mm512_reduce_min_epi32(b);
+                   ]])
+
+    AS_IF([test "x$ac_simd_sse2_supported" = "xyes"], [
+      AC_DEFINE([VRNA_WITH_SIMD_SSE2], [1], [Compile SSE2 implementations])
+      AC_RNA_APPEND_VAR_COMMA(ac_simd_list, [SSE2])
+    ])
+    AS_IF([test "x$ac_simd_sse41_supported" = "xyes"], [
+      AC_DEFINE([VRNA_WITH_SIMD_SSE41], [1], [Compile SSE4.1 implementations])
+      AC_RNA_APPEND_VAR_COMMA(ac_simd_list, [SSE4.1])
+    ])
+    AS_IF([test "x$ac_simd_avx2_supported" = "xyes"], [
+      AC_DEFINE([VRNA_WITH_SIMD_AVX2], [1], [Compile AVX2 implementations])
+      AC_RNA_APPEND_VAR_COMMA(ac_simd_list, [AVX2])
+    ])
+    AS_IF([test "x$ac_simd_avx512_supported" = "xyes"], [
+      AC_DEFINE([VRNA_WITH_SIMD_AVX512], [1], [Compile AVX-512 implementations])
+      AC_RNA_APPEND_VAR_COMMA(ac_simd_list, [AVX-512])
+    ])
+
+    AS_IF([test "x$ac_simd_sse2_supported" != "xyes" &&
+           test "x$ac_simd_sse41_supported" != "xyes" &&
+           test "x$ac_simd_avx2_supported" != "xyes" &&
+           test "x$ac_simd_avx512_supported" != "xyes"], [
+      enable_simd=no
+    ], [
+      ac_simd_list=" (${ac_simd_list})"
     ])
-    CFLAGS="$ac_save_CFLAGS"
   ])
 
-  AC_SUBST(SIMD_CFLAGS)
-  AC_SUBST(CONFIG_SSE_IMPLEMENTATION)
+  AC_SUBST(SIMD_sse2_FLAGS)
+  AC_SUBST(SIMD_sse41_FLAGS)
+  AC_SUBST(SIMD_avx2_FLAGS)
+  AC_SUBST(SIMD_avx512_FLAGS)
+  AM_CONDITIONAL(VRNA_AM_SWITCH_SIMD_SSE2, test "x$ac_simd_sse2_supported" = "xyes")
+  AM_CONDITIONAL(VRNA_AM_SWITCH_SIMD_SSE41, test "x$ac_simd_sse41_supported" = "xyes")
+  AM_CONDITIONAL(VRNA_AM_SWITCH_SIMD_AVX2, test "x$ac_simd_avx2_supported" = "xyes")
+  AM_CONDITIONAL(VRNA_AM_SWITCH_SIMD_AVX512, test "x$ac_simd_avx512_supported" = "xyes")
 ])
@@ -30,6 +30,17 @@
 #include "ViennaRNA/Lfold.h"
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/part_func_window.h"
+#include "ViennaRNA/datastructures/file_stream.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ *  Sequences are split into chunks of PROBS_WINDOW_CHUNK_FACTOR times the
+ *  overlap of adjacent chunks for the multithreaded scan
+ */
+#define PROBS_WINDOW_CHUNK_FACTOR   64
 
 /*
  #################################
@@ -38,21 +49,42 @@
  */
 
 typedef struct {
-  int           bpp_print;  /* 1 if pairing probabilities should be written to file-handle, 0 if they are returned as vrna_ep_t */
-  int           up_print;   /* 1 if unpaired probabilities should be written to file-handle, 0 if they are returned as array */
-
-  FILE          *fp_pU;
-  double        **pU;
-  FLT_OR_DBL    bpp_cutoff;
-  FILE          *fp_bpp;
-  vrna_ep_t     *bpp;
-  unsigned int  bpp_max_size;
-  unsigned int  bpp_size;
-  vrna_ep_t     *stack_prob;
-  unsigned int  stack_prob_size;
-  unsigned int  stack_prob_max_size;
+  int             bpp_print;  /* 1 if pairing probabilities should be written to file-handle, 0 if they are returned as vrna_ep_t */
+  int             up_print;   /* 1 if unpaired probabilities should be written to file-handle, 0 if they are returned as array */
+
+  vrna_fstream_t  fs_pU;      /* output stream of the unpaired probability file-handle */
+  double          **pU;
+  FLT_OR_DBL      bpp_cutoff;
+  vrna_fstream_t  fs_bpp;     /* output stream of the pairing probability file-handle */
+  vrna_ep_t       *bpp;
+  unsigned int    bpp_max_size;
+  unsigned int    bpp_size;
+  vrna_ep_t       *stack_prob;
+  unsigned int    stack_prob_size;
+  unsigned int    stack_prob_max_size;
 } default_cb_data;
 
+/*
+ *  records of the output streams, pair probabilities and unpaired
+ *  probabilities of a single position k are followed by an array
+ *  of pairs (j, p) and an array of probabilities, respectively
+ */
+typedef struct {
+  int         j;
+  FLT_OR_DBL  p;
+} bpp_entry;
+
+typedef struct {
+  int k;
+  int num;
+} bpp_record;
+
+typedef struct {
+  int           k;
+  int           size;
+  unsigned int  type;
+} pU_record;
+
 typedef struct {
   FLT_OR_DBL  *prml;
   FLT_OR_DBL  *prm_l;
@@ -64,6 +96,31 @@ typedef struct {
   double      **pUH;
 } helper_arrays;
 
+/* a single callback execution of vrna_probs_window() for a chunk of the sequence */
+typedef struct {
+  unsigned int  type;
+  int           i;
+  int           pr_size;
+  int           max;
+  int           first;      /* index of the first value in the probability array */
+  size_t        offset;     /* byte offset of the first value in chunk_output.values */
+} chunk_record;
+
+/* callback data collected for a chunk of the sequence by vrna_probs_window_parallel() */
+typedef struct {
+  int           shift;      /* position in the sequence = position in the chunk + shift */
+  int           length;     /* length of the chunk */
+  int           first;      /* first position the chunk reports data for */
+  int           last;       /* last position the chunk reports data for */
+  int           pairsize;
+  chunk_record  *records;
+  size_t        num_records;
+  size_t        max_records;
+  char          *values;    /* FLT_OR_DBL, or double for unpaired probabilities */
+  size_t        num_values;
+  size_t        max_values;
+} chunk_output;
+
 /* soft constraint contributions function (interior-loops) */
 typedef FLT_OR_DBL (sc_int)(vrna_fold_compound_t *,
                             int,
@@ -86,10 +143,6 @@ typedef void (add_QI5)(FLT_OR_DBL **,
 
 #ifndef VRNA_DISABLE_BACKWARD_COMPATIBILITY
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
-
 /* some backward compatibility stuff */
 PRIVATE vrna_fold_compound_t  *backward_compat_compound = NULL;
 PRIVATE int                   backward_compat           = 0;
@@ -182,6 +235,13 @@ print_bpp_callback(FLT_OR_DBL *pr,
                    void       *data);
 
 
+PRIVATE void
+format_bpp(FILE       *fp,
+           const void *record,
+           size_t     size,
+           void       *data);
+
+
 PRIVATE void
 store_bpp_callback(FLT_OR_DBL *pr,
                    int        size,
@@ -208,6 +268,13 @@ print_pU_callback(double        *pU,
                   void          *data);
 
 
+PRIVATE void
+format_pU(FILE        *fp,
+          const void  *record,
+          size_t      size,
+          void        *data);
+
+
 PRIVATE void
 store_pU_callback(double        *pU,
                   int           size,
@@ -242,6 +309,38 @@ sc_dummy(vrna_fold_compound_t *vc,
          int                  l);
 
 
+PRIVATE int
+probs_window_chunkable(vrna_fold_compound_t *fc);
+
+
+PRIVATE int
+probs_window_chunk(vrna_fold_compound_t *fc,
+                   int                  start,
+                   int                  end,
+                   int                  ulength,
+                   unsigned int         options,
+                   chunk_output         *out);
+
+
+PRIVATE void
+chunk_store_callback(FLT_OR_DBL   *pr,
+                     int          pr_size,
+                     int          i,
+                     int          max,
+                     unsigned int type,
+                     void         *data);
+
+
+PRIVATE void
+chunk_output_replay(chunk_output                *out,
+                    vrna_probs_window_callback  *cb,
+                    void                        *data);
+
+
+PRIVATE void
+chunk_output_free(chunk_output *out);
+
+
 /*
  #################################
  # BEGIN OF FUNCTION DEFINITIONS #
@@ -255,10 +354,10 @@ vrna_pfl_fold(const char  *sequence,
 {
   default_cb_data data;
 
-  data.fp_pU                = NULL;
+  data.fs_pU                = NULL;
   data.pU                   = NULL;
   data.bpp_cutoff           = (FLT_OR_DBL)cutoff;
-  data.fp_bpp               = NULL;
+  data.fs_bpp               = NULL;
   data.bpp                  = NULL;
   data.bpp_max_size         = 0;
   data.bpp_size             = 0;
@@ -298,10 +397,10 @@ vrna_pfl_fold_up(const char *sequence,
     i   = strlen(sequence);
     pU  = (double **)vrna_alloc(sizeof(double *) * (i + 2));
 
-    data.fp_pU                = NULL;
+    data.fs_pU                = NULL;
     data.pU                   = pU;
     data.bpp_cutoff           = 0.;
-    data.fp_bpp               = NULL;
+    data.fs_bpp               = NULL;
     data.bpp                  = NULL;
     data.bpp_max_size         = 0;
     data.bpp_size             = 0;
@@ -942,6 +1041,266 @@ vrna_probs_window(vrna_fold_compound_t        *vc,
 }
 
 
+PUBLIC int
+vrna_probs_window_parallel(vrna_fold_compound_t       *fc,
+                           int                        ulength,
+                           unsigned int               options,
+                           vrna_probs_window_callback *cb,
+                           void                       *data,
+                           unsigned int               num_threads)
+{
+  int c, n, overlap, chunk_size, num_chunks, failed;
+
+  if ((!fc) || (!cb))
+    return 0; /* failure */
+
+#ifdef _OPENMP
+  if (num_threads == 0)
+    num_threads = (unsigned int)omp_get_max_threads();
+
+#else
+  num_threads = 1;
+#endif
+
+  n = (int)fc->length;
+
+  /*
+   *  The data reported for position i only depends on the windows that
+   *  contain i, and the nucleotides directly adjacent to these windows.
+   *  Thus, chunks that overlap by more than one window size yield exactly
+   *  the same data for their central part as a scan of the entire sequence
+   */
+  overlap     = fc->window_size + 2;
+  chunk_size  = PROBS_WINDOW_CHUNK_FACTOR * overlap;
+
+  if ((num_threads < 2) ||
+      (n < 2 * chunk_size) ||
+      (!probs_window_chunkable(fc)))
+    return vrna_probs_window(fc, ulength, options, cb, data);
+
+  /* prepare the Boltzmann factors shared by all chunks */
+  if (!vrna_fold_compound_prepare(fc, VRNA_OPTION_PF | VRNA_OPTION_WINDOW)) {
+    vrna_message_warning("vrna_probs_window_parallel: "
+                         "Failed to prepare vrna_fold_compound");
+    return 0; /* failure */
+  }
+
+  num_chunks  = (n + chunk_size - 1) / chunk_size;
+  failed      = 0;
+
+  /*
+   *  chunks are processed concurrently, but their data is passed to the
+   *  callback in the order of the chunks. Hence, at most num_threads chunks
+   *  are kept in memory at any time
+   */
+#pragma omp parallel for ordered schedule(dynamic, 1) num_threads(num_threads)
+  for (c = 0; c < num_chunks; c++) {
+    int           first, last, r;
+    chunk_output  out;
+
+    first = c * chunk_size + 1;
+    last  = MIN2(n, first + chunk_size - 1);
+
+    out.first       = first;
+    out.last        = last;
+    out.records     = NULL;
+    out.num_records = 0;
+    out.max_records = 0;
+    out.values      = NULL;
+    out.num_values  = 0;
+    out.max_values  = 0;
+
+    r = probs_window_chunk(fc,
+                           MAX2(1, first - overlap),
+                           MIN2(n, last + overlap),
+                           ulength,
+                           options,
+                           &out);
+
+#pragma omp ordered
+    {
+      if (!r)
+        failed = 1;
+
+      if (!failed)
+        chunk_output_replay(&out, cb, data);
+    }
+
+    chunk_output_free(&out);
+  }
+
+  return (failed) ? 0 : 1;
+}
+
+
+PRIVATE int
+probs_window_chunkable(vrna_fold_compound_t *fc)
+{
+  vrna_hc_t *hc;
+
+  /* chunks are folded without constraints or any other extensions */
+  if (fc->type != VRNA_FC_TYPE_SINGLE)
+    return 0;
+
+  hc = fc->hc;
+
+  if ((hc) &&
+      ((hc->up_storage) || (hc->bp_storage) || (hc->f)))
+    return 0;
+
+  if ((fc->sc) || (fc->domains_up))
+    return 0;
+
+  return 1;
+}
+
+
+PRIVATE int
+probs_window_chunk(vrna_fold_compound_t *fc,
+                   int                  start,
+                   int                  end,
+                   int                  ulength,
+                   unsigned int         options,
+                   chunk_output         *out)
+{
+  char                  *sequence;
+  int                   r;
+  vrna_md_t             md;
+  vrna_fold_compound_t  *chunk_fc;
+
+  sequence = (char *)vrna_alloc(sizeof(char) * (end - start + 2));
+  memcpy(sequence, fc->sequence + start - 1, sizeof(char) * (end - start + 1));
+
+  vrna_md_copy(&md, &(fc->exp_params->model_details));
+
+  out->shift    = start - 1;
+  out->length   = end - start + 1;
+  out->pairsize = md.max_bp_span;
+
+  chunk_fc = vrna_fold_compound(sequence, &md, VRNA_OPTION_WINDOW);
+
+  /* use the exact same Boltzmann factors and scaling as for the entire sequence */
+  vrna_exp_params_subst(chunk_fc, fc->exp_params);
+
+  r = vrna_probs_window(chunk_fc, ulength, options, &chunk_store_callback, (void *)out);
+
+  vrna_fold_compound_free(chunk_fc);
+  free(sequence);
+
+  return r;
+}
+
+
+PRIVATE void
+chunk_store_callback(FLT_OR_DBL   *pr,
+                     int          pr_size,
+                     int          i,
+                     int          max,
+                     unsigned int type,
+                     void         *data)
+{
+  int           key, first, last, shift;
+  size_t        bytes, size;
+  chunk_output  *out;
+  chunk_record  *rec;
+
+  out   = (chunk_output *)data;
+  shift = out->shift;
+  bytes = 0;
+
+  /*
+   *  determine the position the data belongs to, and the range of valid
+   *  entries in pr. Pair and stack probabilities, as well as ensemble free
+   *  energies, are indexed by their (absolute) 3' position, which needs
+   *  to be shifted along with the 5' position i
+   */
+  if (type & VRNA_PROBS_WINDOW_UP) {
+    /* unpaired probabilities are actually passed as arrays of double */
+    key   = i + shift;
+    first = 0;
+    last  = pr_size;
+    bytes = sizeof(double) * (last + 1);
+  } else if (type & VRNA_PROBS_WINDOW_PF) {
+    key     = pr_size + shift;
+    first   = i;
+    last    = pr_size;
+    pr_size += shift;
+  } else if (type & VRNA_PROBS_WINDOW_STACKP) {
+    key   = i + shift;
+    first = i + 1;
+    last  = MIN2(i + out->pairsize, out->length);
+  } else {
+    key     = i + shift;
+    first   = i;
+    last    = pr_size;
+    pr_size += shift;
+  }
+
+  if ((key < out->first) || (key > out->last))
+    return;
+
+  if (!(type & VRNA_PROBS_WINDOW_UP))
+    bytes = (last >= first) ? sizeof(FLT_OR_DBL) * (last - first + 1) : 0;
+
+  /* keep all records aligned */
+  size = (bytes + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+
+  if (out->num_records == out->max_records) {
+    out->max_records  = (out->max_records) ? 2 * out->max_records : 1024;
+    out->records      = (chunk_record *)vrna_realloc(out->records,
+                                                     sizeof(chunk_record) * out->max_records);
+  }
+
+  if (out->num_values + size > out->max_values) {
+    out->max_values = MAX2(2 * out->max_values, out->num_values + size);
+    out->values     = (char *)vrna_realloc(out->values, sizeof(char) * out->max_values);
+  }
+
+  rec           = out->records + out->num_records++;
+  rec->type     = type;
+  rec->i        = i + shift;
+  rec->pr_size  = pr_size;
+  rec->max      = max;
+  rec->first    = (first == 0) ? 0 : first + shift;
+  rec->offset   = out->num_values;
+
+  if (bytes > 0) {
+    memcpy(out->values + out->num_values,
+           (type & VRNA_PROBS_WINDOW_UP) ? (void *)pr : (void *)(pr + first),
+           bytes);
+    out->num_values += size;
+  }
+}
+
+
+PRIVATE void
+chunk_output_replay(chunk_output                *out,
+                    vrna_probs_window_callback  *cb,
+                    void                        *data)
+{
+  size_t        r;
+  chunk_record  *rec;
+
+  for (r = 0; r < out->num_records; r++) {
+    rec = out->records + r;
+    cb((FLT_OR_DBL *)(out->values + rec->offset) - rec->first,
+       rec->pr_size,
+       rec->i,
+       rec->max,
+       rec->type,
+       data);
+  }
+}
+
+
+PRIVATE void
+chunk_output_free(chunk_output *out)
+{
+  free(out->records);
+  free(out->values);
+}
+
+
 PRIVATE FLT_OR_DBL
 sc_contribution(vrna_fold_compound_t  *vc,
                 int                   i,
@@ -1864,16 +2223,43 @@ print_bpp_callback(FLT_OR_DBL *pr,
                    int        k,
                    void       *data)
 {
-  int         j;
-  FILE        *fp     = ((default_cb_data *)data)->fp_bpp;
-  FLT_OR_DBL  cutoff  = ((default_cb_data *)data)->bpp_cutoff;
+  int             j;
+  bpp_record      *rec;
+  bpp_entry       *entries;
+  vrna_fstream_t  fs      = ((default_cb_data *)data)->fs_bpp;
+  FLT_OR_DBL      cutoff  = ((default_cb_data *)data)->bpp_cutoff;
+
+  rec = (bpp_record *)vrna_fstream_reserve(fs,
+                                           sizeof(bpp_record) +
+                                           sizeof(bpp_entry) * MAX2(size - k, 0));
+  entries   = (bpp_entry *)(rec + 1);
+  rec->k    = k;
+  rec->num  = 0;
 
   for (j = k + 1; j <= size; j++) {
     if (pr[j] < cutoff)
       continue;
 
-    fprintf(fp, "%d  %d  %g\n", k, j, pr[j]);
+    entries[rec->num].j   = j;
+    entries[rec->num++].p = pr[j];
   }
+
+  vrna_fstream_commit(fs, sizeof(bpp_record) + sizeof(bpp_entry) * rec->num);
+}
+
+
+PRIVATE void
+format_bpp(FILE       *fp,
+           const void *record,
+           size_t     size,
+           void       *data)
+{
+  int               i;
+  const bpp_record  *rec      = (const bpp_record *)record;
+  const bpp_entry   *entries  = (const bpp_entry *)(rec + 1);
+
+  for (i = 0; i < rec->num; i++)
+    fprintf(fp, "%d  %d  %g\n", rec->k, entries[i].j, entries[i].p);
 }
 
 
@@ -1984,31 +2370,51 @@ print_pU_callback(double        *pU,
                   void          *data)
 {
   if (type & VRNA_PROBS_WINDOW_UP) {
-    int   i;
-    FILE  *fp = ((default_cb_data *)data)->fp_pU;
+    pU_record       *rec;
+    vrna_fstream_t  fs = ((default_cb_data *)data)->fs_pU;
 
-    fprintf(fp, "%d\t", k);
+    rec = (pU_record *)vrna_fstream_reserve(fs, sizeof(pU_record) + sizeof(double) * size);
+    rec->k    = k;
+    rec->size = size;
+    rec->type = type;
+    memcpy(rec + 1, pU + 1, sizeof(double) * size);
 
-    for (i = 1; i < size; i++)
-      fprintf(fp, "%.7g\t", pU[i]);
-    fprintf(fp, "%.7g", pU[size]);
-
-    if ((type & VRNA_ANY_LOOP) == VRNA_ANY_LOOP)
-      fprintf(fp, "\n");
-    else if (type & VRNA_EXT_LOOP)
-      fprintf(fp, "\tE\n");
-    else if (type & VRNA_HP_LOOP)
-      fprintf(fp, "\tH\n");
-    else if (type & VRNA_INT_LOOP)
-      fprintf(fp, "\tI\n");
-    else if (type & VRNA_MB_LOOP)
-      fprintf(fp, "\tM\n");
-    else
-      vrna_message_warning("unknown loop type");
+    vrna_fstream_commit(fs, sizeof(pU_record) + sizeof(double) * size);
   }
 }
 
 
+PRIVATE void
+format_pU(FILE        *fp,
+          const void  *record,
+          size_t      size,
+          void        *data)
+{
+  int             i;
+  const pU_record *rec  = (const pU_record *)record;
+  const double    *pU   = (const double *)(rec + 1) - 1; /* 1-based */
+
+  fprintf(fp, "%d\t", rec->k);
+
+  for (i = 1; i < rec->size; i++)
+    fprintf(fp, "%.7g\t", pU[i]);
+  fprintf(fp, "%.7g", pU[rec->size]);
+
+  if ((rec->type & VRNA_ANY_LOOP) == VRNA_ANY_LOOP)
+    fprintf(fp, "\n");
+  else if (rec->type & VRNA_EXT_LOOP)
+    fprintf(fp, "\tE\n");
+  else if (rec->type & VRNA_HP_LOOP)
+    fprintf(fp, "\tH\n");
+  else if (rec->type & VRNA_INT_LOOP)
+    fprintf(fp, "\tI\n");
+  else if (rec->type & VRNA_MB_LOOP)
+    fprintf(fp, "\tM\n");
+  else
+    vrna_message_warning("unknown loop type");
+}
+
+
 PRIVATE void
 store_pU_callback(double        *pU,
                   int           size,
@@ -2119,10 +2525,10 @@ wrap_pf_foldLP(char             *sequence,
   if (pU)
     ulength = (int)pU[0][0] + 0.49;
 
-  data.fp_pU                = pUfp;
+  data.fs_pU                = vrna_fstream_init(pUfp, 0, &format_pU, NULL);
   data.pU                   = pU;
   data.bpp_cutoff           = (FLT_OR_DBL)cutoffb;
-  data.fp_bpp               = spup;
+  data.fs_bpp               = vrna_fstream_init(spup, 0, &format_bpp, NULL);
   data.bpp                  = NULL;
   data.bpp_max_size         = 0;
   data.bpp_size             = 0;
@@ -2143,6 +2549,13 @@ wrap_pf_foldLP(char             *sequence,
 
   r = vrna_probs_window(vc, ulength, options, &backward_compat_callback, (void *)&data);
 
+  /* wait for the output streams to write everything */
+  if (data.fs_pU)
+    (void)vrna_fstream_free(data.fs_pU);
+
+  if (data.fs_bpp)
+    (void)vrna_fstream_free(data.fs_bpp);
+
   if (!r)
     return NULL;
 
@@ -22,14 +22,168 @@
 #include "ViennaRNA/constraints/hard.h"
 #include "ViennaRNA/constraints/soft.h"
 #include "ViennaRNA/alphabet.h"
+#include "ViennaRNA/part_func_logspace.h"
+#include "ViennaRNA/utils/structures.h"
 #include "ViennaRNA/boltzmann_sampling.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if VRNA_WITH_PTHREADS
+# include <pthread.h>
+#endif
+
+#ifndef INLINE
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+#endif
+
 /*
  #################################
  # GLOBAL VARIABLES              #
  #################################
  */
 
+/*
+ #################################
+ # PRIVATE MACROS                #
+ #################################
+ */
+
+/* number of consecutive samples drawn from the same random number stream */
+#define SAMPLES_PER_STREAM    64
+
+/*
+ *  Tables of the backtracking cache are looked up without locking, so they
+ *  must be published with release semantics once they are complete
+ */
+#ifdef __GNUC__
+# define CACHE_LOAD(ptr)        __atomic_load_n(&(ptr), __ATOMIC_ACQUIRE)
+# define CACHE_STORE(ptr, val)  __atomic_store_n(&(ptr), (val), __ATOMIC_RELEASE)
+#else
+# define CACHE_LOAD(ptr)        (ptr)
+# define CACHE_STORE(ptr, val)  ((ptr) = (val))
+#endif
+
+/* number of random number streams processed per thread and round of batched sampling */
+#define STREAMS_PER_THREAD    4
+
+/* private option flag to return pair tables from batched sampling */
+#define SAMPLE_PAIR_TABLE     (1U << 31)
+
+/* decompositions with memoized cumulative weights */
+#define BT_EXT                0   /* exterior loop, pairing partner i of j */
+#define BT_QB                 1   /* hairpin, interior, or multiloop closed by (i,j) */
+#define BT_QM                 2   /* first stem in multiloop segment [i,j] */
+#define BT_QM1                3   /* pairing partner l of i in [i,j] */
+#define BT_QM_UP              4   /* [i,j-1] unpaired or qm[i,j-1] (non-redundant sampling only) */
+
+/* relative weight below which non-redundant sampling considers a subtree exhausted */
+#define NR_EPSILON            1e-10
+
+/* number of attempts of non-redundant sampling to avoid subtrees exhausted by rounding errors */
+#define NR_MAX_RETRIES        100
+
+/*
+ #################################
+ # PRIVATE DATA STRUCTURES       #
+ #################################
+ */
+
+/* collects the samples of vrna_pbacktrack_num() and vrna_pbacktrack_num_pt() */
+struct sample_list {
+  void          **samples;
+  unsigned int  num;
+};
+
+
+/* forwards the samples of vrna_pbacktrack_cb() to the user callback */
+struct sample_callback {
+  vrna_boltzmann_sampling_callback  *cb;
+  void                              *data;
+};
+
+
+/*
+ *  a decomposition candidate and the cumulative Boltzmann weight of all
+ *  candidates up to (and including) this one. For BT_QB, k = 0 denotes
+ *  the hairpin, l > 0 an interior loop (k,l), and l = 0 a multiloop with
+ *  split index k
+ */
+struct bt_entry {
+  FLT_OR_DBL  cum;
+  int         k;
+  int         l;
+};
+
+
+struct bt_table {
+  unsigned int    num;
+  struct bt_entry entries[];
+};
+
+
+struct vrna_pbacktrack_cache_s {
+  int             length;
+  size_t          max_memory;
+  size_t          memory;
+  int             full;
+  struct bt_table **ext;      /* tables for BT_EXT, indexed by j */
+  struct bt_table ***rows[3]; /* tables for BT_QB, BT_QM, and BT_QM1, indexed by [i][j - i] */
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_t mtx;
+#endif
+};
+
+
+/* a pending subsegment of non-redundant stochastic backtracking */
+struct nr_segment {
+  int decomp;
+  int i;
+  int j;
+};
+
+
+/*
+ *  a node of the prefix tree of non-redundant sampling that represents
+ *  the decisions taken so far. It stores the probability of all structures
+ *  that share these decisions and the probability of those already drawn.
+ *  Below a node that has been passed by a single sample only, the remaining
+ *  decisions of that sample are kept in a compact tail instead of nodes
+ */
+struct nr_node {
+  FLT_OR_DBL      weight;
+  FLT_OR_DBL      removed;
+  unsigned int    idx;            /* candidate taken in the parent node */
+  unsigned int    num_children;
+  unsigned int    size_children;
+  struct nr_node  **children;     /* sorted by idx */
+  unsigned int    tail_length;
+  unsigned int    *tail;
+};
+
+
+struct vrna_nr_memory_s {
+  unsigned int      length;
+  FLT_OR_DBL        q;            /* partition function the memory belongs to */
+  struct nr_node    *root;
+
+  /* workspace of pbacktrack_nr() */
+  FLT_OR_DBL        *w;           /* candidate weights */
+  FLT_OR_DBL        *avail;       /* candidate weights without previous samples */
+  struct bt_table   *table;       /* candidates if there is no cache */
+  struct nr_segment *stack;       /* pending subsegments */
+  struct nr_node    **path;       /* nodes passed by the current sample */
+  unsigned int      *tail;        /* decisions taken below the first new node */
+  unsigned int      max_path;
+  unsigned int      max_tail;
+};
+
+
 /*
  #################################
  # PRIVATE VARIABLES             #
@@ -46,6 +200,206 @@ PRIVATE char *info_set_uniq_ml =
  # PRIVATE FUNCTION DECLARATIONS #
  #################################
  */
+PRIVATE INLINE double
+sample_urn(vrna_fold_compound_t *vc);
+
+
+PRIVATE int
+sampling_prepare(vrna_fold_compound_t *fc);
+
+
+PRIVATE char *
+sample_structure(vrna_fold_compound_t *fc);
+
+
+PRIVATE char *
+pbacktrack5(vrna_fold_compound_t  *vc,
+            int                   length);
+
+
+PRIVATE void
+sample_streams(vrna_fold_compound_t *fc,
+               vrna_rng_t           **streams,
+               unsigned int         num_samples,
+               void                 **samples,
+               unsigned int         options);
+
+
+PRIVATE unsigned int
+sample_batch(vrna_fold_compound_t *fc,
+             unsigned int         num_samples,
+             void                 (*emit)(void *sample, void *data),
+             void                 *data,
+             unsigned int         options);
+
+
+PRIVATE void *
+sample_convert(char         *structure,
+               unsigned int options);
+
+
+PRIVATE unsigned int
+sample_nr(vrna_fold_compound_t  *fc,
+          unsigned int          num_samples,
+          void                  (*emit)(void *sample, void *data),
+          void                  *data,
+          unsigned int          options);
+
+
+PRIVATE void
+emit_to_list(void *sample,
+             void *data);
+
+
+PRIVATE void
+emit_to_callback(void *sample,
+                 void *data);
+
+
+PRIVATE INLINE FLT_OR_DBL
+ext_stem_weight(vrna_fold_compound_t  *fc,
+                int                   i,
+                int                   j);
+
+
+PRIVATE INLINE FLT_OR_DBL
+int_loop_weight(vrna_fold_compound_t  *fc,
+                int                   i,
+                int                   j,
+                int                   k,
+                int                   l);
+
+
+PRIVATE INLINE FLT_OR_DBL
+ml_closing_weight(vrna_fold_compound_t  *fc,
+                  int                   i,
+                  int                   j);
+
+
+PRIVATE INLINE FLT_OR_DBL
+qm_split_accumulate(vrna_fold_compound_t  *fc,
+                    int                   i,
+                    int                   j,
+                    int                   k,
+                    FLT_OR_DBL            qmt);
+
+
+PRIVATE INLINE FLT_OR_DBL
+qm1_stem_weight(vrna_fold_compound_t  *fc,
+                int                   i,
+                int                   j,
+                int                   l);
+
+
+PRIVATE struct bt_table *
+bt_table_get(vrna_fold_compound_t *fc,
+             int                  decomp,
+             int                  i,
+             int                  j);
+
+
+PRIVATE struct bt_entry *
+bt_table_search(struct bt_table *table,
+                FLT_OR_DBL      r,
+                int             strict);
+
+
+PRIVATE struct bt_table *
+bt_table_build(vrna_fold_compound_t *fc,
+               int                  decomp,
+               int                  i,
+               int                  j);
+
+
+PRIVATE INLINE unsigned int
+bt_table_size(int decomp,
+              int i,
+              int j);
+
+
+PRIVATE INLINE FLT_OR_DBL
+bt_table_last(struct bt_table *table);
+
+
+PRIVATE INLINE FLT_OR_DBL
+bt_entry_weight(struct bt_table *table,
+                unsigned int    k);
+
+
+PRIVATE INLINE int
+bt_table_append(struct bt_table *table,
+                FLT_OR_DBL      cum,
+                int             k,
+                int             l,
+                FLT_OR_DBL      stop);
+
+
+PRIVATE void
+bt_table_fill(vrna_fold_compound_t  *fc,
+              int                   decomp,
+              int                   i,
+              int                   j,
+              struct bt_table       *table,
+              FLT_OR_DBL            stop);
+
+
+PRIVATE char *
+pbacktrack_nr(vrna_fold_compound_t    *fc,
+              struct vrna_nr_memory_s *mem);
+
+
+PRIVATE INLINE FLT_OR_DBL
+nr_ext_up_weight(vrna_fold_compound_t *fc,
+                 int                  j);
+
+
+PRIVATE INLINE FLT_OR_DBL
+nr_ml_up_weight(vrna_fold_compound_t  *fc,
+                int                   i,
+                int                   k);
+
+
+PRIVATE unsigned int
+nr_candidates(vrna_fold_compound_t    *fc,
+              struct vrna_nr_memory_s *mem,
+              struct nr_segment       *segment,
+              struct bt_table         **table);
+
+
+PRIVATE int
+nr_draw(vrna_fold_compound_t    *fc,
+        struct vrna_nr_memory_s *mem,
+        struct nr_segment       *segment,
+        struct bt_table         **table,
+        unsigned int            *c,
+        FLT_OR_DBL              *weight);
+
+
+PRIVATE void
+nr_apply(vrna_fold_compound_t *fc,
+         struct nr_segment    *segment,
+         unsigned int         c,
+         struct bt_table      *table,
+         char                 *pstruc,
+         struct nr_segment    *stack,
+         int                  *top);
+
+
+PRIVATE struct nr_node *
+nr_node_new(unsigned int  idx,
+            FLT_OR_DBL    weight);
+
+
+PRIVATE struct nr_node *
+nr_node_child(struct nr_node  *node,
+              unsigned int    idx,
+              FLT_OR_DBL      weight);
+
+
+PRIVATE void
+nr_node_free(struct nr_node *node);
+
+
 PRIVATE void  backtrack(int                   i,
                         int                   j,
                         char                  *pstruc,
@@ -108,6 +462,15 @@ PRIVATE char *pbacktrack_comparative(vrna_fold_compound_t *vc,
  #################################
  */
 
+/* draw from the generator attached to the fold compound, if any */
+PRIVATE INLINE double
+sample_urn(vrna_fold_compound_t *vc)
+{
+  return (vc->rng) ? vrna_rng_urn(vc->rng) : vrna_urn();
+}
+
+
+
 /*
  * stochastic backtracking in pf_fold arrays
  * returns random structure S with Boltzman probabilty
@@ -153,93 +516,346 @@ vrna_pbacktrack(vrna_fold_compound_t *vc)
 }
 
 
+PUBLIC char **
+vrna_pbacktrack_num(vrna_fold_compound_t  *fc,
+                    unsigned int          num_samples,
+                    unsigned int          options)
+{
+  struct sample_list list;
+
+  list.samples  = (void **)vrna_alloc(sizeof(char *) * (num_samples + 1));
+  list.num      = 0;
+
+  if ((num_samples > 0) &&
+      (sample_batch(fc, num_samples, &emit_to_list, (void *)&list, options) == 0)) {
+    free(list.samples);
+    return NULL;
+  }
+
+  list.samples[list.num] = NULL;
+
+  return (char **)list.samples;
+}
+
+
+PUBLIC unsigned int
+vrna_pbacktrack_cb(vrna_fold_compound_t             *fc,
+                   unsigned int                     num_samples,
+                   vrna_boltzmann_sampling_callback *cb,
+                   void                             *data,
+                   unsigned int                     options)
+{
+  struct sample_callback d;
+
+  if (!cb)
+    return 0;
+
+  d.cb    = cb;
+  d.data  = data;
+
+  return sample_batch(fc, num_samples, &emit_to_callback, (void *)&d, options);
+}
+
+
+PUBLIC short **
+vrna_pbacktrack_num_pt(vrna_fold_compound_t *fc,
+                       unsigned int         num_samples,
+                       unsigned int         options)
+{
+  struct sample_list list;
+
+  list.samples  = (void **)vrna_alloc(sizeof(short *) * (num_samples + 1));
+  list.num      = 0;
+
+  options &= ~VRNA_PBACKTRACK_PACKED;
+  options |= SAMPLE_PAIR_TABLE;
+
+  if ((num_samples > 0) &&
+      (sample_batch(fc, num_samples, &emit_to_list, (void *)&list, options) == 0)) {
+    free(list.samples);
+    return NULL;
+  }
+
+  list.samples[list.num] = NULL;
+
+  return (short **)list.samples;
+}
+
+
+PUBLIC char *
+vrna_pbacktrack_nr(vrna_fold_compound_t   *fc,
+                   vrna_pbacktrack_mem_t  *nr_mem)
+{
+  unsigned int            num;
+  FLT_OR_DBL              q;
+  struct vrna_nr_memory_s *mem;
+
+  if ((!fc) || (!nr_mem))
+    return NULL;
+
+  if ((fc->type != VRNA_FC_TYPE_SINGLE) ||
+      ((fc->exp_params) && (fc->exp_params->model_details.circ))) {
+    vrna_message_warning("vrna_pbacktrack_nr: Non-redundant sampling is only available "
+                         "for single linear sequences!");
+    return NULL;
+  }
+
+  if (!sampling_prepare(fc))
+    return NULL;
+
+  q = fc->exp_matrices->q[fc->iindx[1] - (int)fc->length];
+
+  if (!(*nr_mem)) {
+    num           = bt_table_size(BT_QB, 1, fc->length) + 1;
+    mem           = (struct vrna_nr_memory_s *)vrna_alloc(sizeof(struct vrna_nr_memory_s));
+    mem->length   = fc->length;
+    mem->q        = q;
+    mem->root     = nr_node_new(0, 1.);
+    mem->w        = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * num);
+    mem->avail    = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * num);
+    mem->table    = (struct bt_table *)vrna_alloc(sizeof(struct bt_table) +
+                                                  sizeof(struct bt_entry) * num);
+    mem->stack    = (struct nr_segment *)vrna_alloc(sizeof(struct nr_segment) *
+                                                    (2 * fc->length + 2));
+    mem->max_path = 2 * fc->length + 2;
+    mem->path     = (struct nr_node **)vrna_alloc(sizeof(struct nr_node *) * mem->max_path);
+    mem->max_tail = 2 * fc->length + 2;
+    mem->tail     = (unsigned int *)vrna_alloc(sizeof(unsigned int) * mem->max_tail);
+    *nr_mem       = mem;
+
+    /* decisions along previous samples require all candidates, so better memoize them */
+    if (!fc->exp_matrices->bt_cache)
+      vrna_pbacktrack_cache_init(fc, 0);
+  } else {
+    mem = *nr_mem;
+    if ((mem->length != fc->length) || (mem->q != q)) {
+      vrna_message_warning("vrna_pbacktrack_nr: Memory of previous samples does not match "
+                           "the partition function!");
+      return NULL;
+    }
+  }
+
+  return pbacktrack_nr(fc, mem);
+}
+
+
+PUBLIC void
+vrna_pbacktrack_mem_free(vrna_pbacktrack_mem_t nr_mem)
+{
+  if (nr_mem) {
+    nr_node_free(nr_mem->root);
+    free(nr_mem->w);
+    free(nr_mem->avail);
+    free(nr_mem->table);
+    free(nr_mem->stack);
+    free(nr_mem->path);
+    free(nr_mem->tail);
+    free(nr_mem);
+  }
+}
+
+
+PUBLIC int
+vrna_pbacktrack_cache_init(vrna_fold_compound_t *fc,
+                           size_t               max_memory)
+{
+  int                             d;
+  struct vrna_pbacktrack_cache_s  *cache;
+
+  if ((!fc) || (!fc->exp_matrices) || (fc->exp_matrices->type != VRNA_MX_DEFAULT))
+    return 0;
+
+  vrna_pbacktrack_cache_free(fc);
+
+  /* only linear single sequences, stochastic backtracking otherwise remains unchanged */
+  if ((fc->type != VRNA_FC_TYPE_SINGLE) || (fc->exp_params->model_details.circ))
+    return 0;
+
+  cache             = (struct vrna_pbacktrack_cache_s *)vrna_alloc(sizeof(struct vrna_pbacktrack_cache_s));
+  cache->length     = (int)fc->length;
+  cache->max_memory = (max_memory) ? max_memory : (size_t)-1;
+  cache->ext        = (struct bt_table **)vrna_alloc(sizeof(struct bt_table *) * (fc->length + 1));
+  cache->memory     = sizeof(struct bt_table *) * (fc->length + 1);
+
+  for (d = 0; d < 3; d++)
+    cache->rows[d] = (struct bt_table ***)vrna_alloc(sizeof(struct bt_table **) * (fc->length + 1));
+
+  cache->memory += 3 * sizeof(struct bt_table **) * (fc->length + 1);
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_init(&(cache->mtx), NULL);
+#endif
+
+  fc->exp_matrices->bt_cache = cache;
+
+  return 1;
+}
+
+
+PUBLIC void
+vrna_pbacktrack_cache_clear(vrna_fold_compound_t *fc)
+{
+  int                             d, i, j, n;
+  struct vrna_pbacktrack_cache_s  *cache;
+
+  if ((fc) && (fc->exp_matrices) && (fc->exp_matrices->bt_cache)) {
+    cache = fc->exp_matrices->bt_cache;
+    n     = cache->length;
+
+    for (j = 1; j <= n; j++) {
+      free(cache->ext[j]);
+      cache->ext[j] = NULL;
+    }
+
+    for (d = 0; d < 3; d++)
+      for (i = 1; i <= n; i++)
+        if (cache->rows[d][i]) {
+          for (j = i; j <= n; j++)
+            free(cache->rows[d][i][j - i]);
+
+          free(cache->rows[d][i]);
+          cache->rows[d][i] = NULL;
+        }
+
+    cache->memory = 4 * sizeof(struct bt_table *) * (n + 1);
+    cache->full   = 0;
+  }
+}
+
+
+PUBLIC void
+vrna_pbacktrack_cache_free(vrna_fold_compound_t *fc)
+{
+  int                             d;
+  struct vrna_pbacktrack_cache_s  *cache;
+
+  if ((fc) && (fc->exp_matrices) && (fc->exp_matrices->bt_cache)) {
+    vrna_pbacktrack_cache_clear(fc);
+
+    cache = fc->exp_matrices->bt_cache;
+
+    for (d = 0; d < 3; d++)
+      free(cache->rows[d]);
+
+    free(cache->ext);
+
+#if VRNA_WITH_PTHREADS
+    pthread_mutex_destroy(&(cache->mtx));
+#endif
+
+    free(cache);
+    fc->exp_matrices->bt_cache = NULL;
+  }
+}
+
+
 PUBLIC char *
 vrna_pbacktrack5(vrna_fold_compound_t *vc,
                  int                  length)
 {
-  FLT_OR_DBL        r, qt, q_temp, qkl;
-  int               i, j, ij, n, k, u, type;
-  char              *pstruc;
-  int               *my_iindx, *jindx, hc_decompose, *hc_up_ext;
-  FLT_OR_DBL        *q, *qb, *q1k, *qln, *scale;
-  unsigned char     *hard_constraints;
-  short             *S1, *S2;
-  vrna_mx_pf_t      *matrices;
-  vrna_md_t         *md;
-  vrna_hc_t         *hc;
-  vrna_sc_t         *sc;
-  vrna_exp_param_t  *pf_params;
+  int           k, n, *my_iindx;
+  FLT_OR_DBL    *q;
+  vrna_mx_pf_t  *matrices;
 
-  n = vc->length;
-
-  pf_params = vc->exp_params;
-  md        = &(vc->exp_params->model_details);
+  n         = vc->length;
   my_iindx  = vc->iindx;
-  jindx     = vc->jindx;
   matrices  = vc->exp_matrices;
 
-  hc  = vc->hc;
-  sc  = vc->sc;
-  S1  = vc->sequence_encoding;
-  S2  = vc->sequence_encoding2;
-
-  hard_constraints  = hc->matrix;
-  hc_up_ext         = hc->up_ext;
-
   if (length > n) {
     vrna_message_warning("vrna_pbacktrack5: 3'-end exceeds sequence length");
     return NULL;
   } else if (length < 1) {
     vrna_message_warning("vrna_pbacktrack5: 3'-end too small");
     return NULL;
-  } else if ((!matrices) || (!matrices->q) || (!matrices->qb) || (!matrices->qm) || (!pf_params)) {
+  } else if ((!matrices) || (!matrices->q) || (!matrices->qb) || (!matrices->qm) ||
+             (!vc->exp_params)) {
     vrna_message_warning("vrna_pbacktrack5: DP matrices are missing! Call vrna_pf() first!");
     return NULL;
+  } else if (vrna_pf_logspace(vc)) {
+    vrna_message_warning("vrna_pbacktrack5: Stochastic backtracking is not available "
+                         "for log-space partition functions!");
+    return NULL;
   } else if ((!vc->exp_params->model_details.uniq_ML) || (!matrices->qm1)) {
     vrna_message_warning("vrna_pbacktrack5: Unique multiloop decomposition is unset!");
     vrna_message_info(stderr, info_set_uniq_ml);
     return NULL;
   }
 
-  q     = matrices->q;
-  qb    = matrices->qb;
-  q1k   = matrices->q1k;
-  qln   = matrices->qln;
-  scale = matrices->scale;
-
-  pstruc = vrna_alloc((length + 1) * sizeof(char));
-
-  for (i = 0; i < length; i++)
-    pstruc[i] = '.';
-
-  if (!(q1k && qln)) {
+  if (!(matrices->q1k && matrices->qln)) {
+    q = matrices->q;
+    free(matrices->q1k);
+    free(matrices->qln);
     matrices->q1k = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 1));
     matrices->qln = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
-    q1k           = matrices->q1k;
-    qln           = matrices->qln;
     for (k = 1; k <= n; k++) {
-      q1k[k]  = q[my_iindx[1] - k];
-      qln[k]  = q[my_iindx[k] - n];
+      matrices->q1k[k]  = q[my_iindx[1] - k];
+      matrices->qln[k]  = q[my_iindx[k] - n];
     }
-    q1k[0]      = 1.0;
-    qln[n + 1]  = 1.0;
+    matrices->q1k[0]      = 1.0;
+    matrices->qln[n + 1]  = 1.0;
   }
 
-#ifdef VRNA_WITH_BOUSTROPHEDON
-  j = length;
-  while (j > 1) {
-    /* find j position of first pair */
-    for (; j > 1; j--) {
-      if (hc_up_ext[j]) {
-        r       = vrna_urn() * q1k[j];
-        q_temp  = q[my_iindx[1] - j + 1] * scale[1];
+  return pbacktrack5(vc, length);
+}
 
-        if (sc) {
-          if (sc->exp_energy_up)
-            q_temp *= sc->exp_energy_up[j][1];
 
-          if (sc->exp_f)
-            q_temp *= sc->exp_f(1, j, 1, j - 1, VRNA_DECOMP_EXT_EXT, sc->data);
+/*
+ * stochastic backtracking of a single sample for the subsequence [1, length],
+ * all preconditions have been checked by the callers already
+ */
+PRIVATE char *
+pbacktrack5(vrna_fold_compound_t  *vc,
+            int                   length)
+{
+  FLT_OR_DBL    r, qt, q_temp;
+  int           i, j;
+  char          *pstruc;
+  int           *my_iindx, *jindx, hc_decompose, *hc_up_ext;
+  FLT_OR_DBL    *scale;
+  unsigned char *hard_constraints;
+  vrna_mx_pf_t  *matrices;
+  vrna_hc_t     *hc;
+  vrna_sc_t     *sc;
+
+  my_iindx  = vc->iindx;
+  jindx     = vc->jindx;
+  matrices  = vc->exp_matrices;
+
+  hc  = vc->hc;
+  sc  = vc->sc;
+
+  hard_constraints  = hc->matrix;
+  hc_up_ext         = hc->up_ext;
+
+  scale = matrices->scale;
+
+  pstruc = vrna_alloc((length + 1) * sizeof(char));
+
+  for (i = 0; i < length; i++)
+    pstruc[i] = '.';
+
+#ifdef VRNA_WITH_BOUSTROPHEDON
+  int             k, u;
+  struct bt_table *table;
+  struct bt_entry *entry;
+  FLT_OR_DBL      *q    = matrices->q;
+  FLT_OR_DBL      *q1k  = matrices->q1k;
+  vrna_md_t       *md   = &(vc->exp_params->model_details);
+
+  j = length;
+  while (j > 1) {
+    /* find j position of first pair */
+    for (; j > 1; j--) {
+      if (hc_up_ext[j]) {
+        r       = sample_urn(vc) * q1k[j];
+        q_temp  = q[my_iindx[1] - j + 1] * scale[1];
+
+        if (sc) {
+          if (sc->exp_energy_up)
+            q_temp *= sc->exp_energy_up[j][1];
+
+          if (sc->exp_f)
+            q_temp *= sc->exp_f(1, j, 1, j - 1, VRNA_DECOMP_EXT_EXT, sc->data);
         }
 
         if (r > q_temp)
@@ -250,51 +866,48 @@ vrna_pbacktrack5(vrna_fold_compound_t *vc,
       break;         /* no more pairs */
 
     /* now find the pairing partner i */
-    r = vrna_urn() * (q1k[j] - q_temp);
+    r = sample_urn(vc) * (q1k[j] - q_temp);
     u = j - 1;
 
-    for (qt = 0, k = 1; k < j; k++) {
-      /* apply alternating boustrophedon scheme to variable i */
-      i = (int)(1 + (u - 1) * ((k - 1) % 2)) +
-          (int)((1 - (2 * ((k - 1) % 2))) * ((k - 1) / 2));
-      ij            = my_iindx[i] - j;
-      hc_decompose  = hard_constraints[jindx[j] + i];
-      if (hc_decompose & VRNA_CONSTRAINT_CONTEXT_EXT_LOOP) {
-        type  = vrna_get_ptype_md(S2[i], S2[j], md);
-        qkl   = qb[ij] * exp_E_ExtLoop(type,
-                                       (i > 1) ? S1[i - 1] : -1,
-                                       (j < n) ? S1[j + 1] : -1,
-                                       pf_params);
-
-        if (i > 1) {
-          qkl *= q1k[i - 1];
-          if (sc)
-            if (sc->exp_f)
-              qkl *= sc->exp_f(1, j, i - 1, i, VRNA_DECOMP_EXT_EXT_STEM, sc->data);
-        } else {
-          if (sc)
-            if (sc->exp_f)
-              qkl *= sc->exp_f(i, j, i, j, VRNA_DECOMP_EXT_STEM, sc->data);
-        }
+    if ((table = bt_table_get(vc, BT_EXT, 1, j))) {
+      if (!(entry = bt_table_search(table, r, 1)))
+        vrna_message_error("backtracking failed in ext loop");
 
-        qt += qkl;
-        if (qt > r)
-          break;           /* j is paired */
+      i = entry->k;
+    } else {
+      for (qt = 0, k = 1; k < j; k++) {
+        /* apply alternating boustrophedon scheme to variable i */
+        i = (int)(1 + (u - 1) * ((k - 1) % 2)) +
+            (int)((1 - (2 * ((k - 1) % 2))) * ((k - 1) / 2));
+        hc_decompose = hard_constraints[jindx[j] + i];
+        if (hc_decompose & VRNA_CONSTRAINT_CONTEXT_EXT_LOOP) {
+          qt += ext_stem_weight(vc, i, j);
+          if (qt > r)
+            break;           /* j is paired */
+        }
       }
+      if (k == j)
+        vrna_message_error("backtracking failed in ext loop");
     }
-    if (k == j)
-      vrna_message_error("backtracking failed in ext loop");
 
     backtrack(i, j, pstruc, vc);
     j = i - 1;
   }
 #else
+  int               start, ij, type;
+  int               n         = vc->length;
+  short             *S1       = vc->sequence_encoding;
+  char              *ptype    = vc->ptype;
+  FLT_OR_DBL        qkl, *qb  = matrices->qb;
+  FLT_OR_DBL        *qln      = matrices->qln;
+  vrna_exp_param_t  *pf_params = vc->exp_params;
+
   start = 1;
   while (start < length) {
     /* find i position of first pair */
     for (i = start; i < length; i++) {
       if (hc_up_ext[i]) {
-        r       = vrna_urn() * qln[i];
+        r       = sample_urn(vc) * qln[i];
         q_temp  = qln[i + 1] * scale[1];
 
         if (sc) {
@@ -313,7 +926,7 @@ vrna_pbacktrack5(vrna_fold_compound_t *vc,
       break;              /* no more pairs */
 
     /* now find the pairing partner j */
-    r = vrna_urn() * (qln[i] - q_temp);
+    r = sample_urn(vc) * (qln[i] - q_temp);
     for (qt = 0, j = i + 1; j <= length; j++) {
       ij            = my_iindx[i] - j;
       type          = vrna_get_ptype(jindx[j] + i, ptype);
@@ -358,12 +971,14 @@ backtrack_qm(int                  i,
              vrna_fold_compound_t *vc)
 {
   /* divide multiloop into qm and qm1  */
-  FLT_OR_DBL    qmt, r, q_temp;
-  int           k, u, cnt, span, turn;
-  FLT_OR_DBL    *qm, *qm1, *expMLbase;
-  int           *my_iindx, *jindx, *hc_up_ml;
-  vrna_sc_t     *sc;
-  vrna_hc_t     *hc;
+  FLT_OR_DBL      qmt, r, q_temp;
+  int             k, u, cnt, span, turn;
+  FLT_OR_DBL      *qm, *qm1, *expMLbase;
+  int             *my_iindx, *jindx, *hc_up_ml;
+  vrna_sc_t       *sc;
+  vrna_hc_t       *hc;
+  struct bt_table *table;
+  struct bt_entry *entry;
 
   vrna_mx_pf_t  *matrices = vc->exp_matrices;
 
@@ -382,50 +997,34 @@ backtrack_qm(int                  i,
 
   while (j > i) {
     /* now backtrack  [i ... j] in qm[] */
-    r   = vrna_urn() * qm[my_iindx[i] - j];
-    qmt = qm1[jindx[j] + i];
-    k   = cnt = i;
-    if (qmt < r) {
-      for (span = j - i, cnt = i + 1; cnt <= j; cnt++) {
+    r = sample_urn(vc) * qm[my_iindx[i] - j];
+
+    if ((table = bt_table_get(vc, BT_QM, i, j))) {
+      if (!(entry = bt_table_search(table, r, 0)))
+        vrna_message_error("backtrack failed in qm");
+
+      k = entry->k;
+    } else {
+      qmt = qm1[jindx[j] + i];
+      k   = cnt = i;
+      if (qmt < r) {
+        for (span = j - i, cnt = i + 1; cnt <= j; cnt++) {
 #ifdef VRNA_WITH_BOUSTROPHEDON
-        k = (int)(i + 1 + span * ((cnt - i - 1) % 2)) +
-            (int)((1 - (2 * ((cnt - i - 1) % 2))) * ((cnt - i) / 2));
+          k = (int)(i + 1 + span * ((cnt - i - 1) % 2)) +
+              (int)((1 - (2 * ((cnt - i - 1) % 2))) * ((cnt - i) / 2));
 #else
-        k = cnt;
+          k = cnt;
 #endif
-        q_temp  = 0.;
-        u       = k - i;
-        /* [i...k] is unpaired */
-        if (hc_up_ml[i] >= u) {
-          q_temp += expMLbase[u] * qm1[jindx[j] + k];
-
-          if (sc) {
-            if (sc->exp_energy_up)
-              q_temp *= sc->exp_energy_up[i][u];
+          qmt = qm_split_accumulate(vc, i, j, k, qmt);
 
-            if (sc->exp_f)
-              q_temp *= sc->exp_f(i, j, k, j, VRNA_DECOMP_ML_ML, sc->data);
-          }
-
-          qmt += q_temp;
+          if (qmt >= r)
+            break;
         }
-
-        /* split between k-1, k */
-        q_temp = qm[my_iindx[i] - (k - 1)] * qm1[jindx[j] + k];
-
-        if (sc)
-          if (sc->exp_f)
-            q_temp *= sc->exp_f(i, j, k - 1, k, VRNA_DECOMP_ML_ML_ML, sc->data);
-
-        qmt += q_temp;
-
-        if (qmt >= r)
-          break;
       }
-    }
 
-    if (cnt > j)
-      vrna_message_error("backtrack failed in qm");
+      if (cnt > j)
+        vrna_message_error("backtrack failed in qm");
+    }
 
     backtrack_qm1(k, j, pstruc, vc);
 
@@ -445,7 +1044,7 @@ backtrack_qm(int                  i,
           q_temp *= sc->exp_f(i, k - 1, i, k - 1, VRNA_DECOMP_ML_UP, sc->data);
       }
 
-      r = vrna_urn() * (qm[my_iindx[i] - (k - 1)] + q_temp);
+      r = sample_urn(vc) * (qm[my_iindx[i] - (k - 1)] + q_temp);
       if (q_temp >= r)
         break;
     }
@@ -462,69 +1061,55 @@ backtrack_qm1(int                   i,
               vrna_fold_compound_t  *vc)
 {
   /* i is paired to l, i<l<j; backtrack in qm1 to find l */
-  int               ii, l, il, type, turn;
-  FLT_OR_DBL        qt, r, q_temp;
-  FLT_OR_DBL        *qm1, *qb, *expMLbase;
+  int               l, il, turn;
+  FLT_OR_DBL        qt, r;
+  FLT_OR_DBL        *qm1;
   vrna_mx_pf_t      *matrices;
-  int               u, *my_iindx, *jindx, *hc_up_ml;
-  char              *ptype;
+  int               u, *jindx, *hc_up_ml;
   unsigned char     *hard_constraints;
-  short             *S1;
-  vrna_sc_t         *sc;
   vrna_hc_t         *hc;
   vrna_exp_param_t  *pf_params;
+  struct bt_table   *table;
+  struct bt_entry   *entry;
 
 
   pf_params = vc->exp_params;
-  my_iindx  = vc->iindx;
   jindx     = vc->jindx;
 
-  ptype = vc->ptype;
-
-  sc                = vc->sc;
   hc                = vc->hc;
   hc_up_ml          = hc->up_ml;
   hard_constraints  = hc->matrix;
 
   matrices  = vc->exp_matrices;
-  qb        = matrices->qb;
   qm1       = matrices->qm1;
-  expMLbase = matrices->expMLbase;
-  S1        = vc->sequence_encoding;
 
   turn = pf_params->model_details.min_loop_size;
 
-  r   = vrna_urn() * qm1[jindx[j] + i];
-  ii  = my_iindx[i];
-  for (qt = 0., l = j; l > i + turn; l--) {
-    il = jindx[l] + i;
-    if (hard_constraints[il] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC) {
-      u = j - l;
-      if (hc_up_ml[l + 1] >= u) {
-        type    = vrna_get_ptype(il, ptype);
-        q_temp  = qb[ii - l]
-                  * exp_E_MLstem(type, S1[i - 1], S1[l + 1], pf_params)
-                  * expMLbase[j - l];
-
-        if (sc) {
-          if (sc->exp_energy_up)
-            q_temp *= sc->exp_energy_up[l + 1][j - l];
+  r = sample_urn(vc) * qm1[jindx[j] + i];
 
-          if (sc->exp_f)
-            q_temp *= sc->exp_f(i, j, i, l, VRNA_DECOMP_ML_STEM, sc->data);
-        }
+  if ((table = bt_table_get(vc, BT_QM1, i, j))) {
+    if (!(entry = bt_table_search(table, r, 0)))
+      vrna_message_error("backtrack failed in qm1");
 
-        qt += q_temp;
-        if (qt >= r)
+    l = entry->k;
+  } else {
+    for (qt = 0., l = j; l > i + turn; l--) {
+      il = jindx[l] + i;
+      if (hard_constraints[il] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC) {
+        u = j - l;
+        if (hc_up_ml[l + 1] >= u) {
+          qt += qm1_stem_weight(vc, i, j, l);
+          if (qt >= r)
+            break;
+        } else {
+          l = i + turn;
           break;
-      } else {
-        l = i + turn;
-        break;
+        }
       }
     }
+    if (l < i + turn + 1)
+      vrna_message_error("backtrack failed in qm1");
   }
-  if (l < i + turn + 1)
-    vrna_message_error("backtrack failed in qm1");
 
   backtrack(i, l, pstruc, vc);
 }
@@ -548,7 +1133,7 @@ backtrack_qm2(int                   k,
   turn  = vc->exp_params->model_details.min_loop_size;
   sc    = vc->sc;
 
-  r = vrna_urn() * qm2[k];
+  r = sample_urn(vc) * qm2[k];
   /* we have to search for our barrier u between qm1 and qm1  */
   if ((sc) && (sc->exp_f)) {
     for (qom2t = 0., u = k + turn + 1; u < n - turn - 1; u++) {
@@ -581,21 +1166,18 @@ backtrack(int                   i,
           char                  *pstruc,
           vrna_fold_compound_t  *vc)
 {
-  char              *ptype, *sequence;
   unsigned char     *hard_constraints, hc_decompose;
   vrna_exp_param_t  *pf_params;
-  FLT_OR_DBL        *qb, *qm, *qm1, *scale;
+  FLT_OR_DBL        *qb, *qm, *qm1;
   FLT_OR_DBL        r, qbt1, qt, q_temp;
   vrna_mx_pf_t      *matrices;
-  int               *my_iindx, *jindx, *hc_up_int;
+  int               *my_iindx, *jindx, *hc_up_int, split;
   vrna_sc_t         *sc;
   vrna_hc_t         *hc;
-  short             *S1;
+  struct bt_table   *table;
+  struct bt_entry   *entry;
 
-  sequence  = vc->sequence;
   pf_params = vc->exp_params;
-  ptype     = vc->ptype;
-  S1        = vc->sequence_encoding;
   my_iindx  = vc->iindx;
   jindx     = vc->jindx;
 
@@ -608,27 +1190,39 @@ backtrack(int                   i,
   qb        = matrices->qb;
   qm        = matrices->qm;
   qm1       = matrices->qm1;
-  scale     = matrices->scale;
 
-  int noGUclosure = pf_params->model_details.noGUclosure;
-  int turn        = pf_params->model_details.min_loop_size;
-  int *rtype      = &(pf_params->model_details.rtype[0]);
+  int turn = pf_params->model_details.min_loop_size;
 
-  qbt1 = 0.;
+  qbt1  = 0.;
+  split = 0;
 
   do {
-    int           k, l, kl, u, u1, u2, max_k, min_l;
-    unsigned char type;
+    int k, l, u2, max_k, min_l;
     k = i;
     l = j;
 
     pstruc[i - 1] = '(';
     pstruc[j - 1] = ')';
 
-    r             = vrna_urn() * qb[my_iindx[i] - j];
-    type          = vrna_get_ptype(jindx[j] + i, ptype);
+    r             = sample_urn(vc) * qb[my_iindx[i] - j];
     hc_decompose  = hard_constraints[jindx[j] + i];
 
+    if ((table = bt_table_get(vc, BT_QB, i, j))) {
+      if (!(entry = bt_table_search(table, r, 0)))
+        vrna_message_error("backtrack failed, can't find split index ");
+
+      if (entry->k == 0) {
+        return;           /* found the hairpin we're done */
+      } else if (entry->l > 0) {
+        i = entry->k;     /* continue with the enclosed pair of the interior loop */
+        j = entry->l;
+        continue;
+      }
+
+      split = entry->k;   /* multiloop with known split index */
+      break;
+    }
+
     /* hairpin contribution */
     qbt1 = vrna_exp_E_hp_loop(vc, i, j);
 
@@ -641,51 +1235,13 @@ backtrack(int                   i,
       max_k = MIN2(max_k, j - turn - 2);
       max_k = MIN2(max_k, i + 1 + hc_up_int[i + 1]);
       for (k = i + 1; k <= max_k; k++) {
-        u1    = k - i - 1;
-        min_l = MAX2(k + turn + 1, j - 1 - MAXLOOP + u1);
-        kl    = my_iindx[k] - j + 1;
-        for (u2 = 0, l = j - 1; l >= min_l; l--, kl++, u2++) {
+        min_l = MAX2(k + turn + 1, j - 1 - MAXLOOP + k - i - 1);
+        for (u2 = 0, l = j - 1; l >= min_l; l--, u2++) {
           if (hc_up_int[l + 1] < u2)
             break;
 
           if (hard_constraints[jindx[l] + k] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
-            unsigned int type_2 = rtype[vrna_get_ptype(jindx[l] + k, ptype)];
-
-            /* add *scale[u1+u2+2] */
-            q_temp = qb[kl]
-                     * scale[u1 + u2 + 2]
-                     * exp_E_IntLoop(u1,
-                                     u2,
-                                     type,
-                                     type_2,
-                                     S1[i + 1],
-                                     S1[j - 1],
-                                     S1[k - 1],
-                                     S1[l + 1],
-                                     pf_params);
-
-            if (sc) {
-              if (sc->exp_energy_up)
-                q_temp *= sc->exp_energy_up[i + 1][u1]
-                          * sc->exp_energy_up[l + 1][u2];
-
-              if (sc->exp_energy_bp)
-                q_temp *= sc->exp_energy_bp[jindx[j] + i];
-
-              if (sc->exp_energy_stack) {
-                if ((i + 1 == k) && (j - 1 == l)) {
-                  q_temp *= sc->exp_energy_stack[i]
-                            * sc->exp_energy_stack[k]
-                            * sc->exp_energy_stack[l]
-                            * sc->exp_energy_stack[j];
-                }
-              }
-
-              if (sc->exp_f)
-                q_temp *= sc->exp_f(i, j, k, l, VRNA_DECOMP_PAIR_IL, sc->data);
-            }
-
-            qbt1 += q_temp;
+            qbt1 += int_loop_weight(vc, i, j, k, l);
             if (qbt1 >= r)
               break;
           }
@@ -708,19 +1264,10 @@ backtrack(int                   i,
 
   /* backtrack in multi-loop */
   {
-    int         k, ii, jj, tt;
+    int         k, ii, jj;
     FLT_OR_DBL  closingPair;
-    tt          = rtype[vrna_get_ptype(jindx[j] + i, ptype)];
-    closingPair = pf_params->expMLclosing
-                  * exp_E_MLstem(tt, S1[j - 1], S1[i + 1], pf_params)
-                  * scale[2];
-    if (sc) {
-      if (sc->exp_energy_bp)
-        q_temp *= sc->exp_energy_bp[jindx[j] + i];
 
-      if (sc->exp_f)
-        closingPair *= sc->exp_f(i, j, i, j, VRNA_DECOMP_PAIR_ML, sc->data);
-    }
+    closingPair = ml_closing_weight(vc, i, j);
 
     i++;
     j--;
@@ -728,7 +1275,9 @@ backtrack(int                   i,
     ii  = my_iindx[i];  /* ii-j=[i,j] */
     jj  = jindx[j];     /* jj+i=[j,i] */
 
-    if ((sc) && (sc->exp_f)) {
+    if (split) {
+      k = split;
+    } else if ((sc) && (sc->exp_f)) {
       for (qt = qbt1, k = i + 1; k < j; k++) {
         q_temp =  qm[ii - (k - 1)] *
                   qm1[jj + k] *
@@ -832,7 +1381,7 @@ wrap_pbacktrack_circ(vrna_fold_compound_t *vc)
       qt *= sc->exp_f(1, n, 1, n, VRNA_DECOMP_EXT_UP, sc->data);
   }
 
-  r   = vrna_urn() * qo;
+  r   = sample_urn(vc) * qo;
 
   /* open chain? */
   if (qt > r)
@@ -936,7 +1485,7 @@ wrap_pbacktrack_circ(vrna_fold_compound_t *vc)
   {
     /* as we reach this part, we have to search for our barrier between qm and qm2  */
     qt  = 0.;
-    r   = vrna_urn() * qmo;
+    r   = sample_urn(vc) * qmo;
     if ((sc) && (sc->exp_f)) {
       for (k = turn + 2; k < n - 2 * turn - 3; k++) {
         qt += qm[my_iindx[1] - k] *
@@ -1030,7 +1579,7 @@ pbacktrack_comparative(vrna_fold_compound_t *vc,
     /* find i position of first pair */
     probs = 1.;
     for (i = start; i < n; i++) {
-      gr = vrna_urn() * qln[i];
+      gr = sample_urn(vc) * qln[i];
       if (gr > qln[i + 1] * scale[1]) {
         *prob = *prob * probs * (1 - qln[i + 1] * scale[1] / qln[i]);
         break; /* i is paired */
@@ -1044,7 +1593,7 @@ pbacktrack_comparative(vrna_fold_compound_t *vc,
     }
 
     /* now find the pairing partner j */
-    r = vrna_urn() * (qln[i] - qln[i + 1] * scale[1]);
+    r = sample_urn(vc) * (qln[i] - qln[i + 1] * scale[1]);
     for (qt = 0, j = i + 1; j <= n; j++) {
       int         xtype;
       /*  type = ptype[my_iindx[i]-j];
@@ -1118,7 +1667,7 @@ backtrack_comparative(vrna_fold_compound_t  *vc,
     for (s = 0; s < n_seq; s++)
       type[s] = vrna_get_ptype_md(S[s][i], S[s][j], md);
 
-    r = vrna_urn() * (qb[my_iindx[i] - j] / exp(pscore[jindx[j] + i] / kTn)); /*?*exp(pscore[jindx[j]+i]/kTn)*/
+    r = sample_urn(vc) * (qb[my_iindx[i] - j] / exp(pscore[jindx[j] + i] / kTn)); /*?*exp(pscore[jindx[j]+i]/kTn)*/
 
     qbt1 = 1.;
     for (s = 0; s < n_seq; s++) {
@@ -1230,7 +1779,7 @@ backtrack_comparative(vrna_fold_compound_t  *vc,
     jj  = jindx[j];     /* jj+i=[j,i] */
     for (qt = 0., k = i + 1; k < j; k++)
       qttemp += qm[ii - (k - 1)] * qm1[jj + k];
-    r = vrna_urn() * qttemp;
+    r = sample_urn(vc) * qttemp;
     for (qt = 0., k = i + 1; k < j; k++) {
       qt += qm[ii - (k - 1)] * qm1[jj + k];
       if (qt >= r) {
@@ -1252,7 +1801,7 @@ backtrack_comparative(vrna_fold_compound_t  *vc,
       /* now backtrack  [i ... j] in qm[] */
       jj  = jindx[j];/*habides??*/
       ii  = my_iindx[i];
-      r   = vrna_urn() * qm[ii - j];
+      r   = sample_urn(vc) * qm[ii - j];
       qt  = qm1[jj + i];
       k   = i;
       if (qt < r) {
@@ -1279,7 +1828,7 @@ backtrack_comparative(vrna_fold_compound_t  *vc,
       if (k < i + TURN)
         break;             /* no more pairs */
 
-      r = vrna_urn() * (qm[ii - (k - 1)] + expMLbase[k - i]);
+      r = sample_urn(vc) * (qm[ii - (k - 1)] + expMLbase[k - i]);
       if (expMLbase[k - i] >= r) {
         *prob = *prob * expMLbase[k - i] / (qm[ii - (k - 1)] + expMLbase[k - i]);
         break; /* no more pairs */
@@ -1317,7 +1866,7 @@ backtrack_qm1_comparative(vrna_fold_compound_t  *vc,
   int               ii, l, xtype, s;
   FLT_OR_DBL        qt, r, tempz;
 
-  r   = vrna_urn() * qm1[jindx[j] + i];
+  r   = sample_urn(vc) * qm1[jindx[j] + i];
   ii  = my_iindx[i];
   for (qt = 0., l = i + TURN + 1; l <= j; l++) {
     if (qb[ii - l] == 0)
@@ -1344,3 +1893,1307 @@ backtrack_qm1_comparative(vrna_fold_compound_t  *vc,
 
   backtrack_comparative(vc, pstruc, i, l, prob);
 }
+
+
+/*
+ * check everything stochastic backtracking requires only once and
+ * add the auxiliary arrays that vrna_pbacktrack5() and the
+ * comparative backtracking would otherwise create on the fly, since
+ * the DP matrices must not change while they are shared among threads
+ */
+PRIVATE int
+sampling_prepare(vrna_fold_compound_t *fc)
+{
+  int           k, n, *my_iindx;
+  FLT_OR_DBL    *q;
+  vrna_mx_pf_t  *matrices;
+
+  if (!fc)
+    return 0;
+
+  matrices = fc->exp_matrices;
+
+  if ((!fc->exp_params) || (!matrices) || (!matrices->q) || (!matrices->qb) ||
+      (!matrices->qm)) {
+    vrna_message_warning("vrna_pbacktrack_num: DP matrices are missing! Call vrna_pf() first!");
+    return 0;
+  } else if ((!fc->exp_params->model_details.uniq_ML) || (!matrices->qm1)) {
+    vrna_message_warning("vrna_pbacktrack_num: Unique multiloop decomposition is unset!");
+    vrna_message_info(stderr, info_set_uniq_ml);
+    return 0;
+  } else if (vrna_pf_logspace(fc)) {
+    vrna_message_warning("vrna_pbacktrack_num: Stochastic backtracking is not available "
+                         "for log-space partition functions!");
+    return 0;
+  }
+
+  if ((!fc->exp_params->model_details.circ) &&
+      ((!matrices->q1k) || (!matrices->qln))) {
+    n         = fc->length;
+    q         = matrices->q;
+    my_iindx  = fc->iindx;
+
+    free(matrices->q1k);
+    free(matrices->qln);
+    matrices->q1k = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 1));
+    matrices->qln = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+    for (k = 1; k <= n; k++) {
+      matrices->q1k[k]  = q[my_iindx[1] - k];
+      matrices->qln[k]  = q[my_iindx[k] - n];
+    }
+    matrices->q1k[0]      = 1.0;
+    matrices->qln[n + 1]  = 1.0;
+  }
+
+  return 1;
+}
+
+
+PRIVATE char *
+sample_structure(vrna_fold_compound_t *fc)
+{
+  double prob = 1.;
+
+  if (fc->type == VRNA_FC_TYPE_COMPARATIVE)
+    return pbacktrack_comparative(fc, &prob);
+  else if (fc->exp_params->model_details.circ)
+    return wrap_pbacktrack_circ(fc);
+  else
+    return pbacktrack5(fc, fc->length);
+}
+
+
+/*
+ * draw SAMPLES_PER_STREAM consecutive samples from each random number
+ * stream. Streams are processed concurrently, each with its own shallow
+ * copy of the fold compound that only differs in the attached generator
+ */
+PRIVATE void
+sample_streams(vrna_fold_compound_t *fc,
+               vrna_rng_t           **streams,
+               unsigned int         num_samples,
+               void                 **samples,
+               unsigned int         options)
+{
+  int num_streams, s;
+
+  num_streams = (num_samples + SAMPLES_PER_STREAM - 1) / SAMPLES_PER_STREAM;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) if (num_streams > 1)
+#endif
+  for (s = 0; s < num_streams; s++) {
+    unsigned int          k, k_max;
+    vrna_fold_compound_t  fc_stream = *fc;
+
+    fc_stream.rng = streams[s];
+
+    k_max = MIN2(num_samples, (unsigned int)(s + 1) * SAMPLES_PER_STREAM);
+
+    for (k = (unsigned int)s * SAMPLES_PER_STREAM; k < k_max; k++)
+      samples[k] = sample_convert(sample_structure(&fc_stream), options);
+  }
+}
+
+
+/* convert a sampled structure into the output format requested by options */
+PRIVATE void *
+sample_convert(char         *structure,
+               unsigned int options)
+{
+  void *sample;
+
+  if (options & SAMPLE_PAIR_TABLE) {
+    sample = (void *)vrna_ptable(structure);
+    free(structure);
+  } else if (options & VRNA_PBACKTRACK_PACKED) {
+    sample = (void *)vrna_db_pack(structure);
+    free(structure);
+  } else {
+    sample = (void *)structure;
+  }
+
+  return sample;
+}
+
+
+/* draw non-redundant samples one after another until the ensemble is exhausted */
+PRIVATE unsigned int
+sample_nr(vrna_fold_compound_t  *fc,
+          unsigned int          num_samples,
+          void                  (*emit)(void *sample, void *data),
+          void                  *data,
+          unsigned int          options)
+{
+  unsigned int          k;
+  char                  *structure;
+  vrna_pbacktrack_mem_t nr_mem;
+
+  nr_mem = NULL;
+
+  for (k = 0; k < num_samples; k++) {
+    if (!(structure = vrna_pbacktrack_nr(fc, &nr_mem)))
+      break;
+
+    emit(sample_convert(structure, options), data);
+  }
+
+  vrna_pbacktrack_mem_free(nr_mem);
+
+  return k;
+}
+
+
+PRIVATE unsigned int
+sample_batch(vrna_fold_compound_t *fc,
+             unsigned int         num_samples,
+             void                 (*emit)(void *sample, void *data),
+             void                 *data,
+             unsigned int         options)
+{
+  unsigned int  threads, round_size, num, done, k, s;
+  uint64_t      seed;
+  void          **samples;
+  vrna_rng_t    *rng, **streams;
+
+  if (!sampling_prepare(fc))
+    return 0;
+
+  if (options & VRNA_PBACKTRACK_NON_REDUNDANT)
+    return sample_nr(fc, num_samples, emit, data, options);
+
+  threads = 1;
+#ifdef _OPENMP
+  threads = (unsigned int)omp_get_max_threads();
+#endif
+
+  /* all streams derive from the attached generator, or a seed obtained from vrna_urn() */
+  if (fc->rng) {
+    rng = fc->rng;
+  } else {
+    seed  = (uint64_t)(vrna_urn() * 4294967296.) << 32;
+    seed  |= (uint64_t)(vrna_urn() * 4294967296.);
+    rng   = vrna_rng_init(seed);
+  }
+
+  round_size  = threads * STREAMS_PER_THREAD * SAMPLES_PER_STREAM;
+  round_size  = MIN2(round_size, num_samples);
+  samples     = (void **)vrna_alloc(sizeof(void *) * round_size);
+  streams     = (vrna_rng_t **)vrna_alloc(sizeof(vrna_rng_t *) *
+                                          (round_size / SAMPLES_PER_STREAM + 1));
+
+  for (done = 0; done < num_samples; done += num) {
+    num = MIN2(round_size, num_samples - done);
+
+    for (s = 0; s * SAMPLES_PER_STREAM < num; s++)
+      streams[s] = vrna_rng_split(rng);
+
+    sample_streams(fc, streams, num, samples, options);
+
+    /* hand over the samples in the order they were drawn */
+    for (k = 0; k < num; k++)
+      emit(samples[k], data);
+
+    for (s = 0; s * SAMPLES_PER_STREAM < num; s++)
+      vrna_rng_free(streams[s]);
+  }
+
+  free(samples);
+  free(streams);
+
+  if (rng != fc->rng)
+    vrna_rng_free(rng);
+
+  return num_samples;
+}
+
+
+PRIVATE void
+emit_to_list(void *sample,
+             void *data)
+{
+  struct sample_list *list = (struct sample_list *)data;
+
+  list->samples[list->num++] = sample;
+}
+
+
+PRIVATE void
+emit_to_callback(void *sample,
+                 void *data)
+{
+  struct sample_callback *d = (struct sample_callback *)data;
+
+  d->cb((const char *)sample, d->data);
+  free(sample);
+}
+
+
+/*
+ * Boltzmann weights of the individual decomposition candidates. Linear
+ * scans and memoized tables both use them to accumulate weights in the
+ * very same order, such that both yield identical samples
+ */
+PRIVATE INLINE FLT_OR_DBL
+ext_stem_weight(vrna_fold_compound_t  *fc,
+                int                   i,
+                int                   j)
+{
+  int         type, n;
+  short       *S1, *S2;
+  FLT_OR_DBL  qkl;
+  vrna_sc_t   *sc;
+  vrna_md_t   *md;
+
+  n   = fc->length;
+  S1  = fc->sequence_encoding;
+  S2  = fc->sequence_encoding2;
+  sc  = fc->sc;
+  md  = &(fc->exp_params->model_details);
+
+  type  = vrna_get_ptype_md(S2[i], S2[j], md);
+  qkl   = fc->exp_matrices->qb[fc->iindx[i] - j] *
+          exp_E_ExtLoop(type,
+                        (i > 1) ? S1[i - 1] : -1,
+                        (j < n) ? S1[j + 1] : -1,
+                        fc->exp_params);
+
+  if (i > 1) {
+    qkl *= fc->exp_matrices->q1k[i - 1];
+    if (sc)
+      if (sc->exp_f)
+        qkl *= sc->exp_f(1, j, i - 1, i, VRNA_DECOMP_EXT_EXT_STEM, sc->data);
+  } else {
+    if (sc)
+      if (sc->exp_f)
+        qkl *= sc->exp_f(i, j, i, j, VRNA_DECOMP_EXT_STEM, sc->data);
+  }
+
+  return qkl;
+}
+
+
+PRIVATE INLINE FLT_OR_DBL
+int_loop_weight(vrna_fold_compound_t  *fc,
+                int                   i,
+                int                   j,
+                int                   k,
+                int                   l)
+{
+  int           u1, u2, *jindx, *rtype;
+  unsigned char type;
+  unsigned int  type_2;
+  short         *S1;
+  FLT_OR_DBL    q_temp;
+  vrna_sc_t     *sc;
+
+  jindx = fc->jindx;
+  S1    = fc->sequence_encoding;
+  sc    = fc->sc;
+  rtype = &(fc->exp_params->model_details.rtype[0]);
+
+  u1      = k - i - 1;
+  u2      = j - l - 1;
+  type    = vrna_get_ptype(jindx[j] + i, fc->ptype);
+  type_2  = rtype[vrna_get_ptype(jindx[l] + k, fc->ptype)];
+
+  /* add *scale[u1+u2+2] */
+  q_temp = fc->exp_matrices->qb[fc->iindx[k] - l]
+           * fc->exp_matrices->scale[u1 + u2 + 2]
+           * exp_E_IntLoop(u1,
+                           u2,
+                           type,
+                           type_2,
+                           S1[i + 1],
+                           S1[j - 1],
+                           S1[k - 1],
+                           S1[l + 1],
+                           fc->exp_params);
+
+  if (sc) {
+    if (sc->exp_energy_up)
+      q_temp *= sc->exp_energy_up[i + 1][u1]
+                * sc->exp_energy_up[l + 1][u2];
+
+    if (sc->exp_energy_bp)
+      q_temp *= sc->exp_energy_bp[jindx[j] + i];
+
+    if (sc->exp_energy_stack) {
+      if ((i + 1 == k) && (j - 1 == l)) {
+        q_temp *= sc->exp_energy_stack[i]
+                  * sc->exp_energy_stack[k]
+                  * sc->exp_energy_stack[l]
+                  * sc->exp_energy_stack[j];
+      }
+    }
+
+    if (sc->exp_f)
+      q_temp *= sc->exp_f(i, j, k, l, VRNA_DECOMP_PAIR_IL, sc->data);
+  }
+
+  return q_temp;
+}
+
+
+PRIVATE INLINE FLT_OR_DBL
+ml_closing_weight(vrna_fold_compound_t  *fc,
+                  int                   i,
+                  int                   j)
+{
+  int         tt;
+  short       *S1;
+  FLT_OR_DBL  closingPair;
+  vrna_sc_t   *sc;
+
+  S1  = fc->sequence_encoding;
+  sc  = fc->sc;
+
+  tt          = fc->exp_params->model_details.rtype[vrna_get_ptype(fc->jindx[j] + i, fc->ptype)];
+  closingPair = fc->exp_params->expMLclosing
+                * exp_E_MLstem(tt, S1[j - 1], S1[i + 1], fc->exp_params)
+                * fc->exp_matrices->scale[2];
+
+  if (sc)
+    if (sc->exp_f)
+      closingPair *= sc->exp_f(i, j, i, j, VRNA_DECOMP_PAIR_ML, sc->data);
+
+  return closingPair;
+}
+
+
+PRIVATE INLINE FLT_OR_DBL
+qm_split_accumulate(vrna_fold_compound_t  *fc,
+                    int                   i,
+                    int                   j,
+                    int                   k,
+                    FLT_OR_DBL            qmt)
+{
+  int           u, *my_iindx, *jindx;
+  FLT_OR_DBL    q_temp, *qm, *qm1;
+  vrna_sc_t     *sc;
+
+  my_iindx  = fc->iindx;
+  jindx     = fc->jindx;
+  qm        = fc->exp_matrices->qm;
+  qm1       = fc->exp_matrices->qm1;
+  sc        = fc->sc;
+
+  q_temp  = 0.;
+  u       = k - i;
+  /* [i...k] is unpaired */
+  if (fc->hc->up_ml[i] >= u) {
+    q_temp += fc->exp_matrices->expMLbase[u] * qm1[jindx[j] + k];
+
+    if (sc) {
+      if (sc->exp_energy_up)
+        q_temp *= sc->exp_energy_up[i][u];
+
+      if (sc->exp_f)
+        q_temp *= sc->exp_f(i, j, k, j, VRNA_DECOMP_ML_ML, sc->data);
+    }
+
+    qmt += q_temp;
+  }
+
+  /* split between k-1, k */
+  q_temp = qm[my_iindx[i] - (k - 1)] * qm1[jindx[j] + k];
+
+  if (sc)
+    if (sc->exp_f)
+      q_temp *= sc->exp_f(i, j, k - 1, k, VRNA_DECOMP_ML_ML_ML, sc->data);
+
+  qmt += q_temp;
+
+  return qmt;
+}
+
+
+PRIVATE INLINE FLT_OR_DBL
+qm1_stem_weight(vrna_fold_compound_t  *fc,
+                int                   i,
+                int                   j,
+                int                   l)
+{
+  int         type;
+  short       *S1;
+  FLT_OR_DBL  q_temp;
+  vrna_sc_t   *sc;
+
+  S1  = fc->sequence_encoding;
+  sc  = fc->sc;
+
+  type    = vrna_get_ptype(fc->jindx[l] + i, fc->ptype);
+  q_temp  = fc->exp_matrices->qb[fc->iindx[i] - l]
+            * exp_E_MLstem(type, S1[i - 1], S1[l + 1], fc->exp_params)
+            * fc->exp_matrices->expMLbase[j - l];
+
+  if (sc) {
+    if (sc->exp_energy_up)
+      q_temp *= sc->exp_energy_up[l + 1][j - l];
+
+    if (sc->exp_f)
+      q_temp *= sc->exp_f(i, j, i, l, VRNA_DECOMP_ML_STEM, sc->data);
+  }
+
+  return q_temp;
+}
+
+
+/*
+ * get the memoized table of decomposition candidates for [i,j], and
+ * build it on first access unless the cache exceeds its memory limit.
+ * Returns NULL if the caller has to scan the candidates instead.
+ *
+ * Rows and tables are never removed while sampling, and they are only
+ * published once they are complete. So lookups don't require the lock,
+ * which is only taken to insert a newly built table
+ */
+PRIVATE struct bt_table *
+bt_table_get(vrna_fold_compound_t *fc,
+             int                  decomp,
+             int                  i,
+             int                  j)
+{
+  size_t                          size, row_size;
+  struct bt_table                 **row, **slot, *table;
+  struct vrna_pbacktrack_cache_s  *cache;
+
+  cache = fc->exp_matrices->bt_cache;
+
+  if (!cache)
+    return NULL;
+
+  if (decomp == BT_EXT) {
+    slot = &(cache->ext[j]);
+  } else {
+    row   = CACHE_LOAD(cache->rows[decomp - 1][i]);
+    slot  = (row) ? &(row[j - i]) : NULL;
+  }
+
+  if ((slot) && ((table = CACHE_LOAD(*slot))))
+    return table;
+
+  if (CACHE_LOAD(cache->full))
+    return NULL;
+
+  /* build the table outside the critical section */
+  table = bt_table_build(fc, decomp, i, j);
+  size  = sizeof(struct bt_table) + sizeof(struct bt_entry) * table->num;
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_lock(&(cache->mtx));
+#endif
+
+  if (!slot) {
+    /* another thread may have added the row in the meantime */
+    row = cache->rows[decomp - 1][i];
+
+    if (!row) {
+      row_size = sizeof(struct bt_table *) * (cache->length - i + 1);
+      if (cache->memory + row_size <= cache->max_memory) {
+        row           = (struct bt_table **)vrna_alloc(row_size);
+        cache->memory += row_size;
+        CACHE_STORE(cache->rows[decomp - 1][i], row);
+      }
+    }
+
+    slot = (row) ? &(row[j - i]) : NULL;
+  }
+
+  if ((slot) && (*slot)) {
+    /* another thread was faster */
+    free(table);
+    table = *slot;
+  } else if ((slot) && (cache->memory + size <= cache->max_memory)) {
+    cache->memory += size;
+    CACHE_STORE(*slot, table);
+  } else {
+    CACHE_STORE(cache->full, 1);
+    free(table);
+    table = NULL;
+  }
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_unlock(&(cache->mtx));
+#endif
+
+  return table;
+}
+
+
+/* binary search for the first candidate whose cumulative weight reaches r */
+PRIVATE struct bt_entry *
+bt_table_search(struct bt_table *table,
+                FLT_OR_DBL      r,
+                int             strict)
+{
+  unsigned int lo, hi, mid;
+
+  lo  = 0;
+  hi  = table->num;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if ((strict) ? (table->entries[mid].cum > r) : (table->entries[mid].cum >= r))
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+
+  return (lo < table->num) ? &(table->entries[lo]) : NULL;
+}
+
+
+/*
+ * enumerate the decomposition candidates of [i,j] in the same order
+ * as the linear scans in backtrack(), backtrack_qm(), backtrack_qm1(),
+ * and the exterior loop part of vrna_pbacktrack5()
+ */
+PRIVATE struct bt_table *
+bt_table_build(vrna_fold_compound_t *fc,
+               int                  decomp,
+               int                  i,
+               int                  j)
+{
+  struct bt_table *table;
+
+  table = (struct bt_table *)vrna_alloc(sizeof(struct bt_table) +
+                                        sizeof(struct bt_entry) * bt_table_size(decomp, i, j));
+
+  bt_table_fill(fc, decomp, i, j, table, -1.);
+
+  return (struct bt_table *)vrna_realloc(table,
+                                         sizeof(struct bt_table) +
+                                         sizeof(struct bt_entry) * table->num);
+}
+
+
+/* maximum number of decomposition candidates of [i,j] */
+PRIVATE INLINE unsigned int
+bt_table_size(int decomp,
+              int i,
+              int j)
+{
+  return (decomp == BT_QB) ? (MAXLOOP + 2) * (MAXLOOP + 2) + j - i + 1 : j - i + 2;
+}
+
+
+/* cumulative weight of all candidates in table */
+PRIVATE INLINE FLT_OR_DBL
+bt_table_last(struct bt_table *table)
+{
+  return (table->num > 0) ? table->entries[table->num - 1].cum : 0.;
+}
+
+
+/* Boltzmann weight of candidate k in table */
+PRIVATE INLINE FLT_OR_DBL
+bt_entry_weight(struct bt_table *table,
+                unsigned int    k)
+{
+  return (k > 0) ? table->entries[k].cum - table->entries[k - 1].cum : table->entries[0].cum;
+}
+
+
+/*
+ * append a candidate with cumulative weight cum, and tell whether
+ * it contributes to, and reaches stop (if non-negative)
+ */
+PRIVATE INLINE int
+bt_table_append(struct bt_table *table,
+                FLT_OR_DBL      cum,
+                int             k,
+                int             l,
+                FLT_OR_DBL      stop)
+{
+  FLT_OR_DBL      prev;
+  struct bt_entry *entry;
+
+  prev        = bt_table_last(table);
+  entry       = &(table->entries[table->num]);
+  entry->cum  = cum;
+  entry->k    = k;
+  entry->l    = l;
+  table->num++;
+
+  return (stop >= 0.) && (cum > prev) && (cum >= stop);
+}
+
+
+/*
+ * fill table with the decomposition candidates of [i,j]. If stop is
+ * non-negative, the enumeration ends with the first candidate whose
+ * cumulative weight reaches stop
+ */
+PRIVATE void
+bt_table_fill(vrna_fold_compound_t  *fc,
+              int                   decomp,
+              int                   i,
+              int                   j,
+              struct bt_table       *table,
+              FLT_OR_DBL            stop)
+{
+  unsigned char *hard_constraints;
+  int           k, l, u, u2, cnt, span, max_k, min_l, turn, *jindx, *hc_up_int, *hc_up_ml,
+                ii, jj;
+  FLT_OR_DBL    q_temp, closingPair, *qm, *qm1;
+  vrna_sc_t     *sc;
+
+  jindx             = fc->jindx;
+  hard_constraints  = fc->hc->matrix;
+  hc_up_int         = fc->hc->up_int;
+  hc_up_ml          = fc->hc->up_ml;
+  qm                = fc->exp_matrices->qm;
+  qm1               = fc->exp_matrices->qm1;
+  sc                = fc->sc;
+  turn              = fc->exp_params->model_details.min_loop_size;
+
+  table->num = 0;
+
+  switch (decomp) {
+    case BT_EXT:
+      u = j - 1;
+      for (k = 1; k < j; k++) {
+        /* apply alternating boustrophedon scheme to variable i */
+        i = (int)(1 + (u - 1) * ((k - 1) % 2)) +
+            (int)((1 - (2 * ((k - 1) % 2))) * ((k - 1) / 2));
+        if (hard_constraints[jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_EXT_LOOP)
+          if (bt_table_append(table, bt_table_last(table) + ext_stem_weight(fc, i, j), i, 0, stop))
+            return;
+      }
+      break;
+
+    case BT_QB:
+      /* hairpin */
+      if (bt_table_append(table, vrna_exp_E_hp_loop(fc, i, j), 0, 0, stop))
+        return;
+
+      /* interior loops */
+      if (hard_constraints[jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP) {
+        max_k = i + MAXLOOP + 1;
+        max_k = MIN2(max_k, j - turn - 2);
+        max_k = MIN2(max_k, i + 1 + hc_up_int[i + 1]);
+        for (k = i + 1; k <= max_k; k++) {
+          min_l = MAX2(k + turn + 1, j - 1 - MAXLOOP + k - i - 1);
+          for (u2 = 0, l = j - 1; l >= min_l; l--, u2++) {
+            if (hc_up_int[l + 1] < u2)
+              break;
+
+            if (hard_constraints[jindx[l] + k] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC)
+              if (bt_table_append(table,
+                                bt_table_last(table) + int_loop_weight(fc, i, j, k, l),
+                                k,
+                                l,
+                                stop))
+                return;
+          }
+        }
+      }
+
+      /* multiloops */
+      closingPair = ml_closing_weight(fc, i, j);
+      ii          = fc->iindx[i + 1];
+      jj          = jindx[j - 1];
+      for (k = i + 2; k < j - 1; k++) {
+        q_temp = qm[ii - (k - 1)] *
+                 qm1[jj + k] *
+                 closingPair;
+
+        if (sc)
+          if (sc->exp_f)
+            q_temp *= sc->exp_f(i + 1, j - 1, k - 1, k, VRNA_DECOMP_ML_ML_ML, sc->data);
+
+        if (bt_table_append(table, bt_table_last(table) + q_temp, k, 0, stop))
+          return;
+      }
+      break;
+
+    case BT_QM:
+      if (bt_table_append(table, qm1[jindx[j] + i], i, 0, stop))
+        return;
+
+      for (span = j - i, cnt = i + 1; cnt <= j; cnt++) {
+#ifdef VRNA_WITH_BOUSTROPHEDON
+        k = (int)(i + 1 + span * ((cnt - i - 1) % 2)) +
+            (int)((1 - (2 * ((cnt - i - 1) % 2))) * ((cnt - i) / 2));
+#else
+        k = cnt;
+#endif
+        q_temp = qm_split_accumulate(fc, i, j, k, bt_table_last(table));
+        if (bt_table_append(table, q_temp, k, 0, stop))
+          return;
+      }
+      break;
+
+    case BT_QM1:
+      for (l = j; l > i + turn; l--) {
+        if (hard_constraints[jindx[l] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC) {
+          if (hc_up_ml[l + 1] < j - l)
+            break;
+
+          if (bt_table_append(table, bt_table_last(table) + qm1_stem_weight(fc, i, j, l), l, 0, stop))
+            return;
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+/*
+ * non-redundant stochastic backtracking. The pending subsegments are
+ * processed in the same order as in vrna_pbacktrack5(), such that the
+ * sequence of decisions identifies a structure. Along nodes of the prefix
+ * tree, the probability of structures already drawn is removed from the
+ * weights of the candidates. Below a new node, the decisions are drawn as
+ * usual and only recorded in the tail of that node
+ */
+PRIVATE char *
+pbacktrack_nr(vrna_fold_compound_t    *fc,
+              struct vrna_nr_memory_s *mem)
+{
+  char              *pstruc;
+  int               n, top, failed, attempt;
+  unsigned int      c, k, num, depth, tail_length;
+  FLT_OR_DBL        *w, *avail, sum, factor, r, weight;
+  struct bt_table   *table;
+  struct nr_segment *stack, segment;
+  struct nr_node    *node, *fresh, *child;
+
+  n       = (int)fc->length;
+  w       = mem->w;
+  avail   = mem->avail;
+  stack   = mem->stack;
+  pstruc  = (char *)vrna_alloc(sizeof(char) * (n + 1));
+  failed  = 1;
+
+  for (attempt = 0; attempt < NR_MAX_RETRIES; attempt++) {
+    node = mem->root;
+
+    /* all structures have been drawn already */
+    if (node->weight - node->removed <= node->weight * NR_EPSILON)
+      break;
+
+    memset(pstruc, '.', sizeof(char) * n);
+
+    stack[0].decomp = BT_EXT;
+    stack[0].i      = 1;
+    stack[0].j      = n;
+    top             = 1;
+    mem->path[0]    = node;
+    depth           = 1;
+    fresh           = NULL;
+    tail_length     = 0;
+    weight          = 0.;
+    failed          = 0;
+
+    while ((top > 0) && (!failed)) {
+      segment = stack[--top];
+
+      if (fresh) {
+        /* nothing has been drawn below the new node yet */
+        if (!nr_draw(fc, mem, &segment, &table, &c, &weight))
+          continue;
+
+        if (tail_length == mem->max_tail) {
+          mem->max_tail *= 2;
+          mem->tail     = (unsigned int *)vrna_realloc(mem->tail,
+                                                       sizeof(unsigned int) * mem->max_tail);
+        }
+
+        mem->tail[tail_length++] = c;
+      } else {
+        if (!(num = nr_candidates(fc, mem, &segment, &table)))
+          continue;
+
+        for (sum = 0., c = 0; c < num; c++)
+          sum += w[c];
+
+        if (sum <= 0.)
+          vrna_message_error("backtracking failed in non-redundant sampling");
+
+        factor = node->weight / sum;
+
+        /* turn the first decision of a single previous sample into a node */
+        if (node->tail_length > 0) {
+          child               = nr_node_child(node, node->tail[0], factor * w[node->tail[0]]);
+          child->removed      = node->removed;
+          child->tail_length  = node->tail_length - 1;
+          if (child->tail_length > 0) {
+            child->tail = (unsigned int *)vrna_alloc(sizeof(unsigned int) * child->tail_length);
+            memcpy(child->tail, node->tail + 1, sizeof(unsigned int) * child->tail_length);
+          }
+
+          free(node->tail);
+          node->tail        = NULL;
+          node->tail_length = 0;
+        }
+
+        /* remove the probability of structures drawn before from the candidates */
+        for (sum = 0., k = 0, c = 0; c < num; c++) {
+          if ((k < node->num_children) && (node->children[k]->idx == c)) {
+            child     = node->children[k++];
+            avail[c]  = child->weight - child->removed;
+            if (avail[c] <= child->weight * NR_EPSILON)
+              avail[c] = 0.;
+          } else {
+            avail[c] = factor * w[c];
+          }
+
+          sum += avail[c];
+        }
+
+        if (sum <= node->weight * NR_EPSILON) {
+          /* the remainder of this subtree is lost to rounding, mark it exhausted and restart */
+          weight = node->weight - node->removed;
+          for (k = 0; k < depth; k++)
+            mem->path[k]->removed += weight;
+
+          failed = 1;
+          break;
+        }
+
+        r = sample_urn(fc) * sum;
+        for (sum = 0., c = 0; c < num; c++) {
+          sum += avail[c];
+          if ((avail[c] > 0.) && (sum >= r))
+            break;
+        }
+
+        if (c == num)
+          for (c = num - 1; avail[c] <= 0.; c--);
+
+        k     = node->num_children;
+        child = nr_node_child(node, c, factor * w[c]);
+        if (node->num_children > k) {
+          /* candidate taken for the first time */
+          fresh   = child;
+          weight  = child->weight;
+        }
+
+        node = child;
+
+        if (depth == mem->max_path) {
+          mem->max_path *= 2;
+          mem->path     = (struct nr_node **)vrna_realloc(mem->path,
+                                                          sizeof(struct nr_node *) * mem->max_path);
+        }
+
+        mem->path[depth++] = node;
+      }
+
+      nr_apply(fc, &segment, c, table, pstruc, stack, &top);
+    }
+
+    if (failed)
+      continue;
+
+    if (fresh) {
+      /* store the remaining decisions of the new structure */
+      if (tail_length > 0) {
+        fresh->tail         = (unsigned int *)vrna_alloc(sizeof(unsigned int) * tail_length);
+        fresh->tail_length  = tail_length;
+        memcpy(fresh->tail, mem->tail, sizeof(unsigned int) * tail_length);
+      }
+    } else {
+      /* no new decision was taken, e.g. for an ensemble of a single structure */
+      weight = node->weight - node->removed;
+      if (weight <= node->weight * NR_EPSILON) {
+        /* rounding errors lead us to a structure drawn before, exclude it and restart */
+        for (k = 0; k < depth; k++)
+          mem->path[k]->removed += weight;
+
+        failed = 1;
+        continue;
+      }
+    }
+
+    /* remove the new structure from the ensemble */
+    for (k = 0; k < depth; k++)
+      mem->path[k]->removed += weight;
+
+    break;
+  }
+
+  if ((failed) || (attempt == NR_MAX_RETRIES)) {
+    free(pstruc);
+    return NULL;
+  }
+
+  return pstruc;
+}
+
+
+/* Boltzmann weight of the unpaired 3' end j of the exterior loop [1,j] */
+PRIVATE INLINE FLT_OR_DBL
+nr_ext_up_weight(vrna_fold_compound_t *fc,
+                 int                  j)
+{
+  FLT_OR_DBL  q_temp;
+  vrna_sc_t   *sc;
+
+  if (!fc->hc->up_ext[j])
+    return 0.;
+
+  sc      = fc->sc;
+  q_temp  = fc->exp_matrices->q1k[j - 1] * fc->exp_matrices->scale[1];
+
+  if (sc) {
+    if (sc->exp_energy_up)
+      q_temp *= sc->exp_energy_up[j][1];
+
+    if (sc->exp_f)
+      q_temp *= sc->exp_f(1, j, 1, j - 1, VRNA_DECOMP_EXT_EXT, sc->data);
+  }
+
+  return q_temp;
+}
+
+
+/* Boltzmann weight of the unpaired stretch [i,k-1] in a multiloop */
+PRIVATE INLINE FLT_OR_DBL
+nr_ml_up_weight(vrna_fold_compound_t  *fc,
+                int                   i,
+                int                   k)
+{
+  int         u;
+  FLT_OR_DBL  q_temp;
+  vrna_sc_t   *sc;
+
+  u = k - i;
+
+  if (fc->hc->up_ml[i] < u)
+    return 0.;
+
+  sc      = fc->sc;
+  q_temp  = fc->exp_matrices->expMLbase[u];
+
+  if (sc) {
+    if (sc->exp_energy_up)
+      q_temp *= sc->exp_energy_up[i][u];
+
+    if (sc->exp_f)
+      q_temp *= sc->exp_f(i, k - 1, i, k - 1, VRNA_DECOMP_ML_UP, sc->data);
+  }
+
+  return q_temp;
+}
+
+
+/*
+ * Boltzmann weights of all decomposition candidates of a pending
+ * subsegment in the order of the regular stochastic backtracking.
+ * For BT_EXT, candidate 0 denotes an unpaired 3' end and candidate
+ * c > 0 the table entry c - 1. For BT_QM_UP, candidate 0 denotes the
+ * unpaired stretch and candidate 1 the remaining multiloop segment
+ */
+PRIVATE unsigned int
+nr_candidates(vrna_fold_compound_t    *fc,
+              struct vrna_nr_memory_s *mem,
+              struct nr_segment       *segment,
+              struct bt_table         **table)
+{
+  int           i, j;
+  unsigned int  c, offset;
+  FLT_OR_DBL    prev, *w;
+
+  i       = segment->i;
+  j       = segment->j;
+  w       = mem->w;
+  offset  = 0;
+  *table  = NULL;
+
+  switch (segment->decomp) {
+    case BT_EXT:
+      /* no more pairs */
+      if (j <= fc->exp_params->model_details.min_loop_size + 1)
+        return 0;
+
+      w[0]    = nr_ext_up_weight(fc, j);
+      offset  = 1;
+      break;
+
+    case BT_QM_UP:
+      w[0]  = nr_ml_up_weight(fc, i, j);
+      w[1]  = fc->exp_matrices->qm[fc->iindx[i] - (j - 1)];
+      return 2;
+
+    default:
+      break;
+  }
+
+  if (!(*table = bt_table_get(fc, segment->decomp, i, j))) {
+    *table = mem->table;
+    bt_table_fill(fc, segment->decomp, i, j, *table, -1.);
+  }
+
+  for (prev = 0., c = 0; c < (*table)->num; c++) {
+    w[offset + c] = (*table)->entries[c].cum - prev;
+    prev          = (*table)->entries[c].cum;
+  }
+
+  return offset + (*table)->num;
+}
+
+
+/*
+ * draw a decomposition candidate of a pending subsegment without
+ * previous samples, and scale weight by its probability. Unless the
+ * candidates are cached, the enumeration stops with the candidate drawn.
+ * Returns 0 if there is nothing to decide
+ */
+PRIVATE int
+nr_draw(vrna_fold_compound_t    *fc,
+        struct vrna_nr_memory_s *mem,
+        struct nr_segment       *segment,
+        struct bt_table         **table,
+        unsigned int            *c,
+        FLT_OR_DBL              *weight)
+{
+  int             i, j;
+  unsigned int    k;
+  FLT_OR_DBL      total, r, w_up, w_c;
+  struct bt_entry *entry;
+
+  i       = segment->i;
+  j       = segment->j;
+  w_up    = 0.;
+  *table  = NULL;
+
+  switch (segment->decomp) {
+    case BT_EXT:
+      if (j <= fc->exp_params->model_details.min_loop_size + 1)
+        return 0;
+
+      w_up  = nr_ext_up_weight(fc, j);
+      total = fc->exp_matrices->q1k[j];
+      break;
+
+    case BT_QM_UP:
+      w_up  = nr_ml_up_weight(fc, i, j);
+      w_c   = fc->exp_matrices->qm[fc->iindx[i] - (j - 1)];
+      total = w_up + w_c;
+      r     = sample_urn(fc) * total;
+      if ((w_up > 0.) && (w_up >= r)) {
+        *c  = 0;
+        w_c = w_up;
+      } else {
+        *c = 1;
+      }
+
+      *weight *= w_c / total;
+      return 1;
+
+    case BT_QB:
+      total = fc->exp_matrices->qb[fc->iindx[i] - j];
+      break;
+
+    case BT_QM:
+      total = fc->exp_matrices->qm[fc->iindx[i] - j];
+      break;
+
+    case BT_QM1:
+      total = fc->exp_matrices->qm1[fc->jindx[j] + i];
+      break;
+
+    default:
+      return 0;
+  }
+
+  r = sample_urn(fc) * total;
+
+  if ((w_up > 0.) && (w_up >= r)) {
+    /* unpaired 3' end of the exterior loop */
+    *c      = 0;
+    *weight *= w_up / total;
+    return 1;
+  }
+
+  r -= w_up;
+
+  if ((*table = bt_table_get(fc, segment->decomp, i, j))) {
+    entry = bt_table_search(*table, r, 0);
+    k     = (entry) ? (unsigned int)(entry - (*table)->entries) : (*table)->num - 1;
+  } else {
+    *table = mem->table;
+    bt_table_fill(fc, segment->decomp, i, j, *table, r);
+    k = (*table)->num - 1;
+  }
+
+  if ((*table)->num == 0) {
+    /* rounding errors beyond the unpaired 3' end */
+    if (w_up <= 0.)
+      vrna_message_error("backtracking failed in non-redundant sampling");
+
+    *c      = 0;
+    *weight *= w_up / total;
+    return 1;
+  }
+
+  /* avoid candidates without contribution, e.g. for r = 0 or rounding errors beyond the last one */
+  while ((k + 1 < (*table)->num) && (bt_entry_weight(*table, k) <= 0.))
+    k++;
+
+  while ((k > 0) && (bt_entry_weight(*table, k) <= 0.))
+    k--;
+
+  w_c = bt_entry_weight(*table, k);
+
+  if (w_c <= 0.)
+    vrna_message_error("backtracking failed in non-redundant sampling");
+
+  *c      = (segment->decomp == BT_EXT) ? k + 1 : k;
+  *weight *= w_c / total;
+
+  return 1;
+}
+
+
+/* push the subsegments that result from candidate c onto the stack */
+PRIVATE void
+nr_apply(vrna_fold_compound_t *fc,
+         struct nr_segment    *segment,
+         unsigned int         c,
+         struct bt_table      *table,
+         char                 *pstruc,
+         struct nr_segment    *stack,
+         int                  *top)
+{
+  int             i, j, turn;
+  struct bt_entry *entry;
+
+  i     = segment->i;
+  j     = segment->j;
+  turn  = fc->exp_params->model_details.min_loop_size;
+
+#define NR_PUSH(d, a, b)  do { \
+    stack[*top].decomp  = (d); \
+    stack[*top].i       = (a); \
+    stack[*top].j       = (b); \
+    (*top)++; \
+} while (0)
+
+  switch (segment->decomp) {
+    case BT_EXT:
+      if (c == 0) {
+        NR_PUSH(BT_EXT, 1, j - 1);
+      } else {
+        entry = &(table->entries[c - 1]);
+        NR_PUSH(BT_EXT, 1, entry->k - 1);
+        NR_PUSH(BT_QB, entry->k, j);
+      }
+
+      break;
+
+    case BT_QB:
+      pstruc[i - 1] = '(';
+      pstruc[j - 1] = ')';
+      entry         = &(table->entries[c]);
+      if (entry->k == 0) {
+        /* hairpin */
+      } else if (entry->l > 0) {
+        NR_PUSH(BT_QB, entry->k, entry->l);
+      } else {
+        NR_PUSH(BT_QM, i + 1, entry->k - 1);
+        NR_PUSH(BT_QM1, entry->k, j - 1);
+      }
+
+      break;
+
+    case BT_QM:
+      entry = &(table->entries[c]);
+      if (entry->k >= i + turn)
+        NR_PUSH(BT_QM_UP, i, entry->k);
+
+      NR_PUSH(BT_QM1, entry->k, j);
+      break;
+
+    case BT_QM1:
+      NR_PUSH(BT_QB, i, table->entries[c].k);
+      break;
+
+    case BT_QM_UP:
+      if (c == 1)
+        NR_PUSH(BT_QM, i, j - 1);
+
+      break;
+
+    default:
+      break;
+  }
+
+#undef NR_PUSH
+}
+
+
+PRIVATE struct nr_node *
+nr_node_new(unsigned int  idx,
+            FLT_OR_DBL    weight)
+{
+  struct nr_node *node;
+
+  node          = (struct nr_node *)vrna_alloc(sizeof(struct nr_node));
+  node->idx     = idx;
+  node->weight  = weight;
+
+  return node;
+}
+
+
+/* get the child of node for candidate idx, and add it if necessary */
+PRIVATE struct nr_node *
+nr_node_child(struct nr_node  *node,
+              unsigned int    idx,
+              FLT_OR_DBL      weight)
+{
+  unsigned int  lo, hi, mid;
+
+  lo  = 0;
+  hi  = node->num_children;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (node->children[mid]->idx < idx)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if ((lo < node->num_children) && (node->children[lo]->idx == idx))
+    return node->children[lo];
+
+  if (node->num_children == node->size_children) {
+    node->size_children = (node->size_children) ? 2 * node->size_children : 2;
+    node->children      = (struct nr_node **)vrna_realloc(node->children,
+                                                          sizeof(struct nr_node *) *
+                                                          node->size_children);
+  }
+
+  memmove(node->children + lo + 1,
+          node->children + lo,
+          sizeof(struct nr_node *) * (node->num_children - lo));
+
+  node->children[lo] = nr_node_new(idx, weight);
+  node->num_children++;
+
+  return node->children[lo];
+}
+
+
+PRIVATE void
+nr_node_free(struct nr_node *node)
+{
+  unsigned int k;
+
+  if (node) {
+    for (k = 0; k < node->num_children; k++)
+      nr_node_free(node->children[k]);
+
+    free(node->children);
+    free(node->tail);
+    free(node);
+  }
+}
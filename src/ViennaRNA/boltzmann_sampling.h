@@ -1,6 +1,8 @@
 #ifndef VIENNA_RNA_PACKAGE_BOLTZMANN_SAMPLING_H
 #define VIENNA_RNA_PACKAGE_BOLTZMANN_SAMPLING_H
 
+#include <stddef.h>
+
 #include <ViennaRNA/datastructures/basic.h>
 
 /**
@@ -19,6 +21,58 @@
  *          equilibrium probability
  */
 
+/**
+ *  @brief  Callback for Boltzmann sampling
+ *
+ *  This function will be called for each secondary structure that has been sampled by
+ *  vrna_pbacktrack_cb(). Structures are passed in the order they have been drawn, and
+ *  all calls are made from the thread that called vrna_pbacktrack_cb().
+ *
+ *  @see vrna_pbacktrack_cb(), #VRNA_PBACKTRACK_PACKED
+ *
+ *  @param structure  The secondary structure in dot-bracket notation (or packed, see #VRNA_PBACKTRACK_PACKED)
+ *  @param data       Some arbitrary, auxiliary data address as provided to the calling function
+ */
+typedef void (vrna_boltzmann_sampling_callback)(const char  *structure,
+                                                void        *data);
+
+/**
+ *  @brief  Boltzmann sampling option flag indicating default settings
+ *
+ *  @see vrna_pbacktrack_num(), vrna_pbacktrack_cb(), vrna_pbacktrack_num_pt()
+ */
+#define VRNA_PBACKTRACK_DEFAULT   0U
+
+/**
+ *  @brief  Boltzmann sampling option flag to emit packed structures
+ *
+ *  Sampled structures are compressed with vrna_db_pack() to about a fifth of the size
+ *  of their dot-bracket representation. Use vrna_db_unpack() to restore them.
+ *
+ *  @see vrna_pbacktrack_num(), vrna_pbacktrack_cb(), vrna_db_pack(), vrna_db_unpack()
+ */
+#define VRNA_PBACKTRACK_PACKED    1U
+
+/**
+ *  @brief  Boltzmann sampling option flag to draw non-redundant samples
+ *
+ *  Each structure is drawn at most once. The samples are drawn sequentially from
+ *  the remaining ensemble, see vrna_pbacktrack_nr() for details. Fewer structures
+ *  are returned if the ensemble has been exhausted before.
+ *
+ *  @see vrna_pbacktrack_num(), vrna_pbacktrack_cb(), vrna_pbacktrack_num_pt(), vrna_pbacktrack_nr()
+ */
+#define VRNA_PBACKTRACK_NON_REDUNDANT   2U
+
+
+/**
+ *  @brief  Memory of the structures drawn by non-redundant Boltzmann sampling
+ *
+ *  @see vrna_pbacktrack_nr(), vrna_pbacktrack_mem_free()
+ */
+typedef struct vrna_nr_memory_s *vrna_pbacktrack_mem_t;
+
+
 /**
  *  @brief Sample a secondary structure of a subsequence from the Boltzmann ensemble according its probability
  *
@@ -49,12 +103,189 @@ char *vrna_pbacktrack5(vrna_fold_compound_t *vc,
  *  @note The function will automagically detect cicular RNAs based on the model_details in exp_params as
  *        provided via the #vrna_fold_compound_t
  *
+ *  @note Random numbers are drawn from the generator state attached with vrna_fold_compound_add_rng(),
+ *        or from the process-wide generator behind vrna_urn() if there is none. To sample concurrently
+ *        and reproducibly from multiple threads, attach a separate state (see vrna_rng_split()) to
+ *        the fold compound of each thread.
+ *
+ *  @see vrna_fold_compound_add_rng()
+ *
  *  @param  vc      The fold compound data structure
  *  @return         A sampled secondary structure in dot-bracket notation (or NULL on error)
  */
 char *vrna_pbacktrack(vrna_fold_compound_t *vc);
 
 
+/**
+ *  @brief Sample multiple secondary structures (consensus structures) from the Boltzmann ensemble
+ *
+ *  Draws @p num_samples structures at once. Arguments and DP matrices are validated only once,
+ *  and the samples are distributed among all available OpenMP threads that concurrently read the
+ *  partition function matrices of @p fc.
+ *
+ *  Each consecutive block of samples is drawn from its own random number stream that is split
+ *  off the generator attached with vrna_fold_compound_add_rng(), or from a generator seeded by
+ *  vrna_urn() if there is none. Hence, the samples are reproducible and do not depend on the
+ *  number of threads.
+ *
+ *  @pre    Unique multiloop decomposition has to be active upon creation of @p fc with vrna_fold_compound()
+ *          or similar. This can be done easily by passing vrna_fold_compound() a model details parameter
+ *          with vrna_md_t.uniq_ML = 1.
+ *  @pre    vrna_pf() has to be called first to fill the partition function matrices
+ *
+ *  With #VRNA_PBACKTRACK_NON_REDUNDANT, the samples are drawn sequentially instead, and each
+ *  structure is returned at most once.
+ *
+ *  @see vrna_pbacktrack(), vrna_pbacktrack_cb(), vrna_pbacktrack_num_pt(), #VRNA_PBACKTRACK_PACKED,
+ *       #VRNA_PBACKTRACK_NON_REDUNDANT
+ *
+ *  @param  fc            The fold compound data structure
+ *  @param  num_samples   The number of samples to draw
+ *  @param  options       A bitwise OR-flag indicating the output format
+ *  @return               A NULL terminated list of sampled secondary structures (or NULL on error)
+ */
+char **vrna_pbacktrack_num(vrna_fold_compound_t *fc,
+                           unsigned int         num_samples,
+                           unsigned int         options);
+
+
+/**
+ *  @brief Sample multiple secondary structures (consensus structures) from the Boltzmann ensemble and
+ *         pass them to a callback
+ *
+ *  Same as vrna_pbacktrack_num() but streams the samples to the callback @p cb instead of keeping them
+ *  all in memory.
+ *
+ *  @see vrna_pbacktrack_num(), vrna_boltzmann_sampling_callback(), #VRNA_PBACKTRACK_PACKED
+ *
+ *  @param  fc            The fold compound data structure
+ *  @param  num_samples   The number of samples to draw
+ *  @param  cb            The callback that receives the sampled structures
+ *  @param  data          A data structure passed through to the callback @p cb
+ *  @param  options       A bitwise OR-flag indicating the output format
+ *  @return               The number of structures passed to @p cb
+ */
+unsigned int vrna_pbacktrack_cb(vrna_fold_compound_t             *fc,
+                                unsigned int                     num_samples,
+                                vrna_boltzmann_sampling_callback *cb,
+                                void                             *data,
+                                unsigned int                     options);
+
+
+/**
+ *  @brief Sample multiple secondary structures (consensus structures) from the Boltzmann ensemble as
+ *         pair tables
+ *
+ *  Same as vrna_pbacktrack_num() but returns the samples as pair tables (see vrna_ptable()), which
+ *  saves their conversion from the dot-bracket notation for subsequent ensemble statistics.
+ *
+ *  @see vrna_pbacktrack_num(), vrna_ptable()
+ *
+ *  @param  fc            The fold compound data structure
+ *  @param  num_samples   The number of samples to draw
+ *  @param  options       A bitwise OR-flag, either #VRNA_PBACKTRACK_DEFAULT or #VRNA_PBACKTRACK_NON_REDUNDANT
+ *  @return               A NULL terminated list of pair tables (or NULL on error)
+ */
+short **vrna_pbacktrack_num_pt(vrna_fold_compound_t  *fc,
+                               unsigned int          num_samples,
+                               unsigned int          options);
+
+
+/**
+ *  @brief Sample a secondary structure that has not been drawn before from the Boltzmann ensemble
+ *
+ *  Non-redundant stochastic backtracking keeps all decisions taken so far in a prefix tree,
+ *  together with the Boltzmann probability of the structures already emitted below each of
+ *  them. Subsequent draws remove this probability from the respective decomposition
+ *  candidates, such that each call yields a new structure with a probability proportional to
+ *  its Boltzmann weight among the structures not yet drawn.
+ *
+ *  Pass the address of a #vrna_pbacktrack_mem_t initialized to NULL with the first call. The
+ *  memory is created on demand, and has to be released with vrna_pbacktrack_mem_free() once
+ *  sampling is done. It is only valid as long as the partition function matrices of @p fc do
+ *  not change.
+ *
+ *  Decisions along previously drawn structures require the weights of all their candidates.
+ *  Thus, the cache of vrna_pbacktrack_cache_init() is activated without memory limit upon
+ *  creation of the memory, unless a cache is already active.
+ *
+ *  @pre    Unique multiloop decomposition has to be active upon creation of @p fc with vrna_fold_compound()
+ *          or similar. This can be done easily by passing vrna_fold_compound() a model details parameter
+ *          with vrna_md_t.uniq_ML = 1.
+ *  @pre    vrna_pf() has to be called first to fill the partition function matrices
+ *
+ *  @note Only single sequences with linear (non-circular) RNAs are supported.
+ *
+ *  @see vrna_pbacktrack_mem_free(), vrna_pbacktrack(), vrna_pbacktrack_cache_init(),
+ *       #VRNA_PBACKTRACK_NON_REDUNDANT
+ *
+ *  @param  fc      The fold compound data structure
+ *  @param  nr_mem  The address of the memory of previously drawn structures
+ *  @return         A sampled secondary structure in dot-bracket notation (or NULL if the
+ *                  ensemble is exhausted or on error)
+ */
+char *vrna_pbacktrack_nr(vrna_fold_compound_t   *fc,
+                         vrna_pbacktrack_mem_t  *nr_mem);
+
+
+/**
+ *  @brief  Release the memory of non-redundant Boltzmann sampling
+ *
+ *  @see vrna_pbacktrack_nr()
+ *
+ *  @param  nr_mem  The memory of previously drawn structures
+ */
+void vrna_pbacktrack_mem_free(vrna_pbacktrack_mem_t nr_mem);
+
+
+/**
+ *  @brief  Memoize the decompositions of stochastic backtracking
+ *
+ *  Each step of stochastic backtracking draws a random number and scans the possible
+ *  decompositions of the current subsegment until their accumulated Boltzmann weights
+ *  exceed it. Once this cache is active, the cumulative weights of each subsegment are
+ *  stored upon its first visit, and subsequent visits only perform a binary search.
+ *  This considerably speeds up drawing large numbers of samples at the cost of memory.
+ *  Samples are identical to those drawn without the cache.
+ *
+ *  Tables are only added as long as the total memory stays below @p max_memory. Beyond
+ *  that, the remaining subsegments are scanned as usual. The cache is part of the
+ *  partition function DP matrices. vrna_pf() empties it, and it is free'd together
+ *  with the matrices.
+ *
+ *  @note Only single sequences with linear (non-circular) RNAs benefit from the cache.
+ *
+ *  @see vrna_pbacktrack_cache_clear(), vrna_pbacktrack_cache_free(), vrna_pbacktrack(),
+ *       vrna_pbacktrack_num()
+ *
+ *  @param  fc          The fold compound data structure with partition function matrices
+ *  @param  max_memory  The maximum memory in bytes to use for the cache (0 for no limit)
+ *  @return             Non-zero if the cache has been activated, 0 otherwise
+ */
+int vrna_pbacktrack_cache_init(vrna_fold_compound_t  *fc,
+                               size_t                max_memory);
+
+
+/**
+ *  @brief  Discard all memoized decompositions but keep the cache active
+ *
+ *  @see vrna_pbacktrack_cache_init()
+ *
+ *  @param  fc  The fold compound data structure
+ */
+void vrna_pbacktrack_cache_clear(vrna_fold_compound_t *fc);
+
+
+/**
+ *  @brief  Deactivate and free the cache of memoized decompositions
+ *
+ *  @see vrna_pbacktrack_cache_init()
+ *
+ *  @param  fc  The fold compound data structure
+ */
+void vrna_pbacktrack_cache_free(vrna_fold_compound_t *fc);
+
+
 /**@}*/
 
 
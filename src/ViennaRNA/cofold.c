@@ -33,16 +33,20 @@
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/cofold.h"
 
-#ifndef VRNA_DISABLE_BACKWARD_COMPATIBILITY
-
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
 #endif
 
 #define MAXSECTORS        500     /* dimension for a backtrack array */
 
+#include "mfe_aux_arrays.inc"
+
 /*
  #################################
  # GLOBAL VARIABLES              #
@@ -61,12 +65,13 @@
 /* some backward compatibility stuff */
 PRIVATE int                   backward_compat           = 0;
 PRIVATE vrna_fold_compound_t  *backward_compat_compound = NULL;
+PRIVATE int                   *backward_compat_ggg      = NULL; /* dense G-quadruplex matrix for export_cofold_arrays_gq() */
 
 PRIVATE float                 mfe1, mfe2; /* minimum free energies of the monomers */
 
 #ifdef _OPENMP
 
-#pragma omp threadprivate(mfe1, mfe2, backward_compat_compound, backward_compat)
+#pragma omp threadprivate(mfe1, mfe2, backward_compat_compound, backward_compat, backward_compat_ggg)
 
 #endif
 
@@ -87,6 +92,12 @@ PRIVATE int   fill_arrays(vrna_fold_compound_t  *vc,
                           int                   zuker);
 
 
+PRIVATE INLINE void fill_cell(vrna_fold_compound_t  *vc,
+                              int                   i,
+                              int                   j,
+                              struct aux_arrays     *aux);
+
+
 PRIVATE void  free_end(int                  *array,
                        int                  i,
                        int                  start,
@@ -183,62 +194,49 @@ fill_arrays(vrna_fold_compound_t  *vc,
 {
   /* fill "c", "fML" and "f5" arrays and return  optimal energy */
 
-  unsigned int  strands, *sn, *ss, *se;
-  int           i, j, length, energy;
-  int           uniq_ML;
-  int           no_close, type, maxj, *indx;
-  int           *my_f5, *my_c, *my_fML, *my_fM1, *my_fc;
-  int           *cc, *cc1;  /* auxilary arrays for canonical structures     */
-  int           *Fmi;       /* holds row i of fML (avoids jumps in memory)  */
-  int           *DMLi;      /* DMLi[j] holds  MIN(fML[i,k]+fML[k+1,j])      */
-  int           *DMLi1;     /*                MIN(fML[i+1,k]+fML[k+1,j])    */
-  int           *DMLi2;     /*                MIN(fML[i+2,k]+fML[k+1,j])    */
-
-  int           dangle_model, noGUclosure, noLP, hc_decompose, turn;
-  char          *ptype;
-  unsigned char *hard_constraints;
-  vrna_param_t  *P;
-  vrna_mx_mfe_t *matrices;
-  vrna_hc_t     *hc;
-
-  length            = (int)vc->length;
-  ptype             = vc->ptype;
-  indx              = vc->jindx;
-  P                 = vc->params;
-  dangle_model      = P->model_details.dangles;
-  noGUclosure       = P->model_details.noGUclosure;
-  noLP              = P->model_details.noLP;
-  uniq_ML           = P->model_details.uniq_ML;
-  strands           = vc->strands;
-  sn                = vc->strand_number;
-  ss                = vc->strand_start;
-  se                = vc->strand_end;
-  hc                = vc->hc;
-  hard_constraints  = hc->matrix;
-  matrices          = vc->matrices;
-  my_f5             = matrices->f5;
-  my_c              = matrices->c;
-  my_fML            = matrices->fML;
-  my_fM1            = matrices->fM1;
-  my_fc             = matrices->fc;
-  turn              = P->model_details.min_loop_size;
-
-  /* allocate memory for all helper arrays */
-  cc    = (int *)vrna_alloc(sizeof(int) * (length + 2));
-  cc1   = (int *)vrna_alloc(sizeof(int) * (length + 2));
-  Fmi   = (int *)vrna_alloc(sizeof(int) * (length + 1));
-  DMLi  = (int *)vrna_alloc(sizeof(int) * (length + 1));
-  DMLi1 = (int *)vrna_alloc(sizeof(int) * (length + 1));
-  DMLi2 = (int *)vrna_alloc(sizeof(int) * (length + 1));
-
+  unsigned int      strands, *ss, *se;
+  int               i, j, d, length, energy;
+  int               uniq_ML;
+  int               maxj, *indx;
+  int               *my_f5, *my_c, *my_fML, *my_fM1, *my_fc;
+  int               turn;
+  vrna_param_t      *P;
+  vrna_mx_mfe_t     *matrices;
+  struct aux_arrays *helper_arrays;
+
+  length    = (int)vc->length;
+  indx      = vc->jindx;
+  P         = vc->params;
+  uniq_ML   = P->model_details.uniq_ML;
+  strands   = vc->strands;
+  ss        = vc->strand_start;
+  se        = vc->strand_end;
+  matrices  = vc->matrices;
+  my_f5     = matrices->f5;
+  my_c      = matrices->c;
+  my_fML    = matrices->fML;
+  my_fM1    = matrices->fM1;
+  my_fc     = matrices->fc;
+  turn      = P->model_details.min_loop_size;
+
+  /*
+   *  allocate memory for all helper arrays, the zuker suboptimals
+   *  restrict j for each row and therefore always fill row-wise
+   */
+  helper_arrays = get_aux_arrays(length,
+                                 ((zuker) || (!P->model_details.wavefront)) ?
+                                 AUX_ROWWISE : AUX_WAVEFRONT,
+                                 P->model_details.noLP);
+
+  helper_arrays->il = vrna_E_int_loop_fast_init(vc);
+  helper_arrays->hp = vrna_E_hp_loop_fast_init(vc);
+  helper_arrays->ml = vrna_E_ml_fast_init(vc);
 
   /* hard code min_loop_size to 0, since we can not be sure yet that this is already the case */
   turn = 0;
 
-  for (j = 1; j <= length; j++) {
-    Fmi[j]    = DMLi[j] = DMLi1[j] = DMLi2[j] = INF;
-    my_fc[j]  = 0;
-  }
+  for (j = 1; j <= length; j++)
+    my_fc[j] = 0;
 
   for (j = 1; j <= length; j++)
     for (i = 1; i <= j; i++) {
@@ -247,90 +245,54 @@ fill_arrays(vrna_fold_compound_t  *vc,
         my_fM1[indx[j] + i] = INF;
     }
 
-  for (i = length - turn - 1; i >= 1; i--) {
-    /* i,j in [1..length] */
-
-    maxj = (zuker) ? (MIN2(i + se[0], length)) : length;
-    for (j = i + turn + 1; j <= maxj; j++) {
-      int ij;
-      ij            = indx[j] + i;
-      type          = vrna_get_ptype(ij, ptype);
-      hc_decompose  = hard_constraints[ij];
-      energy        = INF;
-
-      no_close = (((type == 3) || (type == 4)) && noGUclosure);
-
-      if (hc_decompose) {
-        /* we have a pair */
-        int new_c = INF;
-
-        if (!no_close) {
-          /* check for hairpin loop */
-          energy  = vrna_E_hp_loop(vc, i, j);
-          new_c   = MIN2(new_c, energy);
-
-          /* check for multibranch loops */
-          energy  = vrna_E_mb_loop_fast(vc, i, j, DMLi1, DMLi2);
-          new_c   = MIN2(new_c, energy);
-        }
+  if (helper_arrays->mode == AUX_WAVEFRONT) {
+    /*
+     *  process all cells of an anti-diagonal with span d = j - i in parallel.
+     *  Pairs (i, j) that span the strand nick require the free ends fc[i + 1]
+     *  and fc[j - 1], i.e. the free ends with a span of at most d - 2 from the
+     *  nick. Hence, we extend the free ends by one nucleotide each after
+     *  finishing an anti-diagonal
+     */
+    free_end(my_fc, se[0], se[0], vc);
+    if (strands > 1)
+      free_end(my_fc, ss[1], ss[1], vc);
 
-        if (dangle_model == 3) {
-          /* coaxial stacking */
-          energy  = vrna_E_mb_loop_stack(vc, i, j);
-          new_c   = MIN2(new_c, energy);
-        }
+#ifdef _OPENMP
+#pragma omp parallel private(d, i)
+#endif
+    for (d = turn + 1; d < length; d++) {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i = 1; i <= length - d; i++)
+        fill_cell(vc, i, i + d, helper_arrays);
 
-        /* check for interior loops */
-        energy  = vrna_E_int_loop(vc, i, j);
-        new_c   = MIN2(new_c, energy);
-
-        /* remember stack energy for --noLP option */
-        if (noLP) {
-          if ((sn[i] == sn[i + 1]) && (sn[j - 1] == sn[j])) {
-            int stackEnergy = vrna_E_stack(vc, i, j);
-            new_c     = MIN2(new_c, cc1[j - 1] + stackEnergy);
-            my_c[ij]  = cc1[j - 1] + stackEnergy;
-          } else {
-            /* currently we don't allow stacking over the cut point */
-            my_c[ij] = FORBIDDEN;
-          }
+#ifdef _OPENMP
+#pragma omp single
+#endif
+      {
+        if ((int)se[0] - d >= 1)
+          free_end(my_fc, se[0] - d, se[0], vc);
 
-          cc[j] = new_c;
-        } else {
-          my_c[ij] = new_c;
-        }
-      } /* end >> if (pair) << */
-      else {
-        my_c[ij] = INF;
+        if ((strands > 1) && ((int)ss[1] + d <= length))
+          free_end(my_fc, ss[1] + d, ss[1], vc);
       }
+    }
+  } else {
+    for (i = length - turn - 1; i >= 1; i--) {
+      /* i,j in [1..length] */
+      reset_aux_arrays(helper_arrays, i, length);
 
-      /* done with c[i,j], now compute fML[i,j] */
-      /* free ends ? -----------------------------------------*/
-
-      my_fML[ij] = vrna_E_ml_stems_fast(vc, i, j, Fmi, DMLi);
+      maxj = (zuker) ? (MIN2(i + se[0], length)) : length;
+      for (j = i + turn + 1; j <= maxj; j++)
+        fill_cell(vc, i, j, helper_arrays);
 
-      if (uniq_ML)   /* compute fM1 for unique decomposition */
-        my_fM1[ij] = E_ml_rightmost_stem(i, j, vc);
-    }
+      if (i == se[0] + 1)
+        for (j = i; j <= maxj; j++)
+          free_end(my_fc, j, ss[1], vc);
 
-    if (i == se[0] + 1)
-      for (j = i; j <= maxj; j++)
-        free_end(my_fc, j, ss[1], vc);
-
-    if (i <= se[0])
-      free_end(my_fc, i, se[0], vc);
-
-    {
-      int *FF; /* rotate the auxilliary arrays */
-      FF    = DMLi2;
-      DMLi2 = DMLi1;
-      DMLi1 = DMLi;
-      DMLi  = FF;
-      FF    = cc1;
-      cc1   = cc;
-      cc    = FF;
-      for (j = 1; j <= maxj; j++)
-        cc[j] = Fmi[j] = DMLi[j] = INF;
+      if (i <= se[0])
+        free_end(my_fc, i, se[0], vc);
     }
   }
 
@@ -352,17 +314,95 @@ fill_arrays(vrna_fold_compound_t  *vc,
     mfe1 = mfe2 = energy;
 
   /* clean up memory */
-  free(cc);
-  free(cc1);
-  free(Fmi);
-  free(DMLi);
-  free(DMLi1);
-  free(DMLi2);
+  free_aux_arrays(helper_arrays);
 
   return energy;
 }
 
 
+PRIVATE INLINE void
+fill_cell(vrna_fold_compound_t  *vc,
+          int                   i,
+          int                   j,
+          struct aux_arrays     *aux)
+{
+  unsigned int    *sn;
+  int             ij, type, energy, new_c, stackEnergy, no_close, dangle_model, noGUclosure,
+                  noLP, *my_c, *cc, *cc1;
+  vrna_md_t       *md;
+  struct aux_cell cell;
+
+  sn            = vc->strand_number;
+  md            = &(vc->params->model_details);
+  dangle_model  = md->dangles;
+  noGUclosure   = md->noGUclosure;
+  noLP          = md->noLP;
+  my_c          = vc->matrices->c;
+  ij            = vc->jindx[j] + i;
+  type          = vrna_get_ptype(ij, vc->ptype);
+  no_close      = (((type == 3) || (type == 4)) && noGUclosure);
+
+  get_aux_cell(vc, aux, i, j, &cell);
+
+  if (vc->hc->matrix[ij]) {
+    /* we have a pair */
+    new_c = INF;
+
+    if (!no_close) {
+      /* check for hairpin loop */
+      energy  = vrna_E_hp_loop_fast(vc, i, j, aux->hp);
+      new_c   = MIN2(new_c, energy);
+
+      /* check for multibranch loops */
+      energy  = vrna_E_mb_loop_fast_aux(vc, i, j, cell.DMLi1, cell.DMLi2, aux->ml);
+      new_c = MIN2(new_c, energy);
+    }
+
+    if (dangle_model == 3) {
+      /* coaxial stacking */
+      energy  = vrna_E_mb_loop_stack(vc, i, j);
+      new_c   = MIN2(new_c, energy);
+    }
+
+    /* check for interior loops */
+    energy  = vrna_E_int_loop_fast(vc, i, j, aux->il);
+    new_c   = MIN2(new_c, energy);
+
+    /* remember stack energy for --noLP option */
+    if (noLP) {
+      cc  = cell.cc;
+      cc1 = cell.cc1;
+
+      if ((sn[i] == sn[i + 1]) && (sn[j - 1] == sn[j])) {
+        stackEnergy = vrna_E_stack(vc, i, j);
+        new_c       = MIN2(new_c, cc1[j - 1] + stackEnergy);
+        my_c[ij]    = cc1[j - 1] + stackEnergy;
+      } else {
+        /* currently we don't allow stacking over the cut point */
+        my_c[ij] = FORBIDDEN;
+      }
+
+      cc[j] = new_c;
+    } else {
+      my_c[ij] = new_c;
+    }
+  } /* end >> if (pair) << */
+  else {
+    my_c[ij] = INF;
+  }
+
+  /* done with c[i,j], now compute fML[i,j] */
+  /* free ends ? -----------------------------------------*/
+
+  vc->matrices->fML[ij] = vrna_E_ml_stems_fast_aux(vc, i, j, cell.Fmi, cell.DMLi, aux->ml);
+
+  store_aux_cell(aux, i, j, &cell);
+
+  if (md->uniq_ML)   /* compute fM1 for unique decomposition */
+    vc->matrices->fM1[ij] = vrna_E_ml_rightmost_stem_aux(vc, i, j, aux->ml);
+}
+
+
 PRIVATE void
 backtrack_co(sect                 bt_stack[],
              vrna_bp_stack_t      *bp_list,
@@ -555,16 +595,17 @@ free_end(int                  *array,
          int                  start,
          vrna_fold_compound_t *vc)
 {
-  unsigned int  *sn;
-  int           inc, type, energy, en, length, j, left, right, dangle_model, with_gquad, *indx,
-                *c, *ggg, turn;
-  vrna_param_t  *P;
-  short         *S1;
-  char          *ptype;
-  unsigned char *hard_constraints;
-  vrna_mx_mfe_t *matrices;
-  vrna_hc_t     *hc;
-  vrna_sc_t     *sc;
+  unsigned int    *sn;
+  int             inc, type, energy, en, length, j, left, right, dangle_model, with_gquad, *indx,
+                  *c, turn;
+  vrna_gquad_mx_t *ggg;
+  vrna_param_t    *P;
+  short           *S1;
+  char            *ptype;
+  unsigned char   *hard_constraints;
+  vrna_mx_mfe_t   *matrices;
+  vrna_hc_t       *hc;
+  vrna_sc_t       *sc;
 
   P                 = vc->params;
   dangle_model      = P->model_details.dangles;
@@ -688,7 +729,7 @@ free_end(int                  *array,
     if (with_gquad) {
       if (sn[ii] == sn[jj])
         if (array[j - inc] != INF)
-          array[i] = MIN2(array[i], array[j - inc] + ggg[indx[jj] + ii]);
+          array[i] = MIN2(array[i], array[j - inc] + gquad_mx_get(ggg, ii, jj));
     }
 
     if (dangle_model % 2 == 1) {
@@ -1237,8 +1278,13 @@ export_cofold_arrays_gq(int   **f5_p,
 {
   /* make the DP arrays available to routines such as subopt() */
   wrap_array_export(f5_p, c_p, fML_p, fM1_p, fc_p, indx_p, ptype_p);
-  if (backward_compat_compound)
-    *ggg_p = backward_compat_compound->matrices->ggg;
+  if (backward_compat_compound) {
+    /* the fold compound only stores a sparse G-quadruplex matrix, so export a dense copy instead */
+    free(backward_compat_ggg);
+    backward_compat_ggg = get_gquad_matrix(backward_compat_compound->sequence_encoding2,
+                                           backward_compat_compound->params);
+    *ggg_p = backward_compat_ggg;
+  }
 }
 
 
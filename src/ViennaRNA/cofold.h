@@ -109,6 +109,7 @@ DEPRECATED(void update_cofold_params_par(vrna_param_t *parameters),
  *  @param  fM1_p   A pointer to the 'M1' array, i.e. array containing best free energy in interval [i,j] for multiloop segment with exactly one stem
  *  @param  fc_p    A pointer to the 'fc' array, i.e. array ...
  *  @param  ggg_p   A pointer to the 'ggg' array, i.e. array containing best free energy of a gquadruplex delimited by [i,j]
+ *                  (a dense copy that remains valid until the next call of this function)
  *  @param  indx_p  A pointer to the indexing array used for accessing the energy matrices
  *  @param  ptype_p A pointer to the ptype array containing the base pair types for each possibility (i,j)
  */
@@ -0,0 +1,392 @@
+/*
+ *  Block buffered file output stream with asynchronous writes
+ *
+ *  ViennaRNA Package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if VRNA_WITH_PTHREADS
+# include <pthread.h>
+#endif
+
+#include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/datastructures/file_stream.h"
+
+/* maximum number of full blocks waiting for the writer thread */
+#define FSTREAM_MAX_PENDING   4
+
+/* record sizes are padded to multiples of this alignment */
+#define FSTREAM_ALIGN(s)      (((s) + sizeof(double) - 1) & ~(sizeof(double) - 1))
+
+/* every record is preceded by its size */
+#define FSTREAM_HEAD          FSTREAM_ALIGN(sizeof(size_t))
+
+struct fstream_block {
+  char                  *data;
+  size_t                size;     /* number of bytes used */
+  size_t                capacity;
+  struct fstream_block  *next;
+};
+
+struct vrna_file_stream_s {
+  FILE                          *fp;
+  vrna_callback_fstream_format  *format;
+  void                          *auxdata;
+  size_t                        block_size;
+
+  struct fstream_block          *current;       /* block the producer currently appends to */
+  struct fstream_block          *pending_first; /* full blocks waiting for the writer */
+  struct fstream_block          *pending_last;
+  unsigned int                  num_pending;
+  struct fstream_block          *unused;        /* written blocks available for re-use */
+
+#if VRNA_WITH_PTHREADS
+  int                           threaded;
+  int                           shutdown;
+  pthread_t                     writer;
+  pthread_mutex_t               mtx;
+  pthread_cond_t                not_empty;      /* signalled when blocks were submitted, or on shutdown */
+  pthread_cond_t                not_full;       /* signalled when blocks have been written */
+#endif
+};
+
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+PRIVATE void
+write_block(struct vrna_file_stream_s *stream,
+            struct fstream_block      *block);
+
+
+PRIVATE struct fstream_block *
+get_block(struct vrna_file_stream_s *stream,
+          size_t                    capacity);
+
+
+PRIVATE void
+submit_block(struct vrna_file_stream_s  *stream,
+             struct fstream_block       *block);
+
+
+PRIVATE void
+free_blocks(struct fstream_block *block);
+
+
+#if VRNA_WITH_PTHREADS
+PRIVATE void *
+writer_thread(void *arg);
+
+
+#endif
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+PUBLIC struct vrna_file_stream_s *
+vrna_fstream_init(FILE                          *fp,
+                  size_t                        block_size,
+                  vrna_callback_fstream_format  *format,
+                  void                          *auxdata)
+{
+  struct vrna_file_stream_s *stream;
+
+  if (!fp)
+    return NULL;
+
+  stream = (struct vrna_file_stream_s *)vrna_alloc(sizeof(struct vrna_file_stream_s));
+
+  stream->fp            = fp;
+  stream->format        = format;
+  stream->auxdata       = auxdata;
+  stream->block_size    = (block_size > 0) ? block_size : VRNA_FSTREAM_BLOCK_SIZE;
+  stream->pending_first = NULL;
+  stream->pending_last  = NULL;
+  stream->num_pending   = 0;
+  stream->unused        = NULL;
+  stream->current       = get_block(stream, stream->block_size);
+
+#if VRNA_WITH_PTHREADS
+  stream->shutdown = 0;
+  pthread_mutex_init(&stream->mtx, NULL);
+  pthread_cond_init(&stream->not_empty, NULL);
+  pthread_cond_init(&stream->not_full, NULL);
+
+  /* fall back to synchronous writes if we can't get a writer thread */
+  stream->threaded = (pthread_create(&stream->writer, NULL, &writer_thread, (void *)stream) == 0) ?
+                     1 : 0;
+#endif
+
+  return stream;
+}
+
+
+PUBLIC int
+vrna_fstream_free(struct vrna_file_stream_s *stream)
+{
+  int ret;
+
+  if (!stream)
+    return 0;
+
+  if (stream->current->size > 0) {
+    submit_block(stream, stream->current);
+    stream->current = NULL;
+  }
+
+#if VRNA_WITH_PTHREADS
+  if (stream->threaded) {
+    pthread_mutex_lock(&stream->mtx);
+    stream->shutdown = 1;
+    pthread_cond_signal(&stream->not_empty);
+    pthread_mutex_unlock(&stream->mtx);
+
+    pthread_join(stream->writer, NULL);
+  }
+
+  pthread_mutex_destroy(&stream->mtx);
+  pthread_cond_destroy(&stream->not_empty);
+  pthread_cond_destroy(&stream->not_full);
+#endif
+
+  ret = ((fflush(stream->fp) == 0) && (!ferror(stream->fp))) ? 1 : 0;
+
+  free_blocks(stream->current);
+  free_blocks(stream->unused);
+  free(stream);
+
+  return ret;
+}
+
+
+PUBLIC void *
+vrna_fstream_reserve(struct vrna_file_stream_s  *stream,
+                     size_t                     size)
+{
+  size_t                need;
+  struct fstream_block  *block;
+
+  if (!stream)
+    return NULL;
+
+  need  = FSTREAM_HEAD + FSTREAM_ALIGN(size);
+  block = stream->current;
+
+  if (block->size + need > block->capacity) {
+    if (block->size > 0) {
+      submit_block(stream, block);
+      block = get_block(stream, MAX2(stream->block_size, need));
+    } else {
+      /* the empty current block is too small for this record */
+      free_blocks(block);
+      block = (struct fstream_block *)vrna_alloc(sizeof(struct fstream_block));
+      block->data     = (char *)vrna_alloc(sizeof(char) * need);
+      block->capacity = need;
+    }
+
+    stream->current = block;
+  }
+
+  return (void *)(block->data + block->size + FSTREAM_HEAD);
+}
+
+
+PUBLIC void
+vrna_fstream_commit(struct vrna_file_stream_s *stream,
+                    size_t                    size)
+{
+  struct fstream_block *block;
+
+  if (stream) {
+    block = stream->current;
+    memcpy(block->data + block->size, &size, sizeof(size_t));
+    block->size += FSTREAM_HEAD + FSTREAM_ALIGN(size);
+  }
+}
+
+
+PUBLIC void
+vrna_fstream_write(struct vrna_file_stream_s  *stream,
+                   const void                 *record,
+                   size_t                     size)
+{
+  void *mem;
+
+  if (stream) {
+    mem = vrna_fstream_reserve(stream, size);
+    memcpy(mem, record, size);
+    vrna_fstream_commit(stream, size);
+  }
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+PRIVATE void
+write_block(struct vrna_file_stream_s *stream,
+            struct fstream_block      *block)
+{
+  size_t  pos, size;
+  char    *record;
+
+  if (!stream->format) {
+    /* write records as they are, but without size heads and padding */
+    for (pos = 0; pos < block->size; pos += FSTREAM_HEAD + FSTREAM_ALIGN(size)) {
+      memcpy(&size, block->data + pos, sizeof(size_t));
+      (void)fwrite(block->data + pos + FSTREAM_HEAD, sizeof(char), size, stream->fp);
+    }
+  } else {
+    for (pos = 0; pos < block->size; pos += FSTREAM_HEAD + FSTREAM_ALIGN(size)) {
+      memcpy(&size, block->data + pos, sizeof(size_t));
+      record = block->data + pos + FSTREAM_HEAD;
+      stream->format(stream->fp, (const void *)record, size, stream->auxdata);
+    }
+  }
+
+  block->size = 0;
+}
+
+
+PRIVATE struct fstream_block *
+get_block(struct vrna_file_stream_s *stream,
+          size_t                    capacity)
+{
+  struct fstream_block *block = NULL;
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_lock(&stream->mtx);
+#endif
+
+  if (stream->unused) {
+    block           = stream->unused;
+    stream->unused  = block->next;
+  }
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_unlock(&stream->mtx);
+#endif
+
+  if (!block) {
+    block = (struct fstream_block *)vrna_alloc(sizeof(struct fstream_block));
+  } else if (block->capacity < capacity) {
+    free(block->data);
+    block->data = NULL;
+  }
+
+  if (!block->data) {
+    block->data     = (char *)vrna_alloc(sizeof(char) * capacity);
+    block->capacity = capacity;
+  }
+
+  block->size = 0;
+  block->next = NULL;
+
+  return block;
+}
+
+
+PRIVATE void
+submit_block(struct vrna_file_stream_s  *stream,
+             struct fstream_block       *block)
+{
+#if VRNA_WITH_PTHREADS
+  if (stream->threaded) {
+    pthread_mutex_lock(&stream->mtx);
+
+    /* bound the memory of the stream by waiting for the writer */
+    while (stream->num_pending >= FSTREAM_MAX_PENDING)
+      pthread_cond_wait(&stream->not_full, &stream->mtx);
+
+    if (stream->pending_last)
+      stream->pending_last->next = block;
+    else
+      stream->pending_first = block;
+
+    stream->pending_last = block;
+    stream->num_pending++;
+
+    pthread_cond_signal(&stream->not_empty);
+    pthread_mutex_unlock(&stream->mtx);
+
+    return;
+  }
+
+#endif
+
+  write_block(stream, block);
+
+  block->next     = stream->unused;
+  stream->unused  = block;
+}
+
+
+PRIVATE void
+free_blocks(struct fstream_block *block)
+{
+  struct fstream_block *next;
+
+  for (; block; block = next) {
+    next = block->next;
+    free(block->data);
+    free(block);
+  }
+}
+
+
+#if VRNA_WITH_PTHREADS
+PRIVATE void *
+writer_thread(void *arg)
+{
+  struct vrna_file_stream_s *stream;
+  struct fstream_block      *block;
+
+  stream = (struct vrna_file_stream_s *)arg;
+
+  pthread_mutex_lock(&stream->mtx);
+
+  while (1) {
+    while ((!stream->pending_first) && (!stream->shutdown))
+      pthread_cond_wait(&stream->not_empty, &stream->mtx);
+
+    block = stream->pending_first;
+    if (!block)
+      break;  /* shutdown with all blocks written */
+
+    stream->pending_first = block->next;
+    if (!stream->pending_first)
+      stream->pending_last = NULL;
+
+    pthread_mutex_unlock(&stream->mtx);
+
+    write_block(stream, block);
+
+    pthread_mutex_lock(&stream->mtx);
+
+    block->next     = stream->unused;
+    stream->unused  = block;
+    stream->num_pending--;
+
+    pthread_cond_signal(&stream->not_full);
+  }
+
+  pthread_mutex_unlock(&stream->mtx);
+
+  return NULL;
+}
+
+
+#endif
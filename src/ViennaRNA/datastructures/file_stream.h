@@ -0,0 +1,143 @@
+#ifndef VIENNA_RNA_PACKAGE_FILE_STREAM_H
+#define VIENNA_RNA_PACKAGE_FILE_STREAM_H
+
+/**
+ *  @file     ViennaRNA/datastructures/file_stream.h
+ *  @ingroup  utils, buffer_utils
+ *  @brief    An implementation of a block buffered file output stream with asynchronous writes
+ */
+
+/**
+ *  @addtogroup   buffer_utils
+ *  @{
+ */
+
+#include <stdio.h>
+
+/**
+ *  @brief  A block buffered file output stream
+ *
+ *  Producers append records to the current block of the stream. Full blocks
+ *  are handed over to a dedicated writer thread (if the library has been
+ *  compiled with POSIX threads support) that converts them into the actual
+ *  file output, while the producer continues to fill the next block. At most
+ *  a few blocks are pending at any time, so the memory of the stream is bounded
+ *  and a producer that is faster than the output device blocks until
+ *  the writer catches up. Records are written in the order they have been
+ *  appended.
+ */
+typedef struct vrna_file_stream_s *vrna_fstream_t;
+
+/**
+ *  @brief  File stream record formatting callback
+ *
+ *  This callback converts a single record, as appended by vrna_fstream_write()
+ *  or vrna_fstream_commit(), into the actual file output. It is executed by the
+ *  writer thread, i.e. concurrently to the producer, so it must not access
+ *  any data that is modified by the producer.
+ *
+ *  @param  fp        The output file handle
+ *  @param  record    The record data
+ *  @param  size      The size of the record data in bytes
+ *  @param  auxdata   A shared pointer for all calls, as provided to vrna_fstream_init()
+ */
+typedef void (vrna_callback_fstream_format)(FILE        *fp,
+                                            const void  *record,
+                                            size_t      size,
+                                            void        *auxdata);
+
+
+/**
+ *  @brief  The default block size of file streams in bytes
+ */
+#define VRNA_FSTREAM_BLOCK_SIZE   1048576
+
+/**
+ *  @brief  Get an initialized file output stream
+ *
+ *  Without formatting callback, records are written to @p fp as they are,
+ *  e.g. for binary output. The stream never closes @p fp, and @p fp must not
+ *  be accessed otherwise until the stream has been released with vrna_fstream_free().
+ *
+ *  @see  vrna_fstream_free(), vrna_fstream_write(), vrna_fstream_reserve()
+ *
+ *  @param  fp          The output file handle
+ *  @param  block_size  The size of the blocks in bytes (0 for #VRNA_FSTREAM_BLOCK_SIZE)
+ *  @param  format      A callback function that converts records into file output (may be @p NULL)
+ *  @param  auxdata     A pointer to auxiliary data passed as last argument to the @p format callback
+ *  @return             An initialized file output stream, or @p NULL if @p fp is @p NULL
+ */
+vrna_fstream_t
+vrna_fstream_init(FILE                          *fp,
+                  size_t                        block_size,
+                  vrna_callback_fstream_format  *format,
+                  void                          *auxdata);
+
+
+/**
+ *  @brief  Flush and release a file output stream
+ *
+ *  Waits until all records have been written and the writer thread has
+ *  terminated. The file handle of the stream is flushed but not closed.
+ *
+ *  @see  vrna_fstream_init()
+ *
+ *  @param  stream  The file output stream
+ *  @return         1 if all records have been written successfully, 0 otherwise
+ */
+int
+vrna_fstream_free(vrna_fstream_t stream);
+
+
+/**
+ *  @brief  Append a record to a file output stream
+ *
+ *  @see  vrna_fstream_reserve()
+ *
+ *  @param  stream  The file output stream
+ *  @param  record  The record data
+ *  @param  size    The size of the record data in bytes
+ */
+void
+vrna_fstream_write(vrna_fstream_t stream,
+                   const void     *record,
+                   size_t         size);
+
+
+/**
+ *  @brief  Reserve memory for a record within the current block of a file output stream
+ *
+ *  This allows producers to compose records in place instead of copying them
+ *  into the stream. The memory is aligned such that it can hold any basic type,
+ *  and the record is appended to the stream by a subsequent call to vrna_fstream_commit().
+ *
+ *  @see  vrna_fstream_commit()
+ *
+ *  @param  stream  The file output stream
+ *  @param  size    The maximum size of the record in bytes
+ *  @return         A pointer to the memory for the record
+ */
+void *
+vrna_fstream_reserve(vrna_fstream_t stream,
+                     size_t         size);
+
+
+/**
+ *  @brief  Append a record composed in memory obtained from vrna_fstream_reserve()
+ *
+ *  @see  vrna_fstream_reserve()
+ *
+ *  @param  stream  The file output stream
+ *  @param  size    The actual size of the record in bytes, at most the size reserved before
+ */
+void
+vrna_fstream_commit(vrna_fstream_t  stream,
+                    size_t          size);
+
+
+/**
+ *  @}
+ */
+
+
+#endif
@@ -1,45 +1,413 @@
 /* Taken from the barriers tool and modified by GE. */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
 
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
 
+#if VRNA_WITH_PTHREADS
+# include <pthread.h>
+#endif
+
 #include "ViennaRNA/utils/basic.h"
 #include "ViennaRNA/datastructures/hash_tables.h"
 
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+
+/*
+ *  The hash table uses open addressing with Robin Hood hashing, i.e. an
+ *  entry that is farther away from its home slot than the one occupying a
+ *  slot takes over that slot, and the displaced entry continues probing.
+ *  This keeps probe sequences short and sorted by home slot, such that
+ *  look-ups can stop early and entries can be removed by shifting the
+ *  remainder of their cluster backwards instead of leaving tombstones.
+ *
+ *  Each slot caches the (mixed) hash value of its entry, so the compare
+ *  callback is only executed for entries with identical hash values.
+ *
+ *  Whenever a table exceeds its maximum load, a table of twice the size
+ *  is allocated and the entries of the old table are migrated in small
+ *  steps with each subsequent insertion and removal. Migration always
+ *  stops at the start of a cluster, so the entries that remain in the old
+ *  table can still be found there.
+ *
+ *  Concurrent tables consist of independent shards, selected by the upper
+ *  bits of the hash value, each protected by its own lock.
+ */
+
+/* full range of hash values requested from the hash function callback */
+#define HASH_RANGE            0xffffffffUL
+
+/* maximum load of a table before it grows, in percent */
+#define MAX_LOAD              80
+
+/* number of slots of an old table that are migrated per insertion or removal */
+#define MIGRATION_STEPS       16
+
+/* maximum number of shards of a concurrent hash table */
+#define MAX_SHARDS            256
+
+typedef struct {
+  void          *entry;
+  unsigned int  hash;     /* cached hash value of the entry */
+} ht_slot;
+
+typedef struct {
+  ht_slot       *slots;
+  unsigned long mask;     /* number of slots - 1 */
+  unsigned long count;    /* number of entries */
+} ht_table;
+
+typedef struct {
+  ht_table        table;
+  ht_table        old;          /* table whose entries are still being migrated */
+  unsigned long   migrate_pos;  /* next slot of the old table to migrate */
+  unsigned long   migrate_left; /* number of slots of the old table left to migrate */
+  unsigned long   collisions;
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_t mtx;
+#endif
+} ht_shard;
 
 struct vrna_hash_table_s {
   unsigned int                      hash_bits;
-  unsigned long                     Hash_size;
-  /* must be power of 2^hash_bits -1 (example: HASHSIZE 67108864 -1 = 2^26 -1 )*/
-  void                              **Hash_table;
-  unsigned long                     Collisions;
+  unsigned int                      num_shards;
+  unsigned int                      shard_bits;
+  int                               concurrent;
+  ht_shard                          *shards;
   vrna_callback_ht_compare_entries  *Compare_function;
   vrna_callback_ht_hash_function    *Hash_function;
   vrna_callback_ht_free_entry       *Free_hash_entry;
 };
 
-/* ----------------------------------------------------------------- */
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+PRIVATE struct vrna_hash_table_s *
+init_table(unsigned int                     hash_bits,
+           unsigned int                     num_shards,
+           vrna_callback_ht_compare_entries *compare_function,
+           vrna_callback_ht_hash_function   *hash_function,
+           vrna_callback_ht_free_entry      *free_hash_entry);
+
+
+PRIVATE INLINE unsigned int
+get_hash(struct vrna_hash_table_s *ht,
+         void                     *x);
+
+
+PRIVATE INLINE ht_shard *
+get_shard(struct vrna_hash_table_s  *ht,
+          unsigned int              hash);
+
+
+PRIVATE long
+table_find(struct vrna_hash_table_s *ht,
+           ht_table                 *table,
+           void                     *x,
+           unsigned int             hash);
+
+
+PRIVATE unsigned long
+table_put(ht_table      *table,
+          void          *x,
+          unsigned int  hash);
+
 
+PRIVATE void
+table_delete(ht_table       *table,
+             unsigned long  pos);
+
+
+PRIVATE void
+shard_grow(ht_shard *shard);
+
+
+PRIVATE void
+shard_migrate(ht_shard      *shard,
+              unsigned long steps);
+
+
+PRIVATE void
+shard_clear(struct vrna_hash_table_s  *ht,
+            ht_shard                  *shard);
+
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
 PUBLIC struct vrna_hash_table_s *
 vrna_ht_init(unsigned int                     hash_bits,
              vrna_callback_ht_compare_entries *compare_function,
              vrna_callback_ht_hash_function   *hash_function,
              vrna_callback_ht_free_entry      *free_hash_entry)
 {
-  struct vrna_hash_table_s *ht = NULL;
+  return init_table(hash_bits, 1, compare_function, hash_function, free_hash_entry);
+}
+
+
+PUBLIC struct vrna_hash_table_s *
+vrna_ht_init_concurrent(unsigned int                      hash_bits,
+                        unsigned int                      num_shards,
+                        vrna_callback_ht_compare_entries  *compare_function,
+                        vrna_callback_ht_hash_function    *hash_function,
+                        vrna_callback_ht_free_entry       *free_hash_entry)
+{
+  return init_table(hash_bits,
+                    (num_shards > 0) ? num_shards : 1,
+                    compare_function,
+                    hash_function,
+                    free_hash_entry);
+}
+
+
+PUBLIC unsigned long
+vrna_ht_size(struct vrna_hash_table_s *ht)
+{
+  unsigned int  s;
+  unsigned long size = 0;
+
+  if (ht)
+    for (s = 0; s < ht->num_shards; s++)
+      size += ht->shards[s].table.mask + 1;
+
+  return size;
+}
+
+
+PUBLIC unsigned long
+vrna_ht_count(struct vrna_hash_table_s *ht)
+{
+  unsigned int  s;
+  unsigned long count = 0;
+
+  if (ht) {
+    for (s = 0; s < ht->num_shards; s++) {
+      ht_shard *shard = ht->shards + s;
+#if VRNA_WITH_PTHREADS
+      if (ht->concurrent)
+        pthread_mutex_lock(&(shard->mtx));
+
+#endif
+      count += shard->table.count + shard->old.count;
+#if VRNA_WITH_PTHREADS
+      if (ht->concurrent)
+        pthread_mutex_unlock(&(shard->mtx));
+
+#endif
+    }
+  }
+
+  return count;
+}
+
+
+PUBLIC unsigned long
+vrna_ht_collisions(struct vrna_hash_table_s *ht)
+{
+  unsigned int  s;
+  unsigned long collisions = 0;
+
+  if (ht)
+    for (s = 0; s < ht->num_shards; s++)
+      collisions += ht->shards[s].collisions;
+
+  return collisions;
+}
+
+
+PUBLIC void *
+vrna_ht_get(struct vrna_hash_table_s  *ht,
+            void                      *x)             /* returns NULL unless x is in the hash */
+{
+  unsigned int  hash;
+  long          pos;
+  void          *entry;
+  ht_shard      *shard;
+
+  entry = NULL;
+
+  if ((ht) && (x)) {
+    hash  = get_hash(ht, x);
+    shard = get_shard(ht, hash);
+
+#if VRNA_WITH_PTHREADS
+    if (ht->concurrent)
+      pthread_mutex_lock(&(shard->mtx));
+
+#endif
+
+    pos = table_find(ht, &(shard->table), x, hash);
+    if (pos >= 0) {
+      entry = shard->table.slots[pos].entry;
+    } else if (shard->old.slots) {
+      pos = table_find(ht, &(shard->old), x, hash);
+      if (pos >= 0)
+        entry = shard->old.slots[pos].entry;
+    }
+
+#if VRNA_WITH_PTHREADS
+    if (ht->concurrent)
+      pthread_mutex_unlock(&(shard->mtx));
+
+#endif
+  }
+
+  return entry;
+}
+
+
+/* ----------------------------------------------------------------- */
+
+PUBLIC int
+vrna_ht_insert(struct vrna_hash_table_s *ht,
+               void                     *x)         /* returns 1 if x already was in the hash */
+{
+  int           ret;
+  unsigned int  hash;
+  ht_shard      *shard;
+
+  if ((!ht) || (!x))
+    return -1; /* failure */
+
+  hash  = get_hash(ht, x);
+  shard = get_shard(ht, hash);
+
+#if VRNA_WITH_PTHREADS
+  if (ht->concurrent)
+    pthread_mutex_lock(&(shard->mtx));
+
+#endif
+
+  if ((table_find(ht, &(shard->table), x, hash) >= 0) ||
+      ((shard->old.slots) && (table_find(ht, &(shard->old), x, hash) >= 0))) {
+    ret = 1;
+  } else {
+    if ((shard->table.count + 1) * 100 > (shard->table.mask + 1) * MAX_LOAD)
+      shard_grow(shard);
+
+    shard->collisions += table_put(&(shard->table), x, hash);
+
+    if (shard->old.slots)
+      shard_migrate(shard, MIGRATION_STEPS);
+
+    ret = 0; /* success */
+  }
+
+#if VRNA_WITH_PTHREADS
+  if (ht->concurrent)
+    pthread_mutex_unlock(&(shard->mtx));
+
+#endif
+
+  return ret;
+}
+
+
+PUBLIC void
+vrna_ht_clear(struct vrna_hash_table_s *ht)
+{
+  unsigned int s;
+
+  if (ht)
+    for (s = 0; s < ht->num_shards; s++)
+      shard_clear(ht, ht->shards + s);
+}
+
+
+PUBLIC void
+vrna_ht_free(struct vrna_hash_table_s *ht)
+{
+  unsigned int s;
+
+  if (ht) {
+    vrna_ht_clear(ht);
+
+    for (s = 0; s < ht->num_shards; s++) {
+      free(ht->shards[s].table.slots);
+#if VRNA_WITH_PTHREADS
+      pthread_mutex_destroy(&(ht->shards[s].mtx));
+#endif
+    }
+
+    free(ht->shards);
+    free(ht);
+  }
+}
+
+
+/* ----------------------------------------------------------------- */
+
+PUBLIC void
+vrna_ht_remove(struct vrna_hash_table_s *ht,
+               void                     *x)
+{
+  /* doesn't free anything ! */
+  unsigned int  hash;
+  long          pos;
+  ht_shard      *shard;
+
+  if ((ht) && (x)) {
+    hash  = get_hash(ht, x);
+    shard = get_shard(ht, hash);
+
+#if VRNA_WITH_PTHREADS
+    if (ht->concurrent)
+      pthread_mutex_lock(&(shard->mtx));
+
+#endif
+
+    pos = table_find(ht, &(shard->table), x, hash);
+    if (pos >= 0) {
+      table_delete(&(shard->table), (unsigned long)pos);
+    } else if (shard->old.slots) {
+      pos = table_find(ht, &(shard->old), x, hash);
+      if (pos >= 0)
+        table_delete(&(shard->old), (unsigned long)pos);
+    }
+
+    if (shard->old.slots)
+      shard_migrate(shard, MIGRATION_STEPS);
+
+#if VRNA_WITH_PTHREADS
+    if (ht->concurrent)
+      pthread_mutex_unlock(&(shard->mtx));
+
+#endif
+  }
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+PRIVATE struct vrna_hash_table_s *
+init_table(unsigned int                     hash_bits,
+           unsigned int                     num_shards,
+           vrna_callback_ht_compare_entries *compare_function,
+           vrna_callback_ht_hash_function   *hash_function,
+           vrna_callback_ht_free_entry      *free_hash_entry)
+{
+  unsigned int              s, bits;
+  struct vrna_hash_table_s  *ht = NULL;
 
   if (hash_bits > 0) {
     ht = (struct vrna_hash_table_s *)vrna_alloc(sizeof(struct vrna_hash_table_s));
 
-    ht->hash_bits = hash_bits;
-    /* must be power of 2^hash_bits -1 (example: HASHSIZE 67108864 -1 = 2^26 -1 )*/
-    ht->Hash_size   = (((unsigned long)1 << hash_bits) - 1);
-    ht->Hash_table  = calloc(ht->Hash_size + 1, sizeof(void *));
-    ht->Collisions  = 0;
-
     if ((!compare_function) &&
         (!hash_function) &&
         (!free_hash_entry)) {
@@ -64,7 +432,29 @@ vrna_ht_init(unsigned int                     hash_bits,
        *  anything!
        */
       free(ht);
-      ht = NULL;
+      return NULL;
+    }
+
+    /* round number of shards up to the next power of 2 */
+    for (ht->shard_bits = 0;
+         ((1U << ht->shard_bits) < num_shards) && ((1U << ht->shard_bits) < MAX_SHARDS);
+         ht->shard_bits++);
+
+    ht->hash_bits   = hash_bits;
+    ht->num_shards  = 1U << ht->shard_bits;
+    ht->concurrent  = (num_shards > 1) ? 1 : 0;
+    ht->shards      = (ht_shard *)vrna_alloc(sizeof(ht_shard) * ht->num_shards);
+
+    /* distribute the initial size among the shards */
+    bits = (hash_bits > ht->shard_bits + 4) ? hash_bits - ht->shard_bits : 4;
+
+    for (s = 0; s < ht->num_shards; s++) {
+      ht_shard *shard = ht->shards + s;
+      shard->table.mask   = ((unsigned long)1 << bits) - 1;
+      shard->table.slots  = (ht_slot *)vrna_alloc(sizeof(ht_slot) * (shard->table.mask + 1));
+#if VRNA_WITH_PTHREADS
+      pthread_mutex_init(&(shard->mtx), NULL);
+#endif
     }
   }
 
@@ -72,131 +462,201 @@ vrna_ht_init(unsigned int                     hash_bits,
 }
 
 
-unsigned long
-vrna_ht_size(struct vrna_hash_table_s *ht)
+PRIVATE INLINE unsigned int
+get_hash(struct vrna_hash_table_s *ht,
+         void                     *x)
 {
-  if (ht)
-    return ht->Hash_size;
+  unsigned int h;
+
+  /* scramble the hash value, in case the hash function only produces few distinct low order bits */
+  h = ht->Hash_function(x, HASH_RANGE);
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
 
-  return 0L;
+  return h;
 }
 
 
-unsigned long
-vrna_ht_collisions(struct vrna_hash_table_s *ht)
+PRIVATE INLINE ht_shard *
+get_shard(struct vrna_hash_table_s  *ht,
+          unsigned int              hash)
 {
-  if (ht)
-    return ht->Collisions;
+  if (ht->shard_bits == 0)
+    return ht->shards;
 
-  return 0L;
+  return ht->shards + (hash >> (32 - ht->shard_bits));
 }
 
 
-PUBLIC void *
-vrna_ht_get(struct vrna_hash_table_s  *ht,
-            void                      *x)             /* returns NULL unless x is in the hash */
+/* return the slot of entry x, or -1 if x is not in the table */
+PRIVATE long
+table_find(struct vrna_hash_table_s *ht,
+           ht_table                 *table,
+           void                     *x,
+           unsigned int             hash)
 {
-  unsigned int hashval;
+  unsigned long pos, dist;
+  ht_slot       *slot;
 
-  if ((ht) && (x)) {
-    hashval = ht->Hash_function(x, ht->Hash_size);
-    if (ht->Hash_table[hashval] == NULL)
-      return NULL;
+  pos = hash & table->mask;
 
-    while (ht->Hash_table[hashval]) {
-      if (ht->Compare_function(x, ht->Hash_table[hashval]) == 0)
-        return ht->Hash_table[hashval];
+  for (dist = 0; ; dist++, pos = (pos + 1) & table->mask) {
+    slot = table->slots + pos;
 
-      hashval = ((hashval + 1) & (ht->Hash_size));
-    }
-  }
+    /* entries of a cluster are sorted by their home slot */
+    if ((!slot->entry) ||
+        (((pos - slot->hash) & table->mask) < dist))
+      return -1;
 
-  return NULL;
+    if ((slot->hash == hash) &&
+        (ht->Compare_function(x, slot->entry) == 0))
+      return (long)pos;
+  }
 }
 
 
-/* ----------------------------------------------------------------- */
-
-PUBLIC int
-vrna_ht_insert(struct vrna_hash_table_s *ht,
-               void                     *x)         /* returns 1 if x already was in the hash */
+/* insert an entry that is not in the table yet, return the number of displacements */
+PRIVATE unsigned long
+table_put(ht_table      *table,
+          void          *x,
+          unsigned int  hash)
 {
-  unsigned int hashval;
+  unsigned long pos, dist, d, collisions;
+  ht_slot       *slot, tmp, carry;
 
-  if ((ht) && (x)) {
-    hashval = ht->Hash_function(x, ht->Hash_size);
-    if (hashval < ht->Hash_size) {
-      void *entry = ht->Hash_table[hashval];
-      while (entry != NULL) {
-        if (ht->Compare_function(x, ht->Hash_table[hashval]) == 0)
-          return 1;
-
-        hashval = ((hashval + 1) & (ht->Hash_size));
-        ht->Collisions++;
-      }
-      ht->Hash_table[hashval] = x;
-      return 0; /* success */
-    } else {
-      vrna_message_warning("vrna_ht_insert: "
-                           "The hash table (size %d) is too small for entry with key %d",
-                           ht->Hash_size,
-                           hashval);
+  carry.entry = x;
+  carry.hash  = hash;
+  collisions  = 0;
+  pos         = hash & table->mask;
+
+  for (dist = 0; ; dist++, pos = (pos + 1) & table->mask) {
+    slot = table->slots + pos;
+
+    if (!slot->entry) {
+      *slot = carry;
+      table->count++;
+      return collisions;
+    }
+
+    collisions++;
+
+    /* take the slot from an entry that is closer to its home slot */
+    d = (pos - slot->hash) & table->mask;
+    if (d < dist) {
+      tmp   = *slot;
+      *slot = carry;
+      carry = tmp;
+      dist  = d;
     }
   }
+}
+
+
+/* remove the entry at pos and shift the remainder of its cluster backwards */
+PRIVATE void
+table_delete(ht_table       *table,
+             unsigned long  pos)
+{
+  unsigned long next;
+
+  for (next = (pos + 1) & table->mask;
+       (table->slots[next].entry) && (((next - table->slots[next].hash) & table->mask) > 0);
+       pos = next, next = (next + 1) & table->mask)
+    table->slots[pos] = table->slots[next];
 
-  return -1; /* failure */
+  table->slots[pos].entry = NULL;
+  table->count--;
 }
 
 
-PUBLIC void
-vrna_ht_clear(struct vrna_hash_table_s *ht)
+PRIVATE void
+shard_grow(ht_shard *shard)
 {
-  unsigned int i;
+  unsigned long pos;
 
-  if (ht) {
-    for (i = 0; i < ht->Hash_size + 1; i++) {
-      if (ht->Hash_table[i]) {
-        ht->Free_hash_entry(ht->Hash_table[i]);
-        ht->Hash_table[i] = NULL;
-      }
-    }
+  /* a previous migration must be finished before another one can start */
+  if (shard->old.slots)
+    shard_migrate(shard, shard->migrate_left);
 
-    ht->Collisions = 0;
-  }
+  shard->old          = shard->table;
+  shard->table.mask   = 2 * shard->old.mask + 1;
+  shard->table.count  = 0;
+  shard->table.slots  = (ht_slot *)vrna_alloc(sizeof(ht_slot) * (shard->table.mask + 1));
+
+  /* start the migration at the beginning of a cluster */
+  for (pos = 0; shard->old.slots[pos].entry; pos++);
+
+  shard->migrate_pos  = pos;
+  shard->migrate_left = shard->old.mask + 1;
 }
 
 
-PUBLIC void
-vrna_ht_free(struct vrna_hash_table_s *ht)
+PRIVATE void
+shard_migrate(ht_shard      *shard,
+              unsigned long steps)
 {
-  if (ht) {
-    vrna_ht_clear(ht);
-    free(ht->Hash_table);
-    free(ht);
+  ht_table  *old  = &(shard->old);
+  ht_slot   *slot;
+
+  while (shard->migrate_left > 0) {
+    slot = old->slots + shard->migrate_pos;
+
+    /*
+     *  only stop in front of empty slots or entries in their home slot,
+     *  such that no remaining entry has its home slot in the migrated part
+     */
+    if ((steps == 0) &&
+        ((!slot->entry) || (((shard->migrate_pos - slot->hash) & old->mask) == 0)))
+      return;
+
+    if (slot->entry) {
+      (void)table_put(&(shard->table), slot->entry, slot->hash);
+      slot->entry = NULL;
+      old->count--;
+    }
+
+    shard->migrate_pos = (shard->migrate_pos + 1) & old->mask;
+    shard->migrate_left--;
+
+    if (steps > 0)
+      steps--;
   }
-}
 
+  free(old->slots);
+  old->slots  = NULL;
+  old->mask   = 0;
+  old->count  = 0;
+}
 
-/* ----------------------------------------------------------------- */
 
-PUBLIC void
-vrna_ht_remove(struct vrna_hash_table_s *ht,
-               void                     *x)           /* doesn't work in case of collisions */
+PRIVATE void
+shard_clear(struct vrna_hash_table_s  *ht,
+            ht_shard                  *shard)
 {
-  /* doesn't free anything ! */
-  unsigned int hashval;
+  unsigned long i;
 
-  if ((ht) && (x)) {
-    hashval = ht->Hash_function(x, ht->Hash_size);
-    while (ht->Hash_table[hashval]) {
-      if (ht->Compare_function(x, ht->Hash_table[hashval]) == 0) {
-        ht->Hash_table[hashval] = NULL;
-        return;
-      }
-
-      hashval = ((hashval + 1) & (ht->Hash_size));
+  for (i = 0; i <= shard->table.mask; i++)
+    if (shard->table.slots[i].entry) {
+      ht->Free_hash_entry(shard->table.slots[i].entry);
+      shard->table.slots[i].entry = NULL;
     }
+
+  if (shard->old.slots) {
+    for (i = 0; i <= shard->old.mask; i++)
+      if (shard->old.slots[i].entry)
+        ht->Free_hash_entry(shard->old.slots[i].entry);
+
+    free(shard->old.slots);
+    shard->old.slots  = NULL;
+    shard->old.mask   = 0;
+    shard->old.count  = 0;
   }
+
+  shard->table.count  = 0;
+  shard->collisions   = 0;
 }
 
 
@@ -21,6 +21,12 @@
  *  Here, we provide an abstract implementation of a hash table interface
  *  and a concrete implementation for pairs of secondary structure and
  *  corresponding free energy value.
+ *
+ *  The hash tables use open addressing with Robin Hood hashing and cache
+ *  the hash value of each entry, such that the comparison callback is only
+ *  executed for entries with identical hash values. Tables grow automatically
+ *  whenever their load exceeds 80%, where the entries of the previous table
+ *  are migrated incrementally with subsequent insertions and removals.
  */
 
 /**
@@ -48,9 +54,14 @@ typedef int (vrna_callback_ht_compare_entries)(void *x,
 
 /**
  *  @brief  Callback function to generate a hash key, i.e. hash function
+ *
+ *  Since hash tables grow dynamically, the hash table implementation
+ *  requests hash keys in the range @f$[0, 2^{32} - 1]@f$ and maps them
+ *  to its slots itself.
+ *
  *  @see    vrna_ht_init(), vrna_ht_db_hash_func()
  *  @param  x               A hash table entry
- *  @param  hashtable_size  The size of the hash table
+ *  @param  hashtable_size  The largest hash key to return
  *  @return                 The hash table key for entry @p x
  */
 typedef unsigned int (vrna_callback_ht_hash_function)(void          *x,
@@ -70,7 +81,8 @@ typedef int (vrna_callback_ht_free_entry)(void *x);
  *  @brief  Get an initialized hash table
  *
  *  This function returns a ready-to-use hash table with pre-allocated
- *  memory for a particular number of entries.
+ *  memory for a particular number of entries. The table grows automatically
+ *  if more entries are inserted.
  *
  *  @note
  *  @parblock
@@ -82,10 +94,9 @@ typedef int (vrna_callback_ht_free_entry)(void *x);
  *
  *  arguments.
  *  @endparblock
- *  @warning  If @p hash_bits is larger than 27 you have to compile it with
- *            the flag gcc -mcmodel=large.
+ *  @see vrna_ht_init_concurrent()
  *
- *  @param  b                 Number of bits for the hash table. This determines the size (@f$2^b -1@f$).
+ *  @param  b                 Number of bits for the hash table. This determines the initial size (@f$2^b@f$).
  *  @param  compare_function  A function pointer to compare any two entries in the hash table (may be @p NULL)
  *  @param  hash_function     A function pointer to retrieve the hash value of any entry (may be @p NULL)
  *  @param  free_hash_entry   A function pointer to free the memory occupied by any entry (may be @p NULL)
@@ -98,21 +109,60 @@ vrna_ht_init(unsigned int                     b,
              vrna_callback_ht_free_entry      *free_hash_entry);
 
 
+/**
+ *  @brief  Get an initialized hash table that supports concurrent access
+ *
+ *  Same as vrna_ht_init(), but the hash table is split into @p num_shards
+ *  independent shards, each protected by its own lock. Entries are assigned
+ *  to shards by their hash value, thus multiple threads may insert, look-up,
+ *  and remove entries concurrently as long as they access different shards.
+ *  The number of shards is rounded up to the next power of 2 (at most 256).
+ *
+ *  @note Concurrent access requires the library to be compiled with POSIX
+ *        threads support.
+ *
+ *  @see vrna_ht_init()
+ *
+ *  @param  b                 Number of bits for the hash table. This determines the initial size (@f$2^b@f$) of all shards together.
+ *  @param  num_shards        Number of independently locked shards
+ *  @param  compare_function  A function pointer to compare any two entries in the hash table (may be @p NULL)
+ *  @param  hash_function     A function pointer to retrieve the hash value of any entry (may be @p NULL)
+ *  @param  free_hash_entry   A function pointer to free the memory occupied by any entry (may be @p NULL)
+ *  @return                   An initialized, empty hash table, or @p NULL on any error
+ */
+vrna_hash_table_t
+vrna_ht_init_concurrent(unsigned int                      b,
+                        unsigned int                      num_shards,
+                        vrna_callback_ht_compare_entries  *compare_function,
+                        vrna_callback_ht_hash_function    *hash_function,
+                        vrna_callback_ht_free_entry       *free_hash_entry);
+
+
 /**
  *  @brief  Get the size of the hash table
  *
  *  @param  ht  The hash table
- *  @return     The size of the hash table, i.e. the maximum number of entries
+ *  @return     The current size of the hash table, i.e. the number of slots
  */
 unsigned long
 vrna_ht_size(vrna_hash_table_t ht);
 
 
+/**
+ *  @brief  Get the number of entries stored in the hash table
+ *
+ *  @param  ht  The hash table
+ *  @return     The number of entries in the hash table
+ */
+unsigned long
+vrna_ht_count(vrna_hash_table_t ht);
+
+
 /**
  *  @brief  Get the number of collisions in the hash table
  *
  *  @param  ht  The hash table
- *  @return     The number of collisions in the hash table
+ *  @return     The number of occupied slots probed while inserting entries since the last vrna_ht_clear()
  */
 unsigned long
 vrna_ht_collisions(struct vrna_hash_table_s *ht);
@@ -142,10 +192,6 @@ vrna_ht_get(vrna_hash_table_t ht,
  *
  *  Writes the pointer to your hash entry into the table.
  *
- *  @warning  In case of collisions, this function simply
- *            increments the hash key until a free entry in
- *            the hash table is found.
- *
  *  @see vrna_ht_init(), vrna_hash_delete(), vrna_ht_clear()
  *
  *  @param  ht  The hash table
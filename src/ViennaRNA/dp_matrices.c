@@ -25,6 +25,7 @@
 #include "ViennaRNA/utils/basic.h"
 #include "ViennaRNA/gquad.h"
 #include "ViennaRNA/dp_matrices.h"
+#include "ViennaRNA/boltzmann_sampling.h"
 
 /*
  #################################
@@ -205,6 +206,8 @@ vrna_mx_pf_free(vrna_fold_compound_t *vc)
   if (vc) {
     vrna_mx_pf_t *self = vc->exp_matrices;
     if (self) {
+      vrna_pbacktrack_cache_free(vc);
+
       switch (self->type) {
         case VRNA_MX_DEFAULT:
           pf_matrices_free_default(self);
@@ -494,7 +497,7 @@ add_pf_matrices(vrna_fold_compound_t  *vc,
         case VRNA_FC_TYPE_SINGLE:
           vc->exp_matrices->G = NULL;
           /* can't do that here, since scale[] is not filled yet :(
-           * vc->exp_matrices->G = get_gquad_pf_matrix(vc->sequence_encoding2, vc->exp_matrices->scale, vc->exp_params);
+           * vc->exp_matrices->G = vrna_gquad_mx_pf(vc->sequence_encoding2, vc->exp_matrices->scale, vc->exp_params);
            */
           break;
         default:                    /* do nothing */
@@ -534,7 +537,7 @@ add_mfe_matrices(vrna_fold_compound_t *vc,
             case VRNA_MX_WINDOW:                              /* do nothing, since we handle memory somewhere else */
               break;
             default:
-              vc->matrices->ggg = get_gquad_matrix(vc->sequence_encoding2, vc->params);
+              vc->matrices->ggg = vrna_gquad_mx_mfe(vc->sequence_encoding2, vc->params);
               break;
           }
           break;
@@ -543,7 +546,7 @@ add_mfe_matrices(vrna_fold_compound_t *vc,
             case VRNA_MX_WINDOW:                              /* do nothing, since we handle memory somewhere else */
               break;
             default:
-              vc->matrices->ggg = get_gquad_ali_matrix(vc->S_cons, vc->S, vc->n_seq, vc->params);
+              vc->matrices->ggg = vrna_gquad_mx_mfe_ali(vc->S_cons, vc->S, vc->n_seq, vc->params);
               break;
           }
           break;
@@ -737,7 +740,7 @@ mfe_matrices_free_default(vrna_mx_mfe_t *self)
   free(self->fML);
   free(self->fM1);
   free(self->fM2);
-  free(self->ggg);
+  vrna_gquad_mx_free(self->ggg);
 }
 
 
@@ -1325,7 +1328,7 @@ pf_matrices_free_default(vrna_mx_pf_t *self)
   free(self->qm1);
   free(self->qm2);
   free(self->probs);
-  free(self->G);
+  vrna_gquad_mx_free(self->G);
   free(self->q1k);
   free(self->qln);
 }
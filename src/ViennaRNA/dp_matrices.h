@@ -20,6 +20,8 @@
 typedef struct  vrna_mx_mfe_s vrna_mx_mfe_t;
 /** @brief Typename for the Partition Function (PF) DP matrices data structure #vrna_mx_pf_s */
 typedef struct  vrna_mx_pf_s vrna_mx_pf_t;
+/** @brief Typename for the sparse G-quadruplex matrix data structure #vrna_gquad_mx_s (see gquad.h) */
+typedef struct  vrna_gquad_mx_s vrna_gquad_mx_t;
 
 #include <ViennaRNA/datastructures/basic.h>
 
@@ -69,7 +71,7 @@ struct vrna_mx_mfe_s {
   int *fML;         /**<  @brief  Multi-loop auxiliary energy array */
   int *fM1;         /**<  @brief  Second ML array, only for unique multibrnach loop decomposition */
   int *fM2;         /**<  @brief  Energy for a multibranch loop region with exactly two stems, extending to 3' end */
-  int *ggg;         /**<  @brief  Energies of g-quadruplexes */
+  vrna_gquad_mx_t *ggg;  /**<  @brief  Energies of g-quadruplexes (sparse, see vrna_gquad_mx_get()) */
   int Fc;           /**<  @brief  Minimum Free Energy of entire circular RNA */
   int FcH;
   int FcI;
@@ -232,7 +234,7 @@ struct vrna_mx_pf_s {
   FLT_OR_DBL *probs;
   FLT_OR_DBL *q1k;
   FLT_OR_DBL *qln;
-  FLT_OR_DBL *G;
+  vrna_gquad_mx_t *G;  /**<  @brief  Boltzmann weights of g-quadruplexes (sparse, see vrna_gquad_mx_get_pf()) */
 
   FLT_OR_DBL qo;
   FLT_OR_DBL *qm2;
@@ -354,6 +356,9 @@ struct {
 };
 };
 #endif
+
+  struct vrna_pbacktrack_cache_s *bt_cache; /**< @brief Memoized decompositions for stochastic backtracking, see vrna_pbacktrack_cache_init() */
+  unsigned int logspace;                    /**< @brief Non-zero if the matrices hold log-space partition functions, see vrna_pf_logspace() */
 };
 
 /**
@@ -27,6 +27,7 @@
 #include "ViennaRNA/eval.h"
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/part_func.h"
+#include "ViennaRNA/part_func_logspace.h"
 #include "ViennaRNA/equilibrium_probs.h"
 
 /*
@@ -51,6 +52,12 @@ PRIVATE int  pf_co_bppm(vrna_fold_compound_t *vc, char *structure);
 PRIVATE int  alipf_create_bppm(vrna_fold_compound_t *vc, char *structure);
 PRIVATE INLINE void bppm_circ(vrna_fold_compound_t *vc);
 
+PRIVATE INLINE void outside_int_loops(vrna_fold_compound_t *vc, unsigned char *hc_local, int k, int l, vrna_ep_t **bp_correction, int *corr_cnt, int *corr_size);
+PRIVATE INLINE void outside_gquad(vrna_fold_compound_t *vc, int k, int l);
+PRIVATE void        outside_wavefront(vrna_fold_compound_t *vc, unsigned char *hc_local, int *ov);
+PRIVATE INLINE void ali_outside_int_loops(vrna_fold_compound_t *vc, int k, int l, int *type);
+PRIVATE void        ali_outside_wavefront(vrna_fold_compound_t *vc, int *ov);
+
 PRIVATE INLINE void ud_outside_ext_loops(vrna_fold_compound_t *vc);
 PRIVATE INLINE void ud_outside_hp_loops(vrna_fold_compound_t *vc);
 PRIVATE INLINE void ud_outside_int_loops(vrna_fold_compound_t *vc);
@@ -98,7 +105,10 @@ vrna_pr_structure(vrna_fold_compound_t *fc,
     kT = params->kT / 1000.;
     Q  = params->model_details.circ ? fc->exp_matrices->qo : fc->exp_matrices->q[fc->iindx[1] - n];
 
-    dG = (-log(Q) - n * log(params->pf_scale)) * kT;
+    if (vrna_pf_logspace(fc))
+      dG = -Q * kT;
+    else
+      dG = (-log(Q) - n * log(params->pf_scale)) * kT;
 
     if (fc->type == VRNA_FC_TYPE_COMPARATIVE) {
       /* add covariance term */
@@ -130,7 +140,10 @@ vrna_pr_energy(vrna_fold_compound_t *fc,
     kT = params->kT / 1000.;
     Q  = params->model_details.circ ? fc->exp_matrices->qo : fc->exp_matrices->q[fc->iindx[1] - n];
 
-    dG = (-log(Q) - n * log(params->pf_scale)) * kT;
+    if (vrna_pf_logspace(fc))
+      dG = -Q * kT;
+    else
+      dG = (-log(Q) - n * log(params->pf_scale)) * kT;
 
     if (fc->type == VRNA_FC_TYPE_COMPARATIVE)
       dG /= fc->n_seq;
@@ -153,7 +166,9 @@ vrna_pairing_probs( vrna_fold_compound_t *vc,
   if (vc) {
     switch (vc->type) {
       case VRNA_FC_TYPE_SINGLE:
-        if (vc->cutpoint != -1)
+        if (vrna_pf_logspace(vc))
+          ret = vrna_pairing_probs_logspace(vc, structure);
+        else if (vc->cutpoint != -1)
           ret = pf_co_bppm(vc, structure);
         else
           ret = pf_create_bppm(vc, structure);
@@ -177,15 +192,15 @@ PRIVATE int
 pf_create_bppm( vrna_fold_compound_t *vc,
                 char *structure){
 
-  int n, i,j,k,l, ij, kl, ii, u, u1, u2, ov=0;
-  unsigned char type, type_2, tt;
+  int n, i,j,k,l, ij, kl, ii, u, ov=0;
+  unsigned char type, tt;
   FLT_OR_DBL  temp, Qmax=0, prm_MLb;
   FLT_OR_DBL  prmt, prmt1;
   FLT_OR_DBL  *tmp;
-  FLT_OR_DBL  tmp2;
   FLT_OR_DBL  expMLclosing;
-  FLT_OR_DBL  *qb, *qm, *G, *probs, *scale, *expMLbase;
+  FLT_OR_DBL  *qb, *qm, *probs, *scale, *expMLbase;
   FLT_OR_DBL  *q1k, *qln;
+  vrna_gquad_mx_t *G;
 
   char              *ptype;
 
@@ -234,7 +249,6 @@ pf_create_bppm( vrna_fold_compound_t *vc,
 
   FLT_OR_DBL    expMLstem         = (with_gquad) ? exp_E_MLstem(0, -1, -1, pf_params) : 0;
   unsigned char *hard_constraints = hc->matrix;
-  int           *hc_up_int        = hc->up_int;
 
   int           corr_size       = 5;
   int           corr_cnt        = 0;
@@ -314,399 +328,250 @@ pf_create_bppm( vrna_fold_compound_t *vc,
       }
     } /* end if(!circular)  */
 
-    for (l = n; l > turn + 1; l--) {
-
-      /* 2. bonding k,l as substem of 2:loop enclosed by i,j */
-      for(k = 1; k < l - turn; k++){
-        kl      = my_iindx[k]-l;
-        type_2  = rtype[vrna_get_ptype(jindx[l] + k, ptype)];
-
-        if (qb[kl]==0.) continue;
-
-        if(hc_local[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC){
-          for(i = MAX2(1, k - MAXLOOP - 1); i <= k - 1; i++){
-            u1 = k - i - 1;
-            if(hc_up_int[i+1] < u1) continue;
-
-            for(j = l + 1; j <= MIN2(l + MAXLOOP - k + i + 2, n); j++){
-              u2 = j-l-1;
-              if(hc_up_int[l+1] < u2) break;
-
-              ij = my_iindx[i] - j;
-              if(hc_local[ij] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP){
-                type = vrna_get_ptype(jindx[j] + i, ptype);
-
-                if(probs[ij] > 0){
-                  tmp2 =  probs[ij]
-                          * scale[u1 + u2 + 2]
-                          * exp_E_IntLoop(u1, u2, type, type_2, S1[i+1], S1[j-1], S1[k-1], S1[l+1], pf_params);
-
-                  if(sc){
-                    if(sc->exp_energy_up)
-                      tmp2 *=   sc->exp_energy_up[i+1][u1]
-                              * sc->exp_energy_up[l+1][u2];
-
-                    if(sc->exp_energy_bp)
-                      tmp2 *=   sc->exp_energy_bp[ij];
-
-                    if(sc->exp_energy_stack){
-                      if((i+1 == k) && (j-1 == l)){
-                        tmp2 *=   sc->exp_energy_stack[i]
-                                * sc->exp_energy_stack[k]
-                                * sc->exp_energy_stack[l]
-                                * sc->exp_energy_stack[j];
-                      }
-                    }
-
-                    if(sc->exp_f)
-                      tmp2 *= sc->exp_f(i, j, k, l, VRNA_DECOMP_PAIR_IL, sc->data);
-                  }
+    if(md->wavefront && (!with_ud) && (!(sc && sc->exp_f && sc->bt))){
+      /* 2. - 3. along anti-diagonals, see outside_wavefront() */
+      outside_wavefront(vc, hc_local, &ov);
+    } else {
+      for (l = n; l > turn + 1; l--) {
 
-                  if(with_ud){
-                    FLT_OR_DBL qql, qqr;
+        /* 2. bonding k,l as substem of 2:loop enclosed by i,j */
+        for(k = 1; k < l - turn; k++)
+          outside_int_loops(vc, hc_local, k, l, &bp_correction, &corr_cnt, &corr_size);
 
-                    qql = qqr = 0.;
+        if(with_gquad){
+          /* 2.5. bonding k,l as gquad enclosed by i,j */
+          for(k = 2; k <= l - VRNA_GQUAD_MIN_BOX_SIZE + 1; k++)
+            outside_gquad(vc, k, l);
+        }
 
-                    if(u1 > 0)
-                      qql = domains_up->exp_energy_cb(vc,
-                                                      i+1, k-1,
-                                                      VRNA_UNSTRUCTURED_DOMAIN_INT_LOOP,
-                                                      domains_up->data);
-                    if(u2 > 0)
-                      qqr = domains_up->exp_energy_cb(vc,
-                                                      l+1, j-1,
-                                                      VRNA_UNSTRUCTURED_DOMAIN_INT_LOOP,
-                                                      domains_up->data);
-                    temp  = tmp2;
-                    tmp2 += temp * qql;
-                    tmp2 += temp * qqr;
-                    tmp2 += temp * qql * qqr;
-                  }
+        /* 3. bonding k,l as substem of multi-loop enclosed by i,j */
+        prm_MLb = 0.;
 
-                  if(sc && sc->exp_f && sc->bt){ /* store probability correction for auxiliary pairs in interior loop motif */
-                    vrna_basepair_t *ptr, *aux_bps;
-                    aux_bps = sc->bt(i, j, k, l, VRNA_DECOMP_PAIR_IL, sc->data);
-                    for(ptr = aux_bps; ptr && ptr->i != 0; ptr++){
-                      bp_correction[corr_cnt].i = ptr->i;
-                      bp_correction[corr_cnt].j = ptr->j;
-                      bp_correction[corr_cnt++].p = tmp2 * qb[kl];
-                      if(corr_cnt == corr_size){
-                        corr_size += 5;
-                        bp_correction = vrna_realloc(bp_correction, sizeof(vrna_ep_t) * corr_size);
-                      }
-                    }
-                    free(aux_bps);
-                  }
+        if(with_ud){
+          for(u = 0; u <= ud_max_size; u++)
+            prm_MLbu[u] = 0.;
+        }
 
-                  probs[kl] += tmp2;
+        if (l<n)
+          for (k = 2; k < l - turn; k++) {
+            kl    = my_iindx[k] - l;
+            i     = k - 1;
+            prmt  = prmt1 = 0.0;
+
+            int lj;
+            short s3;
+            FLT_OR_DBL ppp;
+            ij = my_iindx[i] - (l+2);
+            lj = my_iindx[l+1]-(l+1);
+            s3 = S1[i+1];
+            for (j = l + 2; j<=n; j++, ij--, lj--){
+              if(hc_local[ij] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
+                tt = vrna_get_ptype_md(S[j], S[i], md);
+
+                /* which decomposition is covered here? =>
+                  i + 1 = k < l < j:
+                  (i,j)       -> enclosing pair
+                  (k, l)      -> enclosed pair
+                  (l+1, j-1)  -> multiloop part with at least one stem
+                  a.k.a. (k,l) is left-most stem in multiloop closed by (k-1, j)
+                */
+                ppp = probs[ij]
+                      * exp_E_MLstem(tt, S1[j-1], s3, pf_params)
+                      * qm[lj];
+
+                if(sc){
+                  if(sc->exp_energy_bp)
+                    ppp *= sc->exp_energy_bp[ij];
+  /*
+                  if(sc->exp_f)
+                    ppp *= sc->exp_f(i, j, l+1, j-1, , sc->data);
+  */
                 }
+                prmt += ppp;
               }
             }
-          }
-        }
-      }
+            prmt *= expMLclosing;
 
-      if(with_gquad){
-        /* 2.5. bonding k,l as gquad enclosed by i,j */
-        double *expintern = &(pf_params->expinternal[0]);
-        FLT_OR_DBL qe;
-
-        if(l < n - 3){
-          for(k = 2; k <= l - VRNA_GQUAD_MIN_BOX_SIZE + 1; k++){
-            kl = my_iindx[k]-l;
-            if (G[kl]==0.) continue;
-            tmp2 = 0.;
-            i = k - 1;
-            for(j = MIN2(l + MAXLOOP + 1, n); j > l + 3; j--){
-              ij = my_iindx[i] - j;
-              type = (unsigned char)ptype[jindx[j] + i];
-              if(!type) continue;
-              u1 = j - l - 1;
-              qe = (type > 2) ? pf_params->expTermAU : 1.;
-              tmp2 +=   probs[ij]
-                      * qe
-                      * (FLT_OR_DBL)expintern[u1]
-                      * pf_params->expmismatchI[type][S1[i+1]][S1[j-1]]
-                      * scale[u1 + 2];
-            }
-            probs[kl] += tmp2 * G[kl];
-          }
-        }
 
-        if (l < n - 1){
-          for (k=3; k<=l-VRNA_GQUAD_MIN_BOX_SIZE + 1; k++) {
-            kl = my_iindx[k]-l;
-            if (G[kl]==0.) continue;
-            tmp2 = 0.;
-            for (i=MAX2(1,k-MAXLOOP-1); i<=k-2; i++){
-              u1 = k - i - 1;
-              for (j=l+2; j<=MIN2(l + MAXLOOP - u1 + 1,n); j++) {
-                ij = my_iindx[i] - j;
-                type = (unsigned char)ptype[jindx[j] + i];
-                if(!type) continue;
-                u2 = j - l - 1;
-                qe = (type > 2) ? pf_params->expTermAU : 1.;
-                tmp2 +=   probs[ij]
-                        * qe
-                        * (FLT_OR_DBL)expintern[u1 + u2]
-                        * pf_params->expmismatchI[type][S1[i+1]][S1[j-1]]
-                        * scale[u1 + u2 + 2];
-              }
-            }
-            probs[kl] += tmp2 * G[kl];
-          }
-        }
+            prml[ i]  =   prmt;
 
-        if(l < n){
-          for(k = 4; k <= l - VRNA_GQUAD_MIN_BOX_SIZE + 1; k++){
-            kl = my_iindx[k]-l;
-            if (G[kl]==0.) continue;
-            tmp2 = 0.;
-            j = l + 1;
-            for (i=MAX2(1,k-MAXLOOP-1); i < k - 3; i++){
-              ij = my_iindx[i] - j;
-              type = (unsigned char)ptype[jindx[j] + i];
-              if(!type) continue;
-              u2 = k - i - 1;
-              qe = (type > 2) ? pf_params->expTermAU : 1.;
-              tmp2 +=   probs[ij]
-                      * qe
-                      * (FLT_OR_DBL)expintern[u2]
-                      * pf_params->expmismatchI[type][S1[i+1]][S1[j-1]]
-                      * scale[u2 + 2];
-            }
-            probs[kl] += tmp2 * G[kl];
-          }
-        }
-      }
-
-      /* 3. bonding k,l as substem of multi-loop enclosed by i,j */
-      prm_MLb = 0.;
-
-      if(with_ud){
-        for(u = 0; u <= ud_max_size; u++)
-          prm_MLbu[u] = 0.;
-      }
-
-      if (l<n)
-        for (k = 2; k < l - turn; k++) {
-          kl    = my_iindx[k] - l;
-          i     = k - 1;
-          prmt  = prmt1 = 0.0;
-
-          int lj;
-          short s3;
-          FLT_OR_DBL ppp;
-          ij = my_iindx[i] - (l+2);
-          lj = my_iindx[l+1]-(l+1);
-          s3 = S1[i+1];
-          for (j = l + 2; j<=n; j++, ij--, lj--){
-            if(hc_local[ij] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
-              tt = vrna_get_ptype_md(S[j], S[i], md);
-
-              /* which decomposition is covered here? =>
-                i + 1 = k < l < j:
-                (i,j)       -> enclosing pair
-                (k, l)      -> enclosed pair
-                (l+1, j-1)  -> multiloop part with at least one stem
-                a.k.a. (k,l) is left-most stem in multiloop closed by (k-1, j)
-              */
-              ppp = probs[ij]
-                    * exp_E_MLstem(tt, S1[j-1], s3, pf_params)
-                    * qm[lj];
+            ii = my_iindx[i];     /* ii-j=[i,j]     */
+            tt = vrna_get_ptype(jindx[l+1] + i, ptype);
+            tt = rtype[tt];
+            if(hc_local[ii - (l + 1)] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
+              prmt1 = probs[ii-(l+1)]
+                      * expMLclosing
+                      * exp_E_MLstem(tt, S1[l], S1[i+1], pf_params);
 
               if(sc){
+                /* which decompositions are covered here? => (i, l+1) -> enclosing pair */
                 if(sc->exp_energy_bp)
-                  ppp *= sc->exp_energy_bp[ij];
-/*
+                  prmt1 *= sc->exp_energy_bp[ii - (l+1)];
+
+  /*
                 if(sc->exp_f)
-                  ppp *= sc->exp_f(i, j, l+1, j-1, , sc->data);
-*/
+                  prmt1 *= sc->exp_f(i, l+1, k, l, , sc->data);
+  */
               }
-              prmt += ppp;
             }
-          }
-          prmt *= expMLclosing;
 
+            /* l+1 is unpaired */
+            if(hc->up_ml[l+1]){
+              ppp = prm_l1[i] * expMLbase[1];
+              if(sc){
+                if(sc->exp_energy_up)
+                  ppp *= sc->exp_energy_up[l+1][1];
 
-          prml[ i]  =   prmt;
+  /*
+                if(sc_exp_f)
+                  ppp *= sc->exp_f(, sc->data);
+  */
+              }
 
-          ii = my_iindx[i];     /* ii-j=[i,j]     */
-          tt = vrna_get_ptype(jindx[l+1] + i, ptype);
-          tt = rtype[tt];
-          if(hc_local[ii - (l + 1)] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
-            prmt1 = probs[ii-(l+1)]
-                    * expMLclosing
-                    * exp_E_MLstem(tt, S1[l], S1[i+1], pf_params);
+              /* add contributions of MB loops where any unstructured domain starts at l+1 */
+              if(with_ud){
+                int cnt;
+                for(cnt = 0; cnt < domains_up->uniq_motif_count; cnt++){
+                  u = domains_up->uniq_motif_size[cnt];
+                  if(hc->up_ml[l+1] >= u){
+                    if(l + u < n){
+                      temp =    domains_up->exp_energy_cb(vc,
+                                                          l+1, l+u,
+                                                          VRNA_UNSTRUCTURED_DOMAIN_MB_LOOP | VRNA_UNSTRUCTURED_DOMAIN_MOTIF,
+                                                          domains_up->data)
+                              * pmlu[u][i]
+                              * expMLbase[u];
+
+                      if(sc){
+                        if(sc->exp_energy_up)
+                          temp *= sc->exp_energy_up[l+1][u];
+                      }
 
-            if(sc){
-              /* which decompositions are covered here? => (i, l+1) -> enclosing pair */
-              if(sc->exp_energy_bp)
-                prmt1 *= sc->exp_energy_bp[ii - (l+1)];
+                      ppp += temp;
+                    }
+                  }
+                }
+                pmlu[0][i] = ppp + prmt1;
+              }
 
-/*
-              if(sc->exp_f)
-                prmt1 *= sc->exp_f(i, l+1, k, l, , sc->data);
-*/
+              prm_l[i] = ppp + prmt1;
+            } else { /* skip configuration where l+1 is unpaired */
+              prm_l[i] = prmt1;
+
+              if(with_ud)
+                pmlu[0][i] = prmt1;
             }
-          }
 
-          /* l+1 is unpaired */
-          if(hc->up_ml[l+1]){
-            ppp = prm_l1[i] * expMLbase[1];
-            if(sc){
-              if(sc->exp_energy_up)
-                ppp *= sc->exp_energy_up[l+1][1];
+            /* i is unpaired */
+            if(hc->up_ml[i]){
+              ppp = prm_MLb * expMLbase[1];
+              if(sc){
+                if(sc->exp_energy_up)
+                  ppp *= sc->exp_energy_up[i][1];
 
-/*
-              if(sc_exp_f)
-                ppp *= sc->exp_f(, sc->data);
-*/
-            }
+  /*
+                if(sc->exp_f)
+                  ppp *= sc->exp_f(, sc->data);
+  */
+              }
 
-            /* add contributions of MB loops where any unstructured domain starts at l+1 */
-            if(with_ud){
-              int cnt;
-              for(cnt = 0; cnt < domains_up->uniq_motif_count; cnt++){
-                u = domains_up->uniq_motif_size[cnt];
-                if(hc->up_ml[l+1] >= u){
-                  if(l + u < n){
-                    temp =    domains_up->exp_energy_cb(vc,
-                                                        l+1, l+u,
+              if(with_ud){
+                int cnt;
+                for(cnt = 0; cnt < domains_up->uniq_motif_count; cnt++){
+                  u = domains_up->uniq_motif_size[cnt];
+                  if(hc->up_ml[i] >= u){
+                    temp =    prm_MLbu[u]
+                            * expMLbase[u]
+                            * domains_up->exp_energy_cb(vc,
+                                                        i, i+u,
                                                         VRNA_UNSTRUCTURED_DOMAIN_MB_LOOP | VRNA_UNSTRUCTURED_DOMAIN_MOTIF,
-                                                        domains_up->data)
-                            * pmlu[u][i]
-                            * expMLbase[u];
+                                                        domains_up->data);
 
                     if(sc){
                       if(sc->exp_energy_up)
-                        temp *= sc->exp_energy_up[l+1][u];
+                        temp *= sc->exp_energy_up[i][u];
                     }
-
                     ppp += temp;
                   }
                 }
+                prm_MLbu[0] = ppp + prml[i];
               }
-              pmlu[0][i] = ppp + prmt1;
-            }
 
-            prm_l[i] = ppp + prmt1;
-          } else { /* skip configuration where l+1 is unpaired */
-            prm_l[i] = prmt1;
+              prm_MLb = ppp + prml[i];
+              /* same as:    prm_MLb = 0;
+                 for (i=1; i<=k-1; i++) prm_MLb += prml[i]*expMLbase[k-i-1]; */
 
-            if(with_ud)
-              pmlu[0][i] = prmt1;
-          }
-
-          /* i is unpaired */
-          if(hc->up_ml[i]){
-            ppp = prm_MLb * expMLbase[1];
-            if(sc){
-              if(sc->exp_energy_up)
-                ppp *= sc->exp_energy_up[i][1];
+            } else { /* skip all configurations where i is unpaired */
+              prm_MLb = prml[i];
 
-/*
-              if(sc->exp_f)
-                ppp *= sc->exp_f(, sc->data);
-*/
+              if(with_ud)
+                prm_MLbu[0] = prml[i];
             }
 
-            if(with_ud){
-              int cnt;
-              for(cnt = 0; cnt < domains_up->uniq_motif_count; cnt++){
-                u = domains_up->uniq_motif_size[cnt];
-                if(hc->up_ml[i] >= u){
-                  temp =    prm_MLbu[u]
-                          * expMLbase[u]
-                          * domains_up->exp_energy_cb(vc,
-                                                      i, i+u,
-                                                      VRNA_UNSTRUCTURED_DOMAIN_MB_LOOP | VRNA_UNSTRUCTURED_DOMAIN_MOTIF,
-                                                      domains_up->data);
+            prml[i] = prml[i] + prm_l[i];
 
-                  if(sc){
-                    if(sc->exp_energy_up)
-                      temp *= sc->exp_energy_up[i][u];
-                  }
-                  ppp += temp;
-                }
-              }
-              prm_MLbu[0] = ppp + prml[i];
-            }
-
-            prm_MLb = ppp + prml[i];
-            /* same as:    prm_MLb = 0;
-               for (i=1; i<=k-1; i++) prm_MLb += prml[i]*expMLbase[k-i-1]; */
+            tt = ptype[jindx[l] + k];
 
-          } else { /* skip all configurations where i is unpaired */
-            prm_MLb = prml[i];
+            if(with_gquad){
+              if ((!tt) && (gquad_mx_get_pf(G, k, l) == 0.)) continue;
+            } else {
+              if (qb[kl] == 0.) continue;
+            }
 
-            if(with_ud)
-              prm_MLbu[0] = prml[i];
-          }
+            if(hc_local[kl] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC){
 
-          prml[i] = prml[i] + prm_l[i];
+              temp = prm_MLb;
 
-          tt = ptype[jindx[l] + k];
+              for (i=1;i<=k-2; i++)
+                temp += prml[i]*qm[my_iindx[i+1] - (k-1)];
 
-          if(with_gquad){
-            if ((!tt) && (G[kl] == 0.)) continue;
-          } else {
-            if (qb[kl] == 0.) continue;
-          }
-
-          if(hc_local[kl] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC){
-
-            temp = prm_MLb;
+              if(with_gquad){
+                if(tt)
+                  temp    *= exp_E_MLstem(tt, (k>1) ? S1[k-1] : -1, (l<n) ? S1[l+1] : -1, pf_params) * scale[2];
+                else
+                  temp    *= gquad_mx_get_pf(G, k, l) * expMLstem * scale[2];
+              } else {
 
-            for (i=1;i<=k-2; i++)
-              temp += prml[i]*qm[my_iindx[i+1] - (k-1)];
+                if(tt == 0)
+                  tt = 7;
 
-            if(with_gquad){
-              if(tt)
                 temp    *= exp_E_MLstem(tt, (k>1) ? S1[k-1] : -1, (l<n) ? S1[l+1] : -1, pf_params) * scale[2];
-              else
-                temp    *= G[kl] * expMLstem * scale[2];
-            } else {
-
-              if(tt == 0)
-                tt = 7;
+              }
 
-              temp    *= exp_E_MLstem(tt, (k>1) ? S1[k-1] : -1, (l<n) ? S1[l+1] : -1, pf_params) * scale[2];
+              probs[kl]  += temp;
             }
 
-            probs[kl]  += temp;
-          }
-
-          if (probs[kl]>Qmax) {
-            Qmax = probs[kl];
-            if (Qmax>max_real/10.)
-              vrna_message_warning("P close to overflow: %d %d %g %g\n",
-                                   k, l, probs[kl], qb[kl]);
-          }
+            if (probs[kl]>Qmax) {
+              Qmax = probs[kl];
+              if (Qmax>max_real/10.)
+                vrna_message_warning("P close to overflow: %d %d %g %g\n",
+                                     k, l, probs[kl], qb[kl]);
+            }
 
-          if (probs[kl]>=max_real) {
-            ov++;
-            probs[kl]=FLT_MAX;
-          }
+            if (probs[kl]>=max_real) {
+              ov++;
+              probs[kl]=FLT_MAX;
+            }
 
-          /* rotate prm_MLbu entries required for unstructured domain feature */
-          if(with_ud){
-            for(u = ud_max_size; u > 0; u--)
-              prm_MLbu[u] = prm_MLbu[u - 1];
-          }
-        } /* end for (k=..) */
+            /* rotate prm_MLbu entries required for unstructured domain feature */
+            if(with_ud){
+              for(u = ud_max_size; u > 0; u--)
+                prm_MLbu[u] = prm_MLbu[u - 1];
+            }
+          } /* end for (k=..) */
 
-      /* rotate prm_l and prm_l1 arrays */
-      tmp = prm_l1; prm_l1=prm_l; prm_l=tmp;
+        /* rotate prm_l and prm_l1 arrays */
+        tmp = prm_l1; prm_l1=prm_l; prm_l=tmp;
 
-      /* rotate pmlu entries required for unstructured domain feature */
-      if(with_ud){
-        tmp = pmlu[ud_max_size];
-        for(u = ud_max_size; u > 0; u--)
-          pmlu[u] = pmlu[u - 1];
-        pmlu[0] = tmp;
-      }
-    }  /* end for (l=..)   */
+        /* rotate pmlu entries required for unstructured domain feature */
+        if(with_ud){
+          tmp = pmlu[ud_max_size];
+          for(u = ud_max_size; u > 0; u--)
+            pmlu[u] = pmlu[u - 1];
+          pmlu[0] = tmp;
+        }
+      }  /* end for (l=..)   */
+    }
 
     if(with_ud_outside){
       /*
@@ -774,73 +639,524 @@ pf_create_bppm( vrna_fold_compound_t *vc,
           if (qb[ij] > 0.)
             probs[ij] *= qb[ij];
 
-          if (G[ij] > 0.){
-            probs[ij] += q1k[i-1] * G[ij] * qln[j+1]/q1k[n];
+          if (gquad_mx_get_pf(G, i, j) > 0.){
+            probs[ij] += q1k[i-1] * gquad_mx_get_pf(G, i, j) * qln[j+1]/q1k[n];
+          }
+        } else {
+          if (qb[ij] > 0.)
+            probs[ij] *= qb[ij];
+        }
+      }
+
+    if (structure!=NULL){
+      char *s = vrna_db_from_probs(probs, (unsigned int)n);
+      memcpy(structure, s, n);
+      structure[n] = '\0';
+      free(s);
+    }
+    if(ov > 0)
+      vrna_message_warning("%d overflows occurred while backtracking;\n"
+                                  "you might try a smaller pf_scale than %g\n",
+                                  ov, pf_params->pf_scale);
+
+    /* clean up */
+    free(prm_l);
+    free(prm_l1);
+    free(prml);
+
+    if(with_ud){
+      for(u = 0; u <= ud_max_size; u++)
+        free(pmlu[u]);
+      free(pmlu);
+      free(prm_MLbu);
+    }
+
+    free(hc_local);
+  } /* end if 'check for forward recursion' */
+  else {
+    vrna_message_warning("bppm calculations have to be done after calling forward recursion");
+    return 0;
+  }
+#if 0
+  if(with_ud_outside){
+    for(i = 1; i <= n; i++)
+      for(j = i; j <= n; j++){
+        FLT_OR_DBL p, pp;
+        pp = 0.;
+        p = domains_up->probs_get(vc, i, j, VRNA_UNSTRUCTURED_DOMAIN_EXT_LOOP, 0, domains_up->data);
+        if(p > 0.)
+          printf("p_ext[0][%d,%d] = %g\n", i, j, p);
+        pp += p;
+        p = domains_up->probs_get(vc, i, j, VRNA_UNSTRUCTURED_DOMAIN_HP_LOOP, 0, domains_up->data);
+        pp += p;
+        if(p > 0.)
+          printf("p_hp[0][%d,%d] = %g\n", i, j, p);
+        p = domains_up->probs_get(vc, i, j, VRNA_UNSTRUCTURED_DOMAIN_INT_LOOP, 0, domains_up->data);
+        pp += p;
+        if(p > 0.)
+          printf("p_int[0][%d,%d] = %g\n", i, j, p);
+        p = domains_up->probs_get(vc, i, j, VRNA_UNSTRUCTURED_DOMAIN_MB_LOOP, 0, domains_up->data);
+        pp += p;
+        if(p > 0.)
+          printf("p_ml[0][%d,%d] = %g\n", i, j, p);
+        if(pp > 0.)
+          printf("p[0][%d,%d] = %g\n", i, j, pp);
+      }
+  }
+#endif
+
+  return 1;
+}
+
+
+/*
+    bonding (k,l) as substem of interior loop enclosed by (i,j), i.e.
+    all contributions to probs[kl] stem from pairs (i,j) of larger span
+*/
+PRIVATE INLINE void
+outside_int_loops(vrna_fold_compound_t *vc,
+                  unsigned char *hc_local,
+                  int k,
+                  int l,
+                  vrna_ep_t **bp_correction,
+                  int *corr_cnt,
+                  int *corr_size){
+
+  int               n, i, j, ij, kl, u1, u2, *my_iindx, *jindx, *rtype, *hc_up_int, with_ud;
+  unsigned char     type, type_2;
+  char              *ptype;
+  short             *S1;
+  FLT_OR_DBL        temp, tmp2, *qb, *probs, *scale;
+  vrna_exp_param_t  *pf_params;
+  vrna_sc_t         *sc;
+  vrna_ud_t         *domains_up;
+
+  n           = vc->length;
+  my_iindx    = vc->iindx;
+  jindx       = vc->jindx;
+  ptype       = vc->ptype;
+  S1          = vc->sequence_encoding;
+  pf_params   = vc->exp_params;
+  rtype       = &(pf_params->model_details.rtype[0]);
+  hc_up_int   = vc->hc->up_int;
+  sc          = vc->sc;
+  domains_up  = vc->domains_up;
+  with_ud     = (domains_up && domains_up->exp_energy_cb) ? 1 : 0;
+  qb          = vc->exp_matrices->qb;
+  probs       = vc->exp_matrices->probs;
+  scale       = vc->exp_matrices->scale;
+
+  kl      = my_iindx[k]-l;
+  type_2  = rtype[vrna_get_ptype(jindx[l] + k, ptype)];
+
+  if (qb[kl]==0.) return;
+
+  if(hc_local[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC){
+    for(i = MAX2(1, k - MAXLOOP - 1); i <= k - 1; i++){
+      u1 = k - i - 1;
+      if(hc_up_int[i+1] < u1) continue;
+
+      for(j = l + 1; j <= MIN2(l + MAXLOOP - k + i + 2, n); j++){
+        u2 = j-l-1;
+        if(hc_up_int[l+1] < u2) break;
+
+        ij = my_iindx[i] - j;
+        if(hc_local[ij] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP){
+          type = vrna_get_ptype(jindx[j] + i, ptype);
+
+          if(probs[ij] > 0){
+            tmp2 =  probs[ij]
+                    * scale[u1 + u2 + 2]
+                    * exp_E_IntLoop(u1, u2, type, type_2, S1[i+1], S1[j-1], S1[k-1], S1[l+1], pf_params);
+
+            if(sc){
+              if(sc->exp_energy_up)
+                tmp2 *=   sc->exp_energy_up[i+1][u1]
+                        * sc->exp_energy_up[l+1][u2];
+
+              if(sc->exp_energy_bp)
+                tmp2 *=   sc->exp_energy_bp[ij];
+
+              if(sc->exp_energy_stack){
+                if((i+1 == k) && (j-1 == l)){
+                  tmp2 *=   sc->exp_energy_stack[i]
+                          * sc->exp_energy_stack[k]
+                          * sc->exp_energy_stack[l]
+                          * sc->exp_energy_stack[j];
+                }
+              }
+
+              if(sc->exp_f)
+                tmp2 *= sc->exp_f(i, j, k, l, VRNA_DECOMP_PAIR_IL, sc->data);
+            }
+
+            if(with_ud){
+              FLT_OR_DBL qql, qqr;
+
+              qql = qqr = 0.;
+
+              if(u1 > 0)
+                qql = domains_up->exp_energy_cb(vc,
+                                                i+1, k-1,
+                                                VRNA_UNSTRUCTURED_DOMAIN_INT_LOOP,
+                                                domains_up->data);
+              if(u2 > 0)
+                qqr = domains_up->exp_energy_cb(vc,
+                                                l+1, j-1,
+                                                VRNA_UNSTRUCTURED_DOMAIN_INT_LOOP,
+                                                domains_up->data);
+              temp  = tmp2;
+              tmp2 += temp * qql;
+              tmp2 += temp * qqr;
+              tmp2 += temp * qql * qqr;
+            }
+
+            if(sc && sc->exp_f && sc->bt){ /* store probability correction for auxiliary pairs in interior loop motif */
+              vrna_basepair_t *ptr, *aux_bps;
+              aux_bps = sc->bt(i, j, k, l, VRNA_DECOMP_PAIR_IL, sc->data);
+              for(ptr = aux_bps; ptr && ptr->i != 0; ptr++){
+                (*bp_correction)[*corr_cnt].i = ptr->i;
+                (*bp_correction)[*corr_cnt].j = ptr->j;
+                (*bp_correction)[(*corr_cnt)++].p = tmp2 * qb[kl];
+                if(*corr_cnt == *corr_size){
+                  *corr_size += 5;
+                  *bp_correction = vrna_realloc(*bp_correction, sizeof(vrna_ep_t) * (*corr_size));
+                }
+              }
+              free(aux_bps);
+            }
+
+            probs[kl] += tmp2;
+          }
+        }
+      }
+    }
+  }
+}
+
+
+/*
+    bonding (k,l) as gquad enclosed by (i,j)
+*/
+PRIVATE INLINE void
+outside_gquad(vrna_fold_compound_t *vc,
+              int k,
+              int l){
+
+  int               n, i, j, ij, kl, u1, u2, *my_iindx, *jindx;
+  unsigned char     type;
+  char              *ptype;
+  short             *S1;
+  double            *expintern;
+  FLT_OR_DBL        qe, qg, tmp2, *probs, *scale;
+  vrna_exp_param_t  *pf_params;
+
+  n         = vc->length;
+  my_iindx  = vc->iindx;
+  jindx     = vc->jindx;
+  ptype     = vc->ptype;
+  S1        = vc->sequence_encoding;
+  pf_params = vc->exp_params;
+  expintern = &(pf_params->expinternal[0]);
+  probs     = vc->exp_matrices->probs;
+  scale     = vc->exp_matrices->scale;
+  kl        = my_iindx[k] - l;
+  qg        = gquad_mx_get_pf(vc->exp_matrices->G, k, l);
+
+  if(qg == 0.)
+    return;
+
+  if((l < n - 3) && (k >= 2)){
+    tmp2 = 0.;
+    i = k - 1;
+    for(j = MIN2(l + MAXLOOP + 1, n); j > l + 3; j--){
+      ij = my_iindx[i] - j;
+      type = (unsigned char)ptype[jindx[j] + i];
+      if(!type) continue;
+      u1 = j - l - 1;
+      qe = (type > 2) ? pf_params->expTermAU : 1.;
+      tmp2 +=   probs[ij]
+              * qe
+              * (FLT_OR_DBL)expintern[u1]
+              * pf_params->expmismatchI[type][S1[i+1]][S1[j-1]]
+              * scale[u1 + 2];
+    }
+    probs[kl] += tmp2 * qg;
+  }
+
+  if ((l < n - 1) && (k >= 3)){
+    tmp2 = 0.;
+    for (i=MAX2(1,k-MAXLOOP-1); i<=k-2; i++){
+      u1 = k - i - 1;
+      for (j=l+2; j<=MIN2(l + MAXLOOP - u1 + 1,n); j++) {
+        ij = my_iindx[i] - j;
+        type = (unsigned char)ptype[jindx[j] + i];
+        if(!type) continue;
+        u2 = j - l - 1;
+        qe = (type > 2) ? pf_params->expTermAU : 1.;
+        tmp2 +=   probs[ij]
+                * qe
+                * (FLT_OR_DBL)expintern[u1 + u2]
+                * pf_params->expmismatchI[type][S1[i+1]][S1[j-1]]
+                * scale[u1 + u2 + 2];
+      }
+    }
+    probs[kl] += tmp2 * qg;
+  }
+
+  if((l < n) && (k >= 4)){
+    tmp2 = 0.;
+    j = l + 1;
+    for (i=MAX2(1,k-MAXLOOP-1); i < k - 3; i++){
+      ij = my_iindx[i] - j;
+      type = (unsigned char)ptype[jindx[j] + i];
+      if(!type) continue;
+      u2 = k - i - 1;
+      qe = (type > 2) ? pf_params->expTermAU : 1.;
+      tmp2 +=   probs[ij]
+              * qe
+              * (FLT_OR_DBL)expintern[u2]
+              * pf_params->expmismatchI[type][S1[i+1]][S1[j-1]]
+              * scale[u2 + 2];
+    }
+    probs[kl] += tmp2 * qg;
+  }
+}
+
+
+/*
+    Outside recursion for base pair probabilities along anti-diagonals of
+    decreasing span d = l - k. All contributions to probs[kl] stem from
+    pairs (i,j) with i <= k < l <= j and larger span, so the entire
+    anti-diagonal may be processed in parallel. The multibranch loop helper
+    arrays of the column-wise recursion in pf_create_bppm() are kept per
+    (i,l) instead, i.e. prm_l and prm_MLb for the two most recent spans and
+    prml for the entire triangle. Each entry accumulates its contributions
+    in the same order as the column-wise recursion, so the probabilities
+    are bit-identical to the serial computation for any number of threads.
+*/
+PRIVATE void
+outside_wavefront(vrna_fold_compound_t *vc,
+                  unsigned char *hc_local,
+                  int *ov){
+
+  int               n, d, i, j, k, l, ij, kl, lj, ii, s, turn, dmin, with_gquad, *my_iindx, *jindx, *rtype;
+  unsigned char     tt;
+  char              *ptype;
+  short             *S, *S1, s3;
+  FLT_OR_DBL        temp, ppp, prmt, prmt1, Qmax, expMLstem, expMLclosing, max_real,
+                    *prm_l, *prm_l1, *prm_MLb, *prm_MLb1, *prml, *tmp,
+                    *qb, *qm, *probs, *scale, *expMLbase;
+  vrna_gquad_mx_t   *G;
+  vrna_exp_param_t  *pf_params;
+  vrna_md_t         *md;
+  vrna_hc_t         *hc;
+  vrna_sc_t         *sc;
+
+  n             = vc->length;
+  my_iindx      = vc->iindx;
+  jindx         = vc->jindx;
+  ptype         = vc->ptype;
+  S             = vc->sequence_encoding2;
+  S1            = vc->sequence_encoding;
+  pf_params     = vc->exp_params;
+  md            = &(pf_params->model_details);
+  rtype         = &(md->rtype[0]);
+  turn          = md->min_loop_size;
+  with_gquad    = md->gquad;
+  hc            = vc->hc;
+  sc            = vc->sc;
+  qb            = vc->exp_matrices->qb;
+  qm            = vc->exp_matrices->qm;
+  G             = vc->exp_matrices->G;
+  probs         = vc->exp_matrices->probs;
+  scale         = vc->exp_matrices->scale;
+  expMLbase     = vc->exp_matrices->expMLbase;
+  expMLclosing  = pf_params->expMLclosing;
+  expMLstem     = (with_gquad) ? exp_E_MLstem(0, -1, -1, pf_params) : 0;
+  max_real      = (sizeof(FLT_OR_DBL) == sizeof(float)) ? FLT_MAX : DBL_MAX;
+  Qmax          = 0.;
+
+  /* gquads may be enclosed in spans shorter than turn + 1 */
+  dmin = turn + 1;
+  if(with_gquad)
+    dmin = MIN2(dmin, VRNA_GQUAD_MIN_BOX_SIZE - 1);
+
+  prm_l     = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  prm_l1    = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  prm_MLb   = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  prm_MLb1  = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  prml      = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (((n + 1) * (n + 2)) / 2 + 2));
+
+#ifdef _OPENMP
+#pragma omp parallel private(d, i, j, k, l, ij, kl, lj, ii, s, tt, s3, temp, ppp, prmt, prmt1)
+#endif
+  for(d = n - 1; d >= dmin; d--){
+    /*
+        1. multiloop helper arrays for (i,l) with span s = d + 1, where
+        prm_l1[i] = prm_l(i,l+1) and prm_MLb1[i - 1] = prm_MLb(i-1,l)
+        still hold the values of span s + 1
+    */
+    s = d + 1;
+    if(s >= turn + 2){
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for(i = 1; i <= n - s; i++){
+        l = i + s;
+        if(l == n){
+          prm_l[i] = prm_MLb[i] = 0.;
+          continue;
+        }
+
+        prmt = prmt1 = 0.0;
+        ij = my_iindx[i] - (l+2);
+        lj = my_iindx[l+1]-(l+1);
+        s3 = S1[i+1];
+        for (j = l + 2; j<=n; j++, ij--, lj--){
+          if(hc_local[ij] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
+            tt  = vrna_get_ptype_md(S[j], S[i], md);
+            ppp = probs[ij]
+                  * exp_E_MLstem(tt, S1[j-1], s3, pf_params)
+                  * qm[lj];
+
+            if(sc && sc->exp_energy_bp)
+              ppp *= sc->exp_energy_bp[ij];
+
+            prmt += ppp;
+          }
+        }
+        prmt *= expMLclosing;
+
+        ii = my_iindx[i];
+        tt = rtype[vrna_get_ptype(jindx[l+1] + i, ptype)];
+        if(hc_local[ii - (l + 1)] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
+          prmt1 = probs[ii-(l+1)]
+                  * expMLclosing
+                  * exp_E_MLstem(tt, S1[l], S1[i+1], pf_params);
+
+          if(sc && sc->exp_energy_bp)
+            prmt1 *= sc->exp_energy_bp[ii - (l+1)];
+        }
+
+        /* l+1 is unpaired */
+        if(hc->up_ml[l+1]){
+          ppp = prm_l1[i] * expMLbase[1];
+          if(sc && sc->exp_energy_up)
+            ppp *= sc->exp_energy_up[l+1][1];
+
+          prm_l[i] = ppp + prmt1;
+        } else {
+          prm_l[i] = prmt1;
+        }
+
+        /* i is unpaired */
+        if(hc->up_ml[i]){
+          ppp = prm_MLb1[i - 1] * expMLbase[1];
+          if(sc && sc->exp_energy_up)
+            ppp *= sc->exp_energy_up[i][1];
+
+          prm_MLb[i] = ppp + prmt;
+        } else {
+          prm_MLb[i] = prmt;
+        }
+
+        prml[jindx[l] + i] = prmt + prm_l[i];
+      }
+    }
+
+    /* 2. all pairs (k,l) with span d */
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+    for(k = 1; k <= n - d; k++){
+      l   = k + d;
+      kl  = my_iindx[k] - l;
+
+      if(l <= turn + 1)
+        continue;
+
+      if(d > turn)
+        outside_int_loops(vc, hc_local, k, l, NULL, NULL, NULL);
+
+      if((with_gquad) && (k >= 2) && (k <= l - VRNA_GQUAD_MIN_BOX_SIZE + 1))
+        outside_gquad(vc, k, l);
+
+      if((d <= turn) || (l == n) || (k < 2))
+        continue;
+
+      tt = ptype[jindx[l] + k];
+
+      if(with_gquad){
+        if ((!tt) && (gquad_mx_get_pf(G, k, l) == 0.)) continue;
+      } else {
+        if (qb[kl] == 0.) continue;
+      }
+
+      if(hc_local[kl] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC){
+        temp = prm_MLb[k - 1];
+
+        for (i=1;i<=k-2; i++)
+          temp += prml[jindx[l] + i]*qm[my_iindx[i+1] - (k-1)];
+
+        if(with_gquad){
+          if(tt)
+            temp    *= exp_E_MLstem(tt, (k>1) ? S1[k-1] : -1, (l<n) ? S1[l+1] : -1, pf_params) * scale[2];
+          else
+            temp    *= gquad_mx_get_pf(G, k, l) * expMLstem * scale[2];
+        } else {
+
+          if(tt == 0)
+            tt = 7;
+
+          temp    *= exp_E_MLstem(tt, (k>1) ? S1[k-1] : -1, (l<n) ? S1[l+1] : -1, pf_params) * scale[2];
+        }
+
+        probs[kl]  += temp;
+      }
+    }
+
+    /* 3. overflow checks and rotation of helper arrays once the anti-diagonal is complete */
+#ifdef _OPENMP
+#pragma omp single
+#endif
+    {
+      if(d > turn){
+        for(k = 2; k <= n - d - 1; k++){
+          l   = k + d;
+          kl  = my_iindx[k] - l;
+          tt  = ptype[jindx[l] + k];
+
+          if(with_gquad){
+            if ((!tt) && (gquad_mx_get_pf(G, k, l) == 0.)) continue;
+          } else {
+            if (qb[kl] == 0.) continue;
+          }
+
+          if (probs[kl]>Qmax) {
+            Qmax = probs[kl];
+            if (Qmax>max_real/10.)
+              vrna_message_warning("P close to overflow: %d %d %g %g\n",
+                                   k, l, probs[kl], qb[kl]);
+          }
+
+          if (probs[kl]>=max_real) {
+            (*ov)++;
+            probs[kl]=FLT_MAX;
           }
-        } else {
-          if (qb[ij] > 0.)
-            probs[ij] *= qb[ij];
         }
       }
 
-    if (structure!=NULL){
-      char *s = vrna_db_from_probs(probs, (unsigned int)n);
-      memcpy(structure, s, n);
-      structure[n] = '\0';
-      free(s);
-    }
-    if(ov > 0)
-      vrna_message_warning("%d overflows occurred while backtracking;\n"
-                                  "you might try a smaller pf_scale than %g\n",
-                                  ov, pf_params->pf_scale);
-
-    /* clean up */
-    free(prm_l);
-    free(prm_l1);
-    free(prml);
-
-    if(with_ud){
-      for(u = 0; u <= ud_max_size; u++)
-        free(pmlu[u]);
-      free(pmlu);
-      free(prm_MLbu);
+      tmp = prm_l1; prm_l1 = prm_l; prm_l = tmp;
+      tmp = prm_MLb1; prm_MLb1 = prm_MLb; prm_MLb = tmp;
     }
-
-    free(hc_local);
-  } /* end if 'check for forward recursion' */
-  else {
-    vrna_message_warning("bppm calculations have to be done after calling forward recursion");
-    return 0;
-  }
-#if 0
-  if(with_ud_outside){
-    for(i = 1; i <= n; i++)
-      for(j = i; j <= n; j++){
-        FLT_OR_DBL p, pp;
-        pp = 0.;
-        p = domains_up->probs_get(vc, i, j, VRNA_UNSTRUCTURED_DOMAIN_EXT_LOOP, 0, domains_up->data);
-        if(p > 0.)
-          printf("p_ext[0][%d,%d] = %g\n", i, j, p);
-        pp += p;
-        p = domains_up->probs_get(vc, i, j, VRNA_UNSTRUCTURED_DOMAIN_HP_LOOP, 0, domains_up->data);
-        pp += p;
-        if(p > 0.)
-          printf("p_hp[0][%d,%d] = %g\n", i, j, p);
-        p = domains_up->probs_get(vc, i, j, VRNA_UNSTRUCTURED_DOMAIN_INT_LOOP, 0, domains_up->data);
-        pp += p;
-        if(p > 0.)
-          printf("p_int[0][%d,%d] = %g\n", i, j, p);
-        p = domains_up->probs_get(vc, i, j, VRNA_UNSTRUCTURED_DOMAIN_MB_LOOP, 0, domains_up->data);
-        pp += p;
-        if(p > 0.)
-          printf("p_ml[0][%d,%d] = %g\n", i, j, p);
-        if(pp > 0.)
-          printf("p[0][%d,%d] = %g\n", i, j, pp);
-      }
   }
-#endif
 
-  return 1;
+  free(prm_l);
+  free(prm_l1);
+  free(prm_MLb);
+  free(prm_MLb1);
+  free(prml);
 }
 
 
@@ -3295,209 +3611,466 @@ alipf_create_bppm(vrna_fold_compound_t *vc,
       }
     }
   } /* end if(!circular)  */
-  for (l=n; l>TURN+1; l--) {
+  if(md->wavefront){
+    /* 2. - 3. along anti-diagonals, see ali_outside_wavefront() */
+    ali_outside_wavefront(vc, &ov);
+  } else {
+    for (l=n; l>TURN+1; l--) {
 
-    /* 2. bonding k,l as substem of 2:loop enclosed by i,j */
-    for (k=1; k<l-TURN; k++) {
-      pp = 0.;
-      kl = my_iindx[k]-l;
-      if (qb[kl] == 0.) continue;
-      if(!(hard_constraints[jindx[l] + k] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC)) continue;
+      /* 2. bonding k,l as substem of 2:loop enclosed by i,j */
+      for (k=1; k<l-TURN; k++)
+        ali_outside_int_loops(vc, k, l, type);
+
+      /* 3. bonding k,l as substem of multi-loop enclosed by i,j */
+      prm_MLb = 0.;
+      if (l<n)
+        for (k=2; k<l-TURN; k++) {
+        i = k-1;
+        prmt = prmt1 = 0.;
 
-      for (s=0; s<n_seq; s++)
-        type[s] = vrna_get_ptype_md(S[s][l], S[s][k], md);
+        if(1 /* hard_constraints[jindx[l] + k] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC */){
+          ii = my_iindx[i];     /* ii-j=[i,j]     */
+          ll = my_iindx[l+1];   /* ll-j=[l+1,j-1] */
+          if(hard_constraints[jindx[l+1] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
+            prmt1 = probs[ii-(l+1)];
+            for (s=0; s<n_seq; s++) {
+              tt = vrna_get_ptype_md(S[s][l+1], S[s][i], md);
+              prmt1 *= exp_E_MLstem(tt, S5[s][l+1], S3[s][i], pf_params) * expMLclosing;
+            }
 
-      for (i=MAX2(1,k-MAXLOOP-1); i<=k-1; i++){
-        if(hc->up_int[i+1] < k - i - 1)
-          continue;
+            if(sc)
+              for(s = 0; s < n_seq; s++){
+                if(sc[s]){
+                  if(sc[s]->exp_energy_bp)
+                    prmt1 *= sc[s]->exp_energy_bp[jindx[l+1] + i];
+                }
+              }
+          }
+
+          for (j=l+2; j<=n; j++){
+            pp = 1.;
+            if(probs[ii-j]==0) continue;
+            if(!(hard_constraints[jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP)) continue;
+
+            for (s=0; s<n_seq; s++) {
+              tt = vrna_get_ptype_md(S[s][j], S[s][i], md);
+              pp *=  exp_E_MLstem(tt, S5[s][j], S3[s][i], pf_params) * expMLclosing;
+            }
+
+            if(sc)
+              for(s = 0; s < n_seq; s++){
+                if(sc[s]){
+                  if(sc[s]->exp_energy_bp)
+                    pp *= sc[s]->exp_energy_bp[jindx[j] + i];
+                }
+              }
+
+            prmt +=  probs[ii-j] * pp * qm[ll-(j-1)];
+          }
+          kl = my_iindx[k]-l;
+
+          prml[ i] = prmt;
+
+          pp = 0.;
+          if(hc->up_ml[l+1]){
+            pp = prm_l1[i] * expMLbase[1];
+            if(sc)
+              for(s = 0; s < n_seq; s++){
+                if(sc[s]){
+                  if(sc[s]->exp_energy_up)
+                    pp *= sc[s]->exp_energy_up[a2s[s][l+1]][1];
+                }
+              }
+          }
+          prm_l[i] = pp + prmt1; /* expMLbase[1]^n_seq */
+
+          pp = 0.;
+          if(hc->up_ml[i]){
+            pp = prm_MLb * expMLbase[1];
+            if(sc)
+              for(s = 0; s < n_seq; s++){
+                if(sc[s]){
+                  if(sc[s]->exp_energy_up)
+                    pp *= sc[s]->exp_energy_up[a2s[s][i]][1];
+                }
+              }
+          }
+          prm_MLb = pp + prml[i];
+
+          /* same as:    prm_MLb = 0;
+             for (i=1; i<=k-1; i++) prm_MLb += prml[i]*expMLbase[k-i-1]; */
+
+          prml[i] = prml[ i] + prm_l[i];
 
-        for (j=l+1; j<=MIN2(l+ MAXLOOP -k+i+2,n); j++) {
-          FLT_OR_DBL qloop=1;
-          ij = my_iindx[i] - j;
+          if (qb[kl] == 0.) continue;
 
-          if(probs[ij] == 0.) continue;
-          if(!(hard_constraints[jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP)) continue;
-          if(hc->up_int[l+1] < j - l - 1) break;
+          temp = prm_MLb;
+
+          for (i=1;i<=k-2; i++)
+            temp += prml[i]*qm[my_iindx[i+1] - (k-1)];
 
           for (s=0; s<n_seq; s++) {
-            int typ, u1, u2;
-            u1 = a2s[s][k-1] - a2s[s][i];
-            u2 = a2s[s][j-1] - a2s[s][l];
-            typ = vrna_get_ptype_md(S[s][i], S[s][j], md);
-            qloop *=  exp_E_IntLoop(u1, u2, typ, type[s], S3[s][i], S5[s][j], S5[s][k], S3[s][l], pf_params);
+            tt = vrna_get_ptype_md(S[s][k], S[s][l], md);
+            temp *= exp_E_MLstem(tt, S5[s][k], S3[s][l], pf_params);
           }
+          probs[kl] += temp * scale[2] * exp(pscore[jindx[l]+k]/kTn);
+        } else { /* (k,l) not allowed to be substem of multiloop closed by (i,j) */
+          prml[i] = prm_l[i] = prm_l1[i] = 0.;
+        }
+
+  #ifdef USE_FLOAT_PF
+        if (probs[kl]>Qmax) {
+          Qmax = probs[kl];
+          if (Qmax>FLT_MAX/10.)
+            vrna_message_warning("%d %d %g %g\n", i,j,probs[kl],qb[kl]);
+        }
+        if (probs[kl]>FLT_MAX) {
+          ov++;
+          probs[kl]=FLT_MAX;
+        }
+  #endif
+      } /* end for (k=2..) */
+      tmp = prm_l1; prm_l1=prm_l; prm_l=tmp;
+
+    }  /* end for (l=..)   */
+  }
+
+  for (i=1; i<=n; i++)
+    for (j=i+TURN+1; j<=n; j++) {
+      ij = my_iindx[i]-j;
+      probs[ij] *= qb[ij] *exp(-pscore[jindx[j]+i]/kTn);
+    }
+
+  if (structure!=NULL){
+    char *s = vrna_db_from_probs(probs, (unsigned int)n);
+    memcpy(structure, s, n);
+    structure[n] = '\0';
+    free(s);
+  }
+
+  if(ov > 0)
+    vrna_message_warning("%d overflows occurred while backtracking;\n"
+                                "you might try a smaller pf_scale than %g\n",
+                                ov, pf_params->pf_scale);
+
+  free(type);
+  free(prm_l);
+  free(prm_l1);
+  free(prml);
+
+  return 1;
+}
+
 
-          if(sc){
-            for(s = 0; s < n_seq; s++){
-              if(sc[s]){
-                int u1, u2;
-                u1 = a2s[s][k-1] - a2s[s][i];
-                u2 = a2s[s][j-1] - a2s[s][l];
 /*
-                u1 = k - i - 1;
-                u2 = j - l - 1;
+    bonding (k,l) as substem of interior loop enclosed by (i,j), comparative
+    version. The array type must provide memory for n_seq pair types
 */
-                if(sc[s]->exp_energy_bp)
-                  qloop *= sc[s]->exp_energy_bp[jindx[j] + i];
-
-                if(sc[s]->exp_energy_up)
-                  qloop *=    sc[s]->exp_energy_up[a2s[s][i]+1][u1]
-                              * sc[s]->exp_energy_up[a2s[s][l]+1][u2];
-
-                if(sc[s]->exp_energy_stack)
-                  if(u1 + u2 == 0){
-                    if(S[s][i] && S[s][j] && S[s][k] && S[s][l]){ /* don't allow gaps in stack */
-                      qloop *=    sc[s]->exp_energy_stack[a2s[s][i]]
-                                * sc[s]->exp_energy_stack[a2s[s][k]]
-                                * sc[s]->exp_energy_stack[a2s[s][l]]
-                                * sc[s]->exp_energy_stack[a2s[s][j]];
-                    }
-                  }
+PRIVATE INLINE void
+ali_outside_int_loops(vrna_fold_compound_t *vc,
+                      int k,
+                      int l,
+                      int *type){
+
+  int               s, i, j, ij, kl, n, n_seq, *my_iindx, *jindx, *pscore;
+  short             **S, **S5, **S3;
+  unsigned int      **a2s;
+  unsigned char     *hard_constraints;
+  FLT_OR_DBL        pp, *qb, *probs, *scale;
+  double            kTn;
+  vrna_exp_param_t  *pf_params;
+  vrna_md_t         *md;
+  vrna_hc_t         *hc;
+  vrna_sc_t         **sc;
+
+  n                 = vc->length;
+  n_seq             = vc->n_seq;
+  S                 = vc->S;
+  S5                = vc->S5;
+  S3                = vc->S3;
+  a2s               = vc->a2s;
+  my_iindx          = vc->iindx;
+  jindx             = vc->jindx;
+  pscore            = vc->pscore;
+  pf_params         = vc->exp_params;
+  md                = &(pf_params->model_details);
+  hc                = vc->hc;
+  sc                = vc->scs;
+  hard_constraints  = hc->matrix;
+  qb                = vc->exp_matrices->qb;
+  probs             = vc->exp_matrices->probs;
+  scale             = vc->exp_matrices->scale;
+  kTn               = pf_params->kT/10.;   /* kT in cal/mol  */
+
+  pp = 0.;
+  kl = my_iindx[k]-l;
+  if (qb[kl] == 0.) return;
+  if(!(hard_constraints[jindx[l] + k] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC)) return;
+
+  for (s=0; s<n_seq; s++)
+    type[s] = vrna_get_ptype_md(S[s][l], S[s][k], md);
+
+  for (i=MAX2(1,k-MAXLOOP-1); i<=k-1; i++){
+    if(hc->up_int[i+1] < k - i - 1)
+      continue;
+
+    for (j=l+1; j<=MIN2(l+ MAXLOOP -k+i+2,n); j++) {
+      FLT_OR_DBL qloop=1;
+      ij = my_iindx[i] - j;
+
+      if(probs[ij] == 0.) continue;
+      if(!(hard_constraints[jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP)) continue;
+      if(hc->up_int[l+1] < j - l - 1) break;
+
+      for (s=0; s<n_seq; s++) {
+        int typ, u1, u2;
+        u1 = a2s[s][k-1] - a2s[s][i];
+        u2 = a2s[s][j-1] - a2s[s][l];
+        typ = vrna_get_ptype_md(S[s][i], S[s][j], md);
+        qloop *=  exp_E_IntLoop(u1, u2, typ, type[s], S3[s][i], S5[s][j], S5[s][k], S3[s][l], pf_params);
+      }
+
+      if(sc){
+        for(s = 0; s < n_seq; s++){
+          if(sc[s]){
+            int u1, u2;
+            u1 = a2s[s][k-1] - a2s[s][i];
+            u2 = a2s[s][j-1] - a2s[s][l];
+/*
+            u1 = k - i - 1;
+            u2 = j - l - 1;
+*/
+            if(sc[s]->exp_energy_bp)
+              qloop *= sc[s]->exp_energy_bp[jindx[j] + i];
+
+            if(sc[s]->exp_energy_up)
+              qloop *=    sc[s]->exp_energy_up[a2s[s][i]+1][u1]
+                          * sc[s]->exp_energy_up[a2s[s][l]+1][u2];
+
+            if(sc[s]->exp_energy_stack)
+              if(u1 + u2 == 0){
+                if(S[s][i] && S[s][j] && S[s][k] && S[s][l]){ /* don't allow gaps in stack */
+                  qloop *=    sc[s]->exp_energy_stack[a2s[s][i]]
+                            * sc[s]->exp_energy_stack[a2s[s][k]]
+                            * sc[s]->exp_energy_stack[a2s[s][l]]
+                            * sc[s]->exp_energy_stack[a2s[s][j]];
+                }
               }
-            }
           }
-          pp += probs[ij]*qloop*scale[k-i + j-l];
         }
       }
-      probs[kl] += pp * exp(pscore[jindx[l]+k]/kTn);
+      pp += probs[ij]*qloop*scale[k-i + j-l];
     }
-    /* 3. bonding k,l as substem of multi-loop enclosed by i,j */
-    prm_MLb = 0.;
-    if (l<n)
-      for (k=2; k<l-TURN; k++) {
-      i = k-1;
-      prmt = prmt1 = 0.;
-
-      if(1 /* hard_constraints[jindx[l] + k] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC */){
-        ii = my_iindx[i];     /* ii-j=[i,j]     */
-        ll = my_iindx[l+1];   /* ll-j=[l+1,j-1] */
-        if(hard_constraints[jindx[l+1] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
-          prmt1 = probs[ii-(l+1)];
-          for (s=0; s<n_seq; s++) {
-            tt = vrna_get_ptype_md(S[s][l+1], S[s][i], md);
-            prmt1 *= exp_E_MLstem(tt, S5[s][l+1], S3[s][i], pf_params) * expMLclosing;
-          }
+  }
+  probs[kl] += pp * exp(pscore[jindx[l]+k]/kTn);
+}
 
-          if(sc)
-            for(s = 0; s < n_seq; s++){
-              if(sc[s]){
-                if(sc[s]->exp_energy_bp)
-                  prmt1 *= sc[s]->exp_energy_bp[jindx[l+1] + i];
-              }
-            }
-        }
 
-        for (j=l+2; j<=n; j++){
-          pp = 1.;
-          if(probs[ii-j]==0) continue;
-          if(!(hard_constraints[jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP)) continue;
+/*
+    Comparative version of outside_wavefront()
+*/
+PRIVATE void
+ali_outside_wavefront(vrna_fold_compound_t *vc,
+                      int *ov){
+
+  int               n, n_seq, d, i, j, k, l, kl, ii, ll, s, sp, tt, *type, *my_iindx, *jindx, *pscore;
+  short             **S, **S5, **S3;
+  unsigned int      **a2s;
+  unsigned char     *hard_constraints;
+  FLT_OR_DBL        temp, pp, prmt, prmt1, expMLclosing,
+                    *prm_l, *prm_l1, *prm_MLb, *prm_MLb1, *prml, *tmp,
+                    *qb, *qm, *probs, *scale, *expMLbase;
+  double            kTn;
+  vrna_exp_param_t  *pf_params;
+  vrna_md_t         *md;
+  vrna_hc_t         *hc;
+  vrna_sc_t         **sc;
+#ifdef USE_FLOAT_PF
+  FLT_OR_DBL        Qmax = 0.;
+#endif
 
-          for (s=0; s<n_seq; s++) {
-            tt = vrna_get_ptype_md(S[s][j], S[s][i], md);
-            pp *=  exp_E_MLstem(tt, S5[s][j], S3[s][i], pf_params) * expMLclosing;
+  n                 = vc->length;
+  n_seq             = vc->n_seq;
+  S                 = vc->S;
+  S5                = vc->S5;
+  S3                = vc->S3;
+  a2s               = vc->a2s;
+  my_iindx          = vc->iindx;
+  jindx             = vc->jindx;
+  pscore            = vc->pscore;
+  pf_params         = vc->exp_params;
+  md                = &(pf_params->model_details);
+  hc                = vc->hc;
+  sc                = vc->scs;
+  hard_constraints  = hc->matrix;
+  qb                = vc->exp_matrices->qb;
+  qm                = vc->exp_matrices->qm;
+  probs             = vc->exp_matrices->probs;
+  scale             = vc->exp_matrices->scale;
+  expMLbase         = vc->exp_matrices->expMLbase;
+  expMLclosing      = pf_params->expMLclosing;
+  kTn               = pf_params->kT/10.;   /* kT in cal/mol  */
+
+  prm_l     = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  prm_l1    = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  prm_MLb   = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  prm_MLb1  = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  prml      = (FLT_OR_DBL *) vrna_alloc(sizeof(FLT_OR_DBL) * (((n + 1) * (n + 2)) / 2 + 2));
+
+#ifdef _OPENMP
+#pragma omp parallel private(d, i, j, k, l, kl, ii, ll, s, sp, tt, type, temp, pp, prmt, prmt1)
+#endif
+  {
+    type = (int *)vrna_alloc(sizeof(int) * n_seq);
+
+    for(d = n - 1; d > TURN; d--){
+      /* 1. multiloop helper arrays for (i,l) with span sp = d + 1, see outside_wavefront() */
+      sp = d + 1;
+      if(sp >= TURN + 2){
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+        for(i = 1; i <= n - sp; i++){
+          l = i + sp;
+          if(l == n){
+            prm_l[i] = prm_MLb[i] = 0.;
+            continue;
           }
 
-          if(sc)
-            for(s = 0; s < n_seq; s++){
-              if(sc[s]){
-                if(sc[s]->exp_energy_bp)
-                  pp *= sc[s]->exp_energy_bp[jindx[j] + i];
+          prmt = prmt1 = 0.;
+          ii = my_iindx[i];     /* ii-j=[i,j]     */
+          ll = my_iindx[l+1];   /* ll-j=[l+1,j-1] */
+          if(hard_constraints[jindx[l+1] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP){
+            prmt1 = probs[ii-(l+1)];
+            for (s=0; s<n_seq; s++) {
+              tt = vrna_get_ptype_md(S[s][l+1], S[s][i], md);
+              prmt1 *= exp_E_MLstem(tt, S5[s][l+1], S3[s][i], pf_params) * expMLclosing;
+            }
+
+            if(sc)
+              for(s = 0; s < n_seq; s++){
+                if(sc[s]){
+                  if(sc[s]->exp_energy_bp)
+                    prmt1 *= sc[s]->exp_energy_bp[jindx[l+1] + i];
+                }
               }
+          }
+
+          for (j=l+2; j<=n; j++){
+            pp = 1.;
+            if(probs[ii-j]==0) continue;
+            if(!(hard_constraints[jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP)) continue;
+
+            for (s=0; s<n_seq; s++) {
+              tt = vrna_get_ptype_md(S[s][j], S[s][i], md);
+              pp *=  exp_E_MLstem(tt, S5[s][j], S3[s][i], pf_params) * expMLclosing;
             }
 
-          prmt +=  probs[ii-j] * pp * qm[ll-(j-1)];
-        }
-        kl = my_iindx[k]-l;
+            if(sc)
+              for(s = 0; s < n_seq; s++){
+                if(sc[s]){
+                  if(sc[s]->exp_energy_bp)
+                    pp *= sc[s]->exp_energy_bp[jindx[j] + i];
+                }
+              }
 
-        prml[ i] = prmt;
+            prmt +=  probs[ii-j] * pp * qm[ll-(j-1)];
+          }
 
-        pp = 0.;
-        if(hc->up_ml[l+1]){
-          pp = prm_l1[i] * expMLbase[1];
-          if(sc)
-            for(s = 0; s < n_seq; s++){
-              if(sc[s]){
-                if(sc[s]->exp_energy_up)
-                  pp *= sc[s]->exp_energy_up[a2s[s][l+1]][1];
+          pp = 0.;
+          if(hc->up_ml[l+1]){
+            pp = prm_l1[i] * expMLbase[1];
+            if(sc)
+              for(s = 0; s < n_seq; s++){
+                if(sc[s]){
+                  if(sc[s]->exp_energy_up)
+                    pp *= sc[s]->exp_energy_up[a2s[s][l+1]][1];
+                }
               }
-            }
-        }
-        prm_l[i] = pp + prmt1; /* expMLbase[1]^n_seq */
+          }
+          prm_l[i] = pp + prmt1; /* expMLbase[1]^n_seq */
 
-        pp = 0.;
-        if(hc->up_ml[i]){
-          pp = prm_MLb * expMLbase[1];
-          if(sc)
-            for(s = 0; s < n_seq; s++){
-              if(sc[s]){
-                if(sc[s]->exp_energy_up)
-                  pp *= sc[s]->exp_energy_up[a2s[s][i]][1];
+          pp = 0.;
+          if(hc->up_ml[i]){
+            pp = prm_MLb1[i - 1] * expMLbase[1];
+            if(sc)
+              for(s = 0; s < n_seq; s++){
+                if(sc[s]){
+                  if(sc[s]->exp_energy_up)
+                    pp *= sc[s]->exp_energy_up[a2s[s][i]][1];
+                }
               }
-            }
+          }
+          prm_MLb[i] = pp + prmt;
+
+          prml[jindx[l] + i] = prmt + prm_l[i];
         }
-        prm_MLb = pp + prml[i];
+      }
+
+      /* 2. all pairs (k,l) with span d */
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for(k = 1; k <= n - d; k++){
+        l = k + d;
+
+        ali_outside_int_loops(vc, k, l, type);
 
-        /* same as:    prm_MLb = 0;
-           for (i=1; i<=k-1; i++) prm_MLb += prml[i]*expMLbase[k-i-1]; */
+        if((l == n) || (k < 2))
+          continue;
 
-        prml[i] = prml[ i] + prm_l[i];
+        kl = my_iindx[k]-l;
 
         if (qb[kl] == 0.) continue;
 
-        temp = prm_MLb;
+        temp = prm_MLb[k - 1];
 
         for (i=1;i<=k-2; i++)
-          temp += prml[i]*qm[my_iindx[i+1] - (k-1)];
+          temp += prml[jindx[l] + i]*qm[my_iindx[i+1] - (k-1)];
 
         for (s=0; s<n_seq; s++) {
           tt = vrna_get_ptype_md(S[s][k], S[s][l], md);
           temp *= exp_E_MLstem(tt, S5[s][k], S3[s][l], pf_params);
         }
         probs[kl] += temp * scale[2] * exp(pscore[jindx[l]+k]/kTn);
-      } else { /* (k,l) not allowed to be substem of multiloop closed by (i,j) */
-        prml[i] = prm_l[i] = prm_l1[i] = 0.;
       }
 
-#ifdef USE_FLOAT_PF
-      if (probs[kl]>Qmax) {
-        Qmax = probs[kl];
-        if (Qmax>FLT_MAX/10.)
-          vrna_message_warning("%d %d %g %g\n", i,j,probs[kl],qb[kl]);
-      }
-      if (probs[kl]>FLT_MAX) {
-        ov++;
-        probs[kl]=FLT_MAX;
-      }
+      /* 3. overflow checks and rotation of helper arrays once the anti-diagonal is complete */
+#ifdef _OPENMP
+#pragma omp single
 #endif
-    } /* end for (k=2..) */
-    tmp = prm_l1; prm_l1=prm_l; prm_l=tmp;
-
-  }  /* end for (l=..)   */
+      {
+#ifdef USE_FLOAT_PF
+        for(k = 2; k <= n - d - 1; k++){
+          kl = my_iindx[k] - (k + d);
+          if (qb[kl] == 0.) continue;
 
-  for (i=1; i<=n; i++)
-    for (j=i+TURN+1; j<=n; j++) {
-      ij = my_iindx[i]-j;
-      probs[ij] *= qb[ij] *exp(-pscore[jindx[j]+i]/kTn);
+          if (probs[kl]>Qmax) {
+            Qmax = probs[kl];
+            if (Qmax>FLT_MAX/10.)
+              vrna_message_warning("%d %d %g %g\n", k, k + d, probs[kl], qb[kl]);
+          }
+          if (probs[kl]>FLT_MAX) {
+            (*ov)++;
+            probs[kl]=FLT_MAX;
+          }
+        }
+#else
+        (void)ov;
+#endif
+        tmp = prm_l1; prm_l1 = prm_l; prm_l = tmp;
+        tmp = prm_MLb1; prm_MLb1 = prm_MLb; prm_MLb = tmp;
+      }
     }
 
-  if (structure!=NULL){
-    char *s = vrna_db_from_probs(probs, (unsigned int)n);
-    memcpy(structure, s, n);
-    structure[n] = '\0';
-    free(s);
+    free(type);
   }
 
-  if(ov > 0)
-    vrna_message_warning("%d overflows occurred while backtracking;\n"
-                                "you might try a smaller pf_scale than %g\n",
-                                ov, pf_params->pf_scale);
-
-  free(type);
   free(prm_l);
   free(prm_l1);
+  free(prm_MLb);
+  free(prm_MLb1);
   free(prml);
-
-  return 1;
 }
 
 
@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
 
 #include "ViennaRNA/findpath.h"
 #include "ViennaRNA/datastructures/basic.h"
@@ -24,8 +25,6 @@
 #include <omp.h>
 #endif
 
-#define LOOP_EN
-
 /**
  *  @brief
  */
@@ -37,15 +36,78 @@ typedef struct move {
 } move_t;
 
 /**
- *  @brief
+ *  @brief  An intermediate structure, represented by the set of moves applied to the start structure
  */
 typedef struct intermediate {
-  short   *pt;      /**<  @brief  pair table */
-  int     Sen;      /**<  @brief  saddle energy so far */
-  int     curr_en;  /**<  @brief  current energy */
-  move_t  *moves;   /**<  @brief  remaining moves to target */
+  uint64_t  *applied; /**<  @brief  bit set of moves applied so far */
+  uint64_t  hash;     /**<  @brief  hash value of the bit set of applied moves */
+  int       Sen;      /**<  @brief  saddle energy so far */
+  int       curr_en;  /**<  @brief  current energy */
+  int       history;  /**<  @brief  last move that lead to this intermediate in the history arena */
 } intermediate_t;
 
+/**
+ *  @brief  A neighbor of an intermediate, i.e. a candidate for the next distance class
+ */
+typedef struct candidate {
+  uint64_t  hash;     /**<  @brief  hash value of the resulting set of applied moves */
+  int       parent;   /**<  @brief  intermediate the move is applied to */
+  int       move;     /**<  @brief  the move to apply */
+  int       Sen;      /**<  @brief  saddle energy so far */
+  int       curr_en;  /**<  @brief  current energy */
+  int       order;    /**<  @brief  order of generation, used to break ties */
+} candidate_t;
+
+/**
+ *  @brief  An entry of the history arena, i.e. one move along a path
+ */
+typedef struct history {
+  int parent;         /**<  @brief  previous entry of the path, or -1 */
+  int move;           /**<  @brief  the move that has been applied */
+  int E;              /**<  @brief  energy after applying the move */
+} history_t;
+
+/**
+ *  @brief  An entry of the move energy cache
+ */
+typedef struct move_en {
+  uint64_t  key;      /**<  @brief  hash value of the move and the loops it affects */
+  int       delta;    /**<  @brief  energy change of the move */
+} move_en_t;
+
+/**
+ *  @brief  The single structure all moves are applied to and undone on
+ */
+typedef struct path_walker {
+  short     *pt;      /**<  @brief  pair table of the current structure */
+  int       *loop;    /**<  @brief  the loop each nucleotide is located in (opening position of its closing pair, 0 for the exterior loop) */
+  uint64_t  *content; /**<  @brief  hash value of the pairs enclosed by each loop */
+  uint64_t  *applied; /**<  @brief  bit set of moves applied to the current structure */
+  move_t    *moves;   /**<  @brief  list of all moves from start to target structure */
+  int       words;    /**<  @brief  number of words of each bit set */
+  move_en_t *cache;   /**<  @brief  energy changes of moves evaluated so far */
+  uint64_t  mask;     /**<  @brief  size of the cache minus one */
+} path_walker_t;
+
+/**
+ *  @brief  Data required to compare the pair tables of candidates without constructing them
+ */
+typedef struct cand_order {
+  const intermediate_t  *current; /**<  @brief  intermediates the candidates are derived from */
+  const move_t          *moves;   /**<  @brief  list of all moves, sorted by their 5' position */
+  int                   words;    /**<  @brief  number of words of each bit set */
+  short                 *start;   /**<  @brief  pair table of the start structure */
+  int                   *ins;     /**<  @brief  insert move of each nucleotide, or -1 */
+  int                   *del;     /**<  @brief  delete move of each nucleotide, or -1 */
+} cand_order_t;
+
+#define MOVE_WORD(m)    ((m) >> 6)
+#define MOVE_BIT(m)     ((uint64_t)1 << ((m) & 63))
+#define MOVE_APPLIED(set, m)  ((set)[MOVE_WORD(m)] & MOVE_BIT(m))
+
+/* maximum number of entries in the move energy cache */
+#define MOVE_CACHE_MAX  (1 << 22)
+
 /*
  #################################
  # GLOBAL VARIABLES              #
@@ -63,11 +125,13 @@ PRIVATE int                   path_fwd; /* 1: s1->s2, else s2 -> s1 */
 
 PRIVATE vrna_fold_compound_t  *backward_compat_compound = NULL;
 
+PRIVATE cand_order_t          *cand_order = NULL;
+
 #ifdef _OPENMP
 
 /* NOTE: all variables are assumed to be uninitialized if they are declared as threadprivate
  */
-#pragma omp threadprivate(BP_dist, path, path_fwd, backward_compat_compound)
+#pragma omp threadprivate(BP_dist, path, path_fwd, backward_compat_compound, cand_order)
 
 #endif
 
@@ -76,18 +140,19 @@ PRIVATE vrna_fold_compound_t  *backward_compat_compound = NULL;
  # PRIVATE FUNCTION DECLARATIONS #
  #################################
  */
-PRIVATE move_t *
-copy_moves(move_t *mvs);
+PRIVATE int
+compare_candidate_energy(const void *A,
+                         const void *B);
 
 
 PRIVATE int
-compare_ptable(const void *A,
-               const void *B);
+compare_candidates(const void *A,
+                   const void *B);
 
 
 PRIVATE int
-compare_energy(const void *A,
-               const void *B);
+compare_candidate_ptable(const candidate_t  *a,
+                         const candidate_t  *b);
 
 
 PRIVATE int
@@ -95,8 +160,73 @@ compare_moves_when(const void *A,
                    const void *B);
 
 
+PRIVATE int
+same_set(const intermediate_t *current,
+         const candidate_t    *a,
+         const candidate_t    *b,
+         int                  words);
+
+
+PRIVATE int
+remove_duplicates(const intermediate_t  *current,
+                  candidate_t           *cand,
+                  int                   num,
+                  int                   words,
+                  int                   *table);
+
+
 PRIVATE void
-free_intermediate(intermediate_t *i);
+select_best(candidate_t *cand,
+            int         num,
+            int         k);
+
+
+PRIVATE uint64_t
+hash_mix(uint64_t z);
+
+
+PRIVATE uint64_t
+move_key(int m);
+
+
+PRIVATE uint64_t
+pair_key(int i,
+         int j);
+
+
+PRIVATE uint64_t
+loop_key(path_walker_t  *w,
+         int            l);
+
+
+PRIVATE int
+walker_eval_move(vrna_fold_compound_t *vc,
+                 path_walker_t        *w,
+                 int                  m);
+
+
+PRIVATE void
+walker_init(path_walker_t *w,
+            short         *pt,
+            move_t        *moves,
+            int           num_moves,
+            int           cache_size);
+
+
+PRIVATE void
+walker_free(path_walker_t *w);
+
+
+PRIVATE void
+walker_pair(path_walker_t *w,
+            int           i,
+            int           j,
+            int           insert);
+
+
+PRIVATE void
+walker_goto(path_walker_t *w,
+            uint64_t      *target);
 
 
 #ifdef TEST_FINDPATH
@@ -118,10 +248,11 @@ find_path_once(vrna_fold_compound_t *vc,
 
 PRIVATE int
 try_moves(vrna_fold_compound_t  *vc,
-          intermediate_t        c,
+          path_walker_t         *w,
+          intermediate_t        *c,
+          int                   parent,
           int                   maxE,
-          intermediate_t        *next,
-          int                   dist);
+          candidate_t           *next);
 
 
 /*
@@ -374,62 +505,42 @@ vrna_path_findpath_ub(vrna_fold_compound_t  *vc,
 
 PRIVATE int
 try_moves(vrna_fold_compound_t  *vc,
-          intermediate_t        c,
+          path_walker_t         *w,
+          intermediate_t        *c,
+          int                   parent,
           int                   maxE,
-          intermediate_t        *next,
-          int                   dist)
+          candidate_t           *next)
 {
-  int     *loopidx, len, num_next = 0, en, oldE;
+  int     m, i, j, en, num_next = 0;
   move_t  *mv;
-  short   *pt;
 
-  len     = c.pt[0];
-  loopidx = vrna_loopidx_from_ptable(c.pt);
-  oldE    = c.Sen;
-  for (mv = c.moves; mv->i != 0; mv++) {
-    int i, j;
-    if (mv->when > 0)
+  /* evaluate all moves on the structure of this intermediate */
+  walker_goto(w, c->applied);
+
+  for (m = 0, mv = w->moves; mv->i != 0; m++, mv++) {
+    if (MOVE_APPLIED(c->applied, m))
       continue;
 
-    i   = mv->i;
-    j   = mv->j;
-    pt  = (short *)vrna_alloc(sizeof(short) * (len + 1));
-    memcpy(pt, c.pt, (len + 1) * sizeof(short));
-    if (j < 0) {
-      /*it's a delete move */
-      pt[-i]  = 0;
-      pt[-j]  = 0;
-    } else {
+    i = mv->i;
+    j = mv->j;
+    if (i > 0) {
       /* insert move */
-      if ((loopidx[i] == loopidx[j]) && /* i and j belong to same loop */
-          (pt[i] == 0) && (pt[j] == 0)  /* ... and are unpaired */
-          ) {
-        pt[i] = j;
-        pt[j] = i;
-      } else {
-        free(pt);
-        continue; /* llegal move, try next; */
-      }
+      if ((w->pt[i] != 0) || (w->pt[j] != 0) || /* i and j must be unpaired */
+          (w->loop[i] != w->loop[j]))           /* ... and belong to the same loop */
+        continue;                               /* illegal move, try next */
     }
 
-#ifdef LOOP_EN
-    en = c.curr_en + vrna_eval_move_pt(vc, c.pt, i, j);
-#else
-    en = vrna_eval_structure_pt(vc, pt);
-#endif
+    en = c->curr_en + walker_eval_move(vc, w, m);
     if (en < maxE) {
-      next[num_next].Sen      = (en > oldE) ? en : oldE;
+      next[num_next].hash     = c->hash ^ move_key(m);
+      next[num_next].parent   = parent;
+      next[num_next].move     = m;
+      next[num_next].Sen      = (en > c->Sen) ? en : c->Sen;
       next[num_next].curr_en  = en;
-      next[num_next].pt       = pt;
-      mv->when                = dist;
-      mv->E                   = en;
-      next[num_next++].moves  = copy_moves(c.moves);
-      mv->when                = 0;
-    } else {
-      free(pt);
+      num_next++;
     }
   }
-  free(loopidx);
+
   return num_next;
 }
 
@@ -442,15 +553,20 @@ find_path_once(vrna_fold_compound_t *vc,
                int                  maxE)
 {
   short           *pt1, *pt2;
+  uint64_t        *pool;
   move_t          *mlist;
-  int             i, len, d, dist = 0, result;
-  intermediate_t  *current, *next;
+  int             i, len, d, h, words, num_current, dist = 0, result, *table;
+  intermediate_t  *current, *next, *swap;
+  candidate_t     *cand;
+  history_t       *history;
+  path_walker_t   walker;
+  cand_order_t    order;
 
   pt1 = vrna_ptable(s1);
   pt2 = vrna_ptable(s2);
   len = (int)strlen(s1);
 
-  mlist = (move_t *)vrna_alloc(sizeof(move_t) * len); /* bp_dist < n */
+  mlist = (move_t *)vrna_alloc(sizeof(move_t) * (len + 1)); /* bp_dist <= n */
 
   for (i = 1; i <= len; i++) {
     if (pt1[i] != pt2[i]) {
@@ -469,102 +585,258 @@ find_path_once(vrna_fold_compound_t *vc,
       }
     }
   }
+  BP_dist = dist;
+
+  /*
+   *  Candidates with equal energies are ranked by their pair tables, see
+   *  compare_candidate_ptable(). For that, we need to know the moves that
+   *  alter each nucleotide
+   */
+  order.moves = mlist;
+  order.start = vrna_ptable_copy(pt1);
+  order.ins   = (int *)vrna_alloc(sizeof(int) * (len + 1));
+  order.del   = (int *)vrna_alloc(sizeof(int) * (len + 1));
+
+  for (i = 0; i <= len; i++)
+    order.ins[i] = order.del[i] = -1;
+
+  for (i = 0; i < dist; i++) {
+    if (mlist[i].i > 0)
+      order.ins[mlist[i].i] = order.ins[mlist[i].j] = i;
+    else
+      order.del[-mlist[i].i] = order.del[-mlist[i].j] = i;
+  }
+
   free(pt2);
-  BP_dist           = dist;
-  current           = (intermediate_t *)vrna_alloc(sizeof(intermediate_t) * (maxl + 1));
-  current[0].pt     = pt1;
-  current[0].Sen    = current[0].curr_en = vrna_eval_structure_pt(vc, pt1);
-  current[0].moves  = mlist;
-  next              = (intermediate_t *)vrna_alloc(sizeof(intermediate_t) * (dist * maxl + 1));
+
+  /*
+   *  Intermediates are stored as bit sets of applied moves, and all
+   *  moves are evaluated on a single pair table that is transformed
+   *  into the respective intermediate structure in place. The moves
+   *  that lead to an intermediate are kept in a history arena that
+   *  is shared among all intermediates with a common ancestor.
+   */
+  walker_init(&walker, pt1, mlist, dist, dist * maxl);
+  words       = walker.words;
+  order.words = words;
+  cand_order  = &order;
+
+  /* bit sets of the current and the next distance class */
+  pool    = (uint64_t *)vrna_alloc(sizeof(uint64_t) * words * 2 * (maxl + 1));
+  current = (intermediate_t *)vrna_alloc(sizeof(intermediate_t) * (maxl + 1));
+  next    = (intermediate_t *)vrna_alloc(sizeof(intermediate_t) * (maxl + 1));
+  cand    = (candidate_t *)vrna_alloc(sizeof(candidate_t) * ((size_t)dist * maxl + 1));
+  history = (history_t *)vrna_alloc(sizeof(history_t) * ((size_t)dist * maxl + 1));
+  table   = (int *)vrna_alloc(sizeof(int) * 4 * ((size_t)dist * maxl + 1));
+
+  for (i = 0; i <= maxl; i++) {
+    current[i].applied  = pool + i * words;
+    next[i].applied     = pool + (maxl + 1 + i) * words;
+  }
+
+  current[0].hash     = 0;
+  current[0].Sen      = current[0].curr_en = vrna_eval_structure_pt(vc, pt1);
+  current[0].history  = -1;
+  num_current         = 1;
+  h                   = 0;
 
   for (d = 1; d <= dist; d++) {
     /* go through the distance classes */
-    int             c, u, num_next = 0;
-    intermediate_t  *cc;
+    int c, num_next = 0;
+
+    for (c = 0; c < num_current; c++)
+      num_next += try_moves(vc, &walker, current + c, c, maxE, cand + num_next);
 
-    for (c = 0; current[c].pt != NULL; c++)
-      num_next += try_moves(vc, current[c], maxE, next + num_next, d);
     if (num_next == 0) {
-      for (cc = current; cc->pt != NULL; cc++)
-        free_intermediate(cc);
-      current[0].Sen = INT_MAX;
+      num_current = 0;
       break;
     }
 
-    /* remove duplicates via sort|uniq
-     * if this becomes a bottleneck we can use a hash instead */
-    qsort(next, num_next, sizeof(intermediate_t), compare_ptable);
-    for (u = 0, c = 1; c < num_next; c++) {
-      if (memcmp(next[u].pt, next[c].pt, sizeof(short) * len) != 0)
-        next[++u] = next[c];
-      else
-        free_intermediate(next + c);
+    for (c = 0; c < num_next; c++)
+      cand[c].order = c;
+
+    num_next = remove_duplicates(current, cand, num_next, words, table);
+
+    order.current = current;
+
+    /* the best maxl candidates become the next distance class */
+    if (num_next > maxl) {
+      select_best(cand, num_next, maxl);
+      num_next = maxl;
     }
-    num_next = u + 1;
-    qsort(next, num_next, sizeof(intermediate_t), compare_energy);
-    /* free the old stuff */
-    for (cc = current; cc->pt != NULL; cc++)
-      free_intermediate(cc);
-    for (u = 0; u < maxl && u < num_next; u++)
-      current[u] = next[u];
-    for (; u < num_next; u++)
-      free_intermediate(next + u);
-    num_next = 0;
+
+    qsort(cand, num_next, sizeof(candidate_t), compare_candidates);
+
+    for (c = 0; c < num_next; c++) {
+      intermediate_t *p = current + cand[c].parent;
+
+      memcpy(next[c].applied, p->applied, sizeof(uint64_t) * words);
+      next[c].applied[MOVE_WORD(cand[c].move)] |= MOVE_BIT(cand[c].move);
+      next[c].hash      = cand[c].hash;
+      next[c].Sen       = cand[c].Sen;
+      next[c].curr_en   = cand[c].curr_en;
+      next[c].history   = h;
+      history[h].parent = p->history;
+      history[h].move   = cand[c].move;
+      history[h++].E    = cand[c].curr_en;
+    }
+
+    swap        = current;
+    current     = next;
+    next        = swap;
+    num_current = num_next;
   }
-  free(next);
-  path    = current[0].moves;
-  result  = current[0].Sen;
-  free(current[0].pt);
+
+  if (num_current > 0) {
+    /* reconstruct the move list of the best path from the history */
+    d = dist;
+    for (h = current[0].history; h >= 0; h = history[h].parent) {
+      mlist[history[h].move].when = d--;
+      mlist[history[h].move].E    = history[h].E;
+    }
+    path    = mlist;
+    result  = current[0].Sen;
+  } else {
+    free(mlist);
+    path    = NULL;
+    result  = INT_MAX;
+  }
+
+  free(pool);
   free(current);
+  free(next);
+  free(cand);
+  free(history);
+  free(table);
+  free(order.start);
+  free(order.ins);
+  free(order.del);
+  walker_free(&walker);
+
+  cand_order = NULL;
+
   return result;
 }
 
 
-PRIVATE void
-free_intermediate(intermediate_t *i)
+/* rank candidates by saddle energy, current energy, and order of generation */
+PRIVATE int
+compare_candidate_energy(const void *A,
+                         const void *B)
 {
-  free(i->pt);
-  free(i->moves);
-  i->pt     = NULL;
-  i->moves  = NULL;
-  i->Sen    = INT_MAX;
+  candidate_t *a, *b;
+
+  a = (candidate_t *)A;
+  b = (candidate_t *)B;
+
+  if ((a->Sen - b->Sen) != 0)
+    return a->Sen - b->Sen;
+
+  if ((a->curr_en - b->curr_en) != 0)
+    return a->curr_en - b->curr_en;
+
+  return a->order - b->order;
 }
 
 
+/*
+ *  rank candidates by saddle energy, current energy, and finally their pair
+ *  tables. This resembles the order of intermediates in previous versions,
+ *  that sorted them by their pair tables first (to remove duplicates), and
+ *  by energy in a stable manner afterwards
+ */
 PRIVATE int
-compare_ptable(const void *A,
-               const void *B)
+compare_candidates(const void *A,
+                   const void *B)
 {
-  intermediate_t  *a, *b;
-  int             c;
+  candidate_t *a, *b;
 
-  a = (intermediate_t *)A;
-  b = (intermediate_t *)B;
-
-  c = memcmp(a->pt, b->pt, a->pt[0] * sizeof(short));
-  if (c != 0)
-    return c;
+  a = (candidate_t *)A;
+  b = (candidate_t *)B;
 
   if ((a->Sen - b->Sen) != 0)
     return a->Sen - b->Sen;
 
-  return a->curr_en - b->curr_en;
+  if ((a->curr_en - b->curr_en) != 0)
+    return a->curr_en - b->curr_en;
+
+  return compare_candidate_ptable(a, b);
 }
 
 
+/* check whether move m is applied in the structure a candidate results in */
 PRIVATE int
-compare_energy(const void *A,
-               const void *B)
+candidate_applied(const candidate_t *c,
+                  int               m)
 {
-  intermediate_t *a, *b;
+  return (c->move == m) || (MOVE_APPLIED(cand_order->current[c->parent].applied, m));
+}
 
-  a = (intermediate_t *)A;
-  b = (intermediate_t *)B;
 
-  if ((a->Sen - b->Sen) != 0)
-    return a->Sen - b->Sen;
+/* the pairing partner of nucleotide i in the structure a candidate results in */
+PRIVATE short
+candidate_partner(const candidate_t *c,
+                  int               i)
+{
+  int           m;
+  const move_t  *mv;
+
+  m = cand_order->ins[i];
+  if ((m >= 0) && (candidate_applied(c, m))) {
+    mv = cand_order->moves + m;
+    return (short)((mv->i == i) ? mv->j : mv->i);
+  }
+
+  m = cand_order->del[i];
+  if ((m >= 0) && (candidate_applied(c, m)))
+    return 0;
 
-  return a->curr_en - b->curr_en;
+  return cand_order->start[i];
+}
+
+
+/*
+ *  compare the pair tables of the structures two candidates result in, just
+ *  like memcmp() on the pair table arrays does. Every move alters the pair
+ *  table at both of its positions. Thus, the first nucleotide where the pair
+ *  tables differ is the 5' position of the first move that is applied to
+ *  only one of the two candidates, since moves are sorted by their 5'
+ *  positions
+ */
+PRIVATE int
+compare_candidate_ptable(const candidate_t  *a,
+                         const candidate_t  *b)
+{
+  int             k, m, i;
+  short           pa, pb;
+  uint64_t        x;
+  const uint64_t  *sa, *sb;
+
+  sa  = cand_order->current[a->parent].applied;
+  sb  = cand_order->current[b->parent].applied;
+
+  for (k = 0; k < cand_order->words; k++) {
+    x = sa[k] ^ sb[k];
+    if (MOVE_WORD(a->move) == k)
+      x ^= MOVE_BIT(a->move);
+
+    if (MOVE_WORD(b->move) == k)
+      x ^= MOVE_BIT(b->move);
+
+    if (x)
+      break;
+  }
+
+  if (k == cand_order->words)
+    return 0;
+
+  for (m = 64 * k; !(x & MOVE_BIT(m)); m++);
+
+  i   = abs(cand_order->moves[m].i);
+  pa  = candidate_partner(a, i);
+  pb  = candidate_partner(b, i);
+
+  return memcmp(&pa, &pb, sizeof(short));
 }
 
 
@@ -581,14 +853,317 @@ compare_moves_when(const void *A,
 }
 
 
-PRIVATE move_t *
-copy_moves(move_t *mvs)
+/* check whether two candidates result in the same set of applied moves */
+PRIVATE int
+same_set(const intermediate_t *current,
+         const candidate_t    *a,
+         const candidate_t    *b,
+         int                  words)
+{
+  int       k;
+  uint64_t  *sa, *sb, wa, wb;
+
+  sa  = current[a->parent].applied;
+  sb  = current[b->parent].applied;
+
+  for (k = 0; k < words; k++) {
+    wa  = sa[k];
+    wb  = sb[k];
+    if (MOVE_WORD(a->move) == k)
+      wa |= MOVE_BIT(a->move);
+
+    if (MOVE_WORD(b->move) == k)
+      wb |= MOVE_BIT(b->move);
+
+    if (wa != wb)
+      return 0;
+  }
+
+  return 1;
+}
+
+
+/*
+ *  remove candidates that result in the same set of applied moves, and keep
+ *  the one with lowest energy only. Returns the number of remaining candidates
+ */
+PRIVATE int
+remove_duplicates(const intermediate_t  *current,
+                  candidate_t           *cand,
+                  int                   num,
+                  int                   words,
+                  int                   *table)
+{
+  int           c, k, u;
+  unsigned int  size, mask, slot;
+
+  for (size = 2; size < 2 * (unsigned int)num; size *= 2);
+
+  mask = size - 1;
+  for (slot = 0; slot < size; slot++)
+    table[slot] = -1;
+
+  for (u = c = 0; c < num; c++) {
+    for (slot = cand[c].hash & mask; (k = table[slot]) != -1; slot = (slot + 1) & mask)
+      if ((cand[k].hash == cand[c].hash) &&
+          (same_set(current, cand + k, cand + c, words)))
+        break;
+
+    if (k == -1) {
+      table[slot] = u;
+      cand[u++]   = cand[c];
+    } else if (compare_candidate_energy(cand + c, cand + k) < 0) {
+      cand[k] = cand[c];
+    }
+  }
+
+  return u;
+}
+
+
+/* partition the candidates such that the k best ones come first (quickselect) */
+PRIVATE void
+select_best(candidate_t *cand,
+            int         num,
+            int         k)
+{
+  int         l, r, i, j;
+  candidate_t pivot, tmp;
+
+  l = 0;
+  r = num - 1;
+
+  while (l < r) {
+    pivot = cand[l + (r - l) / 2];
+    i     = l;
+    j     = r;
+    while (i <= j) {
+      while (compare_candidates(cand + i, &pivot) < 0)
+        i++;
+      while (compare_candidates(&pivot, cand + j) < 0)
+        j--;
+      if (i <= j) {
+        tmp     = cand[i];
+        cand[i] = cand[j];
+        cand[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+
+    if (k - 1 <= j)
+      r = j;
+    else if (k - 1 >= i)
+      l = i;
+    else
+      break;
+  }
+}
+
+
+/* a bijective mixing function (splitmix64 finalizer) to derive pseudo-random, but fixed keys */
+PRIVATE uint64_t
+hash_mix(uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+  return z ^ (z >> 31);
+}
+
+
+PRIVATE uint64_t
+move_key(int m)
+{
+  return hash_mix(((uint64_t)m + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+
+PRIVATE uint64_t
+pair_key(int  i,
+         int  j)
 {
-  move_t *new;
+  return hash_mix((((uint64_t)i << 32) | (uint64_t)j) * 0x9E3779B97F4A7C15ULL + 1);
+}
+
+
+/* hash value of a loop, i.e. its closing pair and the pairs it encloses */
+PRIVATE uint64_t
+loop_key(path_walker_t  *w,
+         int            l)
+{
+  uint64_t k = w->content[l];
+
+  if (l > 0)
+    k ^= hash_mix(pair_key(l, w->pt[l]));
+
+  return k;
+}
+
+
+/*
+ *  The energy change of a move only depends on the loops it affects, i.e.
+ *  the loop an insertion splits, or the two loops a deletion merges. We
+ *  therefore memorize the energy changes of moves in a direct mapped cache
+ *  with the hash value of the move and these loops as key, such that the
+ *  same move in the same loop context is evaluated only once, no matter
+ *  which intermediate it is applied to.
+ */
+PRIVATE int
+walker_eval_move(vrna_fold_compound_t *vc,
+                 path_walker_t        *w,
+                 int                  m)
+{
+  int       i, j;
+  uint64_t  key;
+  move_en_t *entry;
+
+  i = w->moves[m].i;
+  j = w->moves[m].j;
+
+  if (i > 0)
+    key = loop_key(w, w->loop[i]);
+  else
+    key = loop_key(w, w->loop[-i]) ^ hash_mix(loop_key(w, -i));
+
+  key   = hash_mix(key ^ move_key(m)) | 1; /* 0 marks empty entries */
+  entry = w->cache + (key & w->mask);
+
+  if (entry->key != key) {
+    entry->key    = key;
+    entry->delta  = vrna_eval_move_pt(vc, w->pt, i, j);
+  }
+
+  return entry->delta;
+}
+
+
+PRIVATE void
+walker_init(path_walker_t *w,
+            short         *pt,
+            move_t        *moves,
+            int           num_moves,
+            int           cache_size)
+{
+  int i, n, l;
+
+  n           = pt[0];
+  w->pt       = pt;
+  w->moves    = moves;
+  w->words    = num_moves / 64 + 1;
+  w->applied  = (uint64_t *)vrna_alloc(sizeof(uint64_t) * w->words);
+  w->loop     = (int *)vrna_alloc(sizeof(int) * (n + 2));
+  w->content  = (uint64_t *)vrna_alloc(sizeof(uint64_t) * (n + 2));
+
+  for (w->mask = 1; (w->mask < 4 * (uint64_t)cache_size) && (w->mask < MOVE_CACHE_MAX); w->mask *= 2);
+
+  w->cache  = (move_en_t *)vrna_alloc(sizeof(move_en_t) * w->mask);
+  w->mask   -= 1;
+
+  /* label each nucleotide with the opening position of the pair that closes its loop */
+  for (l = 0, i = 1; i <= n; i++) {
+    if (pt[i] == 0) {
+      w->loop[i] = l;
+    } else if (pt[i] > i) {
+      w->loop[i]    = l;
+      w->content[l] ^= pair_key(i, pt[i]);
+      l             = i;
+    } else {
+      l           = w->loop[pt[i]];
+      w->loop[i]  = l;
+    }
+  }
+}
+
+
+PRIVATE void
+walker_free(path_walker_t *w)
+{
+  free(w->pt);
+  free(w->loop);
+  free(w->content);
+  free(w->applied);
+  free(w->cache);
+}
+
+
+/* insert or remove the pair (i,j) and update the loop labels of the nucleotides it encloses */
+PRIVATE void
+walker_pair(path_walker_t *w,
+            int           i,
+            int           j,
+            int           insert)
+{
+  int       k, l, outer;
+  uint64_t  inner;
+  short     *pt;
+
+  pt    = w->pt;
+  outer = w->loop[i];
+  l     = (insert) ? i : outer;
+  inner = 0;
+
+  for (k = i + 1; k < j; k++) {
+    if (pt[k] > k) {
+      inner           ^= pair_key(k, pt[k]);
+      w->loop[k]      = l;
+      w->loop[pt[k]]  = l;
+      k               = pt[k];
+    } else {
+      w->loop[k] = l;
+    }
+  }
+
+  /* the pairs enclosed by (i,j) move from the outer loop into the new loop, or vice versa */
+  w->content[outer] ^= inner ^ pair_key(i, j);
+  w->content[i]     = (insert) ? inner : 0;
+
+  if (insert) {
+    pt[i] = j;
+    pt[j] = i;
+  } else {
+    pt[i] = pt[j] = 0;
+  }
+}
+
+
+/*
+ *  transform the current structure into the one with the target set of
+ *  applied moves. We first remove all pairs that are not present in the
+ *  target structure, and then insert the missing ones, such that each
+ *  intermediate step is a valid secondary structure.
+ */
+PRIVATE void
+walker_goto(path_walker_t *w,
+            uint64_t      *target)
+{
+  int       k, m, pass;
+  uint64_t  diff;
+  move_t    *mv;
+
+  for (pass = 0; pass < 2; pass++) {
+    for (k = 0; k < w->words; k++) {
+      diff = w->applied[k] ^ target[k];
+      for (m = 64 * k; diff; m++, diff >>= 1) {
+        if (!(diff & 1))
+          continue;
+
+        mv = w->moves + m;
+        /*
+         *  undoing an insert or applying a delete move removes a pair,
+         *  applying an insert or undoing a delete move inserts a pair
+         */
+        if ((mv->i > 0) == ((target[k] & MOVE_BIT(m)) == 0)) {
+          if (pass == 0)
+            walker_pair(w, abs(mv->i), abs(mv->j), 0);
+        } else if (pass == 1) {
+          walker_pair(w, abs(mv->i), abs(mv->j), 1);
+        }
+      }
+    }
+  }
 
-  new = (move_t *)vrna_alloc(sizeof(move_t) * (BP_dist + 1));
-  memcpy(new, mvs, sizeof(move_t) * (BP_dist + 1));
-  return new;
+  memcpy(w->applied, target, sizeof(uint64_t) * w->words);
 }
 
 
@@ -23,6 +23,10 @@
 #include <string.h>
 #include <limits.h>
 
+#if VRNA_WITH_PTHREADS
+# include <pthread.h>
+#endif
+
 #include "ViennaRNA/utils/basic.h"
 #include "ViennaRNA/utils/structures.h"
 #include "ViennaRNA/utils/strings.h"
@@ -40,6 +44,7 @@
 #include "ViennaRNA/mm.h"
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/fold_compound.h"
+#include "ViennaRNA/boltzmann_sampling.h"
 
 /*
  #################################
@@ -61,6 +66,16 @@
  # PRIVATE VARIABLES             #
  #################################
  */
+struct vrna_fc_pool_s {
+  unsigned int          max_length; /* largest sequence length we keep fold compounds for (0 = no limit) */
+  unsigned int          num;        /* number of idle fold compounds */
+  unsigned int          size;       /* available memory for idle fold compounds */
+  vrna_fold_compound_t  **idle;     /* idle fold compounds, the most recently released one last */
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_t       mtx;        /* semaphore to provide concurrent access */
+#endif
+};
+
 
 /*
  #################################
@@ -100,6 +115,39 @@ PRIVATE INLINE void
 nullify(vrna_fold_compound_t *fc);
 
 
+PRIVATE void
+free_sequence_data(vrna_fold_compound_t *fc);
+
+
+PRIVATE void
+retarget(vrna_fold_compound_t *fc,
+         vrna_md_t            *md_p,
+         unsigned int         n_seq_old,
+         unsigned int         options);
+
+
+PRIVATE INLINE void
+reset_sequence_dependent_md(vrna_md_t       *md,
+                            const vrna_md_t *md_requested);
+
+
+PRIVATE void
+reset_mfe_matrices(vrna_fold_compound_t *fc);
+
+
+PRIVATE void
+reset_pf_matrices(vrna_fold_compound_t *fc);
+
+
+PRIVATE int
+retargetable(vrna_fold_compound_t *fc);
+
+
+PRIVATE vrna_fold_compound_t *
+pool_take(vrna_fold_compound_pool_t *pool,
+          vrna_fc_type_e            type);
+
+
 /*
  #################################
  # BEGIN OF FUNCTION DEFINITIONS #
@@ -108,81 +156,15 @@ nullify(vrna_fold_compound_t *fc);
 PUBLIC void
 vrna_fold_compound_free(vrna_fold_compound_t *fc)
 {
-  int s;
-
   if (fc) {
     /* first destroy common attributes */
     vrna_mx_mfe_free(fc);
     vrna_mx_pf_free(fc);
-    free(fc->iindx);
-    free(fc->jindx);
     free(fc->params);
     free(fc->exp_params);
 
-    free(fc->strand_number);
-    free(fc->strand_order);
-    free(fc->strand_start);
-    free(fc->strand_end);
-
-    vrna_hc_free(fc->hc);
-    vrna_ud_remove(fc);
-    vrna_sequence_remove_all(fc);
-
-    /* now distinguish the fc type */
-    switch (fc->type) {
-      case VRNA_FC_TYPE_SINGLE:
-        free(fc->sequence);
-        free(fc->sequence_encoding);
-        free(fc->sequence_encoding2);
-        free(fc->ptype);
-        free(fc->ptype_pf_compat);
-        vrna_sc_free(fc->sc);
-        break;
-      case VRNA_FC_TYPE_COMPARATIVE:
-        for (s = 0; s < fc->n_seq; s++) {
-          free(fc->sequences[s]);
-          free(fc->S[s]);
-          free(fc->S5[s]);
-          free(fc->S3[s]);
-          free(fc->Ss[s]);
-          free(fc->a2s[s]);
-        }
-        free(fc->sequences);
-        free(fc->cons_seq);
-        free(fc->S_cons);
-        free(fc->S);
-        free(fc->S5);
-        free(fc->S3);
-        free(fc->Ss);
-        free(fc->a2s);
-        free(fc->pscore);
-        free(fc->pscore_pf_compat);
-        if (fc->scs) {
-          for (s = 0; s < fc->n_seq; s++)
-            vrna_sc_free(fc->scs[s]);
-          free(fc->scs);
-        }
-
-        break;
-      default:                      /* do nothing */
-        break;
-    }
-
-    /* free Distance Class Partitioning stuff (should be NULL if not used) */
-    free(fc->reference_pt1);
-    free(fc->reference_pt2);
-    free(fc->referenceBPs1);
-    free(fc->referenceBPs2);
-    free(fc->bpdist);
-    free(fc->mm1);
-    free(fc->mm2);
-
-    /* free local folding related stuff (should be NULL if not used) */
-    free(fc->ptype_local);
-    free(fc->pscore_local);
-
-    if (fc->free_auxdata)
-      fc->free_auxdata(fc->auxdata);
+    /* then everything that depends on the actual sequence(s) */
+    free_sequence_data(fc);
 
     free(fc);
   }
@@ -467,6 +449,19 @@ vrna_fold_compound_add_auxdata(vrna_fold_compound_t       *fc,
 }
 
 
+PUBLIC void
+vrna_fold_compound_add_rng(vrna_fold_compound_t *fc,
+                           vrna_rng_t           *rng)
+{
+  if (fc) {
+    if (fc->rng != rng)
+      vrna_rng_free(fc->rng);
+
+    fc->rng = rng;
+  }
+}
+
+
 PUBLIC void
 vrna_fold_compound_add_callback(vrna_fold_compound_t            *fc,
                                 vrna_callback_recursion_status  *f)
@@ -546,6 +541,226 @@ vrna_fold_compound_prepare(vrna_fold_compound_t *fc,
 }
 
 
+PUBLIC int
+vrna_fold_compound_retarget(vrna_fold_compound_t  *fc,
+                            const char            *sequence,
+                            vrna_md_t             *md_p,
+                            unsigned int          options)
+{
+  unsigned int length;
+
+  if ((!fc) || (!sequence) || (fc->type != VRNA_FC_TYPE_SINGLE))
+    return 0;
+
+  /* sanity check */
+  length = strlen(sequence);
+  if (length == 0) {
+    vrna_message_warning("vrna_fold_compound_retarget: "
+                         "sequence length must be greater 0");
+    return 0;
+  }
+
+  if (length > vrna_sequence_length_max(options)) {
+    vrna_message_warning("vrna_fold_compound_retarget: "
+                         "sequence length of %d exceeds addressable range",
+                         length);
+    return 0;
+  }
+
+  if ((options & VRNA_OPTION_WINDOW) || (!retargetable(fc))) {
+    vrna_message_warning("vrna_fold_compound_retarget: "
+                         "only fold compounds for global structure prediction can be re-targeted");
+    return 0;
+  }
+
+  free_sequence_data(fc);
+
+  fc->length    = length;
+  fc->sequence  = strdup(sequence);
+
+  retarget(fc, md_p, 0, options);
+
+  return 1;
+}
+
+
+PUBLIC int
+vrna_fold_compound_comparative_retarget(vrna_fold_compound_t  *fc,
+                                        const char            **sequences,
+                                        vrna_md_t             *md_p,
+                                        unsigned int          options)
+{
+  unsigned int s, n_seq, n_seq_old, length;
+
+  if ((!fc) || (!sequences) || (!sequences[0]) || (fc->type != VRNA_FC_TYPE_COMPARATIVE))
+    return 0;
+
+  for (s = 0; sequences[s]; s++);  /* count the sequences */
+
+  n_seq = s;
+
+  /* sanity check */
+  length = strlen(sequences[0]);
+  if (length == 0) {
+    vrna_message_warning("vrna_fold_compound_comparative_retarget: "
+                         "sequence length must be greater 0");
+    return 0;
+  }
+
+  if (length > vrna_sequence_length_max(options)) {
+    vrna_message_warning("vrna_fold_compound_comparative_retarget: "
+                         "sequence length of %d exceeds addressable range",
+                         length);
+    return 0;
+  }
+
+  for (s = 0; s < n_seq; s++)
+    if (strlen(sequences[s]) != length) {
+      vrna_message_warning("vrna_fold_compound_comparative_retarget: "
+                           "uneqal sequence lengths in alignment");
+      return 0;
+    }
+
+  if ((options & VRNA_OPTION_WINDOW) || (!retargetable(fc))) {
+    vrna_message_warning("vrna_fold_compound_comparative_retarget: "
+                         "only fold compounds for global structure prediction can be re-targeted");
+    return 0;
+  }
+
+  n_seq_old = fc->n_seq;
+
+  free_sequence_data(fc);
+
+  fc->n_seq     = n_seq;
+  fc->length    = length;
+  fc->sequences = vrna_alloc(sizeof(char *) * (fc->n_seq + 1));
+  for (s = 0; sequences[s]; s++)
+    fc->sequences[s] = strdup(sequences[s]);
+
+  retarget(fc, md_p, n_seq_old, options);
+
+  return 1;
+}
+
+
+PUBLIC vrna_fold_compound_pool_t *
+vrna_fold_compound_pool_init(unsigned int max_length)
+{
+  vrna_fold_compound_pool_t *pool;
+
+  pool = (vrna_fold_compound_pool_t *)vrna_alloc(sizeof(vrna_fold_compound_pool_t));
+
+  pool->max_length  = max_length;
+  pool->num         = 0;
+  pool->size        = 0;
+  pool->idle        = NULL;
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_init(&pool->mtx, NULL);
+#endif
+
+  return pool;
+}
+
+
+PUBLIC void
+vrna_fold_compound_pool_free(vrna_fold_compound_pool_t *pool)
+{
+  unsigned int i;
+
+  if (pool) {
+    for (i = 0; i < pool->num; i++)
+      vrna_fold_compound_free(pool->idle[i]);
+
+    free(pool->idle);
+
+#if VRNA_WITH_PTHREADS
+    pthread_mutex_destroy(&pool->mtx);
+#endif
+
+    free(pool);
+  }
+}
+
+
+PUBLIC vrna_fold_compound_t *
+vrna_fold_compound_pool_acquire(vrna_fold_compound_pool_t *pool,
+                                const char                *sequence,
+                                vrna_md_t                 *md_p,
+                                unsigned int              options)
+{
+  vrna_fold_compound_t *fc;
+
+  fc = pool_take(pool, VRNA_FC_TYPE_SINGLE);
+
+  if ((fc) && (!vrna_fold_compound_retarget(fc, sequence, md_p, options))) {
+    vrna_fold_compound_free(fc);
+    fc = NULL;
+  }
+
+  if (!fc)
+    fc = vrna_fold_compound(sequence, md_p, options);
+
+  return fc;
+}
+
+
+PUBLIC vrna_fold_compound_t *
+vrna_fold_compound_pool_acquire_comparative(vrna_fold_compound_pool_t *pool,
+                                            const char                **sequences,
+                                            vrna_md_t                 *md_p,
+                                            unsigned int              options)
+{
+  vrna_fold_compound_t *fc;
+
+  fc = pool_take(pool, VRNA_FC_TYPE_COMPARATIVE);
+
+  if ((fc) && (!vrna_fold_compound_comparative_retarget(fc, sequences, md_p, options))) {
+    vrna_fold_compound_free(fc);
+    fc = NULL;
+  }
+
+  if (!fc)
+    fc = vrna_fold_compound_comparative(sequences, md_p, options);
+
+  return fc;
+}
+
+
+PUBLIC void
+vrna_fold_compound_pool_release(vrna_fold_compound_pool_t *pool,
+                                vrna_fold_compound_t      *fc)
+{
+  if (!fc)
+    return;
+
+  /* do not keep the memory of exceptionally long, or unsupported fold compounds */
+  if ((!pool) ||
+      ((pool->max_length > 0) && (fc->length > pool->max_length)) ||
+      (!retargetable(fc))) {
+    vrna_fold_compound_free(fc);
+    return;
+  }
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_lock(&pool->mtx);
+#endif
+
+  if (pool->num == pool->size) {
+    pool->size  += 8;
+    pool->idle  = (vrna_fold_compound_t **)vrna_realloc(pool->idle,
+                                                       sizeof(vrna_fold_compound_t *) *
+                                                       pool->size);
+  }
+
+  pool->idle[pool->num++] = fc;
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_unlock(&pool->mtx);
+#endif
+}
+
+
 /*
  #####################################
  # BEGIN OF STATIC HELPER FUNCTIONS  #
@@ -833,6 +1048,378 @@ make_pscores(vrna_fold_compound_t *fc)
 }
 
 
+/*
+ *  free everything that depends on the actual sequence(s), i.e. all
+ *  data except for the DP matrices and the energy parameters, and reset
+ *  the respective pointers
+ */
+PRIVATE void
+free_sequence_data(vrna_fold_compound_t *fc)
+{
+  int               s;
+  vrna_mx_mfe_t     *matrices;
+  vrna_mx_pf_t      *exp_matrices;
+  vrna_param_t      *params;
+  vrna_exp_param_t  *exp_params;
+
+  free(fc->iindx);
+  free(fc->jindx);
+
+  free(fc->strand_number);
+  free(fc->strand_order);
+  free(fc->strand_start);
+  free(fc->strand_end);
+
+  vrna_hc_free(fc->hc);
+  vrna_ud_remove(fc);
+  vrna_sequence_remove_all(fc);
+
+  /* now distinguish the fc type */
+  switch (fc->type) {
+    case VRNA_FC_TYPE_SINGLE:
+      free(fc->sequence);
+      free(fc->sequence_encoding);
+      free(fc->sequence_encoding2);
+      free(fc->ptype);
+      free(fc->ptype_pf_compat);
+      vrna_sc_free(fc->sc);
+      break;
+    case VRNA_FC_TYPE_COMPARATIVE:
+      for (s = 0; s < fc->n_seq; s++) {
+        free(fc->sequences[s]);
+        free(fc->S[s]);
+        free(fc->S5[s]);
+        free(fc->S3[s]);
+        free(fc->Ss[s]);
+        free(fc->a2s[s]);
+      }
+      free(fc->sequences);
+      free(fc->cons_seq);
+      free(fc->S_cons);
+      free(fc->S);
+      free(fc->S5);
+      free(fc->S3);
+      free(fc->Ss);
+      free(fc->a2s);
+      free(fc->pscore);
+      free(fc->pscore_pf_compat);
+      if (fc->scs) {
+        for (s = 0; s < fc->n_seq; s++)
+          vrna_sc_free(fc->scs[s]);
+        free(fc->scs);
+      }
+
+      break;
+    default:                      /* do nothing */
+      break;
+  }
+
+  /* free Distance Class Partitioning stuff (should be NULL if not used) */
+  free(fc->reference_pt1);
+  free(fc->reference_pt2);
+  free(fc->referenceBPs1);
+  free(fc->referenceBPs2);
+  free(fc->bpdist);
+  free(fc->mm1);
+  free(fc->mm2);
+
+  /* free local folding related stuff (should be NULL if not used) */
+  free(fc->ptype_local);
+  free(fc->pscore_local);
+
+  if (fc->free_auxdata)
+    fc->free_auxdata(fc->auxdata);
+
+  vrna_rng_free(fc->rng);
+
+  matrices      = fc->matrices;
+  exp_matrices  = fc->exp_matrices;
+  params        = fc->params;
+  exp_params    = fc->exp_params;
+
+  nullify(fc);
+
+  fc->matrices      = matrices;
+  fc->exp_matrices  = exp_matrices;
+  fc->params        = params;
+  fc->exp_params    = exp_params;
+}
+
+
+/*
+ *  re-do everything vrna_fold_compound() and vrna_fold_compound_comparative()
+ *  do after the sequence(s) have been attached, but keep the energy parameters
+ *  and the DP matrices whenever possible
+ */
+PRIVATE void
+retarget(vrna_fold_compound_t *fc,
+         vrna_md_t            *md_p,
+         unsigned int         n_seq_old,
+         unsigned int         options)
+{
+  unsigned int  aux_options;
+  vrna_md_t     md;
+
+  /* get a copy of the model details */
+  if (md_p)
+    md = *md_p;
+  else /* this fallback relies on global parameters and thus is not threadsafe */
+    vrna_md_set_default(&md);
+
+  /*
+   *  sanitize_bp_span() and set_fold_compound() adapt window size, base pair
+   *  span, and minimum loop size of the model details attached to the energy
+   *  parameters to the current sequence. None of them enters the actual energy
+   *  contributions, so we reset them to the requested values to let add_params()
+   *  and vrna_params_prepare() keep the parameters if nothing else changed
+   */
+  if (fc->params)
+    reset_sequence_dependent_md(&(fc->params->model_details), &md);
+
+  if (fc->exp_params) {
+    /* Boltzmann factors for alignments are scaled by the number of sequences */
+    if ((fc->type == VRNA_FC_TYPE_COMPARATIVE) && (n_seq_old != fc->n_seq)) {
+      free(fc->exp_params);
+      fc->exp_params = NULL;
+    } else {
+      reset_sequence_dependent_md(&(fc->exp_params->model_details), &md);
+    }
+  }
+
+  add_params(fc, &md, options);
+
+  /*
+   *  without VRNA_OPTION_PF, add_params() leaves the Boltzmann factors untouched,
+   *  but vrna_exp_params_rescale() would only update their model details later on
+   */
+  if ((fc->exp_params) &&
+      (memcmp(&md, &(fc->exp_params->model_details), sizeof(vrna_md_t)) != 0)) {
+    free(fc->exp_params);
+    fc->exp_params = NULL;
+  }
+
+  /* a new fold compound always starts with an unknown scaling factor */
+  if (fc->exp_params)
+    fc->exp_params->pf_scale = -1.;
+
+  sanitize_bp_span(fc, options);
+
+  aux_options = WITH_PTYPE;
+
+  if (options & VRNA_OPTION_PF)
+    aux_options |= WITH_PTYPE_COMPAT;
+
+  set_fold_compound(fc, options, aux_options);
+
+  if (fc->type == VRNA_FC_TYPE_COMPARATIVE)
+    make_pscores(fc);
+
+  if (options & VRNA_OPTION_EVAL_ONLY) {
+    vrna_mx_mfe_free(fc);
+    vrna_mx_pf_free(fc);
+  } else {
+    /* add default hard constraints */
+    vrna_hc_init(fc);
+
+    /* keep DP matrices of sufficient size and clear them, drop all others */
+    if (fc->matrices) {
+      if ((fc->matrices->type == VRNA_MX_DEFAULT) &&
+          (fc->matrices->length >= fc->length))
+        reset_mfe_matrices(fc);
+      else
+        vrna_mx_mfe_free(fc);
+    }
+
+    if (fc->exp_matrices) {
+      if ((fc->exp_matrices->type == VRNA_MX_DEFAULT) &&
+          (fc->exp_matrices->length >= fc->length) &&
+          (fc->exp_params))
+        reset_pf_matrices(fc);
+      else
+        vrna_mx_pf_free(fc);
+    }
+
+    /* add missing DP matrices (if required) */
+    vrna_mx_prepare(fc, options);
+  }
+}
+
+
+PRIVATE INLINE void
+reset_sequence_dependent_md(vrna_md_t       *md,
+                            const vrna_md_t *md_requested)
+{
+  md->window_size   = md_requested->window_size;
+  md->max_bp_span   = md_requested->max_bp_span;
+  md->min_loop_size = md_requested->min_loop_size;
+}
+
+
+/*
+ *  bring the MFE matrices into the state of newly allocated ones, i.e. clear
+ *  all entries that may be accessed for the current sequence length
+ */
+PRIVATE void
+reset_mfe_matrices(vrna_fold_compound_t *fc)
+{
+  unsigned int  n, size, lin_size;
+  vrna_mx_mfe_t *mx;
+
+  mx        = fc->matrices;
+  n         = fc->length;
+  size      = ((n + 1) * (n + 2)) / 2;
+  lin_size  = n + 2;
+
+  if (mx->c)
+    memset(mx->c, 0, sizeof(int) * size);
+
+  if (mx->fML)
+    memset(mx->fML, 0, sizeof(int) * size);
+
+  if (mx->fM1)
+    memset(mx->fM1, 0, sizeof(int) * size);
+
+  if (mx->f5)
+    memset(mx->f5, 0, sizeof(int) * lin_size);
+
+  if (mx->f3)
+    memset(mx->f3, 0, sizeof(int) * lin_size);
+
+  if (mx->fc)
+    memset(mx->fc, 0, sizeof(int) * lin_size);
+
+  if (mx->fM2)
+    memset(mx->fM2, 0, sizeof(int) * lin_size);
+
+  mx->FcH = mx->FcI = mx->FcM = mx->Fc = INF;
+
+  /* G-quadruplex energies depend on the sequence */
+  vrna_gquad_mx_free(mx->ggg);
+  mx->ggg = NULL;
+
+  if (fc->params->model_details.gquad) {
+    switch (fc->type) {
+      case VRNA_FC_TYPE_SINGLE:
+        mx->ggg = vrna_gquad_mx_mfe(fc->sequence_encoding2, fc->params);
+        break;
+      case VRNA_FC_TYPE_COMPARATIVE:
+        mx->ggg = vrna_gquad_mx_mfe_ali(fc->S_cons, fc->S, fc->n_seq, fc->params);
+        break;
+      default:                      /* do nothing */
+        break;
+    }
+  }
+}
+
+
+/* same as above for the partition function matrices */
+PRIVATE void
+reset_pf_matrices(vrna_fold_compound_t *fc)
+{
+  unsigned int  n, size, lin_size;
+  vrna_mx_pf_t  *mx;
+
+  mx        = fc->exp_matrices;
+  n         = fc->length;
+  size      = ((n + 1) * (n + 2)) / 2;
+  lin_size  = n + 2;
+
+  if (mx->q)
+    memset(mx->q, 0, sizeof(FLT_OR_DBL) * size);
+
+  if (mx->qb)
+    memset(mx->qb, 0, sizeof(FLT_OR_DBL) * size);
+
+  if (mx->qm)
+    memset(mx->qm, 0, sizeof(FLT_OR_DBL) * size);
+
+  if (mx->qm1)
+    memset(mx->qm1, 0, sizeof(FLT_OR_DBL) * size);
+
+  if (mx->probs)
+    memset(mx->probs, 0, sizeof(FLT_OR_DBL) * size);
+
+  if (mx->qm2)
+    memset(mx->qm2, 0, sizeof(FLT_OR_DBL) * lin_size);
+
+  if (mx->q1k)
+    memset(mx->q1k, 0, sizeof(FLT_OR_DBL) * lin_size);
+
+  if (mx->qln)
+    memset(mx->qln, 0, sizeof(FLT_OR_DBL) * lin_size);
+
+  mx->qo = mx->qho = mx->qio = mx->qmo = 0.;
+
+  /* a re-targeted fold compound starts without memoized stochastic backtracking decompositions */
+  vrna_pbacktrack_cache_free(fc);
+
+  /* G-quadruplex Boltzmann factors are re-computed in vrna_pf() */
+  vrna_gquad_mx_free(mx->G);
+  mx->G = NULL;
+
+  /* re-compute the scaling factors for the current sequence length */
+  vrna_exp_params_rescale(fc, NULL);
+}
+
+
+/* only fold compounds for global structure prediction can be re-targeted */
+PRIVATE int
+retargetable(vrna_fold_compound_t *fc)
+{
+  if ((fc->type != VRNA_FC_TYPE_SINGLE) && (fc->type != VRNA_FC_TYPE_COMPARATIVE))
+    return 0;
+
+  if ((fc->hc) && (fc->hc->type != VRNA_HC_DEFAULT))
+    return 0;
+
+  if ((fc->matrices) && (fc->matrices->type != VRNA_MX_DEFAULT))
+    return 0;
+
+  if ((fc->exp_matrices) && (fc->exp_matrices->type != VRNA_MX_DEFAULT))
+    return 0;
+
+  /* distance class partitioning */
+  if (fc->reference_pt1)
+    return 0;
+
+  return 1;
+}
+
+
+/* remove the most recently released fold compound of a particular type from the pool */
+PRIVATE vrna_fold_compound_t *
+pool_take(vrna_fold_compound_pool_t *pool,
+          vrna_fc_type_e            type)
+{
+  unsigned int          i;
+  vrna_fold_compound_t  *fc;
+
+  fc = NULL;
+
+  if (pool) {
+#if VRNA_WITH_PTHREADS
+    pthread_mutex_lock(&pool->mtx);
+#endif
+
+    for (i = pool->num; i > 0; i--)
+      if (pool->idle[i - 1]->type == type) {
+        fc = pool->idle[i - 1];
+        memmove(pool->idle + i - 1,
+                pool->idle + i,
+                sizeof(vrna_fold_compound_t *) * (pool->num - i));
+        pool->num--;
+        break;
+      }
+
+#if VRNA_WITH_PTHREADS
+    pthread_mutex_unlock(&pool->mtx);
+#endif
+  }
+
+  return fc;
+}
+
+
 PRIVATE vrna_fold_compound_t *
 init_fc_single(void)
 {
@@ -891,6 +1478,7 @@ nullify(vrna_fold_compound_t *fc)
     fc->stat_cb       = NULL;
     fc->auxdata       = NULL;
     fc->free_auxdata  = NULL;
+    fc->rng           = NULL;
 
     fc->domains_struc = NULL;
     fc->domains_up    = NULL;
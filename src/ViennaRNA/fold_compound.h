@@ -25,6 +25,12 @@
  */
 typedef struct vrna_fc_s vrna_fold_compound_t;
 
+/**
+ *  @brief  Typename for the pool of re-usable #vrna_fold_compound_t data structures
+ *  @see    vrna_fold_compound_pool_init(), vrna_fold_compound_pool_acquire(), vrna_fold_compound_pool_release()
+ */
+typedef struct vrna_fc_pool_s vrna_fold_compound_pool_t;
+
 /**
  *  @brief Callback to free memory allocated for auxiliary user-provided data
  *
@@ -98,6 +104,7 @@ typedef void (vrna_callback_recursion_status)(unsigned char status,
 #define VRNA_STATUS_PF_POST     (unsigned char)4
 
 
+#include <ViennaRNA/utils/basic.h>
 #include <ViennaRNA/model.h>
 #include <ViennaRNA/params/basic.h>
 #include <ViennaRNA/sequence.h>
@@ -334,6 +341,11 @@ struct vrna_fc_s {
   /**
    *  @}
    */
+
+  vrna_rng_t  *rng;               /**<  @brief  A random number generator state used for stochastic backtracking
+                                   *            (falls back to vrna_urn() if NULL)
+                                   *    @see    vrna_fold_compound_add_rng(), vrna_pbacktrack()
+                                   */
 };
 
 
@@ -491,6 +503,147 @@ void
 vrna_fold_compound_free(vrna_fold_compound_t *fc);
 
 
+/**
+ *  @brief  Re-target a #vrna_fold_compound_t to another single sequence, or pair of hybridizing sequences
+ *
+ *  This function turns an existing #vrna_fold_compound_t into the same state a call to
+ *  vrna_fold_compound() with the same arguments would produce, but re-uses as much of the
+ *  memory already attached to @p fc as possible. In particular, the energy parameters and
+ *  Boltzmann factors are kept whenever the model details did not change, and the DP matrices
+ *  are kept (and cleared) whenever they are large enough to hold the new sequence. Everything
+ *  that depends on the actual sequence, i.e. the sequence encodings, hard and soft constraints,
+ *  unstructured domains, and auxiliary data is removed. Processing many short sequences with
+ *  a single #vrna_fold_compound_t therefore saves the repeated preparation of energy parameters
+ *  and most of the memory allocations.
+ *
+ *  @note Only fold compounds of type #VRNA_FC_TYPE_SINGLE for global structure prediction can be
+ *        re-targeted. Energy parameters that have been substituted by the user remain in place if
+ *        the model details do not change. The partition function scaling factor is always reset.
+ *
+ *  @see  vrna_fold_compound(), vrna_fold_compound_comparative_retarget(), vrna_fold_compound_pool_acquire()
+ *
+ *  @param    fc          The #vrna_fold_compound_t to re-target
+ *  @param    sequence    A single sequence, or two concatenated sequences seperated by an '&' character
+ *  @param    md_p        An optional set of model details
+ *  @param    options     The options for DP matrices memory allocation
+ *  @return               1 on success, 0 on error (in which case @p fc remains unchanged)
+ */
+int
+vrna_fold_compound_retarget(vrna_fold_compound_t  *fc,
+                            const char            *sequence,
+                            vrna_md_t             *md_p,
+                            unsigned int          options);
+
+
+/**
+ *  @brief  Re-target a #vrna_fold_compound_t to another sequence alignment
+ *
+ *  This is the comparative counterpart of vrna_fold_compound_retarget(). The Boltzmann factors
+ *  are only kept if the number of sequences in the alignment did not change.
+ *
+ *  @see  vrna_fold_compound_comparative(), vrna_fold_compound_retarget(),
+ *        vrna_fold_compound_pool_acquire_comparative()
+ *
+ *  @param    fc          The #vrna_fold_compound_t to re-target
+ *  @param    sequences   A sequence alignment including 'gap' characters
+ *  @param    md_p        An optional set of model details
+ *  @param    options     The options for DP matrices memory allocation
+ *  @return               1 on success, 0 on error (in which case @p fc remains unchanged)
+ */
+int
+vrna_fold_compound_comparative_retarget(vrna_fold_compound_t  *fc,
+                                        const char            **sequences,
+                                        vrna_md_t             *md_p,
+                                        unsigned int          options);
+
+
+/**
+ *  @brief  Create a pool of re-usable #vrna_fold_compound_t data structures
+ *
+ *  A pool keeps fold compounds that are no longer required, and hands them out again,
+ *  re-targeted to a new input, through vrna_fold_compound_pool_acquire(). If each worker
+ *  thread of a batch computation acquires a fold compound for each input and releases it
+ *  afterwards, the pool holds at most one fold compound per thread. Access to the pool is
+ *  thread-safe if RNAlib has been compiled with POSIX threads support.
+ *
+ *  @see  vrna_fold_compound_pool_acquire(), vrna_fold_compound_pool_release(),
+ *        vrna_fold_compound_pool_free(), vrna_fold_compound_retarget()
+ *
+ *  @param  max_length  Do not keep fold compounds for sequences longer than this (0 = no limit)
+ *  @return             An empty pool
+ */
+vrna_fold_compound_pool_t *
+vrna_fold_compound_pool_init(unsigned int max_length);
+
+
+/**
+ *  @brief  Free a pool of #vrna_fold_compound_t data structures, including all idle fold compounds
+ *
+ *  @see  vrna_fold_compound_pool_init()
+ *
+ *  @param  pool  The pool to free
+ */
+void
+vrna_fold_compound_pool_free(vrna_fold_compound_pool_t *pool);
+
+
+/**
+ *  @brief  Obtain a #vrna_fold_compound_t for a single sequence, or pair of hybridizing sequences, from a pool
+ *
+ *  Re-targets an idle fold compound of the pool (see vrna_fold_compound_retarget()), or creates
+ *  a new one with vrna_fold_compound() if none is available. In either case, the result is the
+ *  same as that of vrna_fold_compound().
+ *
+ *  @see  vrna_fold_compound_pool_release(), vrna_fold_compound(), vrna_fold_compound_retarget()
+ *
+ *  @param    pool        The pool (may be @p NULL)
+ *  @param    sequence    A single sequence, or two concatenated sequences seperated by an '&' character
+ *  @param    md_p        An optional set of model details
+ *  @param    options     The options for DP matrices memory allocation
+ *  @return               A prefilled vrna_fold_compound_t ready to be used for computations (may be @p NULL on error)
+ */
+vrna_fold_compound_t *
+vrna_fold_compound_pool_acquire(vrna_fold_compound_pool_t *pool,
+                                const char                *sequence,
+                                vrna_md_t                 *md_p,
+                                unsigned int              options);
+
+
+/**
+ *  @brief  Obtain a #vrna_fold_compound_t for a sequence alignment from a pool
+ *
+ *  @see  vrna_fold_compound_pool_acquire(), vrna_fold_compound_pool_release(),
+ *        vrna_fold_compound_comparative(), vrna_fold_compound_comparative_retarget()
+ *
+ *  @param    pool        The pool (may be @p NULL)
+ *  @param    sequences   A sequence alignment including 'gap' characters
+ *  @param    md_p        An optional set of model details
+ *  @param    options     The options for DP matrices memory allocation
+ *  @return               A prefilled vrna_fold_compound_t ready to be used for computations (may be @p NULL on error)
+ */
+vrna_fold_compound_t *
+vrna_fold_compound_pool_acquire_comparative(vrna_fold_compound_pool_t *pool,
+                                            const char                **sequences,
+                                            vrna_md_t                 *md_p,
+                                            unsigned int              options);
+
+
+/**
+ *  @brief  Return a #vrna_fold_compound_t to a pool
+ *
+ *  The fold compound must not be used by the caller afterwards. Fold compounds that can not
+ *  be re-targeted, or that exceed the maximum sequence length of the pool, are freed instead.
+ *
+ *  @see  vrna_fold_compound_pool_acquire(), vrna_fold_compound_pool_init()
+ *
+ *  @param  pool  The pool (may be @p NULL, in which case @p fc is simply freed)
+ *  @param  fc    The fold compound that is no longer required
+ */
+void
+vrna_fold_compound_pool_release(vrna_fold_compound_pool_t *pool,
+                                vrna_fold_compound_t      *fc);
+
+
 /**
  *  @brief  Add auxiliary data to the #vrna_fold_compound_t
  *
@@ -513,6 +666,25 @@ void vrna_fold_compound_add_auxdata(vrna_fold_compound_t        *fc,
                                     vrna_callback_free_auxdata  *f);
 
 
+/**
+ *  @brief  Attach a random number generator state to the #vrna_fold_compound_t
+ *
+ *  Stochastic backtracking, e.g. vrna_pbacktrack(), draws its random numbers from this state instead
+ *  of the process-wide generator behind vrna_urn(). This renders sampling from different fold compounds
+ *  in different threads reproducible and free of interference. Independent streams for each thread can
+ *  be obtained from a single seed with vrna_rng_split().
+ *
+ *  The #vrna_fold_compound_t takes over ownership of @p rng, i.e. the state is free'd together with
+ *  the fold compound, or when another state is attached. Passing NULL detaches the current state.
+ *
+ *  @see vrna_rng_init(), vrna_rng_split(), vrna_pbacktrack()
+ *  @param  fc    The fold_compound the random number generator state should be associated with
+ *  @param  rng   The random number generator state (May be NULL)
+ */
+void vrna_fold_compound_add_rng(vrna_fold_compound_t  *fc,
+                                vrna_rng_t            *rng);
+
+
 /**
  *  @brief  Add a recursion status callback to the #vrna_fold_compound_t
  *
@@ -69,6 +69,22 @@ get_g_islands_sub(short *S,
                   int   j);
 
 
+PRIVATE vrna_gquad_mx_t *
+gquad_mx_init(int n,
+              int *gg,
+              int pf);
+
+
+PRIVATE void
+gquad_mx_add_row(vrna_gquad_mx_t  *mx,
+                 int              i,
+                 void             *row);
+
+
+PRIVATE vrna_gquad_mx_t *
+gquad_mx_finalize(vrna_gquad_mx_t *mx);
+
+
 /**
  *  IMPORTANT:
  *  If you don't know how to use this function, DONT'T USE IT!
@@ -508,6 +524,155 @@ get_gquad_ali_matrix(short        *S_cons,
 }
 
 
+PUBLIC vrna_gquad_mx_t *
+vrna_gquad_mx_mfe(short         *S,
+                  vrna_param_t  *P)
+{
+  int             n, i, j, *gg, *row;
+  vrna_gquad_mx_t *mx;
+
+  n   = S[0];
+  gg  = get_g_islands(S);
+  mx  = gquad_mx_init(n, gg, 0);
+  row = (int *)vrna_alloc(sizeof(int) * mx->width);
+
+  for (i = n - VRNA_GQUAD_MIN_BOX_SIZE + 1; i >= 1; i--) {
+    if (gg[i] < VRNA_GQUAD_MIN_STACK_SIZE)
+      continue;
+
+    for (j = 0; j < (int)mx->width; j++)
+      row[j] = INF;
+
+    FOR_EACH_GQUAD_AT(i, j, n){
+      process_gquad_enumeration(gg, i, j,
+                                &gquad_mfe,
+                                (void *)(&(row[j - i])),
+                                (void *)P,
+                                NULL,
+                                NULL);
+    }
+
+    gquad_mx_add_row(mx, i, (void *)row);
+  }
+
+  free(row);
+  free(gg);
+
+  return gquad_mx_finalize(mx);
+}
+
+
+PUBLIC vrna_gquad_mx_t *
+vrna_gquad_mx_mfe_ali(short         *S_cons,
+                      short         **S,
+                      int           n_seq,
+                      vrna_param_t  *P)
+{
+  int             n, i, j, *gg, *row;
+  vrna_gquad_mx_t *mx;
+
+  n   = S[0][0];
+  gg  = get_g_islands(S_cons);
+  mx  = gquad_mx_init(n, gg, 0);
+  row = (int *)vrna_alloc(sizeof(int) * mx->width);
+
+  for (i = n - VRNA_GQUAD_MIN_BOX_SIZE + 1; i >= 1; i--) {
+    if (gg[i] < VRNA_GQUAD_MIN_STACK_SIZE)
+      continue;
+
+    for (j = 0; j < (int)mx->width; j++)
+      row[j] = INF;
+
+    FOR_EACH_GQUAD_AT(i, j, n){
+      process_gquad_enumeration(gg, i, j,
+                                &gquad_mfe_ali,
+                                (void *)(&(row[j - i])),
+                                (void *)P,
+                                (void *)S,
+                                (void *)(&n_seq));
+    }
+
+    gquad_mx_add_row(mx, i, (void *)row);
+  }
+
+  free(row);
+  free(gg);
+
+  return gquad_mx_finalize(mx);
+}
+
+
+PUBLIC vrna_gquad_mx_t *
+vrna_gquad_mx_pf(short            *S,
+                 FLT_OR_DBL       *scale,
+                 vrna_exp_param_t *pf)
+{
+  int             n, i, j, *gg;
+  FLT_OR_DBL      *row;
+  vrna_gquad_mx_t *mx;
+
+  n   = S[0];
+  gg  = get_g_islands(S);
+  mx  = gquad_mx_init(n, gg, 1);
+  row = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * mx->width);
+
+  for (i = n - VRNA_GQUAD_MIN_BOX_SIZE + 1; i >= 1; i--) {
+    if (gg[i] < VRNA_GQUAD_MIN_STACK_SIZE)
+      continue;
+
+    for (j = 0; j < (int)mx->width; j++)
+      row[j] = 0.;
+
+    FOR_EACH_GQUAD_AT(i, j, n){
+      process_gquad_enumeration(gg, i, j,
+                                &gquad_pf,
+                                (void *)(&(row[j - i])),
+                                (void *)pf,
+                                NULL,
+                                NULL);
+      row[j - i] *= scale[j - i + 1];
+    }
+
+    gquad_mx_add_row(mx, i, (void *)row);
+  }
+
+  free(row);
+  free(gg);
+
+  return gquad_mx_finalize(mx);
+}
+
+
+PUBLIC void
+vrna_gquad_mx_free(vrna_gquad_mx_t *mx)
+{
+  if (mx) {
+    free(mx->row);
+    free(mx->e);
+    free(mx->q);
+    free(mx);
+  }
+}
+
+
+PUBLIC int
+vrna_gquad_mx_get(const vrna_gquad_mx_t *mx,
+                  int                   i,
+                  int                   j)
+{
+  return gquad_mx_get(mx, i, j);
+}
+
+
+PUBLIC FLT_OR_DBL
+vrna_gquad_mx_get_pf(const vrna_gquad_mx_t  *mx,
+                     int                    i,
+                     int                    j)
+{
+  return gquad_mx_get_pf(mx, i, j);
+}
+
+
 PUBLIC int **
 get_gquad_L_matrix(short        *S,
                    int          start,
@@ -843,7 +1008,7 @@ PUBLIC plist *
 get_plist_gquad_from_pr(short             *S,
                         int               gi,
                         int               gj,
-                        FLT_OR_DBL        *G,
+                        vrna_gquad_mx_t   *G,
                         FLT_OR_DBL        *probs,
                         FLT_OR_DBL        *scale,
                         vrna_exp_param_t  *pf)
@@ -858,30 +1023,39 @@ PUBLIC plist *
 get_plist_gquad_from_pr_max(short             *S,
                             int               gi,
                             int               gj,
-                            FLT_OR_DBL        *G,
+                            vrna_gquad_mx_t   *G,
                             FLT_OR_DBL        *probs,
                             FLT_OR_DBL        *scale,
                             int               *Lmax,
                             int               lmax[3],
                             vrna_exp_param_t  *pf)
 {
-  int         n, size, *gg, counter, i, j, *my_index;
-  FLT_OR_DBL  pp, *tempprobs;
+  int         n, m, size, *gg, counter, i, j, *my_index, *local_index;
+  FLT_OR_DBL  pp, *tempprobs, *local_probs;
   plist       *pl;
 
-  n         = S[0];
-  size      = (n * (n + 1)) / 2 + 2;
-  tempprobs = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * size);
-  pl        = (plist *)vrna_alloc((S[0] * S[0]) * sizeof(plist));
-  gg        = get_g_islands_sub(S, gi, gj);
-  counter   = 0;
-  my_index  = vrna_idx_row_wise(n);
+  /*
+   *  all pairs of a G-quadruplex are located within [gi,gj], so we only
+   *  need a triangular matrix for this segment rather than the entire sequence
+   */
+  n           = S[0];
+  m           = gj - gi + 1;
+  size        = (m * (m + 1)) / 2 + 2;
+  tempprobs   = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * size);
+  pl          = (plist *)vrna_alloc((m * m + 1) * sizeof(plist));
+  gg          = get_g_islands_sub(S, gi, gj);
+  counter     = 0;
+  my_index    = vrna_idx_row_wise(n);
+  local_index = vrna_idx_row_wise(m);
+  /* shift both, such that local_probs[local_index[i] - j] addresses position (i,j) with gi <= i <= j <= gj */
+  local_index -= gi - 1;
+  local_probs = tempprobs + (gi - 1);
 
   process_gquad_enumeration(gg, gi, gj,
                             &gquad_interact,
-                            (void *)tempprobs,
+                            (void *)local_probs,
                             (void *)pf,
-                            (void *)my_index,
+                            (void *)local_index,
                             NULL);
 
   pp = 0.;
@@ -892,13 +1066,13 @@ get_plist_gquad_from_pr_max(short             *S,
                             (void *)Lmax,
                             (void *)lmax);
 
-  pp = probs[my_index[gi] - gj] * scale[gj - gi + 1] / G[my_index[gi] - gj];
+  pp = probs[my_index[gi] - gj] * scale[gj - gi + 1] / gquad_mx_get_pf(G, gi, gj);
   for (i = gi; i < gj; i++) {
     for (j = i; j <= gj; j++) {
-      if (tempprobs[my_index[i] - j] > 0.) {
+      if (local_probs[local_index[i] - j] > 0.) {
         pl[counter].i   = i;
         pl[counter].j   = j;
-        pl[counter++].p = pp * tempprobs[my_index[i] - j];
+        pl[counter++].p = pp * local_probs[local_index[i] - j];
       }
     }
   }
@@ -907,9 +1081,11 @@ get_plist_gquad_from_pr_max(short             *S,
   /* shrink memory to actual size needed */
   pl = (plist *)vrna_realloc(pl, counter * sizeof(plist));
 
-  gg += gi - 1;
+  gg          += gi - 1;
+  local_index += gi - 1;
   free(gg);
   free(my_index);
+  free(local_index);
   free(tempprobs);
   return pl;
 }
@@ -1328,6 +1504,88 @@ gquad_interact(int  i,
 }
 
 
+PRIVATE vrna_gquad_mx_t *
+gquad_mx_init(int n,
+              int *gg,
+              int pf)
+{
+  int             i;
+  size_t          k, rows;
+  vrna_gquad_mx_t *mx;
+
+  /* upper bound for the number of rows to store, i.e. rows starting with a G-run of sufficient size */
+  for (rows = 0, i = 1; i <= n; i++)
+    if (gg[i] >= VRNA_GQUAD_MIN_STACK_SIZE)
+      rows++;
+
+  mx          = (vrna_gquad_mx_t *)vrna_alloc(sizeof(vrna_gquad_mx_t));
+  mx->length  = (unsigned int)n;
+  mx->width   = VRNA_GQUAD_MAX_BOX_SIZE;
+  /* all rows, including the boundaries 0 and n + 1, start out as the neutral row at offset 0 */
+  mx->row   = (size_t *)vrna_alloc(sizeof(size_t) * (n + 2));
+  mx->size  = mx->width;
+  mx->e     = NULL;
+  mx->q     = NULL;
+
+  if (pf) {
+    mx->q = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * mx->width * (rows + 1));
+  } else {
+    mx->e = (int *)vrna_alloc(sizeof(int) * mx->width * (rows + 1));
+    for (k = 0; k < mx->width; k++)
+      mx->e[k] = INF;
+  }
+
+  return mx;
+}
+
+
+/*
+ *  Append the band of row i to the value array, unless it only
+ *  consists of neutral entries
+ */
+PRIVATE void
+gquad_mx_add_row(vrna_gquad_mx_t  *mx,
+                 int              i,
+                 void             *row)
+{
+  unsigned int d;
+
+  if (mx->q) {
+    for (d = 0; d < mx->width; d++)
+      if (((FLT_OR_DBL *)row)[d] != 0.)
+        break;
+  } else {
+    for (d = 0; d < mx->width; d++)
+      if (((int *)row)[d] != INF)
+        break;
+  }
+
+  if (d == mx->width)
+    return;
+
+  if (mx->q)
+    memcpy(mx->q + mx->size, row, sizeof(FLT_OR_DBL) * mx->width);
+  else
+    memcpy(mx->e + mx->size, row, sizeof(int) * mx->width);
+
+  mx->row[i]  = mx->size;
+  mx->size    += mx->width;
+}
+
+
+/* release the memory of candidate rows that turned out to be empty */
+PRIVATE vrna_gquad_mx_t *
+gquad_mx_finalize(vrna_gquad_mx_t *mx)
+{
+  if (mx->q)
+    mx->q = (FLT_OR_DBL *)vrna_realloc(mx->q, sizeof(FLT_OR_DBL) * mx->size);
+  else
+    mx->e = (int *)vrna_realloc(mx->e, sizeof(int) * mx->size);
+
+  return mx;
+}
+
+
 PRIVATE INLINE int *
 get_g_islands(short *S)
 {
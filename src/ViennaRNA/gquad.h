@@ -26,6 +26,32 @@
  */
 
 
+/**
+ *  @brief  Sparse storage of G-quadruplex free energies or Boltzmann weights
+ *
+ *  G-quadruplexes delimited by @f$(i,j)@f$ can only form if both positions
+ *  are part of G-islands and the span @f$j - i + 1@f$ does not exceed
+ *  #VRNA_GQUAD_MAX_BOX_SIZE. Instead of a full triangular matrix, only rows
+ *  @f$i@f$ that actually start at least one G-quadruplex are stored, each
+ *  as a band of #VRNA_GQUAD_MAX_BOX_SIZE entries. All other rows share a
+ *  single band of neutral entries, i.e. INF for free energies and @f$0@f$
+ *  for Boltzmann weights.
+ *
+ *  Use vrna_gquad_mx_get() and vrna_gquad_mx_get_pf() for element access.
+ *
+ *  @see vrna_gquad_mx_mfe(), vrna_gquad_mx_mfe_ali(), vrna_gquad_mx_pf(),
+ *       vrna_gquad_mx_free()
+ */
+struct vrna_gquad_mx_s {
+  unsigned int  length;   /**<  @brief  Length of the sequence */
+  unsigned int  width;    /**<  @brief  Number of entries per row, i.e. the maximum span of a G-quadruplex */
+  size_t        *row;     /**<  @brief  Offset of row @f$i@f$ within the value array, 0 for rows without G-quadruplexes */
+  size_t        size;     /**<  @brief  Number of entries in the value array (including the shared neutral row) */
+  int           *e;       /**<  @brief  Free energies in dcal/mol, or NULL for Boltzmann weights */
+  FLT_OR_DBL    *q;       /**<  @brief  Boltzmann weights, or NULL for free energies */
+};
+
+
 int         E_gquad(int           L,
                     int           l[3],
                     vrna_param_t  *P);
@@ -84,6 +110,93 @@ FLT_OR_DBL *get_gquad_pf_matrix(short             *S,
                                 vrna_exp_param_t  *pf);
 
 
+/**
+ *  @brief  Get a sparse matrix of minimum free energy contributions of G-quadruplexes
+ *
+ *  In contrast to get_gquad_matrix(), memory is only allocated for rows
+ *  @f$i@f$ where at least one G-quadruplex may start. Access the elements
+ *  via vrna_gquad_mx_get().
+ *
+ *  @see vrna_gquad_mx_free(), #vrna_gquad_mx_t
+ *
+ *  @param S  The encoded sequence (with the length stored at position 0)
+ *  @param P  A pointer to the data structure containing the precomputed energy contributions
+ *  @return   The sparse G-quadruplex free energy matrix
+ */
+vrna_gquad_mx_t *vrna_gquad_mx_mfe(short         *S,
+                                   vrna_param_t  *P);
+
+
+/**
+ *  @brief  Get a sparse matrix of consensus G-quadruplex free energies for an alignment
+ *
+ *  @see vrna_gquad_mx_mfe(), vrna_gquad_mx_free()
+ *
+ *  @param S_cons The encoded consensus sequence
+ *  @param S      The encoded sequences of the alignment
+ *  @param n_seq  The number of sequences in the alignment
+ *  @param P      A pointer to the data structure containing the precomputed energy contributions
+ *  @return       The sparse G-quadruplex free energy matrix
+ */
+vrna_gquad_mx_t *vrna_gquad_mx_mfe_ali(short         *S_cons,
+                                       short         **S,
+                                       int           n_seq,
+                                       vrna_param_t  *P);
+
+
+/**
+ *  @brief  Get a sparse matrix of G-quadruplex Boltzmann weights
+ *
+ *  The weights of a G-quadruplex delimited by @f$(i,j)@f$ are already
+ *  multiplied with the scaling factor for @f$j - i + 1@f$ nucleotides.
+ *  Access the elements via vrna_gquad_mx_get_pf().
+ *
+ *  @see vrna_gquad_mx_free(), #vrna_gquad_mx_t
+ *
+ *  @param S      The encoded sequence (with the length stored at position 0)
+ *  @param scale  The scaling factors for subsegments of the sequence
+ *  @param pf     A pointer to the data structure containing the precomputed Boltzmann factors
+ *  @return       The sparse G-quadruplex Boltzmann weight matrix
+ */
+vrna_gquad_mx_t *vrna_gquad_mx_pf(short             *S,
+                                  FLT_OR_DBL        *scale,
+                                  vrna_exp_param_t  *pf);
+
+
+/**
+ *  @brief  Free memory occupied by a sparse G-quadruplex matrix
+ *
+ *  @param mx The sparse G-quadruplex matrix (may be NULL)
+ */
+void vrna_gquad_mx_free(vrna_gquad_mx_t *mx);
+
+
+/**
+ *  @brief  Get the free energy of the G-quadruplex delimited by @f$(i,j)@f$
+ *
+ *  @param mx The sparse G-quadruplex free energy matrix
+ *  @param i  The 5' delimiter of the G-quadruplex
+ *  @param j  The 3' delimiter of the G-quadruplex
+ *  @return   The free energy in dcal/mol, or INF if no G-quadruplex is possible
+ */
+int vrna_gquad_mx_get(const vrna_gquad_mx_t *mx,
+                      int                   i,
+                      int                   j);
+
+
+/**
+ *  @brief  Get the Boltzmann weight of G-quadruplexes delimited by @f$(i,j)@f$
+ *
+ *  @param mx The sparse G-quadruplex Boltzmann weight matrix
+ *  @param i  The 5' delimiter of the G-quadruplex
+ *  @param j  The 3' delimiter of the G-quadruplex
+ *  @return   The (scaled) Boltzmann weight, or 0 if no G-quadruplex is possible
+ */
+FLT_OR_DBL vrna_gquad_mx_get_pf(const vrna_gquad_mx_t  *mx,
+                                int                    i,
+                                int                    j);
+
+
 int **get_gquad_L_matrix(short        *S,
                          int          start,
                          int          maxdist,
@@ -125,7 +238,7 @@ void get_gquad_pattern_pf(short             *S,
 plist *get_plist_gquad_from_pr(short            *S,
                                int              gi,
                                int              gj,
-                               FLT_OR_DBL       *G,
+                               vrna_gquad_mx_t  *G,
                                FLT_OR_DBL       *probs,
                                FLT_OR_DBL       *scale,
                                vrna_exp_param_t *pf);
@@ -134,7 +247,7 @@ plist *get_plist_gquad_from_pr(short            *S,
 plist *get_plist_gquad_from_pr_max(short            *S,
                                    int              gi,
                                    int              gj,
-                                   FLT_OR_DBL       *G,
+                                   vrna_gquad_mx_t  *G,
                                    FLT_OR_DBL       *probs,
                                    FLT_OR_DBL       *scale,
                                    int              *L,
@@ -181,31 +294,56 @@ int parse_gquad(const char  *struc,
                 int         l[3]);
 
 
-INLINE PRIVATE int backtrack_GQuad_IntLoop(int          c,
-                                           int          i,
-                                           int          j,
-                                           int          type,
-                                           short        *S,
-                                           int          *ggg,
-                                           int          *index,
-                                           int          *p,
-                                           int          *q,
-                                           vrna_param_t *P);
-
-
-INLINE PRIVATE int backtrack_GQuad_IntLoop_comparative(int          c,
-                                                       int          i,
-                                                       int          j,
-                                                       unsigned int *type,
-                                                       short        *S_cons,
-                                                       short        **S5,
-                                                       short        **S3,
-                                                       int          *ggg,
-                                                       int          *index,
-                                                       int          *p,
-                                                       int          *q,
-                                                       int          n_seq,
-                                                       vrna_param_t *P);
+/*
+ *  Element access of the sparse G-quadruplex matrices for the recursions
+ *  within RNAlib. Same as vrna_gquad_mx_get() and vrna_gquad_mx_get_pf()
+ *  but inlined into the (hot) decomposition loops.
+ */
+PRIVATE INLINE int
+gquad_mx_get(const vrna_gquad_mx_t  *mx,
+             int                    i,
+             int                    j)
+{
+  unsigned int d = (unsigned int)(j - i);
+
+  return (d < mx->width) ? mx->e[mx->row[i] + d] : INF;
+}
+
+
+PRIVATE INLINE FLT_OR_DBL
+gquad_mx_get_pf(const vrna_gquad_mx_t *mx,
+                int                   i,
+                int                   j)
+{
+  unsigned int d = (unsigned int)(j - i);
+
+  return (d < mx->width) ? mx->q[mx->row[i] + d] : 0.;
+}
+
+
+INLINE PRIVATE int backtrack_GQuad_IntLoop(int             c,
+                                           int             i,
+                                           int             j,
+                                           int             type,
+                                           short           *S,
+                                           vrna_gquad_mx_t *ggg,
+                                           int             *p,
+                                           int             *q,
+                                           vrna_param_t    *P);
+
+
+INLINE PRIVATE int backtrack_GQuad_IntLoop_comparative(int             c,
+                                                       int             i,
+                                                       int             j,
+                                                       unsigned int    *type,
+                                                       short           *S_cons,
+                                                       short           **S5,
+                                                       short           **S3,
+                                                       vrna_gquad_mx_t *ggg,
+                                                       int             *p,
+                                                       int             *q,
+                                                       int             n_seq,
+                                                       vrna_param_t    *P);
 
 
 INLINE PRIVATE int backtrack_GQuad_IntLoop_L(int          c,
@@ -291,13 +429,14 @@ vrna_BT_gquad_int(vrna_fold_compound_t  *vc,
                   vrna_bp_stack_t       *bp_stack,
                   int                   *stack_count)
 {
-  int           energy, dangles, *idx, ij, p, q, maxl, minl, c0, l1, *ggg;
-  unsigned char type;
-  char          *ptype;
-  short         si, sj, *S, *S1;
+  int             energy, dangles, *idx, ij, p, q, maxl, minl, c0, l1;
+  unsigned char   type;
+  char            *ptype;
+  short           si, sj, *S, *S1;
+  vrna_gquad_mx_t *ggg;
 
-  vrna_param_t  *P;
-  vrna_md_t     *md;
+  vrna_param_t    *P;
+  vrna_md_t       *md;
 
   idx     = vc->jindx;
   ij      = idx[j] + i;
@@ -332,7 +471,7 @@ vrna_BT_gquad_int(vrna_fold_compound_t  *vc,
         if (S[q] != 3)
           continue;
 
-        if (en == energy + ggg[idx[q] + p] + P->internal_loop[j - q - 1])
+        if (en == energy + gquad_mx_get(ggg, p, q) + P->internal_loop[j - q - 1])
           return vrna_BT_gquad_mfe(vc, p, q, bp_stack, stack_count);
       }
     }
@@ -358,7 +497,7 @@ vrna_BT_gquad_int(vrna_fold_compound_t  *vc,
       if (S1[q] != 3)
         continue;
 
-      if (en == energy + ggg[idx[q] + p] + P->internal_loop[l1 + j - q - 1])
+      if (en == energy + gquad_mx_get(ggg, p, q) + P->internal_loop[l1 + j - q - 1])
         return vrna_BT_gquad_mfe(vc, p, q, bp_stack, stack_count);
     }
   }
@@ -375,7 +514,7 @@ vrna_BT_gquad_int(vrna_fold_compound_t  *vc,
       if (S1[p] != 3)
         continue;
 
-      if (en == energy + ggg[idx[q] + p] + P->internal_loop[l1])
+      if (en == energy + gquad_mx_get(ggg, p, q) + P->internal_loop[l1])
         return vrna_BT_gquad_mfe(vc, p, q, bp_stack, stack_count);
     }
 
@@ -392,8 +531,7 @@ vrna_BT_gquad_int(vrna_fold_compound_t  *vc,
  *  @param j      position j of enclosing pair
  *  @param type   base pair type of enclosing pair (must be reverse type)
  *  @param S      integer encoded sequence
- *  @param ggg    triangular matrix containing g-quadruplex contributions
- *  @param index  the index for accessing the triangular matrix
+ *  @param ggg    sparse matrix containing g-quadruplex contributions
  *  @param p      here the 5' position of the gquad is stored
  *  @param q      here the 3' position of the gquad is stored
  *  @param P      the datastructure containing the precalculated contibutions
@@ -401,16 +539,15 @@ vrna_BT_gquad_int(vrna_fold_compound_t  *vc,
  *  @return       1 on success, 0 if no gquad found
  */
 INLINE PRIVATE int
-backtrack_GQuad_IntLoop(int           c,
-                        int           i,
-                        int           j,
-                        int           type,
-                        short         *S,
-                        int           *ggg,
-                        int           *index,
-                        int           *p,
-                        int           *q,
-                        vrna_param_t  *P)
+backtrack_GQuad_IntLoop(int              c,
+                        int              i,
+                        int              j,
+                        int              type,
+                        short            *S,
+                        vrna_gquad_mx_t  *ggg,
+                        int              *p,
+                        int              *q,
+                        vrna_param_t     *P)
 {
   int   energy, dangles, k, l, maxl, minl, c0, l1;
   short si, sj;
@@ -439,7 +576,7 @@ backtrack_GQuad_IntLoop(int           c,
         if (S[l] != 3)
           continue;
 
-        if (c == energy + ggg[index[l] + k] + P->internal_loop[j - l - 1]) {
+        if (c == energy + gquad_mx_get(ggg, k, l) + P->internal_loop[j - l - 1]) {
           *p  = k;
           *q  = l;
           return 1;
@@ -468,7 +605,7 @@ backtrack_GQuad_IntLoop(int           c,
       if (S[l] != 3)
         continue;
 
-      if (c == energy + ggg[index[l] + k] + P->internal_loop[l1 + j - l - 1]) {
+      if (c == energy + gquad_mx_get(ggg, k, l) + P->internal_loop[l1 + j - l - 1]) {
         *p  = k;
         *q  = l;
         return 1;
@@ -488,7 +625,7 @@ backtrack_GQuad_IntLoop(int           c,
       if (S[k] != 3)
         continue;
 
-      if (c == energy + ggg[index[l] + k] + P->internal_loop[l1]) {
+      if (c == energy + gquad_mx_get(ggg, k, l) + P->internal_loop[l1]) {
         *p  = k;
         *q  = l;
         return 1;
@@ -500,19 +637,18 @@ backtrack_GQuad_IntLoop(int           c,
 
 
 INLINE PRIVATE int
-backtrack_GQuad_IntLoop_comparative(int           c,
-                                    int           i,
-                                    int           j,
-                                    unsigned int  *type,
-                                    short         *S_cons,
-                                    short         **S5,
-                                    short         **S3,
-                                    int           *ggg,
-                                    int           *index,
-                                    int           *p,
-                                    int           *q,
-                                    int           n_seq,
-                                    vrna_param_t  *P)
+backtrack_GQuad_IntLoop_comparative(int              c,
+                                    int              i,
+                                    int              j,
+                                    unsigned int     *type,
+                                    short            *S_cons,
+                                    short            **S5,
+                                    short            **S3,
+                                    vrna_gquad_mx_t  *ggg,
+                                    int              *p,
+                                    int              *q,
+                                    int              n_seq,
+                                    vrna_param_t     *P)
 {
   int energy, dangles, k, l, maxl, minl, c0, l1, ss, tt;
 
@@ -544,7 +680,7 @@ backtrack_GQuad_IntLoop_comparative(int           c,
         if (S_cons[l] != 3)
           continue;
 
-        if (c == energy + ggg[index[l] + k] + n_seq * P->internal_loop[j - l - 1]) {
+        if (c == energy + gquad_mx_get(ggg, k, l) + n_seq * P->internal_loop[j - l - 1]) {
           *p  = k;
           *q  = l;
           return 1;
@@ -573,7 +709,7 @@ backtrack_GQuad_IntLoop_comparative(int           c,
       if (S_cons[l] != 3)
         continue;
 
-      if (c == energy + ggg[index[l] + k] + n_seq * P->internal_loop[l1 + j - l - 1]) {
+      if (c == energy + gquad_mx_get(ggg, k, l) + n_seq * P->internal_loop[l1 + j - l - 1]) {
         *p  = k;
         *q  = l;
         return 1;
@@ -593,7 +729,7 @@ backtrack_GQuad_IntLoop_comparative(int           c,
       if (S_cons[k] != 3)
         continue;
 
-      if (c == energy + ggg[index[l] + k] + n_seq * P->internal_loop[l1]) {
+      if (c == energy + gquad_mx_get(ggg, k, l) + n_seq * P->internal_loop[l1]) {
         *p  = k;
         *q  = l;
         return 1;
@@ -828,13 +964,12 @@ backtrack_GQuad_IntLoop_L_comparative(int           c,
 
 PRIVATE INLINE
 int
-E_GQuad_IntLoop(int           i,
-                int           j,
-                int           type,
-                short         *S,
-                int           *ggg,
-                int           *index,
-                vrna_param_t  *P)
+E_GQuad_IntLoop(int              i,
+                int              j,
+                int              type,
+                short            *S,
+                vrna_gquad_mx_t  *ggg,
+                vrna_param_t     *P)
 {
   int   energy, ge, dangles, p, q, l1, minq, maxq, c0;
   short si, sj;
@@ -865,7 +1000,7 @@ E_GQuad_IntLoop(int           i,
         if (S[q] != 3)
           continue;
 
-        c0  = energy + ggg[index[q] + p] + P->internal_loop[j - q - 1];
+        c0  = energy + gquad_mx_get(ggg, p, q) + P->internal_loop[j - q - 1];
         ge  = MIN2(ge, c0);
       }
     }
@@ -891,7 +1026,7 @@ E_GQuad_IntLoop(int           i,
       if (S[q] != 3)
         continue;
 
-      c0  = energy + ggg[index[q] + p] + P->internal_loop[l1 + j - q - 1];
+      c0  = energy + gquad_mx_get(ggg, p, q) + P->internal_loop[l1 + j - q - 1];
       ge  = MIN2(ge, c0);
     }
   }
@@ -908,7 +1043,7 @@ E_GQuad_IntLoop(int           i,
       if (S[p] != 3)
         continue;
 
-      c0  = energy + ggg[index[q] + p] + P->internal_loop[l1];
+      c0  = energy + gquad_mx_get(ggg, p, q) + P->internal_loop[l1];
       ge  = MIN2(ge, c0);
     }
 
@@ -933,7 +1068,7 @@ E_GQuad_IntLoop(int           i,
           if (S[q] != 3)
             continue;
 
-          c0  = en1 + ggg[index[q] + p] + P->internal_loop[j - q - 1];
+          c0  = en1 + gquad_mx_get(ggg, p, q) + P->internal_loop[j - q - 1];
           ge  = MIN2(ge, c0);
         }
       }
@@ -957,7 +1092,7 @@ E_GQuad_IntLoop(int           i,
         if (S[q] != 3)
           continue;
 
-        c0  = en1 + ggg[index[q] + p] + P->internal_loop[l1 + j - q - 1];
+        c0  = en1 + gquad_mx_get(ggg, p, q) + P->internal_loop[l1 + j - q - 1];
         ge  = MIN2(ge, c0);
       }
     }
@@ -972,7 +1107,7 @@ E_GQuad_IntLoop(int           i,
         if (S[p] != 3)
           continue;
 
-        c0  = en1 + ggg[index[q] + p] + P->internal_loop[l1 + 1];
+        c0  = en1 + gquad_mx_get(ggg, p, q) + P->internal_loop[l1 + 1];
         ge  = MIN2(ge, c0);
       }
 
@@ -986,16 +1121,15 @@ E_GQuad_IntLoop(int           i,
 
 PRIVATE INLINE
 int *
-E_GQuad_IntLoop_exhaustive(int          i,
-                           int          j,
-                           int          **p_p,
-                           int          **q_p,
-                           int          type,
-                           short        *S,
-                           int          *ggg,
-                           int          threshold,
-                           int          *index,
-                           vrna_param_t *P)
+E_GQuad_IntLoop_exhaustive(int             i,
+                           int             j,
+                           int             **p_p,
+                           int             **q_p,
+                           int             type,
+                           short           *S,
+                           vrna_gquad_mx_t *ggg,
+                           int             threshold,
+                           vrna_param_t    *P)
 {
   int   energy, *ge, dangles, p, q, l1, minq, maxq, c0;
   short si, sj;
@@ -1030,7 +1164,7 @@ E_GQuad_IntLoop_exhaustive(int          i,
         if (S[q] != 3)
           continue;
 
-        c0 = energy + ggg[index[q] + p] + P->internal_loop[j - q - 1];
+        c0 = energy + gquad_mx_get(ggg, p, q) + P->internal_loop[j - q - 1];
         if (c0 <= threshold) {
           ge[cnt]       = energy + P->internal_loop[j - q - 1];
           (*p_p)[cnt]   = p;
@@ -1060,7 +1194,7 @@ E_GQuad_IntLoop_exhaustive(int          i,
       if (S[q] != 3)
         continue;
 
-      c0 = energy + ggg[index[q] + p] + P->internal_loop[l1 + j - q - 1];
+      c0 = energy + gquad_mx_get(ggg, p, q) + P->internal_loop[l1 + j - q - 1];
       if (c0 <= threshold) {
         ge[cnt]       = energy + P->internal_loop[l1 + j - q - 1];
         (*p_p)[cnt]   = p;
@@ -1081,7 +1215,7 @@ E_GQuad_IntLoop_exhaustive(int          i,
       if (S[p] != 3)
         continue;
 
-      c0 = energy + ggg[index[q] + p] + P->internal_loop[l1];
+      c0 = energy + gquad_mx_get(ggg, p, q) + P->internal_loop[l1];
       if (c0 <= threshold) {
         ge[cnt]       = energy + P->internal_loop[l1];
         (*p_p)[cnt]   = p;
@@ -1191,9 +1325,8 @@ exp_E_GQuad_IntLoop(int               i,
                     int               j,
                     int               type,
                     short             *S,
-                    FLT_OR_DBL        *G,
+                    vrna_gquad_mx_t   *G,
                     FLT_OR_DBL        *scale,
-                    int               *index,
                     vrna_exp_param_t  *pf)
 {
   int         k, l, minl, maxl, u, r;
@@ -1223,11 +1356,11 @@ exp_E_GQuad_IntLoop(int               i,
         if (S[l] != 3)
           continue;
 
-        if (G[index[k] - l] == 0.)
+        if (gquad_mx_get_pf(G, k, l) == 0.)
           continue;
 
         q += qe
-             * G[index[k] - l]
+             * gquad_mx_get_pf(G, k, l)
              * (FLT_OR_DBL)expintern[j - l - 1]
              * scale[j - l + 1];
       }
@@ -1254,11 +1387,11 @@ exp_E_GQuad_IntLoop(int               i,
       if (S[l] != 3)
         continue;
 
-      if (G[index[k] - l] == 0.)
+      if (gquad_mx_get_pf(G, k, l) == 0.)
         continue;
 
       q += qe
-           * G[index[k] - l]
+           * gquad_mx_get_pf(G, k, l)
            * (FLT_OR_DBL)expintern[u + j - l - 1]
            * scale[u + j - l + 1];
     }
@@ -1274,11 +1407,11 @@ exp_E_GQuad_IntLoop(int               i,
       if (S[k] != 3)
         continue;
 
-      if (G[index[k] - l] == 0.)
+      if (gquad_mx_get_pf(G, k, l) == 0.)
         continue;
 
       q += qe
-           * G[index[k] - l]
+           * gquad_mx_get_pf(G, k, l)
            * (FLT_OR_DBL)expintern[u]
            * scale[u + 2];
     }
@@ -0,0 +1,644 @@
+/*
+ *  ViennaRNA/io/accessibility.c
+ *
+ *  Binary stores of accessibility profiles
+ *
+ *  ViennaRNA package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/io/accessibility.h"
+
+#define PRIVATE  static
+#define PUBLIC
+
+/*
+ #################################
+ # PRIVATE MACROS                #
+ #################################
+ */
+#define ACC_MAGIC             "VRNAACC"
+#define ACC_BYTE_ORDER        0x01020304U
+#define ACC_HEADER_SIZE       40
+#define ACC_INDEX_ENTRY_SIZE  32
+#define ACC_DATA_ALIGNMENT    16
+
+/*
+ #################################
+ # PRIVATE DATA STRUCTURES       #
+ #################################
+ */
+struct vrna_acc_store_s {
+  unsigned char           *data;
+  size_t                  size;
+  int                     mapped;
+  unsigned int            num_records;
+  vrna_acc_record_t       *records;
+  const vrna_acc_record_t **sorted;   /* records sorted by identifier */
+};
+
+typedef struct {
+  uint64_t  offset;
+  uint32_t  length;
+  uint32_t  max_u;
+  double    kT;
+  char      *id;
+} acc_index_entry;
+
+struct vrna_acc_store_writer_s {
+  FILE            *fp;
+  uint64_t        offset;
+  unsigned int    num_records;
+  acc_index_entry *index;
+};
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+PRIVATE int
+load_file(vrna_acc_store_t  *store,
+          const char        *filename);
+
+
+PRIVATE void
+unload_file(vrna_acc_store_t *store);
+
+
+PRIVATE int
+parse_index(vrna_acc_store_t  *store,
+            const char        *filename);
+
+
+PRIVATE int
+compare_ids(const void  *a,
+            const void  *b);
+
+
+PRIVATE void
+sort_records(vrna_acc_store_t *store);
+
+
+PRIVATE int
+write_padding(vrna_acc_store_writer_t *writer,
+              unsigned int            alignment);
+
+
+PRIVATE int
+write_header(FILE     *fp,
+             uint64_t num_records,
+             uint64_t index_offset);
+
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+PUBLIC vrna_acc_store_t *
+vrna_acc_store_open(const char *filename)
+{
+  vrna_acc_store_t *store;
+
+  if (!filename)
+    return NULL;
+
+  store = (vrna_acc_store_t *)vrna_alloc(sizeof(vrna_acc_store_t));
+
+  if (!load_file(store, filename)) {
+    free(store);
+    return NULL;
+  }
+
+  if (!parse_index(store, filename)) {
+    vrna_acc_store_close(store);
+    return NULL;
+  }
+
+  sort_records(store);
+
+  return store;
+}
+
+
+PUBLIC void
+vrna_acc_store_close(vrna_acc_store_t *store)
+{
+  if (store) {
+    unload_file(store);
+    free(store->records);
+    free(store->sorted);
+    free(store);
+  }
+}
+
+
+PUBLIC unsigned int
+vrna_acc_store_size(const vrna_acc_store_t *store)
+{
+  return (store) ? store->num_records : 0;
+}
+
+
+PUBLIC const vrna_acc_record_t *
+vrna_acc_store_record(const vrna_acc_store_t  *store,
+                      unsigned int            k)
+{
+  if ((store) && (k < store->num_records))
+    return store->records + k;
+
+  return NULL;
+}
+
+
+PUBLIC const vrna_acc_record_t *
+vrna_acc_store_find(const vrna_acc_store_t  *store,
+                    const char              *id)
+{
+  unsigned int lo, hi, mid;
+
+  if ((!store) || (!id))
+    return NULL;
+
+  /* lower bound, such that duplicate identifiers yield their first occurrence */
+  lo  = 0;
+  hi  = store->num_records;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (strcmp(store->sorted[mid]->id, id) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if ((lo < store->num_records) && (strcmp(store->sorted[lo]->id, id) == 0))
+    return store->sorted[lo];
+
+  return NULL;
+}
+
+
+PUBLIC float
+vrna_acc_record_energy(const vrna_acc_record_t  *record,
+                       unsigned int             i,
+                       unsigned int             u)
+{
+  if ((!record) || (i == 0) || (i > record->length) || (u == 0) || (u > record->max_u))
+    return (float)NAN;
+
+  return record->energies[(size_t)(u - 1) * record->length + i - 1];
+}
+
+
+PUBLIC double
+vrna_acc_record_probability(const vrna_acc_record_t *record,
+                            unsigned int            i,
+                            unsigned int            u)
+{
+  float e = vrna_acc_record_energy(record, i, u);
+
+  if (isnan(e))
+    return (double)NAN;
+
+  return exp(-(double)e / record->kT);
+}
+
+
+PUBLIC vrna_acc_store_writer_t *
+vrna_acc_store_create(const char *filename)
+{
+  vrna_acc_store_writer_t *writer;
+  FILE                    *fp;
+
+  if (!filename)
+    return NULL;
+
+  fp = fopen(filename, "wb");
+  if (!fp) {
+    vrna_message_warning("vrna_acc_store_create: Can't open file \"%s\" for writing", filename);
+    return NULL;
+  }
+
+  /*
+   *  the header is rewritten with the actual index offset once the store is
+   *  finished, until then readers detect the store as incomplete
+   */
+  if ((!write_header(fp, 0, 0)) || (fflush(fp) != 0)) {
+    fclose(fp);
+    return NULL;
+  }
+
+  writer              = (vrna_acc_store_writer_t *)vrna_alloc(sizeof(vrna_acc_store_writer_t));
+  writer->fp          = fp;
+  writer->offset      = ACC_HEADER_SIZE;
+  writer->num_records = 0;
+  writer->index       = NULL;
+
+  return writer;
+}
+
+
+PUBLIC int
+vrna_acc_store_add(vrna_acc_store_writer_t  *writer,
+                   const char               *id,
+                   unsigned int             length,
+                   unsigned int             max_u,
+                   double                   kT,
+                   double                   **pu)
+{
+  unsigned int  i, u;
+  float         *row;
+  double        p;
+  size_t        row_size;
+
+  if ((!writer) || (!id) || (!pu) || (length == 0) || (max_u == 0) || (kT <= 0.))
+    return 0;
+
+  if (!write_padding(writer, ACC_DATA_ALIGNMENT))
+    return 0;
+
+  writer->index = (acc_index_entry *)vrna_realloc(writer->index,
+                                                  sizeof(acc_index_entry) *
+                                                  (writer->num_records + 1));
+  writer->index[writer->num_records].offset = writer->offset;
+  writer->index[writer->num_records].length = length;
+  writer->index[writer->num_records].max_u  = max_u;
+  writer->index[writer->num_records].kT     = kT;
+  writer->index[writer->num_records].id     = strdup(id);
+
+  row       = (float *)vrna_alloc(sizeof(float) * length);
+  row_size  = sizeof(float) * length;
+
+  for (u = 1; u <= max_u; u++) {
+    for (i = 1; i <= length; i++) {
+      if ((u > i) || (!pu[i])) {
+        row[i - 1] = (float)NAN;
+        continue;
+      }
+
+      p = pu[i][u];
+      if (isnan(p))
+        row[i - 1] = (float)NAN;
+      else if (p <= 0.)
+        row[i - 1] = (float)INFINITY;
+      else
+        row[i - 1] = (float)(-log(p) * kT);
+    }
+
+    if (fwrite(row, sizeof(float), length, writer->fp) != length) {
+      free(row);
+      free(writer->index[writer->num_records].id);
+      vrna_message_warning("vrna_acc_store_add: Failed to write profile of \"%s\"", id);
+      return 0;
+    }
+
+    writer->offset += row_size;
+  }
+
+  free(row);
+  writer->num_records++;
+
+  return 1;
+}
+
+
+PUBLIC int
+vrna_acc_store_finish(vrna_acc_store_writer_t *writer)
+{
+  unsigned char entry[ACC_INDEX_ENTRY_SIZE];
+  unsigned int  k;
+  uint64_t      index_offset, id_offset;
+  int           ret;
+
+  if (!writer)
+    return 0;
+
+  ret = write_padding(writer, 8);
+
+  index_offset  = writer->offset;
+  id_offset     = index_offset + (uint64_t)ACC_INDEX_ENTRY_SIZE * writer->num_records;
+
+  for (k = 0; (ret) && (k < writer->num_records); k++) {
+    memset(entry, 0, sizeof(entry));
+    memcpy(entry, &(writer->index[k].offset), sizeof(uint64_t));
+    memcpy(entry + 8, &id_offset, sizeof(uint64_t));
+    memcpy(entry + 16, &(writer->index[k].length), sizeof(uint32_t));
+    memcpy(entry + 20, &(writer->index[k].max_u), sizeof(uint32_t));
+    memcpy(entry + 24, &(writer->index[k].kT), sizeof(double));
+
+    if (fwrite(entry, 1, sizeof(entry), writer->fp) != sizeof(entry))
+      ret = 0;
+
+    id_offset += strlen(writer->index[k].id) + 1;
+  }
+
+  for (k = 0; (ret) && (k < writer->num_records); k++)
+    if (fwrite(writer->index[k].id, 1, strlen(writer->index[k].id) + 1,
+               writer->fp) != strlen(writer->index[k].id) + 1)
+      ret = 0;
+
+  if ((ret) && (fseek(writer->fp, 0, SEEK_SET) == 0))
+    ret = write_header(writer->fp, writer->num_records, index_offset);
+  else
+    ret = 0;
+
+  if (fclose(writer->fp) != 0)
+    ret = 0;
+
+  if (!ret)
+    vrna_message_warning("vrna_acc_store_finish: Failed to write the accessibility store index");
+
+  for (k = 0; k < writer->num_records; k++)
+    free(writer->index[k].id);
+
+  free(writer->index);
+  free(writer);
+
+  return ret;
+}
+
+
+/*
+ #################################
+ # STATIC helper functions below #
+ #################################
+ */
+PRIVATE int
+load_file(vrna_acc_store_t  *store,
+          const char        *filename)
+{
+#ifndef _WIN32
+  int         fd;
+  struct stat sb;
+  void        *map;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    vrna_message_warning("vrna_acc_store_open: Can't open file \"%s\"", filename);
+    return 0;
+  }
+
+  if ((fstat(fd, &sb) != 0) || (sb.st_size < ACC_HEADER_SIZE)) {
+    vrna_message_warning("vrna_acc_store_open: \"%s\" is not an accessibility store", filename);
+    close(fd);
+    return 0;
+  }
+
+  if ((unsigned long long)sb.st_size > (unsigned long long)SIZE_MAX) {
+    vrna_message_warning("vrna_acc_store_open: \"%s\" is too large to be mapped into memory",
+                         filename);
+    close(fd);
+    return 0;
+  }
+
+  map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (map == MAP_FAILED) {
+    vrna_message_warning("vrna_acc_store_open: Can't map file \"%s\" into memory", filename);
+    return 0;
+  }
+
+  store->data   = (unsigned char *)map;
+  store->size   = (size_t)sb.st_size;
+  store->mapped = 1;
+
+  return 1;
+
+#else
+  FILE      *fp;
+  long long size;
+
+  fp = fopen(filename, "rb");
+  if (!fp) {
+    vrna_message_warning("vrna_acc_store_open: Can't open file \"%s\"", filename);
+    return 0;
+  }
+
+  /* use the 64-bit variants, since long is only 32 bits wide on Windows */
+  if ((_fseeki64(fp, 0, SEEK_END) != 0) ||
+      ((size = _ftelli64(fp)) < ACC_HEADER_SIZE) ||
+      (_fseeki64(fp, 0, SEEK_SET) != 0)) {
+    vrna_message_warning("vrna_acc_store_open: \"%s\" is not an accessibility store", filename);
+    fclose(fp);
+    return 0;
+  }
+
+  if ((unsigned long long)size > (unsigned long long)SIZE_MAX) {
+    vrna_message_warning("vrna_acc_store_open: \"%s\" is too large to be loaded into memory",
+                         filename);
+    fclose(fp);
+    return 0;
+  }
+
+  /*
+   *  no memory mapping available, so we read the entire file at once.
+   *  vrna_alloc() only takes an unsigned int, so we allocate the
+   *  (possibly > 4GB) buffer ourselves
+   */
+  store->size   = (size_t)size;
+  store->data   = (unsigned char *)malloc(store->size);
+  store->mapped = 0;
+
+  if (!store->data) {
+    vrna_message_warning("vrna_acc_store_open: Can't allocate memory for file \"%s\"", filename);
+    fclose(fp);
+    return 0;
+  }
+
+  if (fread(store->data, 1, store->size, fp) != store->size) {
+    vrna_message_warning("vrna_acc_store_open: Failed to read file \"%s\"", filename);
+    free(store->data);
+    fclose(fp);
+    return 0;
+  }
+
+  fclose(fp);
+
+  return 1;
+#endif
+}
+
+
+PRIVATE void
+unload_file(vrna_acc_store_t *store)
+{
+#ifndef _WIN32
+  if (store->mapped) {
+    munmap(store->data, store->size);
+    return;
+  }
+
+#endif
+  free(store->data);
+}
+
+
+PRIVATE int
+parse_index(vrna_acc_store_t  *store,
+            const char        *filename)
+{
+  const unsigned char *entry;
+  unsigned int        k;
+  uint32_t            version, byte_order, length, max_u;
+  uint64_t            num_records, index_offset, data_offset, id_offset;
+  double              kT;
+
+  if (memcmp(store->data, ACC_MAGIC, sizeof(ACC_MAGIC)) != 0) {
+    vrna_message_warning("vrna_acc_store_open: \"%s\" is not an accessibility store", filename);
+    return 0;
+  }
+
+  memcpy(&version, store->data + 8, sizeof(uint32_t));
+  memcpy(&byte_order, store->data + 12, sizeof(uint32_t));
+  memcpy(&num_records, store->data + 16, sizeof(uint64_t));
+  memcpy(&index_offset, store->data + 24, sizeof(uint64_t));
+
+  if (byte_order != ACC_BYTE_ORDER) {
+    vrna_message_warning("vrna_acc_store_open: \"%s\" has been created on a machine "
+                         "with different byte order",
+                         filename);
+    return 0;
+  }
+
+  if (version != VRNA_ACC_STORE_VERSION) {
+    vrna_message_warning("vrna_acc_store_open: Unsupported format version %u of \"%s\"",
+                         version,
+                         filename);
+    return 0;
+  }
+
+  if ((index_offset < ACC_HEADER_SIZE) ||
+      (index_offset > store->size) ||
+      (num_records > (store->size - index_offset) / ACC_INDEX_ENTRY_SIZE)) {
+    vrna_message_warning("vrna_acc_store_open: \"%s\" is incomplete or corrupt", filename);
+    return 0;
+  }
+
+  store->num_records  = (unsigned int)num_records;
+  store->records      = (vrna_acc_record_t *)vrna_alloc(sizeof(vrna_acc_record_t) *
+                                                        (store->num_records + 1));
+
+  for (k = 0; k < store->num_records; k++) {
+    entry = store->data + index_offset + (uint64_t)k * ACC_INDEX_ENTRY_SIZE;
+    memcpy(&data_offset, entry, sizeof(uint64_t));
+    memcpy(&id_offset, entry + 8, sizeof(uint64_t));
+    memcpy(&length, entry + 16, sizeof(uint32_t));
+    memcpy(&max_u, entry + 20, sizeof(uint32_t));
+    memcpy(&kT, entry + 24, sizeof(double));
+
+    /* make sure all data is within the file before anyone accesses it */
+    if ((data_offset % ACC_DATA_ALIGNMENT) ||
+        (data_offset < ACC_HEADER_SIZE) ||
+        (data_offset > index_offset) ||
+        ((uint64_t)length * max_u > (index_offset - data_offset) / sizeof(float)) ||
+        (id_offset >= store->size) ||
+        (!memchr(store->data + id_offset, '\0', store->size - id_offset))) {
+      vrna_message_warning("vrna_acc_store_open: \"%s\" is incomplete or corrupt", filename);
+      return 0;
+    }
+
+    store->records[k].id        = (const char *)(store->data + id_offset);
+    store->records[k].length    = length;
+    store->records[k].max_u     = max_u;
+    store->records[k].kT        = kT;
+    store->records[k].energies  = (const float *)(store->data + data_offset);
+  }
+
+  return 1;
+}
+
+
+PRIVATE int
+compare_ids(const void  *a,
+            const void  *b)
+{
+  const vrna_acc_record_t *r1, *r2;
+  int                     c;
+
+  r1  = *((const vrna_acc_record_t **)a);
+  r2  = *((const vrna_acc_record_t **)b);
+  c   = strcmp(r1->id, r2->id);
+
+  /* keep records with identical identifiers in the order of the file */
+  if (c == 0)
+    c = (r1 < r2) ? -1 : ((r1 > r2) ? 1 : 0);
+
+  return c;
+}
+
+
+PRIVATE void
+sort_records(vrna_acc_store_t *store)
+{
+  unsigned int k;
+
+  store->sorted = (const vrna_acc_record_t **)vrna_alloc(sizeof(vrna_acc_record_t *) *
+                                                         (store->num_records + 1));
+
+  for (k = 0; k < store->num_records; k++)
+    store->sorted[k] = store->records + k;
+
+  qsort(store->sorted, store->num_records, sizeof(vrna_acc_record_t *), &compare_ids);
+}
+
+
+PRIVATE int
+write_padding(vrna_acc_store_writer_t *writer,
+              unsigned int            alignment)
+{
+  static const unsigned char  zeros[ACC_DATA_ALIGNMENT] = {
+    0
+  };
+  size_t                      pad;
+
+  pad = (size_t)((alignment - writer->offset % alignment) % alignment);
+
+  if ((pad > 0) && (fwrite(zeros, 1, pad, writer->fp) != pad))
+    return 0;
+
+  writer->offset += pad;
+
+  return 1;
+}
+
+
+PRIVATE int
+write_header(FILE     *fp,
+             uint64_t num_records,
+             uint64_t index_offset)
+{
+  unsigned char header[ACC_HEADER_SIZE];
+  uint32_t      version, byte_order;
+
+  version     = VRNA_ACC_STORE_VERSION;
+  byte_order  = ACC_BYTE_ORDER;
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, ACC_MAGIC, sizeof(ACC_MAGIC));
+  memcpy(header + 8, &version, sizeof(uint32_t));
+  memcpy(header + 12, &byte_order, sizeof(uint32_t));
+  memcpy(header + 16, &num_records, sizeof(uint64_t));
+  memcpy(header + 24, &index_offset, sizeof(uint64_t));
+
+  return (fwrite(header, 1, sizeof(header), fp) == sizeof(header)) ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+#ifndef VIENNA_RNA_PACKAGE_FILE_ACCESSIBILITY_H
+#define VIENNA_RNA_PACKAGE_FILE_ACCESSIBILITY_H
+
+/**
+ *  @file     ViennaRNA/io/accessibility.h
+ *  @ingroup  utils, file_utils, file_formats_acc
+ *  @brief    Read and write binary stores of accessibility profiles
+ */
+
+/**
+ *  @addtogroup   file_formats_acc
+ *  @{
+ *  @brief  Functions to read/write accessibility profiles of many sequences in a single binary file
+ *
+ *  An accessibility store keeps the opening energies of unpaired stretches of
+ *  length @f$ u = 1, \ldots, u_{max} @f$ for each position of any number of
+ *  sequences, e.g. as computed by RNAplfold. The opening energy of the stretch
+ *  of @f$ u @f$ nucleotides that ends at position @f$ i @f$ is
+ *  @f$ E_u(i) = -kT \ln p_u(i) @f$, where @f$ p_u(i) @f$ is the probability
+ *  that the entire stretch is unpaired.
+ *
+ *  A store consists of a fixed size file header, followed by one data block per
+ *  sequence and an index of all sequences at the end of the file:
+ *
+ *  | Offset    | Type          | Content                                                 |
+ *  |:----------|:--------------|:--------------------------------------------------------|
+ *  | 0         | char[8]       | Magic bytes @p "VRNAACC" including the terminating 0    |
+ *  | 8         | uint32        | Format version (#VRNA_ACC_STORE_VERSION)                |
+ *  | 12        | uint32        | Byte order mark @p 0x01020304                           |
+ *  | 16        | uint64        | Number of sequences                                     |
+ *  | 24        | uint64        | File offset of the index                                |
+ *  | 32        | uint64        | Reserved                                                |
+ *
+ *  Each data block is a row-major matrix of 32bit floating point values with
+ *  @f$ u_{max} @f$ rows and one column per sequence position, i.e. the values
+ *  for a particular @f$ u @f$ are stored contiguously. Values that do not exist
+ *  (@f$ u > i @f$) are stored as @p NaN, stretches that can never be unpaired
+ *  as positive infinity. Data blocks are aligned to 16 bytes. The index consists
+ *  of one entry per sequence, followed by the zero-terminated sequence identifiers:
+ *
+ *  | Offset    | Type          | Content                                                 |
+ *  |:----------|:--------------|:--------------------------------------------------------|
+ *  | 0         | uint64        | File offset of the data block                           |
+ *  | 8         | uint64        | File offset of the sequence identifier                  |
+ *  | 16        | uint32        | Sequence length                                         |
+ *  | 20        | uint32        | Maximum length of unpaired stretches @f$ u_{max} @f$    |
+ *  | 24        | double        | Thermal energy @f$ kT @f$ in kcal/mol                   |
+ *
+ *  All values are stored in the byte order of the machine that created the store.
+ *  Since the index is written last, incomplete stores are detected upon opening.
+ *  Readers map the file into memory and hand out pointers into the mapped data
+ *  blocks, such that profiles are neither parsed nor copied.
+ */
+
+/**
+ *  @brief  The format version of accessibility stores written by this library
+ */
+#define VRNA_ACC_STORE_VERSION  1
+
+/**
+ *  @brief  A (read-only) accessibility store
+ */
+typedef struct vrna_acc_store_s vrna_acc_store_t;
+
+/**
+ *  @brief  An accessibility store that is being written
+ */
+typedef struct vrna_acc_store_writer_s vrna_acc_store_writer_t;
+
+/**
+ *  @brief  The accessibility profile of a single sequence in an accessibility store
+ */
+typedef struct {
+  const char    *id;        /**<  @brief  The sequence identifier */
+  unsigned int  length;     /**<  @brief  The sequence length */
+  unsigned int  max_u;      /**<  @brief  The maximum length of unpaired stretches */
+  double        kT;         /**<  @brief  The thermal energy in kcal/mol used to compute the opening energies */
+  const float   *energies;  /**<  @brief  The opening energies in kcal/mol, row @p u - 1 starts at energies[(u - 1) * length] */
+} vrna_acc_record_t;
+
+
+/**
+ *  @brief  Open an accessibility store for reading
+ *
+ *  The file is mapped into memory, and all records point directly into the
+ *  mapped data. Files with a different byte order, an unknown format version,
+ *  or a missing index are rejected.
+ *
+ *  @see  vrna_acc_store_close(), vrna_acc_store_find(), vrna_acc_store_record()
+ *
+ *  @param  filename  The name of the accessibility store
+ *  @return           The opened store, or @p NULL on any error
+ */
+vrna_acc_store_t *
+vrna_acc_store_open(const char *filename);
+
+
+/**
+ *  @brief  Close an accessibility store and release all of its memory
+ *
+ *  Records obtained from the store must not be used anymore afterwards.
+ *
+ *  @param  store   The accessibility store
+ */
+void
+vrna_acc_store_close(vrna_acc_store_t *store);
+
+
+/**
+ *  @brief  Get the number of records in an accessibility store
+ *
+ *  @param  store   The accessibility store
+ *  @return         The number of records
+ */
+unsigned int
+vrna_acc_store_size(const vrna_acc_store_t *store);
+
+
+/**
+ *  @brief  Get a record of an accessibility store by its position in the file
+ *
+ *  @param  store   The accessibility store
+ *  @param  k       The (0-based) number of the record
+ *  @return         The record, or @p NULL if @p k exceeds the number of records
+ */
+const vrna_acc_record_t *
+vrna_acc_store_record(const vrna_acc_store_t  *store,
+                      unsigned int            k);
+
+
+/**
+ *  @brief  Find the record of a sequence in an accessibility store
+ *
+ *  Records are looked up by binary search on the sequence identifiers. If
+ *  an identifier appears more than once, the first record in the file is
+ *  returned.
+ *
+ *  @param  store   The accessibility store
+ *  @param  id      The sequence identifier
+ *  @return         The record, or @p NULL if the store does not contain @p id
+ */
+const vrna_acc_record_t *
+vrna_acc_store_find(const vrna_acc_store_t  *store,
+                    const char              *id);
+
+
+/**
+ *  @brief  Get the opening energy of an unpaired stretch from an accessibility profile
+ *
+ *  @param  record  The accessibility profile
+ *  @param  i       The (1-based) last position of the unpaired stretch
+ *  @param  u       The length of the unpaired stretch
+ *  @return         The opening energy in kcal/mol, or @p NaN if the stretch does not exist
+ */
+float
+vrna_acc_record_energy(const vrna_acc_record_t  *record,
+                       unsigned int             i,
+                       unsigned int             u);
+
+
+/**
+ *  @brief  Get the probability of an unpaired stretch from an accessibility profile
+ *
+ *  @param  record  The accessibility profile
+ *  @param  i       The (1-based) last position of the unpaired stretch
+ *  @param  u       The length of the unpaired stretch
+ *  @return         The probability that all @p u nucleotides up to position @p i are unpaired, or @p NaN if the stretch does not exist
+ */
+double
+vrna_acc_record_probability(const vrna_acc_record_t *record,
+                            unsigned int            i,
+                            unsigned int            u);
+
+
+/**
+ *  @brief  Create a new accessibility store
+ *
+ *  An existing file of the same name is overwritten. Records are added with
+ *  vrna_acc_store_add() and the store becomes readable once it has been
+ *  finished with vrna_acc_store_finish().
+ *
+ *  @param  filename  The name of the accessibility store
+ *  @return           The store writer, or @p NULL if the file can not be created
+ */
+vrna_acc_store_writer_t *
+vrna_acc_store_create(const char *filename);
+
+
+/**
+ *  @brief  Add the accessibility profile of a sequence to an accessibility store
+ *
+ *  The unpaired probabilities are given in the layout of vrna_probs_window()
+ *  and RNAplfold, i.e. @p pu[i][u] is the probability that the stretch of @p u
+ *  nucleotides ending at position @p i is unpaired. Entries with @f$ u > i @f$
+ *  are ignored, and so are missing rows (@p pu[i] = @p NULL).
+ *
+ *  @param  writer  The store writer
+ *  @param  id      The sequence identifier
+ *  @param  length  The sequence length
+ *  @param  max_u   The maximum length of unpaired stretches
+ *  @param  kT      The thermal energy in kcal/mol
+ *  @param  pu      The unpaired probabilities [1..length][1..max_u]
+ *  @return         1 on success, 0 on any error
+ */
+int
+vrna_acc_store_add(vrna_acc_store_writer_t  *writer,
+                   const char               *id,
+                   unsigned int             length,
+                   unsigned int             max_u,
+                   double                   kT,
+                   double                   **pu);
+
+
+/**
+ *  @brief  Finish an accessibility store
+ *
+ *  Writes the index and the file header and releases the writer.
+ *
+ *  @param  writer  The store writer
+ *  @return         1 on success, 0 on any error
+ */
+int
+vrna_acc_store_finish(vrna_acc_store_writer_t *writer);
+
+
+/**
+ *  @}
+ */
+
+#endif
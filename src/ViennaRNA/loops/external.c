@@ -12,6 +12,7 @@
 #include "ViennaRNA/fold_vars.h"
 #include "ViennaRNA/params/default.h"
 #include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/utils/higher_order_functions.h"
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/constraints/hard.h"
 #include "ViennaRNA/constraints/soft.h"
@@ -2063,21 +2064,25 @@ add_f5_gquad(vrna_fold_compound_t       *fc,
              struct default_data        *hc_dat_local,
              struct sc_wrapper_f5       *sc_wrapper)
 {
-  int e, i, ij, *indx, turn, *f5, *ggg;
+  int             e, en, i, i_min, turn, *f5;
+  vrna_gquad_mx_t *ggg;
 
-  indx  = fc->jindx;
   f5    = fc->matrices->f5;
   ggg   = fc->matrices->ggg;
   turn  = fc->params->model_details.min_loop_size;
-  ij    = indx[j] + j - turn - 1;
   e     = INF;
 
-  for (i = j - turn - 1; i > 1; i--, ij--)
-    if ((f5[i - 1] != INF) && (ggg[ij] != INF))
-      e = MIN2(e, f5[i - 1] + ggg[ij]);
+  /* no G-quadruplex spans more than ggg->width nucleotides */
+  i_min = j - (int)ggg->width + 1;
+  i_min = MAX2(2, i_min);
 
-  ij  = indx[j] + 1;
-  e   = MIN2(e, ggg[ij]);
+  for (i = j - turn - 1; i >= i_min; i--) {
+    en = gquad_mx_get(ggg, i, j);
+    if ((f5[i - 1] != INF) && (en != INF))
+      e = MIN2(e, f5[i - 1] + en);
+  }
+
+  e = MIN2(e, gquad_mx_get(ggg, 1, j));
 
   return e;
 }
@@ -2110,74 +2115,18 @@ add_f3_gquad(vrna_fold_compound_t       *fc,
 }
 
 
-#ifdef VRNA_WITH_SSE_IMPLEMENTATION
-/* SSE modular decomposition -------------------------------*/
-#include <emmintrin.h>
-#include <smmintrin.h>
-
-PRIVATE INLINE int
-horizontal_min_Vec4i(__m128i x)
-{
-  __m128i min1  = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 0, 3, 2));
-  __m128i min2  = _mm_min_epi32(x, min1);
-  __m128i min3  = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0, 0, 0, 1));
-  __m128i min4  = _mm_min_epi32(min2, min3);
-
-  return _mm_cvtsi128_si32(min4);
-}
-
-
-#endif
-
-
 PRIVATE INLINE int
 decompose_f5_ext_stem(vrna_fold_compound_t  *fc,
                       int                   j,
                       int                   *stems)
 {
-  int e, i, *f5, turn;
+  int *f5, turn;
 
   f5    = fc->matrices->f5;
   turn  = fc->params->model_details.min_loop_size;
-  e     = INF;
-
-  /* modular decomposition */
-#if VRNA_WITH_SSE_IMPLEMENTATION
-  __m128i   inf = _mm_set1_epi32(INF);
-
-  const int end = j - turn;
-
-  for (i = 2; i < end - 3; i += 4) {
-    __m128i   a     = _mm_loadu_si128((__m128i *)&f5[i - 1]);
-    __m128i   b     = _mm_loadu_si128((__m128i *)&stems[i]);
-    __m128i   c     = _mm_add_epi32(a, b);
-    __m128i   mask1 = _mm_cmplt_epi32(a, inf);
-    __m128i   mask2 = _mm_cmplt_epi32(b, inf);
-    __m128i   res   = _mm_or_si128(_mm_and_si128(mask1, c),
-                                   _mm_andnot_si128(mask1, a));
-
-    res = _mm_or_si128(_mm_and_si128(mask2, res),
-                       _mm_andnot_si128(mask2, b));
-    const int en = horizontal_min_Vec4i(res);
-    e = MIN2(e, en);
-  }
-
-  for (; i < end; i++) {
-    if ((f5[i - 1] != INF) && (stems[i] != INF)) {
-      const int en = f5[i - 1] + stems[i];
-      e = MIN2(e, en);
-    }
-  }
-#else
-  for (i = 2; i < j - turn; i++)
-    if ((f5[i - 1] != INF) && (stems[i] != INF)) {
-      const int en = f5[i - 1] + stems[i];
-      e = MIN2(e, en);
-    }
-
-#endif
 
-  return e;
+  /* modular decomposition, i.e. min_{1 < i < j - turn} f5[i - 1] + stems[i] */
+  return vrna_fun_zip_add_min(f5 + 1, stems + 2, j - turn - 2);
 }
 
 
@@ -2187,47 +2136,13 @@ decompose_f3_ext_stem(vrna_fold_compound_t  *fc,
                       int                   max_j,
                       int                   *stems)
 {
-  int e, j, *f3, turn;
+  int *f3, turn;
 
   f3    = fc->matrices->f3_local;
   turn  = fc->params->model_details.min_loop_size;
-  e     = INF;
-
-  /* modular decomposition */
-#if VRNA_WITH_SSE_IMPLEMENTATION
-  __m128i inf = _mm_set1_epi32(INF);
-
-  for (j = i + turn + 1; j < max_j - 3; j += 4) {
-    __m128i   a     = _mm_loadu_si128((__m128i *)&f3[j + 1]);
-    __m128i   b     = _mm_loadu_si128((__m128i *)&stems[j]);
-    __m128i   c     = _mm_add_epi32(a, b);
-    __m128i   mask1 = _mm_cmplt_epi32(a, inf);
-    __m128i   mask2 = _mm_cmplt_epi32(b, inf);
-    __m128i   res   = _mm_or_si128(_mm_and_si128(mask1, c),
-                                   _mm_andnot_si128(mask1, a));
-
-    res = _mm_or_si128(_mm_and_si128(mask2, res),
-                       _mm_andnot_si128(mask2, b));
-    const int en = horizontal_min_Vec4i(res);
-    e = MIN2(e, en);
-  }
 
-  for (; j <= max_j; j++) {
-    if ((f3[j + 1] != INF) && (stems[j] != INF)) {
-      const int en = f3[j + 1] + stems[j];
-      e = MIN2(e, en);
-    }
-  }
-#else
-  for (j = i + turn + 1; j <= max_j; j++)
-    if ((f3[j + 1] != INF) && (stems[j] != INF)) {
-      const int en = stems[j] + f3[j + 1];
-      e = MIN2(e, en);
-    }
-
-#endif
-
-  return e;
+  /* modular decomposition, i.e. min_{i + turn < j <= max_j} stems[j] + f3[j + 1] */
+  return vrna_fun_zip_add_min(f3 + i + turn + 2, stems + i + turn + 1, max_j - i - turn);
 }
 
 
@@ -171,8 +171,9 @@ BT_ext_loop_f5(vrna_fold_compound_t *fc,
   char                      *ptype;
   short                     mm5, mm3, *S1;
   unsigned int              *sn, type;
-  int                       length, fij, fi, jj, u, en, e, *my_f5, *my_c, *my_ggg, *idx,
+  int                       length, fij, fi, jj, u, en, e, *my_f5, *my_c, *idx,
                             dangle_model, turn, with_gquad, cnt, ii, with_ud;
+  vrna_gquad_mx_t           *my_ggg;
   vrna_param_t              *P;
   vrna_md_t                 *md;
   vrna_sc_t                 *sc;
@@ -303,7 +304,7 @@ BT_ext_loop_f5(vrna_fold_compound_t *fc,
     case 0:   /* j is paired. Find pairing partner */
       for (u = jj - turn - 1; u >= 1; u--) {
         if (with_gquad) {
-          if (fij == my_f5[u - 1] + my_ggg[idx[jj] + u]) {
+          if (fij == my_f5[u - 1] + gquad_mx_get(my_ggg, u, jj)) {
             *i  = *j = -1;
             *k  = u - 1;
             return vrna_BT_gquad_mfe(fc, u, jj, bp_stack, stack_count);
@@ -337,7 +338,7 @@ BT_ext_loop_f5(vrna_fold_compound_t *fc,
       mm3 = ((jj < length) && (sn[jj + 1] == sn[jj])) ? S1[jj + 1] : -1;
       for (u = jj - turn - 1; u >= 1; u--) {
         if (with_gquad) {
-          if (fij == my_f5[u - 1] + my_ggg[idx[jj] + u]) {
+          if (fij == my_f5[u - 1] + gquad_mx_get(my_ggg, u, jj)) {
             *i  = *j = -1;
             *k  = u - 1;
             return vrna_BT_gquad_mfe(fc, u, jj, bp_stack, stack_count);
@@ -370,7 +371,7 @@ BT_ext_loop_f5(vrna_fold_compound_t *fc,
 
     default:
       if (with_gquad) {
-        if (fij == my_ggg[idx[jj] + 1]) {
+        if (fij == gquad_mx_get(my_ggg, 1, jj)) {
           *i  = *j = -1;
           *k  = 0;
           return vrna_BT_gquad_mfe(fc, 1, jj, bp_stack, stack_count);
@@ -428,7 +429,7 @@ BT_ext_loop_f5(vrna_fold_compound_t *fc,
 
       for (u = jj - turn - 1; u > 1; u--) {
         if (with_gquad) {
-          if (fij == my_f5[u - 1] + my_ggg[idx[jj] + u]) {
+          if (fij == my_f5[u - 1] + gquad_mx_get(my_ggg, u, jj)) {
             *i  = *j = -1;
             *k  = u - 1;
             return vrna_BT_gquad_mfe(fc, u, jj, bp_stack, stack_count);
@@ -557,8 +558,9 @@ BT_ext_loop_f5_comparative(vrna_fold_compound_t *fc,
   unsigned int              **a2s;
   short                     **S, **S5, **S3;
   unsigned int              tt;
-  int                       fij, fi, jj, u, en, *my_f5, *my_c, *my_ggg, *idx,
+  int                       fij, fi, jj, u, en, *my_f5, *my_c, *idx,
                             dangle_model, turn, with_gquad, n_seq, ss, mm5, mm3;
+  vrna_gquad_mx_t           *my_ggg;
   vrna_param_t              *P;
   vrna_md_t                 *md;
   vrna_sc_t                 **scs;
@@ -621,7 +623,7 @@ BT_ext_loop_f5_comparative(vrna_fold_compound_t *fc,
     case 0:   /* j is paired. Find pairing partner */
       for (u = jj - turn - 1; u >= 1; u--) {
         if (with_gquad) {
-          if (fij == my_f5[u - 1] + my_ggg[idx[jj] + u]) {
+          if (fij == my_f5[u - 1] + gquad_mx_get(my_ggg, u, jj)) {
             *i  = *j = -1;
             *k  = u - 1;
             return vrna_BT_gquad_mfe(fc, u, jj, bp_stack, stack_count);
@@ -658,7 +660,7 @@ BT_ext_loop_f5_comparative(vrna_fold_compound_t *fc,
     case 2:
       for (u = jj - turn - 1; u >= 1; u--) {
         if (with_gquad) {
-          if (fij == my_f5[u - 1] + my_ggg[idx[jj] + u]) {
+          if (fij == my_f5[u - 1] + gquad_mx_get(my_ggg, u, jj)) {
             *i  = *j = -1;
             *k  = u - 1;
             return vrna_BT_gquad_mfe(fc, u, jj, bp_stack, stack_count);
@@ -12,6 +12,7 @@
 #include "ViennaRNA/fold_vars.h"
 #include "ViennaRNA/params/default.h"
 #include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/utils/higher_order_functions.h"
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/constraints/hard.h"
 #include "ViennaRNA/constraints/soft.h"
@@ -37,6 +38,16 @@ struct vrna_mx_pf_aux_el_s {
 
   int         qqu_size;
   FLT_OR_DBL  **qqu;
+
+  /* complete columns qq[j][i] for wavefront and tiled fills (NULL otherwise) */
+  int         length;
+  FLT_OR_DBL  **qq_col;
+
+  /* hard and soft constraint wrappers prepared once for all (i, j) */
+  unsigned char             has_wrappers;
+  vrna_callback_hc_evaluate *evaluate;
+  struct default_data       hc_dat;
+  struct sc_wrapper_exp_ext sc_wrapper;
 };
 
 /*
@@ -92,6 +103,17 @@ exp_E_ext_fast(vrna_fold_compound_t       *fc,
                struct vrna_mx_pf_aux_el_s *aux_mx);
 
 
+PRIVATE INLINE struct vrna_mx_pf_aux_el_s *
+get_column_view(struct vrna_mx_pf_aux_el_s  *aux_mx,
+                int                         j,
+                struct vrna_mx_pf_aux_el_s  *view);
+
+
+PRIVATE INLINE void
+free_column_view(struct vrna_mx_pf_aux_el_s *aux_mx,
+                 struct vrna_mx_pf_aux_el_s *view);
+
+
 /*
  #################################
  # BEGIN OF FUNCTION DEFINITIONS #
@@ -129,8 +151,8 @@ vrna_exp_E_ext_fast_init(vrna_fold_compound_t *fc)
     int                       i, j, max_j, d, n, turn, ij, *iidx, with_ud;
     FLT_OR_DBL                *q, **q_local;
     vrna_callback_hc_evaluate *evaluate;
-    struct default_data       hc_dat_local;
-    struct sc_wrapper_exp_ext sc_wrapper;
+    struct default_data       hc_dat_local, *hc_dat;
+    struct sc_wrapper_exp_ext sc_wrapper_local, *sc_wrapper;
     vrna_ud_t                 *domains_up;
 
     n           = (int)fc->length;
@@ -139,20 +161,47 @@ vrna_exp_E_ext_fast_init(vrna_fold_compound_t *fc)
     domains_up  = fc->domains_up;
     with_ud     = (domains_up && domains_up->exp_energy_cb);
 
-    if (fc->hc->type == VRNA_HC_WINDOW)
-      evaluate = prepare_hc_default_window(fc, &hc_dat_local);
-    else
-      evaluate = prepare_hc_default(fc, &hc_dat_local);
-
-    init_sc_wrapper_pf(fc, &sc_wrapper);
-
     /* allocate memory for helper arrays */
     aux_mx =
       (struct vrna_mx_pf_aux_el_s *)vrna_alloc(sizeof(struct vrna_mx_pf_aux_el_s));
-    aux_mx->qq        = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
-    aux_mx->qq1       = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
     aux_mx->qqu_size  = 0;
     aux_mx->qqu       = NULL;
+    aux_mx->length    = n;
+    aux_mx->qq_col    = NULL;
+
+    /*
+     *  hard and soft constraints of sliding window computations change
+     *  while the window moves, so only global fills keep the wrappers
+     *  around for all subsequent decompositions
+     */
+    if (fc->hc->type == VRNA_HC_WINDOW) {
+      aux_mx->has_wrappers  = 0;
+      evaluate              = prepare_hc_default_window(fc, &hc_dat_local);
+      hc_dat                = &hc_dat_local;
+      sc_wrapper            = &sc_wrapper_local;
+    } else {
+      aux_mx->has_wrappers  = 1;
+      aux_mx->evaluate      = prepare_hc_default(fc, &(aux_mx->hc_dat));
+      evaluate              = aux_mx->evaluate;
+      hc_dat                = &(aux_mx->hc_dat);
+      sc_wrapper            = &(aux_mx->sc_wrapper);
+    }
+
+    init_sc_wrapper_pf(fc, sc_wrapper);
+
+    if ((fc->hc->type != VRNA_HC_WINDOW) &&
+        ((fc->exp_params->model_details.wavefront) ||
+         (fc->exp_params->model_details.tile_size > 0))) {
+      /* keep all columns j of qq for wavefront and tiled fills, see multibranch_pf.c */
+      aux_mx->qq      = NULL;
+      aux_mx->qq1     = NULL;
+      aux_mx->qq_col  = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (n + 1));
+      for (j = 0; j <= n; j++)
+        aux_mx->qq_col[j] = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j + 2));
+    } else {
+      aux_mx->qq  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+      aux_mx->qq1 = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+    }
 
     /* pre-processing ligand binding production rule(s) and auxiliary memory */
     if (with_ud) {
@@ -161,11 +210,14 @@ vrna_exp_E_ext_fast_init(vrna_fold_compound_t *fc)
         if (ud_max_size < domains_up->uniq_motif_size[u])
           ud_max_size = domains_up->uniq_motif_size[u];
 
-      aux_mx->qqu_size  = ud_max_size;
-      aux_mx->qqu       = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (ud_max_size + 1));
+      aux_mx->qqu_size = ud_max_size;
+
+      if (!aux_mx->qq_col) {
+        aux_mx->qqu = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (ud_max_size + 1));
 
-      for (u = 0; u <= ud_max_size; u++)
-        aux_mx->qqu[u] = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+        for (u = 0; u <= ud_max_size; u++)
+          aux_mx->qqu[u] = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+      }
     }
 
     if (fc->hc->type == VRNA_HC_WINDOW) {
@@ -175,7 +227,7 @@ vrna_exp_E_ext_fast_init(vrna_fold_compound_t *fc)
       for (j = 1; j <= max_j; j++)
         for (i = 1; i <= j; i++)
           q_local[i][j] =
-            reduce_ext_up_fast(fc, i, j, aux_mx, evaluate, &hc_dat_local, &sc_wrapper);
+            reduce_ext_up_fast(fc, i, j, aux_mx, evaluate, hc_dat, sc_wrapper);
     } else {
       q = fc->exp_matrices->q;
       for (d = 0; d <= turn; d++)
@@ -183,7 +235,7 @@ vrna_exp_E_ext_fast_init(vrna_fold_compound_t *fc)
           j   = i + d;
           ij  = iidx[i] - j;
 
-          q[ij] = reduce_ext_up_fast(fc, i, j, aux_mx, evaluate, &hc_dat_local, &sc_wrapper);
+          q[ij] = reduce_ext_up_fast(fc, i, j, aux_mx, evaluate, hc_dat, sc_wrapper);
         }
 
       if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_f)) {
@@ -196,6 +248,9 @@ vrna_exp_E_ext_fast_init(vrna_fold_compound_t *fc)
           }
       }
     }
+
+    if (!aux_mx->has_wrappers)
+      free_sc_wrapper_pf(sc_wrapper);
   }
 
   return aux_mx;
@@ -205,7 +260,7 @@ vrna_exp_E_ext_fast_init(vrna_fold_compound_t *fc)
 PUBLIC void
 vrna_exp_E_ext_fast_rotate(struct vrna_mx_pf_aux_el_s *aux_mx)
 {
-  if (aux_mx) {
+  if ((aux_mx) && (!aux_mx->qq_col)) {
     int         u;
     FLT_OR_DBL  *tmp;
 
@@ -240,6 +295,16 @@ vrna_exp_E_ext_fast_free(struct vrna_mx_pf_aux_el_s *aux_mx)
       free(aux_mx->qqu);
     }
 
+    if (aux_mx->qq_col) {
+      for (u = 0; u <= aux_mx->length; u++)
+        free(aux_mx->qq_col[u]);
+
+      free(aux_mx->qq_col);
+    }
+
+    if (aux_mx->has_wrappers)
+      free_sc_wrapper_pf(&(aux_mx->sc_wrapper));
+
     free(aux_mx);
   }
 }
@@ -277,7 +342,14 @@ vrna_exp_E_ext_fast(vrna_fold_compound_t        *fc,
       return 0.;
     }
 
-    return exp_E_ext_fast(fc, i, j, aux_mx);
+    FLT_OR_DBL                  q;
+    struct vrna_mx_pf_aux_el_s  view, *mx;
+
+    mx  = get_column_view(aux_mx, j, &view);
+    q   = exp_E_ext_fast(fc, i, j, mx);
+    free_column_view(aux_mx, mx);
+
+    return q;
   }
 
   return 0.;
@@ -313,6 +385,41 @@ vrna_exp_E_ext_fast_update(vrna_fold_compound_t       *fc,
 }
 
 
+PRIVATE INLINE struct vrna_mx_pf_aux_el_s *
+get_column_view(struct vrna_mx_pf_aux_el_s  *aux_mx,
+                int                         j,
+                struct vrna_mx_pf_aux_el_s  *view)
+{
+  int u;
+
+  if (!aux_mx->qq_col)
+    return aux_mx;
+
+  /* present columns j, j - 1, ..., j - qqu_size as rotating helper arrays */
+  *view     = *aux_mx;
+  view->qq  = aux_mx->qq_col[j];
+  view->qq1 = aux_mx->qq_col[(j > 0) ? j - 1 : 0];
+  view->qqu = NULL;
+
+  if (aux_mx->qqu_size > 0) {
+    view->qqu = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (aux_mx->qqu_size + 1));
+    for (u = 0; (u <= aux_mx->qqu_size) && (u <= j); u++)
+      view->qqu[u] = aux_mx->qq_col[j - u];
+  }
+
+  return view;
+}
+
+
+PRIVATE INLINE void
+free_column_view(struct vrna_mx_pf_aux_el_s *aux_mx,
+                 struct vrna_mx_pf_aux_el_s *view)
+{
+  if (view != aux_mx)
+    free(view->qqu);
+}
+
+
 PRIVATE INLINE FLT_OR_DBL
 reduce_ext_ext_fast(vrna_fold_compound_t        *fc,
                     int                         i,
@@ -545,28 +652,38 @@ split_ext_fast(vrna_fold_compound_t       *fc,
    *  increases speed. However, once we check for the split point between
    *  strands in hard constraints, we have to think of something else...
    */
-  if ((evaluate == &hc_default) || (evaluate == &hc_default_window)) {
-    for (k = j; k > i; k--) {
-      qbt += q[ij1] *
-             qqq[k];
-      ij1 -= factor;
+  if ((evaluate != &hc_default) && (evaluate != &hc_default_window)) {
+    /*
+     *  mask unavailable decompositions instead of skipping them, such
+     *  that the products are summed up in the same order in any case
+     */
+    if (qqq == qq) {
+      qqq = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j - i + 1));
+      qqq -= i;
+
+      for (k = j; k > i; k--)
+        qqq[k] = qq[k];
     }
-  } else {
+
     for (k = j; k > i; k--)
-      if (evaluate(i, j, k - 1, k, VRNA_DECOMP_EXT_EXT_EXT, hc_dat_local)) {
-        qbt += q[ij1] *
-               qqq[k];
-        ij1 -= factor;
-      }
+      if (!evaluate(i, j, k - 1, k, VRNA_DECOMP_EXT_EXT_EXT, hc_dat_local))
+        qqq[k] = 0.;
   }
 
+  if (factor == 1)
+    qbt = vrna_fun_zip_mult_sum(q + i,
+                                qqq + i + 1,
+                                j - i);
+  else
+    qbt = vrna_fun_zip_mult_sum_reverse(q + ij1,
+                                        qqq + j,
+                                        j - i);
+
 #else
-  for (k = j; k > i; k--)
-    if (evaluate(i, j, k - 1, k, VRNA_DECOMP_EXT_EXT_EXT, hc_dat_local)) {
+  for (k = j; k > i; k--, ij1 -= factor)
+    if (evaluate(i, j, k - 1, k, VRNA_DECOMP_EXT_EXT_EXT, hc_dat_local))
       qbt += q[ij1] *
              qqq[k];
-      ij1 -= factor;
-    }
 
 #endif
 
@@ -585,14 +702,14 @@ exp_E_ext_fast(vrna_fold_compound_t       *fc,
                int                        j,
                struct vrna_mx_pf_aux_el_s *aux_mx)
 {
-  int                       *iidx, ij, with_ud, with_gquad;
-  FLT_OR_DBL                qbt1, *qq, **qqu, *G, **G_local;
+  int                       with_ud, with_gquad;
+  FLT_OR_DBL                qbt1, *qq, **qqu, **G_local;
   vrna_md_t                 *md;
   vrna_exp_param_t          *pf_params;
   vrna_ud_t                 *domains_up;
   vrna_callback_hc_evaluate *evaluate;
-  struct default_data       hc_dat_local;
-  struct sc_wrapper_exp_ext sc_wrapper;
+  struct default_data       hc_dat_local, *hc_dat;
+  struct sc_wrapper_exp_ext sc_wrapper_local, *sc_wrapper;
 
   qq          = aux_mx->qq;
   qqu         = aux_mx->qqu;
@@ -602,29 +719,34 @@ exp_E_ext_fast(vrna_fold_compound_t       *fc,
   with_gquad  = md->gquad;
   with_ud     = (domains_up && domains_up->exp_energy_cb);
 
-  if (fc->hc->type == VRNA_HC_WINDOW)
-    evaluate = prepare_hc_default_window(fc, &hc_dat_local);
-  else
-    evaluate = prepare_hc_default(fc, &hc_dat_local);
+  if (aux_mx->has_wrappers) {
+    evaluate    = aux_mx->evaluate;
+    hc_dat      = &(aux_mx->hc_dat);
+    sc_wrapper  = &(aux_mx->sc_wrapper);
+  } else {
+    if (fc->hc->type == VRNA_HC_WINDOW)
+      evaluate = prepare_hc_default_window(fc, &hc_dat_local);
+    else
+      evaluate = prepare_hc_default(fc, &hc_dat_local);
 
-  init_sc_wrapper_pf(fc, &sc_wrapper);
+    hc_dat      = &hc_dat_local;
+    sc_wrapper  = &sc_wrapper_local;
+    init_sc_wrapper_pf(fc, sc_wrapper);
+  }
 
   qbt1 = 0.;
 
   /* all exterior loop parts [i, j] with exactly one stem (i, u) i < u < j */
-  qbt1 += reduce_ext_ext_fast(fc, i, j, aux_mx, evaluate, &hc_dat_local, &sc_wrapper);
+  qbt1 += reduce_ext_ext_fast(fc, i, j, aux_mx, evaluate, hc_dat, sc_wrapper);
   /* exterior loop part with stem (i, j) */
-  qbt1 += reduce_ext_stem_fast(fc, i, j, aux_mx, evaluate, &hc_dat_local, &sc_wrapper);
+  qbt1 += reduce_ext_stem_fast(fc, i, j, aux_mx, evaluate, hc_dat, sc_wrapper);
 
   if (with_gquad) {
     if (fc->hc->type == VRNA_HC_WINDOW) {
       G_local = fc->exp_matrices->G_local;
       qbt1    += G_local[i][j];
     } else {
-      G     = fc->exp_matrices->G;
-      iidx  = fc->iindx;
-      ij    = iidx[i] - j;
-      qbt1  += G[ij];
+      qbt1 += gquad_mx_get_pf(fc->exp_matrices->G, i, j);
     }
   }
 
@@ -634,11 +756,12 @@ exp_E_ext_fast(vrna_fold_compound_t       *fc,
     qqu[0][i] = qbt1;
 
   /* the entire stretch [i,j] is unpaired */
-  qbt1 += reduce_ext_up_fast(fc, i, j, aux_mx, evaluate, &hc_dat_local, &sc_wrapper);
+  qbt1 += reduce_ext_up_fast(fc, i, j, aux_mx, evaluate, hc_dat, sc_wrapper);
 
-  qbt1 += split_ext_fast(fc, i, j, aux_mx, evaluate, &hc_dat_local, &sc_wrapper);
+  qbt1 += split_ext_fast(fc, i, j, aux_mx, evaluate, hc_dat, sc_wrapper);
 
-  free_sc_wrapper_pf(&sc_wrapper);
+  if (!aux_mx->has_wrappers)
+    free_sc_wrapper_pf(sc_wrapper);
 
   return qbt1;
 }
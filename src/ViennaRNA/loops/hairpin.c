@@ -30,12 +30,44 @@
 #include "hairpin_hc.inc"
 #include "hairpin_sc.inc"
 
+struct vrna_mx_mfe_aux_hp_s {
+  vrna_callback_hc_evaluate *evaluate;
+  struct default_data       hc_dat;
+  struct sc_wrapper_hp      sc_wrapper;
+};
+
 /*
  #################################
  # PRIVATE FUNCTION DECLARATIONS #
  #################################
  */
 
+PRIVATE void
+init_aux_hp(vrna_fold_compound_t        *fc,
+            struct vrna_mx_mfe_aux_hp_s *aux);
+
+
+PRIVATE int
+E_hp_loop(vrna_fold_compound_t        *fc,
+          int                         i,
+          int                         j,
+          struct vrna_mx_mfe_aux_hp_s *aux);
+
+
+PRIVATE int
+eval_hp_loop(vrna_fold_compound_t *fc,
+             int                  i,
+             int                  j,
+             struct sc_wrapper_hp *sc_wrapper);
+
+
+PRIVATE int
+eval_ext_hp_loop(vrna_fold_compound_t *fc,
+                 int                  i,
+                 int                  j,
+                 struct sc_wrapper_hp *sc_wrapper);
+
+
 PRIVATE int
 eval_hp_loop_fake(vrna_fold_compound_t  *fc,
                   int                   i,
@@ -61,25 +93,53 @@ vrna_E_hp_loop(vrna_fold_compound_t *fc,
                int                  i,
                int                  j)
 {
-  vrna_callback_hc_evaluate *evaluate;
-  struct default_data       hc_dat_local;
+  int                         e;
+  struct vrna_mx_mfe_aux_hp_s aux;
 
-  if (fc->hc->type == VRNA_HC_WINDOW)
-    evaluate = prepare_hc_default_window(fc, &hc_dat_local);
-  else
-    evaluate = prepare_hc_default(fc, &hc_dat_local);
+  init_aux_hp(fc, &aux);
+  e = E_hp_loop(fc, i, j, &aux);
+  free_sc_wrapper(&(aux.sc_wrapper));
 
-  if ((i > 0) && (j > 0)) {
-    /* is this base pair allowed to close a hairpin (like) loop ? */
-    if (evaluate(i, j, i, j, VRNA_DECOMP_PAIR_HP, &hc_dat_local)) {
-      if (j > i)  /* linear case */
-        return vrna_eval_hp_loop(fc, i, j);
-      else        /* circular case */
-        return vrna_eval_ext_hp_loop(fc, j, i);
-    }
+  return e;
+}
+
+
+PUBLIC vrna_mx_mfe_aux_hp_t
+vrna_E_hp_loop_fast_init(vrna_fold_compound_t *fc)
+{
+  struct vrna_mx_mfe_aux_hp_s *aux = NULL;
+
+  if (fc) {
+    aux = (struct vrna_mx_mfe_aux_hp_s *)vrna_alloc(sizeof(struct vrna_mx_mfe_aux_hp_s));
+    init_aux_hp(fc, aux);
   }
 
-  return INF;
+  return aux;
+}
+
+
+PUBLIC int
+vrna_E_hp_loop_fast(vrna_fold_compound_t  *fc,
+                    int                   i,
+                    int                   j,
+                    vrna_mx_mfe_aux_hp_t  aux_mx)
+{
+  int e = INF;
+
+  if ((fc) && (aux_mx))
+    e = E_hp_loop(fc, i, j, aux_mx);
+
+  return e;
+}
+
+
+PUBLIC void
+vrna_E_hp_loop_fast_free(vrna_mx_mfe_aux_hp_t aux_mx)
+{
+  if (aux_mx) {
+    free_sc_wrapper(&(aux_mx->sc_wrapper));
+    free(aux_mx);
+  }
 }
 
 
@@ -106,6 +166,99 @@ PUBLIC int
 vrna_eval_ext_hp_loop(vrna_fold_compound_t  *fc,
                       int                   i,
                       int                   j)
+{
+  int                   e;
+  struct sc_wrapper_hp  sc_wrapper;
+
+  init_sc_wrapper(fc, &sc_wrapper);
+  e = eval_ext_hp_loop(fc, i, j, &sc_wrapper);
+  free_sc_wrapper(&sc_wrapper);
+
+  return e;
+}
+
+
+/**
+ *  @brief Evaluate free energy of a hairpin loop
+ *
+ *  @ingroup eval
+ *
+ *  @note This function is polymorphic! The provided #vrna_fold_compound_t may be of type
+ *  #VRNA_FC_TYPE_SINGLE or #VRNA_FC_TYPE_COMPARATIVE
+ *
+ *  @param  fc  The #vrna_fold_compound_t for the particular energy evaluation
+ *  @param  i   5'-position of the base pair
+ *  @param  j   3'-position of the base pair
+ *  @returns    Free energy of the hairpin loop closed by @f$ (i,j) @f$ in deka-kal/mol
+ */
+PUBLIC int
+vrna_eval_hp_loop(vrna_fold_compound_t  *fc,
+                  int                   i,
+                  int                   j)
+{
+  int                   e;
+  struct sc_wrapper_hp  sc_wrapper;
+
+  if (fc->strand_number[j] != fc->strand_number[i])
+    return eval_hp_loop_fake(fc, i, j);
+
+  init_sc_wrapper(fc, &sc_wrapper);
+  e = eval_hp_loop(fc, i, j, &sc_wrapper);
+  free_sc_wrapper(&sc_wrapper);
+
+  return e;
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+PRIVATE void
+init_aux_hp(vrna_fold_compound_t        *fc,
+            struct vrna_mx_mfe_aux_hp_s *aux)
+{
+  if (fc->hc->type == VRNA_HC_WINDOW)
+    aux->evaluate = prepare_hc_default_window(fc, &(aux->hc_dat));
+  else
+    aux->evaluate = prepare_hc_default(fc, &(aux->hc_dat));
+
+  init_sc_wrapper(fc, &(aux->sc_wrapper));
+}
+
+
+PRIVATE int
+E_hp_loop(vrna_fold_compound_t        *fc,
+          int                         i,
+          int                         j,
+          struct vrna_mx_mfe_aux_hp_s *aux)
+{
+  if ((i > 0) && (j > 0)) {
+    /* is this base pair allowed to close a hairpin (like) loop ? */
+    if (aux->evaluate(i, j, i, j, VRNA_DECOMP_PAIR_HP, &(aux->hc_dat))) {
+      if (j > i) {
+        /* linear case */
+        if (fc->strand_number[j] != fc->strand_number[i])
+          return eval_hp_loop_fake(fc, i, j);
+
+        return eval_hp_loop(fc, i, j, &(aux->sc_wrapper));
+      } else {
+        /* circular case */
+        return eval_ext_hp_loop(fc, j, i, &(aux->sc_wrapper));
+      }
+    }
+  }
+
+  return INF;
+}
+
+
+PRIVATE int
+eval_ext_hp_loop(vrna_fold_compound_t *fc,
+                 int                  i,
+                 int                  j,
+                 struct sc_wrapper_hp *sc_wrapper)
 {
   char                  **Ss, loopseq[10] = {
     0
@@ -115,7 +268,6 @@ vrna_eval_ext_hp_loop(vrna_fold_compound_t  *fc,
   int                   u1, u2, e, s, type, n_seq, length, noGUclosure;
   vrna_param_t          *P;
   vrna_md_t             *md;
-  struct sc_wrapper_hp  sc_wrapper;
 
   length      = fc->length;
   P           = fc->params;
@@ -123,8 +275,6 @@ vrna_eval_ext_hp_loop(vrna_fold_compound_t  *fc,
   noGUclosure = md->noGUclosure;
   e           = INF;
 
-  init_sc_wrapper(fc, &sc_wrapper);
-
   u1  = length - j;
   u2  = i - 1;
 
@@ -189,55 +339,33 @@ vrna_eval_ext_hp_loop(vrna_fold_compound_t  *fc,
   }
 
   if (e != INF)
-    if (sc_wrapper.pair_ext)
-      e += sc_wrapper.pair_ext(i, j, &sc_wrapper);
-
-  free_sc_wrapper(&sc_wrapper);
+    if (sc_wrapper->pair_ext)
+      e += sc_wrapper->pair_ext(i, j, sc_wrapper);
 
   return e;
 }
 
 
-/**
- *  @brief Evaluate free energy of a hairpin loop
- *
- *  @ingroup eval
- *
- *  @note This function is polymorphic! The provided #vrna_fold_compound_t may be of type
- *  #VRNA_FC_TYPE_SINGLE or #VRNA_FC_TYPE_COMPARATIVE
- *
- *  @param  fc  The #vrna_fold_compound_t for the particular energy evaluation
- *  @param  i   5'-position of the base pair
- *  @param  j   3'-position of the base pair
- *  @returns    Free energy of the hairpin loop closed by @f$ (i,j) @f$ in deka-kal/mol
- */
-PUBLIC int
-vrna_eval_hp_loop(vrna_fold_compound_t  *fc,
-                  int                   i,
-                  int                   j)
+PRIVATE int
+eval_hp_loop(vrna_fold_compound_t *fc,
+             int                  i,
+             int                  j,
+             struct sc_wrapper_hp *sc_wrapper)
 {
   char                  **Ss;
   unsigned int          **a2s;
   short                 *S, *S2, **SS, **S5, **S3;
-  unsigned int          *sn;
   int                   u, e, s, type, n_seq, en, noGUclosure;
   vrna_param_t          *P;
   vrna_md_t             *md;
   vrna_ud_t             *domains_up;
-  struct sc_wrapper_hp  sc_wrapper;
 
   P           = fc->params;
   md          = &(P->model_details);
   noGUclosure = md->noGUclosure;
-  sn          = fc->strand_number;
   domains_up  = fc->domains_up;
   e           = INF;
 
-  if (sn[j] != sn[i])
-    return eval_hp_loop_fake(fc, i, j);
-
-  init_sc_wrapper(fc, &sc_wrapper);
-
   /* regular hairpin loop */
   switch (fc->type) {
     /* single sequences and cofolding hybrids */
@@ -281,8 +409,8 @@ vrna_eval_hp_loop(vrna_fold_compound_t  *fc,
   }
 
   if (e != INF) {
-    if (sc_wrapper.pair)
-      e += sc_wrapper.pair(i, j, &sc_wrapper);
+    if (sc_wrapper->pair)
+      e += sc_wrapper->pair(i, j, sc_wrapper);
 
     /* consider possible ligand binding */
     if (domains_up && domains_up->energy_cb) {
@@ -297,8 +425,6 @@ vrna_eval_hp_loop(vrna_fold_compound_t  *fc,
     }
   }
 
-  free_sc_wrapper(&sc_wrapper);
-
   return e;
 }
 
@@ -72,6 +72,45 @@ vrna_E_hp_loop(vrna_fold_compound_t *fc,
                int                  j);
 
 
+/**
+ *  @brief  Auxiliary data for fast hairpin loop evaluation
+ *
+ *  Holds the hard constraint evaluator and the soft constraint wrapper that
+ *  hairpin loop evaluations of different pairs @f$(i,j)@f$ have in common.
+ *
+ *  @see vrna_E_hp_loop_fast_init(), vrna_E_hp_loop_fast_free(),
+ *  vrna_E_hp_loop_fast(), #vrna_mx_mfe_aux_il_t
+ */
+typedef struct vrna_mx_mfe_aux_hp_s *vrna_mx_mfe_aux_hp_t;
+
+
+/**
+ *  @brief  Prepare the auxiliary data for fast hairpin loop evaluation
+ *
+ *  The returned data refers to the hard and soft constraints of @p fc and is
+ *  only valid as long as they are not changed or replaced.
+ */
+vrna_mx_mfe_aux_hp_t
+vrna_E_hp_loop_fast_init(vrna_fold_compound_t *fc);
+
+
+/**
+ *  @brief  Evaluate the free energy of a hairpin loop using pre-computed auxiliary data
+ *
+ *  Same as vrna_E_hp_loop() but without any per-call setup. This function
+ *  may be called concurrently from multiple threads for a single @p aux_mx.
+ */
+int
+vrna_E_hp_loop_fast(vrna_fold_compound_t  *fc,
+                    int                   i,
+                    int                   j,
+                    vrna_mx_mfe_aux_hp_t  aux_mx);
+
+
+void
+vrna_E_hp_loop_fast_free(vrna_mx_mfe_aux_hp_t aux_mx);
+
+
 /**
  *  @brief  Evaluate the free energy of an exterior hairpin loop
  *          and consider possible hard constraints
@@ -305,6 +344,36 @@ vrna_exp_E_hp_loop(vrna_fold_compound_t *fc,
                    int                  j);
 
 
+/**
+ *  @brief  Auxiliary data for fast hairpin loop evaluation (partition function)
+ *
+ *  @see vrna_exp_E_hp_loop_fast_init(), vrna_exp_E_hp_loop_fast_free(),
+ *  vrna_exp_E_hp_loop_fast(), #vrna_mx_mfe_aux_hp_t
+ */
+typedef struct vrna_mx_pf_aux_hp_s *vrna_mx_pf_aux_hp_t;
+
+
+vrna_mx_pf_aux_hp_t
+vrna_exp_E_hp_loop_fast_init(vrna_fold_compound_t *fc);
+
+
+/**
+ *  @brief  Evaluate the Boltzmann weight of a hairpin loop using pre-computed auxiliary data
+ *
+ *  Same as vrna_exp_E_hp_loop() but without any per-call setup. This function
+ *  may be called concurrently from multiple threads for a single @p aux_mx.
+ */
+FLT_OR_DBL
+vrna_exp_E_hp_loop_fast(vrna_fold_compound_t  *fc,
+                        int                   i,
+                        int                   j,
+                        vrna_mx_pf_aux_hp_t   aux_mx);
+
+
+void
+vrna_exp_E_hp_loop_fast_free(vrna_mx_pf_aux_hp_t aux_mx);
+
+
 /* End partition function interface */
 /**@}*/
 
@@ -30,22 +30,42 @@
 #include "hairpin_hc.inc"
 #include "hairpin_sc_pf.inc"
 
+struct vrna_mx_pf_aux_hp_s {
+  vrna_callback_hc_evaluate *evaluate;
+  struct default_data       hc_dat;
+  struct sc_wrapper_exp_hp  sc_wrapper;
+};
+
 /*
  #################################
  # PRIVATE FUNCTION DECLARATIONS #
  #################################
  */
 
+PRIVATE void
+init_aux_hp(vrna_fold_compound_t        *fc,
+            struct vrna_mx_pf_aux_hp_s  *aux);
+
+
 PRIVATE FLT_OR_DBL
-exp_eval_hp_loop(vrna_fold_compound_t *fc,
-                 int                  i,
-                 int                  j);
+exp_E_hp_loop(vrna_fold_compound_t        *fc,
+              int                         i,
+              int                         j,
+              struct vrna_mx_pf_aux_hp_s  *aux);
 
 
 PRIVATE FLT_OR_DBL
-exp_eval_ext_hp_loop(vrna_fold_compound_t *fc,
-                     int                  i,
-                     int                  j);
+exp_eval_hp_loop(vrna_fold_compound_t     *fc,
+                 int                      i,
+                 int                      j,
+                 struct sc_wrapper_exp_hp *sc_wrapper);
+
+
+PRIVATE FLT_OR_DBL
+exp_eval_ext_hp_loop(vrna_fold_compound_t     *fc,
+                     int                      i,
+                     int                      j,
+                     struct sc_wrapper_exp_hp *sc_wrapper);
 
 
 PRIVATE FLT_OR_DBL
@@ -70,20 +90,86 @@ vrna_exp_E_hp_loop(vrna_fold_compound_t *fc,
                    int                  i,
                    int                  j)
 {
-  vrna_callback_hc_evaluate *evaluate;
-  struct default_data       hc_dat_local;
+  FLT_OR_DBL                  q;
+  struct vrna_mx_pf_aux_hp_s  aux;
+
+  init_aux_hp(fc, &aux);
+  q = exp_E_hp_loop(fc, i, j, &aux);
+  free_sc_wrapper(&(aux.sc_wrapper));
+
+  return q;
+}
 
+
+PUBLIC vrna_mx_pf_aux_hp_t
+vrna_exp_E_hp_loop_fast_init(vrna_fold_compound_t *fc)
+{
+  struct vrna_mx_pf_aux_hp_s *aux = NULL;
+
+  if (fc) {
+    aux = (struct vrna_mx_pf_aux_hp_s *)vrna_alloc(sizeof(struct vrna_mx_pf_aux_hp_s));
+    init_aux_hp(fc, aux);
+  }
+
+  return aux;
+}
+
+
+PUBLIC FLT_OR_DBL
+vrna_exp_E_hp_loop_fast(vrna_fold_compound_t  *fc,
+                        int                   i,
+                        int                   j,
+                        vrna_mx_pf_aux_hp_t   aux_mx)
+{
+  FLT_OR_DBL q = 0.;
+
+  if ((fc) && (aux_mx))
+    q = exp_E_hp_loop(fc, i, j, aux_mx);
+
+  return q;
+}
+
+
+PUBLIC void
+vrna_exp_E_hp_loop_fast_free(vrna_mx_pf_aux_hp_t aux_mx)
+{
+  if (aux_mx) {
+    free_sc_wrapper(&(aux_mx->sc_wrapper));
+    free(aux_mx);
+  }
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+PRIVATE void
+init_aux_hp(vrna_fold_compound_t        *fc,
+            struct vrna_mx_pf_aux_hp_s  *aux)
+{
   if (fc->hc->type == VRNA_HC_WINDOW)
-    evaluate = prepare_hc_default_window(fc, &hc_dat_local);
+    aux->evaluate = prepare_hc_default_window(fc, &(aux->hc_dat));
   else
-    evaluate = prepare_hc_default(fc, &hc_dat_local);
+    aux->evaluate = prepare_hc_default(fc, &(aux->hc_dat));
+
+  init_sc_wrapper(fc, &(aux->sc_wrapper));
+}
 
+
+PRIVATE FLT_OR_DBL
+exp_E_hp_loop(vrna_fold_compound_t       *fc,
+              int                        i,
+              int                        j,
+              struct vrna_mx_pf_aux_hp_s *aux)
+{
   if ((i > 0) && (j > 0)) {
-    if (evaluate(i, j, i, j, VRNA_DECOMP_PAIR_HP, &hc_dat_local)) {
+    if (aux->evaluate(i, j, i, j, VRNA_DECOMP_PAIR_HP, &(aux->hc_dat))) {
       if (j > i)  /* linear case */
-        return exp_eval_hp_loop(fc, i, j);
+        return exp_eval_hp_loop(fc, i, j, &(aux->sc_wrapper));
       else        /* circular case */
-        return exp_eval_ext_hp_loop(fc, j, i);
+        return exp_eval_ext_hp_loop(fc, j, i, &(aux->sc_wrapper));
     }
   }
 
@@ -177,20 +263,20 @@ exp_eval_hp_loop_fake(vrna_fold_compound_t  *fc,
 
 
 PRIVATE FLT_OR_DBL
-exp_eval_hp_loop(vrna_fold_compound_t *fc,
-                 int                  i,
-                 int                  j)
+exp_eval_hp_loop(vrna_fold_compound_t     *fc,
+                 int                      i,
+                 int                      j,
+                 struct sc_wrapper_exp_hp *sc_wrapper)
 {
-  char                      **Ss;
-  unsigned int              **a2s;
-  short                     *S, *S2, **SS, **S5, **S3;
-  unsigned int              *sn;
-  int                       u, type, n_seq, s;
-  FLT_OR_DBL                q, qbt1, *scale;
-  vrna_exp_param_t          *P;
-  vrna_md_t                 *md;
-  vrna_ud_t                 *domains_up;
-  struct sc_wrapper_exp_hp  sc_wrapper;
+  char              **Ss;
+  unsigned int      **a2s;
+  short             *S, *S2, **SS, **S5, **S3;
+  unsigned int      *sn;
+  int               u, type, n_seq, s;
+  FLT_OR_DBL        q, qbt1, *scale;
+  vrna_exp_param_t  *P;
+  vrna_md_t         *md;
+  vrna_ud_t         *domains_up;
 
   P           = fc->exp_params;
   md          = &(P->model_details);
@@ -198,7 +284,6 @@ exp_eval_hp_loop(vrna_fold_compound_t *fc,
   scale       = fc->exp_matrices->scale;
   domains_up  = fc->domains_up;
 
-  init_sc_wrapper(fc, &sc_wrapper);
   q = 0.;
 
   if (sn[j] != sn[i])
@@ -247,8 +332,8 @@ exp_eval_hp_loop(vrna_fold_compound_t *fc,
   }
 
   /* add soft constraints */
-  if (sc_wrapper.pair)
-    q *= sc_wrapper.pair(i, j, &sc_wrapper);
+  if (sc_wrapper->pair)
+    q *= sc_wrapper->pair(i, j, sc_wrapper);
 
   if (domains_up && domains_up->exp_energy_cb) {
     /* we always consider both, bound and unbound state */
@@ -260,28 +345,26 @@ exp_eval_hp_loop(vrna_fold_compound_t *fc,
 
   q *= scale[j - i + 1];
 
-  free_sc_wrapper(&sc_wrapper);
-
   return q;
 }
 
 
 PRIVATE FLT_OR_DBL
-exp_eval_ext_hp_loop(vrna_fold_compound_t *fc,
-                     int                  i,
-                     int                  j)
+exp_eval_ext_hp_loop(vrna_fold_compound_t     *fc,
+                     int                      i,
+                     int                      j,
+                     struct sc_wrapper_exp_hp *sc_wrapper)
 {
-  char                      **Ss, *sequence, loopseq[10] = {
+  char              **Ss, *sequence, loopseq[10] = {
     0
   };
-  unsigned int              **a2s;
-  short                     *S, *S2, **SS, **S5, **S3;
-  int                       u1, u2, n, type, n_seq, s, noGUclosure;
-  FLT_OR_DBL                q, qbt1, *scale;
-  vrna_exp_param_t          *P;
-  vrna_md_t                 *md;
-  vrna_ud_t                 *domains_up;
-  struct sc_wrapper_exp_hp  sc_wrapper;
+  unsigned int      **a2s;
+  short             *S, *S2, **SS, **S5, **S3;
+  int               u1, u2, n, type, n_seq, s, noGUclosure;
+  FLT_OR_DBL        q, qbt1, *scale;
+  vrna_exp_param_t  *P;
+  vrna_md_t         *md;
+  vrna_ud_t         *domains_up;
 
   n           = fc->length;
   P           = fc->exp_params;
@@ -290,8 +373,6 @@ exp_eval_ext_hp_loop(vrna_fold_compound_t *fc,
   scale       = fc->exp_matrices->scale;
   domains_up  = fc->domains_up;
 
-  init_sc_wrapper(fc, &sc_wrapper);
-
   q   = 0.;
   u1  = n - j;
   u2  = i - 1;
@@ -353,8 +434,8 @@ exp_eval_ext_hp_loop(vrna_fold_compound_t *fc,
   }
 
   /* add soft constraints */
-  if (sc_wrapper.pair_ext)
-    q *= sc_wrapper.pair_ext(i, j, &sc_wrapper);
+  if (sc_wrapper->pair_ext)
+    q *= sc_wrapper->pair_ext(i, j, sc_wrapper);
 
   if (domains_up && domains_up->exp_energy_cb) {
     /* we always consider both, bound and unbound state */
@@ -366,7 +447,5 @@ exp_eval_ext_hp_loop(vrna_fold_compound_t *fc,
 
   q *= scale[u1 + u2];
 
-  free_sc_wrapper(&sc_wrapper);
-
   return q;
 }
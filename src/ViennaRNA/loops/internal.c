@@ -18,6 +18,9 @@
 #include "ViennaRNA/unstructured_domains.h"
 #include "ViennaRNA/loops/internal.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef __GNUC__
 # define INLINE inline
@@ -28,6 +31,51 @@
 #include "internal_hc.inc"
 #include "internal_sc.inc"
 
+typedef int (decomp_il)(vrna_fold_compound_t        *fc,
+                        int                         i,
+                        int                         j,
+                        struct vrna_mx_mfe_aux_il_s *aux);
+
+struct vrna_mx_mfe_aux_il_s {
+  unsigned char         sliding_window;
+  unsigned char         *hc_mx;
+  unsigned char         **hc_mx_local;
+  char                  *ptype;
+  char                  **ptype_local;
+  short                 *S;
+  short                 **SS;
+  short                 **S5;
+  short                 **S3;
+  unsigned int          *sn;
+  unsigned int          *ss;
+  unsigned int          **a2s;
+  unsigned int          n_seq;
+  int                   *idx;
+  int                   *hc_up;
+  int                   *c;
+  vrna_gquad_mx_t       *ggg;
+  int                   **c_local;
+  int                   **ggg_local;
+  int                   *rtype;
+  int                   with_ud;
+  int                   with_gquad;
+  vrna_param_t          *P;
+  vrna_md_t             *md;
+  vrna_ud_t             *domains_up;
+
+  /* decomposition kernel, selected once according to the constraints present */
+  decomp_il             *decompose;
+
+  eval_hc               *evaluate;
+  struct default_data   hc_dat;
+  struct sc_wrapper_int sc_wrapper;
+
+  /* per-thread scratch space for the pair types of (i, j) in comparative mode */
+  unsigned int          threads;
+  unsigned int          **tt;
+};
+
+
 /*
  #################################
  # PRIVATE FUNCTION DECLARATIONS #
@@ -35,9 +83,17 @@
  */
 
 PRIVATE int
-E_internal_loop(vrna_fold_compound_t  *fc,
-                int                   i,
-                int                   j);
+E_internal_loop(vrna_fold_compound_t        *fc,
+                int                         i,
+                int                         j,
+                struct vrna_mx_mfe_aux_il_s *aux);
+
+
+PRIVATE int
+E_internal_loop_default(vrna_fold_compound_t        *fc,
+                        int                         i,
+                        int                         j,
+                        struct vrna_mx_mfe_aux_il_s *aux);
 
 
 PRIVATE int
@@ -70,6 +126,25 @@ eval_ext_int_loop(vrna_fold_compound_t  *fc,
                   int                   l);
 
 
+PRIVATE void
+init_aux_il(vrna_fold_compound_t        *fc,
+            struct vrna_mx_mfe_aux_il_s *aux,
+            unsigned int                threads);
+
+
+PRIVATE void
+clear_aux_il(struct vrna_mx_mfe_aux_il_s *aux);
+
+
+PRIVATE INLINE unsigned int *
+get_tt_scratch(struct vrna_mx_mfe_aux_il_s *aux);
+
+
+PRIVATE INLINE void
+release_tt_scratch(struct vrna_mx_mfe_aux_il_s  *aux,
+                   unsigned int                 *tt);
+
+
 /*
  #################################
  # BEGIN OF FUNCTION DEFINITIONS #
@@ -79,16 +154,64 @@ PUBLIC int
 vrna_E_int_loop(vrna_fold_compound_t  *fc,
                 int                   i,
                 int                   j)
+{
+  int                         e = INF;
+  struct vrna_mx_mfe_aux_il_s aux;
+
+  if (fc) {
+    init_aux_il(fc, &aux, 1);
+    e = aux.decompose(fc, i, j, &aux);
+    clear_aux_il(&aux);
+  }
+
+  return e;
+}
+
+
+PUBLIC vrna_mx_mfe_aux_il_t
+vrna_E_int_loop_fast_init(vrna_fold_compound_t *fc)
+{
+  unsigned int                threads;
+  struct vrna_mx_mfe_aux_il_s *aux = NULL;
+
+  if (fc) {
+    threads = 1;
+#ifdef _OPENMP
+    threads = (unsigned int)omp_get_max_threads();
+#endif
+    aux = (struct vrna_mx_mfe_aux_il_s *)vrna_alloc(sizeof(struct vrna_mx_mfe_aux_il_s));
+    init_aux_il(fc, aux, threads);
+  }
+
+  return aux;
+}
+
+
+PUBLIC int
+vrna_E_int_loop_fast(vrna_fold_compound_t *fc,
+                     int                  i,
+                     int                  j,
+                     vrna_mx_mfe_aux_il_t aux_mx)
 {
   int e = INF;
 
-  if (fc)
-    e = E_internal_loop(fc, i, j);
+  if ((fc) && (aux_mx))
+    e = aux_mx->decompose(fc, i, j, aux_mx);
 
   return e;
 }
 
 
+PUBLIC void
+vrna_E_int_loop_fast_free(vrna_mx_mfe_aux_il_t aux_mx)
+{
+  if (aux_mx) {
+    clear_aux_il(aux_mx);
+    free(aux_mx);
+  }
+}
+
+
 PUBLIC int
 vrna_E_ext_int_loop(vrna_fold_compound_t  *fc,
                     int                   i,
@@ -140,6 +263,123 @@ vrna_eval_int_loop(vrna_fold_compound_t *fc,
  # BEGIN OF STATIC HELPER FUNCTIONS  #
  #####################################
  */
+PRIVATE void
+init_aux_il(vrna_fold_compound_t        *fc,
+            struct vrna_mx_mfe_aux_il_s *aux,
+            unsigned int                threads)
+{
+  unsigned char sliding_window;
+  unsigned int  t;
+
+  sliding_window      = (fc->hc->type == VRNA_HC_WINDOW) ? 1 : 0;
+  aux->sliding_window = sliding_window;
+  aux->sn             = fc->strand_number;
+  aux->ss             = fc->strand_start;
+  aux->n_seq          = (fc->type == VRNA_FC_TYPE_SINGLE) ? 1 : fc->n_seq;
+  aux->idx            = fc->jindx;
+  aux->hc_mx          = (sliding_window) ? NULL : fc->hc->matrix;
+  aux->hc_mx_local    = (sliding_window) ? fc->hc->matrix_local : NULL;
+  aux->hc_up          = fc->hc->up_int;
+  aux->ptype          =
+    (fc->type == VRNA_FC_TYPE_SINGLE) ? (sliding_window ? NULL : fc->ptype) : NULL;
+  aux->ptype_local =
+    (fc->type == VRNA_FC_TYPE_SINGLE) ? (sliding_window ? fc->ptype_local : NULL) : NULL;
+  aux->S          = (fc->type == VRNA_FC_TYPE_SINGLE) ? fc->sequence_encoding : NULL;
+  aux->SS         = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S;
+  aux->S5         = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S5;
+  aux->S3         = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S3;
+  aux->a2s        = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->a2s;
+  aux->c          = (sliding_window) ? NULL : fc->matrices->c;
+  aux->ggg        = (sliding_window) ? NULL : fc->matrices->ggg;
+  aux->c_local    = (sliding_window) ? fc->matrices->c_local : NULL;
+  aux->ggg_local  = (sliding_window) ? fc->matrices->ggg_local : NULL;
+  aux->P          = fc->params;
+  aux->md         = &(aux->P->model_details);
+  aux->rtype      = &(aux->md->rtype[0]);
+  aux->domains_up = fc->domains_up;
+  aux->with_ud    = ((aux->domains_up) && (aux->domains_up->energy_cb)) ? 1 : 0;
+  aux->with_gquad = aux->md->gquad;
+
+  aux->evaluate = prepare_hc_default(fc, &(aux->hc_dat));
+  init_sc_wrapper(fc, &(aux->sc_wrapper));
+
+  /*
+   *  single sequences on a single strand without any hard constraint callback,
+   *  soft constraints, or unstructured domains can use a kernel that does not
+   *  need to check for any of these in its innermost loops
+   */
+  if ((fc->type == VRNA_FC_TYPE_SINGLE) &&
+      (!sliding_window) &&
+      (fc->strands == 1) &&
+      (!fc->hc->f) &&
+      (!aux->sc_wrapper.pair) &&
+      (!aux->with_ud))
+    aux->decompose = &E_internal_loop_default;
+  else
+    aux->decompose = &E_internal_loop;
+
+  aux->threads  = threads;
+  aux->tt       = NULL;
+
+  if (fc->type == VRNA_FC_TYPE_COMPARATIVE) {
+    aux->tt = (unsigned int **)vrna_alloc(sizeof(unsigned int *) * threads);
+    for (t = 0; t < threads; t++)
+      aux->tt[t] = (unsigned int *)vrna_alloc(sizeof(unsigned int) * aux->n_seq);
+  }
+}
+
+
+PRIVATE void
+clear_aux_il(struct vrna_mx_mfe_aux_il_s *aux)
+{
+  unsigned int t;
+
+  free_sc_wrapper(&(aux->sc_wrapper));
+
+  if (aux->tt) {
+    for (t = 0; t < aux->threads; t++)
+      free(aux->tt[t]);
+
+    free(aux->tt);
+    aux->tt = NULL;
+  }
+}
+
+
+PRIVATE INLINE unsigned int *
+get_tt_scratch(struct vrna_mx_mfe_aux_il_s *aux)
+{
+  unsigned int t = 0;
+
+#ifdef _OPENMP
+  if (aux->threads > 1)
+    t = (unsigned int)omp_get_thread_num();
+
+#endif
+
+  if (t < aux->threads)
+    return aux->tt[t];
+
+  /* more threads than anticipated, fall back to private memory */
+  return (unsigned int *)vrna_alloc(sizeof(unsigned int) * aux->n_seq);
+}
+
+
+PRIVATE INLINE void
+release_tt_scratch(struct vrna_mx_mfe_aux_il_s  *aux,
+                   unsigned int                 *tt)
+{
+  unsigned int t;
+
+  if (tt) {
+    for (t = 0; t < aux->threads; t++)
+      if (aux->tt[t] == tt)
+        return;
+
+    free(tt);
+  }
+}
+
 PRIVATE INLINE int
 eval_int_loop(vrna_fold_compound_t  *fc,
               int                   i,
@@ -358,55 +598,57 @@ eval_ext_int_loop(vrna_fold_compound_t  *fc,
 
 
 PRIVATE int
-E_internal_loop(vrna_fold_compound_t  *fc,
-                int                   i,
-                int                   j)
+E_internal_loop(vrna_fold_compound_t        *fc,
+                int                         i,
+                int                         j,
+                struct vrna_mx_mfe_aux_il_s *aux)
 {
   unsigned char         sliding_window, hc_decompose, *hc_mx, **hc_mx_local;
   char                  *ptype, **ptype_local;
   short                 *S, **SS, **S5, **S3;
   unsigned int          *sn, *ss, **a2s, n_seq, s;
-  int                   e, eee, *idx, ij, *c, *ggg, *rtype, with_ud, with_gquad, noclose,
+  int                   e, eee, *idx, ij, *c, *rtype, with_ud, with_gquad, noclose,
                         *hc_up, **c_local, **ggg_local;
+  vrna_gquad_mx_t       *ggg;
   vrna_param_t          *P;
   vrna_md_t             *md;
   vrna_ud_t             *domains_up;
-  struct default_data   hc_dat_local;
+  struct default_data   *hc_dat_local;
   eval_hc               *evaluate;
-  struct sc_wrapper_int sc_wrapper;
-
-  evaluate = prepare_hc_default(fc, &hc_dat_local);
-  init_sc_wrapper(fc, &sc_wrapper);
+  struct sc_wrapper_int *sc_wrapper;
 
   e = INF;
 
-  sliding_window  = (fc->hc->type == VRNA_HC_WINDOW) ? 1 : 0;
-  sn              = fc->strand_number;
-  ss              = fc->strand_start;
-  n_seq           = (fc->type == VRNA_FC_TYPE_SINGLE) ? 1 : fc->n_seq;
-  idx             = fc->jindx;
+  /* everything that does not depend on (i, j) has been set up in the auxiliary data already */
+  sliding_window  = aux->sliding_window;
+  sn              = aux->sn;
+  ss              = aux->ss;
+  n_seq           = aux->n_seq;
+  idx             = aux->idx;
   ij              = (sliding_window) ? 0 : idx[j] + i;
-  hc_mx           = (sliding_window) ? NULL : fc->hc->matrix;
-  hc_mx_local     = (sliding_window) ? fc->hc->matrix_local : NULL;
-  hc_up           = fc->hc->up_int;
-  ptype           = (fc->type == VRNA_FC_TYPE_SINGLE) ? (sliding_window ? NULL : fc->ptype) : NULL;
-  ptype_local     =
-    (fc->type == VRNA_FC_TYPE_SINGLE) ? (sliding_window ? fc->ptype_local : NULL) : NULL;
-  S           = (fc->type == VRNA_FC_TYPE_SINGLE) ? fc->sequence_encoding : NULL;
-  SS          = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S;
-  S5          = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S5;
-  S3          = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S3;
-  a2s         = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->a2s;
-  c           = (sliding_window) ? NULL : fc->matrices->c;
-  ggg         = (sliding_window) ? NULL : fc->matrices->ggg;
-  c_local     = (sliding_window) ? fc->matrices->c_local : NULL;
-  ggg_local   = (sliding_window) ? fc->matrices->ggg_local : NULL;
-  P           = fc->params;
-  md          = &(P->model_details);
-  rtype       = &(md->rtype[0]);
-  domains_up  = fc->domains_up;
-  with_ud     = ((domains_up) && (domains_up->energy_cb)) ? 1 : 0;
-  with_gquad  = md->gquad;
+  hc_mx           = aux->hc_mx;
+  hc_mx_local     = aux->hc_mx_local;
+  hc_up           = aux->hc_up;
+  ptype           = aux->ptype;
+  ptype_local     = aux->ptype_local;
+  S               = aux->S;
+  SS              = aux->SS;
+  S5              = aux->S5;
+  S3              = aux->S3;
+  a2s             = aux->a2s;
+  c               = aux->c;
+  ggg             = aux->ggg;
+  c_local         = aux->c_local;
+  ggg_local       = aux->ggg_local;
+  P               = aux->P;
+  md              = aux->md;
+  rtype           = aux->rtype;
+  domains_up      = aux->domains_up;
+  with_ud         = aux->with_ud;
+  with_gquad      = aux->with_gquad;
+  evaluate        = aux->evaluate;
+  hc_dat_local    = &(aux->hc_dat);
+  sc_wrapper      = &(aux->sc_wrapper);
 
   hc_decompose = (sliding_window) ? hc_mx_local[i][j - i] : hc_mx[ij];
   if (hc_decompose & VRNA_CONSTRAINT_CONTEXT_INT_LOOP) {
@@ -427,7 +669,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
     noclose = ((noGUclosure) && (type == 3 || type == 4)) ? 1 : 0;
 
     if (fc->type == VRNA_FC_TYPE_COMPARATIVE) {
-      tt = (unsigned int *)vrna_alloc(sizeof(unsigned int) * n_seq);
+      tt = get_tt_scratch(aux);
       for (s = 0; s < n_seq; s++)
         tt[s] = vrna_get_ptype_md(SS[s][i], SS[s][j], md);
     }
@@ -439,7 +681,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
       kl            = (sliding_window) ? 0 : idx[l] + k;
       hc_decompose  = (sliding_window) ? hc_mx_local[k][l - k] : hc_mx[kl];
       if ((hc_decompose & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) &&
-          (evaluate(i, j, k, l, &hc_dat_local))) {
+          (evaluate(i, j, k, l, hc_dat_local))) {
         eee = (sliding_window) ? c_local[k][l - k] : c[kl];
 
         if (eee != INF) {
@@ -476,8 +718,8 @@ E_internal_loop(vrna_fold_compound_t  *fc,
               break;
           }
 
-          if (sc_wrapper.pair)
-            eee += sc_wrapper.pair(i, j, k, l, &sc_wrapper);
+          if (sc_wrapper->pair)
+            eee += sc_wrapper->pair(i, j, k, l, sc_wrapper);
 
           e = MIN2(e, eee);
         }
@@ -505,7 +747,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
         for (; k <= last_k; k++, u1++, kl++) {
           hc_decompose = (sliding_window) ? hc_mx_local[k][l - k] : hc_mx[kl];
           if ((hc_decompose & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) &&
-              (evaluate(i, j, k, l, &hc_dat_local))) {
+              (evaluate(i, j, k, l, hc_dat_local))) {
             eee = (sliding_window) ? c_local[k][l - k] : c[kl];
 
             switch (fc->type) {
@@ -546,8 +788,8 @@ E_internal_loop(vrna_fold_compound_t  *fc,
                 break;
             }
 
-            if (sc_wrapper.pair)
-              eee += sc_wrapper.pair(i, j, k, l, &sc_wrapper);
+            if (sc_wrapper->pair)
+              eee += sc_wrapper->pair(i, j, k, l, sc_wrapper);
 
             e = MIN2(e, eee);
 
@@ -578,7 +820,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
 
           hc_decompose = (sliding_window) ? hc_mx_local[k][l - k] : hc_mx[kl];
           if ((hc_decompose & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) &&
-              (evaluate(i, j, k, l, &hc_dat_local))) {
+              (evaluate(i, j, k, l, hc_dat_local))) {
             eee = (sliding_window) ? c_local[k][l - k] : c[kl];
 
             switch (fc->type) {
@@ -619,8 +861,8 @@ E_internal_loop(vrna_fold_compound_t  *fc,
                 break;
             }
 
-            if (sc_wrapper.pair)
-              eee += sc_wrapper.pair(i, j, k, l, &sc_wrapper);
+            if (sc_wrapper->pair)
+              eee += sc_wrapper->pair(i, j, k, l, sc_wrapper);
 
             e = MIN2(e, eee);
 
@@ -659,7 +901,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
         for (; k <= last_k; k++, u1++, kl++) {
           hc_decompose = (sliding_window) ? hc_mx_local[k][l - k] : hc_mx[kl];
           if ((hc_decompose & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) &&
-              (evaluate(i, j, k, l, &hc_dat_local))) {
+              (evaluate(i, j, k, l, hc_dat_local))) {
             eee = (sliding_window) ? c_local[k][l - k] : c[kl];
 
             switch (fc->type) {
@@ -708,8 +950,8 @@ E_internal_loop(vrna_fold_compound_t  *fc,
                 break;
             }
 
-            if (sc_wrapper.pair)
-              eee += sc_wrapper.pair(i, j, k, l, &sc_wrapper);
+            if (sc_wrapper->pair)
+              eee += sc_wrapper->pair(i, j, k, l, sc_wrapper);
 
             e = MIN2(e, eee);
 
@@ -745,7 +987,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
             if (sliding_window)
               eee = E_GQuad_IntLoop_L(i, j, type, S, ggg_local, fc->window_size, P);
             else if (sn[j] == sn[i])
-              eee = E_GQuad_IntLoop(i, j, type, S, ggg, idx, P);
+              eee = E_GQuad_IntLoop(i, j, type, S, ggg, P);
 
             e = MIN2(e, eee);
 
@@ -781,7 +1023,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
                 if (S_cons[l] != 3)
                   continue;
 
-                c0  = (sliding_window) ? ggg_local[k][l - k] : ggg[idx[l] + k];
+                c0  = (sliding_window) ? ggg_local[k][l - k] : gquad_mx_get(ggg, k, l);
                 c0  += eee +
                        n_seq *
                        P->internal_loop[u + j - l - 1];
@@ -802,7 +1044,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
                   if (S_cons[l] != 3)
                     continue;
 
-                  c0  = (sliding_window) ? ggg_local[k][l - k] : ggg[idx[l] + k];
+                  c0  = (sliding_window) ? ggg_local[k][l - k] : gquad_mx_get(ggg, k, l);
                   c0  += eee +
                          n_seq *
                          P->internal_loop[j - l - 1];
@@ -821,7 +1063,7 @@ E_internal_loop(vrna_fold_compound_t  *fc,
                 if (S_cons[k] != 3)
                   continue;
 
-                c0  = (sliding_window) ? ggg_local[k][l - k] : ggg[idx[l] + k];
+                c0  = (sliding_window) ? ggg_local[k][l - k] : gquad_mx_get(ggg, k, l);
                 c0  += eee +
                        n_seq *
                        P->internal_loop[u];
@@ -832,12 +1074,165 @@ E_internal_loop(vrna_fold_compound_t  *fc,
             break;
         }
       }
+    }
+
+    release_tt_scratch(aux, tt);
+  }
+
+  return e;
+}
+
+
+/*
+ *  Same decomposition as E_internal_loop() but for single sequences in
+ *  global (non-window) folding mode on a single strand, where neither a
+ *  hard constraint callback, nor soft constraints, nor unstructured domains
+ *  are present. The innermost loops thus only consult the hard constraint
+ *  matrix and do not require any indirect function calls
+ */
+PRIVATE int
+E_internal_loop_default(vrna_fold_compound_t        *fc,
+                        int                         i,
+                        int                         j,
+                        struct vrna_mx_mfe_aux_il_s *aux)
+{
+  unsigned char *hc_mx;
+  char          *ptype;
+  short         *S, si1, sj1;
+  unsigned int  type, type2;
+  int           e, eee, *idx, ij, kl, *c, *rtype, *hc_up, k, l, last_k, first_l, u1, u2,
+                turn, noGUclosure;
+  vrna_param_t  *P;
+  vrna_md_t     *md;
+
+  idx   = aux->idx;
+  ij    = idx[j] + i;
+  hc_mx = aux->hc_mx;
+
+  if (!(hc_mx[ij] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP))
+    return INF;
 
-      free(tt);
+  e           = INF;
+  hc_up       = aux->hc_up;
+  ptype       = aux->ptype;
+  S           = aux->S;
+  c           = aux->c;
+  P           = aux->P;
+  md          = aux->md;
+  rtype       = aux->rtype;
+  turn        = md->min_loop_size;
+  noGUclosure = md->noGUclosure;
+  type        = vrna_get_ptype(ij, ptype);
+  si1         = S[i + 1];
+  sj1         = S[j - 1];
+
+  /* handle stacks separately */
+  k = i + 1;
+  l = j - 1;
+  if (k < l) {
+    kl = idx[l] + k;
+    if ((hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) && (c[kl] != INF)) {
+      type2 = rtype[vrna_get_ptype(kl, ptype)];
+      eee   = c[kl] + E_IntLoop(0, 0, type, type2, si1, sj1, S[i], S[j], P);
+      e     = MIN2(e, eee);
     }
   }
 
-  free_sc_wrapper(&sc_wrapper);
+  /* only proceed if the enclosing pair is allowed */
+  if ((noGUclosure) && (type == 3 || type == 4))
+    return e;
+
+  /* handle bulges in 5' side */
+  l = j - 1;
+  if (l > i + 2) {
+    last_k = l - turn - 1;
+
+    if (last_k > i + 1 + MAXLOOP)
+      last_k = i + 1 + MAXLOOP;
+
+    if (last_k > i + 1 + hc_up[i + 1])
+      last_k = i + 1 + hc_up[i + 1];
+
+    u1  = 1;
+    k   = i + 2;
+    kl  = idx[l] + k;
+    for (; k <= last_k; k++, u1++, kl++) {
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+        type2 = rtype[vrna_get_ptype(kl, ptype)];
+
+        if ((noGUclosure) && (type2 == 3 || type2 == 4))
+          continue;
+
+        eee = c[kl] + E_IntLoop(u1, 0, type, type2, si1, sj1, S[k - 1], S[l + 1], P);
+        e   = MIN2(e, eee);
+      }
+    }
+  }
+
+  /* handle bulges in 3' side */
+  k = i + 1;
+  if (k < j - 2) {
+    first_l = k + turn + 1;
+    if (first_l < j - 1 - MAXLOOP)
+      first_l = j - 1 - MAXLOOP;
+
+    u2 = 1;
+    for (l = j - 2; l >= first_l; l--, u2++) {
+      if (u2 > hc_up[l + 1])
+        break;
+
+      kl = idx[l] + k;
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+        type2 = rtype[vrna_get_ptype(kl, ptype)];
+
+        if ((noGUclosure) && (type2 == 3 || type2 == 4))
+          continue;
+
+        eee = c[kl] + E_IntLoop(0, u2, type, type2, si1, sj1, S[k - 1], S[l + 1], P);
+        e   = MIN2(e, eee);
+      }
+    }
+  }
+
+  /* last but not least, all other internal loops */
+  first_l = i + 2 + turn + 1;
+  if (first_l < j - 1 - MAXLOOP)
+    first_l = j - 1 - MAXLOOP;
+
+  u2 = 1;
+  for (l = j - 2; l >= first_l; l--, u2++) {
+    if (u2 > hc_up[l + 1])
+      break;
+
+    last_k = l - turn - 1;
+
+    if (last_k > i + 1 + MAXLOOP - u2)
+      last_k = i + 1 + MAXLOOP - u2;
+
+    if (last_k > i + 1 + hc_up[i + 1])
+      last_k = i + 1 + hc_up[i + 1];
+
+    u1  = 1;
+    k   = i + 2;
+    kl  = idx[l] + k;
+    for (; k <= last_k; k++, u1++, kl++) {
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+        type2 = rtype[vrna_get_ptype(kl, ptype)];
+
+        if ((noGUclosure) && (type2 == 3 || type2 == 4))
+          continue;
+
+        eee = c[kl] + E_IntLoop(u1, u2, type, type2, si1, sj1, S[k - 1], S[l + 1], P);
+        e   = MIN2(e, eee);
+      }
+    }
+  }
+
+  if (aux->with_gquad) {
+    /* include all cases where a g-quadruplex may be enclosed by base pair (i,j) */
+    eee = E_GQuad_IntLoop(i, j, type, S, aux->ggg, P);
+    e   = MIN2(e, eee);
+  }
 
   return e;
 }
@@ -81,6 +81,50 @@ vrna_E_stack(vrna_fold_compound_t *fc,
              int                  j);
 
 
+/**
+ *  @brief  Auxiliary data for fast interior loop decomposition
+ *
+ *  Holds everything that interior loop decompositions of different pairs
+ *  @f$(i,j)@f$ have in common, i.e. the hard constraint evaluator, the soft
+ *  constraint wrapper, views into sequence encodings, pair types and DP
+ *  matrices, and per-thread scratch memory. Setting this up once before the
+ *  DP matrix fill avoids repeating the preparation for each pair.
+ *
+ *  @see vrna_E_int_loop_fast_init(), vrna_E_int_loop_fast_free(),
+ *  vrna_E_int_loop_fast()
+ */
+typedef struct vrna_mx_mfe_aux_il_s *vrna_mx_mfe_aux_il_t;
+
+
+/**
+ *  @brief  Prepare the auxiliary data for fast interior loop decomposition
+ *
+ *  The returned data refers to the DP matrices, hard and soft constraints of
+ *  @p fc. It must therefore be created after these have been set up, and
+ *  is only valid as long as they are not changed or replaced.
+ */
+vrna_mx_mfe_aux_il_t
+vrna_E_int_loop_fast_init(vrna_fold_compound_t *fc);
+
+
+/**
+ *  @brief  Evaluate all interior loops closed by @f$(i,j)@f$ using pre-computed auxiliary data
+ *
+ *  Same as vrna_E_int_loop() but without any per-call setup. This function
+ *  may be called concurrently from multiple threads of the same OpenMP team
+ *  for a single @p aux_mx.
+ */
+int
+vrna_E_int_loop_fast(vrna_fold_compound_t *fc,
+                     int                  i,
+                     int                  j,
+                     vrna_mx_mfe_aux_il_t aux_mx);
+
+
+void
+vrna_E_int_loop_fast_free(vrna_mx_mfe_aux_il_t aux_mx);
+
+
 /* End basic interface */
 /**@}*/
 
@@ -106,6 +150,30 @@ vrna_exp_E_interior_loop(vrna_fold_compound_t *fc,
                          int                  l);
 
 
+/**
+ *  @brief  Auxiliary data for fast interior loop decomposition (partition function)
+ *
+ *  @see vrna_exp_E_int_loop_fast_init(), vrna_exp_E_int_loop_fast_free(),
+ *  vrna_exp_E_int_loop_fast(), #vrna_mx_mfe_aux_il_t
+ */
+typedef struct vrna_mx_pf_aux_il_s *vrna_mx_pf_aux_il_t;
+
+
+vrna_mx_pf_aux_il_t
+vrna_exp_E_int_loop_fast_init(vrna_fold_compound_t *fc);
+
+
+FLT_OR_DBL
+vrna_exp_E_int_loop_fast(vrna_fold_compound_t *fc,
+                         int                  i,
+                         int                  j,
+                         vrna_mx_pf_aux_il_t  aux_mx);
+
+
+void
+vrna_exp_E_int_loop_fast_free(vrna_mx_pf_aux_il_t aux_mx);
+
+
 /* End partition function interface */
 /**@}*/
 
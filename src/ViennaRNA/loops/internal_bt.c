@@ -345,7 +345,7 @@ BT_int_loop(vrna_fold_compound_t  *fc,
             }
           } else {
             if (backtrack_GQuad_IntLoop_comparative(en, *i, *j, tt, fc->S_cons, fc->S5, fc->S3,
-                                                    fc->matrices->ggg, idx, &p, &q,
+                                                    fc->matrices->ggg, &p, &q,
                                                     n_seq,
                                                     P)) {
               if (vrna_BT_gquad_mfe(fc, p, q, bp_stack, stack_count)) {
@@ -18,6 +18,9 @@
 #include "ViennaRNA/unstructured_domains.h"
 #include "ViennaRNA/loops/internal.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef __GNUC__
 # define INLINE inline
@@ -28,6 +31,53 @@
 #include "internal_hc.inc"
 #include "internal_sc_pf.inc"
 
+typedef FLT_OR_DBL (decomp_il)(vrna_fold_compound_t       *fc,
+                               int                        i,
+                               int                        j,
+                               struct vrna_mx_pf_aux_il_s *aux);
+
+struct vrna_mx_pf_aux_il_s {
+  unsigned char             sliding_window;
+  unsigned char             *hc_mx;
+  unsigned char             **hc_mx_local;
+  char                      *ptype;
+  char                      **ptype_local;
+  short                     *S1;
+  short                     **SS;
+  short                     **S5;
+  short                     **S3;
+  unsigned int              *sn;
+  unsigned int              *se;
+  unsigned int              *ss;
+  unsigned int              **a2s;
+  unsigned int              n_seq;
+  int                       *my_iindx;
+  int                       *jindx;
+  int                       *hc_up;
+  int                       *rtype;
+  int                       with_ud;
+  int                       with_gquad;
+  FLT_OR_DBL                *qb;
+  FLT_OR_DBL                **qb_local;
+  vrna_gquad_mx_t           *G;
+  FLT_OR_DBL                *scale;
+  vrna_exp_param_t          *pf_params;
+  vrna_md_t                 *md;
+  vrna_ud_t                 *domains_up;
+
+  /* decomposition kernel, selected once according to the constraints present */
+  decomp_il                 *decompose;
+
+  eval_hc                   *evaluate;
+  struct default_data       hc_dat;
+  struct sc_wrapper_exp_int sc_wrapper;
+
+  /* per-thread scratch space for the pair types of (i, j) in comparative mode */
+  unsigned int              threads;
+  unsigned int              **tt;
+};
+
+
 /*
  #################################
  # PRIVATE FUNCTION DECLARATIONS #
@@ -35,9 +85,17 @@
  */
 
 PRIVATE FLT_OR_DBL
-exp_E_int_loop(vrna_fold_compound_t *fc,
-               int                  i,
-               int                  j);
+exp_E_int_loop(vrna_fold_compound_t       *fc,
+               int                        i,
+               int                        j,
+               struct vrna_mx_pf_aux_il_s *aux);
+
+
+PRIVATE FLT_OR_DBL
+exp_E_int_loop_default(vrna_fold_compound_t       *fc,
+                       int                        i,
+                       int                        j,
+                       struct vrna_mx_pf_aux_il_s *aux);
 
 
 PRIVATE FLT_OR_DBL
@@ -54,6 +112,25 @@ exp_E_interior_loop(vrna_fold_compound_t  *fc,
                     int                   l);
 
 
+PRIVATE void
+init_aux_il(vrna_fold_compound_t        *fc,
+            struct vrna_mx_pf_aux_il_s  *aux,
+            unsigned int                threads);
+
+
+PRIVATE void
+clear_aux_il(struct vrna_mx_pf_aux_il_s *aux);
+
+
+PRIVATE INLINE unsigned int *
+get_tt_scratch(struct vrna_mx_pf_aux_il_s *aux);
+
+
+PRIVATE INLINE void
+release_tt_scratch(struct vrna_mx_pf_aux_il_s *aux,
+                   unsigned int               *tt);
+
+
 /*
  #################################
  # BEGIN OF FUNCTION DEFINITIONS #
@@ -64,7 +141,8 @@ vrna_exp_E_int_loop(vrna_fold_compound_t  *fc,
                     int                   i,
                     int                   j)
 {
-  FLT_OR_DBL q = 0.;
+  FLT_OR_DBL                  q = 0.;
+  struct vrna_mx_pf_aux_il_s  aux;
 
   if ((fc) && (i > 0) && (j > 0)) {
     if (j < i) {
@@ -78,7 +156,9 @@ vrna_exp_E_int_loop(vrna_fold_compound_t  *fc,
         q = exp_E_ext_int_loop(fc, j, i);
       }
     } else {
-      q = exp_E_int_loop(fc, i, j);
+      init_aux_il(fc, &aux, 1);
+      q = aux.decompose(fc, i, j, &aux);
+      clear_aux_il(&aux);
     }
   }
 
@@ -86,6 +166,54 @@ vrna_exp_E_int_loop(vrna_fold_compound_t  *fc,
 }
 
 
+PUBLIC vrna_mx_pf_aux_il_t
+vrna_exp_E_int_loop_fast_init(vrna_fold_compound_t *fc)
+{
+  unsigned int                threads;
+  struct vrna_mx_pf_aux_il_s  *aux = NULL;
+
+  if (fc) {
+    threads = 1;
+#ifdef _OPENMP
+    threads = (unsigned int)omp_get_max_threads();
+#endif
+    aux = (struct vrna_mx_pf_aux_il_s *)vrna_alloc(sizeof(struct vrna_mx_pf_aux_il_s));
+    init_aux_il(fc, aux, threads);
+  }
+
+  return aux;
+}
+
+
+PUBLIC FLT_OR_DBL
+vrna_exp_E_int_loop_fast(vrna_fold_compound_t *fc,
+                         int                  i,
+                         int                  j,
+                         vrna_mx_pf_aux_il_t  aux_mx)
+{
+  FLT_OR_DBL q = 0.;
+
+  if ((fc) && (aux_mx) && (i > 0) && (j > 0)) {
+    if (j < i)
+      q = vrna_exp_E_int_loop(fc, i, j);
+    else
+      q = aux_mx->decompose(fc, i, j, aux_mx);
+  }
+
+  return q;
+}
+
+
+PUBLIC void
+vrna_exp_E_int_loop_fast_free(vrna_mx_pf_aux_il_t aux_mx)
+{
+  if (aux_mx) {
+    clear_aux_il(aux_mx);
+    free(aux_mx);
+  }
+}
+
+
 PUBLIC FLT_OR_DBL
 vrna_exp_E_interior_loop(vrna_fold_compound_t *fc,
                          int                  i,
@@ -100,10 +228,130 @@ vrna_exp_E_interior_loop(vrna_fold_compound_t *fc,
 }
 
 
+PRIVATE void
+init_aux_il(vrna_fold_compound_t        *fc,
+            struct vrna_mx_pf_aux_il_s  *aux,
+            unsigned int                threads)
+{
+  unsigned char sliding_window;
+  unsigned int  t;
+
+  sliding_window      = (fc->hc->type == VRNA_HC_WINDOW) ? 1 : 0;
+  aux->sliding_window = sliding_window;
+  aux->n_seq          = (fc->type == VRNA_FC_TYPE_SINGLE) ? 1 : fc->n_seq;
+  aux->sn             = fc->strand_number;
+  aux->se             = fc->strand_end;
+  aux->ss             = fc->strand_start;
+  aux->ptype          =
+    (fc->type == VRNA_FC_TYPE_SINGLE) ? (sliding_window ? NULL : fc->ptype) : NULL;
+  aux->ptype_local =
+    (fc->type == VRNA_FC_TYPE_SINGLE) ? (sliding_window ? fc->ptype_local : NULL) : NULL;
+  aux->S1           = (fc->type == VRNA_FC_TYPE_SINGLE) ? fc->sequence_encoding : NULL;
+  aux->SS           = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S;
+  aux->S5           = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S5;
+  aux->S3           = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S3;
+  aux->a2s          = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->a2s;
+  aux->qb           = (sliding_window) ? NULL : fc->exp_matrices->qb;
+  aux->G            = (sliding_window) ? NULL : fc->exp_matrices->G;
+  aux->qb_local     = (sliding_window) ? fc->exp_matrices->qb_local : NULL;
+  aux->scale        = fc->exp_matrices->scale;
+  aux->my_iindx     = fc->iindx;
+  aux->jindx        = fc->jindx;
+  aux->hc_mx        = (sliding_window) ? NULL : fc->hc->matrix;
+  aux->hc_mx_local  = (sliding_window) ? fc->hc->matrix_local : NULL;
+  aux->hc_up        = fc->hc->up_int;
+  aux->pf_params    = fc->exp_params;
+  aux->md           = &(aux->pf_params->model_details);
+  aux->with_gquad   = aux->md->gquad;
+  aux->domains_up   = fc->domains_up;
+  aux->with_ud      = ((aux->domains_up) && (aux->domains_up->exp_energy_cb)) ? 1 : 0;
+  aux->rtype        = &(aux->md->rtype[0]);
+
+  aux->evaluate = prepare_hc_default(fc, &(aux->hc_dat));
+  init_sc_wrapper(fc, &(aux->sc_wrapper));
+
+  /*
+   *  single sequences on a single strand without any hard constraint callback,
+   *  soft constraints, or unstructured domains can use a kernel that does not
+   *  need to check for any of these in its innermost loops
+   */
+  if ((fc->type == VRNA_FC_TYPE_SINGLE) &&
+      (!sliding_window) &&
+      (fc->strands == 1) &&
+      (!fc->hc->f) &&
+      (!aux->sc_wrapper.pair) &&
+      (!aux->with_ud))
+    aux->decompose = &exp_E_int_loop_default;
+  else
+    aux->decompose = &exp_E_int_loop;
+
+  aux->threads  = threads;
+  aux->tt       = NULL;
+
+  if (fc->type == VRNA_FC_TYPE_COMPARATIVE) {
+    aux->tt = (unsigned int **)vrna_alloc(sizeof(unsigned int *) * threads);
+    for (t = 0; t < threads; t++)
+      aux->tt[t] = (unsigned int *)vrna_alloc(sizeof(unsigned int) * aux->n_seq);
+  }
+}
+
+
+PRIVATE void
+clear_aux_il(struct vrna_mx_pf_aux_il_s *aux)
+{
+  unsigned int t;
+
+  free_sc_wrapper(&(aux->sc_wrapper));
+
+  if (aux->tt) {
+    for (t = 0; t < aux->threads; t++)
+      free(aux->tt[t]);
+
+    free(aux->tt);
+    aux->tt = NULL;
+  }
+}
+
+
+PRIVATE INLINE unsigned int *
+get_tt_scratch(struct vrna_mx_pf_aux_il_s *aux)
+{
+  unsigned int t = 0;
+
+#ifdef _OPENMP
+  if (aux->threads > 1)
+    t = (unsigned int)omp_get_thread_num();
+
+#endif
+
+  if (t < aux->threads)
+    return aux->tt[t];
+
+  /* more threads than anticipated, fall back to private memory */
+  return (unsigned int *)vrna_alloc(sizeof(unsigned int) * aux->n_seq);
+}
+
+
+PRIVATE INLINE void
+release_tt_scratch(struct vrna_mx_pf_aux_il_s *aux,
+                   unsigned int               *tt)
+{
+  unsigned int t;
+
+  if (tt) {
+    for (t = 0; t < aux->threads; t++)
+      if (aux->tt[t] == tt)
+        return;
+
+    free(tt);
+  }
+}
+
 PRIVATE FLT_OR_DBL
-exp_E_int_loop(vrna_fold_compound_t *fc,
-               int                  i,
-               int                  j)
+exp_E_int_loop(vrna_fold_compound_t       *fc,
+               int                        i,
+               int                        j,
+               struct vrna_mx_pf_aux_il_s *aux)
 {
   unsigned char             sliding_window, hc_decompose_ij, hc_decompose_kl;
   char                      *ptype, **ptype_local;
@@ -112,46 +360,47 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
   unsigned int              *sn, *se, *ss, n_seq, s, **a2s;
   int                       *rtype, noclose, *my_iindx, *jindx, *hc_up, ij,
                             with_gquad, with_ud;
-  FLT_OR_DBL                qbt1, q_temp, *qb, **qb_local, *G, *scale;
+  FLT_OR_DBL                qbt1, q_temp, *qb, **qb_local, *scale;
+  vrna_gquad_mx_t           *G;
   vrna_exp_param_t          *pf_params;
   vrna_md_t                 *md;
   vrna_ud_t                 *domains_up;
   eval_hc                   *evaluate;
-  struct  default_data      hc_dat_local;
-  struct sc_wrapper_exp_int sc_wrapper;
-
-  sliding_window  = (fc->hc->type == VRNA_HC_WINDOW) ? 1 : 0;
-  n_seq           = (fc->type == VRNA_FC_TYPE_SINGLE) ? 1 : fc->n_seq;
-  sn              = fc->strand_number;
-  se              = fc->strand_end;
-  ss              = fc->strand_start;
-  ptype           = (fc->type == VRNA_FC_TYPE_SINGLE) ? (sliding_window ? NULL : fc->ptype) : NULL;
-  ptype_local     =
-    (fc->type == VRNA_FC_TYPE_SINGLE) ? (sliding_window ? fc->ptype_local : NULL) : NULL;
-  S1          = (fc->type == VRNA_FC_TYPE_SINGLE) ? fc->sequence_encoding : NULL;
-  SS          = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S;
-  S5          = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S5;
-  S3          = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->S3;
-  a2s         = (fc->type == VRNA_FC_TYPE_SINGLE) ? NULL : fc->a2s;
-  qb          = (sliding_window) ? NULL : fc->exp_matrices->qb;
-  G           = (sliding_window) ? NULL : fc->exp_matrices->G;
-  qb_local    = (sliding_window) ? fc->exp_matrices->qb_local : NULL;
-  scale       = fc->exp_matrices->scale;
-  my_iindx    = fc->iindx;
-  jindx       = fc->jindx;
-  hc_mx       = (sliding_window) ? NULL : fc->hc->matrix;
-  hc_mx_local = (sliding_window) ? fc->hc->matrix_local : NULL;
-  hc_up       = fc->hc->up_int;
-  pf_params   = fc->exp_params;
-  md          = &(pf_params->model_details);
-  with_gquad  = md->gquad;
-  domains_up  = fc->domains_up;
-  with_ud     = ((domains_up) && (domains_up->exp_energy_cb)) ? 1 : 0;
-  rtype       = &(md->rtype[0]);
-  qbt1        = 0.;
-  evaluate    = prepare_hc_default(fc, &hc_dat_local);
-
-  init_sc_wrapper(fc, &sc_wrapper);
+  struct  default_data      *hc_dat_local;
+  struct sc_wrapper_exp_int *sc_wrapper;
+
+  /* everything that does not depend on (i, j) has been set up in the auxiliary data already */
+  sliding_window  = aux->sliding_window;
+  n_seq           = aux->n_seq;
+  sn              = aux->sn;
+  se              = aux->se;
+  ss              = aux->ss;
+  ptype           = aux->ptype;
+  ptype_local     = aux->ptype_local;
+  S1              = aux->S1;
+  SS              = aux->SS;
+  S5              = aux->S5;
+  S3              = aux->S3;
+  a2s             = aux->a2s;
+  qb              = aux->qb;
+  G               = aux->G;
+  qb_local        = aux->qb_local;
+  scale           = aux->scale;
+  my_iindx        = aux->my_iindx;
+  jindx           = aux->jindx;
+  hc_mx           = aux->hc_mx;
+  hc_mx_local     = aux->hc_mx_local;
+  hc_up           = aux->hc_up;
+  pf_params       = aux->pf_params;
+  md              = aux->md;
+  with_gquad      = aux->with_gquad;
+  domains_up      = aux->domains_up;
+  with_ud         = aux->with_ud;
+  rtype           = aux->rtype;
+  qbt1            = 0.;
+  evaluate        = aux->evaluate;
+  hc_dat_local    = &(aux->hc_dat);
+  sc_wrapper      = &(aux->sc_wrapper);
 
   ij = (sliding_window) ? 0 : jindx[j] + i;
 
@@ -175,7 +424,7 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
     noclose = ((noGUclosure) && (type == 3 || type == 4)) ? 1 : 0;
 
     if (fc->type == VRNA_FC_TYPE_COMPARATIVE) {
-      tt = (unsigned int *)vrna_alloc(sizeof(unsigned int) * n_seq);
+      tt = get_tt_scratch(aux);
       for (s = 0; s < n_seq; s++)
         tt[s] = vrna_get_ptype_md(SS[s][i], SS[s][j], md);
     }
@@ -187,7 +436,7 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
       kl              = (sliding_window) ? 0 : jindx[l] + k;
       hc_decompose_kl = (sliding_window) ? hc_mx_local[k][l - k] : hc_mx[kl];
       if ((hc_decompose_kl & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) &&
-          (evaluate(i, j, k, l, &hc_dat_local))) {
+          (evaluate(i, j, k, l, hc_dat_local))) {
         q_temp = (sliding_window) ? qb_local[k][l] : qb[my_iindx[k] - l];
 
         switch (fc->type) {
@@ -224,8 +473,8 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
             break;
         }
 
-        if (sc_wrapper.pair)
-          q_temp *= sc_wrapper.pair(i, j, k, l, &sc_wrapper);
+        if (sc_wrapper->pair)
+          q_temp *= sc_wrapper->pair(i, j, k, l, sc_wrapper);
 
         qbt1 += q_temp *
                 scale[2];
@@ -256,7 +505,7 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
         for (; k <= last_k; k++, u1++, kl++) {
           hc_decompose_kl = (sliding_window) ? hc_mx_local[k][l - k] : hc_mx[kl];
           if ((hc_decompose_kl & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) &&
-              (evaluate(i, j, k, l, &hc_dat_local))) {
+              (evaluate(i, j, k, l, hc_dat_local))) {
             q_temp = (sliding_window) ? qb_local[k][l] : qb[my_iindx[k] - l];
 
             switch (fc->type) {
@@ -297,8 +546,8 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
                 break;
             }
 
-            if (sc_wrapper.pair)
-              q_temp *= sc_wrapper.pair(i, j, k, l, &sc_wrapper);
+            if (sc_wrapper->pair)
+              q_temp *= sc_wrapper->pair(i, j, k, l, sc_wrapper);
 
             qbt1 += q_temp *
                     scale[u1 + 2];
@@ -334,7 +583,7 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
 
           hc_decompose_kl = (sliding_window) ? hc_mx_local[k][l - k] : hc_mx[kl];
           if ((hc_decompose_kl & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) &&
-              (evaluate(i, j, k, l, &hc_dat_local))) {
+              (evaluate(i, j, k, l, hc_dat_local))) {
             q_temp = (sliding_window) ? qb_local[k][l] : qb[my_iindx[k] - l];
 
             switch (fc->type) {
@@ -375,8 +624,8 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
                 break;
             }
 
-            if (sc_wrapper.pair)
-              q_temp *= sc_wrapper.pair(i, j, k, l, &sc_wrapper);
+            if (sc_wrapper->pair)
+              q_temp *= sc_wrapper->pair(i, j, k, l, sc_wrapper);
 
             qbt1 += q_temp *
                     scale[u2 + 2];
@@ -425,7 +674,7 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
           kl              = (sliding_window) ? 0 : jindx[l] + k;
           hc_decompose_kl = (sliding_window) ? hc_mx_local[k][l - k] : hc_mx[kl];
           if ((hc_decompose_kl & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) &&
-              (evaluate(i, j, k, l, &hc_dat_local))) {
+              (evaluate(i, j, k, l, hc_dat_local))) {
             q_temp = (sliding_window) ? qb_local[k][l] : qb[my_iindx[k] - l];
 
             switch (fc->type) {
@@ -468,8 +717,8 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
                 break;
             }
 
-            if (sc_wrapper.pair)
-              q_temp *= sc_wrapper.pair(i, j, k, l, &sc_wrapper);
+            if (sc_wrapper->pair)
+              q_temp *= sc_wrapper->pair(i, j, k, l, sc_wrapper);
 
             qbt1 += q_temp *
                     scale[u1 + u2 + 2];
@@ -508,7 +757,7 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
               if (sliding_window) {
                 /* no G-Quadruplex support for sliding window partition function yet! */
               } else if (sn[j] == sn[i]) {
-                qbt1 += exp_E_GQuad_IntLoop(i, j, type, S1, G, scale, my_iindx, pf_params);
+                qbt1 += exp_E_GQuad_IntLoop(i, j, type, S1, G, scale, pf_params);
               }
             }
 
@@ -521,10 +770,173 @@ exp_E_int_loop(vrna_fold_compound_t *fc,
       }
     }
 
-    free(tt);
+    release_tt_scratch(aux, tt);
   }
 
-  free_sc_wrapper(&sc_wrapper);
+  return qbt1;
+}
+
+
+/*
+ *  Same decomposition as exp_E_int_loop() but for single sequences in
+ *  global (non-window) mode on a single strand, where neither a hard
+ *  constraint callback, nor soft constraints, nor unstructured domains
+ *  are present. The innermost loops thus only consult the hard constraint
+ *  matrix and do not require any indirect function calls
+ */
+PRIVATE FLT_OR_DBL
+exp_E_int_loop_default(vrna_fold_compound_t       *fc,
+                       int                        i,
+                       int                        j,
+                       struct vrna_mx_pf_aux_il_s *aux)
+{
+  unsigned char     *hc_mx;
+  char              *ptype;
+  short             *S1, si1, sj1;
+  unsigned int      type, type2;
+  int               *rtype, *my_iindx, *jindx, *hc_up, ij, k, l, kl, last_k, first_l, u1, u2,
+                    turn, noGUclosure;
+  FLT_OR_DBL        qbt1, q_temp, *qb, *scale;
+  vrna_exp_param_t  *pf_params;
+  vrna_md_t         *md;
+
+  jindx = aux->jindx;
+  ij    = jindx[j] + i;
+  hc_mx = aux->hc_mx;
+
+  if (!(hc_mx[ij] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP))
+    return 0.;
+
+  qbt1        = 0.;
+  ptype       = aux->ptype;
+  S1          = aux->S1;
+  qb          = aux->qb;
+  scale       = aux->scale;
+  my_iindx    = aux->my_iindx;
+  hc_up       = aux->hc_up;
+  pf_params   = aux->pf_params;
+  md          = aux->md;
+  rtype       = aux->rtype;
+  turn        = md->min_loop_size;
+  noGUclosure = md->noGUclosure;
+  type        = vrna_get_ptype(ij, ptype);
+  si1         = S1[i + 1];
+  sj1         = S1[j - 1];
+
+  /* handle stacks separately */
+  k = i + 1;
+  l = j - 1;
+  if (k < l) {
+    kl = jindx[l] + k;
+    if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+      type2   = rtype[vrna_get_ptype(kl, ptype)];
+      q_temp  = qb[my_iindx[k] - l] *
+                exp_E_IntLoop(0, 0, type, type2, si1, sj1, S1[k - 1], S1[l + 1], pf_params);
+      qbt1 += q_temp *
+              scale[2];
+    }
+  }
+
+  /* only proceed if the enclosing pair is allowed */
+  if ((noGUclosure) && (type == 3 || type == 4))
+    return qbt1;
+
+  /* handle bulges in 5' side */
+  l = j - 1;
+  if (l > i + 2) {
+    last_k = l - turn - 1;
+
+    if (last_k > i + 1 + MAXLOOP)
+      last_k = i + 1 + MAXLOOP;
+
+    if (last_k > i + 1 + hc_up[i + 1])
+      last_k = i + 1 + hc_up[i + 1];
+
+    u1  = 1;
+    k   = i + 2;
+    kl  = jindx[l] + k;
+    for (; k <= last_k; k++, u1++, kl++) {
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+        type2 = rtype[vrna_get_ptype(kl, ptype)];
+
+        if ((noGUclosure) && (type2 == 3 || type2 == 4))
+          continue;
+
+        q_temp = qb[my_iindx[k] - l] *
+                 exp_E_IntLoop(u1, 0, type, type2, si1, sj1, S1[k - 1], S1[l + 1], pf_params);
+        qbt1 += q_temp *
+                scale[u1 + 2];
+      }
+    }
+  }
+
+  /* handle bulges in 3' side */
+  k = i + 1;
+  if (k < j - 2) {
+    first_l = k + turn + 1;
+    if (first_l < j - 1 - MAXLOOP)
+      first_l = j - 1 - MAXLOOP;
+
+    u2 = 1;
+    for (l = j - 2; l >= first_l; l--, u2++) {
+      if (u2 > hc_up[l + 1])
+        break;
+
+      kl = jindx[l] + k;
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+        type2 = rtype[vrna_get_ptype(kl, ptype)];
+
+        if ((noGUclosure) && (type2 == 3 || type2 == 4))
+          continue;
+
+        q_temp = qb[my_iindx[k] - l] *
+                 exp_E_IntLoop(0, u2, type, type2, si1, sj1, S1[k - 1], S1[l + 1], pf_params);
+        qbt1 += q_temp *
+                scale[u2 + 2];
+      }
+    }
+  }
+
+  /* last but not least, all other internal loops */
+  last_k = j - turn - 3;
+
+  if (last_k > i + MAXLOOP + 1)
+    last_k = i + MAXLOOP + 1;
+
+  if (last_k > i + 1 + hc_up[i + 1])
+    last_k = i + 1 + hc_up[i + 1];
+
+  u1 = 1;
+
+  for (k = i + 2; k <= last_k; k++, u1++) {
+    first_l = k + turn + 1;
+
+    if (first_l < j - 1 - MAXLOOP + u1)
+      first_l = j - 1 - MAXLOOP + u1;
+
+    u2 = 1;
+
+    for (l = j - 2; l >= first_l; l--, u2++) {
+      if (hc_up[l + 1] < u2)
+        break;
+
+      kl = jindx[l] + k;
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+        type2 = rtype[vrna_get_ptype(kl, ptype)];
+
+        if ((noGUclosure) && (type2 == 3 || type2 == 4))
+          continue;
+
+        q_temp = qb[my_iindx[k] - l] *
+                 exp_E_IntLoop(u1, u2, type, type2, si1, sj1, S1[k - 1], S1[l + 1], pf_params);
+        qbt1 += q_temp *
+                scale[u1 + u2 + 2];
+      }
+    }
+  }
+
+  if (aux->with_gquad)
+    qbt1 += exp_E_GQuad_IntLoop(i, j, type, S1, aux->G, scale, pf_params);
 
   return qbt1;
 }
@@ -9,6 +9,7 @@
 #include <ctype.h>
 #include <string.h>
 #include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/utils/higher_order_functions.h"
 #include "ViennaRNA/fold_vars.h"
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/params/default.h"
@@ -20,6 +21,10 @@
 #include "ViennaRNA/unstructured_domains.h"
 #include "ViennaRNA/loops/multibranch.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef __GNUC__
 # define INLINE inline
 #else
@@ -29,6 +34,16 @@
 #include "multibranch_hc.inc"
 #include "multibranch_sc.inc"
 
+struct vrna_mx_mfe_aux_ml_s {
+  vrna_callback_hc_evaluate *evaluate;
+  struct default_data       hc_dat;
+  struct sc_wrapper_ml      sc_wrapper;
+
+  /* per-thread scratch rows for fmi with hard/soft constraints applied */
+  unsigned int              threads;
+  int                       **fmi;
+};
+
 /*
  #################################
  # PRIVATE FUNCTION DECLARATIONS #
@@ -36,19 +51,43 @@
  */
 
 PRIVATE int
-E_mb_loop_fast(vrna_fold_compound_t *fc,
-               int                  i,
-               int                  j,
-               int                  *dmli1,
-               int                  *dmli2);
+E_mb_loop_fast(vrna_fold_compound_t         *fc,
+               int                          i,
+               int                          j,
+               int                          *dmli1,
+               int                          *dmli2,
+               struct vrna_mx_mfe_aux_ml_s  *aux);
 
 
 PRIVATE int
-E_ml_stems_fast(vrna_fold_compound_t  *fc,
-                int                   i,
-                int                   j,
-                int                   *fmi,
-                int                   *dmli);
+E_ml_stems_fast(vrna_fold_compound_t        *fc,
+                int                         i,
+                int                         j,
+                int                         *fmi,
+                int                         *dmli,
+                struct vrna_mx_mfe_aux_ml_s *aux);
+
+
+PRIVATE void
+init_aux_ml(vrna_fold_compound_t        *fc,
+            struct vrna_mx_mfe_aux_ml_s *aux,
+            unsigned int                threads);
+
+
+PRIVATE void
+clear_aux_ml(struct vrna_mx_mfe_aux_ml_s *aux);
+
+
+PRIVATE INLINE int *
+get_fmi_scratch(struct vrna_mx_mfe_aux_ml_s *aux,
+                int                         i,
+                int                         j);
+
+
+PRIVATE INLINE void
+release_fmi_scratch(struct vrna_mx_mfe_aux_ml_s *aux,
+                    int                         *fmi,
+                    int                         i);
 
 
 PRIVATE int
@@ -110,10 +149,14 @@ vrna_E_mb_loop_fast(vrna_fold_compound_t  *fc,
                     int                   *dmli1,
                     int                   *dmli2)
 {
-  int e = INF;
+  int                         e = INF;
+  struct vrna_mx_mfe_aux_ml_s aux;
 
-  if (fc)
-    e = E_mb_loop_fast(fc, i, j, dmli1, dmli2);
+  if (fc) {
+    init_aux_ml(fc, &aux, 0);
+    e = E_mb_loop_fast(fc, i, j, dmli1, dmli2, &aux);
+    clear_aux_ml(&aux);
+  }
 
   return e;
 }
@@ -125,16 +168,83 @@ vrna_E_ml_stems_fast(vrna_fold_compound_t *fc,
                      int                  j,
                      int                  *fmi,
                      int                  *dmli)
+{
+  int                         e = INF;
+  struct vrna_mx_mfe_aux_ml_s aux;
+
+  if (fc) {
+    init_aux_ml(fc, &aux, 0);
+    e = E_ml_stems_fast(fc, i, j, fmi, dmli, &aux);
+    clear_aux_ml(&aux);
+  }
+
+  return e;
+}
+
+
+PUBLIC vrna_mx_mfe_aux_ml_t
+vrna_E_ml_fast_init(vrna_fold_compound_t *fc)
+{
+  unsigned int                threads;
+  struct vrna_mx_mfe_aux_ml_s *aux = NULL;
+
+  if (fc) {
+    threads = 1;
+#ifdef _OPENMP
+    threads = (unsigned int)omp_get_max_threads();
+#endif
+    aux = (struct vrna_mx_mfe_aux_ml_s *)vrna_alloc(sizeof(struct vrna_mx_mfe_aux_ml_s));
+    init_aux_ml(fc, aux, threads);
+  }
+
+  return aux;
+}
+
+
+PUBLIC int
+vrna_E_mb_loop_fast_aux(vrna_fold_compound_t  *fc,
+                        int                   i,
+                        int                   j,
+                        int                   *dmli1,
+                        int                   *dmli2,
+                        vrna_mx_mfe_aux_ml_t  aux_mx)
 {
   int e = INF;
 
-  if (fc)
-    e = E_ml_stems_fast(fc, i, j, fmi, dmli);
+  if ((fc) && (aux_mx))
+    e = E_mb_loop_fast(fc, i, j, dmli1, dmli2, aux_mx);
 
   return e;
 }
 
 
+PUBLIC int
+vrna_E_ml_stems_fast_aux(vrna_fold_compound_t *fc,
+                         int                  i,
+                         int                  j,
+                         int                  *fmi,
+                         int                  *dmli,
+                         vrna_mx_mfe_aux_ml_t aux_mx)
+{
+  int e = INF;
+
+  if ((fc) && (aux_mx))
+    e = E_ml_stems_fast(fc, i, j, fmi, dmli, aux_mx);
+
+  return e;
+}
+
+
+PUBLIC void
+vrna_E_ml_fast_free(vrna_mx_mfe_aux_ml_t aux_mx)
+{
+  if (aux_mx) {
+    clear_aux_ml(aux_mx);
+    free(aux_mx);
+  }
+}
+
+
 PUBLIC int
 vrna_E_mb_loop_stack(vrna_fold_compound_t *fc,
                      int                  i,
@@ -175,11 +285,112 @@ E_ml_rightmost_stem(int                   i,
 }
 
 
+PUBLIC int
+vrna_E_ml_rightmost_stem_aux(vrna_fold_compound_t *fc,
+                             int                  i,
+                             int                  j,
+                             vrna_mx_mfe_aux_ml_t aux_mx)
+{
+  int e = INF;
+
+  if ((fc) && (fc->matrices) && (fc->matrices->fM1) && (aux_mx))
+    e = extend_fm_3p(i,
+                     j,
+                     fc->matrices->fM1,
+                     fc,
+                     aux_mx->evaluate,
+                     &(aux_mx->hc_dat),
+                     &(aux_mx->sc_wrapper));
+
+  return e;
+}
+
+
 /*
  #####################################
  # BEGIN OF STATIC HELPER FUNCTIONS  #
  #####################################
  */
+PRIVATE void
+init_aux_ml(vrna_fold_compound_t        *fc,
+            struct vrna_mx_mfe_aux_ml_s *aux,
+            unsigned int                threads)
+{
+  unsigned int t;
+
+  aux->evaluate = prepare_hc_default(fc, &(aux->hc_dat));
+  init_sc_wrapper(fc, &(aux->sc_wrapper));
+
+  aux->threads  = 0;
+  aux->fmi      = NULL;
+
+  /* scratch rows are only required if decompositions are masked or modified */
+  if ((threads > 0) &&
+      ((fc->hc->f) || (aux->sc_wrapper.decomp_ml))) {
+    aux->threads  = threads;
+    aux->fmi      = (int **)vrna_alloc(sizeof(int *) * threads);
+    for (t = 0; t < threads; t++)
+      aux->fmi[t] = (int *)vrna_alloc(sizeof(int) * (fc->length + 2));
+  }
+}
+
+
+PRIVATE void
+clear_aux_ml(struct vrna_mx_mfe_aux_ml_s *aux)
+{
+  unsigned int t;
+
+  free_sc_wrapper(&(aux->sc_wrapper));
+
+  if (aux->fmi) {
+    for (t = 0; t < aux->threads; t++)
+      free(aux->fmi[t]);
+
+    free(aux->fmi);
+    aux->fmi = NULL;
+  }
+}
+
+
+PRIVATE INLINE int *
+get_fmi_scratch(struct vrna_mx_mfe_aux_ml_s *aux,
+                int                         i,
+                int                         j)
+{
+  unsigned int  t = 0;
+  int           *fmi;
+
+#ifdef _OPENMP
+  if (aux->threads > 1)
+    t = (unsigned int)omp_get_thread_num();
+
+#endif
+
+  if (t < aux->threads)
+    return aux->fmi[t];
+
+  /* no scratch rows or more threads than anticipated, fall back to private memory */
+  fmi = (int *)vrna_alloc(sizeof(int) * (j - i + 2));
+
+  return fmi - i;
+}
+
+
+PRIVATE INLINE void
+release_fmi_scratch(struct vrna_mx_mfe_aux_ml_s *aux,
+                    int                         *fmi,
+                    int                         i)
+{
+  unsigned int t;
+
+  for (t = 0; t < aux->threads; t++)
+    if (aux->fmi[t] == fmi)
+      return;
+
+  free(fmi + i);
+}
+
+
 PRIVATE INLINE int
 ml_pair_d0(vrna_fold_compound_t       *fc,
            int                        i,
@@ -629,19 +840,20 @@ E_mb_loop_fake(vrna_fold_compound_t *fc,
 
 
 PRIVATE int
-E_mb_loop_fast(vrna_fold_compound_t *fc,
-               int                  i,
-               int                  j,
-               int                  *dmli1,
-               int                  *dmli2)
+E_mb_loop_fast(vrna_fold_compound_t         *fc,
+               int                          i,
+               int                          j,
+               int                          *dmli1,
+               int                          *dmli2,
+               struct vrna_mx_mfe_aux_ml_s  *aux)
 {
   unsigned int              *sn;
   int                       decomp, e, dangle_model;
   vrna_param_t              *P;
   vrna_md_t                 *md;
   vrna_callback_hc_evaluate *evaluate;
-  struct default_data       hc_dat_local;
-  struct sc_wrapper_ml      sc_wrapper;
+  struct default_data       *hc_dat_local;
+  struct sc_wrapper_ml      *sc_wrapper;
 
   sn            = fc->strand_number;
   P             = fc->params;
@@ -649,12 +861,11 @@ E_mb_loop_fast(vrna_fold_compound_t *fc,
   dangle_model  = md->dangles;
 
   /* init values */
-  e       = INF;
-  decomp  = INF;
-
-  evaluate = prepare_hc_default(fc, &hc_dat_local);
-
-  init_sc_wrapper(fc, &sc_wrapper);
+  e             = INF;
+  decomp        = INF;
+  evaluate      = aux->evaluate;
+  hc_dat_local  = &(aux->hc_dat);
+  sc_wrapper    = &(aux->sc_wrapper);
 
   /* do pointer magic for sliding window implementation */
   if (fc->hc->type == VRNA_HC_WINDOW) {
@@ -666,22 +877,20 @@ E_mb_loop_fast(vrna_fold_compound_t *fc,
   switch (dangle_model) {
     /* no dangles */
     case 0:
-      decomp = ml_pair_d0(fc, i, j, dmli1, evaluate, &hc_dat_local, &sc_wrapper);
+      decomp = ml_pair_d0(fc, i, j, dmli1, evaluate, hc_dat_local, sc_wrapper);
       break;
 
     /* double dangles */
     case 2:
-      decomp = ml_pair_d2(fc, i, j, dmli1, evaluate, &hc_dat_local, &sc_wrapper);
+      decomp = ml_pair_d2(fc, i, j, dmli1, evaluate, hc_dat_local, sc_wrapper);
       break;
 
     /* normal dangles, aka dangles = 1 || 3 */
     default:
-      decomp = ml_pair_d1(fc, i, j, dmli1, dmli2, evaluate, &hc_dat_local, &sc_wrapper);
+      decomp = ml_pair_d1(fc, i, j, dmli1, dmli2, evaluate, hc_dat_local, sc_wrapper);
       break;
   }
 
-  free_sc_wrapper(&sc_wrapper);
-
   e = MIN2(e, decomp);
 
   /* add additional cases for possible strand nicks between i and j */
@@ -890,13 +1099,14 @@ extend_fm_3p(int                        i,
              struct default_data        *hc_dat_local,
              struct sc_wrapper_ml       *sc_wrapper)
 {
-  short         *S, **SS, **S5, **S3;
-  unsigned int  *sn, n_seq, s, sliding_window;
-  int           en, en2, length, *indx, *c, **c_local, **fm_local, *ggg, **ggg_local, ij, type,
-                dangle_model, with_gquad, e, u, k, cnt, with_ud;
-  vrna_param_t  *P;
-  vrna_md_t     *md;
-  vrna_ud_t     *domains_up;
+  short           *S, **SS, **S5, **S3;
+  unsigned int    *sn, n_seq, s, sliding_window;
+  int             en, en2, length, *indx, *c, **c_local, **fm_local, **ggg_local, ij, type,
+                  dangle_model, with_gquad, e, u, k, cnt, with_ud;
+  vrna_gquad_mx_t *ggg;
+  vrna_param_t    *P;
+  vrna_md_t       *md;
+  vrna_ud_t       *domains_up;
 
   sliding_window  = (fc->hc->type == VRNA_HC_WINDOW) ? 1 : 0;
   n_seq           = (fc->type == VRNA_FC_TYPE_SINGLE) ? 1 : fc->n_seq;
@@ -968,7 +1178,7 @@ extend_fm_3p(int                        i,
 
   if (with_gquad) {
     if (sn[i] == sn[j]) {
-      en  = (sliding_window) ? ggg_local[i][j - i] : ggg[ij];
+      en  = (sliding_window) ? ggg_local[i][j - i] : gquad_mx_get(ggg, i, j);
       en  += E_MLstem(0, -1, -1, P) *
              n_seq;
 
@@ -1021,35 +1231,13 @@ extend_fm_3p(int                        i,
 }
 
 
-#ifdef VRNA_WITH_SSE_IMPLEMENTATION
-#include <emmintrin.h>
-#include <smmintrin.h>
-
-/*
- *  SSE minimum
- *  see also: http://stackoverflow.com/questions/9877700/getting-max-value-in-a-m128i-vector-with-sse
- */
-int
-horizontal_min_Vec4i(__m128i x)
-{
-  __m128i min1  = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 0, 3, 2));
-  __m128i min2  = _mm_min_epi32(x, min1);
-  __m128i min3  = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0, 0, 0, 1));
-  __m128i min4  = _mm_min_epi32(min2, min3);
-
-  return _mm_cvtsi128_si32(min4);
-}
-
-
-#endif
-
-
 PRIVATE int
-E_ml_stems_fast(vrna_fold_compound_t  *fc,
-                int                   i,
-                int                   j,
-                int                   *fmi,
-                int                   *dmli)
+E_ml_stems_fast(vrna_fold_compound_t        *fc,
+                int                         i,
+                int                         j,
+                int                         *fmi,
+                int                         *dmli,
+                struct vrna_mx_mfe_aux_ml_s *aux)
 {
   char                      *ptype, **ptype_local;
   short                     *S, **SS, **S5, **S3;
@@ -1063,8 +1251,8 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
   vrna_md_t                 *md;
   vrna_ud_t                 *domains_up;
   vrna_callback_hc_evaluate *evaluate;
-  struct default_data       hc_dat_local;
-  struct sc_wrapper_ml      sc_wrapper;
+  struct default_data       *hc_dat_local;
+  struct sc_wrapper_ml      *sc_wrapper;
 
   sliding_window = (fc->hc->type == VRNA_HC_WINDOW) ? 1 : 0;
 
@@ -1096,29 +1284,29 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
   domains_up    = fc->domains_up;
   with_ud       = (domains_up && domains_up->energy_cb) ? 1 : 0;
   e             = INF;
-  evaluate      = prepare_hc_default(fc, &hc_dat_local);
-
-  init_sc_wrapper(fc, &sc_wrapper);
+  evaluate      = aux->evaluate;
+  hc_dat_local  = &(aux->hc_dat);
+  sc_wrapper    = &(aux->sc_wrapper);
 
   /*
    *  extension with one unpaired nucleotide at the right (3' site)
    *  or full branch of (i,j)
    */
-  e = extend_fm_3p(i, j, NULL, fc, evaluate, &hc_dat_local, &sc_wrapper);
+  e = extend_fm_3p(i, j, NULL, fc, evaluate, hc_dat_local, sc_wrapper);
 
   /*
    *  extension with one unpaired nucleotide at 5' site
    *  and all other variants which are needed for odd
    *  dangle models
    */
-  if (evaluate(i, j, i + 1, j, VRNA_DECOMP_ML_ML, &hc_dat_local)) {
+  if (evaluate(i, j, i + 1, j, VRNA_DECOMP_ML_ML, hc_dat_local)) {
     en = (sliding_window) ? fm_local[i + 1][j - i - 1] : fm[ij + 1];
     if (en != INF) {
       en += P->MLbase *
             n_seq;
 
-      if (sc_wrapper.red_ml)
-        en += sc_wrapper.red_ml(i, j, i + 1, j, &sc_wrapper);
+      if (sc_wrapper->red_ml)
+        en += sc_wrapper->red_ml(i, j, i + 1, j, sc_wrapper);
 
       e = MIN2(e, en);
     }
@@ -1129,7 +1317,7 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
     for (cnt = 0; cnt < domains_up->uniq_motif_count; cnt++) {
       u = domains_up->uniq_motif_size[cnt];
       k = i + u - 1;
-      if ((k < j) && (evaluate(i, j, k + 1, j, VRNA_DECOMP_ML_ML, &hc_dat_local))) {
+      if ((k < j) && (evaluate(i, j, k + 1, j, VRNA_DECOMP_ML_ML, hc_dat_local))) {
         decomp = (sliding_window) ? fm_local[i + u][j - (i + u)] : fm[ij + u];
         if (decomp != INF) {
           decomp += u * P->MLbase *
@@ -1143,8 +1331,8 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
           if (en != INF) {
             decomp += en;
 
-            if (sc_wrapper.red_ml)
-              decomp += sc_wrapper.red_ml(i, j, k + 1, j, &sc_wrapper);
+            if (sc_wrapper->red_ml)
+              decomp += sc_wrapper->red_ml(i, j, k + 1, j, sc_wrapper);
 
             e = MIN2(e, decomp);
           }
@@ -1165,7 +1353,7 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
         mm3 = S[j];
     }
 
-    if (evaluate(i, j, i + 1, j, VRNA_DECOMP_ML_STEM, &hc_dat_local)) {
+    if (evaluate(i, j, i + 1, j, VRNA_DECOMP_ML_STEM, hc_dat_local)) {
       en = (sliding_window) ? c_local[i + 1][j - (i + 1)] : c[ij + 1];
       if (en != INF) {
         en += P->MLbase *
@@ -1188,14 +1376,14 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
             break;
         }
 
-        if (sc_wrapper.red_ml)
-          en += sc_wrapper.red_ml(i, j, i + 1, j, &sc_wrapper);
+        if (sc_wrapper->red_ml)
+          en += sc_wrapper->red_ml(i, j, i + 1, j, sc_wrapper);
 
         e = MIN2(e, en);
       }
     }
 
-    if (evaluate(i, j, i, j - 1, VRNA_DECOMP_ML_STEM, &hc_dat_local)) {
+    if (evaluate(i, j, i, j - 1, VRNA_DECOMP_ML_STEM, hc_dat_local)) {
       en = (sliding_window) ? c_local[i][j - 1 - i] : c[indx[j - 1] + i];
       if (en != INF) {
         en += P->MLbase *
@@ -1219,14 +1407,14 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
             break;
         }
 
-        if (sc_wrapper.red_ml)
-          en += sc_wrapper.red_ml(i, j, i, j - 1, &sc_wrapper);
+        if (sc_wrapper->red_ml)
+          en += sc_wrapper->red_ml(i, j, i, j - 1, sc_wrapper);
 
         e = MIN2(e, en);
       }
     }
 
-    if (evaluate(i, j, i + 1, j - 1, VRNA_DECOMP_ML_STEM, &hc_dat_local)) {
+    if (evaluate(i, j, i + 1, j - 1, VRNA_DECOMP_ML_STEM, hc_dat_local)) {
       en = (sliding_window) ? c_local[i + 1][j - 1 - (i + 1)] : c[indx[j - 1] + i + 1];
       if (en != INF) {
         en += 2 * P->MLbase *
@@ -1250,8 +1438,8 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
             break;
         }
 
-        if (sc_wrapper.red_ml)
-          en += sc_wrapper.red_ml(i, j, i + 1, j - 1, &sc_wrapper);
+        if (sc_wrapper->red_ml)
+          en += sc_wrapper->red_ml(i, j, i + 1, j - 1, sc_wrapper);
 
         e = MIN2(e, en);
       }
@@ -1268,8 +1456,7 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
   int *fmi_tmp = fmi;
 
   if (hc->f) {
-    fmi_tmp = (int *)vrna_alloc(sizeof(int) * (j - i + 2));
-    fmi_tmp -= i;
+    fmi_tmp = get_fmi_scratch(aux, i, j);
 
     /* copy data */
     for (k = i + 1 + turn; k <= j - 2 - turn; k++)
@@ -1281,10 +1468,9 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
         fmi_tmp[k] = INF;
   }
 
-  if (sc_wrapper.decomp_ml) {
+  if (sc_wrapper->decomp_ml) {
     if (fmi_tmp == fmi) {
-      fmi_tmp = (int *)vrna_alloc(sizeof(int) * (j - i + 2));
-      fmi_tmp -= i;
+      fmi_tmp = get_fmi_scratch(aux, i, j);
 
       /* copy data */
       for (k = i + 1 + turn; k <= j - 2 - turn; k++)
@@ -1293,7 +1479,7 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
 
     for (k = i + 1 + turn; k <= j - 2 - turn; k++)
       if (fmi_tmp[k] != INF)
-        fmi_tmp[k] += sc_wrapper.decomp_ml(i, j, k, k + 1, &sc_wrapper);
+        fmi_tmp[k] += sc_wrapper->decomp_ml(i, j, k, k + 1, sc_wrapper);
   }
 
   /* modular decomposition -------------------------------*/
@@ -1325,41 +1511,16 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
       if (last_nt < i)
         last_nt = i; /* do not start before i */
 
-      const int stop = last_nt;
-#ifdef VRNA_WITH_SSE_IMPLEMENTATION
-      const int end = 1 + stop - k;
-      int       cnt;
-      __m128i   inf = _mm_set1_epi32(INF);
-
-      for (cnt = 0; cnt < end - 3; cnt += 4) {
-        __m128i   a     = _mm_loadu_si128((__m128i *)&fmi_tmp[k + cnt]);
-        __m128i   b     = _mm_loadu_si128((__m128i *)&fm[k1j + cnt]);
-        __m128i   c     = _mm_add_epi32(a, b);
-        __m128i   mask1 = _mm_cmplt_epi32(a, inf);
-        __m128i   mask2 = _mm_cmplt_epi32(b, inf);
-        __m128i   res   = _mm_or_si128(_mm_and_si128(mask1, c),
-                                       _mm_andnot_si128(mask1, a));
-
-        res = _mm_or_si128(_mm_and_si128(mask2, res),
-                           _mm_andnot_si128(mask2, b));
-        const int en = horizontal_min_Vec4i(res);
-        decomp = MIN2(decomp, en);
-      }
+      const int stop  = last_nt;
+      const int cnt   = stop - k + 1;
 
-      for (; cnt < end; cnt++) {
-        if ((fmi[k + cnt] != INF) && (fm[k1j + cnt] != INF)) {
-          const int en = fmi[k + cnt] + fm[k1j + cnt];
-          decomp = MIN2(decomp, en);
-        }
-      }
-#else
-      for (; k <= stop; k++, k1j++) {
-        if ((fmi_tmp[k] != INF) && (fm[k1j] != INF)) {
-          en      = fmi_tmp[k] + fm[k1j];
-          decomp  = MIN2(decomp, en);
-        }
+      en      = vrna_fun_zip_add_min(fmi_tmp + k, fm + k1j, cnt);
+      decomp  = MIN2(decomp, en);
+
+      if (cnt > 0) {
+        k   += cnt;
+        k1j += cnt;
       }
-#endif
 
       k++;
       k1j++;
@@ -1371,10 +1532,8 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
 
   /* end modular decomposition -------------------------------*/
 
-  if (fmi_tmp != fmi) {
-    fmi_tmp += i;
-    free(fmi_tmp);
-  }
+  if (fmi_tmp != fmi)
+    release_fmi_scratch(aux, fmi_tmp, i);
 
   dmli[j] = decomp;               /* store for use in fast ML decompositon */
 
@@ -1386,7 +1545,7 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
     if (sliding_window) {
       /* additional ML decomposition as two coaxially stacked helices */
       for (decomp = INF, k = i + 1 + turn; k <= j - 2 - turn; k++) {
-        if (evaluate(i, k, k + 1, j, VRNA_DECOMP_ML_COAXIAL_ENC, &hc_dat_local)) {
+        if (evaluate(i, k, k + 1, j, VRNA_DECOMP_ML_COAXIAL_ENC, hc_dat_local)) {
           type    = rtype[vrna_get_ptype_window(i, k, ptype_local)];
           type_2  = rtype[vrna_get_ptype_window(k + 1, j, ptype_local)];
 
@@ -1425,7 +1584,7 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
         const int stop = last_nt;
         for (; k <= stop; k++, k1j++) {
           ik = indx[k] + i;
-          if (evaluate(i, k, k + 1, j, VRNA_DECOMP_ML_COAXIAL_ENC, &hc_dat_local)) {
+          if (evaluate(i, k, k + 1, j, VRNA_DECOMP_ML_COAXIAL_ENC, hc_dat_local)) {
             en = c[ik] +
                  c[k1j];
 
@@ -1449,8 +1608,8 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
                 break;
             }
 
-            if (sc_wrapper.coaxial_enc)
-              en += sc_wrapper.coaxial_enc(i, k, k + 1, j, &sc_wrapper);
+            if (sc_wrapper->coaxial_enc)
+              en += sc_wrapper->coaxial_enc(i, k, k + 1, j, sc_wrapper);
 
             decomp = MIN2(decomp, en);
           }
@@ -1482,7 +1641,5 @@ E_ml_stems_fast(vrna_fold_compound_t  *fc,
 
   fmi[j] = e;
 
-  free_sc_wrapper(&sc_wrapper);
-
   return e;
 }
@@ -84,6 +84,74 @@ vrna_E_ml_stems_fast(vrna_fold_compound_t *fc,
                      int                  *dmli);
 
 
+/**
+ *  @brief  Auxiliary data for fast multibranch loop decomposition
+ *
+ *  Holds the hard constraint evaluator and the soft constraint wrapper that
+ *  multibranch loop decompositions of different pairs @f$(i,j)@f$ have in
+ *  common, and per-thread scratch memory for the decomposition into two
+ *  multibranch loop parts if these are subject to constraints.
+ *
+ *  @see vrna_E_ml_fast_init(), vrna_E_ml_fast_free(), vrna_E_mb_loop_fast_aux(),
+ *  vrna_E_ml_stems_fast_aux(), vrna_E_ml_rightmost_stem_aux()
+ */
+typedef struct vrna_mx_mfe_aux_ml_s *vrna_mx_mfe_aux_ml_t;
+
+
+/**
+ *  @brief  Prepare the auxiliary data for fast multibranch loop decomposition
+ *
+ *  The returned data refers to the hard and soft constraints of @p fc and is
+ *  only valid as long as they are not changed or replaced.
+ */
+vrna_mx_mfe_aux_ml_t
+vrna_E_ml_fast_init(vrna_fold_compound_t *fc);
+
+
+/**
+ *  @brief  Same as vrna_E_mb_loop_fast() but without any per-call setup
+ *
+ *  This function may be called concurrently from multiple threads of the same
+ *  OpenMP team for a single @p aux_mx.
+ */
+int
+vrna_E_mb_loop_fast_aux(vrna_fold_compound_t  *fc,
+                        int                   i,
+                        int                   j,
+                        int                   *dmli1,
+                        int                   *dmli2,
+                        vrna_mx_mfe_aux_ml_t  aux_mx);
+
+
+/**
+ *  @brief  Same as vrna_E_ml_stems_fast() but without any per-call setup
+ *
+ *  This function may be called concurrently from multiple threads of the same
+ *  OpenMP team for a single @p aux_mx.
+ */
+int
+vrna_E_ml_stems_fast_aux(vrna_fold_compound_t *fc,
+                         int                  i,
+                         int                  j,
+                         int                  *fmi,
+                         int                  *dmli,
+                         vrna_mx_mfe_aux_ml_t aux_mx);
+
+
+/**
+ *  @brief  Same as E_ml_rightmost_stem() but without any per-call setup
+ */
+int
+vrna_E_ml_rightmost_stem_aux(vrna_fold_compound_t *fc,
+                             int                  i,
+                             int                  j,
+                             vrna_mx_mfe_aux_ml_t aux_mx);
+
+
+void
+vrna_E_ml_fast_free(vrna_mx_mfe_aux_ml_t aux_mx);
+
+
 /* End basic interface */
 /**@}*/
 
@@ -130,6 +198,18 @@ const FLT_OR_DBL *
 vrna_exp_E_ml_fast_qqm1(struct vrna_mx_pf_aux_ml_s *aux_mx);
 
 
+/**
+ *  @brief  Get the helper array of multibranch loop stems for column @f$ j @f$
+ *
+ *  For helper arrays created with vrna_md_t.wavefront set, this returns the
+ *  stored column @f$ j @f$. Otherwise, the current (rotating) column is
+ *  returned, i.e. the same as vrna_exp_E_ml_fast_qqm().
+ */
+const FLT_OR_DBL *
+vrna_exp_E_ml_fast_qqm_column(struct vrna_mx_pf_aux_ml_s  *aux_mx,
+                              int                         j);
+
+
 FLT_OR_DBL
 vrna_exp_E_ml_fast(vrna_fold_compound_t *fc,
                    int                  i,
@@ -110,8 +110,9 @@ vrna_BT_mb_loop_fake(vrna_fold_compound_t *fc,
   char                      *ptype;
   short                     mm5, mm3, *S1;
   unsigned int              *sn, *se;
-  int                       length, ii, jj, k, en, fij, fi, *my_c, *my_fc, *my_ggg,
+  int                       length, ii, jj, k, en, fij, fi, *my_c, *my_fc,
                             *idx, with_gquad, dangle_model, turn, type;
+  vrna_gquad_mx_t           *my_ggg;
   vrna_param_t              *P;
   vrna_md_t                 *md;
   vrna_sc_t                 *sc;
@@ -185,7 +186,7 @@ vrna_BT_mb_loop_fake(vrna_fold_compound_t *fc,
           }
 
           if (with_gquad) {
-            if (fij == my_fc[k + 1] + my_ggg[idx[k] + ii]) {
+            if (fij == my_fc[k + 1] + gquad_mx_get(my_ggg, ii, k)) {
               *u  = k + 1;
               *i  = *j = -1;
               return vrna_BT_gquad_mfe(fc, ii, k, bp_stack, stack_count);
@@ -211,7 +212,7 @@ vrna_BT_mb_loop_fake(vrna_fold_compound_t *fc,
           }
 
           if (with_gquad) {
-            if (fij == my_fc[k + 1] + my_ggg[idx[k] + ii]) {
+            if (fij == my_fc[k + 1] + gquad_mx_get(my_ggg, ii, k)) {
               *u  = k + 1;
               *i  = *j = -1;
               return vrna_BT_gquad_mfe(fc, ii, k, bp_stack, stack_count);
@@ -252,7 +253,7 @@ vrna_BT_mb_loop_fake(vrna_fold_compound_t *fc,
           }
 
           if (with_gquad) {
-            if (fij == my_fc[k + 1] + my_ggg[idx[k] + ii]) {
+            if (fij == my_fc[k + 1] + gquad_mx_get(my_ggg, ii, k)) {
               *u  = k + 1;
               *i  = *j = -1;
               return vrna_BT_gquad_mfe(fc, ii, k, bp_stack, stack_count);
@@ -334,7 +335,7 @@ vrna_BT_mb_loop_fake(vrna_fold_compound_t *fc,
       case 0:
         for (k = jj - turn - 1; k >= ii; k--) {
           if (with_gquad) {
-            if (fij == my_fc[k - 1] + my_ggg[idx[jj] + k]) {
+            if (fij == my_fc[k - 1] + gquad_mx_get(my_ggg, k, jj)) {
               *u  = k - 1;
               *i  = *j = -1;
               return vrna_BT_gquad_mfe(fc, k, jj, bp_stack, stack_count);
@@ -363,7 +364,7 @@ vrna_BT_mb_loop_fake(vrna_fold_compound_t *fc,
       case 2:
         for (k = jj - turn - 1; k >= ii; k--) {
           if (with_gquad) {
-            if (fij == my_fc[k - 1] + my_ggg[idx[jj] + k]) {
+            if (fij == my_fc[k - 1] + gquad_mx_get(my_ggg, k, jj)) {
               *u  = k - 1;
               *i  = *j = -1;
               return vrna_BT_gquad_mfe(fc, k, jj, bp_stack, stack_count);
@@ -393,7 +394,7 @@ vrna_BT_mb_loop_fake(vrna_fold_compound_t *fc,
       default:
         for (k = jj - turn - 1; k >= ii; k--) {
           if (with_gquad) {
-            if (fij == my_fc[k - 1] + my_ggg[idx[jj] + k]) {
+            if (fij == my_fc[k - 1] + gquad_mx_get(my_ggg, k, jj)) {
               *u  = k - 1;
               *i  = *j = -1;
               return vrna_BT_gquad_mfe(fc, k, jj, bp_stack, stack_count);
@@ -511,9 +512,10 @@ BT_mb_loop_split(vrna_fold_compound_t *fc,
   char                      *ptype, **ptype_local;
   short                     *S1, **SS, **S5, **S3;
   unsigned int              n_seq, s;
-  int                       ij, ii, jj, fij, fi, u, en, *my_c, *my_fML, *my_ggg,
+  int                       ij, ii, jj, fij, fi, u, en, *my_c, *my_fML,
                             turn, *idx, with_gquad, dangle_model, *rtype, kk, cnt,
                             with_ud, type, type_2, en2, **c_local, **fML_local, **ggg_local;
+  vrna_gquad_mx_t           *my_ggg;
   vrna_param_t              *P;
   vrna_md_t                 *md;
   vrna_ud_t                 *domains_up;
@@ -715,7 +717,7 @@ BT_mb_loop_split(vrna_fold_compound_t *fc,
   if (with_gquad) {
     en = E_MLstem(0, -1, -1, P) *
          n_seq;
-    en += (sliding_window) ? ggg_local[ii][jj - ii] : my_ggg[ij];
+    en += (sliding_window) ? ggg_local[ii][jj - ii] : gquad_mx_get(my_ggg, ii, jj);
 
     if (fij == en) {
       *i  = *j = -1;
@@ -9,6 +9,7 @@
 #include <ctype.h>
 #include <string.h>
 #include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/utils/higher_order_functions.h"
 #include "ViennaRNA/fold_vars.h"
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/params/default.h"
@@ -20,6 +21,10 @@
 #include "ViennaRNA/unstructured_domains.h"
 #include "ViennaRNA/loops/multibranch.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef __GNUC__
 # define INLINE inline
 #else
@@ -35,6 +40,24 @@ struct vrna_mx_pf_aux_ml_s {
 
   int         qqmu_size;
   FLT_OR_DBL  **qqmu;
+
+  /* complete columns qqm[j][i] for wavefront and tiled fills (NULL otherwise) */
+  int         length;
+  FLT_OR_DBL  **qqm_col;
+
+  /* hard and soft constraint wrappers prepared once for all (i, j) */
+  unsigned char             has_wrappers;
+  vrna_callback_hc_evaluate *evaluate;
+  struct default_data       hc_dat;
+  struct sc_wrapper_exp_ml  sc_wrapper;
+
+  /*
+   *  per-thread scratch rows for qqm and qqm1 with hard/soft constraints
+   *  applied, and per-thread qqmu column pointers of wavefront and tiled fills
+   */
+  unsigned int              threads;
+  FLT_OR_DBL                **qqm_tmp;
+  FLT_OR_DBL                ***qqmu_view;
 };
 
 
@@ -58,6 +81,33 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
               struct vrna_mx_pf_aux_ml_s  *aux_mx);
 
 
+PRIVATE INLINE struct vrna_mx_pf_aux_ml_s *
+get_column_view(struct vrna_mx_pf_aux_ml_s  *aux_mx,
+                int                         j,
+                struct vrna_mx_pf_aux_ml_s  *view);
+
+
+PRIVATE INLINE void
+free_column_view(struct vrna_mx_pf_aux_ml_s *aux_mx,
+                 struct vrna_mx_pf_aux_ml_s *view);
+
+
+PRIVATE INLINE unsigned int
+get_thread_slot(struct vrna_mx_pf_aux_ml_s *aux_mx);
+
+
+PRIVATE INLINE FLT_OR_DBL *
+get_qqm_scratch(struct vrna_mx_pf_aux_ml_s  *aux_mx,
+                int                         i,
+                int                         j);
+
+
+PRIVATE INLINE void
+release_qqm_scratch(struct vrna_mx_pf_aux_ml_s  *aux_mx,
+                    FLT_OR_DBL                  *qqm_tmp,
+                    int                         i);
+
+
 /*
  #################################
  # BEGIN OF FUNCTION DEFINITIONS #
@@ -69,10 +119,14 @@ vrna_exp_E_mb_loop_fast(vrna_fold_compound_t        *fc,
                         int                         j,
                         struct vrna_mx_pf_aux_ml_s  *aux_mx)
 {
-  FLT_OR_DBL q = 0.;
+  FLT_OR_DBL                  q = 0.;
+  struct vrna_mx_pf_aux_ml_s  view, *mx;
 
-  if ((fc) && (aux_mx))
-    q = exp_E_mb_loop_fast(fc, i, j, aux_mx);
+  if ((fc) && (aux_mx)) {
+    mx  = get_column_view(aux_mx, j, &view);
+    q   = exp_E_mb_loop_fast(fc, i, j, mx);
+    free_column_view(aux_mx, mx);
+  }
 
   return q;
 }
@@ -84,10 +138,14 @@ vrna_exp_E_ml_fast(vrna_fold_compound_t       *fc,
                    int                        j,
                    struct vrna_mx_pf_aux_ml_s *aux_mx)
 {
-  FLT_OR_DBL q = 0.;
+  FLT_OR_DBL                  q = 0.;
+  struct vrna_mx_pf_aux_ml_s  view, *mx;
 
-  if ((fc) && (aux_mx))
-    q = exp_E_ml_fast(fc, i, j, aux_mx);
+  if ((fc) && (aux_mx)) {
+    mx  = get_column_view(aux_mx, j, &view);
+    q   = exp_E_ml_fast(fc, i, j, mx);
+    free_column_view(aux_mx, mx);
+  }
 
   return q;
 }
@@ -99,21 +157,60 @@ vrna_exp_E_ml_fast_init(vrna_fold_compound_t *fc)
   struct vrna_mx_pf_aux_ml_s *aux_mx = NULL;
 
   if (fc) {
-    int         i, j, d, n, u, turn, ij, *iidx;
-    FLT_OR_DBL  *qm;
+    unsigned int  t, threads;
+    int           i, j, d, n, u, turn, ij, *iidx;
+    FLT_OR_DBL    *qm;
 
     n     = (int)fc->length;
     iidx  = fc->iindx;
     turn  = fc->exp_params->model_details.min_loop_size;
     qm    = fc->exp_matrices->qm;
 
+    threads = 1;
+#ifdef _OPENMP
+    threads = (unsigned int)omp_get_max_threads();
+#endif
+
     /* allocate memory for helper arrays */
     aux_mx =
       (struct vrna_mx_pf_aux_ml_s *)vrna_alloc(sizeof(struct vrna_mx_pf_aux_ml_s));
-    aux_mx->qqm       = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
-    aux_mx->qqm1      = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
     aux_mx->qqmu_size = 0;
     aux_mx->qqmu      = NULL;
+    aux_mx->length    = n;
+    aux_mx->qqm_col   = NULL;
+    aux_mx->threads   = 0;
+    aux_mx->qqm_tmp   = NULL;
+    aux_mx->qqmu_view = NULL;
+
+    /*
+     *  hard and soft constraints of sliding window computations change
+     *  while the window moves, so only global fills may use wrappers
+     *  prepared in advance
+     */
+    aux_mx->has_wrappers = 0;
+    if (fc->hc->type != VRNA_HC_WINDOW) {
+      aux_mx->has_wrappers  = 1;
+      aux_mx->evaluate      = prepare_hc_default(fc, &(aux_mx->hc_dat));
+      init_sc_wrapper(fc, &(aux_mx->sc_wrapper));
+    }
+
+    if ((fc->hc->type != VRNA_HC_WINDOW) &&
+        ((fc->exp_params->model_details.wavefront) ||
+         (fc->exp_params->model_details.tile_size > 0))) {
+      /*
+       *  wavefront and tiled fills do not proceed column by column, so instead
+       *  of two rotating arrays we need to keep all columns j of qqm. Column j
+       *  only holds entries for i <= j
+       */
+      aux_mx->qqm     = NULL;
+      aux_mx->qqm1    = NULL;
+      aux_mx->qqm_col = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (n + 1));
+      for (j = 0; j <= n; j++)
+        aux_mx->qqm_col[j] = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j + 2));
+    } else {
+      aux_mx->qqm   = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+      aux_mx->qqm1  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+    }
 
     if (fc->type == VRNA_FC_TYPE_SINGLE) {
       vrna_ud_t *domains_up = fc->domains_up;
@@ -127,12 +224,41 @@ vrna_exp_E_ml_fast_init(vrna_fold_compound_t *fc)
             ud_max_size = domains_up->uniq_motif_size[u];
 
         aux_mx->qqmu_size = ud_max_size;
-        aux_mx->qqmu      = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (ud_max_size + 1));
-        for (u = 0; u <= ud_max_size; u++)
-          aux_mx->qqmu[u] = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+
+        /* in wavefront mode, qqmu[u] is simply column j - u of qqm_col */
+        if (!aux_mx->qqm_col) {
+          aux_mx->qqmu = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (ud_max_size + 1));
+          for (u = 0; u <= ud_max_size; u++)
+            aux_mx->qqmu[u] = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+        }
       }
     }
 
+    /*
+     *  scratch rows are only required if decompositions are masked or
+     *  modified. The constraints of sliding window computations may change
+     *  with each window, so they keep allocating their rows per call
+     */
+    if ((aux_mx->has_wrappers) &&
+        ((fc->hc->f) ||
+         (aux_mx->sc_wrapper.decomp_ml) ||
+         (aux_mx->sc_wrapper.red_ml))) {
+      aux_mx->qqm_tmp = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * threads);
+      for (t = 0; t < threads; t++)
+        aux_mx->qqm_tmp[t] = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+    }
+
+    /* in wavefront and tiled fills, each thread collects its qqmu columns here */
+    if ((aux_mx->qqm_col) && (aux_mx->qqmu_size > 0)) {
+      aux_mx->qqmu_view = (FLT_OR_DBL ***)vrna_alloc(sizeof(FLT_OR_DBL * *) * threads);
+      for (t = 0; t < threads; t++)
+        aux_mx->qqmu_view[t] =
+          (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (aux_mx->qqmu_size + 1));
+    }
+
+    if ((aux_mx->qqm_tmp) || (aux_mx->qqmu_view))
+      aux_mx->threads = threads;
+
     if (fc->hc->type == VRNA_HC_WINDOW) {
     } else {
       for (d = 0; d <= turn; d++)
@@ -168,7 +294,7 @@ vrna_exp_E_ml_fast_init(vrna_fold_compound_t *fc)
 PUBLIC void
 vrna_exp_E_ml_fast_rotate(struct vrna_mx_pf_aux_ml_s *aux_mx)
 {
-  if (aux_mx) {
+  if ((aux_mx) && (!aux_mx->qqm_col)) {
     int         u;
     FLT_OR_DBL  *tmp;
 
@@ -203,6 +329,30 @@ vrna_exp_E_ml_fast_free(struct vrna_mx_pf_aux_ml_s *aux_mx)
       free(aux_mx->qqmu);
     }
 
+    if (aux_mx->qqm_col) {
+      for (u = 0; u <= aux_mx->length; u++)
+        free(aux_mx->qqm_col[u]);
+
+      free(aux_mx->qqm_col);
+    }
+
+    if (aux_mx->qqm_tmp) {
+      for (u = 0; u < (int)aux_mx->threads; u++)
+        free(aux_mx->qqm_tmp[u]);
+
+      free(aux_mx->qqm_tmp);
+    }
+
+    if (aux_mx->qqmu_view) {
+      for (u = 0; u < (int)aux_mx->threads; u++)
+        free(aux_mx->qqmu_view[u]);
+
+      free(aux_mx->qqmu_view);
+    }
+
+    if (aux_mx->has_wrappers)
+      free_sc_wrapper(&(aux_mx->sc_wrapper));
+
     free(aux_mx);
   }
 }
@@ -228,11 +378,134 @@ vrna_exp_E_ml_fast_qqm1(struct vrna_mx_pf_aux_ml_s *aux_mx)
 }
 
 
+PUBLIC const FLT_OR_DBL *
+vrna_exp_E_ml_fast_qqm_column(struct vrna_mx_pf_aux_ml_s  *aux_mx,
+                              int                         j)
+{
+  if (aux_mx) {
+    if (aux_mx->qqm_col)
+      return ((j >= 0) && (j <= aux_mx->length)) ?
+             (const FLT_OR_DBL *)aux_mx->qqm_col[j] :
+             NULL;
+
+    return (const FLT_OR_DBL *)aux_mx->qqm;
+  }
+
+  return NULL;
+}
+
+
 /*
  #####################################
  # BEGIN OF STATIC HELPER FUNCTIONS  #
  #####################################
  */
+PRIVATE INLINE struct vrna_mx_pf_aux_ml_s *
+get_column_view(struct vrna_mx_pf_aux_ml_s  *aux_mx,
+                int                         j,
+                struct vrna_mx_pf_aux_ml_s  *view)
+{
+  unsigned int  t;
+  int           u;
+
+  if (!aux_mx->qqm_col)
+    return aux_mx;
+
+  /*
+   *  present the columns j, j - 1, ..., j - qqmu_size as if they were
+   *  the rotating helper arrays, such that the decompositions below
+   *  remain untouched. The view lives on the caller's stack, so
+   *  concurrent threads never share any helper array pointers
+   */
+  *view       = *aux_mx;
+  view->qqm   = aux_mx->qqm_col[j];
+  view->qqm1  = aux_mx->qqm_col[(j > 0) ? j - 1 : 0];
+  view->qqmu  = NULL;
+
+  if (aux_mx->qqmu_size > 0) {
+    t = get_thread_slot(aux_mx);
+
+    if ((aux_mx->qqmu_view) && (t < aux_mx->threads))
+      view->qqmu = aux_mx->qqmu_view[t];
+    else
+      view->qqmu = (FLT_OR_DBL **)vrna_alloc(sizeof(FLT_OR_DBL *) * (aux_mx->qqmu_size + 1));
+
+    for (u = 0; (u <= aux_mx->qqmu_size) && (u <= j); u++)
+      view->qqmu[u] = aux_mx->qqm_col[j - u];
+  }
+
+  return view;
+}
+
+
+PRIVATE INLINE void
+free_column_view(struct vrna_mx_pf_aux_ml_s *aux_mx,
+                 struct vrna_mx_pf_aux_ml_s *view)
+{
+  unsigned int t;
+
+  if ((view != aux_mx) && (view->qqmu)) {
+    if (aux_mx->qqmu_view)
+      for (t = 0; t < aux_mx->threads; t++)
+        if (aux_mx->qqmu_view[t] == view->qqmu)
+          return;
+
+    free(view->qqmu);
+  }
+}
+
+
+PRIVATE INLINE unsigned int
+get_thread_slot(struct vrna_mx_pf_aux_ml_s *aux_mx)
+{
+  unsigned int t = 0;
+
+#ifdef _OPENMP
+  if (aux_mx->threads > 1)
+    t = (unsigned int)omp_get_thread_num();
+
+#endif
+
+  return t;
+}
+
+
+PRIVATE INLINE FLT_OR_DBL *
+get_qqm_scratch(struct vrna_mx_pf_aux_ml_s  *aux_mx,
+                int                         i,
+                int                         j)
+{
+  unsigned int  t;
+  FLT_OR_DBL    *qqm_tmp;
+
+  t = get_thread_slot(aux_mx);
+
+  if ((aux_mx->qqm_tmp) && (t < aux_mx->threads))
+    return aux_mx->qqm_tmp[t];
+
+  /* no scratch rows or more threads than anticipated, fall back to private memory */
+  qqm_tmp = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j - i + 2));
+
+  return qqm_tmp - i;
+}
+
+
+PRIVATE INLINE void
+release_qqm_scratch(struct vrna_mx_pf_aux_ml_s  *aux_mx,
+                    FLT_OR_DBL                  *qqm_tmp,
+                    int                         i)
+{
+  unsigned int t;
+
+  if (aux_mx->qqm_tmp)
+    for (t = 0; t < aux_mx->threads; t++)
+      if (aux_mx->qqm_tmp[t] == qqm_tmp)
+        return;
+
+  free(qqm_tmp + i);
+}
+
+
 PRIVATE FLT_OR_DBL
 exp_E_mb_loop_fast(vrna_fold_compound_t       *fc,
                    int                        i,
@@ -249,8 +522,8 @@ exp_E_mb_loop_fast(vrna_fold_compound_t       *fc,
   vrna_exp_param_t          *pf_params;
   vrna_md_t                 *md;
   vrna_callback_hc_evaluate *evaluate;
-  struct default_data       hc_dat_local;
-  struct sc_wrapper_exp_ml  sc_wrapper;
+  struct default_data       hc_dat_local, *hc_dat;
+  struct sc_wrapper_exp_ml  sc_wrapper_local, *sc_wrapper;
 
   qqm1            = aux_mx->qqm1;
   sliding_window  = (fc->hc->type == VRNA_HC_WINDOW) ? 1 : 0;
@@ -275,12 +548,20 @@ exp_E_mb_loop_fast(vrna_fold_compound_t       *fc,
   expMLclosing    = pf_params->expMLclosing;
   qbt1            = 0.;
   rtype           = &(md->rtype[0]);
-  evaluate        = prepare_hc_default(fc, &hc_dat_local);
 
-  init_sc_wrapper(fc, &sc_wrapper);
+  if (aux_mx->has_wrappers) {
+    evaluate    = aux_mx->evaluate;
+    hc_dat      = &(aux_mx->hc_dat);
+    sc_wrapper  = &(aux_mx->sc_wrapper);
+  } else {
+    evaluate    = prepare_hc_default(fc, &hc_dat_local);
+    hc_dat      = &hc_dat_local;
+    sc_wrapper  = &sc_wrapper_local;
+    init_sc_wrapper(fc, sc_wrapper);
+  }
 
   /* multiple stem loop contribution */
-  if (evaluate(i, j, i + 1, j - 1, VRNA_DECOMP_PAIR_ML, &hc_dat_local)) {
+  if (evaluate(i, j, i + 1, j - 1, VRNA_DECOMP_PAIR_ML, hc_dat)) {
     qqqmmm = pow(expMLclosing, (double)n_seq) *
              scale[2];
 
@@ -302,33 +583,31 @@ exp_E_mb_loop_fast(vrna_fold_compound_t       *fc,
         break;
     }
 
-    if (sc_wrapper.pair)
-      qqqmmm *= sc_wrapper.pair(i, j, &sc_wrapper);
+    if (sc_wrapper->pair)
+      qqqmmm *= sc_wrapper->pair(i, j, sc_wrapper);
 
     FLT_OR_DBL *qqm1_tmp = qqm1;
 
     if (hc->f) {
-      qqm1_tmp  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j - i + 2));
-      qqm1_tmp  -= i;
+      qqm1_tmp = get_qqm_scratch(aux_mx, i, j);
 
       for (k = i + 2; k <= j - 1; k++) {
         qqm1_tmp[k] = qqm1[k];
-        if (!evaluate(i + 1, j - 1, k - 1, k, VRNA_DECOMP_ML_ML_ML, &hc_dat_local))
+        if (!evaluate(i + 1, j - 1, k - 1, k, VRNA_DECOMP_ML_ML_ML, hc_dat))
           qqm1_tmp[k] = 0.;
       }
     }
 
-    if (sc_wrapper.decomp_ml) {
+    if (sc_wrapper->decomp_ml) {
       if (qqm1_tmp == qqm1) {
-        qqm1_tmp  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j - i + 2));
-        qqm1_tmp  -= i;
+        qqm1_tmp = get_qqm_scratch(aux_mx, i, j);
 
         for (k = i + 2; k <= j - 1; k++)
           qqm1_tmp[k] = qqm1[k];
       }
 
       for (k = i + 2; k <= j - 1; k++)
-        qqm1_tmp[k] *= sc_wrapper.decomp_ml(i + 1, j - 1, k - 1, k, &sc_wrapper);
+        qqm1_tmp[k] *= sc_wrapper->decomp_ml(i + 1, j - 1, k - 1, k, sc_wrapper);
     }
 
     temp = 0.0;
@@ -337,9 +616,9 @@ exp_E_mb_loop_fast(vrna_fold_compound_t       *fc,
     k = i + 2;
 
     if (sliding_window) {
-      for (; k <= j - 1; k++, kl--)
-        temp += qm_local[i + 1][k - 1] *
-                qqm1_tmp[k];
+      temp += vrna_fun_zip_mult_sum(qm_local[i + 1] + k - 1,
+                                    qqm1_tmp + k,
+                                    j - k);
     } else {
       kl = my_iindx[i + 1] - (i + 1);
       /*
@@ -351,9 +630,13 @@ exp_E_mb_loop_fast(vrna_fold_compound_t       *fc,
         /* limit for-loop to last nucleotide of 5' part strand */
         int stop = MIN2(j - 1, se[sn[k - 1]]);
 
-        for (; k <= stop; k++, kl--)
-          temp += qm[kl] *
-                  qqm1_tmp[k];
+        if (k <= stop) {
+          temp  += vrna_fun_zip_mult_sum_reverse(qqm1_tmp + k,
+                                                 qm + kl,
+                                                 stop - k + 1);
+          kl    -= stop - k + 1;
+          k     = stop + 1;
+        }
 
         k++;
         kl--;
@@ -363,16 +646,15 @@ exp_E_mb_loop_fast(vrna_fold_compound_t       *fc,
       }
     }
 
-    if (qqm1_tmp != qqm1) {
-      qqm1_tmp += i;
-      free(qqm1_tmp);
-    }
+    if (qqm1_tmp != qqm1)
+      release_qqm_scratch(aux_mx, qqm1_tmp, i);
 
     qbt1 += temp *
             qqqmmm;
   }
 
-  free_sc_wrapper(&sc_wrapper);
+  if (!aux_mx->has_wrappers)
+    free_sc_wrapper(sc_wrapper);
 
   return qbt1;
 }
@@ -389,15 +671,16 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
   unsigned int              *sn, *ss, *se, n_seq, s;
   int                       n, *iidx, k, ij, kl, maxk, ii, with_ud, u, circular, with_gquad,
                             *hc_up_ml, type;
-  FLT_OR_DBL                qbt1, temp, *qm, *qb, *qqm, *qqm1, **qqmu, q_temp, q_temp2, *G,
+  FLT_OR_DBL                qbt1, temp, *qm, *qb, *qqm, *qqm1, **qqmu, q_temp, q_temp2,
                             *expMLbase, **qb_local, **qm_local, **G_local;
+  vrna_gquad_mx_t           *G;
   vrna_md_t                 *md;
   vrna_exp_param_t          *pf_params;
   vrna_ud_t                 *domains_up;
   vrna_hc_t                 *hc;
   vrna_callback_hc_evaluate *evaluate;
-  struct default_data       hc_dat_local;
-  struct sc_wrapper_exp_ml  sc_wrapper;
+  struct default_data       hc_dat_local, *hc_dat;
+  struct sc_wrapper_exp_ml  sc_wrapper_local, *sc_wrapper;
 
   sliding_window  = (fc->hc->type == VRNA_HC_WINDOW) ? 1 : 0;
   n               = (int)fc->length;
@@ -428,21 +711,29 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
   with_gquad      = md->gquad;
   with_ud         = (domains_up && domains_up->exp_energy_cb);
   hc_up_ml        = hc->up_ml;
-  evaluate        = prepare_hc_default(fc, &hc_dat_local);
 
-  init_sc_wrapper(fc, &sc_wrapper);
+  if (aux_mx->has_wrappers) {
+    evaluate    = aux_mx->evaluate;
+    hc_dat      = &(aux_mx->hc_dat);
+    sc_wrapper  = &(aux_mx->sc_wrapper);
+  } else {
+    evaluate    = prepare_hc_default(fc, &hc_dat_local);
+    hc_dat      = &hc_dat_local;
+    sc_wrapper  = &sc_wrapper_local;
+    init_sc_wrapper(fc, sc_wrapper);
+  }
 
   qbt1    = 0;
   q_temp  = 0.;
 
   qqm[i] = 0.;
 
-  if (evaluate(i, j, i, j - 1, VRNA_DECOMP_ML_ML, &hc_dat_local)) {
+  if (evaluate(i, j, i, j - 1, VRNA_DECOMP_ML_ML, hc_dat)) {
     q_temp = qqm1[i] *
              expMLbase[1];
 
-    if (sc_wrapper.red_ml)
-      q_temp *= sc_wrapper.red_ml(i, j, i, j - 1, &sc_wrapper);
+    if (sc_wrapper->red_ml)
+      q_temp *= sc_wrapper->red_ml(i, j, i, j - 1, sc_wrapper);
 
     qqm[i] += q_temp;
   }
@@ -454,7 +745,7 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
     for (cnt = 0; cnt < domains_up->uniq_motif_count; cnt++) {
       u = domains_up->uniq_motif_size[cnt];
       if (j - u >= i) {
-        if (evaluate(i, j, i, j - u, VRNA_DECOMP_ML_ML, &hc_dat_local)) {
+        if (evaluate(i, j, i, j - u, VRNA_DECOMP_ML_ML, hc_dat)) {
           q_temp2 = qqmu[u][i] *
                     domains_up->exp_energy_cb(fc,
                                               j - u + 1,
@@ -464,8 +755,8 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
                                               domains_up->data) *
                     expMLbase[u];
 
-          if (sc_wrapper.red_ml)
-            q_temp2 *= sc_wrapper.red_ml(i, j, i, j - u, &sc_wrapper);
+          if (sc_wrapper->red_ml)
+            q_temp2 *= sc_wrapper->red_ml(i, j, i, j - u, sc_wrapper);
 
           q_temp += q_temp2;
         }
@@ -475,7 +766,7 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
     qqm[i] += q_temp;
   }
 
-  if (evaluate(i, j, i, j, VRNA_DECOMP_ML_STEM, &hc_dat_local)) {
+  if (evaluate(i, j, i, j, VRNA_DECOMP_ML_STEM, hc_dat)) {
     qbt1 = (sliding_window) ? qb_local[i][j] : qb[ij];
 
     switch (fc->type) {
@@ -504,14 +795,14 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
         break;
     }
 
-    if (sc_wrapper.red_stem)
-      qbt1 *= sc_wrapper.red_stem(i, j, i, j, &sc_wrapper);
+    if (sc_wrapper->red_stem)
+      qbt1 *= sc_wrapper->red_stem(i, j, i, j, sc_wrapper);
 
     qqm[i] += qbt1;
   }
 
   if (with_gquad) {
-    q_temp  = (sliding_window) ? G_local[i][j] : G[ij];
+    q_temp  = (sliding_window) ? G_local[i][j] : gquad_mx_get_pf(G, i, j);
     qqm[i]  += q_temp *
                pow(exp_E_MLstem(0, -1, -1, pf_params), (double)n_seq);
   }
@@ -527,28 +818,26 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
 
   /* apply hard constraints if necessary */
   if (hc->f) {
-    qqm_tmp = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j - i + 2));
-    qqm_tmp -= i;
+    qqm_tmp = get_qqm_scratch(aux_mx, i, j);
 
     for (k = j; k > i; k--) {
       qqm_tmp[k] = qqm[k];
-      if (!evaluate(i, j, k - 1, k, VRNA_DECOMP_ML_ML_ML, &hc_dat_local))
+      if (!evaluate(i, j, k - 1, k, VRNA_DECOMP_ML_ML_ML, hc_dat))
         qqm_tmp[k] = 0.;
     }
   }
 
   /* apply soft constraints if necessary */
-  if (sc_wrapper.decomp_ml) {
+  if (sc_wrapper->decomp_ml) {
     if (qqm_tmp == qqm) {
-      qqm_tmp = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j - i + 2));
-      qqm_tmp -= i;
+      qqm_tmp = get_qqm_scratch(aux_mx, i, j);
 
       for (k = j; k > i; k--)
         qqm_tmp[k] = qqm[k];
     }
 
     for (k = j; k > i; k--)
-      qqm_tmp[k] *= sc_wrapper.decomp_ml(i, j, k - 1, k, &sc_wrapper);
+      qqm_tmp[k] *= sc_wrapper->decomp_ml(i, j, k - 1, k, sc_wrapper);
   }
 
   /* finally, decompose segment */
@@ -556,18 +845,22 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
   k     = j;
 
   if (sliding_window) {
-    for (; k > i; k--)
-      temp += qm_local[i][k - 1] *
-              qqm_tmp[k];
+    temp += vrna_fun_zip_mult_sum(qm_local[i] + i,
+                                  qqm_tmp + i + 1,
+                                  j - i);
   } else {
     kl = iidx[i] - j + 1; /* ii-k=[i,k-1] */
 
     while (1) {
       /* limit for-loop to first nucleotide of 3' part strand */
       int stop = MAX2(i, ss[sn[k]]);
-      for (; k > stop; k--, kl++)
-        temp += qm[kl] *
-                qqm_tmp[k];
+      if (k > stop) {
+        temp  += vrna_fun_zip_mult_sum_reverse(qm + kl,
+                                               qqm_tmp + k,
+                                               k - stop);
+        kl    += k - stop;
+        k     = stop;
+      }
 
       k--;
       kl++;
@@ -597,38 +890,34 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
   /* apply hard constraints if necessary */
   if (hc->f) {
     if (qqm_tmp == qqm) {
-      qqm_tmp = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j - i + 2));
-      qqm_tmp -= i;
+      qqm_tmp = get_qqm_scratch(aux_mx, i, j);
 
       for (k = maxk; k > i; k--)
         qqm_tmp[k] = qqm[k];
     }
 
     for (k = maxk; k > i; k--)
-      if (!evaluate(i, j, k, j, VRNA_DECOMP_ML_ML, &hc_dat_local))
+      if (!evaluate(i, j, k, j, VRNA_DECOMP_ML_ML, hc_dat))
         qqm_tmp[k] = 0.;
   }
 
   /* apply soft constraints if necessary */
-  if (sc_wrapper.red_ml) {
+  if (sc_wrapper->red_ml) {
     if (qqm_tmp == qqm) {
-      qqm_tmp = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (j - i + 2));
-      qqm_tmp -= i;
+      qqm_tmp = get_qqm_scratch(aux_mx, i, j);
 
       for (k = maxk; k > i; k--)
         qqm_tmp[k] = qqm[k];
     }
 
     for (k = maxk; k > i; k--)
-      qqm_tmp[k] *= sc_wrapper.red_ml(i, j, k, j, &sc_wrapper);
+      qqm_tmp[k] *= sc_wrapper->red_ml(i, j, k, j, sc_wrapper);
   }
 
-  ii = maxk - i; /* length of unpaired stretch */
-
   /* finally, decompose segment */
-  for (k = maxk; k > i; k--, ii--)
-    temp += expMLbase[ii] *
-            qqm_tmp[k];
+  temp += vrna_fun_zip_mult_sum(expMLbase + 1,
+                                qqm_tmp + i + 1,
+                                maxk - i);
 
   if (with_ud) {
     ii = maxk - i; /* length of unpaired stretch */
@@ -642,12 +931,11 @@ exp_E_ml_fast(vrna_fold_compound_t        *fc,
                                         domains_up->data);
   }
 
-  if (qqm_tmp != qqm) {
-    qqm_tmp += i;
-    free(qqm_tmp);
-  }
+  if (qqm_tmp != qqm)
+    release_qqm_scratch(aux_mx, qqm_tmp, i);
 
-  free_sc_wrapper(&sc_wrapper);
+  if (!aux_mx->has_wrappers)
+    free_sc_wrapper(sc_wrapper);
 
   return temp + qqm[i];
 }
@@ -37,6 +37,10 @@
 #include "ViennaRNA/alphabet.h"
 #include "ViennaRNA/mfe.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef __GNUC__
 # define INLINE inline
 #else
@@ -45,14 +49,7 @@
 
 #define MAXSECTORS        500     /* dimension for a backtrack array */
 
-struct aux_arrays {
-  int *cc;    /* auxilary arrays for canonical structures     */
-  int *cc1;   /* auxilary arrays for canonical structures     */
-  int *Fmi;   /* holds row i of fML (avoids jumps in memory)  */
-  int *DMLi;  /* DMLi[j] holds  MIN(fML[i,k]+fML[k+1,j])      */
-  int *DMLi1; /*                MIN(fML[i+1,k]+fML[k+1,j])    */
-  int *DMLi2; /*                MIN(fML[i+2,k]+fML[k+1,j])    */
-};
+#include "mfe_aux_arrays.inc"
 
 
 /*
@@ -104,20 +101,21 @@ PRIVATE INLINE int
 decompose_pair(vrna_fold_compound_t *fc,
                int                  i,
                int                  j,
-               struct aux_arrays    *aux);
-
-
-PRIVATE INLINE struct aux_arrays *
-get_aux_arrays(unsigned int length);
+               struct aux_arrays    *aux,
+               struct aux_cell      *cell);
 
 
 PRIVATE INLINE void
-rotate_aux_arrays(struct aux_arrays *aux,
-                  unsigned int      length);
+fill_cell(vrna_fold_compound_t  *fc,
+          int                   i,
+          int                   j,
+          struct aux_arrays     *aux);
 
 
-PRIVATE INLINE void
-free_aux_arrays(struct aux_arrays *aux);
+PRIVATE void
+fill_tiles(vrna_fold_compound_t *fc,
+           int                  tile_size,
+           struct aux_arrays    *aux);
 
 
 /*
@@ -228,7 +226,7 @@ vrna_backtrack_from_intervals(vrna_fold_compound_t  *fc,
 PRIVATE int
 fill_arrays(vrna_fold_compound_t *fc)
 {
-  int               i, j, ij, length, turn, uniq_ML, e, *indx, *f5, *c, *fML, *fM1;
+  int               i, j, d, length, turn, uniq_ML, *indx, *f5, *c, *fML, *fM1;
   vrna_param_t      *P;
   vrna_mx_mfe_t     *matrices;
   vrna_ud_t         *domains_up;
@@ -247,7 +245,10 @@ fill_arrays(vrna_fold_compound_t *fc)
   domains_up  = fc->domains_up;
 
   /* allocate memory for all helper arrays */
-  helper_arrays = get_aux_arrays(length);
+  helper_arrays = get_aux_arrays(length,
+                                 (P->model_details.tile_size > 0) ? AUX_TILES :
+                                 ((P->model_details.wavefront) ? AUX_WAVEFRONT : AUX_ROWWISE),
+                                 P->model_details.noLP);
 
   if ((turn < 0) || (turn > length))
     turn = length; /* does this make any sense? */
@@ -256,6 +257,11 @@ fill_arrays(vrna_fold_compound_t *fc)
   if (domains_up && domains_up->prod_cb)
     domains_up->prod_cb(fc, domains_up->data);
 
+  /* prepare everything the loop decompositions of all pairs (i, j) share */
+  helper_arrays->il = vrna_E_int_loop_fast_init(fc);
+  helper_arrays->hp = vrna_E_hp_loop_fast_init(fc);
+  helper_arrays->ml = vrna_E_ml_fast_init(fc);
+
   /* prefill matrices with init contributions */
   for (j = 1; j <= length; j++)
     for (i = (j > turn ? (j - turn) : 1); i <= j; i++) {
@@ -273,39 +279,35 @@ fill_arrays(vrna_fold_compound_t *fc)
     return 0;
   }
 
-  for (i = length - turn - 1; i >= 1; i--) {
-    for (j = i + turn + 1; j <= length; j++) {
-      ij = indx[j] + i;
-
-      /* decompose subsegment [i, j] with pair (i, j) */
-      c[ij] = decompose_pair(fc, i, j, helper_arrays);
-
-      /* decompose subsegment [i, j] that is multibranch loop part with at least one branch */
-      e = vrna_E_ml_stems_fast(fc, i, j, helper_arrays->Fmi, helper_arrays->DMLi);
-
-      if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_m)) {
-        int ee = fc->aux_grammar->cb_aux_m(fc, i, j, fc->aux_grammar->data);
-        e = MIN2(e, ee);
-      }
-
-      fML[ij] = e;
-
-      if (uniq_ML) {
-        /* decompose subsegment [i, j] that is multibranch loop part with exactly one branch */
-        e = E_ml_rightmost_stem(i, j, fc);
-
-        if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_m1)) {
-          int ee = fc->aux_grammar->cb_aux_m1(fc, i, j, fc->aux_grammar->data);
-          e = MIN2(e, ee);
-        }
+  if (P->model_details.tile_size > 0) {
+    fill_tiles(fc, P->model_details.tile_size, helper_arrays);
+  } else if (helper_arrays->mode == AUX_WAVEFRONT) {
+    /*
+     *  process the matrices along anti-diagonals of constant span
+     *  d = j - i. All cells (i, i + d) only depend on cells with
+     *  smaller span, so we may compute them in parallel
+     */
+#ifdef _OPENMP
+#pragma omp parallel private(d, i)
+#endif
+    for (d = turn + 1; d < length; d++) {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i = 1; i <= length - d; i++)
+        fill_cell(fc, i, i + d, helper_arrays);
+      /* implicit barrier of the omp for directive completes the anti-diagonal */
+    }
+  } else {
+    for (i = length - turn - 1; i >= 1; i--) {
+      reset_aux_arrays(helper_arrays, i, length);
 
-        fM1[ij] = e;
-      }
-    } /* end of j-loop */
+      for (j = i + turn + 1; j <= length; j++)
+        fill_cell(fc, i, j, helper_arrays);
+    }
+  }
 
-    rotate_aux_arrays(helper_arrays, length);
-  } /* end of i-loop */
-    /* calculate energies of 5' fragments */
+  /* calculate energies of 5' fragments */
   (void)vrna_E_ext_loop_5(fc);
 
   /* clean up memory */
@@ -1693,7 +1695,8 @@ PRIVATE INLINE int
 decompose_pair(vrna_fold_compound_t *fc,
                int                  i,
                int                  j,
-               struct aux_arrays    *aux)
+               struct aux_arrays    *aux,
+               struct aux_cell      *cell)
 {
   unsigned char hc_decompose;
   int           e, new_c, energy, stackEnergy, ij, dangle_model, noLP,
@@ -1703,10 +1706,10 @@ decompose_pair(vrna_fold_compound_t *fc,
   dangle_model  = fc->params->model_details.dangles;
   noLP          = fc->params->model_details.noLP;
   hc_decompose  = fc->hc->matrix[ij];
-  DMLi1         = aux->DMLi1;
-  DMLi2         = aux->DMLi2;
-  cc            = aux->cc;
-  cc1           = aux->cc1;
+  DMLi1         = cell->DMLi1;
+  DMLi2         = cell->DMLi2;
+  cc            = (noLP) ? cell->cc : NULL;
+  cc1           = (noLP) ? cell->cc1 : NULL;
   e             = INF;
 
   /* do we evaluate this pair? */
@@ -1714,11 +1717,11 @@ decompose_pair(vrna_fold_compound_t *fc,
     new_c = INF;
 
     /* check for hairpin loop */
-    energy  = vrna_E_hp_loop(fc, i, j);
+    energy  = vrna_E_hp_loop_fast(fc, i, j, aux->hp);
     new_c   = MIN2(new_c, energy);
 
     /* check for multibranch loops */
-    energy  = vrna_E_mb_loop_fast(fc, i, j, DMLi1, DMLi2);
+    energy  = vrna_E_mb_loop_fast_aux(fc, i, j, DMLi1, DMLi2, aux->ml);
     new_c   = MIN2(new_c, energy);
 
     if (dangle_model == 3) {
@@ -1728,7 +1731,7 @@ decompose_pair(vrna_fold_compound_t *fc,
     }
 
     /* check for interior loops */
-    energy  = vrna_E_int_loop(fc, i, j);
+    energy  = vrna_E_int_loop_fast(fc, i, j, aux->il);
     new_c   = MIN2(new_c, energy);
 
     /* remember stack energy for --noLP option */
@@ -1758,54 +1761,87 @@ decompose_pair(vrna_fold_compound_t *fc,
 }
 
 
-PRIVATE INLINE struct aux_arrays *
-get_aux_arrays(unsigned int length)
+PRIVATE INLINE void
+fill_cell(vrna_fold_compound_t  *fc,
+          int                   i,
+          int                   j,
+          struct aux_arrays     *aux)
 {
-  unsigned int      j;
-  struct aux_arrays *aux = (struct aux_arrays *)vrna_alloc(sizeof(struct aux_arrays));
+  int             ij, e, ee, *c, *fML, *fM1;
+  struct aux_cell cell;
 
-  aux->cc     = (int *)vrna_alloc(sizeof(int) * (length + 2));  /* auxilary arrays for canonical structures     */
-  aux->cc1    = (int *)vrna_alloc(sizeof(int) * (length + 2));  /* auxilary arrays for canonical structures     */
-  aux->Fmi    = (int *)vrna_alloc(sizeof(int) * (length + 1));  /* holds row i of fML (avoids jumps in memory)  */
-  aux->DMLi   = (int *)vrna_alloc(sizeof(int) * (length + 1));  /* DMLi[j] holds  MIN(fML[i,k]+fML[k+1,j])      */
-  aux->DMLi1  = (int *)vrna_alloc(sizeof(int) * (length + 1));  /*                MIN(fML[i+1,k]+fML[k+1,j])    */
-  aux->DMLi2  = (int *)vrna_alloc(sizeof(int) * (length + 1));  /*                MIN(fML[i+2,k]+fML[k+1,j])    */
+  ij  = fc->jindx[j] + i;
+  c   = fc->matrices->c;
+  fML = fc->matrices->fML;
+  fM1 = fc->matrices->fM1;
 
-  /* prefill helper arrays */
-  for (j = 0; j <= length; j++)
-    aux->Fmi[j] = aux->DMLi[j] = aux->DMLi1[j] = aux->DMLi2[j] = INF;
+  get_aux_cell(fc, aux, i, j, &cell);
 
-  return aux;
-}
+  /* decompose subsegment [i, j] with pair (i, j) */
+  c[ij] = decompose_pair(fc, i, j, aux, &cell);
 
+  /* decompose subsegment [i, j] that is multibranch loop part with at least one branch */
+  e = vrna_E_ml_stems_fast_aux(fc, i, j, cell.Fmi, cell.DMLi, aux->ml);
 
-PRIVATE INLINE void
-rotate_aux_arrays(struct aux_arrays *aux,
-                  unsigned int      length)
-{
-  unsigned int  j;
-  int           *FF;
-
-  FF          = aux->DMLi2;
-  aux->DMLi2  = aux->DMLi1;
-  aux->DMLi1  = aux->DMLi;
-  aux->DMLi   = FF;
-  FF          = aux->cc1;
-  aux->cc1    = aux->cc;
-  aux->cc     = FF;
-  for (j = 1; j <= length; j++)
-    aux->cc[j] = aux->Fmi[j] = aux->DMLi[j] = INF;
+  store_aux_cell(aux, i, j, &cell);
+
+  if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_m)) {
+    ee  = fc->aux_grammar->cb_aux_m(fc, i, j, fc->aux_grammar->data);
+    e   = MIN2(e, ee);
+  }
+
+  fML[ij] = e;
+
+  if (fc->params->model_details.uniq_ML) {
+    /* decompose subsegment [i, j] that is multibranch loop part with exactly one branch */
+    e = vrna_E_ml_rightmost_stem_aux(fc, i, j, aux->ml);
+
+    if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_m1)) {
+      ee  = fc->aux_grammar->cb_aux_m1(fc, i, j, fc->aux_grammar->data);
+      e   = MIN2(e, ee);
+    }
+
+    fM1[ij] = e;
+  }
 }
 
 
-PRIVATE INLINE void
-free_aux_arrays(struct aux_arrays *aux)
+/*
+ *  Fill the matrices in square tiles of size tile_size x tile_size. A cell
+ *  (i, j) depends on cells (p, q) with i <= p < q <= j only, i.e. on cells
+ *  within the same tile or within tiles of a preceding anti-diagonal of
+ *  tiles. Within a tile, we process the cells row by row, starting from the
+ *  bottom row. Tiles of the same anti-diagonal are independent and are
+ *  distributed among the OpenMP threads
+ */
+PRIVATE void
+fill_tiles(vrna_fold_compound_t *fc,
+           int                  tile_size,
+           struct aux_arrays    *aux)
 {
-  free(aux->cc);
-  free(aux->cc1);
-  free(aux->Fmi);
-  free(aux->DMLi);
-  free(aux->DMLi1);
-  free(aux->DMLi2);
-  free(aux);
+  int i, j, d, t, num_tiles, i_min, i_max, j_min, j_max, length, turn;
+
+  length    = (int)fc->length;
+  turn      = fc->params->model_details.min_loop_size;
+  num_tiles = (length + tile_size - 1) / tile_size;
+
+#ifdef _OPENMP
+#pragma omp parallel private(d, t, i, j, i_min, i_max, j_min, j_max)
+#endif
+  for (d = 0; d < num_tiles; d++) {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+    for (t = 0; t < num_tiles - d; t++) {
+      i_min = t * tile_size + 1;
+      i_max = MIN2(i_min + tile_size - 1, length);
+      j_min = (t + d) * tile_size + 1;
+      j_max = MIN2(j_min + tile_size - 1, length);
+
+      for (i = i_max; i >= i_min; i--)
+        for (j = MAX2(j_min, i + turn + 1); j <= j_max; j++)
+          fill_cell(fc, i, j, aux);
+    }
+    /* implicit barrier of the omp for directive completes the anti-diagonal of tiles */
+  }
 }
@@ -37,6 +37,10 @@
 #include "ViennaRNA/utils/svm.h"
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifdef __GNUC__
 # define INLINE inline
 #else
@@ -47,6 +51,15 @@
 #define INT_CLOSE_TO_UNDERFLOW(i)   ((i) <= (INT_MIN / 16))
 #define UNDERFLOW_CORRECTION        (INT_MIN / 32)
 
+/*
+ *  Sequences are split into chunks of MFE_WINDOW_CHUNK_FACTOR times the
+ *  number of f3 values that determine all f3 values further upstream for
+ *  the multithreaded scan. Each chunk is extended towards its 3' end by
+ *  MFE_WINDOW_CHUNK_EXTENSION times that number
+ */
+#define MFE_WINDOW_CHUNK_FACTOR     128
+#define MFE_WINDOW_CHUNK_EXTENSION  16
+
 #define NONE -10000 /* score for forbidden pairs */
 
 
@@ -65,6 +78,43 @@ typedef struct {
 } zscoring_dat;
 #endif
 
+/* a local structure found during the scan */
+typedef struct {
+  int     i;          /* 5' end */
+  int     j;          /* 3' end of the local structure */
+  int     end;        /* 3' end including a dangling nucleotide */
+  int     en;         /* free energy in dcal/mol */
+  double  z;          /* z-score, if any */
+  char    *structure;
+} window_hit;
+
+/* local structures are only reported if the next one found does not contain them */
+typedef struct {
+  vrna_mfe_window_callback        *cb;
+#ifdef VRNA_WITH_SVM
+  vrna_mfe_window_zscore_callback *cb_z;
+#endif
+  void                            *data;
+  int                             n_seq;
+  window_hit                      prev;
+} hit_filter;
+
+/* local structures and boundary energies of a chunk scanned by vrna_mfe_window_cb_parallel() */
+typedef struct {
+  int             shift;      /* position in the sequence = position in the chunk + shift */
+  int             first;      /* first position the chunk reports local structures for */
+  int             last;       /* last position the chunk reports local structures for */
+  int             num_head;   /* number of f3 values stored in head */
+  int             num_tail;   /* number of f3 values stored in tail */
+  long long       *head;      /* f3[first], f3[first + 1], ... corrected for underflows */
+  long long       *tail;      /* f3[last + 1], f3[last + 2], ... corrected for underflows */
+  const long long *inject;    /* exact values that replace the tail, or NULL */
+  int             underflow;
+  window_hit      *hits;      /* candidate local structures in order of discovery */
+  int             num_hits;
+  int             max_hits;
+} window_chunk;
+
 /*
  #################################
  # GLOBAL VARIABLES              #
@@ -94,14 +144,13 @@ PRIVATE char
 
 
 PRIVATE int
-fill_arrays(vrna_fold_compound_t            *vc,
-            int                             *underflow,
-            vrna_mfe_window_callback        *cb,
+fill_arrays(vrna_fold_compound_t  *vc,
+            int                   *underflow,
 #ifdef VRNA_WITH_SVM
-            zscoring_dat                    *z_dat,
-            vrna_mfe_window_zscore_callback *cb_z,
+            zscoring_dat          *z_dat,
 #endif
-            void                            *data);
+            hit_filter            *filter,
+            window_chunk          *chunk);
 
 
 PRIVATE void
@@ -126,10 +175,10 @@ make_pscores(vrna_fold_compound_t *fc,
 
 
 PRIVATE int
-fill_arrays_comparative(vrna_fold_compound_t      *fc,
-                        int                       *underflow,
-                        vrna_mfe_window_callback  *cb,
-                        void                      *data);
+fill_arrays_comparative(vrna_fold_compound_t  *fc,
+                        int                   *underflow,
+                        hit_filter            *filter,
+                        window_chunk          *chunk);
 
 
 PRIVATE void
@@ -164,6 +213,87 @@ rotate_constraints(vrna_fold_compound_t *fc,
                    int                  i);
 
 
+PRIVATE float
+window_mfe(int  energy,
+           int  underflow,
+           int  n_seq);
+
+
+PRIVATE void
+hit_filter_init(hit_filter                *filter,
+                vrna_mfe_window_callback  *cb,
+                void                      *data,
+                int                       n_seq);
+
+
+PRIVATE void
+hit_filter_add(hit_filter *filter,
+               window_hit *hit);
+
+
+PRIVATE int
+hit_filter_flush(hit_filter *filter);
+
+
+PRIVATE void
+hit_filter_report(hit_filter  *filter,
+                  window_hit  *hit);
+
+
+PRIVATE unsigned int
+mfe_window_threads(vrna_fold_compound_t *fc,
+                   unsigned int         num_threads);
+
+
+PRIVATE int
+mfe_window_chunkable(vrna_fold_compound_t *fc);
+
+
+PRIVATE float
+mfe_window_parallel(vrna_fold_compound_t  *fc,
+#ifdef VRNA_WITH_SVM
+                    zscoring_dat          *zsc_data,
+#endif
+                    hit_filter            *filter,
+                    unsigned int          num_threads);
+
+
+PRIVATE window_chunk *
+window_chunk_scan(vrna_fold_compound_t  *fc,
+#ifdef VRNA_WITH_SVM
+                  zscoring_dat          *zsc_data,
+#endif
+                  int                   first,
+                  int                   last,
+                  const long long       *inject);
+
+
+PRIVATE void
+window_chunk_add(window_chunk *chunk,
+                 window_hit   *hit);
+
+
+PRIVATE void
+window_chunk_tail(window_chunk  *chunk,
+                  int           *f3,
+                  int           underflow);
+
+
+PRIVATE void
+window_chunk_head(window_chunk  *chunk,
+                  int           *f3,
+                  int           underflow);
+
+
+PRIVATE int
+window_chunk_synced(window_chunk    *chunk,
+                    const long long *exact);
+
+
+PRIVATE void
+window_chunk_free(window_chunk *chunk);
+
+
 #ifdef VRNA_WITH_SVM
 
 PRIVATE int
@@ -214,7 +344,7 @@ vrna_mfe_window_cb(vrna_fold_compound_t     *vc,
                    void                     *data)
 {
   int           energy, underflow, n_seq;
-  float         mfe_local;
+  hit_filter    filter;
 
 #ifdef VRNA_WITH_SVM
   zscoring_dat  z_dat;
@@ -228,24 +358,57 @@ vrna_mfe_window_cb(vrna_fold_compound_t     *vc,
   }
 
   if (vc->type == VRNA_FC_TYPE_COMPARATIVE) {
-    n_seq   = vc->n_seq;
-    energy  = fill_arrays_comparative(vc, &underflow, cb, data) / 100.;
-
-    mfe_local =
-      (underflow > 0) ? ((float)underflow * (float)(UNDERFLOW_CORRECTION)) / (100. * n_seq) : 0.;
-    mfe_local += (float)energy / (100. * n_seq);
+    n_seq = vc->n_seq;
+    hit_filter_init(&filter, cb, data, n_seq);
+    energy = fill_arrays_comparative(vc, &underflow, &filter, NULL);
   } else {
+    n_seq = 1;
+    hit_filter_init(&filter, cb, data, n_seq);
 #ifdef VRNA_WITH_SVM
     z_dat.with_zsc  = 0;
-    energy          = fill_arrays(vc, &underflow, cb, &z_dat, NULL, data);
+    energy          = fill_arrays(vc, &underflow, &z_dat, &filter, NULL);
 #else
-    energy = fill_arrays(vc, &underflow, cb, data);
+    energy = fill_arrays(vc, &underflow, &filter, NULL);
 #endif
-    mfe_local = (underflow > 0) ? ((float)underflow * (float)(UNDERFLOW_CORRECTION)) / 100. : 0.;
-    mfe_local += (float)energy / 100.;
   }
 
-  return mfe_local;
+  return window_mfe(energy, underflow, n_seq);
+}
+
+
+PUBLIC float
+vrna_mfe_window_cb_parallel(vrna_fold_compound_t      *vc,
+                            vrna_mfe_window_callback  *cb,
+                            void                      *data,
+                            unsigned int              num_threads)
+{
+  hit_filter    filter;
+
+#ifdef VRNA_WITH_SVM
+  zscoring_dat  z_dat;
+#endif
+
+  num_threads = mfe_window_threads(vc, num_threads);
+
+  if (num_threads < 2)
+    return vrna_mfe_window_cb(vc, cb, data);
+
+  if (!vrna_fold_compound_prepare(vc, VRNA_OPTION_MFE | VRNA_OPTION_WINDOW)) {
+    vrna_message_warning("vrna_mfe_window_cb_parallel: Failed to prepare vrna_fold_compound");
+    return (float)(INF / 100.);
+  }
+
+  hit_filter_init(&filter,
+                  cb,
+                  data,
+                  (vc->type == VRNA_FC_TYPE_COMPARATIVE) ? (int)vc->n_seq : 1);
+
+#ifdef VRNA_WITH_SVM
+  z_dat.with_zsc = 0;
+  return mfe_window_parallel(vc, &z_dat, &filter, num_threads);
+#else
+  return mfe_window_parallel(vc, &filter, num_threads);
+#endif
 }
 
 
@@ -272,8 +435,8 @@ vrna_mfe_window_zscore_cb(vrna_fold_compound_t            *vc,
                           void                            *data)
 {
   int           energy, underflow;
-  float         mfe_local;
   zscoring_dat  zsc_data;
+  hit_filter    filter;
 
   if (vc->type == VRNA_FC_TYPE_COMPARATIVE) {
     vrna_message_warning(
@@ -291,15 +454,60 @@ vrna_mfe_window_zscore_cb(vrna_fold_compound_t            *vc,
   zsc_data.sd_model   = svm_load_model_string(sd_model_string);
   zsc_data.min_z      = min_z;
 
+  hit_filter_init(&filter, NULL, data, 1);
+  filter.cb_z = cb_z;
+
   /* keep track of how many times we were close to an integer underflow */
   underflow = 0;
 
-  energy = fill_arrays(vc, &underflow, NULL, &zsc_data, cb_z, data);
+  energy = fill_arrays(vc, &underflow, &zsc_data, &filter, NULL);
   svm_free_model_content(zsc_data.avg_model);
   svm_free_model_content(zsc_data.sd_model);
 
-  mfe_local = (underflow > 0) ? ((float)underflow * (float)(UNDERFLOW_CORRECTION)) / 100. : 0.;
-  mfe_local += (float)energy / 100.;
+  return window_mfe(energy, underflow, 1);
+}
+
+
+PUBLIC float
+vrna_mfe_window_zscore_cb_parallel(vrna_fold_compound_t             *vc,
+                                   double                           min_z,
+                                   vrna_mfe_window_zscore_callback  *cb_z,
+                                   void                             *data,
+                                   unsigned int                     num_threads)
+{
+  float         mfe_local;
+  zscoring_dat  zsc_data;
+  hit_filter    filter;
+
+  if (vc->type == VRNA_FC_TYPE_COMPARATIVE) {
+    vrna_message_warning(
+      "vrna_mfe_window_zscore@mfe_window.c: Comparative prediction not implemented");
+    return (float)(INF / 100.);
+  }
+
+  num_threads = mfe_window_threads(vc, num_threads);
+
+  if (num_threads < 2)
+    return vrna_mfe_window_zscore_cb(vc, min_z, cb_z, data);
+
+  if (!vrna_fold_compound_prepare(vc, VRNA_OPTION_MFE | VRNA_OPTION_WINDOW)) {
+    vrna_message_warning("vrna_mfe_window_zscore_cb_parallel: Failed to prepare vrna_fold_compound");
+    return (float)(INF / 100.);
+  }
+
+  /* the regression models are shared by all chunks, and only read during the scan */
+  zsc_data.with_zsc   = 1;
+  zsc_data.avg_model  = svm_load_model_string(avg_model_string);
+  zsc_data.sd_model   = svm_load_model_string(sd_model_string);
+  zsc_data.min_z      = min_z;
+
+  hit_filter_init(&filter, NULL, data, 1);
+  filter.cb_z = cb_z;
+
+  mfe_local = mfe_window_parallel(vc, &zsc_data, &filter, num_threads);
+
+  svm_free_model_content(zsc_data.avg_model);
+  svm_free_model_content(zsc_data.sd_model);
 
   return mfe_local;
 }
@@ -561,27 +769,21 @@ rotate_constraints(vrna_fold_compound_t *fc,
 
 
 PRIVATE int
-fill_arrays(vrna_fold_compound_t            *vc,
-            int                             *underflow,
-            vrna_mfe_window_callback        *cb,
+fill_arrays(vrna_fold_compound_t  *vc,
+            int                   *underflow,
 #ifdef VRNA_WITH_SVM
-            zscoring_dat                    *zsc_data,
-            vrna_mfe_window_zscore_callback *cb_z,
+            zscoring_dat          *zsc_data,
 #endif
-            void                            *data)
+            hit_filter            *filter,
+            window_chunk          *chunk)
 {
   /* fill "c", "fML" and "f3" arrays and return  optimal energy */
 
-  char          **ptype, *prev;
+  char          **ptype;
   unsigned char hc_decompose;
   int           i, j, length, energy, maxdist, **c, **fML, *f3, no_close,
                 type, with_gquad, dangle_model, noLP, noGUclosure, turn,
-                *cc, *cc1, *Fmi, *DMLi, *DMLi1, *DMLi2, prev_i, prev_j,
-                prev_end, prev_en, new_c, stackEnergy;
-
-#ifdef VRNA_WITH_SVM
-  double        prevz;
-#endif
+                *cc, *cc1, *Fmi, *DMLi, *DMLi1, *DMLi2, new_c, stackEnergy;
   vrna_param_t  *P;
   vrna_md_t     *md;
   vrna_hc_t     *hc;
@@ -598,14 +800,6 @@ fill_arrays(vrna_fold_compound_t            *vc,
   turn          = md->min_loop_size;
   hc            = vc->hc;
   do_backtrack  = 0;
-  prev_i        = 0;
-  prev_j        = 0;
-  prev_end      = 0;
-  prev          = NULL;
-  prev_en       = 0;
-#ifdef VRNA_WITH_SVM
-  prevz = 0.;
-#endif
 
   c   = vc->matrices->c_local;
   fML = vc->matrices->fML_local;
@@ -682,101 +876,82 @@ fill_arrays(vrna_fold_compound_t            *vc,
     } /* for (j...) */
 
     /* calculate energies of 5' and 3' fragments */
+    if ((chunk) && (i == chunk->last))
+      window_chunk_tail(chunk, f3, *underflow);
+
     f3[i] = vrna_E_ext_loop_3(vc, i);
-    {
-      char *ss = NULL;
-
-      if (f3[i] < f3[i + 1]) {
-        /*
-         * instead of backtracing in the next iteration, we backtrack now
-         * already. This is necessary to accomodate for change in free
-         * energy due to unpaired nucleotides in the exterior loop, which
-         * may happen in the case of using soft constraints
-         */
-        int ii, jj;
-        ii  = i;
-        jj  = vrna_BT_ext_loop_f3_pp(vc, &ii, maxdist);
-        if (jj > 0) {
-#ifdef VRNA_WITH_SVM
-          double thisz = 0;
-          if (want_backtrack(vc, ii, jj, zsc_data, &thisz)) {
-#endif
-          ss = backtrack(vc, ii, jj);
-          if (prev) {
-            if ((jj < prev_j) || (strncmp(ss + prev_i - ii, prev, prev_j - prev_i + 1))) {
-              /* ss does not contain prev */
+
+    if ((f3[i] < f3[i + 1]) &&
+        ((!chunk) || ((i >= chunk->first) && (i <= chunk->last)))) {
+      /*
+       * instead of backtracing in the next iteration, we backtrack now
+       * already. This is necessary to accomodate for change in free
+       * energy due to unpaired nucleotides in the exterior loop, which
+       * may happen in the case of using soft constraints
+       */
+      int ii, jj;
+      ii  = i;
+      jj  = vrna_BT_ext_loop_f3_pp(vc, &ii, maxdist);
+      if (jj > 0) {
+        window_hit hit;
+
+        hit.z = 0.;
 #ifdef VRNA_WITH_SVM
-              if (zsc_data->with_zsc)
-                cb_z(prev_i, prev_end, prev, prev_en / 100., prevz, data);
-              else
+        if (want_backtrack(vc, ii, jj, zsc_data, &(hit.z))) {
 #endif
-              cb(prev_i, prev_end, prev, prev_en / 100., data);
-            }
+        hit.i         = ii;
+        hit.j         = jj;
+        hit.end       = MIN2(jj + ((dangle_model) ? 1 : 0), length);
+        hit.en        = f3[ii] - f3[jj + 1];
+        hit.structure = backtrack(vc, ii, jj);
 
-            free(prev);
-          }
+        if (chunk)
+          window_chunk_add(chunk, &hit);
+        else
+          hit_filter_add(filter, &hit);
 
-          prev      = ss;
-          prev_i    = ii;
-          prev_j    = jj;
-          prev_end  = MIN2(jj + ((dangle_model) ? 1 : 0), length);
-          prev_en   = f3[ii] - f3[jj + 1];
 #ifdef VRNA_WITH_SVM
-          prevz = thisz;
-        }
-
-#endif
-        } else if (jj == -1) {
-          /* some error occured during backtracking */
-          vrna_message_error("backtrack failed in short backtrack 1");
-        }
       }
 
-      if (i == 1) {
-        if (prev) {
-#ifdef VRNA_WITH_SVM
-          if (zsc_data->with_zsc)
-            cb_z(prev_i, prev_end, prev, prev_en / 100., prevz, data);
-          else
 #endif
-          cb(prev_i, prev_end, prev, prev_en / 100., data);
+      } else if (jj == -1) {
+        /* some error occured during backtracking */
+        vrna_message_error("backtrack failed in short backtrack 1");
+      }
+    }
 
-          free(prev);
-          prev = NULL;
+    /*
+     * chunks leave the final report to mfe_window_parallel(). Since they
+     * are scanned without soft constraints, each decrease of f3 yields a
+     * hit, and the case below never applies to them
+     */
+    if ((i == 1) &&
+        (!chunk) &&
+        (!hit_filter_flush(filter)) &&
 #ifdef VRNA_WITH_SVM
-        } else if ((f3[i] < 0) && (!zsc_data->with_zsc)) {
+        (f3[i] < 0) && (!zsc_data->with_zsc)) {
 #else
-        } else if (f3[i] < 0) {
-#endif
-          /* why !zsc? */
-          int ii, jj;
-          ii  = i;
-          jj  = vrna_BT_ext_loop_f3_pp(vc, &ii, maxdist);
-          if (jj > 0) {
-#ifdef VRNA_WITH_SVM
-            double thisz = 0;
-            if (want_backtrack(vc, ii, jj, zsc_data, &thisz)) {
-#endif
-            ss = backtrack(vc, ii, jj);
-#ifdef VRNA_WITH_SVM
-            if (zsc_data->with_zsc)
-              cb_z(ii, MIN2(jj + ((dangle_model) ? 1 : 0),
-                            length), ss, (f3[1] - f3[jj + 1]) / 100., thisz, data);
-            else
+        (f3[i] < 0)) {
 #endif
-            cb(ii, MIN2(jj + ((dangle_model) ? 1 : 0),
-                        length), ss, (f3[1] - f3[jj + 1]) / 100., data);
+      /* why !zsc? */
+      int ii, jj;
+      ii  = i;
+      jj  = vrna_BT_ext_loop_f3_pp(vc, &ii, maxdist);
+      if (jj > 0) {
+        window_hit hit;
 
-            free(ss);
-#ifdef VRNA_WITH_SVM
-          }
+        hit.i         = ii;
+        hit.j         = jj;
+        hit.end       = MIN2(jj + ((dangle_model) ? 1 : 0), length);
+        hit.en        = f3[1] - f3[jj + 1];
+        hit.z         = 0.;
+        hit.structure = backtrack(vc, ii, jj);
 
-#endif
-          } else if (jj == -1) {
-            /* some error occured during backtracking */
-            vrna_message_error("backtrack failed in short backtrack 2");
-          }
-        }
+        hit_filter_report(filter, &hit);
+        free(hit.structure);
+      } else if (jj == -1) {
+        /* some error occured during backtracking */
+        vrna_message_error("backtrack failed in short backtrack 2");
       }
     }
 
@@ -805,6 +980,9 @@ fill_arrays(vrna_fold_compound_t            *vc,
       rotate_dp_matrices(vc, i);
       rotate_constraints(vc, NULL, i);
     }
+
+    if ((chunk) && (i == chunk->first))
+      window_chunk_head(chunk, f3, *underflow);
   }
 
   free(cc);
@@ -1094,20 +1272,18 @@ repeat1:
 
 
 PRIVATE int
-fill_arrays_comparative(vrna_fold_compound_t      *fc,
-                        int                       *underflow,
-                        vrna_mfe_window_callback  *cb,
-                        void                      *data)
+fill_arrays_comparative(vrna_fold_compound_t  *fc,
+                        int                   *underflow,
+                        hit_filter            *filter,
+                        window_chunk          *chunk)
 {
   /* fill "c", "fML" and "f3" arrays and return  optimal energy */
   short **S;
-  char **strings, *prev, *ss;
+  char **strings;
   int **pscore, i, j, length, energy, turn, n_seq, **c,
       **fML, *f3, *cc, *cc1, *Fmi, *DMLi, *DMLi1, *DMLi2,
-      maxdist, prev_i, prev_j, prev_en, prev_end, with_gquad,
-      new_c, psc, stackEnergy, dangle_model;
+      maxdist, with_gquad, new_c, psc, stackEnergy, dangle_model;
   float **dm;
-  vrna_mx_mfe_t *matrices;
   vrna_param_t *P;
   vrna_md_t *md;
   vrna_hc_t *hc;
@@ -1121,21 +1297,13 @@ fill_arrays_comparative(vrna_fold_compound_t      *fc,
                       { 0, 2, 2, 2, 1, 2, 0 } /* UA */ };
 
   do_backtrack  = 0;
-  prev_i        = 0;
-  prev_j        = 0;
-  prev_end      = 0;
-  prev_en       = INF;
-
-  dm    = NULL;
-  prev  = NULL;
-  ss    = NULL;
+  dm            = NULL;
 
   strings       = fc->sequences;
   S             = fc->S;
   n_seq         = fc->n_seq;
   length        = fc->length;
   maxdist       = fc->window_size;
-  matrices      = fc->matrices;
   hc            = fc->hc;
   P             = fc->params;
   md            = &(P->model_details);
@@ -1225,9 +1393,13 @@ fill_arrays_comparative(vrna_fold_compound_t      *fc,
     } /* for (j...) */
 
     /* calculate energies of 5' and 3' fragments */
+    if ((chunk) && (i == chunk->last))
+      window_chunk_tail(chunk, f3, *underflow);
+
     f3[i] = vrna_E_ext_loop_3(fc, i);
 
-    if (f3[i] < f3[i + 1]) {
+    if ((f3[i] < f3[i + 1]) &&
+        ((!chunk) || ((i >= chunk->first) && (i <= chunk->last)))) {
       /*
        * instead of backtracing in the next iteration, we backtrack now
        * already. This is necessary to accomodate for change in free
@@ -1238,46 +1410,47 @@ fill_arrays_comparative(vrna_fold_compound_t      *fc,
       ii  = i;
       jj  = vrna_BT_ext_loop_f3_pp(fc, &ii, maxdist);
       if (jj > 0) {
-        ss = backtrack(fc, ii, jj);
-        if (prev) {
-          if ((jj < prev_j) || (strncmp(ss + prev_i - ii, prev, prev_j - prev_i + 1)))
-            /* ss does not contain prev */
-            cb(prev_i, prev_end, prev, prev_en / (100. * n_seq), data);
-
-          free(prev);
-        }
-
-        prev      = ss;
-        prev_i    = ii;
-        prev_j    = jj;
-        prev_end  = MIN2(jj + ((dangle_model) ? 1 : 0), length);
-        prev_en   = f3[ii] - f3[jj + 1];
+        window_hit hit;
+
+        hit.i         = ii;
+        hit.j         = jj;
+        hit.end       = MIN2(jj + ((dangle_model) ? 1 : 0), length);
+        hit.en        = f3[ii] - f3[jj + 1];
+        hit.z         = 0.;
+        hit.structure = backtrack(fc, ii, jj);
+
+        if (chunk)
+          window_chunk_add(chunk, &hit);
+        else
+          hit_filter_add(filter, &hit);
       } else if (jj == -1) {
         /* some error occured during backtracking */
         vrna_message_error("backtrack failed in short backtrack 1");
       }
     }
 
-    if (i == 1) {
-      if (prev) {
-        cb(prev_i, prev_end, prev, prev_en / (100. * n_seq), data);
-
-        free(prev);
-        prev = NULL;
-      } else if (f3[i] < 0) {
-        int ii, jj;
-        ii  = i;
-        jj  = vrna_BT_ext_loop_f3_pp(fc, &ii, maxdist);
-        if (jj > 0) {
-          ss = backtrack(fc, ii, jj);
-          cb(ii, MIN2(jj + ((dangle_model) ? 1 : 0),
-                      length), ss, (f3[1] - f3[jj + 1]) / (100. * n_seq), data);
-
-          free(ss);
-        } else if (jj == -1) {
-          /* some error occured during backtracking */
-          vrna_message_error("backtrack failed in short backtrack 2");
-        }
+    if ((i == 1) &&
+        (!chunk) &&
+        (!hit_filter_flush(filter)) &&
+        (f3[i] < 0)) {
+      int ii, jj;
+      ii  = i;
+      jj  = vrna_BT_ext_loop_f3_pp(fc, &ii, maxdist);
+      if (jj > 0) {
+        window_hit hit;
+
+        hit.i         = ii;
+        hit.j         = jj;
+        hit.end       = MIN2(jj + ((dangle_model) ? 1 : 0), length);
+        hit.en        = f3[1] - f3[jj + 1];
+        hit.z         = 0.;
+        hit.structure = backtrack(fc, ii, jj);
+
+        hit_filter_report(filter, &hit);
+        free(hit.structure);
+      } else if (jj == -1) {
+        /* some error occured during backtracking */
+        vrna_message_error("backtrack failed in short backtrack 2");
       }
     }
 
@@ -1306,6 +1479,9 @@ fill_arrays_comparative(vrna_fold_compound_t      *fc,
       rotate_dp_matrices(fc, i);
       rotate_constraints(fc, dm, i);
     }
+
+    if ((chunk) && (i == chunk->first))
+      window_chunk_head(chunk, f3, *underflow);
   }
 
   free(cc);
@@ -1321,7 +1497,7 @@ fill_arrays_comparative(vrna_fold_compound_t      *fc,
 
   free_dp_matrices(fc);
 
-  return matrices->f3[1];
+  return f3[1];
 }
 
 
@@ -1454,6 +1630,444 @@ make_pscores(vrna_fold_compound_t *fc,
 }
 
 
+PRIVATE float
+window_mfe(int  energy,
+           int  underflow,
+           int  n_seq)
+{
+  float mfe_local;
+
+  mfe_local =
+    (underflow > 0) ? ((float)underflow * (float)(UNDERFLOW_CORRECTION)) / (100. * n_seq) : 0.;
+  mfe_local += (float)energy / (100. * n_seq);
+
+  return mfe_local;
+}
+
+
+PRIVATE void
+hit_filter_init(hit_filter                *filter,
+                vrna_mfe_window_callback  *cb,
+                void                      *data,
+                int                       n_seq)
+{
+  filter->cb              = cb;
+#ifdef VRNA_WITH_SVM
+  filter->cb_z            = NULL;
+#endif
+  filter->data            = data;
+  filter->n_seq           = n_seq;
+  filter->prev.structure  = NULL;
+}
+
+
+PRIVATE void
+hit_filter_add(hit_filter *filter,
+               window_hit *hit)
+{
+  window_hit *prev = &(filter->prev);
+
+  if (prev->structure) {
+    if ((hit->j < prev->j) ||
+        (strncmp(hit->structure + prev->i - hit->i, prev->structure, prev->j - prev->i + 1)))
+      /* hit does not contain prev */
+      hit_filter_report(filter, prev);
+
+    free(prev->structure);
+  }
+
+  *prev = *hit;
+}
+
+
+PRIVATE int
+hit_filter_flush(hit_filter *filter)
+{
+  if (filter->prev.structure) {
+    hit_filter_report(filter, &(filter->prev));
+    free(filter->prev.structure);
+    filter->prev.structure = NULL;
+    return 1;
+  }
+
+  return 0;
+}
+
+
+PRIVATE void
+hit_filter_report(hit_filter  *filter,
+                  window_hit  *hit)
+{
+#ifdef VRNA_WITH_SVM
+  if (filter->cb_z)
+    filter->cb_z(hit->i,
+                 hit->end,
+                 hit->structure,
+                 hit->en / (100. * filter->n_seq),
+                 hit->z,
+                 filter->data);
+  else
+#endif
+  filter->cb(hit->i,
+             hit->end,
+             hit->structure,
+             hit->en / (100. * filter->n_seq),
+             filter->data);
+}
+
+
+PRIVATE unsigned int
+mfe_window_threads(vrna_fold_compound_t *fc,
+                   unsigned int         num_threads)
+{
+  int chunk_size;
+
+#ifdef _OPENMP
+  if (num_threads == 0)
+    num_threads = (unsigned int)omp_get_max_threads();
+
+#else
+  num_threads = 1;
+#endif
+
+  chunk_size = MFE_WINDOW_CHUNK_FACTOR * (fc->window_size + 3);
+
+  if (((int)fc->length < 2 * chunk_size) ||
+      (!mfe_window_chunkable(fc)))
+    return 1;
+
+  return num_threads;
+}
+
+
+PRIVATE int
+mfe_window_chunkable(vrna_fold_compound_t *fc)
+{
+  vrna_hc_t *hc;
+
+  /* chunks are folded without constraints or any other extensions */
+  hc = fc->hc;
+
+  if ((hc) &&
+      ((hc->up_storage) || (hc->bp_storage) || (hc->f)))
+    return 0;
+
+  switch (fc->type) {
+    case VRNA_FC_TYPE_SINGLE:
+      if ((fc->sc) || (fc->domains_up))
+        return 0;
+
+      break;
+
+    case VRNA_FC_TYPE_COMPARATIVE:
+      /* RIBOSUM scoring matrices are selected for the entire alignment */
+      if ((fc->scs) || (fc->params->model_details.ribo))
+        return 0;
+
+      break;
+
+    default:
+      return 0;
+  }
+
+  return 1;
+}
+
+
+PRIVATE float
+mfe_window_parallel(vrna_fold_compound_t  *fc,
+#ifdef VRNA_WITH_SVM
+                    zscoring_dat          *zsc_data,
+#endif
+                    hit_filter            *filter,
+                    unsigned int          num_threads)
+{
+  int       k, n, chunk_size, num_chunks, energy, underflow, failed;
+  long long mfe, *exact;
+
+  n           = (int)fc->length;
+  chunk_size  = MFE_WINDOW_CHUNK_FACTOR * (fc->window_size + 3);
+  num_chunks  = (n + chunk_size - 1) / chunk_size;
+  mfe         = 0;
+  exact       = NULL;
+  failed      = 0;
+
+  /*
+   *  f3[i] only depends on the nucleotides downstream of i. The last
+   *  window size + 3 values of f3 of a chunk that are computed before its
+   *  5' part thus determine all f3 values of its 5' part, apart from a
+   *  constant offset. Chunks are scanned concurrently, and merged in the
+   *  order of the serial scan, i.e. from the 3' to the 5' end. Once the
+   *  3' neighbor of a chunk is merged, the f3 values at the start of that
+   *  neighbor are exact. If they disagree with those of the chunk, the
+   *  chunk is scanned again with the exact values injected.
+   */
+#pragma omp parallel for ordered schedule(dynamic, 1) num_threads(num_threads)
+  for (k = 0; k < num_chunks; k++) {
+    int           c, h, first, last;
+    window_chunk  *chunk;
+
+    c     = num_chunks - 1 - k;
+    first = c * chunk_size + 1;
+    last  = MIN2(n, first + chunk_size - 1);
+
+#ifdef VRNA_WITH_SVM
+    chunk = window_chunk_scan(fc, zsc_data, first, last, NULL);
+#else
+    chunk = window_chunk_scan(fc, first, last, NULL);
+#endif
+
+#pragma omp ordered
+    {
+      if ((chunk) &&
+          (exact) &&
+          (!window_chunk_synced(chunk, exact))) {
+        window_chunk_free(chunk);
+#ifdef VRNA_WITH_SVM
+        chunk = window_chunk_scan(fc, zsc_data, first, last, exact);
+#else
+        chunk = window_chunk_scan(fc, first, last, exact);
+#endif
+      }
+
+      if (!chunk)
+        failed = 1;
+
+      if (!failed) {
+        /* candidates are passed through the filter in the order of the serial scan */
+        for (h = 0; h < chunk->num_hits; h++)
+          hit_filter_add(filter, &(chunk->hits[h]));
+
+        chunk->num_hits = 0;
+
+        mfe += chunk->head[0] - ((chunk->num_tail > 0) ? chunk->tail[0] : 0);
+
+        free(exact);
+        exact       = chunk->head;
+        chunk->head = NULL;
+      }
+
+      window_chunk_free(chunk);
+    }
+  }
+
+  hit_filter_flush(filter);
+  free(exact);
+
+  if (failed)
+    return (float)(INF / 100.);
+
+  /* mimic the underflow corrections of the serial scan, f3 decreases monotonically */
+  for (underflow = 0;
+       INT_CLOSE_TO_UNDERFLOW(mfe - (long long)underflow * UNDERFLOW_CORRECTION);
+       underflow++);
+
+  energy = (int)(mfe - (long long)underflow * UNDERFLOW_CORRECTION);
+
+  return window_mfe(energy, underflow, filter->n_seq);
+}
+
+
+PRIVATE window_chunk *
+window_chunk_scan(vrna_fold_compound_t  *fc,
+#ifdef VRNA_WITH_SVM
+                  zscoring_dat          *zsc_data,
+#endif
+                  int                   first,
+                  int                   last,
+                  const long long       *inject)
+{
+  char                  *sequence, **alignment;
+  unsigned int          s, n_seq;
+  int                   n, h, start, end, boundary, length;
+  vrna_md_t             md;
+  vrna_fold_compound_t  *chunk_fc;
+  window_chunk          *chunk;
+
+  n         = (int)fc->length;
+  boundary  = fc->window_size + 3;
+  start     = MAX2(1, first - 1);
+  end       = MIN2(n, last + MFE_WINDOW_CHUNK_EXTENSION * boundary);
+  sequence  = NULL;
+  alignment = NULL;
+  n_seq     = 0;
+
+  vrna_md_copy(&md, &(fc->params->model_details));
+
+  switch (fc->type) {
+    case VRNA_FC_TYPE_SINGLE:
+      sequence = (char *)vrna_alloc(sizeof(char) * (end - start + 2));
+      memcpy(sequence, fc->sequence + start - 1, sizeof(char) * (end - start + 1));
+      chunk_fc = vrna_fold_compound(sequence, &md, VRNA_OPTION_MFE | VRNA_OPTION_WINDOW);
+      break;
+
+    case VRNA_FC_TYPE_COMPARATIVE:
+      n_seq = fc->n_seq;
+
+      /*
+       *  The energy contributions of an alignment column depend on the
+       *  adjacent nucleotides of each sequence, regardless of any gaps in
+       *  between. Thus, extend the chunk until each sequence has at least
+       *  two nucleotides on either side of the columns we are interested in
+       */
+      for (s = 0; s < n_seq; s++) {
+        while ((start > 1) &&
+               (fc->a2s[s][first - 1] < fc->a2s[s][start - 1] + 2))
+          start--;
+
+        while ((end < n) &&
+               (fc->a2s[s][end] < fc->a2s[s][last + fc->window_size] + 2))
+          end++;
+      }
+
+      alignment = (char **)vrna_alloc(sizeof(char *) * (n_seq + 1));
+      for (s = 0; s < n_seq; s++) {
+        alignment[s] = (char *)vrna_alloc(sizeof(char) * (end - start + 2));
+        memcpy(alignment[s], fc->sequences[s] + start - 1, sizeof(char) * (end - start + 1));
+      }
+
+      chunk_fc = vrna_fold_compound_comparative((const char **)alignment,
+                                                &md,
+                                                VRNA_OPTION_MFE | VRNA_OPTION_WINDOW);
+      break;
+
+    default:
+      return NULL;
+  }
+
+  chunk = NULL;
+
+  if (chunk_fc) {
+    /* use the exact same energy parameters as for the entire sequence */
+    vrna_params_subst(chunk_fc, fc->params);
+
+    if (vrna_fold_compound_prepare(chunk_fc, VRNA_OPTION_MFE | VRNA_OPTION_WINDOW)) {
+      length = (int)chunk_fc->length;
+
+      chunk             = (window_chunk *)vrna_alloc(sizeof(window_chunk));
+      chunk->shift      = start - 1;
+      chunk->first      = first - chunk->shift;
+      chunk->last       = last - chunk->shift;
+      chunk->num_head   = MIN2(boundary, length - chunk->first + 1);
+      chunk->num_tail   = MIN2(boundary, length - chunk->last);
+      chunk->head       = (long long *)vrna_alloc(sizeof(long long) * boundary);
+      chunk->tail       = (long long *)vrna_alloc(sizeof(long long) * boundary);
+      chunk->inject     = inject;
+      chunk->underflow  = 0;
+      chunk->hits       = NULL;
+      chunk->num_hits   = 0;
+      chunk->max_hits   = 0;
+
+      if (fc->type == VRNA_FC_TYPE_COMPARATIVE)
+        (void)fill_arrays_comparative(chunk_fc, &(chunk->underflow), NULL, chunk);
+      else
+#ifdef VRNA_WITH_SVM
+        (void)fill_arrays(chunk_fc, &(chunk->underflow), zsc_data, NULL, chunk);
+#else
+        (void)fill_arrays(chunk_fc, &(chunk->underflow), NULL, chunk);
+#endif
+
+      chunk->inject = NULL;
+
+      for (h = 0; h < chunk->num_hits; h++) {
+        chunk->hits[h].i    += chunk->shift;
+        chunk->hits[h].j    += chunk->shift;
+        chunk->hits[h].end  += chunk->shift;
+      }
+    }
+
+    vrna_fold_compound_free(chunk_fc);
+  }
+
+  free(sequence);
+  if (alignment) {
+    for (s = 0; s < n_seq; s++)
+      free(alignment[s]);
+    free(alignment);
+  }
+
+  return chunk;
+}
+
+
+PRIVATE void
+window_chunk_add(window_chunk *chunk,
+                 window_hit   *hit)
+{
+  if (chunk->num_hits == chunk->max_hits) {
+    chunk->max_hits = (chunk->max_hits > 0) ? 2 * chunk->max_hits : 64;
+    chunk->hits     = (window_hit *)vrna_realloc(chunk->hits,
+                                                 sizeof(window_hit) * chunk->max_hits);
+  }
+
+  chunk->hits[chunk->num_hits++] = *hit;
+}
+
+
+PRIVATE void
+window_chunk_tail(window_chunk  *chunk,
+                  int           *f3,
+                  int           underflow)
+{
+  int k, p;
+
+  /* all underflow corrections so far included f3[last + 1...last + boundary] */
+  p = chunk->last + 1;
+
+  for (k = 0; k < chunk->num_tail; k++)
+    chunk->tail[k] = (long long)f3[p + k] + (long long)underflow * UNDERFLOW_CORRECTION;
+
+  if (chunk->inject)
+    for (k = 1; k < chunk->num_tail; k++)
+      f3[p + k] = f3[p] + (int)(chunk->inject[k] - chunk->inject[0]);
+}
+
+
+PRIVATE void
+window_chunk_head(window_chunk  *chunk,
+                  int           *f3,
+                  int           underflow)
+{
+  int k, p;
+
+  p = chunk->first;
+
+  for (k = 0; k < chunk->num_head; k++)
+    chunk->head[k] = (long long)f3[p + k] + (long long)underflow * UNDERFLOW_CORRECTION;
+}
+
+
+PRIVATE int
+window_chunk_synced(window_chunk    *chunk,
+                    const long long *exact)
+{
+  int k;
+
+  for (k = 1; k < chunk->num_tail; k++)
+    if (chunk->tail[k] - chunk->tail[0] != exact[k] - exact[0])
+      return 0;
+
+  return 1;
+}
+
+
+PRIVATE void
+window_chunk_free(window_chunk *chunk)
+{
+  int h;
+
+  if (chunk) {
+    for (h = 0; h < chunk->num_hits; h++)
+      free(chunk->hits[h].structure);
+
+    free(chunk->hits);
+    free(chunk->head);
+    free(chunk->tail);
+    free(chunk);
+  }
+}
+
+
 PRIVATE void
 default_callback(int        start,
                  int        end,
@@ -111,6 +111,36 @@ float vrna_mfe_window_cb(vrna_fold_compound_t     *vc,
                          vrna_mfe_window_callback *cb,
                          void                     *data);
 
+
+/**
+ *  @brief Local MFE prediction using a sliding window approach and multiple threads
+ *
+ *  Same as vrna_mfe_window_cb(), but long sequences and alignments are split into
+ *  chunks that are scanned concurrently by @p num_threads threads. Each chunk is
+ *  extended towards its 3' end, such that the free energies of its 5' part usually
+ *  agree with those of a scan of the entire input. The chunks are merged from the 3'
+ *  to the 5' end, where any chunk whose free energies disagree with those of its
+ *  already merged 3' neighbor is scanned again. The local structures, the order they
+ *  are passed to the callback @p cb, and the returned free energy are thus identical
+ *  to those of vrna_mfe_window_cb(). The callback is never executed concurrently.
+ *
+ *  Inputs that are too short to be split, fold compounds with hard or soft constraints,
+ *  or unstructured domains, and alignments scored by RIBOSUM matrices are processed by
+ *  vrna_mfe_window_cb() instead.
+ *
+ *  @see  vrna_mfe_window_cb(), vrna_mfe_window_zscore_cb_parallel()
+ *
+ *  @param  vc          The #vrna_fold_compound_t with preallocated memory for the DP matrices
+ *  @param  cb          The callback function that receives the local structures
+ *  @param  data        Some arbitrary data structure that is passed to the callback @p cb
+ *  @param  num_threads Number of threads to use (0 for the maximum number of OpenMP threads)
+ *  @return             The minimum free energy of the entire input
+ */
+float vrna_mfe_window_cb_parallel(vrna_fold_compound_t      *vc,
+                                  vrna_mfe_window_callback  *cb,
+                                  void                      *data,
+                                  unsigned int              num_threads);
+
 #ifdef VRNA_WITH_SVM
 /**
  *  @brief Local MFE prediction using a sliding window approach (with z-score cut-off)
@@ -147,6 +177,28 @@ float vrna_mfe_window_zscore_cb(vrna_fold_compound_t            *vc,
                                 vrna_mfe_window_zscore_callback *cb,
                                 void                            *data);
 
+
+/**
+ *  @brief Local MFE prediction using a sliding window approach and multiple threads (with z-score cut-off)
+ *
+ *  This is the z-score version of vrna_mfe_window_cb_parallel(). Its output is
+ *  identical to that of vrna_mfe_window_zscore_cb().
+ *
+ *  @see  vrna_mfe_window_zscore_cb(), vrna_mfe_window_cb_parallel()
+ *
+ *  @param  vc          The #vrna_fold_compound_t with preallocated memory for the DP matrices
+ *  @param  min_z       The minimal z-score for a predicted structure to appear in the output
+ *  @param  cb          The callback function that receives the local structures
+ *  @param  data        Some arbitrary data structure that is passed to the callback @p cb
+ *  @param  num_threads Number of threads to use (0 for the maximum number of OpenMP threads)
+ *  @return             The minimum free energy of the entire input
+ */
+float vrna_mfe_window_zscore_cb_parallel(vrna_fold_compound_t             *vc,
+                                         double                           min_z,
+                                         vrna_mfe_window_zscore_callback  *cb,
+                                         void                             *data,
+                                         unsigned int                     num_threads);
+
 #endif
 
 /* End basic local MFE interface */
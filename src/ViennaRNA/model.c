@@ -133,7 +133,10 @@ PRIVATE vrna_md_t defaults = {
     { 0, 0,  0, 0, 0, 0, 2, 0 },
     { 0, 0,  0, 0, 0, 1, 0, 0 },
     { 0, 6,  0, 0, 5, 0, 0, 0 }
-  }
+  },
+  VRNA_MODEL_DEFAULT_WAVEFRONT,
+  VRNA_MODEL_DEFAULT_PF_LOGSPACE,
+  VRNA_MODEL_DEFAULT_TILE_SIZE
 };
 
 /*
@@ -333,6 +336,9 @@ vrna_md_defaults_reset(vrna_md_t *md_p)
   defaults.temperature      = VRNA_MODEL_DEFAULT_TEMPERATURE;
   defaults.betaScale        = VRNA_MODEL_DEFAULT_BETA_SCALE;
   defaults.sfact            = 1.07;
+  defaults.wavefront        = VRNA_MODEL_DEFAULT_WAVEFRONT;
+  defaults.pf_logspace      = VRNA_MODEL_DEFAULT_PF_LOGSPACE;
+  defaults.tile_size        = VRNA_MODEL_DEFAULT_TILE_SIZE;
   defaults.nonstandards[0]  = '\0';
 
   if (md_p) {
@@ -366,6 +372,9 @@ vrna_md_defaults_reset(vrna_md_t *md_p)
     vrna_md_defaults_temperature(md_p->temperature);
     vrna_md_defaults_betaScale(md_p->betaScale);
     vrna_md_defaults_sfact(md_p->sfact);
+    vrna_md_defaults_wavefront(md_p->wavefront);
+    vrna_md_defaults_pf_logspace(md_p->pf_logspace);
+    vrna_md_defaults_tile_size(md_p->tile_size);
     copy_nonstandards(&defaults, &(md_p->nonstandards[0]));
   }
 
@@ -807,6 +816,48 @@ vrna_md_defaults_sfact_get(void)
 }
 
 
+PUBLIC void
+vrna_md_defaults_wavefront(int flag)
+{
+  defaults.wavefront = flag ? 1 : 0;
+}
+
+
+PUBLIC int
+vrna_md_defaults_wavefront_get(void)
+{
+  return defaults.wavefront;
+}
+
+
+PUBLIC void
+vrna_md_defaults_pf_logspace(int flag)
+{
+  defaults.pf_logspace = flag ? 1 : 0;
+}
+
+
+PUBLIC int
+vrna_md_defaults_pf_logspace_get(void)
+{
+  return defaults.pf_logspace;
+}
+
+
+PUBLIC void
+vrna_md_defaults_tile_size(int size)
+{
+  defaults.tile_size = (size < 0) ? 0 : size;
+}
+
+
+PUBLIC int
+vrna_md_defaults_tile_size_get(void)
+{
+  return defaults.tile_size;
+}
+
+
 PUBLIC void
 vrna_md_update(vrna_md_t *md)
 {
@@ -975,6 +1026,9 @@ set_model_details(vrna_md_t *md)
     md->temperature     = temperature;
     md->betaScale       = VRNA_MODEL_DEFAULT_BETA_SCALE;
     md->sfact           = 1.07;
+    md->wavefront       = VRNA_MODEL_DEFAULT_WAVEFRONT;
+    md->pf_logspace     = VRNA_MODEL_DEFAULT_PF_LOGSPACE;
+    md->tile_size       = VRNA_MODEL_DEFAULT_TILE_SIZE;
 
     if (nonstandards)
       copy_nonstandards(md, nonstandards);
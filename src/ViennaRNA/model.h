@@ -153,6 +153,24 @@ typedef struct vrna_md_s vrna_md_t;
  */
 #define VRNA_MODEL_DEFAULT_ALI_NC_FACT    1.
 
+/**
+ *  @brief  Default model behavior regarding the order in which the global DP matrices are filled
+ *  @see    #vrna_md_t.wavefront, vrna_md_defaults_reset(), vrna_md_set_default()
+ */
+#define VRNA_MODEL_DEFAULT_WAVEFRONT      0
+
+/**
+ *  @brief  Default model behavior regarding the numerical representation of partition functions
+ *  @see    #vrna_md_t.pf_logspace, vrna_md_defaults_reset(), vrna_md_set_default()
+ */
+#define VRNA_MODEL_DEFAULT_PF_LOGSPACE    0
+
+/**
+ *  @brief  Default edge length of the square tiles in which the global DP matrices are filled (0 = no tiling)
+ *  @see    #vrna_md_t.tile_size, vrna_md_defaults_reset(), vrna_md_set_default()
+ */
+#define VRNA_MODEL_DEFAULT_TILE_SIZE      0
+
 
 #ifndef VRNA_DISABLE_BACKWARD_COMPATIBILITY
 
@@ -229,6 +247,51 @@ struct vrna_md_s {
   int     rtype[8];                         /**<  @brief  Reverse base pair type array */
   short   alias[MAXALPHA + 1];              /**<  @brief  alias of an integer nucleotide representation */
   int     pair[MAXALPHA + 1][MAXALPHA + 1]; /**<  @brief  Integer representation of a base pair */
+  int     wavefront;                        /**<  @brief  Fill the global DP matrices along anti-diagonals (wavefronts) of
+                                             *            constant span @f$ d = j - i @f$ instead of row by row
+                                             *    @details  All cells of the same anti-diagonal are independent of each
+                                             *            other and will be processed in parallel whenever RNAlib has been
+                                             *            compiled with OpenMP support. This applies to the MFE and
+                                             *            partition function forward recursions, and to the outside
+                                             *            recursion for base pair probabilities (single sequences and
+                                             *            alignments). Partition functions and probabilities are
+                                             *            bit-identical to the row-wise fill for any number of threads.
+                                             *            This requires user-supplied callbacks (soft/hard constraints,
+                                             *            grammar extensions) to be thread-safe. The MFE helper arrays
+                                             *            of the last few anti-diagonals require linear memory only.
+                                             */
+  int     pf_logspace;                      /**<  @brief  Compute partition functions and base pair probabilities in log-space
+                                             *    @details  Instead of scaled Boltzmann factors, the partition function
+                                             *            matrices store natural logarithms of the (unscaled) partition
+                                             *            functions. This never under- or overflows, such that neither
+                                             *            #vrna_md_t.sfact nor vrna_exp_params_rescale() are required,
+                                             *            even for very long or GC-rich sequences. The price is a slower
+                                             *            fill, since sums are evaluated by means of log-sum-exp.
+                                             *            Currently, this is available for single, linear sequences
+                                             *            without G-quadruplexes, soft constraints, or grammar extensions.
+                                             *            Other inputs fall back to the default scaled computations.
+                                             *    @see    vrna_pf_logspace()
+                                             */
+  int     tile_size;                        /**<  @brief  Fill the global DP matrices in square tiles of this edge length
+                                             *    @details  If greater than 0, the global MFE and partition function
+                                             *            forward recursions process the triangular matrices tile by
+                                             *            tile instead of row by row (or column by column). The rows
+                                             *            and columns accessed by the multibranch and exterior loop
+                                             *            decompositions of all cells in a tile are then shared, which
+                                             *            greatly reduces memory traffic for long sequences.
+                                             *            Tiles along the same anti-diagonal of tiles are processed in
+                                             *            parallel whenever RNAlib has been compiled with OpenMP
+                                             *            support. The storage layout of the matrices, and the results
+                                             *            of the computations, remain the same. Tile sizes of 32 to 128
+                                             *            are usually a good choice. Takes precedence over
+                                             *            #vrna_md_t.wavefront for the forward recursions.
+                                             *    @note   Since cells of arbitrary preceding anti-diagonals are
+                                             *            accessed, the MFE recursions keep one (two with
+                                             *            #vrna_md_t.noLP) additional triangular helper matrix for
+                                             *            the multibranch loop decomposition in memory, i.e. about
+                                             *            @f$ 2 n^2 @f$ (@f$ 4 n^2 @f$) bytes for a sequence of
+                                             *            length @f$ n @f$.
+                                             */
 };
 
 
@@ -730,6 +793,60 @@ double
 vrna_md_defaults_sfact_get(void);
 
 
+/**
+ *  @brief  Set default behavior for wavefront (anti-diagonal) filling of the global DP matrices
+ *  @see vrna_md_defaults_reset(), vrna_md_set_default(), #vrna_md_t, #VRNA_MODEL_DEFAULT_WAVEFRONT
+ *  @param  flag  Fill matrices along anti-diagonals if non-zero, row by row otherwise
+ */
+void
+vrna_md_defaults_wavefront(int flag);
+
+
+/**
+ *  @brief  Get default behavior for wavefront (anti-diagonal) filling of the global DP matrices
+ *  @see vrna_md_defaults_wavefront(), vrna_md_defaults_reset(), vrna_md_set_default(), #vrna_md_t, #VRNA_MODEL_DEFAULT_WAVEFRONT
+ *  @return The global default settings for wavefront matrix filling
+ */
+int
+vrna_md_defaults_wavefront_get(void);
+
+
+/**
+ *  @brief  Set default behavior for log-space partition function computations
+ *  @see vrna_md_defaults_reset(), vrna_md_set_default(), #vrna_md_t, #VRNA_MODEL_DEFAULT_PF_LOGSPACE
+ *  @param  flag  Compute partition functions in log-space if non-zero, with scaled Boltzmann factors otherwise
+ */
+void
+vrna_md_defaults_pf_logspace(int flag);
+
+
+/**
+ *  @brief  Get default behavior for log-space partition function computations
+ *  @see vrna_md_defaults_pf_logspace(), vrna_md_defaults_reset(), vrna_md_set_default(), #vrna_md_t, #VRNA_MODEL_DEFAULT_PF_LOGSPACE
+ *  @return The global default settings for log-space partition function computations
+ */
+int
+vrna_md_defaults_pf_logspace_get(void);
+
+
+/**
+ *  @brief  Set default edge length of the tiles in which the global DP matrices are filled
+ *  @see vrna_md_defaults_reset(), vrna_md_set_default(), #vrna_md_t, #VRNA_MODEL_DEFAULT_TILE_SIZE
+ *  @param  size  The tile size, or 0 to fill the matrices row by row
+ */
+void
+vrna_md_defaults_tile_size(int size);
+
+
+/**
+ *  @brief  Get default edge length of the tiles in which the global DP matrices are filled
+ *  @see vrna_md_defaults_tile_size(), vrna_md_defaults_reset(), vrna_md_set_default(), #vrna_md_t, #VRNA_MODEL_DEFAULT_TILE_SIZE
+ *  @return The global default tile size
+ */
+int
+vrna_md_defaults_tile_size_get(void);
+
+
 #ifndef VRNA_DISABLE_BACKWARD_COMPATIBILITY
 
 #define model_detailsT        vrna_md_t               /* restore compatibility of struct rename */
@@ -242,6 +242,94 @@ vrna_exp_param_t *
 vrna_exp_params_copy(vrna_exp_param_t *par);
 
 
+/**
+ *  @brief  Get a shared, read-only set of free energy parameters
+ *
+ *  Parameter sets are computed only once for each set of model details, and
+ *  shared by all callers (and threads) within the process through a reference
+ *  counted cache. The returned parameters must not be modified, and must be
+ *  released with vrna_params_shared_free() instead of free(). vrna_params()
+ *  returns private copies of these shared parameter sets.
+ *
+ *  @note The model details attached to the shared parameters may differ from
+ *        @p md in window size, maximum base pair span, and minimum hairpin size,
+ *        since none of them influences the actual energy parameters.
+ *
+ *  @see  vrna_params_shared_free(), vrna_params_shared_clear(), vrna_params()
+ *
+ *  @param  md  A pointer to the model details (Maybe NULL)
+ *  @return     The shared energy parameters
+ */
+const vrna_param_t *
+vrna_params_shared(vrna_md_t *md);
+
+
+/**
+ *  @brief  Get a shared, read-only set of Boltzmann factors
+ *
+ *  Shared Boltzmann factors always come with an undefined scaling factor
+ *  (@p pf_scale = -1). Fold compounds obtain their Boltzmann factors as private
+ *  copies via vrna_exp_params(), such that their scaling factors can be
+ *  adjusted individually with vrna_exp_params_rescale().
+ *
+ *  @see  vrna_params_shared(), vrna_exp_params_shared_free(), vrna_exp_params()
+ *
+ *  @param  md  A pointer to the model details (Maybe NULL)
+ *  @return     The shared Boltzmann factors
+ */
+const vrna_exp_param_t *
+vrna_exp_params_shared(vrna_md_t *md);
+
+
+/**
+ *  @brief  Get a shared, read-only set of Boltzmann factors (alifold version)
+ *
+ *  @see  vrna_exp_params_shared(), vrna_exp_params_shared_free(), vrna_exp_params_comparative()
+ *
+ *  @param  n_seq   The number of sequences in the alignment
+ *  @param  md      A pointer to the model details (Maybe NULL)
+ *  @return         The shared Boltzmann factors
+ */
+const vrna_exp_param_t *
+vrna_exp_params_comparative_shared(unsigned int n_seq,
+                                   vrna_md_t    *md);
+
+
+/**
+ *  @brief  Release a shared set of free energy parameters
+ *
+ *  @see  vrna_params_shared()
+ *
+ *  @param  P   The shared energy parameters obtained from vrna_params_shared()
+ */
+void
+vrna_params_shared_free(const vrna_param_t *P);
+
+
+/**
+ *  @brief  Release a shared set of Boltzmann factors
+ *
+ *  @see  vrna_exp_params_shared(), vrna_exp_params_comparative_shared()
+ *
+ *  @param  P   The shared Boltzmann factors
+ */
+void
+vrna_exp_params_shared_free(const vrna_exp_param_t *P);
+
+
+/**
+ *  @brief  Remove all parameter sets from the cache of shared energy parameters
+ *
+ *  Parameter sets still in use remain valid until they are released. This function
+ *  is called whenever a new energy parameter file is read, but must be called
+ *  explicitly by programs that modify the global energy tables otherwise.
+ *
+ *  @see  vrna_params_shared(), vrna_exp_params_shared()
+ */
+void
+vrna_params_shared_clear(void);
+
+
 /**
  *  @brief  Update/Reset energy parameters data structure within a #vrna_fold_compound_t
  *
@@ -20,6 +20,7 @@
 #include "ViennaRNA/params/constants.h"
 #include "ViennaRNA/params/default.h"
 #include "ViennaRNA/params/io.h"
+#include "ViennaRNA/params/basic.h"
 
 #define PUBLIC
 #define PRIVATE   static
@@ -455,6 +456,10 @@ read_parameter_file(const char fname[])
   fclose(fp);
 
   check_symmetry();
+
+  /* parameter sets derived from the previous energy tables are outdated now */
+  vrna_params_shared_clear();
+
   return;
 }
 
@@ -11,8 +11,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <math.h>
 #include <string.h>
+
+#if VRNA_WITH_PTHREADS
+# include <pthread.h>
+#endif
+
 #include "ViennaRNA/params/default.h"
 #include "ViennaRNA/fold_vars.h"
 #include "ViennaRNA/utils/basic.h"
@@ -42,6 +48,9 @@
 
 /* #define SMOOTH(X) ((X)<0 ? 0 : (X)) */
 
+/* maximum number of parameter sets kept in each of the shared parameter caches */
+#define SHARED_CACHE_SIZE 16
+
 /*
  #################################
  # PRIVATE VARIABLES             #
@@ -57,6 +66,37 @@ PRIVATE int               pf_id = -1;
 #pragma omp threadprivate(id, pf_id)
 #endif
 
+/*
+ *  Shared parameter sets are kept in two least recently used lists, one for
+ *  free energies and one for Boltzmann factors. Each entry is reference
+ *  counted, and the cache itself holds one reference as long as the entry
+ *  is listed.
+ */
+struct shared_entry {
+  unsigned int        hash;
+  unsigned int        n_seq;    /* number of sequences for comparative Boltzmann factors, 0 otherwise */
+  unsigned int        refcount;
+  vrna_md_t           key;      /* model details without sequence dependent attributes */
+  struct shared_entry *next;
+};
+
+struct shared_params {
+  struct shared_entry entry;
+  vrna_param_t        P;
+};
+
+struct shared_exp_params {
+  struct shared_entry entry;
+  vrna_exp_param_t    P;
+};
+
+PRIVATE struct shared_entry *shared_params_list     = NULL;
+PRIVATE struct shared_entry *shared_exp_params_list = NULL;
+
+#if VRNA_WITH_PTHREADS
+PRIVATE pthread_mutex_t shared_mtx = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 /*
  #################################
  # PRIVATE FUNCTION DECLARATIONS #
@@ -78,6 +118,37 @@ PRIVATE vrna_exp_param_t *get_exp_params_ali(vrna_md_t    *md,
 PRIVATE void              rescale_params(vrna_fold_compound_t *vc);
 
 
+PRIVATE void
+shared_key(vrna_md_t    *key,
+           vrna_md_t    *md,
+           unsigned int *hash);
+
+
+PRIVATE struct shared_entry *
+shared_lookup(struct shared_entry **list,
+              vrna_md_t           *key,
+              unsigned int        hash,
+              unsigned int        n_seq);
+
+
+PRIVATE struct shared_entry *
+shared_insert(struct shared_entry **list,
+              struct shared_entry *entry);
+
+
+PRIVATE void
+shared_release(struct shared_entry *entry);
+
+
+PRIVATE void
+shared_clear(struct shared_entry **list);
+
+
+PRIVATE const vrna_exp_param_t *
+get_shared_exp_params(unsigned int  n_seq,
+                      vrna_md_t     *md);
+
+
 /*
  #################################
  # BEGIN OF FUNCTION DEFINITIONS #
@@ -86,26 +157,43 @@ PRIVATE void              rescale_params(vrna_fold_compound_t *vc);
 PUBLIC vrna_param_t *
 vrna_params(vrna_md_t *md)
 {
-  if (md) {
-    return get_scaled_params(md);
-  } else {
-    vrna_md_t md;
-    vrna_md_set_default(&md);
-    return get_scaled_params(&md);
+  vrna_md_t           md_default;
+  vrna_param_t        *P;
+  const vrna_param_t  *shared;
+
+  if (!md) {
+    vrna_md_set_default(&md_default);
+    md = &md_default;
   }
+
+  /* copy from the shared parameter set that only differs in the model details */
+  shared            = vrna_params_shared(md);
+  P                 = vrna_params_copy((vrna_param_t *)shared);
+  P->model_details  = *md;
+  vrna_params_shared_free(shared);
+
+  return P;
 }
 
 
 PUBLIC vrna_exp_param_t *
 vrna_exp_params(vrna_md_t *md)
 {
-  if (md) {
-    return get_scaled_exp_params(md, -1.);
-  } else {
-    vrna_md_t md;
-    vrna_md_set_default(&md);
-    return get_scaled_exp_params(&md, -1.);
+  vrna_md_t               md_default;
+  vrna_exp_param_t        *P;
+  const vrna_exp_param_t  *shared;
+
+  if (!md) {
+    vrna_md_set_default(&md_default);
+    md = &md_default;
   }
+
+  shared            = vrna_exp_params_shared(md);
+  P                 = vrna_exp_params_copy((vrna_exp_param_t *)shared);
+  P->model_details  = *md;
+  vrna_exp_params_shared_free(shared);
+
+  return P;
 }
 
 
@@ -113,13 +201,122 @@ PUBLIC vrna_exp_param_t *
 vrna_exp_params_comparative(unsigned int  n_seq,
                             vrna_md_t     *md)
 {
-  if (md) {
-    return get_exp_params_ali(md, n_seq, -1.);
-  } else {
-    vrna_md_t md;
-    vrna_md_set_default(&md);
-    return get_exp_params_ali(&md, n_seq, -1.);
+  vrna_md_t               md_default;
+  vrna_exp_param_t        *P;
+  const vrna_exp_param_t  *shared;
+
+  if (!md) {
+    vrna_md_set_default(&md_default);
+    md = &md_default;
+  }
+
+  shared            = vrna_exp_params_comparative_shared(n_seq, md);
+  P                 = vrna_exp_params_copy((vrna_exp_param_t *)shared);
+  P->model_details  = *md;
+  vrna_exp_params_shared_free(shared);
+
+  return P;
+}
+
+
+PUBLIC const vrna_param_t *
+vrna_params_shared(vrna_md_t *md)
+{
+  unsigned int          hash;
+  vrna_md_t             key;
+  vrna_param_t          *P;
+  struct shared_entry   *entry;
+  struct shared_params  *shared;
+
+  if (md)
+    shared_key(&key, md, &hash);
+  else {
+    vrna_md_set_default(&key);
+    shared_key(&key, &key, &hash);
   }
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_lock(&shared_mtx);
+#endif
+
+  entry = shared_lookup(&shared_params_list, &key, hash, 0);
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_unlock(&shared_mtx);
+#endif
+
+  if (!entry) {
+    /* compute the parameters outside the critical section */
+    P       = get_scaled_params(&key);
+    shared  = (struct shared_params *)vrna_alloc(sizeof(struct shared_params));
+    memcpy(&(shared->P), P, sizeof(vrna_param_t));
+    free(P);
+
+    shared->entry.hash      = hash;
+    shared->entry.n_seq     = 0;
+    shared->entry.refcount  = 1;
+    shared->entry.key       = key;
+
+#if VRNA_WITH_PTHREADS
+    pthread_mutex_lock(&shared_mtx);
+#endif
+
+    entry = shared_insert(&shared_params_list, &(shared->entry));
+
+#if VRNA_WITH_PTHREADS
+    pthread_mutex_unlock(&shared_mtx);
+#endif
+  }
+
+  return (const vrna_param_t *)&(((struct shared_params *)entry)->P);
+}
+
+
+PUBLIC const vrna_exp_param_t *
+vrna_exp_params_shared(vrna_md_t *md)
+{
+  return get_shared_exp_params(0, md);
+}
+
+
+PUBLIC const vrna_exp_param_t *
+vrna_exp_params_comparative_shared(unsigned int n_seq,
+                                   vrna_md_t    *md)
+{
+  /* comparative Boltzmann factors are scaled by the number of sequences */
+  return get_shared_exp_params(MAX2(n_seq, 1), md);
+}
+
+
+PUBLIC void
+vrna_params_shared_free(const vrna_param_t *P)
+{
+  if (P)
+    shared_release((struct shared_entry *)((char *)P - offsetof(struct shared_params, P)));
+}
+
+
+PUBLIC void
+vrna_exp_params_shared_free(const vrna_exp_param_t *P)
+{
+  if (P)
+    shared_release((struct shared_entry *)((char *)P - offsetof(struct shared_exp_params, P)));
+}
+
+
+PUBLIC void
+vrna_params_shared_clear(void)
+{
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_lock(&shared_mtx);
+#endif
+
+  shared_clear(&shared_params_list);
+  shared_clear(&shared_exp_params_list);
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_unlock(&shared_mtx);
+#endif
 }
 
 
@@ -346,6 +543,188 @@ vrna_params_prepare(vrna_fold_compound_t  *fc,
  # BEGIN OF STATIC HELPER FUNCTIONS  #
  #####################################
  */
+/*
+ *  Window size, maximum base pair span, and minimum hairpin loop size do not
+ *  enter any of the energy parameters or Boltzmann factors. They are adapted
+ *  to the sequence length of each fold compound, so we reset them to their
+ *  defaults to let all fold compounds with otherwise equal model share the
+ *  same parameters
+ */
+PRIVATE void
+shared_key(vrna_md_t    *key,
+           vrna_md_t    *md,
+           unsigned int *hash)
+{
+  size_t        i;
+  unsigned char *c;
+
+  if (key != md)
+    memcpy(key, md, sizeof(vrna_md_t));
+
+  key->window_size    = VRNA_MODEL_DEFAULT_WINDOW_SIZE;
+  key->max_bp_span    = VRNA_MODEL_DEFAULT_MAX_BP_SPAN;
+  key->min_loop_size  = TURN;
+
+  /* FNV-1a */
+  c     = (unsigned char *)key;
+  *hash = 2166136261U;
+  for (i = 0; i < sizeof(vrna_md_t); i++) {
+    *hash ^= c[i];
+    *hash *= 16777619U;
+  }
+}
+
+
+/* find an entry, move it to the front of the list, and add a reference */
+PRIVATE struct shared_entry *
+shared_lookup(struct shared_entry **list,
+              vrna_md_t           *key,
+              unsigned int        hash,
+              unsigned int        n_seq)
+{
+  struct shared_entry *e, *prev;
+
+  for (prev = NULL, e = *list; e; prev = e, e = e->next)
+    if ((e->hash == hash) &&
+        (e->n_seq == n_seq) &&
+        (memcmp(&(e->key), key, sizeof(vrna_md_t)) == 0)) {
+      if (prev) {
+        prev->next  = e->next;
+        e->next     = *list;
+        *list       = e;
+      }
+
+      e->refcount++;
+      return e;
+    }
+
+  return NULL;
+}
+
+
+/*
+ *  insert a new entry (that already carries the reference of the caller)
+ *  unless another thread has been faster, and evict the least recently
+ *  used entry if the cache is full
+ */
+PRIVATE struct shared_entry *
+shared_insert(struct shared_entry **list,
+              struct shared_entry *entry)
+{
+  unsigned int        num;
+  struct shared_entry *e, *prev;
+
+  e = shared_lookup(list, &(entry->key), entry->hash, entry->n_seq);
+  if (e) {
+    free(entry);
+    return e;
+  }
+
+  entry->refcount++;
+  entry->next = *list;
+  *list       = entry;
+
+  for (num = 1, prev = entry, e = entry->next; e; num++, prev = e, e = e->next)
+    if (num == SHARED_CACHE_SIZE) {
+      prev->next  = NULL;
+      shared_clear(&e);
+      break;
+    }
+
+  return entry;
+}
+
+
+PRIVATE void
+shared_release(struct shared_entry *entry)
+{
+  unsigned int refcount;
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_lock(&shared_mtx);
+#endif
+
+  refcount = --entry->refcount;
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_unlock(&shared_mtx);
+#endif
+
+  if (refcount == 0)
+    free(entry);
+}
+
+
+/* drop the references of the cache to all entries in a list */
+PRIVATE void
+shared_clear(struct shared_entry **list)
+{
+  struct shared_entry *e, *next;
+
+  for (e = *list; e; e = next) {
+    next = e->next;
+    if (--e->refcount == 0)
+      free(e);
+  }
+
+  *list = NULL;
+}
+
+
+PRIVATE const vrna_exp_param_t *
+get_shared_exp_params(unsigned int  n_seq,
+                      vrna_md_t     *md)
+{
+  unsigned int              hash;
+  vrna_md_t                 key;
+  vrna_exp_param_t          *P;
+  struct shared_entry       *entry;
+  struct shared_exp_params  *shared;
+
+  if (md)
+    shared_key(&key, md, &hash);
+  else {
+    vrna_md_set_default(&key);
+    shared_key(&key, &key, &hash);
+  }
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_lock(&shared_mtx);
+#endif
+
+  entry = shared_lookup(&shared_exp_params_list, &key, hash, n_seq);
+
+#if VRNA_WITH_PTHREADS
+  pthread_mutex_unlock(&shared_mtx);
+#endif
+
+  if (!entry) {
+    P = (n_seq > 0) ? get_exp_params_ali(&key, n_seq, -1.) : get_scaled_exp_params(&key, -1.);
+
+    shared = (struct shared_exp_params *)vrna_alloc(sizeof(struct shared_exp_params));
+    memcpy(&(shared->P), P, sizeof(vrna_exp_param_t));
+    free(P);
+
+    shared->entry.hash      = hash;
+    shared->entry.n_seq     = n_seq;
+    shared->entry.refcount  = 1;
+    shared->entry.key       = key;
+
+#if VRNA_WITH_PTHREADS
+    pthread_mutex_lock(&shared_mtx);
+#endif
+
+    entry = shared_insert(&shared_exp_params_list, &(shared->entry));
+
+#if VRNA_WITH_PTHREADS
+    pthread_mutex_unlock(&shared_mtx);
+#endif
+  }
+
+  return (const vrna_exp_param_t *)&(((struct shared_exp_params *)entry)->P);
+}
+
+
 PRIVATE vrna_param_t *
 get_scaled_params(vrna_md_t *md)
 {
@@ -25,6 +25,8 @@
 #include "ViennaRNA/constraints/soft.h"
 #include "ViennaRNA/mfe.h"
 #include "ViennaRNA/part_func.h"
+#include "ViennaRNA/part_func_logspace.h"
+#include "ViennaRNA/boltzmann_sampling.h"
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -51,6 +53,24 @@ PRIVATE int
 fill_arrays(vrna_fold_compound_t *fc);
 
 
+PRIVATE FLT_OR_DBL
+fill_cell(vrna_fold_compound_t  *fc,
+          int                   i,
+          int                   j,
+          vrna_mx_pf_aux_el_t   aux_mx_el,
+          vrna_mx_pf_aux_hp_t   aux_mx_hp,
+          vrna_mx_pf_aux_ml_t   aux_mx_ml,
+          vrna_mx_pf_aux_il_t   aux_mx_il);
+
+
+PRIVATE int
+check_overflow(FLT_OR_DBL temp,
+               int        i,
+               int        j,
+               FLT_OR_DBL *Qmax,
+               double     max_real);
+
+
 PRIVATE void
 postprocess_circular(vrna_fold_compound_t *fc);
 
@@ -64,7 +84,7 @@ PUBLIC float
 vrna_pf(vrna_fold_compound_t  *fc,
         char                  *structure)
 {
-  int               n;
+  int               n, logspace;
   FLT_OR_DBL        Q;
   double            free_energy;
   vrna_md_t         *md;
@@ -84,6 +104,11 @@ vrna_pf(vrna_fold_compound_t  *fc,
     params    = fc->exp_params;
     matrices  = fc->exp_matrices;
     md        = &(params->model_details);
+    logspace  = vrna_pf_logspace_available(fc);
+
+    if ((md->pf_logspace) && (!logspace))
+      vrna_message_warning("vrna_pf@part_func.c: Log-space partition function not available "
+                           "for this input, using scaled Boltzmann factors instead");
 
 #ifdef _OPENMP
     /* Explicitly turn off dynamic threads */
@@ -96,6 +121,9 @@ vrna_pf(vrna_fold_compound_t  *fc,
     fpsetfastmode(1);
 #endif
 
+    /* memoized decompositions for stochastic backtracking depend on the matrices we are about to fill */
+    vrna_pbacktrack_cache_clear(fc);
+
     /* call user-defined recursion status callback function */
     if (fc->stat_cb)
       fc->stat_cb(VRNA_STATUS_PF_PRE, fc->auxdata);
@@ -104,7 +132,10 @@ vrna_pf(vrna_fold_compound_t  *fc,
     if ((fc->aux_grammar) && (fc->aux_grammar->cb_proc))
       fc->aux_grammar->cb_proc(fc, VRNA_STATUS_PF_PRE, fc->aux_grammar->data);
 
-    if (!fill_arrays(fc)) {
+    /* decide once how the matrices are to be interpreted by all subsequent computations */
+    matrices->logspace = 0;
+
+    if (!(logspace ? vrna_pf_logspace_fill(fc) : fill_arrays(fc))) {
 #ifdef SUN4
       standard_arithmetic();
 #elif defined(HP9)
@@ -156,12 +187,17 @@ vrna_pf(vrna_fold_compound_t  *fc,
     }
 
     /* ensemble free energy in Kcal/mol              */
-    if (Q <= FLT_MIN)
-      vrna_message_warning("pf_scale too large");
-
-    free_energy = (-log(Q) - n * log(params->pf_scale)) *
-                  params->kT /
-                  1000.0;
+    if (logspace) {
+      /* Q already is the logarithm of the unscaled partition function */
+      free_energy = -Q * params->kT / 1000.0;
+    } else {
+      if (Q <= FLT_MIN)
+        vrna_message_warning("pf_scale too large");
+
+      free_energy = (-log(Q) - n * log(params->pf_scale)) *
+                    params->kT /
+                    1000.0;
+    }
 
     if (fc->type == VRNA_FC_TYPE_COMPARATIVE)
       free_energy /= fc->n_seq;
@@ -220,6 +256,8 @@ vrna_pf_dimer(vrna_fold_compound_t  *fc,
   if (fc->stat_cb)
     fc->stat_cb(VRNA_STATUS_PF_PRE, fc->auxdata);
 
+  matrices->logspace = 0;
+
   if (!fill_arrays(fc)) {
     X.FA    = X.FB = X.FAB = X.F0AB = (float)(INF / 100.);
     X.FcAB  = 0;
@@ -328,38 +366,30 @@ vrna_pf_float_precision(void)
 PRIVATE int
 fill_arrays(vrna_fold_compound_t *fc)
 {
-  unsigned char       *hard_constraints;
-  int                 n, i, j, k, ij, d, *my_iindx, *jindx, with_gquad, turn,
-                      with_ud, hc_decompose, *pscore;
-  FLT_OR_DBL          temp, Qmax, qbt1, *q, *qb, *qm, *qm1, *q1k, *qln;
-  double              kTn, max_real;
+  int                 n, i, j, k, ij, d, *my_iindx, with_gquad, turn, with_ud;
+  FLT_OR_DBL          temp, Qmax, *q, *qb, *q1k, *qln;
+  double              max_real;
   vrna_ud_t           *domains_up;
   vrna_md_t           *md;
-  vrna_hc_t           *hc;
   vrna_mx_pf_t        *matrices;
   vrna_mx_pf_aux_el_t aux_mx_el;
+  vrna_mx_pf_aux_hp_t aux_mx_hp;
   vrna_mx_pf_aux_ml_t aux_mx_ml;
+  vrna_mx_pf_aux_il_t aux_mx_il;
   vrna_exp_param_t    *pf_params;
 
-  n                 = fc->length;
-  my_iindx          = fc->iindx;
-  jindx             = fc->jindx;
-  pscore            = (fc->type == VRNA_FC_TYPE_COMPARATIVE) ? fc->pscore : NULL;
-  matrices          = fc->exp_matrices;
-  pf_params         = fc->exp_params;
-  kTn               = pf_params->kT / 10.;  /* kT in cal/mol */
-  hc                = fc->hc;
-  domains_up        = fc->domains_up;
-  q                 = matrices->q;
-  qb                = matrices->qb;
-  qm                = matrices->qm;
-  qm1               = matrices->qm1;
-  q1k               = matrices->q1k;
-  qln               = matrices->qln;
-  md                = &(pf_params->model_details);
-  with_gquad        = md->gquad;
-  turn              = md->min_loop_size;
-  hard_constraints  = hc->matrix;
+  n           = fc->length;
+  my_iindx    = fc->iindx;
+  matrices    = fc->exp_matrices;
+  pf_params   = fc->exp_params;
+  domains_up  = fc->domains_up;
+  q           = matrices->q;
+  qb          = matrices->qb;
+  q1k         = matrices->q1k;
+  qln         = matrices->qln;
+  md          = &(pf_params->model_details);
+  with_gquad  = md->gquad;
+  turn        = md->min_loop_size;
 
   with_ud = (domains_up && domains_up->exp_energy_cb && (!(fc->type == VRNA_FC_TYPE_COMPARATIVE)));
   Qmax    = 0;
@@ -371,15 +401,17 @@ fill_arrays(vrna_fold_compound_t *fc)
 
   /* no G-Quadruplexes for comparative partition function (yet) */
   if (with_gquad && (!(fc->type == VRNA_FC_TYPE_COMPARATIVE))) {
-    free(fc->exp_matrices->G);
-    fc->exp_matrices->G = get_gquad_pf_matrix(fc->sequence_encoding2,
-                                              fc->exp_matrices->scale,
-                                              fc->exp_params);
+    vrna_gquad_mx_free(fc->exp_matrices->G);
+    fc->exp_matrices->G = vrna_gquad_mx_pf(fc->sequence_encoding2,
+                                           fc->exp_matrices->scale,
+                                           fc->exp_params);
   }
 
-  /* init auxiliary arrays for fast exterior/multibranch loops */
+  /* init auxiliary arrays for fast exterior/hairpin/multibranch/interior loops */
   aux_mx_el = vrna_exp_E_ext_fast_init(fc);
+  aux_mx_hp = vrna_exp_E_hp_loop_fast_init(fc);
   aux_mx_ml = vrna_exp_E_ml_fast_init(fc);
+  aux_mx_il = vrna_exp_E_int_loop_fast_init(fc);
 
   /*array initialization ; qb,qm,q
    * qb,qm,q (i,j) are stored as ((n+1-i)*(n-i) div 2 + n+1-j */
@@ -390,77 +422,132 @@ fill_arrays(vrna_fold_compound_t *fc)
       qb[ij]  = 0.0;
     }
 
-  for (j = turn + 2; j <= n; j++) {
-    for (i = j - turn - 1; i >= 1; i--) {
-      ij            = my_iindx[i] - j;
-      hc_decompose  = hard_constraints[jindx[j] + i];
-      qbt1          = 0;
-
-      if (hc_decompose) {
-        /* process hairpin loop(s) */
-        qbt1 += vrna_exp_E_hp_loop(fc, i, j);
-        /* process interior loop(s) */
-        qbt1 += vrna_exp_E_int_loop(fc, i, j);
-        /* process multibranch loop(s) */
-        qbt1 += vrna_exp_E_mb_loop_fast(fc, i, j, aux_mx_ml);
-
-        if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_c))
-          qbt1 += fc->aux_grammar->cb_aux_exp_c(fc, i, j, fc->aux_grammar->data);
-
-        if (fc->type == VRNA_FC_TYPE_COMPARATIVE)
-          qbt1 *= exp(pscore[jindx[j] + i] / kTn);
-      }
-
-      qb[ij] = qbt1;
+  if (md->tile_size > 0) {
+    int failed = 0, t, num_tiles, i_min, i_max, j_min, j_max;
 
-      /* Multibranch loop */
-      temp = vrna_exp_E_ml_fast(fc, i, j, aux_mx_ml);
+    /*
+     *  process the matrices in square tiles, see fill_tiles() in mfe.c for
+     *  details. Within a tile, we proceed column by column. Again, the order
+     *  of summation within a cell is the same as in the column-wise fill
+     */
+    num_tiles = (n + md->tile_size - 1) / md->tile_size;
 
-      /* apply auxiliary grammar rule for multibranch loop case */
-      if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_m))
-        temp += fc->aux_grammar->cb_aux_exp_m(fc, i, j, fc->aux_grammar->data);
+#ifdef _OPENMP
+#pragma omp parallel private(d, t, i, j, i_min, i_max, j_min, j_max)
+#endif
+    for (d = 0; d < num_tiles; d++) {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+      for (t = 0; t < num_tiles - d; t++) {
+        i_min = t * md->tile_size + 1;
+        i_max = MIN2(i_min + md->tile_size - 1, n);
+        j_min = (t + d) * md->tile_size + 1;
+        j_max = MIN2(j_min + md->tile_size - 1, n);
+
+        for (j = j_min; j <= j_max; j++)
+          for (i = MIN2(i_max, j - turn - 1); i >= i_min; i--)
+            (void)fill_cell(fc, i, j, aux_mx_el, aux_mx_hp, aux_mx_ml, aux_mx_il);
+      }
 
-      qm[ij] = temp;
+      /* check for overflows once the anti-diagonal of tiles is complete */
+#ifdef _OPENMP
+#pragma omp single
+#endif
+      {
+        for (t = 0; (t < num_tiles - d) && (!failed); t++) {
+          i_min = t * md->tile_size + 1;
+          i_max = MIN2(i_min + md->tile_size - 1, n);
+          j_min = (t + d) * md->tile_size + 1;
+          j_max = MIN2(j_min + md->tile_size - 1, n);
+
+          for (j = j_min; (j <= j_max) && (!failed); j++)
+            for (i = MIN2(i_max, j - turn - 1); i >= i_min; i--)
+              if (check_overflow(q[my_iindx[i] - j], i, j, &Qmax, max_real)) {
+                failed = 1;
+                break;
+              }
+        }
+      }
 
-      if (qm1) {
-        temp = vrna_exp_E_ml_fast_qqm(aux_mx_ml)[i]; /* for stochastic backtracking and circfold */
+      /* all threads see the same flag after the implicit barrier of omp single */
+      if (failed)
+        break;
+    }
 
-        /* apply auxiliary grammar rule for multibranch loop (M1) case */
-        if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_m1))
-          temp += fc->aux_grammar->cb_aux_exp_m1(fc, i, j, fc->aux_grammar->data);
+    if (failed) {
+      vrna_exp_E_int_loop_fast_free(aux_mx_il);
+      vrna_exp_E_ml_fast_free(aux_mx_ml);
+      vrna_exp_E_hp_loop_fast_free(aux_mx_hp);
+      vrna_exp_E_ext_fast_free(aux_mx_el);
 
-        qm1[jindx[j] + i] = temp;
-      }
+      return 0; /* failure */
+    }
+  } else if (md->wavefront) {
+    int failed = 0;
 
-      /* Exterior loop */
-      temp = vrna_exp_E_ext_fast(fc, i, j, aux_mx_el);
+    /*
+     *  process the matrices along anti-diagonals of constant span d = j - i.
+     *  Each cell (i, i + d) only depends on cells with smaller span, and the
+     *  order of summation within a cell is the same as in the column-wise
+     *  fill below, so the result does not depend on the number of threads
+     */
+#ifdef _OPENMP
+#pragma omp parallel private(d, i, j, ij, temp)
+#endif
+    for (d = turn + 1; d < n; d++) {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i = 1; i <= n - d; i++)
+        (void)fill_cell(fc, i, i + d, aux_mx_el, aux_mx_hp, aux_mx_ml, aux_mx_il);
 
-      /* apply auxiliary grammar rule for exterior loop case */
-      if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_f))
-        temp += fc->aux_grammar->cb_aux_exp_f(fc, i, j, fc->aux_grammar->data);
+      /* check for overflows once the anti-diagonal is complete */
+#ifdef _OPENMP
+#pragma omp single
+#endif
+      {
+        for (i = 1; i <= n - d; i++) {
+          j = i + d;
+          if (check_overflow(q[my_iindx[i] - j], i, j, &Qmax, max_real)) {
+            failed = 1;
+            break;
+          }
+        }
+      }
 
-      q[ij] = temp;
+      /* all threads see the same flag after the implicit barrier of omp single */
+      if (failed)
+        break;
+    }
 
-      if (temp > Qmax) {
-        Qmax = temp;
-        if (Qmax > max_real / 10.)
-          vrna_message_warning("Q close to overflow: %d %d %g", i, j, temp);
-      }
+    if (failed) {
+      vrna_exp_E_int_loop_fast_free(aux_mx_il);
+      vrna_exp_E_ml_fast_free(aux_mx_ml);
+      vrna_exp_E_hp_loop_fast_free(aux_mx_hp);
+      vrna_exp_E_ext_fast_free(aux_mx_el);
 
-      if (temp >= max_real) {
-        vrna_message_warning("overflow while computing partition function for segment q[%d,%d]\n"
-                             "use larger pf_scale", i, j);
+      return 0; /* failure */
+    }
+  } else {
+    for (j = turn + 2; j <= n; j++) {
+      for (i = j - turn - 1; i >= 1; i--) {
+        temp = fill_cell(fc, i, j, aux_mx_el, aux_mx_hp, aux_mx_ml, aux_mx_il);
 
-        vrna_exp_E_ml_fast_free(aux_mx_ml);
-        vrna_exp_E_ext_fast_free(aux_mx_el);
+        if (check_overflow(temp, i, j, &Qmax, max_real)) {
+          vrna_exp_E_int_loop_fast_free(aux_mx_il);
+          vrna_exp_E_ml_fast_free(aux_mx_ml);
+          vrna_exp_E_hp_loop_fast_free(aux_mx_hp);
+          vrna_exp_E_ext_fast_free(aux_mx_el);
 
-        return 0; /* failure */
+          return 0; /* failure */
+        }
       }
-    }
 
-    /* rotate auxiliary arrays */
-    vrna_exp_E_ext_fast_rotate(aux_mx_el);
-    vrna_exp_E_ml_fast_rotate(aux_mx_ml);
+      /* rotate auxiliary arrays */
+      vrna_exp_E_ext_fast_rotate(aux_mx_el);
+      vrna_exp_E_ml_fast_rotate(aux_mx_ml);
+    }
   }
 
   /* prefill linear qln, q1k arrays */
@@ -473,14 +560,115 @@ fill_arrays(vrna_fold_compound_t *fc)
     qln[n + 1]  = 1.0;
   }
 
-  /* free memory occupied by auxiliary arrays for fast exterior/multibranch loops */
+  /* free memory occupied by auxiliary arrays for fast exterior/hairpin/multibranch/interior loops */
+  vrna_exp_E_int_loop_fast_free(aux_mx_il);
   vrna_exp_E_ml_fast_free(aux_mx_ml);
+  vrna_exp_E_hp_loop_fast_free(aux_mx_hp);
   vrna_exp_E_ext_fast_free(aux_mx_el);
 
   return 1;
 }
 
 
+/* keep track of the largest partition function and return non-zero on overflow */
+PRIVATE int
+check_overflow(FLT_OR_DBL temp,
+               int        i,
+               int        j,
+               FLT_OR_DBL *Qmax,
+               double     max_real)
+{
+  if (temp > *Qmax) {
+    *Qmax = temp;
+    if (*Qmax > max_real / 10.)
+      vrna_message_warning("Q close to overflow: %d %d %g", i, j, temp);
+  }
+
+  if (temp >= max_real) {
+    vrna_message_warning("overflow while computing partition function for segment q[%d,%d]\n"
+                         "use larger pf_scale", i, j);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/* fill all matrix entries for segment [i, j] and return q[i, j] */
+PRIVATE FLT_OR_DBL
+fill_cell(vrna_fold_compound_t  *fc,
+          int                   i,
+          int                   j,
+          vrna_mx_pf_aux_el_t   aux_mx_el,
+          vrna_mx_pf_aux_hp_t   aux_mx_hp,
+          vrna_mx_pf_aux_ml_t   aux_mx_ml,
+          vrna_mx_pf_aux_il_t   aux_mx_il)
+{
+  int               ij, *my_iindx, *jindx, *pscore;
+  FLT_OR_DBL        temp, qbt1, *qm1;
+  double            kTn;
+  vrna_mx_pf_t      *matrices;
+  vrna_exp_param_t  *pf_params;
+
+  my_iindx  = fc->iindx;
+  jindx     = fc->jindx;
+  pscore    = (fc->type == VRNA_FC_TYPE_COMPARATIVE) ? fc->pscore : NULL;
+  matrices  = fc->exp_matrices;
+  pf_params = fc->exp_params;
+  kTn       = pf_params->kT / 10.;  /* kT in cal/mol */
+  qm1       = matrices->qm1;
+  ij        = my_iindx[i] - j;
+  qbt1      = 0;
+
+  if (fc->hc->matrix[jindx[j] + i]) {
+    /* process hairpin loop(s) */
+    qbt1 += vrna_exp_E_hp_loop_fast(fc, i, j, aux_mx_hp);
+    /* process interior loop(s) */
+    qbt1 += vrna_exp_E_int_loop_fast(fc, i, j, aux_mx_il);
+    /* process multibranch loop(s) */
+    qbt1 += vrna_exp_E_mb_loop_fast(fc, i, j, aux_mx_ml);
+
+    if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_c))
+      qbt1 += fc->aux_grammar->cb_aux_exp_c(fc, i, j, fc->aux_grammar->data);
+
+    if (fc->type == VRNA_FC_TYPE_COMPARATIVE)
+      qbt1 *= exp(pscore[jindx[j] + i] / kTn);
+  }
+
+  matrices->qb[ij] = qbt1;
+
+  /* Multibranch loop */
+  temp = vrna_exp_E_ml_fast(fc, i, j, aux_mx_ml);
+
+  /* apply auxiliary grammar rule for multibranch loop case */
+  if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_m))
+    temp += fc->aux_grammar->cb_aux_exp_m(fc, i, j, fc->aux_grammar->data);
+
+  matrices->qm[ij] = temp;
+
+  if (qm1) {
+    temp = vrna_exp_E_ml_fast_qqm_column(aux_mx_ml, j)[i]; /* for stochastic backtracking and circfold */
+
+    /* apply auxiliary grammar rule for multibranch loop (M1) case */
+    if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_m1))
+      temp += fc->aux_grammar->cb_aux_exp_m1(fc, i, j, fc->aux_grammar->data);
+
+    qm1[jindx[j] + i] = temp;
+  }
+
+  /* Exterior loop */
+  temp = vrna_exp_E_ext_fast(fc, i, j, aux_mx_el);
+
+  /* apply auxiliary grammar rule for exterior loop case */
+  if ((fc->aux_grammar) && (fc->aux_grammar->cb_aux_exp_f))
+    temp += fc->aux_grammar->cb_aux_exp_f(fc, i, j, fc->aux_grammar->data);
+
+  matrices->q[ij] = temp;
+
+  return temp;
+}
+
+
 /* calculate partition function for circular case */
 /* NOTE: this is the postprocessing step ONLY     */
 /* You have to call fill_arrays first to calculate  */
@@ -24,6 +24,7 @@ typedef struct vrna_dimer_pf_s cofoldF;
 #include <ViennaRNA/centroid.h>
 #include <ViennaRNA/equilibrium_probs.h>
 #include <ViennaRNA/boltzmann_sampling.h>
+#include <ViennaRNA/part_func_logspace.h>
 
 #ifdef VRNA_WARN_DEPRECATED
 # if defined(__clang__)
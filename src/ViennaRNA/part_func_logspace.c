@@ -0,0 +1,995 @@
+/*
+ *  ViennaRNA/part_func_logspace.c
+ *
+ *  Partition function and base pair probabilities in log-space
+ *
+ *  ViennaRNA package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/utils/structures.h"
+#include "ViennaRNA/params/default.h"
+#include "ViennaRNA/alphabet.h"
+#include "ViennaRNA/loops/all.h"
+#include "ViennaRNA/constraints/hard.h"
+#include "ViennaRNA/part_func_logspace.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+
+/*
+ #################################
+ # PRIVATE MACROS                #
+ #################################
+ */
+
+/* the logarithm of a zero partition function */
+#define LOG_ZERO    (-HUGE_VAL)
+
+/*
+ *  terms that are smaller than the largest term of a sum by more than
+ *  this (natural) log-distance do not change the sum in double precision
+ */
+#define LOG_CUTOFF  50.
+
+/*
+ #################################
+ # PRIVATE VARIABLES and STRUCTS #
+ #################################
+ */
+struct ls_data {
+  int               n;
+  int               turn;
+  int               noGUclosure;
+  int               *iindx;
+  int               *jindx;
+  int               *rtype;
+  int               *hc_up_ext;
+  int               *hc_up_hp;
+  int               *hc_up_int;
+  int               *hc_up_ml;
+  unsigned char     *hc_mx;
+  char              *sequence;
+  char              *ptype;
+  short             *S1;
+  short             *S2;
+  vrna_md_t         *md;
+  vrna_exp_param_t  *P;
+
+  FLT_OR_DBL        *lqb;
+  FLT_OR_DBL        *lqm;
+  FLT_OR_DBL        *lqm1;    /* jindx layout */
+  FLT_OR_DBL        *lq1k;    /* ln Q(1, j), lq1k[0] = 0 */
+  FLT_OR_DBL        *lqln;    /* ln Q(i, n), lqln[n + 1] = 0 */
+
+  /*
+   *  outside recursion: outside partition functions of qb and qm (jindx
+   *  layout), a copy of lqm1 in iindx layout, and buffers for the current row
+   */
+  FLT_OR_DBL        *Ob;
+  FLT_OR_DBL        *Om;
+  FLT_OR_DBL        *lqm1_row;
+  FLT_OR_DBL        *om_row;      /* Om(k, j) of the current row k */
+  FLT_OR_DBL        *obc_prev;    /* Ob(k - 1, j) times the multibranch loop closing penalty */
+  FLT_OR_DBL        *qm_col;      /* lqm(i, k - 1) */
+  FLT_OR_DBL        *buf;
+
+  double            lMLbase;
+  double            lMLclosing;
+
+  /* logarithms of stem contributions, indexed by [type][si + 1][sj + 1] */
+  double            lml_stem[NBPAIRS + 1][6][6];
+  double            lext_stem[NBPAIRS + 1][6][6];
+};
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+PRIVATE void
+init_data(vrna_fold_compound_t  *fc,
+          struct ls_data        *d);
+
+
+PRIVATE void
+fill_cell(struct ls_data  *d,
+          int             i,
+          int             j);
+
+
+PRIVATE double
+pair_contribution(struct ls_data  *d,
+                  int             i,
+                  int             j);
+
+
+PRIVATE void
+fill_exterior(struct ls_data *d);
+
+
+PRIVATE void
+outside_row(struct ls_data  *d,
+            int             k);
+
+
+PRIVATE INLINE double
+ml_closing(struct ls_data *d,
+           int            i,
+           int            j);
+
+
+PRIVATE INLINE void
+lse_add(double  *m,
+        double  *s,
+        double  x,
+        double  f);
+
+
+PRIVATE INLINE double
+lse_result(double m,
+           double s);
+
+
+PRIVATE double
+lse_zip_reverse(const FLT_OR_DBL  *e1,
+                const FLT_OR_DBL  *e2,
+                int               count);
+
+
+PRIVATE double
+lse_linear(const FLT_OR_DBL *e,
+           double           slope,
+           int              count);
+
+
+PRIVATE double
+lse_zip(const FLT_OR_DBL  *e1,
+        const FLT_OR_DBL  *e2,
+        int               count);
+
+
+PRIVATE INLINE double
+lse2(double a,
+     double b);
+
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+PUBLIC int
+vrna_pf_logspace(vrna_fold_compound_t *fc)
+{
+  if ((fc) && (fc->exp_matrices))
+    return (fc->exp_matrices->logspace) ? 1 : 0;
+
+  return 0;
+}
+
+
+PUBLIC int
+vrna_pf_logspace_available(vrna_fold_compound_t *fc)
+{
+  vrna_md_t *md;
+
+  if ((fc) && (fc->exp_params)) {
+    md = &(fc->exp_params->model_details);
+
+    if ((md->pf_logspace) &&
+        (fc->type == VRNA_FC_TYPE_SINGLE) &&
+        (fc->cutpoint == -1) &&
+        (!md->circ) &&
+        (!md->gquad) &&
+        (fc->hc) &&
+        (fc->hc->type == VRNA_HC_DEFAULT) &&
+        (!fc->hc->f) &&
+        (!fc->sc) &&
+        (!(fc->domains_up && fc->domains_up->exp_energy_cb)) &&
+        (!fc->aux_grammar))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+PUBLIC int
+vrna_pf_logspace_fill(vrna_fold_compound_t *fc)
+{
+  int             i, j, k, n, size;
+  vrna_mx_pf_t    *matrices;
+  struct ls_data  d;
+
+  if ((!vrna_pf_logspace_available(fc)) ||
+      (!fc->exp_matrices) ||
+      (!fc->exp_matrices->q) ||
+      (!fc->exp_matrices->qb) ||
+      (!fc->exp_matrices->qm))
+    return 0;
+
+  n         = (int)fc->length;
+  matrices  = fc->exp_matrices;
+  size      = ((n + 1) * (n + 2)) / 2;
+
+  /* from now on, the matrices hold log-space values */
+  matrices->logspace = 1;
+
+  /* we always need qm1 for the outside recursion */
+  if (!matrices->qm1)
+    matrices->qm1 = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * size);
+
+  init_data(fc, &d);
+
+  for (k = 0; k < size; k++)
+    d.lqb[k] = d.lqm[k] = d.lqm1[k] = (FLT_OR_DBL)LOG_ZERO;
+
+  d.lq1k  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  d.lqln  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+
+  if (d.md->tile_size > 0) {
+    int dd, t, num_tiles, i_min, i_max, j_min, j_max;
+
+    /* square tiles along anti-diagonals of tiles, see fill_tiles() in mfe.c */
+    num_tiles = (n + d.md->tile_size - 1) / d.md->tile_size;
+
+#ifdef _OPENMP
+#pragma omp parallel private(dd, t, i, j, i_min, i_max, j_min, j_max)
+#endif
+    for (dd = 0; dd < num_tiles; dd++) {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+      for (t = 0; t < num_tiles - dd; t++) {
+        i_min = t * d.md->tile_size + 1;
+        i_max = MIN2(i_min + d.md->tile_size - 1, n);
+        j_min = (t + dd) * d.md->tile_size + 1;
+        j_max = MIN2(j_min + d.md->tile_size - 1, n);
+
+        for (j = j_min; j <= j_max; j++)
+          for (i = MIN2(i_max, j - d.turn - 1); i >= i_min; i--)
+            fill_cell(&d, i, j);
+      }
+    }
+  } else if (d.md->wavefront) {
+    int dd;
+
+    /* all cells of the same span only depend on cells with smaller span */
+#ifdef _OPENMP
+#pragma omp parallel private(dd, i)
+#endif
+    for (dd = d.turn + 1; dd < n; dd++) {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+      for (i = 1; i <= n - dd; i++)
+        fill_cell(&d, i, i + dd);
+    }
+  } else {
+    for (j = d.turn + 2; j <= n; j++)
+      for (i = j - d.turn - 1; i >= 1; i--)
+        fill_cell(&d, i, j);
+  }
+
+  fill_exterior(&d);
+
+  /* store exterior loop partition functions in the first row and last column of q */
+  for (k = 1; k <= n; k++) {
+    matrices->q[d.iindx[1] - k] = d.lq1k[k];
+    matrices->q[d.iindx[k] - n] = d.lqln[k];
+  }
+
+  if (matrices->q1k && matrices->qln) {
+    for (k = 0; k <= n + 1; k++) {
+      matrices->q1k[k]  = d.lq1k[k];
+      matrices->qln[k]  = d.lqln[k];
+    }
+  }
+
+  free(d.lq1k);
+  free(d.lqln);
+
+  return 1;
+}
+
+
+PUBLIC int
+vrna_pairing_probs_logspace(vrna_fold_compound_t  *fc,
+                            char                  *structure)
+{
+  int             i, j, k, n, size, ij;
+  double          lQ, x;
+  vrna_mx_pf_t    *matrices;
+  struct ls_data  d;
+
+  if ((!vrna_pf_logspace(fc)) ||
+      (!fc->exp_matrices) ||
+      (!fc->exp_matrices->probs) ||
+      (!fc->exp_matrices->qm1))
+    return 0;
+
+  n         = (int)fc->length;
+  matrices  = fc->exp_matrices;
+  size      = ((n + 1) * (n + 2)) / 2;
+
+  init_data(fc, &d);
+
+  lQ = matrices->q[d.iindx[1] - n];
+
+  if (lQ == LOG_ZERO) {
+    vrna_message_warning("vrna_pairing_probs_logspace: Partition function is zero");
+    return 0;
+  }
+
+  /* restore exterior loop partition functions */
+  d.lq1k  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  d.lqln  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+
+  for (k = 1; k <= n; k++) {
+    d.lq1k[k] = matrices->q[d.iindx[1] - k];
+    d.lqln[k] = matrices->q[d.iindx[k] - n];
+  }
+
+  d.lq1k[0]     = 0.;
+  d.lqln[n + 1] = 0.;
+
+  d.Ob        = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * size);
+  d.Om        = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * size);
+  d.om_row    = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  d.obc_prev  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  d.qm_col    = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+  d.buf       = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * (n + 2));
+
+  /*
+   *  the outside recursion traverses lqm1 row-wise, so we temporarily
+   *  store a transposed copy in the (yet unused) probability matrix
+   */
+  d.lqm1_row = matrices->probs;
+
+  for (j = 1; j <= n; j++)
+    for (i = 1; i <= j; i++)
+      d.lqm1_row[d.iindx[i] - j] = d.lqm1[d.jindx[j] + i];
+
+  for (k = 0; k < size; k++)
+    d.Ob[k] = d.Om[k] = (FLT_OR_DBL)LOG_ZERO;
+
+  for (k = 0; k <= n + 1; k++)
+    d.obc_prev[k] = (FLT_OR_DBL)LOG_ZERO;
+
+  /*
+   *  outside recursion, row by row. Within each row, we go from the longest
+   *  to the shortest segment, such that all outside partition functions of
+   *  enclosing segments are available. Since the rows are processed
+   *  sequentially, all matrix accesses can be arranged to be contiguous
+   */
+  for (k = 1; k < n - d.turn; k++)
+    outside_row(&d, k);
+
+  /* convert outside partition functions into probabilities */
+  for (i = 1; i <= n; i++)
+    for (j = i; j <= n; j++) {
+      ij  = d.iindx[i] - j;
+      x   = (double)d.lqb[ij] + (double)d.Ob[d.jindx[j] + i];
+
+      matrices->probs[ij] = (x == LOG_ZERO) ? 0. : (FLT_OR_DBL)exp(x - lQ);
+    }
+
+  if (structure) {
+    char *s = vrna_db_from_probs(matrices->probs, (unsigned int)n);
+    memcpy(structure, s, n);
+    structure[n] = '\0';
+    free(s);
+  }
+
+  free(d.lq1k);
+  free(d.lqln);
+  free(d.Ob);
+  free(d.Om);
+  free(d.om_row);
+  free(d.obc_prev);
+  free(d.qm_col);
+  free(d.buf);
+
+  return 1;
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+PRIVATE void
+init_data(vrna_fold_compound_t  *fc,
+          struct ls_data        *d)
+{
+  int type, si, sj;
+
+  d->n            = (int)fc->length;
+  d->P            = fc->exp_params;
+  d->md           = &(fc->exp_params->model_details);
+  d->turn         = d->md->min_loop_size;
+  d->noGUclosure  = d->md->noGUclosure;
+  d->rtype        = &(d->md->rtype[0]);
+  d->iindx        = fc->iindx;
+  d->jindx        = fc->jindx;
+  d->hc_mx        = fc->hc->matrix;
+  d->hc_up_ext    = fc->hc->up_ext;
+  d->hc_up_hp     = fc->hc->up_hp;
+  d->hc_up_int    = fc->hc->up_int;
+  d->hc_up_ml     = fc->hc->up_ml;
+  d->sequence     = fc->sequence;
+  d->ptype        = fc->ptype;
+  d->S1           = fc->sequence_encoding;
+  d->S2           = fc->sequence_encoding2;
+  d->lqb          = fc->exp_matrices->qb;
+  d->lqm          = fc->exp_matrices->qm;
+  d->lqm1         = fc->exp_matrices->qm1;
+  d->lq1k         = NULL;
+  d->lqln         = NULL;
+  d->Ob           = NULL;
+  d->Om           = NULL;
+  d->lqm1_row     = NULL;
+  d->om_row       = NULL;
+  d->obc_prev     = NULL;
+  d->qm_col       = NULL;
+  d->buf          = NULL;
+  d->lMLbase      = log(d->P->expMLbase);
+  d->lMLclosing   = log(d->P->expMLclosing);
+
+  for (type = 0; type <= NBPAIRS; type++)
+    for (si = -1; si < 5; si++)
+      for (sj = -1; sj < 5; sj++) {
+        d->lml_stem[type][si + 1][sj + 1] =
+          log(exp_E_MLstem(type, si, sj, d->P));
+        d->lext_stem[type][si + 1][sj + 1] =
+          log(vrna_exp_E_ext_stem(type, si, sj, d->P));
+      }
+}
+
+
+/* fill lqb, lqm1, and lqm for segment [i, j] */
+PRIVATE void
+fill_cell(struct ls_data  *d,
+          int             i,
+          int             j)
+{
+  int         ij, type, max_u, n;
+  double      x, y, lqb;
+  FLT_OR_DBL  *lqm1;
+
+  n     = d->n;
+  ij    = d->iindx[i] - j;
+  lqm1  = d->lqm1;
+
+  lqb = (d->hc_mx[d->jindx[j] + i]) ? pair_contribution(d, i, j) : LOG_ZERO;
+
+  d->lqb[ij] = (FLT_OR_DBL)lqb;
+
+  /* qm1: exactly one stem (i, j') with j' <= j */
+  x = y = LOG_ZERO;
+
+  if (d->hc_up_ml[j] >= 1)
+    x = (double)lqm1[d->jindx[j - 1] + i] + d->lMLbase;
+
+  if ((lqb != LOG_ZERO) &&
+      (d->hc_mx[d->jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC)) {
+    type  = vrna_get_ptype_md(d->S2[i], d->S2[j], d->md);
+    y     = lqb +
+            d->lml_stem[type][(i > 1) ? d->S1[i - 1] + 1 : 0][(j < n) ? d->S1[j + 1] + 1 : 0];
+  }
+
+  lqm1[d->jindx[j] + i] = (FLT_OR_DBL)lse2(x, y);
+
+  /* qm: at least one stem, the first one (u, j') preceded by ... */
+  /* ... another multibranch loop part [i, u - 1] */
+  x = lse_zip_reverse(lqm1 + d->jindx[j] + i + 1,
+                      d->lqm + d->iindx[i] - i,
+                      j - i);
+
+  /* ... or unpaired nucleotides only */
+  max_u = MIN2(j - i, d->hc_up_ml[i]);
+  y     = lse_linear(lqm1 + d->jindx[j] + i,
+                     d->lMLbase,
+                     max_u + 1);
+
+  d->lqm[ij] = (FLT_OR_DBL)lse2(x, y);
+}
+
+
+/* ln of the partition function of segment [i, j] given that i and j pair */
+PRIVATE double
+pair_contribution(struct ls_data  *d,
+                  int             i,
+                  int             j)
+{
+  unsigned char     *hc_mx;
+  short             *S1, si1, sj1;
+  int               ij, k, l, kl, u, u1, u2, max_u1, first_l, type, type2, tt, *jindx,
+                    *iindx, *rtype, *hc_up_int;
+  double            m, s, x;
+  vrna_exp_param_t  *P;
+
+  hc_mx     = d->hc_mx;
+  S1        = d->S1;
+  jindx     = d->jindx;
+  iindx     = d->iindx;
+  rtype     = d->rtype;
+  hc_up_int = d->hc_up_int;
+  P         = d->P;
+  ij        = jindx[j] + i;
+  u         = j - i - 1;
+  m         = LOG_ZERO;
+  s         = 0.;
+
+  /* hairpin loop */
+  if ((hc_mx[ij] & VRNA_CONSTRAINT_CONTEXT_HP_LOOP) &&
+      (d->hc_up_hp[i + 1] >= u)) {
+    type = vrna_get_ptype_md(d->S2[i], d->S2[j], d->md);
+    lse_add(&m, &s, 0., exp_E_Hairpin(u, type, S1[i + 1], S1[j - 1], d->sequence + i - 1, P));
+  }
+
+  /* interior loops, same decompositions as in the scaled recursions */
+  if (hc_mx[ij] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP) {
+    type  = vrna_get_ptype(ij, d->ptype);
+    si1   = S1[i + 1];
+    sj1   = S1[j - 1];
+
+    /* stacked pair */
+    k = i + 1;
+    l = j - 1;
+    if (k < l) {
+      kl = jindx[l] + k;
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+        type2 = rtype[vrna_get_ptype(kl, d->ptype)];
+        lse_add(&m, &s,
+                d->lqb[iindx[k] - l],
+                exp_E_IntLoop(0, 0, type, type2, si1, sj1, S1[k - 1], S1[l + 1], P));
+      }
+    }
+
+    /* bulges and interior loops */
+    if (!((d->noGUclosure) && (type == 3 || type == 4))) {
+      max_u1 = MIN2(MAXLOOP, hc_up_int[i + 1]);
+
+      for (u1 = 0; u1 <= max_u1; u1++) {
+        k       = i + 1 + u1;
+        first_l = MAX2(k + d->turn + 1, j - 1 - MAXLOOP + u1);
+
+        for (l = (u1 == 0) ? j - 2 : j - 1; l >= first_l; l--) {
+          u2 = j - 1 - l;
+          if ((u2 > 0) && (hc_up_int[l + 1] < u2))
+            break;
+
+          kl = jindx[l] + k;
+          if (!(hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC))
+            continue;
+
+          type2 = rtype[vrna_get_ptype(kl, d->ptype)];
+
+          if ((d->noGUclosure) && (type2 == 3 || type2 == 4))
+            continue;
+
+          lse_add(&m, &s,
+                  d->lqb[iindx[k] - l],
+                  exp_E_IntLoop(u1, u2, type, type2, si1, sj1, S1[k - 1], S1[l + 1], P));
+        }
+      }
+    }
+  }
+
+  /* multibranch loop */
+  if ((hc_mx[ij] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP) && (u > 1)) {
+    x = lse_zip_reverse(d->lqm1 + jindx[j - 1] + i + 2,
+                        d->lqm + iindx[i + 1] - (i + 1),
+                        j - i - 2);
+
+    if (x != LOG_ZERO) {
+      tt = rtype[vrna_get_ptype(ij, d->ptype)];
+      x  += d->lMLclosing +
+            d->lml_stem[tt][S1[j - 1] + 1][S1[i + 1] + 1];
+      lse_add(&m, &s, x, 1.);
+    }
+  }
+
+  return lse_result(m, s);
+}
+
+
+/* ln Q(1, j) and ln Q(i, n) */
+PRIVATE void
+fill_exterior(struct ls_data *d)
+{
+  int     i, j, k, l, n, turn, type, *iindx, *jindx;
+  double  m, s;
+  short   *S1;
+
+  n     = d->n;
+  turn  = d->turn;
+  iindx = d->iindx;
+  jindx = d->jindx;
+  S1    = d->S1;
+
+  d->lq1k[0] = 0.;
+
+  for (j = 1; j <= n; j++) {
+    m = LOG_ZERO;
+    s = 0.;
+
+    if (d->hc_up_ext[j] >= 1)
+      lse_add(&m, &s, d->lq1k[j - 1], 1.);
+
+    for (k = 1; k < j - turn; k++) {
+      if (!(d->hc_mx[jindx[j] + k] & VRNA_CONSTRAINT_CONTEXT_EXT_LOOP))
+        continue;
+
+      type = vrna_get_ptype_md(d->S2[k], d->S2[j], d->md);
+      lse_add(&m, &s,
+              (double)d->lq1k[k - 1] +
+              (double)d->lqb[iindx[k] - j] +
+              d->lext_stem[type][(k > 1) ? S1[k - 1] + 1 : 0][(j < n) ? S1[j + 1] + 1 : 0],
+              1.);
+    }
+
+    d->lq1k[j] = (FLT_OR_DBL)lse_result(m, s);
+  }
+
+  d->lqln[n + 1] = 0.;
+
+  for (i = n; i >= 1; i--) {
+    m = LOG_ZERO;
+    s = 0.;
+
+    if (d->hc_up_ext[i] >= 1)
+      lse_add(&m, &s, d->lqln[i + 1], 1.);
+
+    for (l = i + turn + 1; l <= n; l++) {
+      if (!(d->hc_mx[jindx[l] + i] & VRNA_CONSTRAINT_CONTEXT_EXT_LOOP))
+        continue;
+
+      type = vrna_get_ptype_md(d->S2[i], d->S2[l], d->md);
+      lse_add(&m, &s,
+              (double)d->lqb[iindx[i] - l] +
+              (double)d->lqln[l + 1] +
+              d->lext_stem[type][(i > 1) ? S1[i - 1] + 1 : 0][(l < n) ? S1[l + 1] + 1 : 0],
+              1.);
+    }
+
+    d->lqln[i] = (FLT_OR_DBL)lse_result(m, s);
+  }
+}
+
+
+/*
+ *  outside partition functions for qm, qm1, and qb of all segments [k, l]
+ *  of row k, from the longest to the shortest segment. Each of them only
+ *  depends on outside values of enclosing segments, except for qm1 that
+ *  also depends on qm of the same segment, and qb that depends on qm1 of
+ *  the same segment.
+ */
+PRIVATE void
+outside_row(struct ls_data  *d,
+            int             k)
+{
+  unsigned char     *hc_mx;
+  short             *S1;
+  int               n, i, j, l, p, q, kl, u1, u2, max_u1, max_u2, i_min, type, type2, tt,
+                    *iindx, *jindx, *rtype, *hc_up_int;
+  double            m, s, x, o, om1, om1_prev;
+  FLT_OR_DBL        *Ob, *Om, *om_row, *obc_prev, *qm_col, *buf;
+  vrna_exp_param_t  *P;
+
+  n         = d->n;
+  hc_mx     = d->hc_mx;
+  S1        = d->S1;
+  iindx     = d->iindx;
+  jindx     = d->jindx;
+  rtype     = d->rtype;
+  hc_up_int = d->hc_up_int;
+  P         = d->P;
+  Ob        = d->Ob;
+  Om        = d->Om;
+  om_row    = d->om_row;
+  obc_prev  = d->obc_prev;
+  qm_col    = d->qm_col;
+  buf       = d->buf;
+
+  /* column k - 1 of lqm */
+  for (i = 1; i < k; i++)
+    qm_col[i] = d->lqm[iindx[i] - k + 1];
+
+  /* the smallest i such that [i, k - 1] may be unpaired in a multibranch loop */
+  i_min = k;
+  while ((i_min > 1) && (d->hc_up_ml[i_min - 1] >= k - i_min + 1))
+    i_min--;
+
+  om1_prev = LOG_ZERO;
+
+  for (l = n; l > k + d->turn; l--) {
+    kl = jindx[l] + k;
+
+    /* 1. qm(k, l), followed by qm1(l + 1, j), or enclosed by (k - 1, j + 1) */
+    x = LOG_ZERO;
+
+    if ((l < n) && (d->lqm[iindx[k] - l] != LOG_ZERO))
+      x = lse2(lse_zip_reverse(om_row + l + 1,
+                               d->lqm1_row + iindx[l + 1] - l - 1,
+                               n - l),
+               lse_zip_reverse(obc_prev + l + 2,
+                               d->lqm1_row + iindx[l + 1] - l - 1,
+                               n - l));
+
+    om_row[l] = Om[kl] = (FLT_OR_DBL)x;
+
+    /* 2. qm1(k, l) */
+    om1 = LOG_ZERO;
+
+    if (d->lqm1[kl] != LOG_ZERO) {
+      /* qm1(k, l + 1) with l + 1 unpaired */
+      if ((l < n) && (d->hc_up_ml[l + 1] >= 1))
+        om1 = om1_prev + d->lMLbase;
+
+      /* qm(i, l) = qm(i, k - 1) qm1(k, l) */
+      om1 = lse2(om1, lse_zip(Om + jindx[l] + 1, qm_col + 1, k - 1));
+
+      /* qm(i, l) with [i, k - 1] unpaired */
+      x = lse_linear(Om + jindx[l] + i_min, -d->lMLbase, k - i_min + 1);
+      if (x != LOG_ZERO)
+        om1 = lse2(om1, x + (k - i_min) * d->lMLbase);
+
+      /* (p, l + 1) closes a multibranch loop qm(p + 1, k - 1) qm1(k, l) */
+      if (l < n) {
+        q = l + 1;
+        for (p = 1; p < k - 1; p++)
+          buf[p] = (FLT_OR_DBL)(ml_closing(d, p, q) + Ob[jindx[q] + p]);
+
+        om1 = lse2(om1, lse_zip(buf + 1, qm_col + 2, k - 2));
+      }
+    }
+
+    om1_prev = om1;
+
+    /* 3. qb(k, l) */
+    if (d->lqb[iindx[k] - l] != LOG_ZERO) {
+      m     = LOG_ZERO;
+      s     = 0.;
+      type  = vrna_get_ptype_md(d->S2[k], d->S2[l], d->md);
+
+      /* exterior loop */
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_EXT_LOOP)
+        lse_add(&m, &s,
+                (double)d->lq1k[k - 1] +
+                (double)d->lqln[l + 1] +
+                d->lext_stem[type][(k > 1) ? S1[k - 1] + 1 : 0][(l < n) ? S1[l + 1] + 1 : 0],
+                1.);
+
+      /* multibranch loop stem */
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP_ENC)
+        lse_add(&m, &s,
+                om1 +
+                d->lml_stem[type][(k > 1) ? S1[k - 1] + 1 : 0][(l < n) ? S1[l + 1] + 1 : 0],
+                1.);
+
+      /* enclosed by pair (i, j) that forms a stack, bulge, or interior loop */
+      if (hc_mx[kl] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP_ENC) {
+        type2   = rtype[vrna_get_ptype(kl, d->ptype)];
+        max_u1  = MIN2(MAXLOOP, k - 2);
+
+        for (u1 = 0; u1 <= max_u1; u1++) {
+          i = k - 1 - u1;
+
+          if (hc_up_int[i + 1] < u1)
+            break;
+
+          max_u2 = MIN2(MAXLOOP - u1, n - l - 1);
+
+          for (u2 = 0; u2 <= max_u2; u2++) {
+            j = l + 1 + u2;
+
+            if ((u2 > 0) && (hc_up_int[l + 1] < u2))
+              break;
+
+            if (!(hc_mx[jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_INT_LOOP))
+              continue;
+
+            o = Ob[jindx[j] + i];
+            if (o == LOG_ZERO)
+              continue;
+
+            tt = vrna_get_ptype(jindx[j] + i, d->ptype);
+
+            if ((u1 + u2 > 0) &&
+                (d->noGUclosure) &&
+                (tt == 3 || tt == 4 || type2 == 3 || type2 == 4))
+              continue;
+
+            lse_add(&m, &s,
+                    o,
+                    exp_E_IntLoop(u1, u2, tt, type2, S1[i + 1], S1[j - 1], S1[k - 1], S1[l + 1], P));
+          }
+        }
+      }
+
+      Ob[kl] = (FLT_OR_DBL)lse_result(m, s);
+    }
+  }
+
+  /* pairs (k, j) that close multibranch loops, for the next row */
+  for (j = 1; j <= n; j++)
+    obc_prev[j] = (j > k + d->turn) ?
+                  (FLT_OR_DBL)(ml_closing(d, k, j) + Ob[jindx[j] + k]) :
+                  (FLT_OR_DBL)LOG_ZERO;
+}
+
+
+/* ln of the multibranch loop closing contributions of pair (i, j) */
+PRIVATE INLINE double
+ml_closing(struct ls_data *d,
+           int            i,
+           int            j)
+{
+  int tt;
+
+  if (!(d->hc_mx[d->jindx[j] + i] & VRNA_CONSTRAINT_CONTEXT_MB_LOOP))
+    return LOG_ZERO;
+
+  tt = d->rtype[vrna_get_ptype(d->jindx[j] + i, d->ptype)];
+
+  return d->lMLclosing +
+         d->lml_stem[tt][d->S1[j - 1] + 1][d->S1[i + 1] + 1];
+}
+
+
+/*
+ *  add exp(x) * f to the sum s * exp(m), where m is the largest x seen so far.
+ *  Zero terms are skipped such that they never determine m
+ */
+PRIVATE INLINE void
+lse_add(double  *m,
+        double  *s,
+        double  x,
+        double  f)
+{
+  if ((x == LOG_ZERO) || (f <= 0.))
+    return;
+
+  if (x > *m) {
+    *s  = *s * exp(*m - x) + f;
+    *m  = x;
+  } else {
+    *s += exp(x - *m) * f;
+  }
+}
+
+
+PRIVATE INLINE double
+lse_result(double m,
+           double s)
+{
+  return (s > 0.) ? m + log(s) : LOG_ZERO;
+}
+
+
+/* ln(exp(a) + exp(b)) */
+PRIVATE INLINE double
+lse2(double a,
+     double b)
+{
+  if (a < b) {
+    double t = a;
+    a = b;
+    b = t;
+  }
+
+  return (b == LOG_ZERO) ? a : a + log1p(exp(b - a));
+}
+
+
+/* ln(sum_k exp(e1[k] + e2[k])) for 0 <= k < count */
+PRIVATE double
+lse_zip(const FLT_OR_DBL  *e1,
+        const FLT_OR_DBL  *e2,
+        int               count)
+{
+  int     k;
+  double  x, m, s;
+
+  m = LOG_ZERO;
+  s = 0.;
+
+  for (k = 0; k < count; k++) {
+    x = (double)e1[k] + (double)e2[k];
+    if (x > m)
+      m = x;
+  }
+
+  if (m == LOG_ZERO)
+    return LOG_ZERO;
+
+  for (k = 0; k < count; k++) {
+    x = (double)e1[k] + (double)e2[k] - m;
+    if (x > -LOG_CUTOFF)
+      s += exp(x);
+  }
+
+  return m + log(s);
+}
+
+
+/* ln(sum_k exp(e1[k] + e2[-k])) for 0 <= k < count */
+PRIVATE double
+lse_zip_reverse(const FLT_OR_DBL  *e1,
+                const FLT_OR_DBL  *e2,
+                int               count)
+{
+  int     k;
+  double  x, m, s;
+
+  m = LOG_ZERO;
+  s = 0.;
+
+  for (k = 0; k < count; k++) {
+    x = (double)e1[k] + (double)e2[-k];
+    if (x > m)
+      m = x;
+  }
+
+  if (m == LOG_ZERO)
+    return LOG_ZERO;
+
+  for (k = 0; k < count; k++) {
+    x = (double)e1[k] + (double)e2[-k] - m;
+    if (x > -LOG_CUTOFF)
+      s += exp(x);
+  }
+
+  return m + log(s);
+}
+
+
+/* ln(sum_k exp(e[k] + k * slope)) for 0 <= k < count */
+PRIVATE double
+lse_linear(const FLT_OR_DBL *e,
+           double           slope,
+           int              count)
+{
+  int     k;
+  double  x, m, s;
+
+  m = LOG_ZERO;
+  s = 0.;
+
+  for (k = 0; k < count; k++) {
+    x = (double)e[k] + k * slope;
+    if (x > m)
+      m = x;
+  }
+
+  if (m == LOG_ZERO)
+    return LOG_ZERO;
+
+  for (k = 0; k < count; k++) {
+    x = (double)e[k] + k * slope - m;
+    if (x > -LOG_CUTOFF)
+      s += exp(x);
+  }
+
+  return m + log(s);
+}
@@ -0,0 +1,112 @@
+#ifndef VIENNA_RNA_PACKAGE_PART_FUNC_LOGSPACE_H
+#define VIENNA_RNA_PACKAGE_PART_FUNC_LOGSPACE_H
+
+#include <ViennaRNA/datastructures/basic.h>
+
+/**
+ *  @file     part_func_logspace.h
+ *  @ingroup  part_func_global
+ *  @brief    Partition function and base pair probabilities in log-space
+ */
+
+/**
+ *  @addtogroup part_func_global
+ *  @{
+ */
+
+/**
+ *  @name Log-space partition function interface
+ *  @{
+ *
+ *  The default partition function recursions store Boltzmann factors that are
+ *  scaled by @f$ s^{-(j - i + 1)} @f$ for each segment @f$ [i:j] @f$, where the
+ *  scaling factor @f$ s @f$ is estimated from the MFE (see #vrna_md_t.sfact and
+ *  vrna_exp_params_rescale()). For long or GC-rich sequences this estimate may
+ *  be too far off, such that the recursions under- or overflow. Setting
+ *  #vrna_md_t.pf_logspace makes vrna_pf() and vrna_pairing_probs() use the
+ *  functions below instead, which store the natural logarithm of the
+ *  @em unscaled partition functions and combine them by means of log-sum-exp.
+ *  Hence, no scaling is required at all.
+ *
+ *  In log-space mode, the matrices of the fold compound's #vrna_mx_pf_t
+ *  hold the following values:
+ *  * @p qb, @p qm, and @p qm1 (the latter in @p jindx layout) store
+ *    @f$ \ln Q^B_{ij} @f$, @f$ \ln Q^M_{ij} @f$, and @f$ \ln Q^{M1}_{ij} @f$
+ *  * @p q stores @f$ \ln Q_{1j} @f$ and @f$ \ln Q_{in} @f$, i.e. only its
+ *    first row and last column are filled
+ *  * @p probs stores the base pair probabilities as usual
+ *
+ *  @note Stochastic backtracking is not (yet) available in log-space mode.
+ */
+
+/**
+ *  @brief  Check whether the partition function matrices of a fold compound hold log-space values
+ *
+ *  The decision is made once whenever the matrices are filled by vrna_pf() (or
+ *  vrna_pf_logspace_fill()) and is stored along with the matrices. Subsequent
+ *  computations on the same matrices, e.g. base pair probabilities, therefore
+ *  interpret them consistently, even if the model details or constraints have
+ *  been changed in the meantime.
+ *
+ *  @see    vrna_pf_logspace_available()
+ *  @param  fc  The fold compound
+ *  @return     Non-zero if the partition function matrices of @p fc hold log-space values, 0 otherwise
+ */
+int
+vrna_pf_logspace(vrna_fold_compound_t *fc);
+
+
+/**
+ *  @brief  Check whether the partition function of a fold compound can be computed in log-space
+ *
+ *  Log-space computations are requested through #vrna_md_t.pf_logspace. They are
+ *  currently available for single, linear sequences without G-quadruplexes, soft
+ *  constraints, unstructured domains, user-defined hard constraint callbacks, or
+ *  grammar extensions.
+ *
+ *  @param  fc  The fold compound
+ *  @return     Non-zero if log-space computations were requested and are available for @p fc, 0 otherwise
+ */
+int
+vrna_pf_logspace_available(vrna_fold_compound_t *fc);
+
+
+/**
+ *  @brief  Fill the partition function matrices in log-space
+ *
+ *  @note   This function is called by vrna_pf() whenever vrna_pf_logspace_available()
+ *          returns non-zero. The fold compound must have been prepared for partition
+ *          function computations already.
+ *
+ *  @param  fc  The fold compound
+ *  @return     1 on success, 0 otherwise
+ */
+int
+vrna_pf_logspace_fill(vrna_fold_compound_t *fc);
+
+
+/**
+ *  @brief  Compute base pair probabilities from log-space partition function matrices
+ *
+ *  @note   This function is called by vrna_pairing_probs() whenever vrna_pf_logspace()
+ *          returns non-zero. It requires a preceding call of vrna_pf_logspace_fill().
+ *
+ *  @param  fc          The fold compound
+ *  @param  structure   A pointer to the character array where the position-wise pairing
+ *                      propensity will be stored (Maybe NULL)
+ *  @return             1 on success, 0 otherwise
+ */
+int
+vrna_pairing_probs_logspace(vrna_fold_compound_t  *fc,
+                            char                  *structure);
+
+
+/**
+ *  @}
+ */
+
+/**
+ *  @}
+ */
+
+#endif
@@ -122,6 +122,10 @@ plot_free_pu_out(pu_out   *res,
                  char     *head);
 
 
+PRIVATE void
+update_up_params(void);
+
+
 PRIVATE void
 scale_stru_pf_params(unsigned int length);
 
@@ -632,6 +636,10 @@ pf_interact(const char  *s1,
   Int->Pi = (double *)vrna_alloc(sizeof(double) * (n1 + 2));
   Int->Gi = (double *)vrna_alloc(sizeof(double) * (n1 + 2));
 
+  /* the unpaired probabilities may not stem from pf_unstru(), so make sure
+   * the Boltzmann weights are available before they are used for scaling */
+  update_up_params();
+
   /* use a different scaling for pf_interact*/
   scale_int(s2, s1, &int_scale);
 
@@ -1253,15 +1261,11 @@ encode_seq(const char *s1,
  * most of this is done in structure Pf see params.c,h (function:
  * get_scaled_pf_parameters(), only arrays scale and expMLbase are handled here*/
 PRIVATE void
-scale_stru_pf_params(unsigned int length)
+update_up_params(void)
 {
-  unsigned int  i;
-  double        kT;
-
-
   /* Do this only at the first call for get_scaled_pf_parameters()
    * and/or if temperature has changed*/
-  if (init_temp != temperature) {
+  if ((!Pf) || (init_temp != temperature)) {
     if (Pf)
       free(Pf);
 
@@ -1271,6 +1275,17 @@ scale_stru_pf_params(unsigned int length)
   }
 
   init_temp = Pf->temperature;
+}
+
+
+PRIVATE void
+scale_stru_pf_params(unsigned int length)
+{
+  unsigned int  i;
+  double        kT;
+
+
+  update_up_params();
 
   kT = Pf->kT; /* kT in cal/mol  */
 
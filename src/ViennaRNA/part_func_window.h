@@ -209,6 +209,41 @@ vrna_probs_window(vrna_fold_compound_t        *fc,
                   vrna_probs_window_callback  *cb,
                   void                        *data);
 
+
+/**
+ *  @brief  Compute various equilibrium probabilities under a sliding window approach using multiple threads
+ *
+ *  Same as vrna_probs_window(), but long sequences are split into overlapping
+ *  chunks that are scanned concurrently by @p num_threads threads. Adjacent chunks
+ *  overlap by more than one window size, such that the data reported for each
+ *  position is identical to that of vrna_probs_window().
+ *
+ *  The data of each chunk is passed to the callback @p cb as soon as all preceding
+ *  chunks are done. Thus, for each type of data the callback is executed in the
+ *  same order as in vrna_probs_window(), while different types of data may be
+ *  interleaved differently. The callback is never executed concurrently.
+ *
+ *  Sequences that are too short to be split, and fold compounds with hard or soft
+ *  constraints, or unstructured domains, are processed by vrna_probs_window() instead.
+ *
+ *  @see  vrna_probs_window()
+ *
+ *  @param  fc            The fold compound with sequence data, model settings and precomputed energy parameters
+ *  @param  ulength       The maximal length of an unpaired segment (only for unpaired probability computations)
+ *  @param  options       Option flags to control the behavior of this function
+ *  @param  cb            The callback function which collects the pair probability data for further processing
+ *  @param  data          Some arbitrary data structure that is passed to the callback @p cb
+ *  @param  num_threads   Number of threads to use (0 for the maximum number of OpenMP threads)
+ *  @return               0 on failure, non-zero on success
+ */
+int
+vrna_probs_window_parallel(vrna_fold_compound_t       *fc,
+                           int                        ulength,
+                           unsigned int               options,
+                           vrna_probs_window_callback *cb,
+                           void                       *data,
+                           unsigned int               num_threads);
+
 /* End basic interface */
 /**@}*/
 
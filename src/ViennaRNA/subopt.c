@@ -21,7 +21,6 @@
 #include "ViennaRNA/utils/strings.h"
 #include "ViennaRNA/params/default.h"
 #include "ViennaRNA/fold_vars.h"
-#include "ViennaRNA/datastructures/lists.h"
 #include "ViennaRNA/eval.h"
 #include "ViennaRNA/params/basic.h"
 #include "ViennaRNA/loops/all.h"
@@ -44,29 +43,154 @@
 #define ON_SAME_STRAND(I, J, C)  (((I) >= (C)) || ((J) < (C)))
 #endif
 
+#ifndef INLINE
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+#endif
+
+/* number of nodes that are allocated at once by a node arena */
+#define ARENA_BLOCK_NODES 4096
+
+/* default memory of structures buffered for energy-sorted output before they are written to disk */
+#define SORT_BUFFER_DEFAULT ((size_t)64 * 1024 * 1024)
+
 /**
  *  @brief  Sequence interval stack element used in subopt.c
+ *
+ *  Interval stacks are persistent singly-linked lists, i.e. a state derived
+ *  from another one pushes its new intervals on top of the (shared) stack of
+ *  its parent. Nodes are reference counted and live in a node arena.
  */
 typedef struct INTERVAL {
-  int i;
-  int j;
-  int array_flag;
+  struct INTERVAL *next;
+  unsigned int    ref;
+  int             i;
+  int             j;
+  int             array_flag;
 } INTERVAL;
 
+/**
+ *  @brief  Structure element (base pair or G-quadruplex) of a partial structure
+ *
+ *  Like the interval stacks, partial structures are persistent lists that
+ *  are shared among all states derived from the same parent. A base pair
+ *  (i,j) has @p L = 0, a G-quadruplex starts at @p i and consists of 4 stacks
+ *  of size @p L separated by linkers of lengths @p l.
+ */
+typedef struct ELEMENT {
+  struct ELEMENT  *next;
+  unsigned int    ref;
+  int             i;
+  int             j;
+  unsigned char   L;
+  unsigned char   l[3];
+} ELEMENT;
+
 typedef struct {
-  char  *structure;
-  LIST  *Intervals;
-  int   partial_energy;
-  int   is_duplex;
+  ELEMENT   *structure;
+  INTERVAL  *Intervals;
+  int       partial_energy;
+  int       is_duplex;
   /* int best_energy;   */ /* best attainable energy */
 } STATE;
 
+/**
+ *  @brief  Arena of fixed-size nodes
+ *
+ *  Nodes are carved from large blocks and recycled through a free list, the
+ *  blocks are only released once the enumeration is done.
+ */
 typedef struct {
-  LIST  *Intervals;
-  LIST  *Stack;
-  int   nopush;
+  size_t        size;         /* size of a node in bytes */
+  void          *free_list;
+  void          *blocks;      /* chain of allocated blocks */
+  unsigned long num_blocks;
+  unsigned long allocations;  /* number of nodes handed out */
+  unsigned long live;
+  unsigned long peak;
+} node_arena;
+
+typedef struct subopt_shared_s subopt_shared;
+
+/**
+ *  @brief  Per-thread data of the enumeration
+ *
+ *  The stack of states is used as a double ended queue in parallel
+ *  enumerations, where idle threads steal the bottom-most (oldest) states
+ *  of other threads.
+ */
+typedef struct {
+  STATE         **Stack;
+  unsigned long stack_first;  /* index of the bottom-most state */
+  unsigned long stack_size;
+  unsigned long stack_alloc;
+  unsigned long max_size;
+  int           nopush;
+  int           length;
+  int           concurrent;   /* other threads may access the stack and shared nodes */
+  node_arena    states;
+  node_arena    intervals;
+  node_arena    elements;
+  subopt_shared *shared;
+#ifdef _OPENMP
+  omp_lock_t    lock;
+#endif
 } subopt_env;
 
+/**
+ *  @brief  Stack of states that wait for later rounds of an energy-sorted enumeration
+ */
+typedef struct {
+  STATE         **states;
+  unsigned long size;
+  unsigned long alloc;
+} state_bucket;
+
+/**
+ *  @brief  Data shared by all threads of an enumeration
+ */
+struct subopt_shared_s {
+  vrna_fold_compound_t  *fc;
+  vrna_subopt_callback  *cb;
+  void                  *data;
+  int                   threshold;
+  int                   minimal_energy;
+  int                   recalc;       /* re-evaluate energies of solutions */
+  double                min_en;
+  double                eprint;
+  float                 correction;
+  int                   sorted;
+  int                   rounds;       /* process states in rounds of increasing lower bound */
+  int                   num_threads;
+  subopt_env            *envs;
+  long                  pending;      /* states on the stacks or in process */
+  int                   done;
+
+  /* energy-sorted output */
+  int                   level;        /* lower bound of states processed in the current round */
+  state_bucket          *buckets;     /* parked states, indexed by lower bound - minimal_energy */
+  unsigned long         num_buckets;
+  size_t                bucket_mem;
+  size_t                bucket_peak;
+  SOLUTION              *solutions;   /* structures found in the current round */
+  unsigned long         num_solutions;
+  unsigned long         max_solutions;
+  size_t                solution_mem;
+  size_t                solution_peak;
+  size_t                solution_limit;
+  size_t                length;       /* length of the structure strings */
+  FILE                  **runs;       /* sorted runs of solutions spilled to temporary files */
+  unsigned int          num_runs;
+  unsigned long         total_runs;
+#ifdef _OPENMP
+  omp_lock_t            bucket_lock;
+  omp_lock_t            output_lock;
+#endif
+};
+
 
 struct old_subopt_dat {
   unsigned long max_sol;
@@ -94,9 +218,17 @@ PUBLIC double print_energy = 9999;    /* printing threshold for use with logML *
 PRIVATE int                   backward_compat           = 0;
 PRIVATE vrna_fold_compound_t  *backward_compat_compound = NULL;
 
+/* maximum memory of structures buffered for energy-sorted output */
+PRIVATE size_t sort_buffer_size = SORT_BUFFER_DEFAULT;
+
+/* memory statistics of the last enumeration */
+PRIVATE vrna_subopt_stats_t last_stats = {
+  0, 0, 0, 0, 0, 0, 0
+};
+
 #ifdef _OPENMP
 
-#pragma omp threadprivate(backward_compat_compound, backward_compat)
+#pragma omp threadprivate(backward_compat_compound, backward_compat, last_stats)
 
 #endif
 
@@ -121,56 +253,71 @@ wrap_subopt(char          *seq,
 #endif
 
 PRIVATE void
-make_pair(int   i,
-          int   j,
-          STATE *state);
+arena_init(node_arena *arena,
+           size_t     size);
 
 
-/* mark a gquadruplex in the resulting dot-bracket structure */
 PRIVATE void
-make_gquad(int    i,
-           int    L,
-           int    l[3],
-           STATE  *state);
+arena_free(node_arena *arena);
 
 
-PRIVATE INTERVAL *
-make_interval(int i,
-              int j,
-              int ml);
+PRIVATE void
+make_pair(int         i,
+          int         j,
+          STATE       *state,
+          subopt_env  *env);
 
 
-PRIVATE STATE *
-make_state(LIST *Intervals,
-           char *structure,
-           int  partial_energy,
-           int  is_duplex,
-           int  length);
+/* mark a gquadruplex in the resulting dot-bracket structure */
+PRIVATE void
+make_gquad(int        i,
+           int        L,
+           int        l[3],
+           STATE      *state,
+           subopt_env *env);
 
 
-PRIVATE STATE *
-copy_state(STATE *state);
+PRIVATE void
+push_interval(STATE       *state,
+              int         i,
+              int         j,
+              int         array_flag,
+              subopt_env  *env);
 
 
 PRIVATE void
-print_state(STATE *state);
+pop_interval(STATE      *state,
+             INTERVAL   *interval,
+             subopt_env *env);
 
 
-PRIVATE void
-UNUSED print_stack(LIST *list);
+PRIVATE STATE *
+make_state(int        partial_energy,
+           int        is_duplex,
+           subopt_env *env);
 
 
-PRIVATE LIST *
-make_list(void);
+PRIVATE STATE *
+copy_state(STATE      *state,
+           subopt_env *env);
 
 
 PRIVATE void
-push(LIST *list,
-     void *data);
+print_state(STATE       *state,
+            subopt_env  *env);
 
 
 PRIVATE void
-*pop(LIST *list);
+UNUSED print_stack(subopt_env *env);
+
+
+PRIVATE INLINE void
+push(subopt_env *env,
+     STATE      *state);
+
+
+PRIVATE STATE *
+pop(subopt_env *env);
 
 
 PRIVATE int
@@ -189,31 +336,64 @@ scan_interval(vrna_fold_compound_t  *vc,
 
 
 PRIVATE void
-free_interval_node(INTERVAL *node);
+free_state_node(STATE       *node,
+                subopt_env  *env);
 
 
 PRIVATE void
-free_state_node(STATE *node);
+push_back(STATE       *state,
+          subopt_env  *env);
+
+
+PRIVATE char *
+get_structure(STATE       *state,
+              subopt_env  *env);
+
+
+PRIVATE int
+has_enclosing_brackets(STATE  *state,
+                       int    i,
+                       int    j);
 
 
 PRIVATE void
-push_back(LIST  *Stack,
-          STATE *state);
+env_init(subopt_env     *env,
+         subopt_shared  *shared);
 
 
-PRIVATE char *
-get_structure(STATE *state);
+PRIVATE void
+env_free(subopt_env *env);
 
 
-PRIVATE int
-compare(const void  *solution1,
-        const void  *solution2);
+PRIVATE void
+enumerate(subopt_env *env);
 
 
 PRIVATE void
-make_output(SOLUTION  *SL,
-            int       cp,
-            FILE      *fp);
+process_state(STATE       *state,
+              subopt_env  *env);
+
+
+PRIVATE void
+store_solution(STATE      *state,
+               subopt_env *env);
+
+
+PRIVATE void
+next_round(subopt_shared *shared);
+
+
+PRIVATE void
+spill_solutions(subopt_shared *shared);
+
+
+PRIVATE void
+flush_solutions(subopt_shared *shared);
+
+
+PRIVATE int
+compare(const void  *solution1,
+        const void  *solution2);
 
 
 PRIVATE void
@@ -260,103 +440,276 @@ old_subopt_store(const char *structure,
 
 
 /*---------------------------------------------------------------------------*/
-/*List routines--------------------------------------------------------------*/
+/*Node arenas----------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 
 PRIVATE void
-make_pair(int   i,
-          int   j,
-          STATE *state)
+arena_init(node_arena *arena,
+           size_t     size)
 {
-  state->structure[i - 1] = '(';
-  state->structure[j - 1] = ')';
+  /* nodes must be able to hold the free list link and keep pointers aligned */
+  size = (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+
+  arena->size         = size;
+  arena->free_list    = NULL;
+  arena->blocks       = NULL;
+  arena->num_blocks   = 0;
+  arena->allocations  = 0;
+  arena->live         = 0;
+  arena->peak         = 0;
 }
 
 
 PRIVATE void
-make_gquad(int    i,
-           int    L,
-           int    l[3],
-           STATE  *state)
+arena_grow(node_arena *arena)
 {
-  int x;
+  char          *block, *node;
+  unsigned int  n;
 
-  for (x = 0; x < L; x++) {
-    state->structure[i - 1 + x]                               = '+';
-    state->structure[i - 1 + x + L + l[0]]                    = '+';
-    state->structure[i - 1 + x + 2 * L + l[0] + l[1]]         = '+';
-    state->structure[i - 1 + x + 3 * L + l[0] + l[1] + l[2]]  = '+';
+  /* the first word of each block links to the previously allocated one */
+  block = (char *)vrna_alloc(sizeof(void *) + ARENA_BLOCK_NODES * arena->size);
+
+  *((void **)block) = arena->blocks;
+  arena->blocks     = block;
+  arena->num_blocks++;
+
+  /* thread the new nodes onto the free list, lowest address first */
+  for (n = ARENA_BLOCK_NODES; n > 0; n--) {
+    node                = block + sizeof(void *) + (n - 1) * arena->size;
+    *((void **)node)    = arena->free_list;
+    arena->free_list    = node;
   }
 }
 
 
+PRIVATE INLINE void *
+arena_alloc(node_arena *arena)
+{
+  void *node;
+
+  if (!arena->free_list)
+    arena_grow(arena);
+
+  node              = arena->free_list;
+  arena->free_list  = *((void **)node);
+
+  arena->allocations++;
+  if (++arena->live > arena->peak)
+    arena->peak = arena->live;
+
+  return node;
+}
+
+
+PRIVATE INLINE void
+arena_release(node_arena  *arena,
+              void        *node)
+{
+  *((void **)node)  = arena->free_list;
+  arena->free_list  = node;
+  arena->live--;
+}
+
+
+PRIVATE void
+arena_free(node_arena *arena)
+{
+  void *block, *next;
+
+  for (block = arena->blocks; block; block = next) {
+    next = *((void **)block);
+    free(block);
+  }
+
+  arena->blocks     = NULL;
+  arena->free_list  = NULL;
+}
+
+
+PRIVATE size_t
+arena_memory(node_arena *arena)
+{
+  return arena->num_blocks * (sizeof(void *) + ARENA_BLOCK_NODES * arena->size);
+}
+
+
+/*---------------------------------------------------------------------------*/
+/*List routines--------------------------------------------------------------*/
 /*---------------------------------------------------------------------------*/
 
-PRIVATE INTERVAL *
-make_interval(int i,
-              int j,
-              int array_flag)
+/* nodes may be shared among the threads of a parallel enumeration */
+PRIVATE INLINE void
+node_ref(unsigned int *ref,
+         subopt_env   *env)
+{
+#ifdef _OPENMP
+  if (env->concurrent) {
+#pragma omp atomic
+    (*ref)++;
+    return;
+  }
+
+#endif
+  (*ref)++;
+}
+
+
+PRIVATE INLINE unsigned int
+node_unref(unsigned int *ref,
+           subopt_env   *env)
+{
+  unsigned int r;
+
+#ifdef _OPENMP
+  if (env->concurrent) {
+#pragma omp atomic capture
+    r = --(*ref);
+    return r;
+  }
+
+#endif
+  r = --(*ref);
+
+  return r;
+}
+
+
+/* drop a reference to a persistent list and release all nodes no longer in use */
+PRIVATE INLINE void
+release_intervals(INTERVAL    *node,
+                  subopt_env  *env)
+{
+  INTERVAL *next;
+
+  while ((node) && (node_unref(&(node->ref), env) == 0)) {
+    next = node->next;
+    arena_release(&(env->intervals), node);
+    node = next;
+  }
+}
+
+
+PRIVATE INLINE void
+release_elements(ELEMENT    *node,
+                 subopt_env *env)
+{
+  ELEMENT *next;
+
+  while ((node) && (node_unref(&(node->ref), env) == 0)) {
+    next = node->next;
+    arena_release(&(env->elements), node);
+    node = next;
+  }
+}
+
+
+PRIVATE void
+make_pair(int         i,
+          int         j,
+          STATE       *state,
+          subopt_env  *env)
+{
+  ELEMENT *element;
+
+  /* the new element takes over the reference of state to the former head */
+  element         = arena_alloc(&(env->elements));
+  element->next   = state->structure;
+  element->ref    = 1;
+  element->i      = i;
+  element->j      = j;
+  element->L      = 0;
+  state->structure = element;
+}
+
+
+PRIVATE void
+make_gquad(int        i,
+           int        L,
+           int        l[3],
+           STATE      *state,
+           subopt_env *env)
+{
+  ELEMENT *element;
+
+  element           = arena_alloc(&(env->elements));
+  element->next     = state->structure;
+  element->ref      = 1;
+  element->i        = i;
+  element->j        = i + 4 * L + l[0] + l[1] + l[2] - 1;
+  element->L        = (unsigned char)L;
+  element->l[0]     = (unsigned char)l[0];
+  element->l[1]     = (unsigned char)l[1];
+  element->l[2]     = (unsigned char)l[2];
+  state->structure  = element;
+}
+
+
+/*---------------------------------------------------------------------------*/
+
+PRIVATE void
+push_interval(STATE       *state,
+              int         i,
+              int         j,
+              int         array_flag,
+              subopt_env  *env)
 {
   INTERVAL *interval;
 
-  interval              = lst_newnode(sizeof(INTERVAL));
+  interval              = arena_alloc(&(env->intervals));
+  interval->next        = state->Intervals;
+  interval->ref         = 1;
   interval->i           = i;
   interval->j           = j;
   interval->array_flag  = array_flag;
-  return interval;
+  state->Intervals      = interval;
 }
 
 
-/*---------------------------------------------------------------------------*/
-
+/* remove the top-most interval of a state and store a copy of it in interval */
 PRIVATE void
-free_interval_node(INTERVAL *node)
+pop_interval(STATE      *state,
+             INTERVAL   *interval,
+             subopt_env *env)
 {
-  lst_freenode(node);
+  INTERVAL *top;
+
+  top       = state->Intervals;
+  *interval = *top;
+
+  state->Intervals = top->next;
+  if (top->next)
+    node_ref(&(top->next->ref), env);
+
+  release_intervals(top, env);
 }
 
 
 /*---------------------------------------------------------------------------*/
 
 PRIVATE void
-free_state_node(STATE *node)
+free_state_node(STATE       *node,
+                subopt_env  *env)
 {
-  free(node->structure);
-  if (node->Intervals)
-    lst_kill(node->Intervals, lst_freenode);
-
-  lst_freenode(node);
+  release_elements(node->structure, env);
+  release_intervals(node->Intervals, env);
+  arena_release(&(env->states), node);
 }
 
 
 /*---------------------------------------------------------------------------*/
 
 PRIVATE STATE *
-make_state(LIST *Intervals,
-           char *structure,
-           int  partial_energy,
-           int  is_duplex,
-           int  length)
+make_state(int        partial_energy,
+           int        is_duplex,
+           subopt_env *env)
 {
   STATE *state;
 
-  state = lst_newnode(sizeof(STATE));
-
-  if (Intervals)
-    state->Intervals = Intervals;
-  else
-    state->Intervals = lst_init();
-
-  if (structure) {
-    state->structure = structure;
-  } else {
-    int i;
-    state->structure = (char *)vrna_alloc(length + 1);
-    for (i = 0; i < length; i++)
-      state->structure[i] = '.';
-  }
-
+  state                 = arena_alloc(&(env->states));
+  state->structure      = NULL;
+  state->Intervals      = NULL;
   state->partial_energy = partial_energy;
+  state->is_duplex      = is_duplex;
 
   return state;
 }
@@ -365,30 +718,20 @@ make_state(LIST *Intervals,
 /*---------------------------------------------------------------------------*/
 
 PRIVATE STATE *
-copy_state(STATE *state)
+copy_state(STATE      *state,
+           subopt_env *env)
 {
-  STATE     *new_state;
-  void      *after;
-  INTERVAL  *new_interval, *next;
-
-  new_state                 = lst_newnode(sizeof(STATE));
-  new_state->Intervals      = lst_init();
-  new_state->partial_energy = state->partial_energy;
-  /* new_state->best_energy = state->best_energy; */
-
-  if (state->Intervals->count) {
-    after = LST_HEAD(new_state->Intervals);
-    for (next = lst_first(state->Intervals); next; next = lst_next(next)) {
-      new_interval  = lst_newnode(sizeof(INTERVAL));
-      *new_interval = *next;
-      lst_insertafter(new_state->Intervals, new_interval, after);
-      after = new_interval;
-    }
-  }
+  STATE *new_state;
 
-  new_state->structure = strdup(state->structure);
-  if (!new_state->structure)
-    vrna_message_error("out of memory");
+  /* intervals and partial structure are shared with the parent state */
+  new_state   = arena_alloc(&(env->states));
+  *new_state  = *state;
+
+  if (new_state->structure)
+    node_ref(&(new_state->structure->ref), env);
+
+  if (new_state->Intervals)
+    node_ref(&(new_state->Intervals->ref), env);
 
   return new_state;
 }
@@ -397,37 +740,41 @@ copy_state(STATE *state)
 /*---------------------------------------------------------------------------*/
 
 /*@unused @*/ PRIVATE void
-print_state(STATE *state)
+print_state(STATE       *state,
+            subopt_env  *env)
 {
-  INTERVAL *next;
+  INTERVAL  *next;
+  char      *structure;
 
-  if (state->Intervals->count) {
-    printf("%d intervals:\n", state->Intervals->count);
-    for (next = lst_first(state->Intervals); next; next = lst_next(next))
+  if (state->Intervals) {
+    printf("intervals:\n");
+    for (next = state->Intervals; next; next = next->next)
       printf("[%d,%d],%d ", next->i, next->j, next->array_flag);
     printf("\n");
   }
 
-  printf("partial structure: %s\n", state->structure);
+  structure = get_structure(state, env);
+  printf("partial structure: %s\n", structure);
   printf("\n");
   printf(" partial_energy: %d\n", state->partial_energy);
   /* printf(" best_energy: %d\n", state->best_energy); */
   (void)fflush(stdout);
+  free(structure);
 }
 
 
 /*---------------------------------------------------------------------------*/
 
 /*@unused @*/ PRIVATE void
-print_stack(LIST *list)
+print_stack(subopt_env *env)
 {
-  void *rec;
+  unsigned long s;
 
   printf("================\n");
-  printf("%d states\n", list->count);
-  for (rec = lst_first(list); rec; rec = lst_next(rec)) {
+  printf("%lu states\n", env->stack_size);
+  for (s = env->stack_size; s > 0; s--) {
     printf("state-----------\n");
-    print_state(rec);
+    print_state(env->Stack[env->stack_first + s - 1], env);
   }
   printf("================\n");
 }
@@ -435,20 +782,123 @@ print_stack(LIST *list)
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE LIST *
-make_list(void)
+PRIVATE INLINE void
+lock_env(subopt_env *env)
 {
-  return lst_init();
+#ifdef _OPENMP
+  if (env->concurrent)
+    omp_set_lock(&(env->lock));
+
+#endif
 }
 
 
-/*---------------------------------------------------------------------------*/
+PRIVATE INLINE void
+unlock_env(subopt_env *env)
+{
+#ifdef _OPENMP
+  if (env->concurrent)
+    omp_unset_lock(&(env->lock));
+
+#endif
+}
+
+
+PRIVATE void
+append_state(subopt_env *env,
+             STATE      *state)
+{
+  if (env->stack_first + env->stack_size == env->stack_alloc) {
+    if (env->stack_first > env->stack_size) {
+      /* states have been stolen from the bottom, re-use their space */
+      memmove(env->Stack, env->Stack + env->stack_first, sizeof(STATE *) * env->stack_size);
+      env->stack_first = 0;
+    } else {
+      env->stack_alloc  *= 2;
+      env->Stack        = (STATE **)vrna_realloc(env->Stack, sizeof(STATE *) * env->stack_alloc);
+    }
+  }
+
+  env->Stack[env->stack_first + env->stack_size++] = state;
+
+  if (env->stack_size > env->max_size)
+    env->max_size = env->stack_size;
+}
+
 
+/* store a state for the round of an energy-sorted enumeration that matches its lower bound */
 PRIVATE void
-push(LIST *list,
-     void *data)
+park_state(subopt_shared  *shared,
+           STATE          *state,
+           int            e)
+{
+  unsigned long b;
+  state_bucket  *bucket;
+
+  b = (unsigned long)(MIN2(e, shared->threshold) - shared->minimal_energy);
+
+#ifdef _OPENMP
+  if (shared->num_threads > 1)
+    omp_set_lock(&(shared->bucket_lock));
+
+#endif
+
+  if (b >= shared->num_buckets) {
+    shared->buckets = (state_bucket *)vrna_realloc(shared->buckets, sizeof(state_bucket) * (b + 1));
+    memset(shared->buckets + shared->num_buckets, 0,
+           sizeof(state_bucket) * (b + 1 - shared->num_buckets));
+    shared->bucket_mem  += sizeof(state_bucket) * (b + 1 - shared->num_buckets);
+    shared->num_buckets = b + 1;
+  }
+
+  bucket = shared->buckets + b;
+
+  if (bucket->size == bucket->alloc) {
+    shared->bucket_mem  -= sizeof(STATE *) * bucket->alloc;
+    bucket->alloc       = (bucket->alloc) ? 2 * bucket->alloc : 64;
+    bucket->states      = (STATE **)vrna_realloc(bucket->states, sizeof(STATE *) * bucket->alloc);
+    shared->bucket_mem  += sizeof(STATE *) * bucket->alloc;
+  }
+
+  bucket->states[bucket->size++] = state;
+
+  if (shared->bucket_mem > shared->bucket_peak)
+    shared->bucket_peak = shared->bucket_mem;
+
+#ifdef _OPENMP
+  if (shared->num_threads > 1)
+    omp_unset_lock(&(shared->bucket_lock));
+
+#endif
+}
+
+
+PRIVATE INLINE void
+push(subopt_env *env,
+     STATE      *state)
 {
-  lst_insertafter(list, data, LST_HEAD(list));
+  int           e;
+  subopt_shared *shared = env->shared;
+
+  if (shared->rounds) {
+    e = best_attainable_energy(shared->fc, state);
+    if (e > shared->level) {
+      park_state(shared, state, e);
+      return;
+    }
+  }
+
+  if (env->concurrent) {
+    lock_env(env);
+    append_state(env, state);
+    unlock_env(env);
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+    shared->pending++;
+  } else {
+    append_state(env, state);
+  }
 }
 
 
@@ -466,13 +916,52 @@ push(LIST *list,
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void *
-pop(LIST *list)
+PRIVATE STATE *
+pop(subopt_env *env)
 {
-  void *data;
+  STATE *state = NULL;
 
-  data = lst_deletenext(list, LST_HEAD(list));
-  return data;
+  lock_env(env);
+
+  if (env->stack_size > 0) {
+    state = env->Stack[env->stack_first + --env->stack_size];
+    if (env->stack_size == 0)
+      env->stack_first = 0;
+  }
+
+  unlock_env(env);
+
+  return state;
+}
+
+
+/* take the bottom-most state from the stack of another thread */
+PRIVATE STATE *
+steal(subopt_env *env)
+{
+  int           k, n;
+  STATE         *state;
+  subopt_env    *victim;
+  subopt_shared *shared = env->shared;
+
+  state = NULL;
+  n     = shared->num_threads;
+
+  for (k = 1; (k < n) && (!state); k++) {
+    victim = shared->envs + (env - shared->envs + k) % n;
+
+    lock_env(victim);
+
+    if (victim->stack_size > 0) {
+      state = victim->Stack[victim->stack_first++];
+      if (--victim->stack_size == 0)
+        victim->stack_first = 0;
+    }
+
+    unlock_env(victim);
+  }
+
+  return state;
 }
 
 
@@ -498,7 +987,7 @@ best_attainable_energy(vrna_fold_compound_t *vc,
 
   sum = state->partial_energy;  /* energy of already found elements */
 
-  for (next = lst_first(state->Intervals); next; next = lst_next(next)) {
+  for (next = state->Intervals; next; next = next->next) {
     if (next->array_flag == 0)
       sum += (md->circ) ? matrices->Fc : matrices->f5[next->j];
     else if (next->array_flag == 1)
@@ -512,7 +1001,7 @@ best_attainable_energy(vrna_fold_compound_t *vc,
     else if (next->array_flag == 5)
       sum += matrices->fc[next->j];
     else if (next->array_flag == 6)
-      sum += matrices->ggg[indx[next->j] + next->i];
+      sum += gquad_mx_get(matrices->ggg, next->i, next->j);
   }
 
   return sum;
@@ -522,10 +1011,10 @@ best_attainable_energy(vrna_fold_compound_t *vc,
 /*---------------------------------------------------------------------------*/
 
 PRIVATE void
-push_back(LIST  *Stack,
-          STATE *state)
+push_back(STATE       *state,
+          subopt_env  *env)
 {
-  push(Stack, copy_state(state));
+  push(env, copy_state(state, env));
   return;
 }
 
@@ -533,15 +1022,67 @@ push_back(LIST  *Stack,
 /*---------------------------------------------------------------------------*/
 
 PRIVATE char *
-get_structure(STATE *state)
+get_structure(STATE       *state,
+              subopt_env  *env)
 {
-  char *structure;
+  char    *structure;
+  int     x, L;
+  ELEMENT *e;
+
+  structure = (char *)vrna_alloc(sizeof(char) * (env->length + 1));
+  memset(structure, '.', env->length);
+
+  for (e = state->structure; e; e = e->next) {
+    if (e->L == 0) {
+      structure[e->i - 1] = '(';
+      structure[e->j - 1] = ')';
+    } else {
+      L = e->L;
+      for (x = 0; x < L; x++) {
+        structure[e->i - 1 + x]                                       = '+';
+        structure[e->i - 1 + x + L + e->l[0]]                         = '+';
+        structure[e->i - 1 + x + 2 * L + e->l[0] + e->l[1]]           = '+';
+        structure[e->i - 1 + x + 3 * L + e->l[0] + e->l[1] + e->l[2]] = '+';
+      }
+    }
+  }
 
-  structure = strdup(state->structure);
   return structure;
 }
 
 
+/*---------------------------------------------------------------------------*/
+
+/*
+ *  check whether nucleotide i - 1 is an opening and j + 1 a closing bracket
+ *  in the partial structure of a state, i.e. whether the pair (i, j) is
+ *  directly enclosed by the pair (i - 1, j + 1).
+ *
+ *  Both pairs can only be added by the same stack decomposition in repeat(),
+ *  which pushes the interval [i, j] of the inner pair on top of the interval
+ *  stack right after. So if they exist, they are the two most recent
+ *  elements of the partial structure, and we don't need to scan the entire
+ *  list
+ */
+PRIVATE int
+has_enclosing_brackets(STATE  *state,
+                       int    i,
+                       int    j)
+{
+  ELEMENT *e;
+
+  e = state->structure;
+
+  if ((e) && (e->L == 0) && (e->i == i) && (e->j == j)) {
+    e = e->next;
+    if ((e) && (e->L == 0) && (e->i == i - 1) && (e->j == j + 1))
+      return 1;
+  }
+
+  return 0;
+}
+
+
 /*---------------------------------------------------------------------------*/
 PRIVATE int
 compare(const void  *solution1,
@@ -558,34 +1099,17 @@ compare(const void  *solution1,
 }
 
 
-/*---------------------------------------------------------------------------*/
-
-PRIVATE void
-make_output(SOLUTION  *SL,
-            int       cp,
-            FILE      *fp)                                /* prints stuff */
-{
-  SOLUTION *sol;
-
-  for (sol = SL; sol->structure != NULL; sol++) {
-    char *e_string = vrna_strdup_printf(" %6.2f", sol->energy);
-    print_structure(fp, sol->structure, e_string);
-    free(e_string);
-  }
-}
-
-
 PRIVATE STATE *
-derive_new_state(int    i,
-                 int    j,
-                 STATE  *s,
-                 int    e,
-                 int    flag)
+derive_new_state(int        i,
+                 int        j,
+                 STATE      *s,
+                 int        e,
+                 int        flag,
+                 subopt_env *env)
 {
-  STATE     *s_new  = copy_state(s);
-  INTERVAL  *ival   = make_interval(i, j, flag);
+  STATE *s_new = copy_state(s, env);
 
-  push(s_new->Intervals, ival);
+  push_interval(s_new, i, j, flag, env);
 
   s_new->partial_energy += e;
 
@@ -601,9 +1125,9 @@ fork_state(int        i,
            int        flag,
            subopt_env *env)
 {
-  STATE *s_new = derive_new_state(i, j, s, e, flag);
+  STATE *s_new = derive_new_state(i, j, s, e, flag, env);
 
-  push(env->Stack, s_new);
+  push(env, s_new);
   env->nopush = false;
 }
 
@@ -617,11 +1141,11 @@ fork_int_state(int        i,
                int        e,
                subopt_env *env)
 {
-  STATE *s_new = derive_new_state(p, q, s, e, 2);
+  STATE *s_new = derive_new_state(p, q, s, e, 2, env);
 
-  make_pair(i, j, s_new);
-  make_pair(p, q, s_new);
-  push(env->Stack, s_new);
+  make_pair(i, j, s_new, env);
+  make_pair(p, q, s_new, env);
+  push(env, s_new);
   env->nopush = false;
 }
 
@@ -635,10 +1159,10 @@ fork_state_pair(int         i,
 {
   STATE *new_state;
 
-  new_state = copy_state(s);
-  make_pair(i, j, new_state);
+  new_state = copy_state(s, env);
+  make_pair(i, j, new_state, env);
   new_state->partial_energy += e;
-  push(env->Stack, new_state);
+  push(env, new_state);
   env->nopush = false;
 }
 
@@ -653,25 +1177,22 @@ fork_two_states_pair(int        i,
                      int        flag2,
                      subopt_env *env)
 {
-  INTERVAL  *interval1, *interval2;
-  STATE     *new_state;
+  STATE *new_state;
 
-  new_state = copy_state(s);
-  interval1 = make_interval(i + 1, k - 1, flag1);
-  interval2 = make_interval(k, j - 1, flag2);
+  new_state = copy_state(s, env);
   if (k - i < j - k) {
     /* push larger interval first */
-    push(new_state->Intervals, interval1);
-    push(new_state->Intervals, interval2);
+    push_interval(new_state, i + 1, k - 1, flag1, env);
+    push_interval(new_state, k, j - 1, flag2, env);
   } else {
-    push(new_state->Intervals, interval2);
-    push(new_state->Intervals, interval1);
+    push_interval(new_state, k, j - 1, flag2, env);
+    push_interval(new_state, i + 1, k - 1, flag1, env);
   }
 
-  make_pair(i, j, new_state);
+  make_pair(i, j, new_state, env);
   new_state->partial_energy += e;
 
-  push(env->Stack, new_state);
+  push(env, new_state);
   env->nopush = false;
 }
 
@@ -687,24 +1208,21 @@ fork_two_states(int         i,
                 int         flag2,
                 subopt_env  *env)
 {
-  INTERVAL  *interval1, *interval2;
-  STATE     *new_state;
+  STATE *new_state;
 
-  new_state = copy_state(s);
-  interval1 = make_interval(i, j, flag1);
-  interval2 = make_interval(p, q, flag2);
+  new_state = copy_state(s, env);
 
   if ((j - i) < (q - p)) {
-    push(new_state->Intervals, interval1);
-    push(new_state->Intervals, interval2);
+    push_interval(new_state, i, j, flag1, env);
+    push_interval(new_state, p, q, flag2, env);
   } else {
-    push(new_state->Intervals, interval2);
-    push(new_state->Intervals, interval1);
+    push_interval(new_state, p, q, flag2, env);
+    push_interval(new_state, i, j, flag1, env);
   }
 
   new_state->partial_energy += e;
 
-  push(env->Stack, new_state);
+  push(env, new_state);
   env->nopush = false;
 }
 
@@ -718,6 +1236,17 @@ vrna_subopt(vrna_fold_compound_t  *vc,
             int                   delta,
             int                   sorted,
             FILE                  *fp)
+{
+  return vrna_subopt_parallel(vc, delta, sorted, fp, 1);
+}
+
+
+PUBLIC SOLUTION *
+vrna_subopt_parallel(vrna_fold_compound_t *vc,
+                     int                  delta,
+                     int                  sorted,
+                     FILE                 *fp,
+                     unsigned int         num_threads)
 {
   struct old_subopt_dat data;
 
@@ -750,17 +1279,29 @@ vrna_subopt(vrna_fold_compound_t  *vc,
       vrna_mx_mfe_free(vc);
     }
 
-    /* call subopt() */
-    vrna_subopt_cb(vc, delta, (!sorted && fp) ? &old_subopt_print : &old_subopt_store,
-                   (void *)&data);
+    if (fp && sorted) {
+      /*
+       *  print structures in order of increasing free energy as soon as
+       *  they are known instead of collecting and sorting all of them
+       */
+      vrna_subopt_cb_parallel(vc,
+                              delta,
+                              &old_subopt_print,
+                              (void *)&data,
+                              num_threads,
+                              VRNA_SUBOPT_DEFAULT);
+    } else {
+      /* call subopt() */
+      vrna_subopt_cb_parallel(vc,
+                              delta,
+                              (fp) ? &old_subopt_print : &old_subopt_store,
+                              (void *)&data,
+                              num_threads,
+                              VRNA_SUBOPT_UNORDERED);
 
-    if (sorted) {
       /* sort structures by energy */
-      if (data.n_sol > 0)
+      if ((sorted) && (data.n_sol > 0))
         qsort(data.SolutionList, data.n_sol - 1, sizeof(SOLUTION), compare);
-
-      if (fp)
-        make_output(data.SolutionList, vc->cutpoint, fp);
     }
 
     if (fp) {
@@ -783,14 +1324,23 @@ vrna_subopt_cb(vrna_fold_compound_t *vc,
                vrna_subopt_callback *cb,
                void                 *data)
 {
-  subopt_env    *env;
+  vrna_subopt_cb_parallel(vc, delta, cb, data, 1, VRNA_SUBOPT_UNORDERED);
+}
+
+
+PUBLIC void
+vrna_subopt_cb_parallel(vrna_fold_compound_t  *vc,
+                        int                   delta,
+                        vrna_subopt_callback  *cb,
+                        void                  *data,
+                        unsigned int          num_threads,
+                        unsigned int          options)
+{
+  subopt_shared shared;
   STATE         *state;
-  INTERVAL      *interval;
-  int           maxlevel, count, partial_energy, old_dangles, logML, dangle_model, length, circular,
-                threshold, cp;
-  double        structure_energy, min_en, eprint;
-  char          *struc, *structure;
-  float         correction;
+  int           t, old_dangles, logML, dangle_model, length, circular, threshold;
+  double        min_en;
+  char          *struc;
   vrna_param_t  *P;
   vrna_md_t     *md;
   int           minimal_energy;
@@ -800,7 +1350,6 @@ vrna_subopt_cb(vrna_fold_compound_t *vc,
   vrna_fold_compound_prepare(vc, VRNA_OPTION_MFE | VRNA_OPTION_HYBRID);
 
   length  = vc->length;
-  cp      = vc->cutpoint;
   P       = vc->params;
   md      = &(P->model_details);
 
@@ -841,15 +1390,6 @@ vrna_subopt_cb(vrna_fold_compound_t *vc,
   }
 
   free(struc);
-  eprint = print_energy + min_en;
-
-  correction = (min_en < 0) ? -0.1 : 0.1;
-
-  /* Initialize ------------------------------------------------------------ */
-
-  maxlevel        = 0;
-  count           = 0;
-  partial_energy  = 0;
 
   /* Initialize the stack ------------------------------------------------- */
 
@@ -860,93 +1400,487 @@ vrna_subopt_cb(vrna_fold_compound_t *vc,
     threshold = INF - EMAX;
   }
 
-  /* init env data structure */
-  env             = (subopt_env *)vrna_alloc(sizeof(subopt_env));
-  env->Stack      = NULL;
-  env->nopush     = true;
-  env->Stack      = make_list();                      /* anchor */
-  env->Intervals  = make_list();                      /* initial state: */
-  interval        = make_interval(1, length, 0);      /* interval [1,length,0] */
-  push(env->Intervals, interval);
-  env->nopush = false;
-  state       = make_state(env->Intervals, NULL, partial_energy, 0, length);
+#ifdef _OPENMP
+  if (num_threads == 0)
+    num_threads = (unsigned int)omp_get_max_threads();
+
+#else
+  num_threads = 1;
+#endif
+
+  if (num_threads == 0)
+    num_threads = 1;
+
+  shared.fc             = vc;
+  shared.cb             = cb;
+  shared.data           = data;
+  shared.threshold      = threshold;
+  shared.minimal_energy = minimal_energy;
+  shared.recalc         = (logML || (dangle_model == 1) || (dangle_model == 3)) ? 1 : 0;
+  shared.min_en         = min_en;
+  shared.eprint         = print_energy + min_en;
+  shared.correction     = (min_en < 0) ? -0.1 : 0.1;
+  shared.sorted         = (options & VRNA_SUBOPT_UNORDERED) ? 0 : 1;
+  /*
+   *  lower bounds of states are not reliable without lonely pairs, and
+   *  re-evaluated energies are only known at the very end. In both cases,
+   *  all structures are collected and sorted once
+   */
+  shared.rounds         = (shared.sorted && !shared.recalc && !md->noLP) ? 1 : 0;
+  shared.num_threads    = (int)num_threads;
+  shared.pending        = 0;
+  shared.done           = 0;
+  shared.level          = minimal_energy;
+  shared.buckets        = NULL;
+  shared.num_buckets    = 0;
+  shared.bucket_mem     = 0;
+  shared.bucket_peak    = 0;
+  shared.solutions      = NULL;
+  shared.num_solutions  = 0;
+  shared.max_solutions  = 0;
+  shared.solution_mem   = 0;
+  shared.solution_peak  = 0;
+  shared.solution_limit = sort_buffer_size;
+  shared.length         = (vc->cutpoint > 0) ? length + 1 : length;
+  shared.runs           = NULL;
+  shared.num_runs       = 0;
+  shared.total_runs     = 0;
+  shared.envs           = (subopt_env *)vrna_alloc(sizeof(subopt_env) * num_threads);
+
+#ifdef _OPENMP
+  omp_init_lock(&(shared.bucket_lock));
+  omp_init_lock(&(shared.output_lock));
+#endif
+
+  for (t = 0; t < (int)num_threads; t++)
+    env_init(shared.envs + t, &shared);
+
+  /* initial state: interval [1,length,0] */
+  state = make_state(0, 0, shared.envs);
+  push_interval(state, 1, length, 0, shared.envs);
   /* state->best_energy = minimal_energy; */
-  push(env->Stack, state);
-  env->nopush = false;
+  push(shared.envs, state);
 
   /* end initialize ------------------------------------------------------- */
 
+#ifdef _OPENMP
+#pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+#endif
+  {
+    subopt_env *env = shared.envs;
+
+#ifdef _OPENMP
+    env += omp_get_thread_num();
+#endif
+
+    enumerate(env);
+  }
+
+  cb(NULL, 0, data);   /* NULL (last time to call callback function */
+
+  /* collect memory statistics */
+  last_stats.states       = 0;
+  last_stats.intervals    = 0;
+  last_stats.elements     = 0;
+  last_stats.allocations  = 0;
+  last_stats.max_stack    = 0;
+  last_stats.runs         = shared.total_runs;
+  last_stats.peak_memory  = shared.bucket_peak + shared.solution_peak;
+
+  for (t = 0; t < (int)num_threads; t++) {
+    subopt_env *env = shared.envs + t;
+
+    last_stats.states       += env->states.allocations;
+    last_stats.intervals    += env->intervals.allocations;
+    last_stats.elements     += env->elements.allocations;
+    last_stats.allocations  += env->states.num_blocks +
+                               env->intervals.num_blocks +
+                               env->elements.num_blocks;
+    last_stats.max_stack    = MAX2(last_stats.max_stack, env->max_size);
+    last_stats.peak_memory  += arena_memory(&(env->states)) +
+                               arena_memory(&(env->intervals)) +
+                               arena_memory(&(env->elements)) +
+                               sizeof(STATE *) * env->stack_alloc;
+
+    env_free(env);
+  }
+
+  /* cleanup memory */
+  for (t = 0; t < (int)shared.num_buckets; t++)
+    free(shared.buckets[t].states);
+
+  free(shared.buckets);
+  free(shared.solutions);
+  free(shared.runs);
+  free(shared.envs);
+
+#ifdef _OPENMP
+  omp_destroy_lock(&(shared.bucket_lock));
+  omp_destroy_lock(&(shared.output_lock));
+#endif
+}
+
+
+PUBLIC void
+vrna_subopt_stats(vrna_subopt_stats_t *stats)
+{
+  if (stats)
+    *stats = last_stats;
+}
+
+
+PUBLIC size_t
+vrna_subopt_sort_buffer(size_t size)
+{
+  size_t old = sort_buffer_size;
+
+  if (size > 0)
+    sort_buffer_size = size;
+
+  return old;
+}
+
+
+PRIVATE void
+env_init(subopt_env     *env,
+         subopt_shared  *shared)
+{
+  env->length       = shared->fc->length;
+  env->stack_first  = 0;
+  env->stack_size   = 0;
+  env->stack_alloc  = 1024;
+  env->max_size     = 0;
+  env->Stack        = (STATE **)vrna_alloc(sizeof(STATE *) * env->stack_alloc);
+  env->nopush       = true;
+  env->shared       = shared;
+  env->concurrent   = (shared->num_threads > 1) ? 1 : 0;
+
+  arena_init(&(env->states), sizeof(STATE));
+  arena_init(&(env->intervals), sizeof(INTERVAL));
+  arena_init(&(env->elements), sizeof(ELEMENT));
+
+#ifdef _OPENMP
+  omp_init_lock(&(env->lock));
+#endif
+}
+
+
+PRIVATE void
+env_free(subopt_env *env)
+{
+  arena_free(&(env->states));
+  arena_free(&(env->intervals));
+  arena_free(&(env->elements));
+  free(env->Stack);
+
+#ifdef _OPENMP
+  omp_destroy_lock(&(env->lock));
+#endif
+}
+
+
+/* enumeration loop of a single thread */
+PRIVATE void
+enumerate(subopt_env *env)
+{
+  long          pending;
+  STATE         *state;
+  subopt_shared *shared = env->shared;
 
   while (1) {
-    /* forever, til nothing remains on stack */
+    /* process all states of the current round */
+    while (1) {
+      state = pop(env);
 
-    maxlevel = (env->Stack->count > maxlevel ? env->Stack->count : maxlevel);
+      if ((!state) && (shared->num_threads > 1))
+        state = steal(env);
 
-    if (LST_EMPTY(env->Stack)) {
-      /* we are done! clean up and quit */
-      /* fprintf(stderr, "maxlevel: %d\n", maxlevel); */
+      if (state) {
+        process_state(state, env);
 
-      lst_kill(env->Stack, free_state_node);
+        if (shared->num_threads > 1) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+          shared->pending--;
+        }
 
-      cb(NULL, 0, data);   /* NULL (last time to call callback function */
+        continue;
+      }
 
-      break;
+      if (shared->num_threads == 1)
+        break;
+
+#ifdef _OPENMP
+#pragma omp atomic read
+#endif
+      pending = shared->pending;
+
+      /* no state left on any stack and none in process that could produce new ones */
+      if (pending == 0)
+        break;
     }
 
-    /* pop the last element ---------------------------------------------- */
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+    next_round(shared);
 
-    state = pop(env->Stack);                       /* current state to work with */
+    if (shared->done)
+      break;
+  }
+}
 
-    if (LST_EMPTY(state->Intervals)) {
-      int e;
-      /* state has no intervals left: we got a solution */
 
-      count++;
-      structure         = get_structure(state);
-      structure_energy  = state->partial_energy / 100.;
+PRIVATE void
+process_state(STATE       *state,
+              subopt_env  *env)
+{
+  INTERVAL interval;
+
+  if (!state->Intervals) {
+    /* state has no intervals left: we got a solution */
+    store_solution(state, env);
+  } else {
+    /* get (and remove) next interval of state to analyze */
+    pop_interval(state, &interval, env);
+    scan_interval(env->shared->fc,
+                  interval.i,
+                  interval.j,
+                  interval.array_flag,
+                  env->shared->threshold,
+                  state,
+                  env);
+  }
+
+  free_state_node(state, env);                /* free the current state */
+}
+
+
+PRIVATE void
+store_solution(STATE      *state,
+               subopt_env *env)
+{
+  int           e;
+  double        structure_energy;
+  char          *structure, *outstruct;
+  subopt_shared *shared = env->shared;
+
+  structure         = get_structure(state, env);
+  structure_energy  = state->partial_energy / 100.;
+
+#ifdef _OPENMP
+  if (shared->num_threads > 1)
+    omp_set_lock(&(shared->output_lock));
+
+#endif
 
 #ifdef CHECK_ENERGY
-      structure_energy = vrna_eval_structure(vc, structure);
-
-      if (!logML)
-        if ((double)(state->partial_energy / 100.) != structure_energy) {
-          vrna_message_error("%s %6.2f %6.2f",
-                             structure,
-                             state->partial_energy / 100.,
-                             structure_energy);
-          exit(1);
-        }
+  structure_energy = vrna_eval_structure(shared->fc, structure);
+
+  if (!shared->fc->params->model_details.logML)
+    if ((double)(state->partial_energy / 100.) != structure_energy) {
+      vrna_message_error("%s %6.2f %6.2f",
+                         structure,
+                         state->partial_energy / 100.,
+                         structure_energy);
+      exit(1);
+    }
 
 #endif
-      if (logML || (dangle_model == 1) || (dangle_model == 3)) /* recalc energy */
-        structure_energy = vrna_eval_structure(vc, structure);
-
-      e = (int)((structure_energy - min_en) * 10. - correction); /* avoid rounding errors */
-      if (e > MAXDOS)
-        e = MAXDOS;
-
-      density_of_states[e]++;
-      if (structure_energy <= eprint) {
-        char *outstruct = vrna_cut_point_insert(structure, cp);
-        cb((const char *)outstruct, structure_energy, data);
-        free(outstruct);
+  if (shared->recalc) /* recalc energy */
+    structure_energy = vrna_eval_structure(shared->fc, structure);
+
+  e = (int)((structure_energy - shared->min_en) * 10. - shared->correction); /* avoid rounding errors */
+  if (e > MAXDOS)
+    e = MAXDOS;
+
+  density_of_states[e]++;
+  if (structure_energy <= shared->eprint) {
+    outstruct = vrna_cut_point_insert(structure, shared->fc->cutpoint);
+
+    if (shared->sorted) {
+      /* keep the structure until all structures of this energy are known */
+      if (shared->num_solutions == shared->max_solutions) {
+        shared->max_solutions = (shared->max_solutions) ? 2 * shared->max_solutions : 128;
+        shared->solutions     = (SOLUTION *)vrna_realloc(shared->solutions,
+                                                         sizeof(SOLUTION) * shared->max_solutions);
       }
 
-      free(structure);
+      shared->solutions[shared->num_solutions].energy       = (float)structure_energy;
+      shared->solutions[shared->num_solutions++].structure  = outstruct;
+      shared->solution_mem                                  += sizeof(SOLUTION) + shared->length + 1;
+
+      if (shared->solution_mem > shared->solution_peak)
+        shared->solution_peak = shared->solution_mem;
+
+      if (shared->solution_mem > shared->solution_limit)
+        spill_solutions(shared);
     } else {
-      /* get (and remove) next interval of state to analyze */
+      shared->cb((const char *)outstruct, structure_energy, shared->data);
+      free(outstruct);
+    }
+  }
 
-      interval = pop(state->Intervals);
-      scan_interval(vc, interval->i, interval->j, interval->array_flag, threshold, state, env);
+#ifdef _OPENMP
+  if (shared->num_threads > 1)
+    omp_unset_lock(&(shared->output_lock));
+
+#endif
 
-      free_interval_node(interval);        /* free the current interval */
+  free(structure);
+}
+
+
+/* deliver the structures of the finished round and distribute the states of the next one */
+PRIVATE void
+next_round(subopt_shared *shared)
+{
+  unsigned long b, k;
+  state_bucket  *bucket;
+
+  /* find the next round with pending states */
+  for (b = shared->level - shared->minimal_energy + 1; b < shared->num_buckets; b++)
+    if (shared->buckets[b].size > 0)
+      break;
+
+  if (shared->sorted) {
+    /*
+     *  unless energies are re-evaluated, all structures with an energy up to
+     *  the current level have been found
+     */
+    if ((shared->rounds) || (b >= shared->num_buckets))
+      flush_solutions(shared);
+  }
+
+  if (b >= shared->num_buckets) {
+    shared->done = 1;
+    return;
+  }
+
+  shared->level = shared->minimal_energy + (int)b;
+  bucket        = shared->buckets + b;
+
+  for (k = 0; k < bucket->size; k++)
+    append_state(shared->envs + k % shared->num_threads, bucket->states[k]);
+
+  shared->pending     = (long)bucket->size;
+  shared->bucket_mem  -= sizeof(STATE *) * bucket->alloc;
+
+  free(bucket->states);
+  bucket->states  = NULL;
+  bucket->size    = 0;
+  bucket->alloc   = 0;
+}
+
+
+/* sort the buffered structures and write them to a temporary file */
+PRIVATE void
+spill_solutions(subopt_shared *shared)
+{
+  unsigned long k;
+  FILE          *fp;
+
+  fp = tmpfile();
+  if (!fp) {
+    vrna_message_warning("subopt: Failed to create temporary file, keeping all structures in memory");
+    shared->solution_limit = (size_t)(-1);
+    return;
+  }
+
+  qsort(shared->solutions, shared->num_solutions, sizeof(SOLUTION), compare);
+
+  /* all records have the same size, energy followed by the structure */
+  for (k = 0; k < shared->num_solutions; k++) {
+    if ((fwrite(&(shared->solutions[k].energy), sizeof(float), 1, fp) != 1) ||
+        (fwrite(shared->solutions[k].structure, sizeof(char), shared->length, fp) !=
+         shared->length))
+      vrna_message_error("subopt: Failed to write to temporary file");
+
+    free(shared->solutions[k].structure);
+  }
+
+  shared->runs                      = (FILE **)vrna_realloc(shared->runs,
+                                                            sizeof(FILE *) *
+                                                            (shared->num_runs + 1));
+  shared->runs[shared->num_runs++]  = fp;
+  shared->total_runs++;
+  shared->num_solutions             = 0;
+  shared->solution_mem              = 0;
+}
+
+
+PRIVATE int
+read_solution(FILE      *fp,
+              SOLUTION  *sol,
+              size_t    length)
+{
+  if ((fread(&(sol->energy), sizeof(float), 1, fp) != 1) ||
+      (fread(sol->structure, sizeof(char), length, fp) != length))
+    return 0;
+
+  return 1;
+}
+
+
+/* pass all buffered structures to the callback in order of increasing free energy */
+PRIVATE void
+flush_solutions(subopt_shared *shared)
+{
+  unsigned int  r, best, num;
+  unsigned long k;
+  SOLUTION      *heads;
+  FILE          **runs;
+
+  if (shared->num_runs == 0) {
+    qsort(shared->solutions, shared->num_solutions, sizeof(SOLUTION), compare);
+
+    for (k = 0; k < shared->num_solutions; k++) {
+      shared->cb((const char *)shared->solutions[k].structure,
+                 shared->solutions[k].energy,
+                 shared->data);
+      free(shared->solutions[k].structure);
     }
 
-    free_state_node(state);                     /* free the current state */
-  } /* end of while (1) */
+    shared->num_solutions = 0;
+    shared->solution_mem  = 0;
+    return;
+  }
 
-  /* cleanup memory */
-  free(env);
+  /* merge the sorted runs */
+  if (shared->num_solutions > 0)
+    spill_solutions(shared);
+
+  num   = shared->num_runs;
+  runs  = shared->runs;
+  heads = (SOLUTION *)vrna_alloc(sizeof(SOLUTION) * num);
+
+  for (r = 0; r < num; r++) {
+    rewind(runs[r]);
+    heads[r].structure = (char *)vrna_alloc(sizeof(char) * (shared->length + 1));
+    (void)read_solution(runs[r], heads + r, shared->length);
+  }
+
+  while (num > 0) {
+    for (best = 0, r = 1; r < num; r++)
+      if (compare(heads + r, heads + best) < 0)
+        best = r;
+
+    shared->cb((const char *)heads[best].structure, heads[best].energy, shared->data);
+
+    if (!read_solution(runs[best], heads + best, shared->length)) {
+      /* run exhausted */
+      fclose(runs[best]);
+      free(heads[best].structure);
+      num--;
+      runs[best]  = runs[num];
+      heads[best] = heads[num];
+    }
+  }
+
+  free(heads);
+  shared->num_runs = 0;
 }
 
 
@@ -966,23 +1900,23 @@ scan_interval(vrna_fold_compound_t  *vc,
   /* array_flag = 2:  trace back in repeat()  */
   /* array_flag = 3:  trace back in fM1-array */
 
-  STATE         *new_state, *temp_state;
-  INTERVAL      *new_interval;
-  vrna_param_t  *P;
-  vrna_md_t     *md;
-  register int  k, fi, cij, ij;
-  register int  type;
-  register int  dangle_model;
-  register int  noLP;
-  int           element_energy, best_energy;
-  int           *fc, *f5, *c, *fML, *fM1, *ggg;
-  int           FcH, FcI, FcM, *fM2;
-  int           length, *indx, *rtype, circular, with_gquad, turn, cp;
-  char          *ptype;
-  short         *S1;
-  unsigned char *hard_constraints, hc_decompose;
-  vrna_hc_t     *hc;
-  vrna_sc_t     *sc;
+  STATE           *new_state, *temp_state;
+  vrna_param_t    *P;
+  vrna_md_t       *md;
+  register int    k, fi, cij, ij;
+  register int    type;
+  register int    dangle_model;
+  register int    noLP;
+  int             element_energy, best_energy;
+  int             *fc, *f5, *c, *fML, *fM1;
+  int             FcH, FcI, FcM, *fM2;
+  int             length, *indx, *rtype, circular, with_gquad, turn, cp;
+  char            *ptype;
+  short           *S1;
+  unsigned char   *hard_constraints, hc_decompose;
+  vrna_hc_t       *hc;
+  vrna_sc_t       *sc;
+  vrna_gquad_mx_t *ggg;
 
   length  = vc->length;
   cp      = vc->cutpoint;
@@ -1028,7 +1962,7 @@ scan_interval(vrna_fold_compound_t  *vc,
       state->partial_energy += f5[j];
 
     if (env->nopush) {
-      push_back(env->Stack, state);
+      push_back(state, env);
       env->nopush = false;
     }
 
@@ -1100,7 +2034,7 @@ scan_interval(vrna_fold_compound_t  *vc,
         repeat(vc, i, j, state, element_energy, 0, best_energy, threshold, env);
     } else if (with_gquad) {
       element_energy  = E_MLstem(0, -1, -1, P);
-      cij             = ggg[ij] + element_energy;
+      cij             = gquad_mx_get(ggg, i, j) + element_energy;
       if (cij + best_energy <= threshold)
         repeat_gquad(vc, i, j, state, element_energy, 0, best_energy, threshold, env);
     }
@@ -1122,9 +2056,9 @@ scan_interval(vrna_fold_compound_t  *vc,
         if (with_gquad) {
           if (ON_SAME_STRAND(k, k + 1, cp)) {
             element_energy = E_MLstem(0, -1, -1, P);
-            if (fML[indx[k] + i] + ggg[indx[j] + k + 1] + element_energy + best_energy <=
+            if (fML[indx[k] + i] + gquad_mx_get(ggg, k + 1, j) + element_energy + best_energy <=
                 threshold) {
-              temp_state  = derive_new_state(i, k, state, 0, array_flag);
+              temp_state  = derive_new_state(i, k, state, 0, array_flag, env);
               env->nopush = false;
               repeat_gquad(vc,
                            k + 1,
@@ -1135,7 +2069,7 @@ scan_interval(vrna_fold_compound_t  *vc,
                            best_energy,
                            threshold,
                            env);
-              free_state_node(temp_state);
+              free_state_node(temp_state, env);
             }
           }
         }
@@ -1165,7 +2099,7 @@ scan_interval(vrna_fold_compound_t  *vc,
 
           if (ON_SAME_STRAND(k, k + 1, cp)) {
             if (fML[indx[k] + i] + c[k1j] + element_energy + best_energy <= threshold) {
-              temp_state  = derive_new_state(i, k, state, 0, array_flag);
+              temp_state  = derive_new_state(i, k, state, 0, array_flag, env);
               env->nopush = false;
               repeat(vc,
                      k + 1,
@@ -1176,7 +2110,7 @@ scan_interval(vrna_fold_compound_t  *vc,
                      best_energy,
                      threshold,
                      env);
-              free_state_node(temp_state);
+              free_state_node(temp_state, env);
             }
           }
         }
@@ -1203,7 +2137,7 @@ scan_interval(vrna_fold_compound_t  *vc,
             if (sc->energy_up)
               element_energy += sc->energy_up[i][up];
 
-          if (ggg[k1j] + element_energy + best_energy <= threshold)
+          if (gquad_mx_get(ggg, k + 1, j) + element_energy + best_energy <= threshold)
             repeat_gquad(vc, k + 1, j, state, element_energy, 0, best_energy, threshold, env);
         }
 
@@ -1287,8 +2221,8 @@ scan_interval(vrna_fold_compound_t  *vc,
       if (with_gquad) {
         if (ON_SAME_STRAND(k, j, cp)) {
           element_energy = 0;
-          if (f5[k - 1] + ggg[kj] + element_energy + best_energy <= threshold) {
-            temp_state  = derive_new_state(1, k - 1, state, 0, 0);
+          if (f5[k - 1] + gquad_mx_get(ggg, k, j) + element_energy + best_energy <= threshold) {
+            temp_state  = derive_new_state(1, k - 1, state, 0, 0, env);
             env->nopush = false;
             /* backtrace the quadruplex */
             repeat_gquad(vc,
@@ -1300,7 +2234,7 @@ scan_interval(vrna_fold_compound_t  *vc,
                          best_energy,
                          threshold,
                          env);
-            free_state_node(temp_state);
+            free_state_node(temp_state, env);
           }
         }
       }
@@ -1331,10 +2265,10 @@ scan_interval(vrna_fold_compound_t  *vc,
         }
 
         if (f5[k - 1] + c[kj] + element_energy + best_energy <= threshold) {
-          temp_state  = derive_new_state(1, k - 1, state, 0, 0);
+          temp_state  = derive_new_state(1, k - 1, state, 0, 0, env);
           env->nopush = false;
           repeat(vc, k, j, temp_state, element_energy, f5[k - 1], best_energy, threshold, env);
-          free_state_node(temp_state);
+          free_state_node(temp_state, env);
         }
       }
     }
@@ -1344,7 +2278,7 @@ scan_interval(vrna_fold_compound_t  *vc,
     if (with_gquad) {
       if (ON_SAME_STRAND(k, j, cp)) {
         element_energy = 0;
-        if (ggg[kj] + element_energy + best_energy <= threshold)
+        if (gquad_mx_get(ggg, 1, j) + element_energy + best_energy <= threshold)
           /* backtrace the quadruplex */
           repeat_gquad(vc, 1, j, state, element_energy, 0, best_energy, threshold, env);
       }
@@ -1397,9 +2331,9 @@ scan_interval(vrna_fold_compound_t  *vc,
       }
 
       if (tmp_en <= threshold) {
-        new_state                 = derive_new_state(1, 2, state, 0, 0);
+        new_state                 = derive_new_state(1, 2, state, 0, 0, env);
         new_state->partial_energy = 0;
-        push(env->Stack, new_state);
+        push(env, new_state);
         env->nopush = false;
       }
     }
@@ -1526,27 +2460,24 @@ scan_interval(vrna_fold_compound_t  *vc,
             if (tmpE2 + fML[indx[k] + 1] + P->MLclosing <= threshold) {
               /* we've (hopefully) found a valid decomposition of fM2 and therefor we have all */
               /* three intervals for our new state to be pushed on stack R */
-              new_state = copy_state(state);
+              new_state = copy_state(state, env);
 
               /* first interval leads for search in fML array */
-              new_interval = make_interval(1, k, 1);
-              push(new_state->Intervals, new_interval);
+              push_interval(new_state, 1, k, 1, env);
               env->nopush = false;
 
               /* next, we have the first interval that has to be traced in fM1 */
-              new_interval = make_interval(k + 1, l, 3);
-              push(new_state->Intervals, new_interval);
+              push_interval(new_state, k + 1, l, 3, env);
               env->nopush = false;
 
               /* and the last of our three intervals is also one to be traced within fM1 array... */
-              new_interval = make_interval(l + 1, j, 3);
-              push(new_state->Intervals, new_interval);
+              push_interval(new_state, l + 1, j, 3, env);
               env->nopush = false;
 
               /* mmh, we add the energy for closing the multiloop now... */
               new_state->partial_energy += P->MLclosing;
               /* next we push our state onto the R stack */
-              push(env->Stack, new_state);
+              push(env, new_state);
               env->nopush = false;
             }
 
@@ -1589,11 +2520,11 @@ scan_interval(vrna_fold_compound_t  *vc,
       ik = indx[k] + i;
 
       if (with_gquad) {
-        if (fc[k + 1] + ggg[ik] + best_energy <= threshold) {
-          temp_state  = derive_new_state(k + 1, j, state, 0, 4);
+        if (fc[k + 1] + gquad_mx_get(ggg, i, k) + best_energy <= threshold) {
+          temp_state  = derive_new_state(k + 1, j, state, 0, 4, env);
           env->nopush = false;
           repeat_gquad(vc, i, k, temp_state, 0, fc[k + 1], best_energy, threshold, env);
-          free_state_node(temp_state);
+          free_state_node(temp_state, env);
         }
       }
 
@@ -1618,10 +2549,10 @@ scan_interval(vrna_fold_compound_t  *vc,
         }
 
         if (fc[k + 1] + c[ik] + element_energy + best_energy <= threshold) {
-          temp_state  = derive_new_state(k + 1, j, state, 0, 4);
+          temp_state  = derive_new_state(k + 1, j, state, 0, 4, env);
           env->nopush = false;
           repeat(vc, i, k, temp_state, element_energy, fc[k + 1], best_energy, threshold, env);
-          free_state_node(temp_state);
+          free_state_node(temp_state, env);
         }
       }
     }
@@ -1629,7 +2560,7 @@ scan_interval(vrna_fold_compound_t  *vc,
     ik = indx[cp - 1] + i; /* indx[j] + i; */
 
     if (with_gquad)
-      if (ggg[ik] + best_energy <= threshold)
+      if (gquad_mx_get(ggg, i, cp - 1) + best_energy <= threshold)
         repeat_gquad(vc, i, cp - 1, state, 0, 0, best_energy, threshold, env);
 
     if (hard_constraints[ik] & VRNA_CONSTRAINT_CONTEXT_EXT_LOOP) {
@@ -1687,11 +2618,11 @@ scan_interval(vrna_fold_compound_t  *vc,
       kj = indx[j] + k;
 
       if (with_gquad) {
-        if (fc[k - 1] + ggg[kj] + best_energy <= threshold) {
-          temp_state  = derive_new_state(i, k - 1, state, 0, 5);
+        if (fc[k - 1] + gquad_mx_get(ggg, k, j) + best_energy <= threshold) {
+          temp_state  = derive_new_state(i, k - 1, state, 0, 5, env);
           env->nopush = false;
           repeat_gquad(vc, k, j, temp_state, 0, fc[k - 1], best_energy, threshold, env);
-          free_state_node(temp_state);
+          free_state_node(temp_state, env);
         }
       }
 
@@ -1717,10 +2648,10 @@ scan_interval(vrna_fold_compound_t  *vc,
         }
 
         if (fc[k - 1] + c[kj] + element_energy + best_energy <= threshold) {
-          temp_state  = derive_new_state(i, k - 1, state, 0, 5);
+          temp_state  = derive_new_state(i, k - 1, state, 0, 5, env);
           env->nopush = false;
           repeat(vc, k, j, temp_state, element_energy, fc[k - 1], best_energy, threshold, env);
-          free_state_node(temp_state);
+          free_state_node(temp_state, env);
         }
       }
     }
@@ -1728,7 +2659,7 @@ scan_interval(vrna_fold_compound_t  *vc,
     kj = indx[j] + cp; /* indx[j] + i; */
 
     if (with_gquad)
-      if (ggg[kj] + best_energy <= threshold)
+      if (gquad_mx_get(ggg, cp, j) + best_energy <= threshold)
         repeat_gquad(vc, cp, j, state, 0, 0, best_energy, threshold, env);
 
     if (hard_constraints[kj] & VRNA_CONSTRAINT_CONTEXT_EXT_LOOP) {
@@ -1766,7 +2697,7 @@ scan_interval(vrna_fold_compound_t  *vc,
   }
 
   if (env->nopush) {
-    push_back(env->Stack, state);
+    push_back(state, env);
     env->nopush = false;
   }
 
@@ -1786,11 +2717,11 @@ repeat_gquad(vrna_fold_compound_t *vc,
              int                  threshold,
              subopt_env           *env)
 {
-  int           *ggg, *indx, element_energy, cp;
-  short         *S1;
-  vrna_param_t  *P;
+  int             element_energy, cp;
+  short           *S1;
+  vrna_param_t    *P;
+  vrna_gquad_mx_t *ggg;
 
-  indx  = vc->jindx;
   cp    = vc->cutpoint;
   ggg   = vc->matrices->ggg;
   S1    = vc->sequence_encoding;
@@ -1803,7 +2734,7 @@ repeat_gquad(vrna_fold_compound_t *vc,
   best_energy += temp_energy; /* energy from unpushed interval */
 
   if (ON_SAME_STRAND(i, j, cp)) {
-    element_energy = ggg[indx[j] + i];
+    element_energy = gquad_mx_get(ggg, i, j);
     if (element_energy + best_energy <= threshold) {
       int cnt;
       int *L;
@@ -1818,14 +2749,14 @@ repeat_gquad(vrna_fold_compound_t *vc,
       get_gquad_pattern_exhaustive(S1, i, j, P, L, l, threshold - best_energy);
 
       for (cnt = 0; L[cnt] != -1; cnt++) {
-        new_state = copy_state(state);
+        new_state = copy_state(state, env);
 
-        make_gquad(i, L[cnt], &(l[3 * cnt]), new_state);
+        make_gquad(i, L[cnt], &(l[3 * cnt]), new_state, env);
         new_state->partial_energy += part_energy;
         new_state->partial_energy += element_energy;
         /* new_state->best_energy =
          * hairpin[unpaired] + element_energy + best_energy; */
-        push(env->Stack, new_state);
+        push(env, new_state);
         env->nopush = false;
       }
       free(L);
@@ -1853,20 +2784,21 @@ repeat(vrna_fold_compound_t *vc,
   /* routine to find stacks, bulges, internal loops and  multiloops */
   /* within interval closed by basepair i,j */
 
-  STATE         *new_state;
-  vrna_param_t  *P;
-  vrna_md_t     *md;
-
-  register int  ij, k, p, q, energy, new;
-  register int  mm;
-  register int  no_close, type, type_2;
-  char          *ptype;
-  int           element_energy;
-  int           *fc, *c, *fML, *fM1, *ggg;
-  int           rt, *indx, *rtype, noGUclosure, noLP, with_gquad, dangle_model, turn, cp;
-  short         *S1;
-  vrna_hc_t     *hc;
-  vrna_sc_t     *sc;
+  STATE           *new_state;
+  vrna_param_t    *P;
+  vrna_md_t       *md;
+
+  register int    ij, k, p, q, energy, new;
+  register int    mm;
+  register int    no_close, type, type_2;
+  char            *ptype;
+  int             element_energy;
+  int             *fc, *c, *fML, *fM1;
+  int             rt, *indx, *rtype, noGUclosure, noLP, with_gquad, dangle_model, turn, cp;
+  short           *S1;
+  vrna_hc_t       *hc;
+  vrna_sc_t       *sc;
+  vrna_gquad_mx_t *ggg;
 
   S1    = vc->sequence_encoding;
   ptype = vc->ptype;
@@ -1926,14 +2858,14 @@ repeat(vrna_fold_compound_t *vc,
                 energy += sc->f(i, j, i + 1, j - 1, VRNA_DECOMP_PAIR_IL, sc->data);
             }
 
-            new_state = derive_new_state(i + 1, j - 1, state, part_energy + energy, 2);
-            make_pair(i, j, new_state);
-            make_pair(i + 1, j - 1, new_state);
+            new_state = derive_new_state(i + 1, j - 1, state, part_energy + energy, 2, env);
+            make_pair(i, j, new_state, env);
+            make_pair(i + 1, j - 1, new_state, env);
 
             /* new_state->best_energy = new + best_energy; */
-            push(env->Stack, new_state);
+            push(env, new_state);
             env->nopush = false;
-            if (i == 1 || state->structure[i - 2] != '(' || state->structure[j] != ')')
+            if (i == 1 || !has_enclosing_brackets(state, i, j))
               /* adding a stack is the only possible structure */
               return;
           }
@@ -2099,7 +3031,7 @@ repeat(vrna_fold_compound_t *vc,
       int cnt, *p, *q, *en, tmp_en;
       p   = q = en = NULL;
       en  =
-        E_GQuad_IntLoop_exhaustive(i, j, &p, &q, type, S1, ggg, threshold - best_energy, indx, P);
+        E_GQuad_IntLoop_exhaustive(i, j, &p, &q, type, S1, ggg, threshold - best_energy, P);
       for (cnt = 0; p[cnt] != -1; cnt++) {
         if ((hc->up_int[i + 1] >= p[cnt] - i - 1) && (hc->up_int[q[cnt] + 1] >= j - q[cnt] - 1)) {
           tmp_en = en[cnt];
@@ -2113,12 +3045,12 @@ repeat(vrna_fold_compound_t *vc,
                         + sc->energy_up[q[cnt] + 1][j - q[cnt] - 1];
           }
 
-          new_state = derive_new_state(p[cnt], q[cnt], state, tmp_en + part_energy, 6);
+          new_state = derive_new_state(p[cnt], q[cnt], state, tmp_en + part_energy, 6, env);
 
-          make_pair(i, j, new_state);
+          make_pair(i, j, new_state, env);
 
           /* new_state->best_energy = new + best_energy; */
-          push(env->Stack, new_state);
+          push(env, new_state);
           env->nopush = false;
         }
       }
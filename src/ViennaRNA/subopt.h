@@ -69,11 +69,50 @@ struct vrna_subopt_sol_s {
   char *structure;    /**< @brief Structure in dot-bracket notation */
 };
 
+/**
+ *  @brief  Typename for the memory statistics of the subopt enumeration #vrna_subopt_stats_s
+ */
+typedef struct vrna_subopt_stats_s vrna_subopt_stats_t;
+
+/**
+ *  @brief  Memory statistics of a suboptimal structure enumeration
+ *  @ingroup subopt_wuchty
+ *
+ *  @see vrna_subopt_stats()
+ */
+struct vrna_subopt_stats_s {
+  unsigned long states;       /**< @brief Number of partial structures (states) created */
+  unsigned long intervals;    /**< @brief Number of sequence intervals created */
+  unsigned long elements;     /**< @brief Number of base pairs and G-quadruplexes added to partial structures */
+  unsigned long allocations;  /**< @brief Number of memory blocks allocated for the above */
+  unsigned long max_stack;    /**< @brief Maximum number of states on the stack */
+  unsigned long runs;         /**< @brief Number of sorted runs of structures written to temporary files for energy-sorted output */
+  size_t        peak_memory;  /**< @brief Peak memory used by the enumeration in bytes */
+};
+
 /**
  *  @brief Maximum density of states discretization for subopt
  */
 #define MAXDOS                1000
 
+/**
+ *  @brief  Default option flag for vrna_subopt_cb_parallel() to pass structures to the callback in order of increasing free energy
+ *
+ *  @ingroup subopt_wuchty
+ *
+ *  @see vrna_subopt_cb_parallel()
+ */
+#define VRNA_SUBOPT_DEFAULT   0U
+
+/**
+ *  @brief  Option flag for vrna_subopt_cb_parallel() to pass structures to the callback as soon as they are found
+ *
+ *  @ingroup subopt_wuchty
+ *
+ *  @see vrna_subopt_cb_parallel()
+ */
+#define VRNA_SUBOPT_UNORDERED 1U
+
 /**
  *  @addtogroup subopt_wuchty
  *  @{
@@ -88,7 +127,9 @@ struct vrna_subopt_sol_s {
  *  'delta' * 0.01 kcal/mol of the optimum, see @cite wuchty:1999. The results
  *  are either directly written to a 'fp' (if 'fp' is not NULL), or
  *  (fp==NULL) returned in a #vrna_subopt_solution_t * list terminated
- *  by an entry were the 'structure' member is NULL.
+ *  by an entry were the 'structure' member is NULL. Sorted output to 'fp'
+ *  is written while the enumeration proceeds and requires only a bounded
+ *  amount of memory, see vrna_subopt_sort_buffer().
  *
  *  @ingroup subopt_wuchty
  *
@@ -117,6 +158,31 @@ vrna_subopt(vrna_fold_compound_t *vc,
             int sorted,
             FILE *fp);
 
+/**
+ *  @brief  Returns list of subopt structures or writes to fp using multiple threads
+ *
+ *  Same as vrna_subopt(), but the enumeration is performed by @p num_threads
+ *  concurrent threads, see vrna_subopt_cb_parallel(). Structures written to
+ *  @p fp or returned with sorting enabled are identical to those of vrna_subopt().
+ *  Without sorting, their order depends on the number of threads.
+ *
+ *  @ingroup subopt_wuchty
+ *
+ *  @see vrna_subopt(), vrna_subopt_cb_parallel()
+ *  @param  vc          fold compount with the sequence data
+ *  @param  delta       Energy band arround the MFE in 10cal/mol, i.e. deka-calories
+ *  @param  sorted      Sort results by energy in ascending order
+ *  @param  fp          The output file handle where structures are written to (maybe NULL)
+ *  @param  num_threads Number of threads to use (0 for the maximum number of OpenMP threads)
+ *  @return             The list of structures if @p fp is NULL, NULL otherwise
+ */
+vrna_subopt_solution_t *
+vrna_subopt_parallel(vrna_fold_compound_t *vc,
+                     int                  delta,
+                     int                  sorted,
+                     FILE                 *fp,
+                     unsigned int         num_threads);
+
 /**
  *  @brief  Generate suboptimal structures within an energy band arround the MFE
  *
@@ -157,6 +223,92 @@ vrna_subopt_cb( vrna_fold_compound_t *vc,
                 vrna_subopt_callback *cb,
                 void *data);
 
+/**
+ *  @brief  Generate suboptimal structures within an energy band arround the MFE using multiple threads
+ *
+ *  Same as vrna_subopt_cb(), but the search tree of the enumeration is explored by
+ *  @p num_threads concurrent threads. Each thread performs a depth-first search
+ *  on its own stack of partial structures, and idle threads steal the oldest
+ *  partial structures, i.e. the largest pending subtrees, from the stacks of
+ *  other threads.
+ *
+ *  By default (#VRNA_SUBOPT_DEFAULT), structures are passed to the callback in
+ *  order of increasing free energy, with ties sorted by their dot-bracket
+ *  string. For that purpose, the enumeration proceeds in rounds, one per
+ *  energy level. Partial structures whose best attainable free energy exceeds
+ *  the current level are put aside until the round of that level, such that
+ *  only the structures of a single energy level need to be kept in memory
+ *  before they are passed to the callback. The output is identical to
+ *  that of vrna_subopt() with sorting enabled, independent of the number of
+ *  threads. If free energies are re-evaluated after the enumeration, i.e.
+ *  for #vrna_md_t.logML, or dangle models 1 and 3, or if lonely pairs are
+ *  forbidden (#vrna_md_t.noLP), where the best attainable free energies of
+ *  partial structures are no reliable lower bounds, all structures are kept
+ *  in memory until the enumeration is complete.
+ *
+ *  With option #VRNA_SUBOPT_UNORDERED, structures are passed to the callback
+ *  as soon as they are found instead, which maximizes throughput. For a single
+ *  thread, the order is then the same as for vrna_subopt_cb().
+ *
+ *  The callback is never executed concurrently.
+ *
+ *  @ingroup subopt_wuchty
+ *
+ *  @see vrna_subopt_cb(), vrna_subopt_callback, #VRNA_SUBOPT_DEFAULT, #VRNA_SUBOPT_UNORDERED
+ *  @param  vc          fold compount with the sequence data
+ *  @param  delta       Energy band arround the MFE in 10cal/mol, i.e. deka-calories
+ *  @param  cb          Pointer to a callback function that handles the backtracked structure and its free energy in kcal/mol
+ *  @param  data        Pointer to some data structure that is passed along to the callback
+ *  @param  num_threads Number of threads to use (0 for the maximum number of OpenMP threads)
+ *  @param  options     Options to modify the order of the output
+ */
+void
+vrna_subopt_cb_parallel(vrna_fold_compound_t  *vc,
+                        int                   delta,
+                        vrna_subopt_callback  *cb,
+                        void                  *data,
+                        unsigned int          num_threads,
+                        unsigned int          options);
+
+/**
+ *  @brief  Get the memory statistics of the last suboptimal structure enumeration
+ *
+ *  The enumeration in vrna_subopt_cb() (and vrna_subopt()) keeps its partial
+ *  structures in node arenas, where states derived from the same parent share
+ *  their base pairs and pending sequence intervals. This function retrieves the
+ *  number of nodes created, the number of actual memory allocations, and the
+ *  peak memory of the most recent enumeration of the calling thread.
+ *
+ *  @ingroup subopt_wuchty
+ *
+ *  @see vrna_subopt_cb(), vrna_subopt()
+ *  @param  stats   A pointer to a #vrna_subopt_stats_t the statistics are written to
+ */
+void
+vrna_subopt_stats(vrna_subopt_stats_t *stats);
+
+
+/**
+ *  @brief  Set the maximum memory used to buffer structures for energy-sorted output
+ *
+ *  Energy-sorted enumerations, i.e. vrna_subopt() with sorting enabled and an
+ *  output file, and vrna_subopt_cb_parallel() with #VRNA_SUBOPT_DEFAULT, keep
+ *  structures in memory until all structures of lower free energy are known.
+ *  Whenever the buffered structures exceed @p size bytes, they are sorted and
+ *  written to a temporary file. The sorted runs are merged when the structures
+ *  are passed on, such that memory consumption stays bounded even for wide
+ *  energy bands. The default limit is 64 MB.
+ *
+ *  @ingroup subopt_wuchty
+ *
+ *  @see vrna_subopt(), vrna_subopt_cb_parallel(), vrna_subopt_stats()
+ *  @param  size  The maximum memory in bytes (0 to leave the current limit unchanged)
+ *  @return       The previous limit in bytes
+ */
+size_t
+vrna_subopt_sort_buffer(size_t size);
+
+
 /**
  *  @brief Compute Zuker type suboptimal structures
  *
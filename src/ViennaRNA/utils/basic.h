@@ -26,6 +26,19 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+
+/**
+ *  @brief  A random number generator state
+ *
+ *  Independent state of a pseudo random number generator (xoshiro256**) that may be
+ *  used instead of the process-wide state behind vrna_urn(). Each thread that draws
+ *  random numbers should use its own state. Non-overlapping streams for multiple
+ *  threads are obtained from a single seed via vrna_rng_split().
+ *
+ *  @see vrna_rng_init(), vrna_rng_split(), vrna_rng_urn(), vrna_fold_compound_add_rng()
+ */
+typedef struct vrna_rng_s vrna_rng_t;
 
 #include <ViennaRNA/datastructures/basic.h>
 
@@ -154,6 +167,9 @@ void  *vrna_realloc(void *p, unsigned size);
 
 /**
  *  @brief  Initialize seed for random number generator
+ *
+ *  Stores a new seed in #xsubi. Threads that are currently drawing random numbers
+ *  through vrna_urn() switch to the new seed with their next draw.
  */
 void vrna_init_rand(void);
 
@@ -161,7 +177,8 @@ void vrna_init_rand(void);
  * @brief Current 48 bit random number
  *
  *  This variable is used by vrna_urn(). These should be set to some
- *  random number seeds before the first call to vrna_urn().
+ *  random number seeds before the first call to vrna_urn(). Direct writes
+ *  to this variable must not happen while other threads draw random numbers.
  *
  *  @see vrna_urn()
  */
@@ -171,7 +188,13 @@ extern unsigned short xsubi[3];
  *  @brief get a random number from [0..1]
  *
  *  @see  vrna_int_urn(), vrna_init_rand()
- *  @note Usually implemented by calling @e erand48().
+ *  @note Usually implemented by calling @e erand48(). Each thread draws from its own state
+ *        without any locking. The first thread that draws after (re-)seeding continues the
+ *        sequence of #xsubi and keeps #xsubi up to date, just like single threaded programs
+ *        did before. Any further thread starts at a different position derived from the
+ *        seed, so the random numbers of concurrent callers depend on the order in which the
+ *        threads start drawing. Use a vrna_rng_t state for reproducible, per-thread random
+ *        numbers instead.
  *  @return   A random number in range [0..1]
  */
 double vrna_urn(void);
@@ -186,6 +209,66 @@ double vrna_urn(void);
  */
 int vrna_int_urn(int from, int to);
 
+/**
+ *  @brief  Create a new random number generator state from a seed
+ *
+ *  The same seed always yields the same sequence of random numbers.
+ *
+ *  @see  vrna_rng_free(), vrna_rng_split()
+ *  @param  seed  The seed
+ *  @return       A new random number generator state
+ */
+vrna_rng_t *vrna_rng_init(uint64_t seed);
+
+/**
+ *  @brief  Release memory occupied by a random number generator state
+ *
+ *  @param  rng   The random number generator state
+ */
+void vrna_rng_free(vrna_rng_t *rng);
+
+/**
+ *  @brief  Advance a random number generator state by @f$ 2^{128} @f$ draws
+ *
+ *  @param  rng   The random number generator state
+ */
+void vrna_rng_jump(vrna_rng_t *rng);
+
+/**
+ *  @brief  Split off an independent random number stream
+ *
+ *  Returns a copy of the current state of @p rng and then advances @p rng by
+ *  vrna_rng_jump(). Repeated calls thus provide non-overlapping streams of
+ *  @f$ 2^{128} @f$ random numbers each, e.g. one for each thread.
+ *
+ *  @see  vrna_rng_jump(), vrna_rng_free()
+ *  @param  rng   The random number generator state to split
+ *  @return       A new random number generator state (or NULL on error)
+ */
+vrna_rng_t *vrna_rng_split(vrna_rng_t *rng);
+
+/**
+ *  @brief  Get a random number from [0..1) using a particular generator state
+ *
+ *  @see  vrna_urn()
+ *  @param  rng   The random number generator state
+ *  @return       A random number in range [0..1)
+ */
+double vrna_rng_urn(vrna_rng_t *rng);
+
+/**
+ *  @brief  Generates a pseudo random integer in a specified range using a particular generator state
+ *
+ *  @see  vrna_int_urn()
+ *  @param  rng   The random number generator state
+ *  @param  from  The first number in range
+ *  @param  to    The last number in range
+ *  @return       A pseudo random number in range [from, to]
+ */
+int vrna_rng_int_urn(vrna_rng_t  *rng,
+                     int         from,
+                     int         to);
+
 /**
  *  @brief Get a timestamp
  *
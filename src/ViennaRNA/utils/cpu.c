@@ -0,0 +1,175 @@
+/*
+ *  ViennaRNA/utils/cpu.c
+ *
+ *  Runtime detection of CPU features and SIMD capabilities
+ *
+ *  ViennaRNA package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define VRNA_CPUID_AVAILABLE
+#endif
+
+#include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/utils/cpu.h"
+
+/*
+ #################################
+ # PRIVATE MACROS                #
+ #################################
+ */
+
+/* bits of the cpuid leaf 1 registers */
+#define bit_MMX_EDX       (1 << 23)
+#define bit_SSE_EDX       (1 << 25)
+#define bit_SSE2_EDX      (1 << 26)
+#define bit_SSE3_ECX      (1 << 0)
+#define bit_SSE41_ECX     (1 << 19)
+#define bit_SSE42_ECX     (1 << 20)
+#define bit_OSXSAVE_ECX   (1 << 27)
+#define bit_AVX_ECX       (1 << 28)
+
+/* bits of the cpuid leaf 7 registers */
+#define bit_AVX2_EBX      (1 << 5)
+#define bit_AVX512F_EBX   (1 << 16)
+
+/* bits of the extended control register XCR0 */
+#define XCR0_SSE          (1 << 1)
+#define XCR0_AVX          (1 << 2)
+#define XCR0_OPMASK       (1 << 5)
+#define XCR0_ZMM_HI256    (1 << 6)
+#define XCR0_HI16_ZMM     (1 << 7)
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+
+#ifdef VRNA_CPUID_AVAILABLE
+PRIVATE unsigned int
+get_xcr0(void);
+
+
+#endif
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+PUBLIC char *
+vrna_cpu_vendor_string(void)
+{
+  char          *vendor = (char *)vrna_alloc(sizeof(char) * 13);
+
+#ifdef VRNA_CPUID_AVAILABLE
+  unsigned int  eax, ebx, ecx, edx;
+
+  if (__get_cpuid(0, &eax, &ebx, &ecx, &edx)) {
+    memcpy(vendor, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+  }
+
+#endif
+
+  return vendor;
+}
+
+
+PUBLIC unsigned int
+vrna_cpu_simd_capabilities(void)
+{
+  unsigned int capabilities = VRNA_CPU_SIMD_NONE;
+
+#ifdef VRNA_CPUID_AVAILABLE
+  unsigned int  eax, ebx, ecx, edx, max_leaf, xcr0;
+
+  max_leaf = __get_cpuid_max(0, NULL);
+
+  if (max_leaf < 1)
+    return capabilities;
+
+  __cpuid(1, eax, ebx, ecx, edx);
+
+  if (edx & bit_MMX_EDX)
+    capabilities |= VRNA_CPU_SIMD_MMX;
+
+  if (edx & bit_SSE_EDX)
+    capabilities |= VRNA_CPU_SIMD_SSE;
+
+  if (edx & bit_SSE2_EDX)
+    capabilities |= VRNA_CPU_SIMD_SSE2;
+
+  if (ecx & bit_SSE3_ECX)
+    capabilities |= VRNA_CPU_SIMD_SSE3;
+
+  if (ecx & bit_SSE41_ECX)
+    capabilities |= VRNA_CPU_SIMD_SSE41;
+
+  if (ecx & bit_SSE42_ECX)
+    capabilities |= VRNA_CPU_SIMD_SSE42;
+
+  /*
+   *  AVX and above use extended register states that must be saved
+   *  by the operating system upon context switches
+   */
+  if (!(ecx & bit_OSXSAVE_ECX))
+    return capabilities;
+
+  xcr0 = get_xcr0();
+
+  if ((xcr0 & (XCR0_SSE | XCR0_AVX)) != (XCR0_SSE | XCR0_AVX))
+    return capabilities;
+
+  if (ecx & bit_AVX_ECX)
+    capabilities |= VRNA_CPU_SIMD_AVX;
+
+  if (max_leaf < 7)
+    return capabilities;
+
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+
+  if ((capabilities & VRNA_CPU_SIMD_AVX) && (ebx & bit_AVX2_EBX))
+    capabilities |= VRNA_CPU_SIMD_AVX2;
+
+  if ((ebx & bit_AVX512F_EBX) &&
+      ((xcr0 & (XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM)) ==
+       (XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM)))
+    capabilities |= VRNA_CPU_SIMD_AVX512F;
+
+#endif
+
+  return capabilities;
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+#ifdef VRNA_CPUID_AVAILABLE
+PRIVATE unsigned int
+get_xcr0(void)
+{
+  unsigned int eax, edx;
+
+  /* xgetbv instruction, encoded as bytes to support older assemblers */
+  __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0));
+
+  return eax;
+}
+
+
+#endif
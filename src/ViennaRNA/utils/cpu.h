@@ -0,0 +1,102 @@
+#ifndef VIENNA_RNA_PACKAGE_UTILS_CPU_H
+#define VIENNA_RNA_PACKAGE_UTILS_CPU_H
+
+/**
+ *  @file     ViennaRNA/utils/cpu.h
+ *  @ingroup  utils, cpu_utils
+ *  @brief    Detect CPU features and SIMD capabilities at runtime
+ */
+
+/**
+ *  @addtogroup   cpu_utils
+ *  @{
+ *  @brief  Determine the SIMD instruction set extensions of the CPU we are running on
+ *
+ *  RNAlib ships implementations of performance critical loops for different
+ *  SIMD instruction set extensions. Which of them is actually used is decided
+ *  at runtime, such that the same library binary runs optimally on different
+ *  CPU generations.
+ */
+
+/**
+ *  @brief  No SIMD extension available
+ */
+#define VRNA_CPU_SIMD_NONE     0U
+
+/**
+ *  @brief  MMX instructions
+ */
+#define VRNA_CPU_SIMD_MMX      1U
+
+/**
+ *  @brief  SSE instructions
+ */
+#define VRNA_CPU_SIMD_SSE      2U
+
+/**
+ *  @brief  SSE2 instructions
+ */
+#define VRNA_CPU_SIMD_SSE2     4U
+
+/**
+ *  @brief  SSE3 instructions
+ */
+#define VRNA_CPU_SIMD_SSE3     8U
+
+/**
+ *  @brief  SSE4.1 instructions
+ */
+#define VRNA_CPU_SIMD_SSE41    16U
+
+/**
+ *  @brief  SSE4.2 instructions
+ */
+#define VRNA_CPU_SIMD_SSE42    32U
+
+/**
+ *  @brief  AVX instructions (including operating system support)
+ */
+#define VRNA_CPU_SIMD_AVX      64U
+
+/**
+ *  @brief  AVX2 instructions (including operating system support)
+ */
+#define VRNA_CPU_SIMD_AVX2     128U
+
+/**
+ *  @brief  AVX-512 Foundation instructions (including operating system support)
+ */
+#define VRNA_CPU_SIMD_AVX512F  256U
+
+
+/**
+ *  @brief  Get the vendor string of the host CPU
+ *
+ *  @return   The vendor string of the host CPU, e.g. "GenuineIntel" (Must be free'd by the caller)
+ */
+char *
+vrna_cpu_vendor_string(void);
+
+
+/**
+ *  @brief  Get the SIMD capabilities of the host CPU
+ *
+ *  The capabilities are returned as a bit-vector of @ref VRNA_CPU_SIMD_NONE,
+ *  @ref VRNA_CPU_SIMD_MMX, @ref VRNA_CPU_SIMD_SSE, @ref VRNA_CPU_SIMD_SSE2,
+ *  @ref VRNA_CPU_SIMD_SSE3, @ref VRNA_CPU_SIMD_SSE41, @ref VRNA_CPU_SIMD_SSE42,
+ *  @ref VRNA_CPU_SIMD_AVX, @ref VRNA_CPU_SIMD_AVX2, and @ref VRNA_CPU_SIMD_AVX512F.
+ *  Extensions that require operating system support for extended register
+ *  states, i.e. AVX and above, are only reported if the operating system
+ *  actually saves these registers upon context switches.
+ *
+ *  @return   A bit-vector of SIMD capabilities of the host CPU
+ */
+unsigned int
+vrna_cpu_simd_capabilities(void);
+
+
+/**
+ *  @}
+ */
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ *  ViennaRNA/utils/higher_order_functions.c
+ *
+ *  Higher order functions with runtime selection of SIMD implementations
+ *
+ *  ViennaRNA package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ViennaRNA/utils/basic.h"
+#include "ViennaRNA/utils/cpu.h"
+#include "ViennaRNA/utils/higher_order_functions.h"
+
+#include "higher_order_functions_sum.inc"
+
+/*
+ #################################
+ # PRIVATE MACROS                #
+ #################################
+ */
+
+/*
+ *  The function pointers below may be replaced while other threads call
+ *  them, so we access them atomically where the compiler allows us to
+ */
+#ifdef __GNUC__
+# define FUN_LOAD(ptr)        __atomic_load_n(&(ptr), __ATOMIC_ACQUIRE)
+# define FUN_STORE(ptr, val)  __atomic_store_n(&(ptr), (val), __ATOMIC_RELEASE)
+#else
+# define FUN_LOAD(ptr)        (ptr)
+# define FUN_STORE(ptr, val)  ((ptr) = (val))
+#endif
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+
+/*
+ *  SIMD implementations, compiled in separate translation units
+ *  with the respective instruction set extension flags
+ */
+#ifdef VRNA_WITH_SIMD_SSE2
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_sse2(const FLT_OR_DBL *e1,
+                           const FLT_OR_DBL *e2,
+                           int              count);
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_reverse_sse2(const FLT_OR_DBL *e1,
+                                   const FLT_OR_DBL *e2,
+                                   int              count);
+
+
+#endif
+
+#ifdef VRNA_WITH_SIMD_SSE41
+int
+vrna_fun_zip_add_min_sse41(const int  *e1,
+                           const int  *e2,
+                           int        count);
+
+
+#endif
+
+#ifdef VRNA_WITH_SIMD_AVX2
+int
+vrna_fun_zip_add_min_avx2(const int *e1,
+                          const int *e2,
+                          int       count);
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_avx2(const FLT_OR_DBL *e1,
+                           const FLT_OR_DBL *e2,
+                           int              count);
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_reverse_avx2(const FLT_OR_DBL *e1,
+                                   const FLT_OR_DBL *e2,
+                                   int              count);
+
+
+#endif
+
+#ifdef VRNA_WITH_SIMD_AVX512
+int
+vrna_fun_zip_add_min_avx512(const int *e1,
+                            const int *e2,
+                            int       count);
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_avx512(const FLT_OR_DBL *e1,
+                             const FLT_OR_DBL *e2,
+                             int              count);
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_reverse_avx512(const FLT_OR_DBL *e1,
+                                     const FLT_OR_DBL *e2,
+                                     int              count);
+
+
+#endif
+
+PRIVATE void
+fun_dispatch(unsigned int features);
+
+
+PRIVATE int
+fun_zip_add_min_default(const int *e1,
+                        const int *e2,
+                        int       count);
+
+
+PRIVATE int
+fun_zip_add_min_dispatcher(const int  *e1,
+                           const int  *e2,
+                           int        count);
+
+
+PRIVATE FLT_OR_DBL
+fun_zip_mult_sum_default(const FLT_OR_DBL *e1,
+                         const FLT_OR_DBL *e2,
+                         int              count);
+
+
+PRIVATE FLT_OR_DBL
+fun_zip_mult_sum_dispatcher(const FLT_OR_DBL  *e1,
+                            const FLT_OR_DBL  *e2,
+                            int               count);
+
+
+PRIVATE FLT_OR_DBL
+fun_zip_mult_sum_reverse_default(const FLT_OR_DBL *e1,
+                                 const FLT_OR_DBL *e2,
+                                 int              count);
+
+
+PRIVATE FLT_OR_DBL
+fun_zip_mult_sum_reverse_dispatcher(const FLT_OR_DBL  *e1,
+                                    const FLT_OR_DBL  *e2,
+                                    int               count);
+
+
+/*
+ #################################
+ # PRIVATE VARIABLES and STRUCTS #
+ #################################
+ */
+
+/*
+ *  Function pointers to the actual implementations. They initially point to
+ *  the dispatchers that replace them with the best implementation for the host
+ *  CPU upon the first call. Concurrent first calls from different threads are
+ *  harmless, since they all atomically store the same addresses.
+ */
+PRIVATE int (*fun_zip_add_min)(const int *,
+                               const int *,
+                               int) = &fun_zip_add_min_dispatcher;
+
+
+PRIVATE FLT_OR_DBL (*fun_zip_mult_sum)(const FLT_OR_DBL *,
+                                       const FLT_OR_DBL *,
+                                       int) = &fun_zip_mult_sum_dispatcher;
+
+
+PRIVATE FLT_OR_DBL (*fun_zip_mult_sum_reverse)(const FLT_OR_DBL *,
+                                               const FLT_OR_DBL *,
+                                               int) = &fun_zip_mult_sum_reverse_dispatcher;
+
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+PUBLIC int
+vrna_fun_zip_add_min(const int  *e1,
+                     const int  *e2,
+                     int        count)
+{
+  return (*FUN_LOAD(fun_zip_add_min))(e1, e2, count);
+}
+
+
+PUBLIC FLT_OR_DBL
+vrna_fun_zip_mult_sum(const FLT_OR_DBL  *e1,
+                      const FLT_OR_DBL  *e2,
+                      int               count)
+{
+  return (*FUN_LOAD(fun_zip_mult_sum))(e1, e2, count);
+}
+
+
+PUBLIC FLT_OR_DBL
+vrna_fun_zip_mult_sum_reverse(const FLT_OR_DBL  *e1,
+                              const FLT_OR_DBL  *e2,
+                              int               count)
+{
+  return (*FUN_LOAD(fun_zip_mult_sum_reverse))(e1, e2, count);
+}
+
+
+PUBLIC void
+vrna_fun_dispatch_disable(void)
+{
+  fun_dispatch(VRNA_CPU_SIMD_NONE);
+}
+
+
+PUBLIC void
+vrna_fun_dispatch_enable(void)
+{
+  fun_dispatch(vrna_cpu_simd_capabilities());
+}
+
+
+PUBLIC void
+vrna_fun_dispatch_restrict(unsigned int features)
+{
+  fun_dispatch(features & vrna_cpu_simd_capabilities());
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+
+/*
+ *  Select the implementations for a set of instruction set extensions. We go
+ *  from the oldest to the most recent extension, the last one supported wins
+ */
+PRIVATE void
+fun_dispatch(unsigned int features)
+{
+  int (*add_min)(const int *,
+                 const int *,
+                 int) = &fun_zip_add_min_default;
+  FLT_OR_DBL (*mult_sum)(const FLT_OR_DBL *,
+                         const FLT_OR_DBL *,
+                         int) = &fun_zip_mult_sum_default;
+  FLT_OR_DBL (*mult_sum_reverse)(const FLT_OR_DBL *,
+                                 const FLT_OR_DBL *,
+                                 int) = &fun_zip_mult_sum_reverse_default;
+
+#ifdef VRNA_WITH_SIMD_SSE2
+  if (features & VRNA_CPU_SIMD_SSE2) {
+    mult_sum          = &vrna_fun_zip_mult_sum_sse2;
+    mult_sum_reverse  = &vrna_fun_zip_mult_sum_reverse_sse2;
+  }
+
+#endif
+
+#ifdef VRNA_WITH_SIMD_SSE41
+  if (features & VRNA_CPU_SIMD_SSE41)
+    add_min = &vrna_fun_zip_add_min_sse41;
+
+#endif
+
+#ifdef VRNA_WITH_SIMD_AVX2
+  if (features & VRNA_CPU_SIMD_AVX2) {
+    add_min           = &vrna_fun_zip_add_min_avx2;
+    mult_sum          = &vrna_fun_zip_mult_sum_avx2;
+    mult_sum_reverse  = &vrna_fun_zip_mult_sum_reverse_avx2;
+  }
+
+#endif
+
+#ifdef VRNA_WITH_SIMD_AVX512
+  if (features & VRNA_CPU_SIMD_AVX512F) {
+    add_min           = &vrna_fun_zip_add_min_avx512;
+    mult_sum          = &vrna_fun_zip_mult_sum_avx512;
+    mult_sum_reverse  = &vrna_fun_zip_mult_sum_reverse_avx512;
+  }
+
+#endif
+
+  FUN_STORE(fun_zip_add_min, add_min);
+  FUN_STORE(fun_zip_mult_sum, mult_sum);
+  FUN_STORE(fun_zip_mult_sum_reverse, mult_sum_reverse);
+}
+
+
+PRIVATE int
+fun_zip_add_min_default(const int *e1,
+                        const int *e2,
+                        int       count)
+{
+  int i, e;
+
+  e = INF;
+
+  for (i = 0; i < count; i++) {
+    if ((e1[i] != INF) && (e2[i] != INF)) {
+      const int en = e1[i] + e2[i];
+      e = MIN2(e, en);
+    }
+  }
+
+  return e;
+}
+
+
+PRIVATE int
+fun_zip_add_min_dispatcher(const int  *e1,
+                           const int  *e2,
+                           int        count)
+{
+  fun_dispatch(vrna_cpu_simd_capabilities());
+
+  return vrna_fun_zip_add_min(e1, e2, count);
+}
+
+
+PRIVATE FLT_OR_DBL
+fun_zip_mult_sum_default(const FLT_OR_DBL *e1,
+                         const FLT_OR_DBL *e2,
+                         int              count)
+{
+  int         i, k;
+  FLT_OR_DBL  sum, lanes[SUM_LANES] = {
+    0.
+  };
+
+  for (i = 0; i < count - (SUM_LANES - 1); i += SUM_LANES)
+    for (k = 0; k < SUM_LANES; k++)
+      lanes[k] += e1[i + k] *
+                  e2[i + k];
+
+  for (k = SUM_LANES / 2; k > 0; k /= 2)
+    for (i = 0; i < k; i++)
+      lanes[i] += lanes[i + k];
+
+  sum = lanes[0];
+
+  for (i = count - count % SUM_LANES; i < count; i++)
+    sum += e1[i] *
+           e2[i];
+
+  return sum;
+}
+
+
+PRIVATE FLT_OR_DBL
+fun_zip_mult_sum_dispatcher(const FLT_OR_DBL  *e1,
+                            const FLT_OR_DBL  *e2,
+                            int               count)
+{
+  fun_dispatch(vrna_cpu_simd_capabilities());
+
+  return vrna_fun_zip_mult_sum(e1, e2, count);
+}
+
+
+PRIVATE FLT_OR_DBL
+fun_zip_mult_sum_reverse_default(const FLT_OR_DBL *e1,
+                                 const FLT_OR_DBL *e2,
+                                 int              count)
+{
+  int         i, k;
+  FLT_OR_DBL  sum, lanes[SUM_LANES] = {
+    0.
+  };
+
+  for (i = 0; i < count - (SUM_LANES - 1); i += SUM_LANES)
+    for (k = 0; k < SUM_LANES; k++)
+      lanes[k] += e1[i + k] *
+                  e2[-i - k];
+
+  for (k = SUM_LANES / 2; k > 0; k /= 2)
+    for (i = 0; i < k; i++)
+      lanes[i] += lanes[i + k];
+
+  sum = lanes[0];
+
+  for (i = count - count % SUM_LANES; i < count; i++)
+    sum += e1[i] *
+           e2[-i];
+
+  return sum;
+}
+
+
+PRIVATE FLT_OR_DBL
+fun_zip_mult_sum_reverse_dispatcher(const FLT_OR_DBL  *e1,
+                                    const FLT_OR_DBL  *e2,
+                                    int               count)
+{
+  fun_dispatch(vrna_cpu_simd_capabilities());
+
+  return vrna_fun_zip_mult_sum_reverse(e1, e2, count);
+}
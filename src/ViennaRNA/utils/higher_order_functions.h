@@ -0,0 +1,130 @@
+#ifndef VIENNA_RNA_PACKAGE_UTILS_HIGHER_ORDER_FUNCTIONS_H
+#define VIENNA_RNA_PACKAGE_UTILS_HIGHER_ORDER_FUNCTIONS_H
+
+/**
+ *  @file     ViennaRNA/utils/higher_order_functions.h
+ *  @ingroup  utils, fun_utils
+ *  @brief    Higher order functions used in the dynamic programming recursions
+ */
+
+#include <ViennaRNA/datastructures/basic.h>
+
+/**
+ *  @addtogroup   fun_utils
+ *  @{
+ *  @brief  Building blocks of the dynamic programming recursions
+ *
+ *  The functions in this module implement operations on entire arrays that
+ *  frequently appear in the inner loops of our recursions. Each of them comes
+ *  with optimized implementations for different SIMD instruction set extensions,
+ *  e.g. SSE2, SSE4.1, AVX2, and AVX-512. The fastest implementation supported by the
+ *  host CPU is selected at runtime upon the first call of the respective function.
+ *
+ *  @see  vrna_cpu_simd_capabilities()
+ */
+
+/**
+ *  @brief  Get the minimum of the element-wise sum of two integer arrays
+ *
+ *  Computes @f$ \min_{0 \leq k < count} e_1[k] + e_2[k] @f$, where all @f$ k @f$
+ *  with @f$ e_1[k] = INF @f$ or @f$ e_2[k] = INF @f$ are ignored.
+ *
+ *  @param  e1    The first integer array
+ *  @param  e2    The second integer array
+ *  @param  count The number of elements
+ *  @return       The minimum of the element-wise sums, or @p INF if no finite sum exists
+ */
+int
+vrna_fun_zip_add_min(const int  *e1,
+                     const int  *e2,
+                     int        count);
+
+
+/**
+ *  @brief  Get the sum of the element-wise product of two arrays
+ *
+ *  Computes @f$ \sum_{0 \leq k < count} e_1[k] \cdot e_2[k] @f$, i.e. the
+ *  dot product of both arrays, as frequently required in the partition
+ *  function recursions.
+ *
+ *  @note   The SIMD implementations accumulate the products in a different
+ *          order than the generic implementation. Thus, the result may differ
+ *          in the last bits of the floating point representation, depending on
+ *          the instruction set extension actually used.
+ *
+ *  @param  e1    The first array
+ *  @param  e2    The second array
+ *  @param  count The number of elements
+ *  @return       The sum of the element-wise products, or 0 if @p count < 1
+ */
+FLT_OR_DBL
+vrna_fun_zip_mult_sum(const FLT_OR_DBL  *e1,
+                      const FLT_OR_DBL  *e2,
+                      int               count);
+
+
+/**
+ *  @brief  Get the sum of the element-wise product of an array and a reversed array
+ *
+ *  Computes @f$ \sum_{0 \leq k < count} e_1[k] \cdot e_2[-k] @f$, i.e. @p e2
+ *  points to the @em last element of the second array that is traversed in
+ *  reverse order. This is the case whenever we combine a row of a triangular
+ *  matrix in our default (@p iindx) memory layout with an auxiliary array
+ *  indexed by nucleotide position.
+ *
+ *  @note   Same as for vrna_fun_zip_mult_sum(), the result may differ in the last
+ *          bits depending on the instruction set extension actually used.
+ *
+ *  @param  e1    The first array
+ *  @param  e2    Pointer to the last element of the second array
+ *  @param  count The number of elements
+ *  @return       The sum of the element-wise products, or 0 if @p count < 1
+ */
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_reverse(const FLT_OR_DBL  *e1,
+                              const FLT_OR_DBL  *e2,
+                              int               count);
+
+
+/**
+ *  @brief  Disable the runtime dispatch of SIMD implementations
+ *
+ *  Subsequent calls to the functions of this module will use the generic,
+ *  non-vectorized implementations. This is mainly useful for benchmarking
+ *  and debugging purposes.
+ *
+ *  @see  vrna_fun_dispatch_enable()
+ */
+void
+vrna_fun_dispatch_disable(void);
+
+
+/**
+ *  @brief  (Re-)enable the runtime dispatch of SIMD implementations
+ *
+ *  @see  vrna_fun_dispatch_disable(), vrna_fun_dispatch_restrict()
+ */
+void
+vrna_fun_dispatch_enable(void);
+
+
+/**
+ *  @brief  Restrict the runtime dispatch of SIMD implementations to a set of instruction set extensions
+ *
+ *  Subsequent calls to the functions of this module will use the most recent
+ *  implementation whose instruction set extension is contained in @p features
+ *  and supported by the host CPU. This is mainly useful to compare the different
+ *  implementations against each other.
+ *
+ *  @see  vrna_fun_dispatch_enable(), vrna_fun_dispatch_disable(), vrna_cpu_simd_capabilities()
+ *  @param  features  A bit-vector of SIMD capabilities, e.g. @ref VRNA_CPU_SIMD_SSE2
+ */
+void
+vrna_fun_dispatch_restrict(unsigned int features);
+
+
+/**
+ *  @}
+ */
+
+#endif
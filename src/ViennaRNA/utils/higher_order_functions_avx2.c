@@ -0,0 +1,197 @@
+/*
+ *  ViennaRNA/utils/higher_order_functions_avx2.c
+ *
+ *  AVX2 implementations of higher order functions. This file must be
+ *  compiled with AVX2 support enabled, e.g. -mavx2, and its functions
+ *  must only be called on CPUs that support these instructions
+ *
+ *  ViennaRNA package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <immintrin.h>
+
+#include "ViennaRNA/utils/basic.h"
+
+#include "higher_order_functions_sum.inc"
+
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+
+/*
+ *  Depending on the precision of our partition function computations, we
+ *  either process 4 double or 8 float values per vector register
+ */
+#ifdef USE_FLOAT_PF
+typedef __m256 vec_t;
+# define VEC_WIDTH              8
+# define vec_zero()             _mm256_setzero_ps()
+# define vec_load(p)            _mm256_loadu_ps(p)
+# define vec_add(a, b)          _mm256_add_ps((a), (b))
+# define vec_mul(a, b)          _mm256_mul_ps((a), (b))
+# define vec_reverse(a)         _mm256_permutevar8x32_ps((a), _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7))
+#else
+typedef __m256d vec_t;
+# define VEC_WIDTH              4
+# define vec_zero()             _mm256_setzero_pd()
+# define vec_load(p)            _mm256_loadu_pd(p)
+# define vec_add(a, b)          _mm256_add_pd((a), (b))
+# define vec_mul(a, b)          _mm256_mul_pd((a), (b))
+# define vec_reverse(a)         _mm256_permute4x64_pd((a), _MM_SHUFFLE(0, 1, 2, 3))
+#endif
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+PRIVATE INLINE int
+horizontal_min_Vec8i(__m256i x);
+
+
+PRIVATE INLINE FLT_OR_DBL
+horizontal_sum(vec_t x);
+
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+int
+vrna_fun_zip_add_min_avx2(const int *e1,
+                          const int *e2,
+                          int       count)
+{
+  int     i, e;
+  __m256i inf   = _mm256_set1_epi32(INF);
+  __m256i vmin  = inf;
+
+  for (i = 0; i < count - 7; i += 8) {
+    __m256i a = _mm256_loadu_si256((__m256i *)&e1[i]);
+    __m256i b = _mm256_loadu_si256((__m256i *)&e2[i]);
+
+    /* mask all sums where at least one of the summands is INF */
+    __m256i mask = _mm256_or_si256(_mm256_cmpeq_epi32(a, inf),
+                                   _mm256_cmpeq_epi32(b, inf));
+    __m256i sum = _mm256_blendv_epi8(_mm256_add_epi32(a, b), inf, mask);
+
+    vmin = _mm256_min_epi32(vmin, sum);
+  }
+
+  e = horizontal_min_Vec8i(vmin);
+
+  for (; i < count; i++) {
+    if ((e1[i] != INF) && (e2[i] != INF)) {
+      const int en = e1[i] + e2[i];
+      e = MIN2(e, en);
+    }
+  }
+
+  return e;
+}
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_avx2(const FLT_OR_DBL *e1,
+                           const FLT_OR_DBL *e2,
+                           int              count)
+{
+  int         i;
+  FLT_OR_DBL  sum;
+  vec_t       s1  = vec_zero();
+  vec_t       s2  = vec_zero();
+
+  /* two accumulators make up the lanes */
+  for (i = 0; i < count - (2 * VEC_WIDTH - 1); i += 2 * VEC_WIDTH) {
+    s1  = vec_add(s1, vec_mul(vec_load(e1 + i), vec_load(e2 + i)));
+    s2  = vec_add(s2, vec_mul(vec_load(e1 + i + VEC_WIDTH), vec_load(e2 + i + VEC_WIDTH)));
+  }
+
+  sum = horizontal_sum(vec_add(s1, s2));
+
+  for (; i < count; i++)
+    sum += e1[i] *
+           e2[i];
+
+  return sum;
+}
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_reverse_avx2(const FLT_OR_DBL *e1,
+                                   const FLT_OR_DBL *e2,
+                                   int              count)
+{
+  int         i;
+  FLT_OR_DBL  sum;
+  vec_t       s1  = vec_zero();
+  vec_t       s2  = vec_zero();
+
+  /* e2 is traversed backwards, so we load its elements in reverse lane order */
+  for (i = 0; i < count - (2 * VEC_WIDTH - 1); i += 2 * VEC_WIDTH) {
+    s1  = vec_add(s1,
+                  vec_mul(vec_load(e1 + i),
+                          vec_reverse(vec_load(e2 - i - (VEC_WIDTH - 1)))));
+    s2  = vec_add(s2,
+                  vec_mul(vec_load(e1 + i + VEC_WIDTH),
+                          vec_reverse(vec_load(e2 - i - (2 * VEC_WIDTH - 1)))));
+  }
+
+  sum = horizontal_sum(vec_add(s1, s2));
+
+  for (; i < count; i++)
+    sum += e1[i] *
+           e2[-i];
+
+  return sum;
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+PRIVATE INLINE int
+horizontal_min_Vec8i(__m256i x)
+{
+  /* reduce to 128 bit first, then proceed as for SSE */
+  __m128i min0  = _mm_min_epi32(_mm256_castsi256_si128(x),
+                                _mm256_extracti128_si256(x, 1));
+  __m128i min1  = _mm_shuffle_epi32(min0, _MM_SHUFFLE(0, 0, 3, 2));
+  __m128i min2  = _mm_min_epi32(min0, min1);
+  __m128i min3  = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0, 0, 0, 1));
+  __m128i min4  = _mm_min_epi32(min2, min3);
+
+  return _mm_cvtsi128_si32(min4);
+}
+
+
+PRIVATE INLINE FLT_OR_DBL
+horizontal_sum(vec_t x)
+{
+  /* reduce to 128 bit first, then proceed as for SSE */
+#ifdef USE_FLOAT_PF
+  __m128  sum0  = _mm_add_ps(_mm256_castps256_ps128(x),
+                             _mm256_extractf128_ps(x, 1));
+  __m128  sum1  = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+  __m128  sum2  = _mm_add_ss(sum1, _mm_shuffle_ps(sum1, sum1, _MM_SHUFFLE(0, 0, 0, 1)));
+
+  return _mm_cvtss_f32(sum2);
+#else
+  __m128d sum0 = _mm_add_pd(_mm256_castpd256_pd128(x),
+                            _mm256_extractf128_pd(x, 1));
+
+  return _mm_cvtsd_f64(_mm_add_sd(sum0, _mm_unpackhi_pd(sum0, sum0)));
+#endif
+}
@@ -0,0 +1,178 @@
+/*
+ *  ViennaRNA/utils/higher_order_functions_avx512.c
+ *
+ *  AVX-512 implementations of higher order functions. This file must be
+ *  compiled with AVX-512F support enabled, e.g. -mavx512f, and its functions
+ *  must only be called on CPUs that support these instructions
+ *
+ *  ViennaRNA package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <immintrin.h>
+
+#include "ViennaRNA/utils/basic.h"
+
+#include "higher_order_functions_sum.inc"
+
+/*
+ *  Depending on the precision of our partition function computations, we
+ *  either process 8 double or 16 float values per vector register
+ */
+#ifdef USE_FLOAT_PF
+typedef __m512 vec_t;
+# define VEC_WIDTH              16
+# define vec_zero()             _mm512_setzero_ps()
+# define vec_load(p)            _mm512_loadu_ps(p)
+# define vec_add(a, b)          _mm512_add_ps((a), (b))
+# define vec_mul(a, b)          _mm512_mul_ps((a), (b))
+# define vec_reverse(a)         _mm512_permutexvar_ps(_mm512_set_epi32(0, 1, 2, 3, 4, 5, 6, 7, \
+                                                                       8, 9, 10, 11, 12, 13, 14, 15), (a))
+#else
+typedef __m512d vec_t;
+# define VEC_WIDTH              8
+# define vec_zero()             _mm512_setzero_pd()
+# define vec_load(p)            _mm512_loadu_pd(p)
+# define vec_add(a, b)          _mm512_add_pd((a), (b))
+# define vec_mul(a, b)          _mm512_mul_pd((a), (b))
+# define vec_reverse(a)         _mm512_permutexvar_pd(_mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7), (a))
+#endif
+
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+PRIVATE INLINE FLT_OR_DBL
+horizontal_sum(vec_t x);
+
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+int
+vrna_fun_zip_add_min_avx512(const int *e1,
+                            const int *e2,
+                            int       count)
+{
+  int       i, e;
+  __m512i   inf   = _mm512_set1_epi32(INF);
+  __m512i   vmin  = inf;
+  __mmask16 mask;
+
+  for (i = 0; i < count - 15; i += 16) {
+    __m512i a = _mm512_loadu_si512((void *)&e1[i]);
+    __m512i b = _mm512_loadu_si512((void *)&e2[i]);
+
+    /* only consider sums where none of the summands is INF */
+    mask  = _mm512_cmpneq_epi32_mask(a, inf) &
+            _mm512_cmpneq_epi32_mask(b, inf);
+    vmin = _mm512_mask_min_epi32(vmin, mask, vmin, _mm512_add_epi32(a, b));
+  }
+
+  /* process the remainder with a partial load */
+  if (i < count) {
+    __mmask16 rem = (__mmask16)((1U << (count - i)) - 1U);
+    __m512i   a   = _mm512_mask_loadu_epi32(inf, rem, (void *)&e1[i]);
+    __m512i   b   = _mm512_mask_loadu_epi32(inf, rem, (void *)&e2[i]);
+
+    mask  = _mm512_cmpneq_epi32_mask(a, inf) &
+            _mm512_cmpneq_epi32_mask(b, inf);
+    vmin = _mm512_mask_min_epi32(vmin, mask, vmin, _mm512_add_epi32(a, b));
+  }
+
+  e = _mm512_reduce_min_epi32(vmin);
+
+  return e;
+}
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_avx512(const FLT_OR_DBL *e1,
+                             const FLT_OR_DBL *e2,
+                             int              count)
+{
+  int         i;
+  FLT_OR_DBL  sum;
+  vec_t       s = vec_zero();
+
+  /* a single accumulator makes up the lanes */
+  for (i = 0; i < count - (VEC_WIDTH - 1); i += VEC_WIDTH)
+    s = vec_add(s, vec_mul(vec_load(e1 + i), vec_load(e2 + i)));
+
+  sum = horizontal_sum(s);
+
+  for (; i < count; i++)
+    sum += e1[i] *
+           e2[i];
+
+  return sum;
+}
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_reverse_avx512(const FLT_OR_DBL *e1,
+                                     const FLT_OR_DBL *e2,
+                                     int              count)
+{
+  int         i;
+  FLT_OR_DBL  sum;
+  vec_t       s = vec_zero();
+
+  /* e2 is traversed backwards, so we load its elements in reverse lane order */
+  for (i = 0; i < count - (VEC_WIDTH - 1); i += VEC_WIDTH)
+    s = vec_add(s,
+                vec_mul(vec_load(e1 + i),
+                        vec_reverse(vec_load(e2 - i - (VEC_WIDTH - 1)))));
+
+  sum = horizontal_sum(s);
+
+  for (; i < count; i++)
+    sum += e1[i] *
+           e2[-i];
+
+  return sum;
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+PRIVATE INLINE FLT_OR_DBL
+horizontal_sum(vec_t x)
+{
+  /* fold the upper onto the lower 256 bit, then proceed as for AVX2 */
+#ifdef USE_FLOAT_PF
+  __m256  sum0  = _mm256_add_ps(_mm512_castps512_ps256(x),
+                                _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(x), 1)));
+  __m128  sum1  = _mm_add_ps(_mm256_castps256_ps128(sum0),
+                             _mm256_extractf128_ps(sum0, 1));
+  __m128  sum2  = _mm_add_ps(sum1, _mm_movehl_ps(sum1, sum1));
+  __m128  sum3  = _mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, _MM_SHUFFLE(0, 0, 0, 1)));
+
+  return _mm_cvtss_f32(sum3);
+#else
+  __m256d sum0  = _mm256_add_pd(_mm512_castpd512_pd256(x),
+                                _mm512_extractf64x4_pd(x, 1));
+  __m128d sum1  = _mm_add_pd(_mm256_castpd256_pd128(sum0),
+                             _mm256_extractf128_pd(sum0, 1));
+
+  return _mm_cvtsd_f64(_mm_add_sd(sum1, _mm_unpackhi_pd(sum1, sum1)));
+#endif
+}
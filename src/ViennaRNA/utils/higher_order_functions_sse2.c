@@ -0,0 +1,150 @@
+/*
+ *  ViennaRNA/utils/higher_order_functions_sse2.c
+ *
+ *  SSE2 implementations of higher order functions. This file must be
+ *  compiled with SSE2 support enabled, e.g. -msse2, and its functions
+ *  must only be called on CPUs that support these instructions
+ *
+ *  ViennaRNA package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <emmintrin.h>
+
+#include "ViennaRNA/utils/basic.h"
+
+#include "higher_order_functions_sum.inc"
+
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+
+/*
+ *  Depending on the precision of our partition function computations, we
+ *  either process 2 double or 4 float values per vector register
+ */
+#ifdef USE_FLOAT_PF
+typedef __m128 vec_t;
+# define VEC_WIDTH              4
+# define vec_zero()             _mm_setzero_ps()
+# define vec_load(p)            _mm_loadu_ps(p)
+# define vec_add(a, b)          _mm_add_ps((a), (b))
+# define vec_mul(a, b)          _mm_mul_ps((a), (b))
+# define vec_reverse(a)         _mm_shuffle_ps((a), (a), _MM_SHUFFLE(0, 1, 2, 3))
+#else
+typedef __m128d vec_t;
+# define VEC_WIDTH              2
+# define vec_zero()             _mm_setzero_pd()
+# define vec_load(p)            _mm_loadu_pd(p)
+# define vec_add(a, b)          _mm_add_pd((a), (b))
+# define vec_mul(a, b)          _mm_mul_pd((a), (b))
+# define vec_reverse(a)         _mm_shuffle_pd((a), (a), 1)
+#endif
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+PRIVATE INLINE FLT_OR_DBL
+horizontal_sum(vec_t x);
+
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_sse2(const FLT_OR_DBL *e1,
+                           const FLT_OR_DBL *e2,
+                           int              count)
+{
+  int         i;
+  FLT_OR_DBL  sum;
+  vec_t       s1  = vec_zero();
+  vec_t       s2  = vec_zero();
+  vec_t       s3  = vec_zero();
+  vec_t       s4  = vec_zero();
+
+  /* four accumulators make up the lanes */
+  for (i = 0; i < count - (4 * VEC_WIDTH - 1); i += 4 * VEC_WIDTH) {
+    s1  = vec_add(s1, vec_mul(vec_load(e1 + i), vec_load(e2 + i)));
+    s2  = vec_add(s2, vec_mul(vec_load(e1 + i + VEC_WIDTH), vec_load(e2 + i + VEC_WIDTH)));
+    s3  = vec_add(s3, vec_mul(vec_load(e1 + i + 2 * VEC_WIDTH), vec_load(e2 + i + 2 * VEC_WIDTH)));
+    s4  = vec_add(s4, vec_mul(vec_load(e1 + i + 3 * VEC_WIDTH), vec_load(e2 + i + 3 * VEC_WIDTH)));
+  }
+
+  sum = horizontal_sum(vec_add(vec_add(s1, s3), vec_add(s2, s4)));
+
+  for (; i < count; i++)
+    sum += e1[i] *
+           e2[i];
+
+  return sum;
+}
+
+
+FLT_OR_DBL
+vrna_fun_zip_mult_sum_reverse_sse2(const FLT_OR_DBL *e1,
+                                   const FLT_OR_DBL *e2,
+                                   int              count)
+{
+  int         i;
+  FLT_OR_DBL  sum;
+  vec_t       s1  = vec_zero();
+  vec_t       s2  = vec_zero();
+  vec_t       s3  = vec_zero();
+  vec_t       s4  = vec_zero();
+
+  /* e2 is traversed backwards, so we load its elements in reverse lane order */
+  for (i = 0; i < count - (4 * VEC_WIDTH - 1); i += 4 * VEC_WIDTH) {
+    s1  = vec_add(s1,
+                  vec_mul(vec_load(e1 + i),
+                          vec_reverse(vec_load(e2 - i - (VEC_WIDTH - 1)))));
+    s2  = vec_add(s2,
+                  vec_mul(vec_load(e1 + i + VEC_WIDTH),
+                          vec_reverse(vec_load(e2 - i - (2 * VEC_WIDTH - 1)))));
+    s3  = vec_add(s3,
+                  vec_mul(vec_load(e1 + i + 2 * VEC_WIDTH),
+                          vec_reverse(vec_load(e2 - i - (3 * VEC_WIDTH - 1)))));
+    s4  = vec_add(s4,
+                  vec_mul(vec_load(e1 + i + 3 * VEC_WIDTH),
+                          vec_reverse(vec_load(e2 - i - (4 * VEC_WIDTH - 1)))));
+  }
+
+  sum = horizontal_sum(vec_add(vec_add(s1, s3), vec_add(s2, s4)));
+
+  for (; i < count; i++)
+    sum += e1[i] *
+           e2[-i];
+
+  return sum;
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+PRIVATE INLINE FLT_OR_DBL
+horizontal_sum(vec_t x)
+{
+#ifdef USE_FLOAT_PF
+  __m128  sum1  = _mm_add_ps(x, _mm_movehl_ps(x, x));
+  __m128  sum2  = _mm_add_ss(sum1, _mm_shuffle_ps(sum1, sum1, _MM_SHUFFLE(0, 0, 0, 1)));
+
+  return _mm_cvtss_f32(sum2);
+#else
+  return _mm_cvtsd_f64(_mm_add_sd(x, _mm_unpackhi_pd(x, x)));
+#endif
+}
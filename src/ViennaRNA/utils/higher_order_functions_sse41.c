@@ -0,0 +1,96 @@
+/*
+ *  ViennaRNA/utils/higher_order_functions_sse41.c
+ *
+ *  SSE4.1 implementations of higher order functions. This file must be
+ *  compiled with SSE4.1 support enabled, e.g. -msse4.1, and its functions
+ *  must only be called on CPUs that support these instructions
+ *
+ *  ViennaRNA package
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+
+#include "ViennaRNA/utils/basic.h"
+
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+
+/*
+ #################################
+ # PRIVATE FUNCTION DECLARATIONS #
+ #################################
+ */
+PRIVATE INLINE int
+horizontal_min_Vec4i(__m128i x);
+
+
+/*
+ #################################
+ # BEGIN OF FUNCTION DEFINITIONS #
+ #################################
+ */
+int
+vrna_fun_zip_add_min_sse41(const int  *e1,
+                           const int  *e2,
+                           int        count)
+{
+  int     i, e;
+  __m128i inf   = _mm_set1_epi32(INF);
+  __m128i vmin  = inf;
+
+  for (i = 0; i < count - 3; i += 4) {
+    __m128i a = _mm_loadu_si128((__m128i *)&e1[i]);
+    __m128i b = _mm_loadu_si128((__m128i *)&e2[i]);
+
+    /* mask all sums where at least one of the summands is INF */
+    __m128i mask = _mm_or_si128(_mm_cmpeq_epi32(a, inf),
+                                _mm_cmpeq_epi32(b, inf));
+    __m128i sum = _mm_blendv_epi8(_mm_add_epi32(a, b), inf, mask);
+
+    vmin = _mm_min_epi32(vmin, sum);
+  }
+
+  e = horizontal_min_Vec4i(vmin);
+
+  for (; i < count; i++) {
+    if ((e1[i] != INF) && (e2[i] != INF)) {
+      const int en = e1[i] + e2[i];
+      e = MIN2(e, en);
+    }
+  }
+
+  return e;
+}
+
+
+/*
+ #####################################
+ # BEGIN OF STATIC HELPER FUNCTIONS  #
+ #####################################
+ */
+
+/*
+ *  SSE minimum
+ *  see also: http://stackoverflow.com/questions/9877700/getting-max-value-in-a-m128i-vector-with-sse
+ */
+PRIVATE INLINE int
+horizontal_min_Vec4i(__m128i x)
+{
+  __m128i min1  = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 0, 3, 2));
+  __m128i min2  = _mm_min_epi32(x, min1);
+  __m128i min3  = _mm_shuffle_epi32(min2, _MM_SHUFFLE(0, 0, 0, 1));
+  __m128i min4  = _mm_min_epi32(min2, min3);
+
+  return _mm_cvtsi128_si32(min4);
+}
@@ -990,9 +990,10 @@ wrap_get_plist(vrna_mx_pf_t     *matrices,
                vrna_exp_param_t *pf_params,
                double           cut_off)
 {
-  int         i, j, k, n, count, gquad;
-  FLT_OR_DBL  *probs, *G, *scale;
-  vrna_ep_t   *pl;
+  int             i, j, k, n, count, gquad;
+  FLT_OR_DBL      *probs, *scale;
+  vrna_gquad_mx_t *G;
+  vrna_ep_t       *pl;
 
   probs = matrices->probs;
   G     = matrices->G;
@@ -1076,7 +1077,8 @@ wrap_plist(vrna_fold_compound_t *vc,
 {
   short             *S;
   int               i, j, k, n, m, count, gquad, length, *index;
-  FLT_OR_DBL        *probs, *G, *scale;
+  FLT_OR_DBL        *probs, *scale;
+  vrna_gquad_mx_t   *G;
   vrna_ep_t         *pl;
   vrna_mx_pf_t      *matrices;
   vrna_exp_param_t  *pf_params;
@@ -35,6 +35,14 @@
 #include "dmalloc.h"
 #endif
 
+#ifndef INLINE
+#ifdef __GNUC__
+# define INLINE inline
+#else
+# define INLINE
+#endif
+#endif
+
 #define PRIVATE  static
 #define PUBLIC
 
@@ -51,6 +59,16 @@
 PUBLIC unsigned short xsubi[3];
 
 
+/*
+ #################################
+ # PRIVATE DATA STRUCTURES       #
+ #################################
+ */
+struct vrna_rng_s {
+  uint64_t s[4];
+};
+
+
 /*
  #################################
  # PRIVATE VARIABLES             #
@@ -59,6 +77,32 @@ PUBLIC unsigned short xsubi[3];
 PRIVATE char  scale1[]  = "....,....1....,....2....,....3....,....4";
 PRIVATE char  scale2[]  = "....,....5....,....6....,....7....,....8";
 
+/*
+ *  Seeds of vrna_urn() are published through xsubi. The upper 32 bits of
+ *  urn_epoch count the (re-)seeds, the lower 32 bits the threads that have
+ *  adopted the current seed so far. Each thread draws from its own state
+ *  derived from the seed, such that no locking is required per draw
+ */
+PRIVATE uint64_t        urn_epoch = (uint64_t)1 << 32;
+
+PRIVATE unsigned short  urn_state[3];
+PRIVATE uint32_t        urn_seed_id;
+PRIVATE uint32_t        urn_stream;
+
+/* NOTE: all variables are assumed to be uninitialized if they are declared as threadprivate
+ */
+#pragma omp threadprivate(urn_state, urn_seed_id, urn_stream)
+
+#ifdef __GNUC__
+# define URN_LOAD(ptr)          __atomic_load_n(&(ptr), __ATOMIC_ACQUIRE)
+# define URN_STORE(ptr, val)    __atomic_store_n(&(ptr), (val), __ATOMIC_RELEASE)
+# define URN_FETCH_ADD(ptr)     __atomic_fetch_add(&(ptr), 1, __ATOMIC_ACQ_REL)
+#else
+# define URN_LOAD(ptr)          (ptr)
+# define URN_STORE(ptr, val)    ((ptr) = (val))
+# define URN_FETCH_ADD(ptr)     ((ptr)++)
+#endif
+
 /*
  #################################
  # PRIVATE FUNCTION DECLARATIONS #
@@ -70,6 +114,18 @@ rj_mix(uint32_t a,
        uint32_t c);
 
 
+PRIVATE INLINE uint64_t
+rng_next(vrna_rng_t *rng);
+
+
+#ifdef HAVE_ERAND48
+PRIVATE void
+urn_adopt_seed(void);
+
+
+#endif
+
+
 /*
  #################################
  # BEGIN OF FUNCTION DEFINITIONS #
@@ -242,11 +298,20 @@ vrna_message_vinfo(FILE       *fp,
 PUBLIC void
 vrna_init_rand(void)
 {
-  uint32_t seed = rj_mix(clock(), time(NULL), getpid());
+  uint32_t        seed = rj_mix(clock(), time(NULL), getpid());
+  unsigned short  s[3];
+
+  s[0]  = s[1] = s[2] = (unsigned short)seed;  /* lower 16 bit */
+  s[1]  += (unsigned short)((unsigned)seed >> 6);
+  s[2]  += (unsigned short)((unsigned)seed >> 12);
+
+  URN_STORE(xsubi[0], s[0]);
+  URN_STORE(xsubi[1], s[1]);
+  URN_STORE(xsubi[2], s[2]);
+
+  /* start a new epoch, all threads adopt the new seed upon their next draw */
+  URN_STORE(urn_epoch, ((URN_LOAD(urn_epoch) >> 32) + 1) << 32);
 
-  xsubi[0]  = xsubi[1] = xsubi[2] = (unsigned short)seed;  /* lower 16 bit */
-  xsubi[1]  += (unsigned short)((unsigned)seed >> 6);
-  xsubi[2]  += (unsigned short)((unsigned)seed >> 12);
 #ifndef HAVE_ERAND48
   srand((unsigned int)seed);
 #endif
@@ -264,8 +329,29 @@ vrna_urn(void)
 #ifdef HAVE_ERAND48
   extern double erand48(unsigned short[]);
 
+  double r;
+
+  if ((uint32_t)(URN_LOAD(urn_epoch) >> 32) != urn_seed_id) {
+    urn_adopt_seed();
+  } else if ((urn_stream == 0) &&
+             ((URN_LOAD(xsubi[0]) != urn_state[0]) ||
+              (URN_LOAD(xsubi[1]) != urn_state[1]) ||
+              (URN_LOAD(xsubi[2]) != urn_state[2]))) {
+    /* xsubi has been (re-)seeded directly, so start a new epoch */
+    URN_STORE(urn_epoch, ((URN_LOAD(urn_epoch) >> 32) + 1) << 32);
+    urn_adopt_seed();
+  }
+
+  r = erand48(urn_state);
+
+  /* the first thread of an epoch keeps xsubi up to date as before */
+  if (urn_stream == 0) {
+    URN_STORE(xsubi[0], urn_state[0]);
+    URN_STORE(xsubi[1], urn_state[1]);
+    URN_STORE(xsubi[2], urn_state[2]);
+  }
 
-  return erand48(xsubi);
+  return r;
 #else
   return ((double)rand()) / RAND_MAX;
 #endif
@@ -282,6 +368,102 @@ vrna_int_urn(int  from,
 }
 
 
+/*------------------------------------------------------------------------*/
+
+/*
+ *  xoshiro256** by David Blackman and Sebastiano Vigna, seeded
+ *  through splitmix64 as recommended by the authors
+ */
+PUBLIC vrna_rng_t *
+vrna_rng_init(uint64_t seed)
+{
+  unsigned int  i;
+  uint64_t      z;
+  vrna_rng_t    *rng;
+
+  rng = (vrna_rng_t *)vrna_alloc(sizeof(vrna_rng_t));
+
+  for (i = 0; i < 4; i++) {
+    seed  += 0x9e3779b97f4a7c15ULL;
+    z     = seed;
+    z     = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z     = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    rng->s[i] = z ^ (z >> 31);
+  }
+
+  return rng;
+}
+
+
+PUBLIC void
+vrna_rng_free(vrna_rng_t *rng)
+{
+  free(rng);
+}
+
+
+PUBLIC void
+vrna_rng_jump(vrna_rng_t *rng)
+{
+  static const uint64_t jump[] = {
+    0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+  };
+  unsigned int          i, b;
+  uint64_t              s[4] = {
+    0, 0, 0, 0
+  };
+
+  if (rng) {
+    for (i = 0; i < 4; i++)
+      for (b = 0; b < 64; b++) {
+        if (jump[i] & (1ULL << b)) {
+          s[0]  ^= rng->s[0];
+          s[1]  ^= rng->s[1];
+          s[2]  ^= rng->s[2];
+          s[3]  ^= rng->s[3];
+        }
+
+        (void)rng_next(rng);
+      }
+
+    memcpy(rng->s, s, sizeof(s));
+  }
+}
+
+
+PUBLIC vrna_rng_t *
+vrna_rng_split(vrna_rng_t *rng)
+{
+  vrna_rng_t *stream = NULL;
+
+  if (rng) {
+    stream = (vrna_rng_t *)vrna_alloc(sizeof(vrna_rng_t));
+    memcpy(stream, rng, sizeof(vrna_rng_t));
+    vrna_rng_jump(rng);
+  }
+
+  return stream;
+}
+
+
+PUBLIC double
+vrna_rng_urn(vrna_rng_t *rng)
+{
+  /* upper 53 bits make up the mantissa of a double in [0, 1) */
+  return (double)(rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+PUBLIC int
+vrna_rng_int_urn(vrna_rng_t *rng,
+                 int        from,
+                 int        to)
+{
+  return ((int)(vrna_rng_urn(rng) * (to - from + 1))) + from;
+}
+
+
 /*------------------------------------------------------------------------*/
 
 /*-----------------------------------------------------------------*/
@@ -444,6 +626,65 @@ vrna_idx_col_wise(unsigned int length)
  # STATIC helper functions below #
  #################################
  */
+PRIVATE INLINE uint64_t
+rotl(const uint64_t x,
+     int            k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+
+#ifdef HAVE_ERAND48
+PRIVATE void
+urn_adopt_seed(void)
+{
+  uint64_t  epoch;
+  uint32_t  mix;
+
+  epoch       = URN_FETCH_ADD(urn_epoch);
+  urn_seed_id = (uint32_t)(epoch >> 32);
+  urn_stream  = (uint32_t)epoch;
+
+  urn_state[0]  = URN_LOAD(xsubi[0]);
+  urn_state[1]  = URN_LOAD(xsubi[1]);
+  urn_state[2]  = URN_LOAD(xsubi[2]);
+
+  /*
+   *  the first thread continues the sequence of xsubi, any further
+   *  thread starts at a different position derived from its index
+   */
+  if (urn_stream > 0) {
+    mix = rj_mix(urn_stream,
+                 ((uint32_t)urn_state[1] << 16) | urn_state[0],
+                 urn_state[2]);
+    urn_state[0]  ^= (unsigned short)mix;
+    urn_state[1]  ^= (unsigned short)(mix >> 16);
+    urn_state[2]  ^= (unsigned short)urn_stream;
+  }
+}
+
+
+#endif
+
+
+PRIVATE INLINE uint64_t
+rng_next(vrna_rng_t *rng)
+{
+  uint64_t  *s    = rng->s;
+  uint64_t  result = rotl(s[1] * 5, 7) * 9;
+  uint64_t  t     = s[1] << 17;
+
+  s[2]  ^= s[0];
+  s[3]  ^= s[1];
+  s[1]  ^= s[2];
+  s[0]  ^= s[3];
+  s[2]  ^= t;
+  s[3]  = rotl(s[3], 45);
+
+  return result;
+}
+
+
 PRIVATE uint32_t
 rj_mix(uint32_t a,
        uint32_t b,
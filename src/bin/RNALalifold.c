@@ -36,6 +36,7 @@
 #include "RNALalifold_cmdl.h"
 #include "gengetopt_helper.h"
 #include "input_id_helpers.h"
+#include "parallel_helpers.h"
 
 #include "ViennaRNA/color_output.inc"
 
@@ -82,7 +83,7 @@ main(int  argc,
   int                           n_seq, i, maxdist, unchangednc, unchangedcv, quiet, mis, istty,
                                 alnPS, aln_columns, aln_out, ssPS, input_file_num, with_shapes,
                                 *shape_file_association, verbose, s, tmp_number,
-                                split_contributions;
+                                split_contributions, jobs;
   long int                      first_alignment_number;
   float                         e_max;
   vrna_md_t                     md;
@@ -112,6 +113,7 @@ main(int  argc,
   quiet                   = 0;
   e_max                   = -0.1; /* threshold in kcal/mol per nucleotide in a hit */
   split_contributions     = 0;
+  jobs                    = 1;
 
   vrna_md_set_default(&md);
 
@@ -319,6 +321,26 @@ main(int  argc,
   if (args_info.split_contributions_given)
     split_contributions = 1;
 
+  /* multithreaded scan of each alignment */
+  if (args_info.jobs_given) {
+    int thread_max = max_user_threads();
+    if (args_info.jobs_arg == 0) {
+      /* use maximum of concurrent threads */
+      int proc_cores, proc_cores_conf;
+      if (num_proc_cores(&proc_cores, &proc_cores_conf)) {
+        jobs = MIN2(thread_max, proc_cores_conf);
+      } else {
+        vrna_message_warning("Could not determine number of available processor cores!\n"
+                             "Defaulting to serial computation");
+        jobs = 1;
+      }
+    } else {
+      jobs = MIN2(thread_max, args_info.jobs_arg);
+    }
+
+    jobs = MAX2(1, jobs);
+  }
+
   /* free allocated memory of command line data structure */
   RNALalifold_cmdline_parser_free(&args_info);
 
@@ -491,7 +513,7 @@ main(int  argc,
                                      VRNA_OPTION_MFE);
     }
 
-    (void)vrna_mfe_window_cb(fc, &print_hit_cb, (void *)&data);
+    (void)vrna_mfe_window_cb_parallel(fc, &print_hit_cb, (void *)&data, (unsigned int)jobs);
 
     string = (mis) ? consens_mis((const char **)AS) : consensus((const char **)AS);
     printf("%s\n", string);
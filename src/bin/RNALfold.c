@@ -30,6 +30,7 @@
 #include "RNALfold_cmdl.h"
 #include "gengetopt_helper.h"
 #include "input_id_helpers.h"
+#include "parallel_helpers.h"
 
 #include "ViennaRNA/color_output.inc"
 
@@ -70,7 +71,7 @@ main(int  argc,
                               *shape_file, *shape_method, *shape_conversion;
   unsigned int                rec_type, read_opt;
   int                         length, istty, noconv, maxdist, zsc, tofile, filename_full,
-                              with_shapes, verbose;
+                              with_shapes, verbose, jobs;
   double                      min_en, min_z;
   vrna_md_t                   md;
   vrna_cmd_t                  commands;
@@ -95,6 +96,7 @@ main(int  argc,
   filename_full = 0;
   command_file  = NULL;
   commands      = NULL;
+  jobs          = 1;
 
   /* apply default model details */
   vrna_md_set_default(&md);
@@ -209,6 +211,26 @@ main(int  argc,
   if (args_info.commands_given)
     command_file = strdup(args_info.commands_arg);
 
+  /* multithreaded scan of each sequence */
+  if (args_info.jobs_given) {
+    int thread_max = max_user_threads();
+    if (args_info.jobs_arg == 0) {
+      /* use maximum of concurrent threads */
+      int proc_cores, proc_cores_conf;
+      if (num_proc_cores(&proc_cores, &proc_cores_conf)) {
+        jobs = MIN2(thread_max, proc_cores_conf);
+      } else {
+        vrna_message_warning("Could not determine number of available processor cores!\n"
+                             "Defaulting to serial computation");
+        jobs = 1;
+      }
+    } else {
+      jobs = MIN2(thread_max, args_info.jobs_arg);
+    }
+
+    jobs = MAX2(1, jobs);
+  }
+
   /* check for errorneous parameter options */
   if (maxdist <= 0) {
     RNALfold_cmdline_parser_print_help();
@@ -347,11 +369,11 @@ main(int  argc,
 
 #ifdef VRNA_WITH_SVM
     min_en =
-      (zsc) ? vrna_mfe_window_zscore_cb(vc, min_z, &default_callback_z,
-                                        (void *)&data) : vrna_mfe_window_cb(vc, &default_callback,
-                                                                            (void *)&data);
+      (zsc) ? vrna_mfe_window_zscore_cb_parallel(vc, min_z, &default_callback_z, (void *)&data,
+                                                 (unsigned int)jobs) :
+      vrna_mfe_window_cb_parallel(vc, &default_callback, (void *)&data, (unsigned int)jobs);
 #else
-    min_en = vrna_mfe_window_cb(vc, &default_callback, (void *)&data);
+    min_en = vrna_mfe_window_cb_parallel(vc, &default_callback, (void *)&data, (unsigned int)jobs);
 #endif
     fprintf(output, "%s\n", orig_sequence);
 
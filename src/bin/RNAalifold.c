@@ -95,6 +95,8 @@ struct options {
   int             keep_order;
   unsigned int    next_record_number;
   vrna_ostream_t  output_queue;
+
+  vrna_fold_compound_pool_t *fc_pool;
 };
 
 
@@ -250,6 +252,7 @@ init_default_options(struct options *opt)
   opt->keep_order         = 1;
   opt->next_record_number = 0;
   opt->output_queue       = NULL;
+  opt->fc_pool            = NULL;
 }
 
 
@@ -617,6 +620,9 @@ main(int  argc,
    # process input files or handle input from stdin
    ################################################
    */
+  /* re-use fold compounds (and their DP matrices) of previous records */
+  opt.fc_pool = vrna_fold_compound_pool_init(FC_POOL_MAX_LENGTH);
+
   INIT_PARALLELIZATION(opt.jobs);
 
   if (num_input > 0) {
@@ -651,6 +657,8 @@ main(int  argc,
 
   UNINIT_PARALLELIZATION
 
+  vrna_fold_compound_pool_free(opt.fc_pool);
+
   /*
    ################################################
    # post processing
@@ -869,9 +877,10 @@ process_record(struct record_data *record)
     for (i = 0; i < n_seq; i++)
       mark_endgaps(alignment[i], '~');
 
-  vc = vrna_fold_compound_comparative((const char **)alignment,
-                                      &(opt->md),
-                                      VRNA_OPTION_DEFAULT);
+  vc = vrna_fold_compound_pool_acquire_comparative(opt->fc_pool,
+                                                   (const char **)alignment,
+                                                   &(opt->md),
+                                                   VRNA_OPTION_DEFAULT);
   n = vc->length;
 
   if (fold_constrained)
@@ -1112,7 +1121,7 @@ process_record(struct record_data *record)
   free(filename_dot);
   free(filename_aln);
   free(filename_out);
-  vrna_fold_compound_free(vc);
+  vrna_fold_compound_pool_release(opt->fc_pool, vc);
 
   vrna_aln_free(alignment);
 
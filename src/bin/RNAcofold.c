@@ -83,6 +83,8 @@ struct options {
   int             keep_order;
   unsigned int    next_record_number;
   vrna_ostream_t  output_queue;
+
+  vrna_fold_compound_pool_t *fc_pool;
 };
 
 
@@ -207,6 +209,7 @@ init_default_options(struct options *opt)
   opt->keep_order         = 1;
   opt->next_record_number = 0;
   opt->output_queue       = NULL;
+  opt->fc_pool            = NULL;
 }
 
 
@@ -468,6 +471,9 @@ main(int  argc,
    # process input files or handle input from stdin
    ################################################
    */
+  /* re-use fold compounds (and their DP matrices) of previous records */
+  opt.fc_pool = vrna_fold_compound_pool_init(FC_POOL_MAX_LENGTH);
+
   INIT_PARALLELIZATION(opt.jobs);
 
   if (num_input > 0) {
@@ -501,6 +507,8 @@ main(int  argc,
 
   UNINIT_PARALLELIZATION
 
+  vrna_fold_compound_pool_free(opt.fc_pool);
+
   /*
    ################################################
    # post processing
@@ -664,9 +672,10 @@ process_record(struct record_data *record)
   /* convert sequence to uppercase letters only */
   vrna_seq_toupper(sequence);
 
-  vrna_fold_compound_t *vc = vrna_fold_compound(sequence,
-                                                &(opt->md),
-                                                VRNA_OPTION_DEFAULT | VRNA_OPTION_HYBRID);
+  vrna_fold_compound_t *vc = vrna_fold_compound_pool_acquire(opt->fc_pool,
+                                                             sequence,
+                                                             &(opt->md),
+                                                             VRNA_OPTION_DEFAULT | VRNA_OPTION_HYBRID);
   n = vc->length;
 
   /* retrieve string stream bound to stdout, 6*length should be enough memory to start with */
@@ -1151,7 +1160,7 @@ cleanup_record:
     free(record->rest);
   }
 
-  vrna_fold_compound_free(vc);
+  vrna_fold_compound_pool_release(opt->fc_pool, vc);
 
   free(record);
 }
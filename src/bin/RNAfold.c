@@ -88,6 +88,8 @@ struct options {
   FILE            *output_stream;
   unsigned int    next_record_number;
   vrna_ostream_t  output_queue;
+
+  vrna_fold_compound_pool_t *fc_pool;
 };
 
 struct record_data {
@@ -390,6 +392,7 @@ init_default_options(struct options *opt)
   opt->output_stream      = NULL;
   opt->next_record_number = 0;
   opt->output_queue       = NULL;
+  opt->fc_pool            = NULL;
 }
 
 
@@ -565,6 +568,9 @@ main(int  argc,
    # process input files or handle input from stdin
    ################################################
    */
+  /* re-use fold compounds (and their DP matrices) of previous records */
+  opt.fc_pool = vrna_fold_compound_pool_init(FC_POOL_MAX_LENGTH);
+
   INIT_PARALLELIZATION(opt.jobs);
 
   if (num_input > 0) {
@@ -598,6 +604,8 @@ main(int  argc,
 
   UNINIT_PARALLELIZATION
 
+  vrna_fold_compound_pool_free(opt.fc_pool);
+
   /*
    ################################################
    # post processing
@@ -817,7 +825,10 @@ process_record(struct record_data *record)
   /* convert sequence to uppercase letters only */
   vrna_seq_toupper(rec_sequence);
 
-  vc = vrna_fold_compound(rec_sequence, &(opt->md), VRNA_OPTION_DEFAULT);
+  vc = vrna_fold_compound_pool_acquire(opt->fc_pool,
+                                       rec_sequence,
+                                       &(opt->md),
+                                       VRNA_OPTION_DEFAULT);
 
   length = vc->length;
 
@@ -1053,7 +1064,7 @@ process_record(struct record_data *record)
   }
 
   /* clean up */
-  vrna_fold_compound_free(vc);
+  vrna_fold_compound_pool_release(opt->fc_pool, vc);
   free(record->id);
   free(record->SEQ_ID);
   free(record->sequence);
@@ -17,6 +17,7 @@
 #include <string.h>
 #include <time.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include "ViennaRNA/params/default.h"
 #include "ViennaRNA/fold_vars.h"
@@ -33,6 +34,7 @@
 #include "ViennaRNA/plotting/alignments.h"
 #include "ViennaRNA/params/io.h"
 #include "ViennaRNA/io/utils.h"
+#include "ViennaRNA/io/accessibility.h"
 #include "RNAplex_cmdl.h"
 
 
@@ -60,14 +62,15 @@ EndTimer(clock_t begin)
 /* --------------------end include timer */
 extern int subopt_sorted;
 /* static int print_struc(duplexT const *dup); */
-static int **average_accessibility_target(char      **names,
-                                          char      **ALN,
-                                          int       number,
-                                          char      *access,
-                                          double    verhaeltnis,
-                                          const int alignment_length,
-                                          int       binaries,
-                                          int       fast);
+static int **average_accessibility_target(char              **names,
+                                          char              **ALN,
+                                          int               number,
+                                          char              *access,
+                                          vrna_acc_store_t  *acc_store,
+                                          double            verhaeltnis,
+                                          const int         alignment_length,
+                                          int               binaries,
+                                          int               fast);
 
 
 /* static int ** average_accessibility_query(char **names, char **ALN, int number, char *access, double verhaeltnis); */
@@ -95,6 +98,16 @@ static int **read_plfold_i_bin(char       *fname,
                                int        fast);
 
 
+/* Fetch opening energies from an accessibility store created by RNAplfold --store */
+static int **read_plfold_i_store(vrna_acc_store_t *store,
+                                 const char       *id,
+                                 const int        beg,
+                                 const int        end,
+                                 double           verhaeltnis,
+                                 const int        length,
+                                 int              fast);
+
+
 /* Compute and pass opening energies in case of f=2*/
 static int get_sequence_length_from_alignment(char *sequence);
 
@@ -172,6 +185,7 @@ main(int  argc,
   char                            *tname  = NULL;
   char                            *qname  = NULL;
   char                            *access = NULL;
+  vrna_acc_store_t                *acc_store = NULL;
   char                            fname[FILENAME_MAX_LENGTH];
   char                            *ParamFile  = NULL;
   char                            *ns_bases   = NULL, *c;
@@ -242,8 +256,16 @@ main(int  argc,
   /*fast_folding*/
   fast = args_info.fast_folding_arg;
   /*accessibility*/
-  if (args_info.accessibility_dir_given)
+  if (args_info.accessibility_dir_given) {
     access = strdup(args_info.accessibility_dir_arg);
+    /* a regular file instead of a directory is an accessibility store */
+    struct stat sb;
+    if ((stat(access, &sb) == 0) && (S_ISREG(sb.st_mode))) {
+      acc_store = vrna_acc_store_open(access);
+      if (acc_store == NULL)
+        vrna_message_error("%s is neither a directory nor an accessibility store", access);
+    }
+  }
 
   /*produce ps arg*/
   if (args_info.produce_ps_given) {
@@ -617,7 +639,10 @@ main(int  argc,
           strcat(file_s1, "/");
           strcat(file_s1, id_s1);
           strcat(file_s1, "_openen");
-          if (!binaries) {
+          if (acc_store) {
+            access_s1 = read_plfold_i_store(acc_store, id_s1, 1, s1_len, verhaeltnis, alignment_length, fast);
+            sprintf(file_s1, "%s:%s", access, id_s1);
+          } else if (!binaries) {
             access_s1 = read_plfold_i(file_s1, 1, s1_len, verhaeltnis, alignment_length, fast);
           } else {
             strcat(file_s1, "_bin");
@@ -691,7 +716,10 @@ main(int  argc,
             strcat(file_s2, "/");
             strcat(file_s2, id_s2);
             strcat(file_s2, "_openen");
-            if (!binaries) {
+            if (acc_store) {
+              access_s2 = read_plfold_i_store(acc_store, id_s2, 1, s2_len, verhaeltnis, alignment_length, fast);
+              sprintf(file_s2, "%s:%s", access, id_s2);
+            } else if (!binaries) {
               access_s2 = read_plfold_i(file_s2, 1, s2_len, verhaeltnis, alignment_length, fast);
             } else {
               strcat(file_s2, "_bin");
@@ -948,7 +976,10 @@ main(int  argc,
           strcat(file_s1, "/");
           strcat(file_s1, id_s1);
           strcat(file_s1, "_openen");
-          if (!binaries) {
+          if (acc_store) {
+            access_s1 = read_plfold_i_store(acc_store, id_s1, 1, s1_len, verhaeltnis, alignment_length, fast);
+            sprintf(file_s1, "%s:%s", access, id_s1);
+          } else if (!binaries) {
             access_s1 = read_plfold_i(file_s1, 1, s1_len, verhaeltnis, alignment_length, fast);
           } else {
             strcat(file_s1, "_bin");
@@ -1041,7 +1072,10 @@ main(int  argc,
             strcat(file_s2, "/");
             strcat(file_s2, id_s2);
             strcat(file_s2, "_openen");
-            if (!binaries) {
+            if (acc_store) {
+              access_s2 = read_plfold_i_store(acc_store, id_s2, 1, s2_len, verhaeltnis, alignment_length, fast);
+              sprintf(file_s2, "%s:%s", access, id_s2);
+            } else if (!binaries) {
               access_s2 = read_plfold_i(file_s2, 1, s2_len, verhaeltnis, alignment_length, fast);
             } else {
               strcat(file_s2, "_bin");
@@ -1383,7 +1417,10 @@ main(int  argc,
         strcat(file_s2, id_s2);
         strcat(file_s1, "_openen");
         strcat(file_s2, "_openen");
-        if (!binaries) {
+        if (acc_store) {
+          access_s1 = read_plfold_i_store(acc_store, id_s1, 1, s1_len, verhaeltnis, alignment_length, fast);
+          sprintf(file_s1, "%s:%s", access, id_s1);
+        } else if (!binaries) {
           access_s1 = read_plfold_i(file_s1, 1, s1_len, verhaeltnis, alignment_length, fast);
         } else {
           strcat(file_s1, "_bin");
@@ -1400,7 +1437,10 @@ main(int  argc,
           continue;
         }
 
-        if (!binaries) {
+        if (acc_store) {
+          access_s2 = read_plfold_i_store(acc_store, id_s2, 1, s2_len, verhaeltnis, alignment_length, fast);
+          sprintf(file_s2, "%s:%s", access, id_s2);
+        } else if (!binaries) {
           access_s2 = read_plfold_i(file_s2, 1, s2_len, verhaeltnis, alignment_length, fast);
         } else {
           strcat(file_s2, "_bin");
@@ -1514,8 +1554,8 @@ main(int  argc,
       aliLduplexfold((const char **)AS1, (const char **)AS2, n_seq * delta, extension_cost, alignment_length, deltaz, fast, il_a, il_b, b_a, b_b);
     } else {
       int **target_access = NULL, **query_access = NULL;
-      target_access = average_accessibility_target(names1, AS1, n_seq, access, verhaeltnis, alignment_length, binaries, fast); /* get averaged accessibility for alignments */
-      query_access  = average_accessibility_target(names2, AS2, n_seq, access, verhaeltnis, alignment_length, binaries, fast);
+      target_access = average_accessibility_target(names1, AS1, n_seq, access, acc_store, verhaeltnis, alignment_length, binaries, fast); /* get averaged accessibility for alignments */
+      query_access  = average_accessibility_target(names2, AS2, n_seq, access, acc_store, verhaeltnis, alignment_length, binaries, fast);
       if (!(target_access && query_access)) {
         for (i = 0; AS1[i]; i++) {
           free(AS1[i]);
@@ -1556,6 +1596,8 @@ main(int  argc,
     access = NULL;
   }
 
+  vrna_acc_store_close(acc_store);
+
   if (qname) {
     free(tname);
     access = NULL;
@@ -1813,6 +1855,64 @@ read_plfold_i_bin(char      *fname,
 }
 
 
+static int **
+read_plfold_i_store(vrna_acc_store_t  *store,
+                    const char        *id,
+                    const int         beg,
+                    const int         end,
+                    double            verhaeltnis,
+                    const int         length,
+                    int               fast)
+{
+  const vrna_acc_record_t *rec;
+  const float             *row;
+  int                     **access, i, u, pos, last, dim_x;
+
+  rec = vrna_acc_store_find(store, id);
+  if (rec == NULL) {
+    vrna_message_warning("No accessibility profile for %s in the accessibility store", id);
+    return NULL;
+  }
+
+  dim_x = (int)rec->max_u;
+  if (length > dim_x && fast == 0) {
+    printf("Interaction length %d is larger than the length of the largest region %d \nfor which the opening energy was computed (-u parameter of RNAplfold)\n", length, dim_x);
+    printf("Please recompute your profiles with a larger -u or set -l to a smaller interaction length\n");
+    return NULL;
+  }
+
+  if ((int)rec->length < end - 20) {
+    printf("Accessibility profile of %s contains %d less entries than expected based on the sequence length\n", id, end - 20 - (int)rec->length);
+    printf("Please recompute your profiles so that profile length and sequence length match\n");
+    return NULL;
+  }
+
+  /* same layout as read_plfold_i(), i.e. position beg is stored at index 11 */
+  access = (int **)vrna_alloc(sizeof(int *) * (dim_x + 2));
+  for (i = 0; i < dim_x + 2; i++) {
+    access[i] = (int *)vrna_alloc(sizeof(int) * (end - beg + 1));
+    for (pos = 0; pos < end - beg + 1; pos++)
+      access[i][pos] = INF;
+  }
+  access[0][0] = dim_x + 2;
+
+  /* the values are read directly from the mapped store, no parsing required */
+  last = MIN2(end - 11, (int)rec->length);
+  for (u = 1; u <= dim_x; u++) {
+    row = rec->energies + (size_t)(u - 1) * rec->length;
+    for (pos = beg; pos <= last; pos++) {
+      if (isnan(row[pos - 1]) || isinf(row[pos - 1]))
+        continue;
+
+      access[u][pos - beg + 11]   = (int)rint(100 * row[pos - 1]);
+      access[u][pos - beg + 11]  *= verhaeltnis;
+    }
+  }
+
+  return access;
+}
+
+
 static int
 get_max_u(const char  *s,
           char        delim)
@@ -1832,14 +1932,15 @@ get_max_u(const char  *s,
 
 
 static int **
-average_accessibility_target(char       **names,
-                             char       **ALN,
-                             int        number,
-                             char       *access,
-                             double     verhaeltnis,
-                             const int  alignment_length,
-                             int        binaries,
-                             int        fast)
+average_accessibility_target(char             **names,
+                             char             **ALN,
+                             int              number,
+                             char             *access,
+                             vrna_acc_store_t *acc_store,
+                             double           verhaeltnis,
+                             const int        alignment_length,
+                             int              binaries,
+                             int              fast)
 {
   int           i;
   int           ***master_access  = NULL;           /* contains the accessibility arrays for different */
@@ -1867,6 +1968,7 @@ average_accessibility_target(char       **names,
     location_flag = 0;
 
   char *file_s1 = NULL;
+  char *id      = NULL;
   for (i = 0; i < number; i++) {
     /*  be careful!!!! Name should contain all characters from begin till the "/" character */
     /* char *s1; */
@@ -1905,6 +2007,7 @@ average_accessibility_target(char       **names,
       }
 
       location_flag = 1;
+      id            = bla;
       strcpy(file_s1, access);
       strcat(file_s1, "/");
       strcat(file_s1, bla);
@@ -1917,13 +2020,16 @@ average_accessibility_target(char       **names,
       }
 
       location_flag = 0;
+      id            = names[i];
       strcpy(file_s1, access);
       strcat(file_s1, "/");
       strcat(file_s1, names[i]);
     }
 
     strcat(file_s1, "_openen");
-    if (!binaries) {
+    if (acc_store) {
+      master_access[i] = read_plfold_i_store(acc_store, id, begin, end, verhaeltnis, alignment_length, fast);
+    } else if (!binaries) {
       master_access[i] = read_plfold_i(file_s1, begin, end, verhaeltnis, alignment_length, fast); /* read */
     } else {
       strcat(file_s1, "_bin");
@@ -28,10 +28,13 @@
 #include "ViennaRNA/constraints/SHAPE.h"
 #include "ViennaRNA/io/file_formats.h"
 #include "ViennaRNA/io/utils.h"
+#include "ViennaRNA/io/accessibility.h"
+#include "ViennaRNA/datastructures/file_stream.h"
 #include "ViennaRNA/commands.h"
 #include "RNAplfold_cmdl.h"
 #include "gengetopt_helper.h"
 #include "input_id_helpers.h"
+#include "parallel_helpers.h"
 
 #include "ViennaRNA/color_output.inc"
 
@@ -72,20 +75,43 @@ isnan_ld(long double x)
 #endif /* ifndef isnan */
 
 typedef struct {
-  float     cutoff;
-  FILE      *pUfp;
-  FILE      *spup;
-  vrna_ep_t *plist;
-  int       plist_cnt;
-  int       plexoutput;
-  int       simply_putout;
-  int       openenergies;
-  double    **pup;
-  int       ulength;
-  int       n;
-  double    kT;
+  float           cutoff;
+  FILE            *pUfp;
+  FILE            *spup;
+  vrna_fstream_t  up_stream;
+  vrna_fstream_t  bpp_stream;
+  vrna_ep_t       *plist;
+  int             plist_cnt;
+  int             plexoutput;
+  int             simply_putout;
+  int             openenergies;
+  double          **pup;
+  int             ulength;
+  int             n;
+  double          kT;
 } plfold_data;
 
+/*
+ *  records of the output streams, pair probabilities and unpaired
+ *  probabilities of a single position i are followed by an array
+ *  of pairs (j, p) and an array of probabilities, respectively
+ */
+typedef struct {
+  int     j;
+  double  p;
+} bpp_entry;
+
+typedef struct {
+  int i;
+  int num;
+} bpp_record;
+
+typedef struct {
+  int i;
+  int size;
+  int ulength;
+} up_record;
+
 int unpaired;
 
 PRIVATE void
@@ -109,6 +135,20 @@ PRIVATE void
 prepare_up_file(plfold_data *data);
 
 
+PRIVATE void
+format_bpp(FILE       *fp,
+           const void *record,
+           size_t     size,
+           void       *data);
+
+
+PRIVATE void
+format_up(FILE        *fp,
+          const void  *record,
+          size_t      size,
+          void        *data);
+
+
 PRIVATE void
 print_up_open(FILE    *fp,
               int     i,
@@ -141,16 +181,17 @@ main(int  argc,
   struct RNAplfold_args_info  args_info;
   char                        *structure, *ParamFile, *ns_bases, *rec_sequence, *rec_id,
                               **rec_rest, *orig_sequence, *filename_delim, *command_file,
-                              *shape_file, *shape_method, *shape_conversion;
+                              *shape_file, *shape_method, *shape_conversion, *store_file;
   unsigned int                rec_type, read_opt;
   int                         length, istty, winsize, pairdist, tempwin, temppair, tempunpaired,
                               noconv, i, plexoutput, simply_putout, openenergies, binaries,
-                              filename_full, with_shapes, verbose;
+                              filename_full, with_shapes, verbose, jobs;
   float                       cutoff;
   vrna_exp_param_t            *pf_parameters;
   vrna_md_t                   md;
   vrna_cmd_t                  commands;
   dataset_id                  id_control;
+  vrna_acc_store_writer_t     *acc_store;
 
   pUfp          = NULL;
   dangles       = 2;
@@ -170,6 +211,9 @@ main(int  argc,
   command_file  = NULL;
   commands      = NULL;
   verbose       = 0;
+  jobs          = 1;
+  store_file    = NULL;
+  acc_store     = NULL;
 
   set_model_details(&md);
 
@@ -269,6 +313,30 @@ main(int  argc,
   if (args_info.binaries_given)
     binaries = 1;
 
+  /* collect accessibility profiles of all sequences in a single store */
+  if (args_info.store_given)
+    store_file = strdup(args_info.store_arg);
+
+  /* multithreaded scan of each sequence */
+  if (args_info.jobs_given) {
+    int thread_max = max_user_threads();
+    if (args_info.jobs_arg == 0) {
+      /* use maximum of concurrent threads */
+      int proc_cores, proc_cores_conf;
+      if (num_proc_cores(&proc_cores, &proc_cores_conf)) {
+        jobs = MIN2(thread_max, proc_cores_conf);
+      } else {
+        vrna_message_warning("Could not determine number of available processor cores!\n"
+                             "Defaulting to serial computation");
+        jobs = 1;
+      }
+    } else {
+      jobs = MIN2(thread_max, args_info.jobs_arg);
+    }
+
+    jobs = MAX2(1, jobs);
+  }
+
   /* check for errorneous parameter options */
   if ((pairdist < 0) || (cutoff < 0.) || (unpaired < 0) || (winsize < 0)) {
     RNAplfold_cmdline_parser_print_help();
@@ -313,9 +381,15 @@ main(int  argc,
     commands = vrna_file_commands_read(command_file, VRNA_CMD_PARSE_HC | VRNA_CMD_PARSE_SC);
 
   /* check parameter options again and reset to reasonable values if needed */
-  if (openenergies && !unpaired)
+  if ((openenergies || store_file) && !unpaired)
     unpaired = 31;
 
+  if (store_file) {
+    acc_store = vrna_acc_store_create(store_file);
+    if (!acc_store)
+      vrna_message_error("Failed to create accessibility store \"%s\"", store_file);
+  }
+
   if (pairdist == 0)
     pairdist = winsize;
 
@@ -399,6 +473,12 @@ main(int  argc,
       simply_putout = 0;
     }
 
+    if ((simply_putout) && (acc_store)) {
+      vrna_message_warning("accessibility store not available in simple output mode!\n"
+                           "Switching back to full mode instead!");
+      simply_putout = 0;
+    }
+
     /* restore winsize if altered before */
     if (tempwin != 0) {
       winsize = tempwin;
@@ -499,6 +579,8 @@ main(int  argc,
 
       data.cutoff         = cutoff;
       data.spup           = (simply_putout) ? fopen(fname2, "w") : NULL;
+      data.bpp_stream     = vrna_fstream_init(data.spup, 0, &format_bpp, NULL);
+      data.up_stream      = NULL;
       data.plexoutput     = plexoutput;
       data.simply_putout  = simply_putout;
       data.openenergies   = openenergies;
@@ -509,10 +591,16 @@ main(int  argc,
       data.kT             = pf_parameters->kT;
 
       if (unpaired > 0) {
-        if (simply_putout) {
-          data.pup  = NULL;
-          data.pUfp = fopen(openenergies ? fname4 : fname1, "w");
+        if ((simply_putout) ||
+            ((!plexoutput) && (!binaries) && (!acc_store))) {
+          /*
+           *  unpaired probabilities go to a text file only, so we
+           *  stream them to the file as soon as they are available
+           */
+          data.pup        = NULL;
+          data.pUfp       = fopen(openenergies ? fname4 : fname1, "w");
           prepare_up_file(&data);
+          data.up_stream  = vrna_fstream_init(data.pUfp, 0, &format_up, (void *)&data);
         } else {
           /* if we don't print on-the-fly we store unpaired probabilities for later */
           data.pup        = (double **)vrna_alloc(MAX2(unpaired, length + 1) * sizeof(double *));
@@ -535,7 +623,19 @@ main(int  argc,
         plfold_opt |= VRNA_PROBS_WINDOW_UP;
 
       /* perform recursions */
-      int r = vrna_probs_window(fc, unpaired, plfold_opt, &plfold_callback, (void *)&data);
+      int r = vrna_probs_window_parallel(fc,
+                                         unpaired,
+                                         plfold_opt,
+                                         &plfold_callback,
+                                         (void *)&data,
+                                         (unsigned int)jobs);
+
+      if ((data.bpp_stream) && (!vrna_fstream_free(data.bpp_stream)))
+        vrna_message_warning("Failed to write pair probabilities to \"%s\"", fname2);
+
+      if ((data.up_stream) && (!vrna_fstream_free(data.up_stream)))
+        vrna_message_warning("Failed to write unpaired probabilities to \"%s\"",
+                             openenergies ? fname4 : fname1);
 
       if (!r) {
         vrna_message_warning("Something bad happened while processing the input! "
@@ -547,8 +647,8 @@ main(int  argc,
         /* create dot plot output */
         PS_dot_plot_turn(orig_sequence, data.plist, ffname, pairdist);
 
-        /* print unpaired probabilities */
-        if (unpaired > 0) {
+        /* print unpaired probabilities that have not been streamed already */
+        if (data.pup) {
           if (plexoutput) {
             pUfp = fopen(fname3, "w");
             putoutphakim_u(fc, data.pup, length, unpaired, pUfp);
@@ -557,7 +657,15 @@ main(int  argc,
 
           /* print unpaired probabilities to file */
 
-          if (binaries) {
+          if (acc_store) {
+            if (!vrna_acc_store_add(acc_store,
+                                    SEQ_ID,
+                                    (unsigned int)length,
+                                    (unsigned int)unpaired,
+                                    data.kT / 1000.,
+                                    data.pup))
+              vrna_message_error("Failed to write accessibility profile to \"%s\"", store_file);
+          } else if (binaries) {
             data.pUfp = fopen(fname1, "w");
             print_pu_bin(fc, &data, unpaired);
           } else {
@@ -577,8 +685,10 @@ main(int  argc,
             }
           }
 
-          fclose(data.pUfp);
-          data.pUfp = NULL;
+          if (data.pUfp) {
+            fclose(data.pUfp);
+            data.pUfp = NULL;
+          }
 
           for (i = 0; i <= length; i++)
             free(data.pup[i]);
@@ -629,7 +739,11 @@ main(int  argc,
 
 rnaplfold_exit:
 
+  if ((acc_store) && (!vrna_acc_store_finish(acc_store)))
+    vrna_message_warning("Failed to finish accessibility store \"%s\"", store_file);
+
   free(filename_delim);
+  free(store_file);
   free(command_file);
   free(shape_method);
   free(shape_conversion);
@@ -747,17 +861,44 @@ plfold_callback(FLT_OR_DBL    *pr,
       d->plist[d->plist_cnt].j    = 0;
       d->plist[d->plist_cnt].p    = 0.;
       d->plist[d->plist_cnt].type = VRNA_PLIST_TYPE_BASEPAIR;
-    } else {
-      /* print pair probabilities to output file handle */
+    } else if (d->bpp_stream) {
+      /* pass pair probabilities to the output stream */
+      bpp_record  *rec;
+      bpp_entry   *entries;
+
+      rec       = (bpp_record *)vrna_fstream_reserve(d->bpp_stream,
+                                                    sizeof(bpp_record) +
+                                                    sizeof(bpp_entry) * MAX2(pr_size - i, 0));
+      entries   = (bpp_entry *)(rec + 1);
+      rec->i    = i;
+      rec->num  = 0;
+
       for (cnt = i + 1; cnt <= pr_size; cnt++)
-        if (pr[cnt] >= d->cutoff)
-          fprintf(d->spup, "%d  %d  %g\n", i, cnt, pr[cnt]);
+        if (pr[cnt] >= d->cutoff) {
+          entries[rec->num].j   = cnt;
+          entries[rec->num++].p = pr[cnt];
+        }
+
+      vrna_fstream_commit(d->bpp_stream,
+                          sizeof(bpp_record) + sizeof(bpp_entry) * rec->num);
     }
   }
 
   /* limit output to full unpaired probabilities */
   if ((type & VRNA_PROBS_WINDOW_UP) && ((type & VRNA_ANY_LOOP) == VRNA_ANY_LOOP)) {
-    if (!d->simply_putout) {
+    if (d->up_stream) {
+      /* pass unpaired probabilities to the output stream */
+      up_record *rec;
+
+      rec = (up_record *)vrna_fstream_reserve(d->up_stream,
+                                              sizeof(up_record) + sizeof(double) * pr_size);
+      rec->i        = i;
+      rec->size     = pr_size;
+      rec->ulength  = max;
+      memcpy(rec + 1, pr + 1, sizeof(double) * pr_size);
+
+      vrna_fstream_commit(d->up_stream, sizeof(up_record) + sizeof(double) * pr_size);
+    } else if (d->pup) {
       /* store unpaired probabilities in an array */
 
       /* first allocate some memory */
@@ -768,17 +909,52 @@ plfold_callback(FLT_OR_DBL    *pr,
         d->pup[i][cnt] = pr[cnt];
       for (cnt = pr_size + 1; cnt <= max; cnt++)
         d->pup[i][cnt] = 0.;
-    } else {
-      /* print unpaired probabilities to output file handle */
-      if (d->openenergies)
-        print_up_open(d->pUfp, i, pr, pr_size, max, d->kT / 1000.);
-      else
-        print_up(d->pUfp, i, pr, pr_size, max);
     }
   }
 }
 
 
+/* executed by the writer thread of the output stream */
+PRIVATE void
+format_bpp(FILE       *fp,
+           const void *record,
+           size_t     size,
+           void       *data)
+{
+  int               k;
+  const bpp_record  *rec;
+  const bpp_entry   *entries;
+
+  rec     = (const bpp_record *)record;
+  entries = (const bpp_entry *)(rec + 1);
+
+  for (k = 0; k < rec->num; k++)
+    fprintf(fp, "%d  %d  %g\n", rec->i, entries[k].j, entries[k].p);
+}
+
+
+/* executed by the writer thread of the output stream */
+PRIVATE void
+format_up(FILE        *fp,
+          const void  *record,
+          size_t      size,
+          void        *data)
+{
+  const up_record *rec;
+  plfold_data     *d;
+  double          *pr;
+
+  rec = (const up_record *)record;
+  d   = (plfold_data *)data;
+  pr  = (double *)(rec + 1) - 1; /* 1-based */
+
+  if (d->openenergies)
+    print_up_open(fp, rec->i, pr, rec->size, rec->ulength, d->kT / 1000.);
+  else
+    print_up(fp, rec->i, pr, rec->size, rec->ulength);
+}
+
+
 PRIVATE void
 print_up_open(FILE    *fp,
               int     i,
@@ -25,6 +25,7 @@
 #include "ViennaRNA/utils/strings.h"
 #include "ViennaRNA/params/io.h"
 #include "ViennaRNA/subopt.h"
+#include "ViennaRNA/boltzmann_sampling.h"
 #include "ViennaRNA/params/basic.h"
 #include "ViennaRNA/constraints/basic.h"
 #include "ViennaRNA/constraints/SHAPE.h"
@@ -33,13 +34,27 @@
 #include "RNAsubopt_cmdl.h"
 #include "gengetopt_helper.h"
 #include "input_id_helpers.h"
+#include "parallel_helpers.h"
 
 #include "ViennaRNA/color_output.inc"
 
+typedef struct {
+  FILE                  *output;
+  vrna_fold_compound_t  *fc;
+  int                   st_back_en;
+  double                ens_en;
+  double                kT;
+} sample_output;
+
+
 PRIVATE void putoutzuker(FILE                   *output,
                          vrna_subopt_solution_t *zukersolution);
 
 
+PRIVATE void print_sample(const char  *structure,
+                          void        *data);
+
+
 int
 main(int  argc,
      char *argv[])
@@ -50,10 +65,10 @@ main(int  argc,
                                       **rec_rest, *orig_sequence, *constraints_file, *cstruc,
                                       *structure, *shape_file, *shape_method, *shape_conversion,
                                       *infile, *outfile, *filename_delim;
-  unsigned int                        rec_type, read_opt;
+  unsigned int                        rec_type, read_opt, sampling_options;
   int                                 i, length, cl, istty, delta, n_back, noconv, dos, zuker,
                                       with_shapes, verbose, enforceConstraints, st_back_en, batch,
-                                      tofile, filename_full, canonicalBPonly;
+                                      tofile, filename_full, canonicalBPonly, jobs;
   double                              deltap;
   vrna_md_t                           md;
   dataset_id                          id_control;
@@ -73,6 +88,9 @@ main(int  argc,
   tofile          = 0;
   filename_full   = 0;
   canonicalBPonly = 0;
+  jobs            = 1;
+
+  sampling_options = VRNA_PBACKTRACK_DEFAULT;
 
   set_model_details(&md);
 
@@ -134,6 +152,26 @@ main(int  argc,
   if (args_info.sorted_given)
     subopt_sorted = 1;
 
+  /* multithreaded enumeration */
+  if (args_info.jobs_given) {
+    int thread_max = max_user_threads();
+    if (args_info.jobs_arg == 0) {
+      /* use maximum of concurrent threads */
+      int proc_cores, proc_cores_conf;
+      if (num_proc_cores(&proc_cores, &proc_cores_conf)) {
+        jobs = MIN2(thread_max, proc_cores_conf);
+      } else {
+        vrna_message_warning("Could not determine number of available processor cores!\n"
+                             "Defaulting to serial computation");
+        jobs = 1;
+      }
+    } else {
+      jobs = MIN2(thread_max, args_info.jobs_arg);
+    }
+
+    jobs = MAX2(1, jobs);
+  }
+
   /* stochastic backtracking */
   if (args_info.stochBT_given) {
     n_back = args_info.stochBT_arg;
@@ -148,6 +186,14 @@ main(int  argc,
     vrna_init_rand();
   }
 
+  /* non-redundant stochastic backtracking */
+  if (args_info.nonRedundant_given) {
+    if (n_back > 0)
+      sampling_options |= VRNA_PBACKTRACK_NON_REDUNDANT;
+    else
+      vrna_message_warning("Option --nonRedundant requires stochastic backtracking (-p), ignoring it!");
+  }
+
   /* density of states */
   if (args_info.dos_given) {
     dos           = 1;
@@ -395,7 +441,8 @@ main(int  argc,
 
     /* stochastic backtracking */
     if (n_back > 0) {
-      double mfe, kT, ens_en;
+      double        mfe, kT, ens_en;
+      sample_output so;
 
       if (vc->cutpoint != -1)
         vrna_message_error("Boltzmann sampling for cofolded structures not implemented (yet)!");
@@ -411,20 +458,13 @@ main(int  argc,
       ens_en  = vrna_pf(vc, structure);
       kT      = vc->exp_params->kT / 1000.;
 
-      for (i = 0; i < n_back; i++) {
-        char *s, *e_string = NULL;
-        s = vrna_pbacktrack(vc);
-        if (st_back_en) {
-          double e, prob;
-          e         = vrna_eval_structure(vc, s);
-          prob      = exp((ens_en - e) / kT);
-          e_string  = vrna_strdup_printf(" %6.2f %6g", e, prob);
-        }
+      so.output     = output;
+      so.fc         = vc;
+      so.st_back_en = st_back_en;
+      so.ens_en     = ens_en;
+      so.kT         = kT;
 
-        print_structure(output, s, e_string);
-        free(s);
-        free(e_string);
-      }
+      vrna_pbacktrack_cb(vc, n_back, &print_sample, (void *)&so, sampling_options);
     }
     /* normal subopt */
     else if (!zuker) {
@@ -435,7 +475,23 @@ main(int  argc,
         free(head);
       }
 
-      vrna_subopt(vc, delta, subopt_sorted, output);
+      vrna_subopt_parallel(vc, delta, subopt_sorted, output, (unsigned int)jobs);
+
+      if (verbose) {
+        vrna_subopt_stats_t stats;
+        vrna_subopt_stats(&stats);
+        vrna_message_info(stderr,
+                          "subopt: %lu states, %lu intervals, %lu structure elements, "
+                          "%lu allocations, max. stack depth %lu, peak memory %.1f kB, "
+                          "%lu sorted runs on disk",
+                          stats.states,
+                          stats.intervals,
+                          stats.elements,
+                          stats.allocations,
+                          stats.max_stack,
+                          (double)stats.peak_memory / 1024.,
+                          stats.runs);
+      }
 
       if (dos) {
         int i;
@@ -544,3 +600,22 @@ putoutzuker(FILE                    *output,
   }
   return;
 }
+
+
+PRIVATE void
+print_sample(const char *structure,
+             void       *data)
+{
+  char          *e_string = NULL;
+  sample_output *so       = (sample_output *)data;
+
+  if (so->st_back_en) {
+    double e, prob;
+    e         = vrna_eval_structure(so->fc, structure);
+    prob      = exp((so->ens_en - e) / so->kT);
+    e_string  = vrna_strdup_printf(" %6.2f %6g", e, prob);
+  }
+
+  print_structure(so->output, structure, e_string);
+  free(e_string);
+}
@@ -30,6 +30,7 @@
 #include "ViennaRNA/duplex.h"
 #include "ViennaRNA/params/constants.h"
 #include "ViennaRNA/io/file_formats.h"
+#include "ViennaRNA/io/accessibility.h"
 #include "ViennaRNA/constraints/basic.h"
 #include "ViennaRNA/constraints/hard.h"
 #include "ViennaRNA/constraints/soft.h"
@@ -60,6 +61,12 @@ PRIVATE void    print_interaction(interact    *Int,
                                   int         incr5);
 
 
+PRIVATE pu_contrib *read_unstru_store(vrna_acc_store_t *store,
+                                      const char        *id,
+                                      int               length,
+                                      int               w);
+
+
 PRIVATE void    print_unstru(pu_contrib *p_c,
                              int        w);
 
@@ -98,6 +105,7 @@ main(int  argc,
   /* variables for output */
   pu_contrib              *unstr_out, *unstr_short, *unstr_target, *contrib1, *contrib2;
   interact                *inter_out;
+  vrna_acc_store_t        *acc_store;
   /* pu_out *longer; */
 
   /* commandline parameters */
@@ -128,6 +136,7 @@ main(int  argc,
   unstr_out       = unstr_short = unstr_target = contrib1 = contrib2 = NULL;
   structure       = ParamFile = ns_bases = head = orig_s1 = orig_s2 = orig_target = NULL;
   up_out          = NULL;
+  acc_store       = NULL;
   fname_target[0] = '\0';
   /* allocate init length for commandline parameter string */
 
@@ -289,6 +298,16 @@ main(int  argc,
       vrna_strcat_printf(&cmdl_parameters, "-c %s ", my_contrib);
   }
 
+  /* read probabilities of being unpaired from an accessibility store */
+  if (args_info.store_given) {
+    acc_store = vrna_acc_store_open(args_info.store_arg);
+    if (!acc_store)
+      vrna_message_error("Can't read accessibility store %s", args_info.store_arg);
+
+    if (header)
+      vrna_strcat_printf(&cmdl_parameters, "--store %s ", args_info.store_arg);
+  }
+
   /* set length(s) of unpaired (unstructured) region(s) */
   int min, max, tmp;
   i = (args_info.ulength_given == 0) ? 1 : args_info.ulength_given;
@@ -692,21 +711,25 @@ main(int  argc,
     if (length1 < wplus)
       wplus = length1;
 
-    /* calc mfe for first sequence (2nd if upmode = 3) */
-    if (cstruc1 != NULL)
-      strncpy(structure, cstruc1, length1 + 1);
+    if (acc_store) {
+      unstr_out = read_unstru_store(acc_store, fname1, length1, wplus);
+    } else {
+      /* calc mfe for first sequence (2nd if upmode = 3) */
+      if (cstruc1 != NULL)
+        strncpy(structure, cstruc1, length1 + 1);
 
-    min_en    = fold(s1, structure);
-    pf_scale  = exp(-(sfact * min_en) / RT / length1);
-    if (length1 > 2000)
-      vrna_message_info(stderr, "scaling factor %f", pf_scale);
+      min_en    = fold(s1, structure);
+      pf_scale  = exp(-(sfact * min_en) / RT / length1);
+      if (length1 > 2000)
+        vrna_message_info(stderr, "scaling factor %f", pf_scale);
 
-    if (cstruc1 != NULL)
-      strncpy(structure, cstruc1, length1 + 1);
+      if (cstruc1 != NULL)
+        strncpy(structure, cstruc1, length1 + 1);
 
-    (void) pf_fold(s1, structure);
-    unstr_out = pf_unstru(s1, wplus);
-    free_pf_arrays();
+      (void) pf_fold(s1, structure);
+      unstr_out = pf_unstru(s1, wplus);
+      free_pf_arrays();
+    }
 
     if (fold_constrained && !(up_mode & RNA_UP_MODE_1)) {
       cstruc_combined = (char *)vrna_alloc(sizeof(char) * (length1 + length2 + 1));
@@ -747,20 +770,24 @@ main(int  argc,
           if (length_target < wplus)
             wplus = length_target;
 
-          if (cstruc_target != NULL)
-            strncpy(structure, cstruc_target, length_target + 1);
+          if (acc_store) {
+            unstr_target = read_unstru_store(acc_store, fname_target, length_target, wplus);
+          } else {
+            if (cstruc_target != NULL)
+              strncpy(structure, cstruc_target, length_target + 1);
 
-          min_en    = fold(s_target, structure);
-          pf_scale  = exp(-(sfact * min_en) / RT / length_target);
-          if (length_target > 2000)
-            vrna_message_info(stderr, "scaling factor %f", pf_scale);
+            min_en    = fold(s_target, structure);
+            pf_scale  = exp(-(sfact * min_en) / RT / length_target);
+            if (length_target > 2000)
+              vrna_message_info(stderr, "scaling factor %f", pf_scale);
 
-          if (cstruc_target != NULL)
-            strncpy(structure, cstruc_target, length_target + 1);
+            if (cstruc_target != NULL)
+              strncpy(structure, cstruc_target, length_target + 1);
 
-          (void) pf_fold(s_target, structure);
-          unstr_target  = pf_unstru(s_target, wplus);
-          free_pf_arrays();                     /* for arrays for pf_fold(...) */
+            (void) pf_fold(s_target, structure);
+            unstr_target  = pf_unstru(s_target, wplus);
+            free_pf_arrays();                     /* for arrays for pf_fold(...) */
+          }
         }
 
         /* check if target sequence is actually longer than query, if not rotate both sequences */
@@ -837,6 +864,7 @@ main(int  argc,
     free_arrays(); /* for arrays for fold(...) */
   } while (1);
   free(cmdl_parameters);
+  vrna_acc_store_close(acc_store);
 
   return EXIT_SUCCESS;
 }
@@ -1219,6 +1247,55 @@ print_interaction(interact    *Int,
 }
 
 
+/*
+ * take the probabilities of being unpaired from an accessibility store. The store
+ * only provides the total probabilities, so we put them into the exterior loop
+ * contributions and leave all others at zero
+ */
+PRIVATE pu_contrib *
+read_unstru_store(vrna_acc_store_t  *store,
+                  const char        *id,
+                  int               length,
+                  int               w)
+{
+  int                     i, d;
+  double                  p;
+  pu_contrib              *pu;
+  const vrna_acc_record_t *record;
+
+  if (id[0] == '\0')
+    vrna_message_error("Sequences require a FASTA header to look up their accessibility profiles");
+
+  record = vrna_acc_store_find(store, id);
+  if (!record)
+    vrna_message_error("No accessibility profile for %s in the accessibility store", id);
+
+  if ((int)record->length != length)
+    vrna_message_error("Accessibility profile of %s has length %u, but the sequence has length %d",
+                       id,
+                       record->length,
+                       length);
+
+  if ((int)record->max_u < w)
+    vrna_message_error("Accessibility profile of %s only covers unpaired regions up to %u nt, but %d nt are required",
+                       id,
+                       record->max_u,
+                       w);
+
+  pu = get_pu_contrib_struct((unsigned int)length, (unsigned int)w);
+
+  /* pu->X[i][d] refers to the unpaired region [i, i + d] */
+  for (i = 1; i <= length; i++)
+    for (d = 0; (d < w) && (i + d <= length); d++) {
+      p = vrna_acc_record_probability(record, i + d, d + 1);
+      if (!isnan(p))
+        pu->E[i][d] = p;
+    }
+
+  return pu;
+}
+
+
 /* print coordinates and free energy for the region of highest accessibility */
 PRIVATE void
 print_unstru(pu_contrib *p_c,
@@ -7,6 +7,10 @@
  *
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -18,6 +22,55 @@
 #include <string.h>
 #include <errno.h>
 
+#include "ViennaRNA/utils/basic.h"
+
+#include "parallel_helpers.h"
+
+#if VRNA_WITH_PTHREADS
+
+/* maximum number of records a worker thread takes from the queue at once */
+#define WORK_QUEUE_MAX_BATCH  16
+
+struct work_item {
+  void  (*fun)(void *);
+  void  *data;
+};
+
+/*
+ *  A bounded ring buffer of work items that is shared by the reading
+ *  (main) thread and the worker threads. Both sides block on condition
+ *  variables instead of polling.
+ */
+struct work_queue {
+  struct work_item  *items;
+  unsigned int      capacity;
+  unsigned int      first;        /* position of the oldest item */
+  unsigned int      num;          /* number of items in the queue */
+  unsigned int      busy;         /* number of workers that currently process items */
+  int               shutdown;
+
+  pthread_mutex_t   mtx;
+  pthread_cond_t    not_empty;    /* signalled when items were added, or on shutdown */
+  pthread_cond_t    not_full;     /* signalled when items were removed */
+  pthread_cond_t    idle;         /* signalled when a worker ran out of work */
+
+  unsigned int      num_threads;
+  pthread_t         *threads;
+};
+
+
+pthread_mutex_t   output_mutex;
+pthread_mutex_t   output_file_mutex;
+unsigned int      max_threads;
+struct work_queue *worker_pool;
+
+
+static void *
+work_queue_worker(void *arg);
+
+
+#endif
+
 
 int
 num_proc_cores(int  *num_cores,
@@ -134,3 +187,179 @@ max_user_threads(void)
 
   return threadm;
 }
+
+
+#if VRNA_WITH_PTHREADS
+
+struct work_queue *
+work_queue_init(unsigned int  num_threads,
+                unsigned int  capacity)
+{
+  unsigned int      i;
+  struct work_queue *queue;
+
+  queue = (struct work_queue *)vrna_alloc(sizeof(struct work_queue));
+
+  queue->capacity     = (capacity > 0) ? capacity : 1;
+  queue->items        = (struct work_item *)vrna_alloc(sizeof(struct work_item) * queue->capacity);
+  queue->first        = 0;
+  queue->num          = 0;
+  queue->busy         = 0;
+  queue->shutdown     = 0;
+  queue->num_threads  = 0;
+  queue->threads      = (pthread_t *)vrna_alloc(sizeof(pthread_t) * num_threads);
+
+  pthread_mutex_init(&(queue->mtx), NULL);
+  pthread_cond_init(&(queue->not_empty), NULL);
+  pthread_cond_init(&(queue->not_full), NULL);
+  pthread_cond_init(&(queue->idle), NULL);
+
+  for (i = 0; i < num_threads; i++) {
+    if (pthread_create(&(queue->threads[queue->num_threads]), NULL, &work_queue_worker, queue))
+      break;
+
+    queue->num_threads++;
+  }
+
+  if (queue->num_threads == 0)
+    vrna_message_error("Failed to create worker threads");
+
+  return queue;
+}
+
+
+void
+work_queue_add(struct work_queue  *queue,
+               void (*fun)(void *),
+               void               *data)
+{
+  unsigned int pos;
+
+  pthread_mutex_lock(&(queue->mtx));
+
+  while (queue->num == queue->capacity)
+    pthread_cond_wait(&(queue->not_full), &(queue->mtx));
+
+  pos                     = (queue->first + queue->num) % queue->capacity;
+  queue->items[pos].fun   = fun;
+  queue->items[pos].data  = data;
+  queue->num++;
+
+  pthread_cond_signal(&(queue->not_empty));
+  pthread_mutex_unlock(&(queue->mtx));
+}
+
+
+void
+work_queue_wait_slots(struct work_queue *queue,
+                      unsigned int      max_pending)
+{
+  pthread_mutex_lock(&(queue->mtx));
+
+  /* only count items that still wait in the queue, not those being processed */
+  while (queue->num >= MAX2(max_pending, 1))
+    pthread_cond_wait(&(queue->not_full), &(queue->mtx));
+
+  pthread_mutex_unlock(&(queue->mtx));
+}
+
+
+void
+work_queue_wait(struct work_queue *queue)
+{
+  pthread_mutex_lock(&(queue->mtx));
+
+  while ((queue->num > 0) || (queue->busy > 0))
+    pthread_cond_wait(&(queue->idle), &(queue->mtx));
+
+  pthread_mutex_unlock(&(queue->mtx));
+}
+
+
+void
+work_queue_free(struct work_queue *queue)
+{
+  unsigned int i;
+
+  if (queue) {
+    /* workers process all remaining items before they terminate */
+    pthread_mutex_lock(&(queue->mtx));
+    queue->shutdown = 1;
+    pthread_cond_broadcast(&(queue->not_empty));
+    pthread_mutex_unlock(&(queue->mtx));
+
+    for (i = 0; i < queue->num_threads; i++)
+      pthread_join(queue->threads[i], NULL);
+
+    pthread_mutex_destroy(&(queue->mtx));
+    pthread_cond_destroy(&(queue->not_empty));
+    pthread_cond_destroy(&(queue->not_full));
+    pthread_cond_destroy(&(queue->idle));
+
+    free(queue->threads);
+    free(queue->items);
+    free(queue);
+  }
+}
+
+
+static void *
+work_queue_worker(void *arg)
+{
+  unsigned int      i, n;
+  struct work_queue *queue;
+  struct work_item  batch[WORK_QUEUE_MAX_BATCH];
+
+  queue = (struct work_queue *)arg;
+
+  pthread_mutex_lock(&(queue->mtx));
+
+  while (1) {
+    while ((queue->num == 0) && (!queue->shutdown))
+      pthread_cond_wait(&(queue->not_empty), &(queue->mtx));
+
+    if (queue->num == 0)
+      break; /* shutdown and nothing left to do */
+
+    /*
+     *  take several items at once if there is enough work for all
+     *  workers, such that short records do not contend for the lock
+     */
+    n = queue->num / queue->num_threads;
+    n = MAX2(n, 1);
+    n = MIN2(n, WORK_QUEUE_MAX_BATCH);
+
+    for (i = 0; i < n; i++) {
+      batch[i] = queue->items[queue->first];
+      queue->first = (queue->first + 1) % queue->capacity;
+    }
+
+    queue->num  -= n;
+    queue->busy += 1;
+
+    /* wake up the reader as well as the other workers if work remains */
+    pthread_cond_broadcast(&(queue->not_full));
+    if (queue->num > 0)
+      pthread_cond_signal(&(queue->not_empty));
+
+    pthread_mutex_unlock(&(queue->mtx));
+
+    for (i = 0; i < n; i++)
+      batch[i].fun(batch[i].data);
+
+    pthread_mutex_lock(&(queue->mtx));
+
+    queue->busy -= 1;
+
+    pthread_cond_broadcast(&(queue->not_full));
+    if ((queue->num == 0) && (queue->busy == 0))
+      pthread_cond_broadcast(&(queue->idle));
+  }
+
+  pthread_mutex_unlock(&(queue->mtx));
+
+  return NULL;
+}
+
+
+#endif
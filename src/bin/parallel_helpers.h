@@ -1,15 +1,20 @@
 #ifndef VRNA_PARALLELIZATION_HELPERS
 #define VRNA_PARALLELIZATION_HELPERS
 
+/* largest sequence length for which fold compounds of previous records are re-used */
+#define FC_POOL_MAX_LENGTH  2000
+
 #if VRNA_WITH_PTHREADS
 
 #include <pthread.h>
-#include "thpool.h"
 
-pthread_mutex_t output_mutex;
-pthread_mutex_t output_file_mutex;
-unsigned int    max_threads;
-threadpool      worker_pool;
+/* maximum number of records waiting for a free worker thread, per thread */
+#define WORK_QUEUE_SLOTS_PER_THREAD 64
+
+extern pthread_mutex_t    output_mutex;
+extern pthread_mutex_t    output_file_mutex;
+extern unsigned int       max_threads;
+extern struct work_queue  *worker_pool;
 
 #define ATOMIC_BLOCK(a) { \
     if (max_threads > 1) { \
@@ -43,35 +48,61 @@ threadpool      worker_pool;
 
 #define INIT_PARALLELIZATION(a) { \
     max_threads = ((a) > 1) ? (unsigned int)(a) : 1; \
-    /* initialize semaphores and thread pool */ \
+    /* initialize semaphores and worker threads */ \
     if (max_threads > 1) { \
       pthread_mutex_init(&output_mutex, NULL); \
       pthread_mutex_init(&output_file_mutex, NULL); \
-      worker_pool = thpool_init(max_threads); \
+      worker_pool = work_queue_init(max_threads, \
+                                    WORK_QUEUE_SLOTS_PER_THREAD * max_threads); \
     } \
 }
 
 #define UNINIT_PARALLELIZATION  { \
-    if (max_threads > 1) \
-      thpool_wait(worker_pool); \
-    pthread_mutex_destroy(&output_mutex); \
-    pthread_mutex_destroy(&output_file_mutex); \
-    if (max_threads > 1) \
-      thpool_destroy(worker_pool); \
+    if (max_threads > 1) { \
+      work_queue_free(worker_pool); \
+      pthread_mutex_destroy(&output_mutex); \
+      pthread_mutex_destroy(&output_file_mutex); \
+    } \
 }
 
+/* blocks while the work queue is full */
 #define RUN_IN_PARALLEL(fun, data)  { \
-    if (max_threads > 1) { thpool_add_work(worker_pool, (void *)&fun, (void *)data); } \
+    if (max_threads > 1) { work_queue_add(worker_pool, (void (*)(void *))&fun, (void *)data); } \
     else { fun(data); } \
 }
 
+/* blocks while at least a records wait in the queue for a worker thread */
 #define WAIT_FOR_FREE_SLOT(a) { \
-    if (max_threads > 1) { \
-      while (thpool_num_threads_working(worker_pool) == (a)) \
-        sleep(1); \
-    } \
+    if (max_threads > 1) \
+      work_queue_wait_slots(worker_pool, (a)); \
 }
 
+
+struct work_queue *
+work_queue_init(unsigned int  num_threads,
+                unsigned int  capacity);
+
+
+void
+work_queue_add(struct work_queue  *queue,
+               void (*fun)(void *),
+               void               *data);
+
+
+/* block until less than max_pending items are queued, items being processed do not count */
+void
+work_queue_wait_slots(struct work_queue *queue,
+                      unsigned int      max_pending);
+
+
+void
+work_queue_wait(struct work_queue *queue);
+
+
+void
+work_queue_free(struct work_queue *queue);
+
+
 #else
 
 #define ATOMIC_BLOCK(a)             { (a); }
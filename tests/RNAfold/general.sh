@@ -66,7 +66,17 @@ do
   if [ "x${diff}" != "x" ] ; then failed; echo -e "$diff"; else passed; fi
 done
 
+# Test parallel processing of input records
+RNAfold --noPS -j1 < ${DATADIR}/rnafold.small.seq > rnafold.fold
+for jobs in 2 4 8
+do
+  testline "MFE prediction (RNAfold -j${jobs})"
+  RNAfold --noPS -j${jobs} < ${DATADIR}/rnafold.small.seq > rnafold_jobs.fold
+  diff=$(${DIFF} rnafold.fold rnafold_jobs.fold)
+  if [ "x${diff}" != "x" ] ; then failed; echo -e "$diff"; else passed; fi
+done
+
 # clean up
-rm rnafold.fold
+rm rnafold.fold rnafold_jobs.fold
 
 exit ${RETURN}
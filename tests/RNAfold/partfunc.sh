@@ -38,6 +38,13 @@ do
 done
 if [ "x${diff}" != "x" ] ; then failed; echo -e "$diff"; else passed; fi
 
+testline "Partition function (RNAfold -j4)"
+RNAfold --noPS -p --MEA -j4 --auto-id --id-prefix="rnafold_pf_jobs" < ${DATADIR}/rnafold.small.seq > rnafold_pf.fold
+RNAfold --noPS -p --MEA -j1 --auto-id --id-prefix="rnafold_pf_jobs" < ${DATADIR}/rnafold.small.seq > rnafold_pf_j1.fold
+diff=$(${DIFF} -I frequency rnafold_pf_j1.fold rnafold_pf.fold)
+if [ "x${diff}" != "x" ] ; then failed; echo -e "$diff"; else passed; fi
+rm rnafold_pf_j1.fold rnafold_pf_jobs_*dp.ps
+
 # clean up
 rm rnafold_pf.fold dot.ps
 rm rnafold_pf_test_00*dp.ps rnafold_pf_test_00*dp2.ps
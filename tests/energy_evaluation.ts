@@ -208,3 +208,50 @@
   ck_assert_int_eq(E_IntLoop(3, 5, 1, 2, 1, 2, 3, 4, &param), 235);
   ck_assert_int_eq(E_IntLoop(5, 3, 1, 2, 1, 2, 3, 4, &param), 235);
 }
+
+/*
+ * check that shared energy parameters are re-used and match freshly computed ones
+ */
+
+#test eval_params_shared
+{
+  vrna_md_t               md;
+  vrna_param_t            *P;
+  vrna_exp_param_t        *exp_P;
+  const vrna_param_t      *shared, *shared2;
+  const vrna_exp_param_t  *exp_shared;
+
+  vrna_md_set_default(&md);
+  md.temperature  = 42.;
+  md.dangles      = 0;
+
+  shared = vrna_params_shared(&md);
+
+  /* sequence dependent attributes must not lead to another parameter set */
+  md.window_size  = 120;
+  md.max_bp_span  = 100;
+  shared2         = vrna_params_shared(&md);
+  ck_assert(shared == shared2);
+
+  P = vrna_params(&md);
+  ck_assert_int_eq(P->model_details.window_size, 120);
+  ck_assert_int_eq(P->stack[1][1], shared->stack[1][1]);
+  ck_assert_int_eq(P->hairpin[5], shared->hairpin[5]);
+  ck_assert(P != shared);
+
+  vrna_params_shared_free(shared2);
+  vrna_params_shared_free(shared);
+  free(P);
+
+  exp_shared  = vrna_exp_params_shared(&md);
+  exp_P       = vrna_exp_params(&md);
+  ck_assert(exp_shared->pf_scale == -1.);
+  ck_assert(exp_P->expstack[1][1] == exp_shared->expstack[1][1]);
+
+  /* parameter sets in use remain valid after clearing the cache */
+  vrna_params_shared_clear();
+  ck_assert(exp_P->exphairpin[5] == exp_shared->exphairpin[5]);
+
+  vrna_exp_params_shared_free(exp_shared);
+  free(exp_P);
+}
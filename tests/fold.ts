@@ -1,5 +1,8 @@
 #include <stdio.h>      /* printf, scanf, NULL */
 #include <stdlib.h>     /* malloc, free, rand */
+#include <string.h>
+#include <math.h>
+#include <limits.h>
 
 #include <ViennaRNA/fold_vars.h>
 #include <ViennaRNA/data_structures.h>
@@ -7,7 +10,158 @@
 #include <ViennaRNA/utils/structures.h>
 #include <ViennaRNA/constraints/basic.h>
 #include <ViennaRNA/fold.h>
+#include <ViennaRNA/mfe.h>
 #include <ViennaRNA/part_func.h>
+#include <ViennaRNA/part_func_window.h>
+#include <ViennaRNA/mfe_window.h>
+#include <ViennaRNA/boltzmann_sampling.h>
+#include <ViennaRNA/subopt.h>
+#include <ViennaRNA/eval.h>
+#include <ViennaRNA/findpath.h>
+#include <ViennaRNA/gquad.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+typedef struct {
+  vrna_fold_compound_t  *fc;
+  float                 threshold;
+  unsigned int          num;
+  char                  **structures;
+} subopt_collection;
+
+
+static void
+collect_subopt(const char *structure,
+               float      energy,
+               void       *data)
+{
+  subopt_collection *d = (subopt_collection *)data;
+
+  if (structure) {
+    ck_assert(energy <= d->threshold);
+    ck_assert(fabs(vrna_eval_structure(d->fc, structure) - energy) < 1e-4);
+
+    d->structures           = (char **)realloc(d->structures, sizeof(char *) * (d->num + 1));
+    d->structures[d->num++] = strdup(structure);
+  }
+}
+
+
+static int
+compare_strings(const void  *a,
+                const void  *b)
+{
+  return strcmp(*((char **)a), *((char **)b));
+}
+
+
+typedef struct {
+  int           winsize;
+  int           ulength;
+  unsigned int  calls;
+  int           last_bpp;
+  int           last_up;
+  double        *bpp;
+  double        *up;
+} window_collection;
+
+
+static void
+collect_window(FLT_OR_DBL   *pr,
+               int          pr_size,
+               int          i,
+               int          max,
+               unsigned int type,
+               void         *data)
+{
+  int               j;
+  window_collection *d = (window_collection *)data;
+
+  d->calls++;
+
+  if (type & VRNA_PROBS_WINDOW_BPP) {
+    /* positions must be reported in increasing order */
+    ck_assert_int_eq(i, d->last_bpp + 1);
+    d->last_bpp = i;
+    for (j = i + 1; j <= pr_size; j++)
+      d->bpp[(size_t)i * (d->winsize + 1) + j - i] = pr[j];
+  } else if (type & VRNA_PROBS_WINDOW_UP) {
+    ck_assert_int_eq(i, d->last_up + 1);
+    d->last_up = i;
+    for (j = 1; j <= pr_size; j++)
+      d->up[(size_t)i * (d->ulength + 1) + j] = ((double *)pr)[j];
+  }
+}
+
+
+typedef struct {
+  unsigned int  num;
+  int           last;
+  char          **hits;
+} hit_collection;
+
+
+static void
+collect_hit(int         start,
+            int         end,
+            const char  *structure,
+            float       en,
+            void        *data)
+{
+  char            buf[64];
+  hit_collection  *d = (hit_collection *)data;
+
+  /* hits are reported from 3' to 5' */
+  ck_assert(start <= d->last);
+  d->last = start;
+
+  snprintf(buf, sizeof(buf), " %d %d %6.2f", start, end, en);
+  d->hits         = (char **)realloc(d->hits, sizeof(char *) * (d->num + 1));
+  d->hits[d->num] = vrna_alloc(sizeof(char) * (strlen(structure) + strlen(buf) + 1));
+  strcpy(d->hits[d->num], structure);
+  strcat(d->hits[d->num], buf);
+  d->num++;
+}
+
+
+static unsigned char
+allow_all(int           i,
+          int           j,
+          int           k,
+          int           l,
+          unsigned char d,
+          void          *data)
+{
+  /* a hard constraint callback that forces the generic loop kernels */
+  return (unsigned char)1;
+}
+
+
+#ifdef VRNA_WITH_SVM
+static void
+collect_hit_z(int         start,
+              int         end,
+              const char  *structure,
+              float       en,
+              float       zscore,
+              void        *data)
+{
+  char            buf[64];
+  hit_collection  *d = (hit_collection *)data;
+
+  /* keep the z-score, such that it is compared as well */
+  snprintf(buf, sizeof(buf), " %6.2f", zscore);
+  collect_hit(start, end, structure, en, data);
+  d->hits[d->num - 1] = (char *)realloc(d->hits[d->num - 1],
+                                        sizeof(char) * (strlen(d->hits[d->num - 1]) + strlen(buf) + 1));
+  strcat(d->hits[d->num - 1], buf);
+}
+
+
+#endif
+
 
 #suite  MFE_Prediction
 
@@ -24,6 +178,346 @@
   free(structure);
 }
 
+#tcase  Wavefront
+
+#test test_mfe_wavefront
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  const int             length = sizeof(sequence) - 1;
+  char                  structure_rows[length + 1];
+  char                  structure_wavefront[length + 1];
+  float                 mfe_rows, mfe_wavefront;
+  int                   dangles;
+
+  for (dangles = 0; dangles < 4; dangles++) {
+    vrna_md_set_default(&md);
+    md.dangles  = dangles;
+    md.noLP     = dangles % 2;
+
+    vc        = vrna_fold_compound(sequence, &md, VRNA_OPTION_DEFAULT);
+    mfe_rows  = vrna_mfe(vc, structure_rows);
+    vrna_fold_compound_free(vc);
+
+    md.wavefront  = 1;
+    vc            = vrna_fold_compound(sequence, &md, VRNA_OPTION_DEFAULT);
+    mfe_wavefront = vrna_mfe(vc, structure_wavefront);
+    vrna_fold_compound_free(vc);
+
+    ck_assert(mfe_rows == mfe_wavefront);
+    ck_assert(strcmp(structure_rows, structure_wavefront) == 0);
+  }
+}
+
+#tcase  Tiles
+
+#test test_mfe_tiles
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  const int             length = sizeof(sequence) - 1;
+  char                  structure_rows[length + 1];
+  char                  structure_tiles[length + 1];
+  float                 mfe_rows, mfe_tiles;
+  int                   dangles, tile_size;
+
+  for (dangles = 0; dangles < 4; dangles++) {
+    vrna_md_set_default(&md);
+    md.dangles  = dangles;
+    md.noLP     = dangles % 2;
+
+    vc        = vrna_fold_compound(sequence, &md, VRNA_OPTION_DEFAULT);
+    mfe_rows  = vrna_mfe(vc, structure_rows);
+    vrna_fold_compound_free(vc);
+
+    for (tile_size = 1; tile_size <= length; tile_size *= 3) {
+      md.tile_size  = tile_size;
+      vc            = vrna_fold_compound(sequence, &md, VRNA_OPTION_DEFAULT);
+      mfe_tiles     = vrna_mfe(vc, structure_tiles);
+      vrna_fold_compound_free(vc);
+
+      ck_assert(mfe_rows == mfe_tiles);
+      ck_assert(strcmp(structure_rows, structure_tiles) == 0);
+    }
+  }
+}
+
+#tcase  Interior_Loops
+
+#test test_int_loop_kernels
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc[2];
+  char                  *seq, *s[2];
+  const int             n = 300;
+  int                   k, d, lp, m, size;
+  float                 mfe[2];
+
+  srand(17);
+  seq = vrna_alloc(sizeof(char) * (n + 1));
+  for (k = 0; k < n; k++)
+    seq[k] = "ACGU"[rand() % 4];
+
+  size = (n * (n + 1)) / 2 + 2;
+
+  for (d = 0; d <= 3; d++)
+    for (lp = 0; lp < 2; lp++) {
+      vrna_md_set_default(&md);
+      md.dangles  = d;
+      md.noLP     = lp;
+
+      /* unconstrained kernel vs. generic kernel that evaluates the callback */
+      for (m = 0; m < 2; m++) {
+        vc[m] = vrna_fold_compound(seq, &md, VRNA_OPTION_MFE);
+        if (m == 1)
+          vrna_hc_add_f(vc[m], &allow_all);
+
+        s[m]    = vrna_alloc(sizeof(char) * (n + 1));
+        mfe[m]  = vrna_mfe(vc[m], s[m]);
+      }
+
+      ck_assert(mfe[0] == mfe[1]);
+      ck_assert_str_eq(s[0], s[1]);
+      ck_assert(memcmp(vc[0]->matrices->c, vc[1]->matrices->c, sizeof(int) * size) == 0);
+      ck_assert(memcmp(vc[0]->matrices->fML, vc[1]->matrices->fML, sizeof(int) * size) == 0);
+
+      for (m = 0; m < 2; m++) {
+        free(s[m]);
+        vrna_fold_compound_free(vc[m]);
+      }
+    }
+
+  free(seq);
+}
+
+#tcase  G_Quadruplexes
+
+#test test_gquad_sparse
+{
+  vrna_md_t               md;
+  vrna_fold_compound_t    *vc;
+  vrna_subopt_solution_t  *sol, *s;
+  const char              sequence[] =
+    "ACGUGGGUGGGUGGGUGGGCAUGCAUGGCCGGGAAGGGAAGGGAAGGGCCGCAUGAUGCUAGCAGGGUUGGGUUGGGUUGGGAU";
+  const int               length = sizeof(sequence) - 1;
+  char                    structure[length + 1];
+  int                     i, j, *dense, *idx, *iidx, num;
+  FLT_OR_DBL              *dense_pf;
+  double                  mfe, ens;
+
+  vrna_md_set_default(&md);
+  md.gquad    = 1;
+  md.uniq_ML  = 1;
+
+  vc  = vrna_fold_compound(sequence, &md, VRNA_OPTION_DEFAULT);
+  mfe = vrna_mfe(vc, structure);
+
+  /* results obtained with the previous, dense G-quadruplex matrices */
+  ck_assert_str_eq(structure,
+                   "....+++.+++.+++.+++..(((.((((.+++..+++..+++..+++.........)))))))+++..+++..+++..+++..");
+  ck_assert(fabs(mfe - (-82.84)) < 1e-4);
+
+  vrna_exp_params_rescale(vc, &mfe);
+  ens = vrna_pf(vc, NULL);
+  ck_assert(fabs(ens - (-83.7755)) < 1e-4);
+  ck_assert(fabs(vc->exp_matrices->probs[vc->iindx[5] - 19] - 0.968951) < 1e-6);
+
+  sol = vrna_subopt(vc, 200, 0, NULL);
+  for (num = 0, s = sol; s->structure; s++, num++) {
+    ck_assert(strchr(s->structure, '+') != NULL);
+    free(s->structure);
+  }
+  free(sol);
+  ck_assert_int_eq(num, 18);
+
+  /* the sparse matrices must hold the same entries as the dense ones */
+  dense     = get_gquad_matrix(vc->sequence_encoding2, vc->params);
+  dense_pf  = get_gquad_pf_matrix(vc->sequence_encoding2, vc->exp_matrices->scale, vc->exp_params);
+  idx       = vrna_idx_col_wise(length);
+  iidx      = vrna_idx_row_wise(length);
+
+  for (i = 1; i <= length; i++)
+    for (j = i; j <= length; j++) {
+      ck_assert_int_eq(vrna_gquad_mx_get(vc->matrices->ggg, i, j), dense[idx[j] + i]);
+      ck_assert(vrna_gquad_mx_get_pf(vc->exp_matrices->G, i, j) == dense_pf[iidx[i] - j]);
+    }
+
+  free(dense);
+  free(dense_pf);
+  free(idx);
+  free(iidx);
+  vrna_fold_compound_free(vc);
+}
+
+#tcase  Suboptimals
+
+#test test_subopt_cb
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  vrna_subopt_stats_t   stats;
+  subopt_collection     d;
+  const char            sequence[] = "GGGAAAUCCCGCGCAUAGCUAGCUAGGCUAAGCUAGCAUCGAUCGAUGCAUGCUAG";
+  float                 mfe;
+  unsigned int          n;
+  int                   noLP;
+
+  for (noLP = 0; noLP < 2; noLP++) {
+    vrna_md_set_default(&md);
+    md.uniq_ML  = 1;
+    md.noLP     = noLP;
+
+    vc  = vrna_fold_compound(sequence, &md, VRNA_OPTION_DEFAULT);
+    mfe = vrna_mfe(vc, NULL);
+
+    d.fc          = vc;
+    d.threshold   = mfe + 4. + 1e-4;
+    d.num         = 0;
+    d.structures  = NULL;
+
+    vrna_subopt_cb(vc, 400, &collect_subopt, (void *)&d);
+    vrna_subopt_stats(&stats);
+
+    ck_assert(d.num > 1);
+
+    /* partial structures are shared among states, so every solution must be unique */
+    qsort(d.structures, d.num, sizeof(char *), &compare_strings);
+    for (n = 1; n < d.num; n++)
+      ck_assert(strcmp(d.structures[n - 1], d.structures[n]) != 0);
+
+    ck_assert(stats.states >= d.num);
+    ck_assert(stats.elements > 0);
+    ck_assert(stats.allocations > 0);
+    ck_assert(stats.max_stack > 0);
+    ck_assert(stats.peak_memory > 0);
+
+    for (n = 0; n < d.num; n++)
+      free(d.structures[n]);
+    free(d.structures);
+    vrna_fold_compound_free(vc);
+  }
+}
+
+#test test_subopt_cb_parallel
+{
+  vrna_md_t               md;
+  vrna_fold_compound_t    *vc;
+  vrna_subopt_solution_t  *sol;
+  subopt_collection       d;
+  const char              sequence[] = "GGGAAAUCCCGCGCAUAGCUAGCUAGGCUAAGCUAGCAUCGAUCGAUGCAUGCUAG";
+  char                    **ref;
+  float                   mfe;
+  unsigned int            n, num;
+  int                     noLP;
+
+  for (noLP = 0; noLP < 2; noLP++) {
+    vrna_md_set_default(&md);
+    md.uniq_ML  = 1;
+    md.noLP     = noLP;
+
+    vc  = vrna_fold_compound(sequence, &md, VRNA_OPTION_DEFAULT);
+    mfe = vrna_mfe(vc, NULL);
+    sol = vrna_subopt(vc, 400, 1, NULL);
+
+    for (num = 0; sol[num].structure; num++);
+
+    d.fc          = vc;
+    d.threshold   = mfe + 4. + 1e-4;
+    d.num         = 0;
+    d.structures  = NULL;
+
+    /* energy-sorted output must not depend on the number of threads */
+    vrna_subopt_cb_parallel(vc, 400, &collect_subopt, (void *)&d, 4, VRNA_SUBOPT_DEFAULT);
+
+    ck_assert_int_eq(d.num, num);
+    for (n = 0; n < num; n++) {
+      ck_assert_str_eq(d.structures[n], sol[n].structure);
+      free(d.structures[n]);
+    }
+
+    /* unordered output yields the same set of structures */
+    d.num = 0;
+    vrna_subopt_cb_parallel(vc, 400, &collect_subopt, (void *)&d, 4, VRNA_SUBOPT_UNORDERED);
+
+    ck_assert_int_eq(d.num, num);
+
+    ref = (char **)malloc(sizeof(char *) * num);
+    for (n = 0; n < num; n++)
+      ref[n] = sol[n].structure;
+
+    qsort(ref, num, sizeof(char *), &compare_strings);
+    qsort(d.structures, d.num, sizeof(char *), &compare_strings);
+
+    for (n = 0; n < num; n++) {
+      ck_assert_str_eq(d.structures[n], ref[n]);
+      free(d.structures[n]);
+    }
+
+    for (n = 0; n < num; n++)
+      free(sol[n].structure);
+
+    free(ref);
+    free(sol);
+    free(d.structures);
+    vrna_fold_compound_free(vc);
+  }
+}
+
+#test test_subopt_sorted_bounded
+{
+  vrna_md_t               md;
+  vrna_fold_compound_t    *vc;
+  vrna_subopt_solution_t  *sol;
+  vrna_subopt_stats_t     stats;
+  subopt_collection       d;
+  const char              sequence[] = "GGGAAAUCCCGCGCAUAGCUAGCUAGGCUAAGCUAGCAUCGAUCGAUGCAUGCUAG";
+  float                   mfe;
+  unsigned int            n, num;
+  size_t                  old_size;
+  int                     dangles;
+
+  /* force the structures to be spilled into many sorted runs */
+  old_size = vrna_subopt_sort_buffer(256);
+
+  for (dangles = 0; dangles < 4; dangles++) {
+    vrna_md_set_default(&md);
+    md.uniq_ML  = 1;
+    md.dangles  = dangles;
+
+    vc  = vrna_fold_compound(sequence, &md, VRNA_OPTION_DEFAULT);
+    mfe = vrna_mfe(vc, NULL);
+    sol = vrna_subopt(vc, 300, 1, NULL);
+
+    for (num = 0; sol[num].structure; num++);
+
+    d.fc          = vc;
+    d.threshold   = (dangles % 2) ? INF : mfe + 3. + 1e-4; /* energies are re-evaluated for d1 and d3 */
+    d.num         = 0;
+    d.structures  = NULL;
+
+    vrna_subopt_cb_parallel(vc, 300, &collect_subopt, (void *)&d, 1, VRNA_SUBOPT_DEFAULT);
+    vrna_subopt_stats(&stats);
+
+    ck_assert(stats.runs > 0);
+    ck_assert_int_eq(d.num, num);
+    for (n = 0; n < num; n++) {
+      ck_assert_str_eq(d.structures[n], sol[n].structure);
+      free(d.structures[n]);
+      free(sol[n].structure);
+    }
+
+    free(sol);
+    free(d.structures);
+    vrna_fold_compound_free(vc);
+  }
+
+  ck_assert(vrna_subopt_sort_buffer(old_size) == 256);
+}
+
 #suite  Partition_Function
 
 #tcase Stochastic_Backtracking
@@ -55,6 +549,882 @@
   vrna_fold_compound_free(vc);
 }
 
+#test test_sample_structure_rng
+{
+  unsigned int          i;
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  vrna_rng_t            *rng;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  char                  *samples[2][10], *other;
+
+  vrna_md_set_default(&md);
+  md.uniq_ML      = 1;
+  md.compute_bpp  = 0;
+
+  vc = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+
+  vrna_pf(vc, NULL);
+
+  /* the same seed must reproduce the same samples */
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(4711));
+  for (i = 0; i < 10; i++)
+    samples[0][i] = vrna_pbacktrack(vc);
+
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(4711));
+  for (i = 0; i < 10; i++)
+    samples[1][i] = vrna_pbacktrack(vc);
+
+  for (i = 0; i < 10; i++)
+    ck_assert_str_eq(samples[0][i], samples[1][i]);
+
+  /* split streams must differ from their origin */
+  rng = vrna_rng_init(4711);
+  vrna_fold_compound_add_rng(vc, vrna_rng_split(rng));
+  ck_assert(vrna_rng_urn(rng) != vrna_rng_urn(vc->rng));
+  vrna_rng_free(rng);
+
+  /* detaching the generator falls back to vrna_urn() */
+  vrna_fold_compound_add_rng(vc, NULL);
+  ck_assert(vc->rng == NULL);
+  other = vrna_pbacktrack(vc);
+  ck_assert_int_eq(strlen(other), sizeof(sequence) - 1);
+  free(other);
+
+  for (i = 0; i < 10; i++) {
+    free(samples[0][i]);
+    free(samples[1][i]);
+  }
+
+  vrna_fold_compound_free(vc);
+}
+
+#test test_sample_structure_num
+{
+  unsigned int          i, num;
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  char                  **samples, **packed, *unpacked;
+  short                 **pts;
+
+  vrna_md_set_default(&md);
+  md.uniq_ML      = 1;
+  md.compute_bpp  = 0;
+
+  vc = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+
+  vrna_pf(vc, NULL);
+
+  /* all output formats must encode the same samples for the same seed */
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(4711));
+  samples = vrna_pbacktrack_num(vc, 200, VRNA_PBACKTRACK_DEFAULT);
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(4711));
+  packed = vrna_pbacktrack_num(vc, 200, VRNA_PBACKTRACK_PACKED);
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(4711));
+  pts = vrna_pbacktrack_num_pt(vc, 200, VRNA_PBACKTRACK_DEFAULT);
+
+  ck_assert(samples != NULL);
+  ck_assert(packed != NULL);
+  ck_assert(pts != NULL);
+
+  for (num = 0; samples[num]; num++) {
+    ck_assert_int_eq(strlen(samples[num]), sizeof(sequence) - 1);
+
+    unpacked = vrna_db_unpack(packed[num]);
+    ck_assert_str_eq(unpacked, samples[num]);
+    free(unpacked);
+
+    unpacked = vrna_db_from_ptable(pts[num]);
+    ck_assert_str_eq(unpacked, samples[num]);
+    free(unpacked);
+  }
+
+  ck_assert_int_eq(num, 200);
+  ck_assert(packed[num] == NULL);
+  ck_assert(pts[num] == NULL);
+
+  for (i = 0; i < num; i++) {
+    free(samples[i]);
+    free(packed[i]);
+    free(pts[i]);
+  }
+  free(samples);
+  free(packed);
+  free(pts);
+
+  vrna_fold_compound_free(vc);
+}
+
+#test test_sample_structure_cache
+{
+  unsigned int          i;
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  char                  **plain, **cached, **capped;
+
+  vrna_md_set_default(&md);
+  md.uniq_ML      = 1;
+  md.compute_bpp  = 0;
+
+  vc = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+
+  vrna_pf(vc, NULL);
+
+  /* memoized decompositions must not change the samples drawn for a seed */
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(815));
+  plain = vrna_pbacktrack_num(vc, 200, VRNA_PBACKTRACK_DEFAULT);
+
+  ck_assert(vrna_pbacktrack_cache_init(vc, 0) != 0);
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(815));
+  cached = vrna_pbacktrack_num(vc, 200, VRNA_PBACKTRACK_DEFAULT);
+
+  ck_assert(vrna_pbacktrack_cache_init(vc, 4096) != 0);
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(815));
+  capped = vrna_pbacktrack_num(vc, 200, VRNA_PBACKTRACK_DEFAULT);
+
+  for (i = 0; i < 200; i++) {
+    ck_assert_str_eq(cached[i], plain[i]);
+    ck_assert_str_eq(capped[i], plain[i]);
+    free(plain[i]);
+    free(cached[i]);
+    free(capped[i]);
+  }
+  free(plain);
+  free(cached);
+  free(capped);
+
+  vrna_pbacktrack_cache_free(vc);
+  vrna_fold_compound_free(vc);
+}
+
+#test test_sample_structure_cache_parallel
+{
+  unsigned int          i, t, threads;
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  char                  **plain, **cached;
+
+  vrna_md_set_default(&md);
+  md.uniq_ML      = 1;
+  md.compute_bpp  = 0;
+
+  vc = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+
+  vrna_pf(vc, NULL);
+
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(4242));
+  plain = vrna_pbacktrack_num(vc, 2000, VRNA_PBACKTRACK_DEFAULT);
+
+  threads = 1;
+#ifdef _OPENMP
+  threads = (unsigned int)omp_get_max_threads();
+#endif
+
+  /* threads that concurrently fill an empty cache must draw the same samples */
+  for (t = 2; t <= 8; t *= 2) {
+#ifdef _OPENMP
+    omp_set_num_threads(t);
+#endif
+    ck_assert(vrna_pbacktrack_cache_init(vc, (t == 8) ? 65536 : 0) != 0);
+    vrna_fold_compound_add_rng(vc, vrna_rng_init(4242));
+    cached = vrna_pbacktrack_num(vc, 2000, VRNA_PBACKTRACK_DEFAULT);
+
+    for (i = 0; i < 2000; i++) {
+      ck_assert_str_eq(cached[i], plain[i]);
+      free(cached[i]);
+    }
+    free(cached);
+  }
+
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+
+  for (i = 0; i < 2000; i++)
+    free(plain[i]);
+  free(plain);
+
+  vrna_pbacktrack_cache_free(vc);
+  vrna_fold_compound_free(vc);
+}
+
+#test test_sample_structure_nr
+{
+  unsigned int          i, j, num;
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] = "GGGGAAAACCCC";
+  char                  **samples, *structure;
+  vrna_pbacktrack_mem_t nr_mem;
+
+  vrna_md_set_default(&md);
+  md.uniq_ML      = 1;
+  md.compute_bpp  = 0;
+
+  vc = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+
+  vrna_pf(vc, NULL);
+
+  /* request more samples than there are structures */
+  vrna_fold_compound_add_rng(vc, vrna_rng_init(1234));
+  samples = vrna_pbacktrack_num(vc, 1000, VRNA_PBACKTRACK_NON_REDUNDANT);
+
+  ck_assert(samples != NULL);
+
+  for (num = 0; samples[num]; num++)
+    for (i = 0; i < num; i++)
+      ck_assert(strcmp(samples[i], samples[num]) != 0);
+
+  ck_assert(num > 50);
+  ck_assert(num < 1000);
+
+  /* drawing one structure after another yields the same ensemble */
+  nr_mem = NULL;
+  for (i = 0; (structure = vrna_pbacktrack_nr(vc, &nr_mem)); i++) {
+    for (j = 0; j < num; j++)
+      if (!strcmp(structure, samples[j]))
+        break;
+
+    ck_assert(j < num);
+    free(structure);
+  }
+
+  ck_assert_int_eq(i, num);
+
+  vrna_pbacktrack_mem_free(nr_mem);
+
+  for (i = 0; i < num; i++)
+    free(samples[i]);
+  free(samples);
+
+  vrna_fold_compound_free(vc);
+}
+
+#tcase  Wavefront
+
+#test test_pf_wavefront
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  const int             length = sizeof(sequence) - 1;
+  int                   i, j, dangles, size, *iindx;
+  double                G_rows, G_wavefront;
+  FLT_OR_DBL            *probs_rows;
+
+  size  = ((length + 1) * (length + 2)) / 2;
+  iindx = vrna_idx_row_wise(length);
+
+  for (dangles = 0; dangles < 4; dangles++) {
+    vrna_md_set_default(&md);
+    md.dangles  = dangles;
+    md.gquad    = dangles % 2;
+
+    vc          = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+    G_rows      = vrna_pf(vc, NULL);
+    probs_rows  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * size);
+    memcpy(probs_rows, vc->exp_matrices->probs, sizeof(FLT_OR_DBL) * size);
+    vrna_fold_compound_free(vc);
+
+    md.wavefront  = 1;
+    vc            = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+    G_wavefront   = vrna_pf(vc, NULL);
+
+    /* same order of summation, so results must be bit-identical */
+    ck_assert(G_rows == G_wavefront);
+    for (i = 1; i <= length; i++)
+      for (j = i; j <= length; j++)
+        ck_assert(probs_rows[iindx[i] - j] == vc->exp_matrices->probs[iindx[i] - j]);
+
+    free(probs_rows);
+    vrna_fold_compound_free(vc);
+  }
+
+  free(iindx);
+}
+
+#tcase  Tiles
+
+#test test_pf_tiles
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  const int             length = sizeof(sequence) - 1;
+  int                   i, j, dangles, size, tile_size, *iindx;
+  double                G_rows, G_tiles;
+  FLT_OR_DBL            *probs_rows;
+
+  size  = ((length + 1) * (length + 2)) / 2;
+  iindx = vrna_idx_row_wise(length);
+
+  for (dangles = 0; dangles < 4; dangles++) {
+    vrna_md_set_default(&md);
+    md.dangles  = dangles;
+    md.gquad    = dangles % 2;
+
+    vc          = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+    G_rows      = vrna_pf(vc, NULL);
+    probs_rows  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * size);
+    memcpy(probs_rows, vc->exp_matrices->probs, sizeof(FLT_OR_DBL) * size);
+    vrna_fold_compound_free(vc);
+
+    for (tile_size = 1; tile_size <= length; tile_size *= 3) {
+      md.tile_size  = tile_size;
+      vc            = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+      G_tiles       = vrna_pf(vc, NULL);
+
+      /* same order of summation within each cell, so results must be bit-identical */
+      ck_assert(G_rows == G_tiles);
+      for (i = 1; i <= length; i++)
+        for (j = i; j <= length; j++)
+          ck_assert(probs_rows[iindx[i] - j] == vc->exp_matrices->probs[iindx[i] - j]);
+
+      vrna_fold_compound_free(vc);
+    }
+
+    free(probs_rows);
+  }
+
+  free(iindx);
+}
+
+#tcase  Log_Space
+
+#test test_pf_logspace
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  const char            sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  const int             length = sizeof(sequence) - 1;
+  int                   i, j, dangles, mode, size, *iindx;
+  double                G_linear, G_log;
+  FLT_OR_DBL            *probs_linear;
+
+  size  = ((length + 1) * (length + 2)) / 2;
+  iindx = vrna_idx_row_wise(length);
+
+  for (dangles = 0; dangles < 4; dangles++) {
+    vrna_md_set_default(&md);
+    md.dangles    = dangles;
+    md.uniq_ML    = 1;
+
+    vc            = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+    G_linear      = vrna_pf(vc, NULL);
+    probs_linear  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * size);
+    memcpy(probs_linear, vc->exp_matrices->probs, sizeof(FLT_OR_DBL) * size);
+    ck_assert_int_eq(vrna_pf_logspace(vc), 0);
+    vrna_fold_compound_free(vc);
+
+    /* row-wise, wavefront, and tiled fill */
+    for (mode = 0; mode < 3; mode++) {
+      md.pf_logspace  = 1;
+      md.wavefront    = (mode == 1);
+      md.tile_size    = (mode == 2) ? 16 : 0;
+
+      vc    = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+      G_log = vrna_pf(vc, NULL);
+      ck_assert_int_eq(vrna_pf_logspace(vc), 1);
+
+      ck_assert(fabs(G_linear - G_log) < 1e-6);
+      for (i = 1; i <= length; i++)
+        for (j = i; j <= length; j++)
+          ck_assert(fabs(probs_linear[iindx[i] - j] - vc->exp_matrices->probs[iindx[i] - j]) < 1e-9);
+
+      /* the decision sticks to the filled matrices, not to constraints added afterwards */
+      vrna_sc_init(vc);
+      ck_assert_int_eq(vrna_pf_logspace(vc), 1);
+      ck_assert_int_eq(vrna_pf_logspace_available(vc), 0);
+      ck_assert_int_eq(vrna_pairing_probs(vc, NULL), 1);
+      ck_assert(fabs(probs_linear[iindx[1] - length] - vc->exp_matrices->probs[iindx[1] - length]) < 1e-9);
+
+      /* stochastic backtracking refuses log-space matrices */
+      ck_assert(vrna_pbacktrack(vc) == NULL);
+
+      ck_assert(fabs(vrna_pf(vc, NULL) - G_linear) < 1e-6);
+      ck_assert_int_eq(vrna_pf_logspace(vc), 0);
+
+      vrna_fold_compound_free(vc);
+    }
+
+    free(probs_linear);
+  }
+
+  /* G-quadruplexes are not available in log-space, so we fall back to scaled Boltzmann factors */
+  vrna_md_set_default(&md);
+  md.gquad        = 1;
+  md.pf_logspace  = 1;
+  vc              = vrna_fold_compound(sequence, &md, VRNA_OPTION_PF);
+  ck_assert_int_eq(vrna_pf_logspace_available(vc), 0);
+  (void)vrna_pf(vc, NULL);
+  ck_assert_int_eq(vrna_pf_logspace(vc), 0);
+  vrna_fold_compound_free(vc);
+
+  free(iindx);
+}
+
+#tcase  Interior_Loops
+
+#test test_exp_int_loop_kernels
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc[2];
+  char                  *seq;
+  const int             n = 300;
+  int                   k, d, m, size;
+  double                G[2];
+
+  srand(17);
+  seq = vrna_alloc(sizeof(char) * (n + 1));
+  for (k = 0; k < n; k++)
+    seq[k] = "ACGU"[rand() % 4];
+
+  size = ((n + 1) * (n + 2)) / 2;
+
+  for (d = 0; d <= 3; d += 2) {
+    vrna_md_set_default(&md);
+    md.dangles      = d;
+    md.compute_bpp  = 1;
+
+    /* unconstrained kernel vs. generic kernel that evaluates the callback */
+    for (m = 0; m < 2; m++) {
+      vc[m] = vrna_fold_compound(seq, &md, VRNA_OPTION_PF);
+      if (m == 1)
+        vrna_hc_add_f(vc[m], &allow_all);
+
+      G[m] = vrna_pf(vc[m], NULL);
+    }
+
+    ck_assert(G[0] == G[1]);
+    ck_assert(memcmp(vc[0]->exp_matrices->qb,
+                     vc[1]->exp_matrices->qb,
+                     sizeof(FLT_OR_DBL) * size) == 0);
+    ck_assert(memcmp(vc[0]->exp_matrices->probs,
+                     vc[1]->exp_matrices->probs,
+                     sizeof(FLT_OR_DBL) * size) == 0);
+
+    for (m = 0; m < 2; m++)
+      vrna_fold_compound_free(vc[m]);
+  }
+
+  free(seq);
+}
+
+#tcase  Fold_Compound_Pool
+
+#test test_fold_compound_pool
+{
+  vrna_md_t                 md;
+  vrna_fold_compound_t      *vc, *vc_pool;
+  vrna_fold_compound_pool_t *pool;
+  const char                sequence[] =
+    "UGCCUGGCGGCCGUAGCGCGGUGGUCCCACCUGACCCCAUGCCGAACUCAGAAGUGAAACGCCGUAGCGCCGAUGGUAGUGUGGGGUCUCCCCAUGCGAGAGUAGGGAACUGCCAGGCAU";
+  const int                 length = sizeof(sequence) - 1;
+  const int                 lengths[] = {
+    length, 40, 77, 18, length, 0
+  };
+  char                      *seq, *s1, *s2;
+  int                       i, j, k, n, *iindx;
+  double                    e1, e2, G1, G2;
+
+  pool = vrna_fold_compound_pool_init(0);
+
+  for (k = 0; lengths[k]; k++) {
+    n   = lengths[k];
+    seq = vrna_alloc(sizeof(char) * (n + 1));
+    s1  = vrna_alloc(sizeof(char) * (n + 1));
+    s2  = vrna_alloc(sizeof(char) * (n + 1));
+    memcpy(seq, sequence + length - n, sizeof(char) * n);
+
+    vrna_md_set_default(&md);
+    md.dangles      = k % 4;
+    md.gquad        = k % 2;
+    md.compute_bpp  = 1;
+
+    /* shrinking and growing sequences must give the same results as a fresh fold compound */
+    vc      = vrna_fold_compound(seq, &md, VRNA_OPTION_DEFAULT);
+    vc_pool = vrna_fold_compound_pool_acquire(pool, seq, &md, VRNA_OPTION_DEFAULT);
+
+    e1  = (double)vrna_mfe(vc, s1);
+    e2  = (double)vrna_mfe(vc_pool, s2);
+    ck_assert(e1 == e2);
+    ck_assert(strcmp(s1, s2) == 0);
+
+    vrna_exp_params_rescale(vc, &e1);
+    vrna_exp_params_rescale(vc_pool, &e2);
+    G1  = vrna_pf(vc, NULL);
+    G2  = vrna_pf(vc_pool, NULL);
+    ck_assert(G1 == G2);
+
+    iindx = vc->iindx;
+    for (i = 1; i <= n; i++)
+      for (j = i; j <= n; j++)
+        ck_assert(vc->exp_matrices->probs[iindx[i] - j] ==
+                  vc_pool->exp_matrices->probs[iindx[i] - j]);
+
+    vrna_fold_compound_free(vc);
+    vrna_fold_compound_pool_release(pool, vc_pool);
+    free(seq);
+    free(s1);
+    free(s2);
+  }
+
+  vrna_fold_compound_pool_free(pool);
+}
+
+#tcase  Sliding_Window
+
+#test test_probs_window_parallel
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  window_collection     d[2];
+  char                  *seq;
+  const int             n = 6000, winsize = 30, ulength = 10;
+  int                   k, r;
+  size_t                i;
+
+  seq = vrna_alloc(sizeof(char) * (n + 1));
+  srand(42);
+  for (k = 0; k < n; k++)
+    seq[k] = "ACGU"[rand() % 4];
+
+  vrna_md_set_default(&md);
+  md.window_size  = winsize;
+  md.max_bp_span  = winsize - 5;
+
+  for (k = 0; k < 2; k++) {
+    d[k].winsize  = winsize;
+    d[k].ulength  = ulength;
+    d[k].calls    = 0;
+    d[k].last_bpp = 0;
+    d[k].last_up  = 0;
+    d[k].bpp      = vrna_alloc(sizeof(double) * (n + 1) * (winsize + 1));
+    d[k].up       = vrna_alloc(sizeof(double) * (n + 1) * (ulength + 1));
+
+    vc  = vrna_fold_compound(seq, &md, VRNA_OPTION_WINDOW);
+    r   = (k == 0) ?
+          vrna_probs_window(vc,
+                            ulength,
+                            VRNA_PROBS_WINDOW_BPP | VRNA_PROBS_WINDOW_UP,
+                            &collect_window,
+                            (void *)&(d[k])) :
+          vrna_probs_window_parallel(vc,
+                                     ulength,
+                                     VRNA_PROBS_WINDOW_BPP | VRNA_PROBS_WINDOW_UP,
+                                     &collect_window,
+                                     (void *)&(d[k]),
+                                     4);
+    ck_assert_int_eq(r, 1);
+    ck_assert_int_eq(d[k].last_bpp, n);
+    ck_assert_int_eq(d[k].last_up, n);
+    vrna_fold_compound_free(vc);
+  }
+
+  /* chunked scan must yield exactly the same probabilities */
+  ck_assert_int_eq(d[0].calls, d[1].calls);
+  for (i = 0; i < (size_t)(n + 1) * (winsize + 1); i++)
+    ck_assert(d[0].bpp[i] == d[1].bpp[i]);
+
+  for (i = 0; i < (size_t)(n + 1) * (ulength + 1); i++)
+    ck_assert(d[0].up[i] == d[1].up[i]);
+
+  for (k = 0; k < 2; k++) {
+    free(d[k].bpp);
+    free(d[k].up);
+  }
+
+  free(seq);
+}
+
+#test test_mfe_window_parallel
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  hit_collection        d[2];
+  char                  *seq, *aln[4];
+  const int             n = 20000, winsize = 60;
+  int                   k, m, s;
+  unsigned int          i;
+  float                 mfe[2];
+
+  srand(42);
+  seq = vrna_alloc(sizeof(char) * (n + 1));
+  for (k = 0; k < n; k++)
+    seq[k] = "ACGU"[rand() % 4];
+
+  /* alignment of point mutants with a few gaps */
+  for (s = 0; s < 3; s++) {
+    aln[s] = strdup(seq);
+    for (k = 0; k < n; k++)
+      if (rand() % 10 == 0)
+        aln[s][k] = "ACGU-"[rand() % 5];
+  }
+  aln[3] = NULL;
+
+  vrna_md_set_default(&md);
+  md.window_size  = winsize;
+  md.max_bp_span  = winsize;
+
+  for (m = 0; m < 2; m++) {
+    for (k = 0; k < 2; k++) {
+      d[k].num  = 0;
+      d[k].last = n + 1;
+      d[k].hits = NULL;
+
+      vc = (m == 0) ?
+           vrna_fold_compound(seq, &md, VRNA_OPTION_MFE | VRNA_OPTION_WINDOW) :
+           vrna_fold_compound_comparative((const char **)aln,
+                                          &md,
+                                          VRNA_OPTION_MFE | VRNA_OPTION_WINDOW);
+      mfe[k] = (k == 0) ?
+               vrna_mfe_window_cb(vc, &collect_hit, (void *)&(d[k])) :
+               vrna_mfe_window_cb_parallel(vc, &collect_hit, (void *)&(d[k]), 4);
+      vrna_fold_compound_free(vc);
+    }
+
+    /* chunked scan must yield exactly the same hits in the same order */
+    ck_assert(mfe[0] == mfe[1]);
+    ck_assert(mfe[0] < 0.);
+    ck_assert(d[0].num > 0);
+    ck_assert_int_eq(d[0].num, d[1].num);
+    for (i = 0; i < d[0].num; i++)
+      ck_assert_str_eq(d[0].hits[i], d[1].hits[i]);
+
+    for (k = 0; k < 2; k++) {
+      for (i = 0; i < d[k].num; i++)
+        free(d[k].hits[i]);
+      free(d[k].hits);
+    }
+  }
+
+#ifdef VRNA_WITH_SVM
+  /* same for the z-score filtered scan of the single sequence */
+  for (k = 0; k < 2; k++) {
+    d[k].num  = 0;
+    d[k].last = n + 1;
+    d[k].hits = NULL;
+
+    vc      = vrna_fold_compound(seq, &md, VRNA_OPTION_MFE | VRNA_OPTION_WINDOW);
+    mfe[k]  = (k == 0) ?
+              vrna_mfe_window_zscore_cb(vc, -2., &collect_hit_z, (void *)&(d[k])) :
+              vrna_mfe_window_zscore_cb_parallel(vc, -2., &collect_hit_z, (void *)&(d[k]), 4);
+    vrna_fold_compound_free(vc);
+  }
+
+  ck_assert(mfe[0] == mfe[1]);
+  ck_assert(d[0].num > 0);
+  ck_assert_int_eq(d[0].num, d[1].num);
+  for (i = 0; i < d[0].num; i++)
+    ck_assert_str_eq(d[0].hits[i], d[1].hits[i]);
+
+  for (k = 0; k < 2; k++) {
+    for (i = 0; i < d[k].num; i++)
+      free(d[k].hits[i]);
+    free(d[k].hits);
+  }
+#endif
+
+  for (s = 0; s < 3; s++)
+    free(aln[s]);
+
+  free(seq);
+}
+
+#test test_mfe_window_comparative
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  hit_collection        d;
+  char                  *seq, *aln[4], *structure;
+  const int             n = 300;
+  int                   k, s, m;
+  unsigned int          i;
+  float                 mfe[2];
+
+  srand(7);
+  seq = vrna_alloc(sizeof(char) * (n + 1));
+  for (k = 0; k < n; k++)
+    seq[k] = "ACGU"[rand() % 4];
+
+  for (s = 0; s < 3; s++) {
+    aln[s] = strdup(seq);
+    for (k = 0; k < n; k++)
+      if (rand() % 10 == 0)
+        aln[s][k] = "ACGU-"[rand() % 5];
+  }
+  aln[3] = NULL;
+
+  /* a window that spans the entire input must yield the global MFE */
+  vrna_md_set_default(&md);
+  md.window_size  = n;
+  md.max_bp_span  = n;
+  structure       = vrna_alloc(sizeof(char) * (n + 1));
+
+  for (m = 0; m < 2; m++) {
+    d.num   = 0;
+    d.last  = n + 1;
+    d.hits  = NULL;
+
+    vc = (m == 0) ?
+         vrna_fold_compound(seq, &md, VRNA_OPTION_MFE | VRNA_OPTION_WINDOW) :
+         vrna_fold_compound_comparative((const char **)aln,
+                                        &md,
+                                        VRNA_OPTION_MFE | VRNA_OPTION_WINDOW);
+    mfe[0] = vrna_mfe_window_cb(vc, &collect_hit, (void *)&d);
+    vrna_fold_compound_free(vc);
+
+    vc = (m == 0) ?
+         vrna_fold_compound(seq, &md, VRNA_OPTION_MFE) :
+         vrna_fold_compound_comparative((const char **)aln,
+                                        &md,
+                                        VRNA_OPTION_MFE);
+    mfe[1] = vrna_mfe(vc, structure);
+    vrna_fold_compound_free(vc);
+
+    ck_assert(mfe[1] < 0.);
+    ck_assert(mfe[0] == mfe[1]);
+
+    for (i = 0; i < d.num; i++)
+      free(d.hits[i]);
+    free(d.hits);
+  }
+
+  for (s = 0; s < 3; s++)
+    free(aln[s]);
+
+  free(structure);
+  free(seq);
+}
+
+#tcase  Find_Path
+
+#test test_findpath
+{
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  vrna_path_t           *route, *r;
+  char                  *seq, *s1, *s2;
+  const int             n = 120;
+  int                   k, width, saddle, max_en;
+  double                mfe;
+
+  srand(42);
+  seq = vrna_alloc(sizeof(char) * (n + 1));
+  for (k = 0; k < n; k++)
+    seq[k] = "ACGU"[rand() % 4];
+
+  vrna_md_set_default(&md);
+  md.uniq_ML = 1;
+
+  vc  = vrna_fold_compound(seq, &md, VRNA_OPTION_DEFAULT);
+  s1  = vrna_alloc(sizeof(char) * (n + 1));
+  mfe = (double)vrna_mfe(vc, s1);
+  vrna_exp_params_rescale(vc, &mfe);
+  vrna_pf(vc, NULL);
+  s2 = vrna_pbacktrack(vc);
+
+  ck_assert(vrna_bp_distance(s1, s2) > 0);
+
+  for (width = 1; width <= 100; width *= 10) {
+    route = vrna_path_findpath(vc, s1, s2, width);
+    ck_assert(route != NULL);
+    ck_assert_str_eq(route[0].s, s1);
+
+    /* each step must insert or delete a single pair, and energies must be correct */
+    max_en = INT_MIN;
+    for (r = route; r->s; r++) {
+      ck_assert(fabs(vrna_eval_structure(vc, r->s) - r->en) < 1e-4);
+      if (r != route)
+        ck_assert_int_eq(vrna_bp_distance(r[-1].s, r->s), 1);
+
+      if ((int)round(r->en * 100.) > max_en)
+        max_en = (int)round(r->en * 100.);
+    }
+    ck_assert_str_eq(r[-1].s, s2);
+    ck_assert_int_eq(r - route, vrna_bp_distance(s1, s2) + 1);
+
+    saddle = vrna_path_findpath_saddle(vc, s1, s2, width);
+    ck_assert_int_eq(saddle, max_en);
+
+    free_path(route);
+  }
+
+  /* no path with a saddle below the start structure */
+  saddle  = (int)round(vrna_eval_structure(vc, s1) * 100.);
+  route   = vrna_path_findpath_ub(vc, s1, s2, 10, saddle);
+  ck_assert(route == NULL);
+
+  /* path from a structure to itself */
+  route = vrna_path_findpath(vc, s1, s1, 10);
+  ck_assert(route != NULL);
+  ck_assert_str_eq(route[0].s, s1);
+  ck_assert(route[1].s == NULL);
+  free_path(route);
+
+  vrna_fold_compound_free(vc);
+  free(seq);
+  free(s1);
+  free(s2);
+}
+
+#test test_findpath_saddles
+{
+  /*
+   *  Saddle heights obtained with previous versions, where candidates of
+   *  equal energy are ranked by their pair tables
+   */
+  struct {
+    const char  *seq;
+    const char  *s1;
+    const char  *s2;
+    int         width;
+    int         saddle;
+  } cases[] = {
+    {
+      "UGUGUAGGAUGGACAUCUGGUAGACGAUAGAAAUGAACUACCUCGUCAGAGGACGGAGCCCCCGCAGCGCGUUCCGCGGA",
+      "((((..((..((....))(((((..............)))))(((((....)))))..))..)))).((((...))))..",
+      "..................(((((...((....))...))))).((((....))))..((....))..((((...))))..",
+      5, -930
+    },
+    {
+      "CGGAAACGUUAACUCGUCCGAAGCGUCUCUCGCAGGAUCAGCCACUGAAUUAAGGUCUGGGAAAAUUCGAGCGUGUUCAU",
+      "((....))(.(((.(((.((((...((((..((..((((((...)))).))...))..))))...)))).))).))).).",
+      ".(((.(((((......(((...(((.....))).))).(((((..........)).))).((....)).))))).)))..",
+      50, -480
+    },
+    {
+      "GCGUGAGGCGCCUGCGAGAGUUGAACUCAGAUAUUGUCACAGUUCACGGCAGAUGAACCCAGCACAGCCUGGGCCAGUUAAUGCGCGUGACUGGUAUGCA",
+      "(((((......((((....(.((((((..(((...)))..))))))).)))).....(((((......)))))(((((((.......)))))))))))).",
+      "((.....))((.(((..(((.....)))...........(((.((((((((......(((((......)))))........))).))))))))))).)).",
+      10, -1120
+    }
+  };
+  vrna_md_t             md;
+  vrna_fold_compound_t  *vc;
+  unsigned int          k;
+
+  vrna_md_set_default(&md);
+  md.uniq_ML = 1;
+
+  for (k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+    vc = vrna_fold_compound(cases[k].seq, &md, VRNA_OPTION_DEFAULT);
+    ck_assert_int_eq(vrna_path_findpath_saddle(vc, cases[k].s1, cases[k].s2, cases[k].width),
+                     cases[k].saddle);
+    vrna_fold_compound_free(vc);
+  }
+}
+
 #suite  Constraints_Implementation
 
 #tcase  Soft_Constraints
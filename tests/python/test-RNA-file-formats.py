@@ -5,6 +5,8 @@ RNApath.addSwigInterfacePath()
 
 import RNA
 import unittest
+import tempfile
+import os
 
 datadir = RNApath.getDataDirPath()
 
@@ -155,6 +157,35 @@ class file_utils_msa_Test(unittest.TestCase):
         self.assertTrue(counter == 3)
 
 
+class file_utils_acc_Test(unittest.TestCase):
+
+    def test_acc_store(self):
+        print "test_acc_store"
+        seq     = "GGGGAAAACCCCAUCGAUCGAUCGAUCGGGAAAUCCC"
+        kT      = 0.61632
+        pu      = RNA.pfl_fold_up(seq, 10, 20, 15)
+        name    = tempfile.mktemp()
+
+        writer = RNA.acc_store_writer(name)
+        self.assertTrue(writer.add("seq1", 10, kT, pu) == 1)
+        # the store is finished upon destruction of the writer
+        del writer
+
+        store = RNA.acc_store(name)
+        self.assertTrue(store.size() == 1)
+        self.assertTrue(store.find("seq2") is None)
+
+        rec = store.find("seq1")
+        self.assertTrue(rec.length == len(seq))
+        self.assertTrue(rec.max_u == 10)
+        self.assertTrue(rec.id == "seq1")
+        self.assertAlmostEqual(rec.probability(20, 5), pu[20][5], places = 5)
+        self.assertAlmostEqual(rec.energies(5)[20], rec.energy(20, 5), places = 5)
+
+        del store
+        os.remove(name)
+
+
 
 if __name__ == '__main__':
     unittest.main()
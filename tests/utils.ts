@@ -1,8 +1,30 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 #include <ViennaRNA/model.h>
 #include <ViennaRNA/utils/basic.h>
 #include <ViennaRNA/alphabet.h>
+#include <ViennaRNA/datastructures/hash_tables.h>
+#include <ViennaRNA/datastructures/file_stream.h>
+#include <ViennaRNA/io/accessibility.h>
+#include <ViennaRNA/utils/cpu.h>
+#include <ViennaRNA/utils/higher_order_functions.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static void
+format_int_record(FILE        *fp,
+                  const void  *record,
+                  size_t      size,
+                  void        *data)
+{
+  fprintf(fp, "%d\n", *((const int *)record));
+}
+
 
 #suite Utilities
 
@@ -205,3 +227,360 @@
 //@TODO: extend alphabeth
 //@TODO: details.noLP = 1
 //@TODO: idx_type = 1
+
+#tcase Hash_Tables
+
+#test test_hash_table_grow_remove
+{
+  vrna_hash_table_t   ht;
+  vrna_ht_entry_db_t  *entries, lookup;
+  char                buf[32];
+  unsigned int        i, n = 5000;
+
+  entries = (vrna_ht_entry_db_t *)vrna_alloc(sizeof(vrna_ht_entry_db_t) * n);
+
+  /* start with a tiny table that has to grow several times */
+  ht = vrna_ht_init(2, NULL, NULL, NULL);
+  ck_assert(ht != NULL);
+
+  for (i = 0; i < n; i++) {
+    sprintf(buf, "((..%u..))", i);
+    entries[i].structure  = strdup(buf);
+    entries[i].energy     = (float)i;
+    ck_assert_int_eq(vrna_ht_insert(ht, entries + i), 0);
+  }
+
+  ck_assert_int_eq(vrna_ht_count(ht), n);
+  ck_assert(vrna_ht_size(ht) >= n);
+
+  /* duplicates are rejected */
+  lookup.structure = entries[42].structure;
+  ck_assert_int_eq(vrna_ht_insert(ht, &lookup), 1);
+
+  /* remove every other entry */
+  for (i = 0; i < n; i += 2)
+    vrna_ht_remove(ht, entries + i);
+
+  ck_assert_int_eq(vrna_ht_count(ht), n / 2);
+
+  for (i = 0; i < n; i++) {
+    sprintf(buf, "((..%u..))", i);
+    lookup.structure = buf;
+    if (i % 2)
+      ck_assert(vrna_ht_get(ht, &lookup) == (void *)(entries + i));
+    else
+      ck_assert(vrna_ht_get(ht, &lookup) == NULL);
+  }
+
+  /* removed entries are not free'd by the hash table */
+  for (i = 0; i < n; i += 2)
+    free(entries[i].structure);
+
+  vrna_ht_free(ht);
+  free(entries);
+}
+
+#test test_hash_table_concurrent
+{
+  vrna_hash_table_t   ht;
+  vrna_ht_entry_db_t  *entries;
+  char                buf[32];
+  int                 i, n = 4000;
+
+  entries = (vrna_ht_entry_db_t *)vrna_alloc(sizeof(vrna_ht_entry_db_t) * n);
+
+  for (i = 0; i < n; i++) {
+    sprintf(buf, "(((%d)))", i);
+    entries[i].structure  = strdup(buf);
+    entries[i].energy     = (float)i;
+  }
+
+  ht = vrna_ht_init_concurrent(4, 8, NULL, NULL, NULL);
+  ck_assert(ht != NULL);
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (i = 0; i < n; i++)
+    vrna_ht_insert(ht, entries + i);
+
+  ck_assert_int_eq(vrna_ht_count(ht), n);
+
+  for (i = 0; i < n; i++)
+    ck_assert(vrna_ht_get(ht, entries + i) == (void *)(entries + i));
+
+  vrna_ht_free(ht);
+  free(entries);
+}
+
+#tcase File_Stream
+
+#test test_file_stream
+{
+  vrna_fstream_t  stream;
+  FILE            *fp;
+  char            *expected, *result, line[64];
+  int             i, *rec, big[100];
+  size_t          n;
+
+  /* formatted records with blocks that hold only a few of them */
+  fp = tmpfile();
+  ck_assert(fp != NULL);
+
+  stream = vrna_fstream_init(fp, 64, &format_int_record, NULL);
+  ck_assert(stream != NULL);
+
+  expected  = (char *)vrna_alloc(sizeof(char) * 100000);
+  n         = 0;
+
+  for (i = 0; i < 5000; i++) {
+    if (i % 2) {
+      vrna_fstream_write(stream, &i, sizeof(int));
+    } else {
+      rec = (int *)vrna_fstream_reserve(stream, sizeof(int) * 2);
+      rec[0] = i;
+      vrna_fstream_commit(stream, sizeof(int));
+    }
+
+    n += sprintf(expected + n, "%d\n", i);
+  }
+
+  /* a record that exceeds the block size */
+  for (i = 0; i < 100; i++)
+    big[i] = i;
+  vrna_fstream_write(stream, big, sizeof(big));
+  n += sprintf(expected + n, "0\n");
+
+  ck_assert_int_eq(vrna_fstream_free(stream), 1);
+
+  result = (char *)vrna_alloc(sizeof(char) * (n + 1));
+  rewind(fp);
+  ck_assert(fread(result, sizeof(char), n + 1, fp) == n);
+  ck_assert_str_eq(result, expected);
+  fclose(fp);
+
+  /* raw records are written as they are */
+  fp = tmpfile();
+  stream = vrna_fstream_init(fp, 0, NULL, NULL);
+  vrna_fstream_write(stream, "abc", 3);
+  vrna_fstream_write(stream, "de\n", 3);
+  ck_assert_int_eq(vrna_fstream_free(stream), 1);
+
+  rewind(fp);
+  ck_assert(fgets(line, 64, fp) != NULL);
+  ck_assert_str_eq(line, "abcde\n");
+  fclose(fp);
+
+  ck_assert(vrna_fstream_init(NULL, 0, NULL, NULL) == NULL);
+
+  free(expected);
+  free(result);
+}
+
+#tcase Higher_Order_Functions
+
+#test test_fun_dispatch_variants
+{
+  unsigned int  variants[] = {
+    VRNA_CPU_SIMD_SSE2,
+    VRNA_CPU_SIMD_SSE41,
+    VRNA_CPU_SIMD_AVX2,
+    VRNA_CPU_SIMD_AVX512F
+  };
+  int           i, v, count, *e1, *e2, min_ref;
+  FLT_OR_DBL    *q1, *q2, sum_ref, sum_rev_ref, sum, sum_rev;
+
+  e1  = (int *)vrna_alloc(sizeof(int) * 200);
+  e2  = (int *)vrna_alloc(sizeof(int) * 200);
+  q1  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * 200);
+  q2  = (FLT_OR_DBL *)vrna_alloc(sizeof(FLT_OR_DBL) * 200);
+
+  srand(4711);
+  for (i = 0; i < 200; i++) {
+    e1[i] = (rand() % 7 == 0) ? INF : rand() % 2000 - 1000;
+    e2[i] = (rand() % 5 == 0) ? INF : rand() % 2000 - 1000;
+    q1[i] = (FLT_OR_DBL)rand() / RAND_MAX * 1e3;
+    q2[i] = (FLT_OR_DBL)rand() / RAND_MAX * 1e-3;
+  }
+
+  /* every variant the host CPU supports must yield exactly the same results as the generic implementation */
+  for (count = 0; count < 100; count++) {
+    vrna_fun_dispatch_disable();
+    min_ref     = vrna_fun_zip_add_min(e1 + count % 3, e2 + count % 5, count);
+    sum_ref     = vrna_fun_zip_mult_sum(q1 + count % 3, q2 + count % 5, count);
+    sum_rev_ref = vrna_fun_zip_mult_sum_reverse(q1 + count % 3, q2 + 199 - count % 5, count);
+
+    for (v = 0; v < 4; v++) {
+      vrna_fun_dispatch_restrict(variants[v]);
+
+      ck_assert_int_eq(vrna_fun_zip_add_min(e1 + count % 3, e2 + count % 5, count), min_ref);
+
+      sum     = vrna_fun_zip_mult_sum(q1 + count % 3, q2 + count % 5, count);
+      sum_rev = vrna_fun_zip_mult_sum_reverse(q1 + count % 3, q2 + 199 - count % 5, count);
+      ck_assert(sum == sum_ref);
+      ck_assert(sum_rev == sum_rev_ref);
+    }
+
+    vrna_fun_dispatch_enable();
+    ck_assert_int_eq(vrna_fun_zip_add_min(e1 + count % 3, e2 + count % 5, count), min_ref);
+  }
+
+  free(e1);
+  free(e2);
+  free(q1);
+  free(q2);
+}
+
+#tcase Random_Numbers
+
+#test test_urn_streams
+{
+  unsigned short  ref[3] = {
+    4711, 42, 1234
+  };
+  double          first, r, draws[4][100];
+  int             i, k, t, num_threads;
+
+  /* single threaded callers draw the sequence of xsubi as before */
+  memcpy(xsubi, ref, sizeof(ref));
+  first = vrna_urn();
+  ck_assert(first == erand48(ref));
+
+  for (i = 0; i < 100; i++)
+    ck_assert(vrna_urn() == erand48(ref));
+
+  ck_assert(memcmp(xsubi, ref, sizeof(ref)) == 0);
+
+  /* re-seeding xsubi directly restarts the sequence */
+  xsubi[0]  = 4711;
+  xsubi[1]  = 42;
+  xsubi[2]  = 1234;
+  ck_assert(vrna_urn() == first);
+
+  vrna_init_rand();
+  memcpy(ref, xsubi, sizeof(ref));
+  ck_assert(vrna_urn() == erand48(ref));
+
+#ifdef _OPENMP
+  /* concurrent callers draw from different streams */
+  num_threads = omp_get_max_threads();
+  omp_set_num_threads(4);
+  vrna_init_rand();
+
+#pragma omp parallel for private(i) schedule(static, 1)
+  for (t = 0; t < 4; t++)
+    for (i = 0; i < 100; i++)
+      draws[t][i] = vrna_urn();
+
+  omp_set_num_threads(num_threads);
+
+  for (t = 0; t < 4; t++) {
+    for (i = 0; i < 100; i++) {
+      r = draws[t][i];
+      ck_assert((r >= 0.) && (r <= 1.));
+    }
+
+    for (k = t + 1; k < 4; k++)
+      ck_assert(memcmp(draws[t], draws[k], sizeof(draws[t])) != 0);
+  }
+#endif
+}
+
+#tcase Accessibility_Store
+
+#test test_acc_store
+{
+  vrna_acc_store_writer_t *writer;
+  vrna_acc_store_t        *store;
+  const vrna_acc_record_t *rec;
+  const char              *filename = "test_acc_store.bin";
+  const char              *ids[]    = {
+    "target_B", "target_A", "target_A"
+  };
+  unsigned int            lengths[] = {
+    50, 30, 20
+  };
+  unsigned int            i, k, u, max_u = 6;
+  double                  **pu, kT = 0.61632;
+  FILE                    *fp;
+
+  writer = vrna_acc_store_create(filename);
+  ck_assert(writer != NULL);
+
+  for (k = 0; k < 3; k++) {
+    pu = (double **)vrna_alloc(sizeof(double *) * (lengths[k] + 1));
+    for (i = 1; i <= lengths[k]; i++) {
+      pu[i] = (double *)vrna_alloc(sizeof(double) * (max_u + 1));
+      for (u = 1; u <= max_u; u++)
+        pu[i][u] = 1. / (double)(k + i + u);
+    }
+    pu[7][3] = 0.;
+
+    ck_assert_int_eq(vrna_acc_store_add(writer, ids[k], lengths[k], max_u, kT, pu), 1);
+
+    for (i = 1; i <= lengths[k]; i++)
+      free(pu[i]);
+    free(pu);
+  }
+
+  ck_assert_int_eq(vrna_acc_store_finish(writer), 1);
+
+  store = vrna_acc_store_open(filename);
+  ck_assert(store != NULL);
+  ck_assert_int_eq(vrna_acc_store_size(store), 3);
+
+  for (k = 0; k < 3; k++) {
+    rec = vrna_acc_store_record(store, k);
+    ck_assert(rec != NULL);
+    ck_assert_str_eq(rec->id, ids[k]);
+    ck_assert_int_eq(rec->length, lengths[k]);
+    ck_assert_int_eq(rec->max_u, max_u);
+    ck_assert(rec->kT == kT);
+
+    for (i = 1; i <= lengths[k]; i++)
+      for (u = 1; u <= max_u; u++) {
+        if (u > i) {
+          ck_assert(isnan(vrna_acc_record_energy(rec, i, u)));
+        } else if ((i == 7) && (u == 3)) {
+          ck_assert(isinf(vrna_acc_record_energy(rec, i, u)));
+          ck_assert(vrna_acc_record_probability(rec, i, u) == 0.);
+        } else {
+          ck_assert(fabs(vrna_acc_record_energy(rec, i, u) -
+                         log((double)(k + i + u)) * kT) < 1e-5);
+          ck_assert(fabs(vrna_acc_record_probability(rec, i, u) -
+                         1. / (double)(k + i + u)) < 1e-6);
+        }
+      }
+
+    /* records point directly into the file data */
+    ck_assert(rec->energies[(max_u - 1) * rec->length + 9] ==
+              vrna_acc_record_energy(rec, 10, max_u));
+    ck_assert(isnan(vrna_acc_record_energy(rec, lengths[k] + 1, 1)));
+  }
+
+  /* duplicate identifiers resolve to their first occurrence */
+  ck_assert(vrna_acc_store_find(store, "target_A") == vrna_acc_store_record(store, 1));
+  ck_assert(vrna_acc_store_find(store, "target_B") == vrna_acc_store_record(store, 0));
+  ck_assert(vrna_acc_store_find(store, "target_C") == NULL);
+  ck_assert(vrna_acc_store_record(store, 3) == NULL);
+
+  vrna_acc_store_close(store);
+
+  /* unfinished and foreign files are rejected */
+  writer = vrna_acc_store_create(filename);
+  ck_assert(writer != NULL);
+  ck_assert(vrna_acc_store_open(filename) == NULL);
+  ck_assert_int_eq(vrna_acc_store_finish(writer), 1);
+
+  store = vrna_acc_store_open(filename);
+  ck_assert(store != NULL);
+  ck_assert_int_eq(vrna_acc_store_size(store), 0);
+  vrna_acc_store_close(store);
+
+  fp = fopen(filename, "w");
+  fprintf(fp, "#opening energies\n #i$\tl=1\t2\t3\t4\t5\t6\t\n");
+  fclose(fp);
+  ck_assert(vrna_acc_store_open(filename) == NULL);
+
+  remove(filename);
+}